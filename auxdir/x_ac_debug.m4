@@ -7,8 +7,8 @@
 #
 #  DESCRIPTION:
 #    Add support for the "--enable-debug", "--enable-memory-leak-debug",
-#    "--disable-partial-attach", "--enable-front-end", and "--enable-developer"
-#    configure script options.
+#    "--enable-lock-stats", "--disable-partial-attach", "--enable-front-end",
+#    and "--enable-developer" configure script options.
 #
 #    options.
 #    If debugging is enabled, CFLAGS will be prepended with the debug flags.
@@ -101,6 +101,23 @@ AC_DEFUN([X_AC_DEBUG], [
   fi
   AC_MSG_RESULT([${x_ac_memory_debug=no}])
 
+  AC_MSG_CHECKING([whether lock statistics are enabled])
+  AC_ARG_ENABLE(
+    [lock-stats],
+    AS_HELP_STRING(--enable-lock-stats,enable slurmctld lock wait and hold time statistics),
+    [ case "$enableval" in
+        yes) x_ac_lock_stats=yes ;;
+         no) x_ac_lock_stats=no ;;
+          *) AC_MSG_RESULT([doh!])
+             AC_MSG_ERROR([bad value "$enableval" for --enable-lock-stats]) ;;
+      esac
+    ]
+  )
+  if test "$x_ac_lock_stats" = yes; then
+    AC_DEFINE(LOCK_STATS, 1, [Define to 1 for lock wait and hold time statistics.])
+  fi
+  AC_MSG_RESULT([${x_ac_lock_stats=no}])
+
   AC_MSG_CHECKING([whether to enable slurmd operation on a front-end])
   AC_ARG_ENABLE(
     [front-end],
@@ -930,6 +930,8 @@ head2 SLURM ERRNO
 
 =item * SLURMCTLD_COMMUNICATIONS_SHUTDOWN_ERROR         1803
 
+=item * SLURMCTLD_COMMUNICATIONS_BACKOFF                1804
+
 =back
 
 =head3 _info.c/communication layer RESPONSE_SLURM_RC message codes
@@ -103,7 +103,9 @@ struct spank_option my_spank_options[] = {
      "Cannot be specified together with 'skip-hicann-init'.",
      0, 0, (spank_opt_cb_f)_no_op},
     {"defects-path", "[path/to/custom/blacklisting]",
-     "Path to directory containing blacklisting information.",
+     "Path to directory containing blacklisting information. "
+     "HICANNs and FPGAs listed in its wafer_<id>.defects files "
+     "(lines 'hicann <id>' or 'fpga <id>') are not allocated.",
      1, 0, (spank_opt_cb_f)_check_opt},
     SPANK_OPTIONS_TABLE_END};
 
@@ -107,3 +107,49 @@ slurm_load_licenses(time_t t,
 
 	return SLURM_SUCCESS;
 }
+
+/* slurm_load_license_usage()
+ *
+ * Load the usage of all licenses from the controller.
+ *
+ */
+extern int
+slurm_load_license_usage(time_t t,
+			 license_usage_msg_t **lic_usage)
+{
+	int cc;
+	slurm_msg_t msg_request;
+	slurm_msg_t msg_reply;
+	struct license_info_request_msg req;
+
+	memset(&req, 0, sizeof(struct license_info_request_msg));
+	slurm_msg_t_init(&msg_request);
+	slurm_msg_t_init(&msg_reply);
+
+	msg_request.msg_type = REQUEST_LICENSE_USAGE;
+	req.last_update = t;
+	msg_request.data = &req;
+
+	cc = slurm_send_recv_controller_msg(&msg_request, &msg_reply,
+					    working_cluster_rec);
+	if (cc < 0)
+		return SLURM_ERROR;
+
+	switch (msg_reply.msg_type) {
+		case RESPONSE_LICENSE_USAGE:
+			*lic_usage = msg_reply.data;
+			break;
+		case RESPONSE_SLURM_RC:
+			cc = ((return_code_msg_t *)msg_reply.data)->return_code;
+			slurm_free_return_code_msg(msg_reply.data);
+			if (cc) /* slurm_seterrno_ret() is a macro ... sigh */
+				slurm_seterrno(cc);
+			*lic_usage = NULL;
+			return -1;
+		default:
+			slurm_seterrno_ret(SLURM_UNEXPECTED_MSG_ERROR);
+		break;
+	}
+
+	return SLURM_SUCCESS;
+}
@@ -44,6 +44,7 @@
 #include <stdlib.h>
 #include <ctype.h>
 
+#include "src/common/lock_stats.h"
 #include "src/common/uid.h"
 #include "src/common/xstring.h"
 #include "src/common/slurm_priority.h"
@@ -73,6 +74,17 @@ static char *assoc_mgr_cluster_name = NULL;
 static int setup_children = 0;
 static pthread_rwlock_t assoc_mgr_locks[ASSOC_MGR_ENTITY_COUNT];
 
+#ifdef LOCK_STATS
+static const char *lock_names[ASSOC_MGR_ENTITY_COUNT] = {
+	"assoc_mgr.assoc", "assoc_mgr.file", "assoc_mgr.qos", "assoc_mgr.res",
+	"assoc_mgr.tres", "assoc_mgr.user", "assoc_mgr.wckey"
+};
+
+/* Statistics and acquisition times of the locks held by this thread */
+static __thread lock_stats_ent_t *held_stats[ASSOC_MGR_ENTITY_COUNT];
+static __thread struct timespec held_since[ASSOC_MGR_ENTITY_COUNT];
+#endif
+
 static assoc_init_args_t init_setup;
 static slurmdb_assoc_rec_t **assoc_hash_id = NULL;
 static slurmdb_assoc_rec_t **assoc_hash = NULL;
@@ -2195,7 +2207,45 @@ bool verify_assoc_lock(assoc_mgr_lock_datatype_t datatype, lock_level_t level)
 }
 #endif
 
-extern void assoc_mgr_lock(assoc_mgr_lock_t *locks)
+static void _lock_entity(assoc_mgr_lock_datatype_t datatype,
+			 lock_level_t level, const char *caller)
+{
+#ifdef LOCK_STATS
+	struct timespec requested;
+
+	if (level == NO_LOCK)
+		return;
+	clock_gettime(CLOCK_MONOTONIC, &requested);
+#endif
+
+	if (level == READ_LOCK)
+		slurm_rwlock_rdlock(&assoc_mgr_locks[datatype]);
+	else if (level == WRITE_LOCK)
+		slurm_rwlock_wrlock(&assoc_mgr_locks[datatype]);
+
+#ifdef LOCK_STATS
+	held_stats[datatype] = lock_stats_acquired(lock_names[datatype],
+						   (level == WRITE_LOCK),
+						   caller, &requested,
+						   &held_since[datatype]);
+#endif
+}
+
+static void _unlock_entity(assoc_mgr_lock_datatype_t datatype,
+			   lock_level_t level)
+{
+	if (level == NO_LOCK)
+		return;
+
+	slurm_rwlock_unlock(&assoc_mgr_locks[datatype]);
+
+#ifdef LOCK_STATS
+	lock_stats_released(held_stats[datatype], &held_since[datatype]);
+	held_stats[datatype] = NULL;
+#endif
+}
+
+extern void assoc_mgr_lock_caller(assoc_mgr_lock_t *locks, const char *caller)
 {
 	static bool init_run = false;
 	xassert(_store_locks(locks));
@@ -2206,66 +2256,32 @@ extern void assoc_mgr_lock(assoc_mgr_lock_t *locks)
 			slurm_rwlock_init(&assoc_mgr_locks[i]);
 	}
 
-	if (locks->assoc == READ_LOCK)
-		slurm_rwlock_rdlock(&assoc_mgr_locks[ASSOC_LOCK]);
-	else if (locks->assoc == WRITE_LOCK)
-		slurm_rwlock_wrlock(&assoc_mgr_locks[ASSOC_LOCK]);
-
-	if (locks->file == READ_LOCK)
-		slurm_rwlock_rdlock(&assoc_mgr_locks[FILE_LOCK]);
-	else if (locks->file == WRITE_LOCK)
-		slurm_rwlock_wrlock(&assoc_mgr_locks[FILE_LOCK]);
-
-	if (locks->qos == READ_LOCK)
-		slurm_rwlock_rdlock(&assoc_mgr_locks[QOS_LOCK]);
-	else if (locks->qos == WRITE_LOCK)
-		slurm_rwlock_wrlock(&assoc_mgr_locks[QOS_LOCK]);
-
-	if (locks->res == READ_LOCK)
-		slurm_rwlock_rdlock(&assoc_mgr_locks[RES_LOCK]);
-	else if (locks->res == WRITE_LOCK)
-		slurm_rwlock_wrlock(&assoc_mgr_locks[RES_LOCK]);
-
-	if (locks->tres == READ_LOCK)
-		slurm_rwlock_rdlock(&assoc_mgr_locks[TRES_LOCK]);
-	else if (locks->tres == WRITE_LOCK)
-		slurm_rwlock_wrlock(&assoc_mgr_locks[TRES_LOCK]);
-
-	if (locks->user == READ_LOCK)
-		slurm_rwlock_rdlock(&assoc_mgr_locks[USER_LOCK]);
-	else if (locks->user == WRITE_LOCK)
-		slurm_rwlock_wrlock(&assoc_mgr_locks[USER_LOCK]);
-
-	if (locks->wckey == READ_LOCK)
-		slurm_rwlock_rdlock(&assoc_mgr_locks[WCKEY_LOCK]);
-	else if (locks->wckey == WRITE_LOCK)
-		slurm_rwlock_wrlock(&assoc_mgr_locks[WCKEY_LOCK]);
+	_lock_entity(ASSOC_LOCK, locks->assoc, caller);
+	_lock_entity(FILE_LOCK, locks->file, caller);
+	_lock_entity(QOS_LOCK, locks->qos, caller);
+	_lock_entity(RES_LOCK, locks->res, caller);
+	_lock_entity(TRES_LOCK, locks->tres, caller);
+	_lock_entity(USER_LOCK, locks->user, caller);
+	_lock_entity(WCKEY_LOCK, locks->wckey, caller);
+}
+
+/* Parentheses keep the LOCK_STATS macro of assoc_mgr.h from expanding */
+extern void (assoc_mgr_lock)(assoc_mgr_lock_t *locks)
+{
+	assoc_mgr_lock_caller(locks, NULL);
 }
 
 extern void assoc_mgr_unlock(assoc_mgr_lock_t *locks)
 {
 	xassert(_clear_locks(locks));
 
-	if (locks->wckey)
-		slurm_rwlock_unlock(&assoc_mgr_locks[WCKEY_LOCK]);
-
-	if (locks->user)
-		slurm_rwlock_unlock(&assoc_mgr_locks[USER_LOCK]);
-
-	if (locks->tres)
-		slurm_rwlock_unlock(&assoc_mgr_locks[TRES_LOCK]);
-
-	if (locks->res)
-		slurm_rwlock_unlock(&assoc_mgr_locks[RES_LOCK]);
-
-	if (locks->qos)
-		slurm_rwlock_unlock(&assoc_mgr_locks[QOS_LOCK]);
-
-	if (locks->file)
-		slurm_rwlock_unlock(&assoc_mgr_locks[FILE_LOCK]);
-
-	if (locks->assoc)
-		slurm_rwlock_unlock(&assoc_mgr_locks[ASSOC_LOCK]);
+	_unlock_entity(WCKEY_LOCK, locks->wckey);
+	_unlock_entity(USER_LOCK, locks->user);
+	_unlock_entity(TRES_LOCK, locks->tres);
+	_unlock_entity(RES_LOCK, locks->res);
+	_unlock_entity(QOS_LOCK, locks->qos);
+	_unlock_entity(FILE_LOCK, locks->file);
+	_unlock_entity(ASSOC_LOCK, locks->assoc);
 }
 
 /* Since the returned assoc_list is full of pointers from the
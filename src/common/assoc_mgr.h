@@ -124,6 +124,17 @@ extern int assoc_mgr_fini(bool save_state);
 extern void assoc_mgr_lock(assoc_mgr_lock_t *locks);
 extern void assoc_mgr_unlock(assoc_mgr_lock_t *locks);
 
+/*
+ * assoc_mgr_lock_caller - assoc_mgr_lock() with the function issuing the lock
+ *	requests, recorded in the lock statistics if built with LOCK_STATS
+ */
+extern void assoc_mgr_lock_caller(assoc_mgr_lock_t *locks, const char *caller);
+
+#ifdef LOCK_STATS
+/* Record the wait and hold times of locks by the function locking them */
+#define assoc_mgr_lock(_l) assoc_mgr_lock_caller(_l, __func__)
+#endif
+
 #ifndef NDEBUG
 extern bool verify_assoc_lock(assoc_mgr_lock_datatype_t datatype, lock_level_t level);
 #endif
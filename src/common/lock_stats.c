@@ -0,0 +1,281 @@
+/*****************************************************************************\
+ *  lock_stats.c - Wait and hold time statistics of slurmctld and assoc_mgr
+ *	locks by caller
+ *
+ *  Statistics are kept for each lock, lock level and function requesting
+ *  the lock, in a hash table keyed by the addresses of the lock name and
+ *  caller string constants. Times are counted in histograms with buckets
+ *  growing tenfold from 1 usec to 1 sec.
+ *
+ *  This file has been developed by staff and students
+ *  of Heidelberg University as part of the research carried out by the
+ *  Electronic Vision(s) group at the Kirchhoff-Institute for Physics.
+ *  The research is funded by Heidelberg University, the State of
+ *  Baden-Württemberg, the Seventh Framework Programme under grant agreements
+ *  no 604102 (HBP) as well as the Horizon 2020 Framework Programme under grant
+ *  agreement 720270 (HBP).
+\*****************************************************************************/
+
+#include "config.h"
+
+#include <pthread.h>
+#include <string.h>
+
+#include "src/common/lock_stats.h"
+#include "src/common/log.h"
+#include "src/common/macros.h"
+#include "src/common/slurm_protocol_defs.h"
+#include "src/common/xmalloc.h"
+#include "src/common/xstring.h"
+
+#define LOCK_STATS_TBL_SIZE 4096	/* entries, power of 2 */
+
+struct lock_stats_ent {
+	const char *lock;
+	const char *caller;
+	bool write;
+	uint64_t cnt;
+	uint64_t wait_nsec;
+	uint64_t wait_max_nsec;
+	uint32_t wait_hist[LOCK_STATS_HIST_CNT];
+	uint64_t hold_nsec;
+	uint64_t hold_max_nsec;
+	uint32_t hold_hist[LOCK_STATS_HIST_CNT];
+};
+
+static pthread_mutex_t lock_stats_mutex = PTHREAD_MUTEX_INITIALIZER;
+static lock_stats_ent_t *lock_stats_tbl[LOCK_STATS_TBL_SIZE];
+static uint32_t lock_stats_cnt = 0;
+
+/* Callers beyond the capacity of the table */
+static lock_stats_ent_t lock_stats_other = { .lock = "other",
+					     .caller = "other" };
+
+static uint64_t _elapsed_nsec(const struct timespec *start,
+			      const struct timespec *end)
+{
+	if ((end->tv_sec < start->tv_sec) ||
+	    ((end->tv_sec == start->tv_sec) &&
+	     (end->tv_nsec < start->tv_nsec)))
+		return 0;
+	return ((uint64_t) (end->tv_sec - start->tv_sec) * NSEC_IN_SEC) +
+	       end->tv_nsec - start->tv_nsec;
+}
+
+/* Bucket 0 counts times below 1 usec, each next one ten times longer */
+static int _hist_inx(uint64_t nsec)
+{
+	uint64_t limit = NSEC_IN_USEC;
+	int i;
+
+	for (i = 0; i < (LOCK_STATS_HIST_CNT - 1); i++, limit *= 10) {
+		if (nsec < limit)
+			break;
+	}
+	return i;
+}
+
+/* Find or add the entry of a lock and caller, lock_stats_mutex set */
+static lock_stats_ent_t *_find_ent(const char *lock, bool write,
+				   const char *caller)
+{
+	lock_stats_ent_t *ent;
+	uint32_t i;
+
+	i = (((uintptr_t) lock * 31) ^ ((uintptr_t) caller >> 3) ^ write) &
+	    (LOCK_STATS_TBL_SIZE - 1);
+	while ((ent = lock_stats_tbl[i])) {
+		if ((ent->caller == caller) && (ent->lock == lock) &&
+		    (ent->write == write))
+			return ent;
+		i = (i + 1) & (LOCK_STATS_TBL_SIZE - 1);
+	}
+
+	/* Keep the table at most 3/4 full */
+	if (lock_stats_cnt >= ((LOCK_STATS_TBL_SIZE / 4) * 3))
+		return &lock_stats_other;
+
+	ent = xmalloc(sizeof(lock_stats_ent_t));
+	ent->lock = lock;
+	ent->caller = caller;
+	ent->write = write;
+	lock_stats_tbl[i] = ent;
+	lock_stats_cnt++;
+
+	return ent;
+}
+
+extern lock_stats_ent_t *lock_stats_acquired(const char *lock, bool write,
+					     const char *caller,
+					     const struct timespec *requested,
+					     struct timespec *acquired)
+{
+	lock_stats_ent_t *ent;
+	uint64_t nsec;
+
+	clock_gettime(CLOCK_MONOTONIC, acquired);
+	nsec = _elapsed_nsec(requested, acquired);
+
+	slurm_mutex_lock(&lock_stats_mutex);
+	ent = _find_ent(lock, write, caller ? caller : "unknown");
+	ent->cnt++;
+	ent->wait_nsec += nsec;
+	ent->wait_max_nsec = MAX(ent->wait_max_nsec, nsec);
+	ent->wait_hist[_hist_inx(nsec)]++;
+	slurm_mutex_unlock(&lock_stats_mutex);
+
+	return ent;
+}
+
+extern void lock_stats_released(lock_stats_ent_t *ent,
+				const struct timespec *acquired)
+{
+	struct timespec now;
+	uint64_t nsec;
+
+	if (!ent)
+		return;
+
+	clock_gettime(CLOCK_MONOTONIC, &now);
+	nsec = _elapsed_nsec(acquired, &now);
+
+	slurm_mutex_lock(&lock_stats_mutex);
+	ent->hold_nsec += nsec;
+	ent->hold_max_nsec = MAX(ent->hold_max_nsec, nsec);
+	ent->hold_hist[_hist_inx(nsec)]++;
+	slurm_mutex_unlock(&lock_stats_mutex);
+}
+
+static void _reset_ent(lock_stats_ent_t *ent)
+{
+	ent->cnt = 0;
+	ent->wait_nsec = 0;
+	ent->wait_max_nsec = 0;
+	memset(ent->wait_hist, 0, sizeof(ent->wait_hist));
+	ent->hold_nsec = 0;
+	ent->hold_max_nsec = 0;
+	memset(ent->hold_hist, 0, sizeof(ent->hold_hist));
+}
+
+extern void lock_stats_reset(void)
+{
+	int i;
+
+	/* Entries stay allocated, they are referenced by held locks */
+	slurm_mutex_lock(&lock_stats_mutex);
+	for (i = 0; i < LOCK_STATS_TBL_SIZE; i++) {
+		if (lock_stats_tbl[i])
+			_reset_ent(lock_stats_tbl[i]);
+	}
+	_reset_ent(&lock_stats_other);
+	slurm_mutex_unlock(&lock_stats_mutex);
+}
+
+static void _pack_ent(lock_stats_ent_t *ent, Buf buffer)
+{
+	packstr((char *) ent->lock, buffer);
+	packstr((char *) ent->caller, buffer);
+	pack16((uint16_t) ent->write, buffer);
+	pack64(ent->cnt, buffer);
+	pack64(ent->wait_nsec / NSEC_IN_USEC, buffer);
+	pack32((uint32_t) MIN(ent->wait_max_nsec / NSEC_IN_USEC, INFINITE - 1),
+	       buffer);
+	pack32_array(ent->wait_hist, LOCK_STATS_HIST_CNT, buffer);
+	pack64(ent->hold_nsec / NSEC_IN_USEC, buffer);
+	pack32((uint32_t) MIN(ent->hold_max_nsec / NSEC_IN_USEC, INFINITE - 1),
+	       buffer);
+	pack32_array(ent->hold_hist, LOCK_STATS_HIST_CNT, buffer);
+}
+
+extern void lock_stats_pack(Buf buffer, uint16_t protocol_version)
+{
+	uint32_t cnt = 0, cnt_offset, tmp_offset;
+	int i;
+
+	if (protocol_version < SLURM_20_02_VISIONS_PROTOCOL_VERSION)
+		return;
+
+	cnt_offset = get_buf_offset(buffer);
+	pack32(cnt, buffer);
+
+	slurm_mutex_lock(&lock_stats_mutex);
+	for (i = 0; i < LOCK_STATS_TBL_SIZE; i++) {
+		if (!lock_stats_tbl[i] || !lock_stats_tbl[i]->cnt)
+			continue;
+		_pack_ent(lock_stats_tbl[i], buffer);
+		cnt++;
+	}
+	if (lock_stats_other.cnt) {
+		_pack_ent(&lock_stats_other, buffer);
+		cnt++;
+	}
+	slurm_mutex_unlock(&lock_stats_mutex);
+
+	tmp_offset = get_buf_offset(buffer);
+	set_buf_offset(buffer, cnt_offset);
+	pack32(cnt, buffer);
+	set_buf_offset(buffer, tmp_offset);
+}
+
+extern int lock_stats_unpack(lock_stats_t **stats_ptr, uint32_t *stats_cnt,
+			     Buf buffer, uint16_t protocol_version)
+{
+	lock_stats_t *stats = NULL, *rec;
+	uint32_t cnt = 0, uint32_tmp, *hist = NULL;
+	uint16_t uint16_tmp;
+	int i;
+
+	*stats_ptr = NULL;
+	*stats_cnt = 0;
+	if (protocol_version < SLURM_20_02_VISIONS_PROTOCOL_VERSION)
+		return SLURM_SUCCESS;
+
+	safe_unpack32(&cnt, buffer);
+	if (cnt > NO_VAL)
+		goto unpack_error;
+	if (cnt)
+		stats = xcalloc(cnt, sizeof(lock_stats_t));
+	for (i = 0, rec = stats; i < cnt; i++, rec++) {
+		safe_unpackstr_xmalloc(&rec->lock, &uint32_tmp, buffer);
+		safe_unpackstr_xmalloc(&rec->caller, &uint32_tmp, buffer);
+		safe_unpack16(&uint16_tmp, buffer);
+		rec->write = uint16_tmp;
+		safe_unpack64(&rec->cnt, buffer);
+		safe_unpack64(&rec->wait_usec, buffer);
+		safe_unpack32(&rec->wait_max_usec, buffer);
+		safe_unpack32_array(&hist, &uint32_tmp, buffer);
+		if (uint32_tmp != LOCK_STATS_HIST_CNT)
+			goto unpack_error;
+		memcpy(rec->wait_hist, hist, sizeof(rec->wait_hist));
+		xfree(hist);
+		safe_unpack64(&rec->hold_usec, buffer);
+		safe_unpack32(&rec->hold_max_usec, buffer);
+		safe_unpack32_array(&hist, &uint32_tmp, buffer);
+		if (uint32_tmp != LOCK_STATS_HIST_CNT)
+			goto unpack_error;
+		memcpy(rec->hold_hist, hist, sizeof(rec->hold_hist));
+		xfree(hist);
+	}
+
+	*stats_ptr = stats;
+	*stats_cnt = cnt;
+	return SLURM_SUCCESS;
+
+unpack_error:
+	xfree(hist);
+	lock_stats_free_array(stats, cnt);
+	return SLURM_ERROR;
+}
+
+extern void lock_stats_free_array(lock_stats_t *stats, uint32_t stats_cnt)
+{
+	int i;
+
+	if (!stats)
+		return;
+	for (i = 0; i < stats_cnt; i++) {
+		xfree(stats[i].lock);
+		xfree(stats[i].caller);
+	}
+	xfree(stats);
+}
@@ -0,0 +1,69 @@
+/*****************************************************************************\
+ *  lock_stats.h - Wait and hold time statistics of slurmctld and assoc_mgr
+ *	locks by caller
+ *
+ *  This file has been developed by staff and students
+ *  of Heidelberg University as part of the research carried out by the
+ *  Electronic Vision(s) group at the Kirchhoff-Institute for Physics.
+ *  The research is funded by Heidelberg University, the State of
+ *  Baden-Württemberg, the Seventh Framework Programme under grant agreements
+ *  no 604102 (HBP) as well as the Horizon 2020 Framework Programme under grant
+ *  agreement 720270 (HBP).
+\*****************************************************************************/
+
+#ifndef _LOCK_STATS_H
+#define _LOCK_STATS_H
+
+#include <stdbool.h>
+#include <stdint.h>
+#include <time.h>
+
+#include "slurm/slurm.h"
+#include "src/common/pack.h"
+
+/*
+ * Statistics are only recorded if configured with --enable-lock-stats,
+ * which defines LOCK_STATS. lock_slurmctld() and assoc_mgr_lock() then
+ * record the function requesting the locks, the time waited for each lock
+ * and the time it was held until unlocked.
+ */
+
+typedef struct lock_stats_ent lock_stats_ent_t;
+
+/*
+ * lock_stats_acquired - Record the time waited for a lock
+ * IN lock - name of the lock, a string constant
+ * IN write - true if the write lock was acquired, false if the read lock
+ * IN caller - function requesting the lock, a string constant
+ * IN requested - time the lock was requested at, CLOCK_MONOTONIC
+ * OUT acquired - set to the time the lock was acquired at
+ * RET statistics to pass to lock_stats_released() once unlocked
+ */
+extern lock_stats_ent_t *lock_stats_acquired(const char *lock, bool write,
+					     const char *caller,
+					     const struct timespec *requested,
+					     struct timespec *acquired);
+
+/*
+ * lock_stats_released - Record the time a lock was held
+ * IN ent - from lock_stats_acquired()
+ * IN acquired - time the lock was acquired at, from lock_stats_acquired()
+ */
+extern void lock_stats_released(lock_stats_ent_t *ent,
+				const struct timespec *acquired);
+
+/* Clear all statistics */
+extern void lock_stats_reset(void);
+
+/*
+ * Pack or unpack the statistics of all locks and callers, none if built
+ * without LOCK_STATS
+ */
+extern void lock_stats_pack(Buf buffer, uint16_t protocol_version);
+extern int lock_stats_unpack(lock_stats_t **stats_ptr, uint32_t *stats_cnt,
+			     Buf buffer, uint16_t protocol_version);
+
+/* Free an array of statistics from lock_stats_unpack() */
+extern void lock_stats_free_array(lock_stats_t *stats, uint32_t stats_cnt);
+
+#endif /* !_LOCK_STATS_H */
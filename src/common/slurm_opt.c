@@ -593,6 +593,18 @@ static slurm_cli_opt_t slurm_opt_batch = {
 	.reset_func = arg_reset_batch_features,
 };
 
+COMMON_SBATCH_STRING_OPTION(batch_file);
+static slurm_cli_opt_t slurm_opt_batch_file = {
+	.name = "batch-file",
+	.has_arg = required_argument,
+	.val = LONG_OPT_BATCH_FILE,
+	.sbatch_early_pass = true,
+	.set_func_sbatch = arg_set_batch_file,
+	.set_func_data = arg_set_data_batch_file,
+	.get_func = arg_get_batch_file,
+	.reset_func = arg_reset_batch_file,
+};
+
 COMMON_STRING_OPTION(burst_buffer_file);
 static slurm_cli_opt_t slurm_opt_bbf = {
 	.name = "bbf",
@@ -4707,6 +4719,7 @@ static const slurm_cli_opt_t *common_options[] = {
 	&slurm_opt_alloc_nodelist,
 	&slurm_opt_array,
 	&slurm_opt_batch,
+	&slurm_opt_batch_file,
 	&slurm_opt_bcast,
 	&slurm_opt_begin,
 	&slurm_opt_bell,
@@ -74,6 +74,7 @@ enum {
 	LONG_OPT_ACCTG_FREQ,
 	LONG_OPT_ALLOC_NODELIST,
 	LONG_OPT_BATCH,
+	LONG_OPT_BATCH_FILE,
 	LONG_OPT_BCAST,
 	LONG_OPT_BELL,
 	LONG_OPT_BLRTS_IMAGE,
@@ -198,6 +199,7 @@ typedef struct {
 
 	char *array_inx;		/* --array			*/
 	char *batch_features;		/* --batch			*/
+	char *batch_file;		/* --batch-file=file		*/
 	char *export_env;		/* --export			*/
 	char *export_file;		/* --export-file=file		*/
 	bool ignore_pbs;		/* --ignore-pbs			*/
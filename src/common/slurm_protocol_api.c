@@ -4449,6 +4449,31 @@ int slurm_send_rc_err_msg(slurm_msg_t *msg, int rc, char *err_msg)
 	return slurm_send_node_msg(msg->conn_fd, &resp_msg);
 }
 
+extern int slurm_send_rc_backoff_msg(slurm_msg_t *msg, int rc,
+				     uint32_t retry_msec)
+{
+	slurm_msg_t resp_msg;
+	return_code_backoff_msg_t backoff_msg;
+
+	if (msg->conn_fd < 0) {
+		slurm_seterrno(ENOTCONN);
+		return SLURM_ERROR;
+	}
+
+	/* Stock clients do not know RESPONSE_SLURM_RC_BACKOFF */
+	if (msg->protocol_version < SLURM_20_02_VISIONS_PROTOCOL_VERSION)
+		return slurm_send_rc_msg(msg, rc);
+
+	backoff_msg.return_code = rc;
+	backoff_msg.retry_msec = retry_msec;
+
+	_resp_msg_setup(msg, &resp_msg, RESPONSE_SLURM_RC_BACKOFF,
+			&backoff_msg);
+
+	/* send message */
+	return slurm_send_node_msg(msg->conn_fd, &resp_msg);
+}
+
 /*
  * Sends back reroute_msg_t which directs the client to make the request to
  * another cluster.
@@ -4668,6 +4693,32 @@ tryagain:
 			break;
 	}
 
+	if (!rc && (response_msg->msg_type == RESPONSE_SLURM_RC_BACKOFF)) {
+		return_code_backoff_msg_t *bo_msg = response_msg->data;
+		return_code_msg_t *rc_msg;
+
+		/*
+		 * The controller is limiting the rate of our requests, retry
+		 * after the time it asked for while within the message timeout
+		 */
+		if ((difftime(time(NULL), start_time) +
+		     (bo_msg->retry_msec / 1000)) < slurm_get_msg_timeout()) {
+			debug("%s: %s, retry in %u msec", __func__,
+			      slurm_strerror(bo_msg->return_code),
+			      bo_msg->retry_msec);
+			usleep(MAX(bo_msg->retry_msec, 1) * 1000);
+			slurm_free_return_code_backoff_msg(bo_msg);
+			response_msg->data = NULL;
+			goto tryagain;
+		}
+
+		rc_msg = xmalloc(sizeof(return_code_msg_t));
+		rc_msg->return_code = bo_msg->return_code;
+		slurm_free_return_code_backoff_msg(bo_msg);
+		response_msg->msg_type = RESPONSE_SLURM_RC;
+		response_msg->data = rc_msg;
+	}
+
 	if (!rc && (response_msg->msg_type == RESPONSE_SLURM_REROUTE_MSG)) {
 		reroute_msg_t *rr_msg = (reroute_msg_t *)response_msg->data;
 
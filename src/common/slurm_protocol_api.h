@@ -1266,6 +1266,17 @@ int slurm_send_rc_msg(slurm_msg_t * request_msg, int rc);
  */
 int slurm_send_rc_err_msg(slurm_msg_t *msg, int rc, char *err_msg);
 
+/*
+ * slurm_send_rc_backoff_msg
+ * given the original request message this function sends a return code
+ *	back to the client, telling it to retry the request later
+ * IN request_msg	- slurm_msg the request msg
+ * IN rc		- the return_code to send back to the client
+ * IN retry_msec	- time to wait before retrying the request
+ */
+extern int slurm_send_rc_backoff_msg(slurm_msg_t *msg, int rc,
+				     uint32_t retry_msec);
+
 /*
  * slurm_send_recv_controller_msg
  * opens a connection to the controller, sends the controller a message,
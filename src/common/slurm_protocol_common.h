@@ -69,11 +69,16 @@
  * done here with them since we have to support old version of archive
  * files since they don't update once they are created.
  */
+/*
+ * 20.02 as extended by Electronic Vision(s). Messages differ from stock 20.02
+ * only where packed for this version, stock 20.02 peers are still accepted.
+ */
+#define SLURM_20_02_VISIONS_PROTOCOL_VERSION ((35 << 8) | 1)
 #define SLURM_20_02_PROTOCOL_VERSION ((35 << 8) | 0)
 #define SLURM_19_05_PROTOCOL_VERSION ((34 << 8) | 0)
 #define SLURM_18_08_PROTOCOL_VERSION ((33 << 8) | 0)
 
-#define SLURM_PROTOCOL_VERSION SLURM_20_02_PROTOCOL_VERSION
+#define SLURM_PROTOCOL_VERSION SLURM_20_02_VISIONS_PROTOCOL_VERSION
 #define SLURM_ONE_BACK_PROTOCOL_VERSION SLURM_19_05_PROTOCOL_VERSION
 #define SLURM_MIN_PROTOCOL_VERSION SLURM_18_08_PROTOCOL_VERSION
 
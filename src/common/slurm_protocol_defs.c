@@ -46,6 +46,7 @@
 
 #include "src/common/forward.h"
 #include "src/common/job_options.h"
+#include "src/common/lock_stats.h"
 #include "src/common/log.h"
 #include "src/common/node_select.h"
 #include "src/common/parse_time.h"
@@ -814,6 +815,12 @@ extern void slurm_free_return_code_msg(return_code_msg_t * msg)
 	xfree(msg);
 }
 
+extern void slurm_free_return_code_backoff_msg(
+	return_code_backoff_msg_t *msg)
+{
+	xfree(msg);
+}
+
 extern void slurm_free_reroute_msg(reroute_msg_t *msg)
 {
 	if (msg) {
@@ -1676,6 +1683,7 @@ extern void slurm_free_stats_response_msg(stats_info_response_msg_t *msg)
 		xfree(msg->rpc_user_id);
 		xfree(msg->rpc_user_cnt);
 		xfree(msg->rpc_user_time);
+		xfree(msg->rpc_user_limited);
 		xfree(msg->rpc_queue_type_id);
 		xfree(msg->rpc_queue_count);
 		xfree(msg->rpc_dump_types);
@@ -1683,6 +1691,13 @@ extern void slurm_free_stats_response_msg(stats_info_response_msg_t *msg)
 			xfree(msg->rpc_dump_hostlist[i]);
 		}
 		xfree(msg->rpc_dump_hostlist);
+		lock_stats_free_array(msg->lock_stats, msg->lock_stats_cnt);
+		for (i = 0; i < msg->rpc_class_cnt; i++)
+			xfree(msg->rpc_class_stats[i].name);
+		xfree(msg->rpc_class_stats);
+		for (i = 0; i < msg->state_file_cnt; i++)
+			xfree(msg->state_file_stats[i].name);
+		xfree(msg->state_file_stats);
 		xfree(msg);
 	}
 }
@@ -4090,6 +4105,23 @@ extern void slurm_free_submit_response_response_msg(submit_response_msg_t * msg)
 	}
 }
 
+/*
+ * slurm_free_submit_batch_response_msg - free slurm batch job submit
+ *	response message
+ * IN msg - pointer to batch job submit response message
+ * NOTE: buffer is loaded by slurm_submit_batch_jobs
+ */
+extern void slurm_free_submit_batch_response_msg(
+	submit_batch_response_msg_t *msg)
+{
+	if (msg) {
+		xfree(msg->job_id);
+		xfree(msg->error_code);
+		xfree(msg->job_submit_user_msg);
+		xfree(msg);
+	}
+}
+
 
 /*
  * slurm_free_ctl_conf - free slurm control information response message
@@ -4832,6 +4864,9 @@ extern int slurm_free_msg_data(slurm_msg_type_t type, void *data)
 	case RESPONSE_SUBMIT_BATCH_JOB:
 		slurm_free_submit_response_response_msg(data);
 		break;
+	case RESPONSE_SUBMIT_BATCH_JOBS:
+		slurm_free_submit_batch_response_msg(data);
+		break;
 	case RESPONSE_ACCT_GATHER_UPDATE:
 		slurm_free_acct_gather_node_resp_msg(data);
 		break;
@@ -4989,6 +5024,9 @@ extern int slurm_free_msg_data(slurm_msg_type_t type, void *data)
 	case RESPONSE_SLURM_RC:
 		slurm_free_return_code_msg(data);
 		break;
+	case RESPONSE_SLURM_RC_BACKOFF:
+		slurm_free_return_code_backoff_msg(data);
+		break;
 	case REQUEST_SET_DEBUG_FLAGS:
 		slurm_free_set_debug_flags_msg(data);
 		break;
@@ -5064,8 +5102,12 @@ extern int slurm_free_msg_data(slurm_msg_type_t type, void *data)
 		slurm_free_stats_info_request_msg(data);
 		break;
 	case REQUEST_LICENSE_INFO:
+	case REQUEST_LICENSE_USAGE:
 		slurm_free_license_info_request_msg(data);
 		break;
+	case RESPONSE_LICENSE_USAGE:
+		slurm_free_license_usage_msg(data);
+		break;
 	case REQUEST_ACCT_GATHER_ENERGY:
 		slurm_free_acct_gather_energy_req_msg(data);
 		break;
@@ -5124,6 +5166,7 @@ extern int slurm_free_msg_data(slurm_msg_type_t type, void *data)
 		break;
 	case REQUEST_HET_JOB_ALLOCATION:
 	case REQUEST_SUBMIT_BATCH_HET_JOB:
+	case REQUEST_SUBMIT_BATCH_JOBS:
 	case RESPONSE_HET_JOB_ALLOCATION:
 		FREE_NULL_LIST(data);
 		break;
@@ -5166,6 +5209,9 @@ extern uint32_t slurm_get_return_code(slurm_msg_type_t type, void *data)
 	case RESPONSE_SLURM_RC:
 		rc = ((return_code_msg_t *)data)->return_code;
 		break;
+	case RESPONSE_SLURM_RC_BACKOFF:
+		rc = ((return_code_backoff_msg_t *)data)->return_code;
+		break;
 	case RESPONSE_PING_SLURMD:
 		rc = SLURM_SUCCESS;
 		break;
@@ -5243,6 +5289,32 @@ slurm_free_license_info_msg(license_info_msg_t *msg)
 	}
 	xfree(msg);
 }
+/* slurm_free_license_usage_msg()
+ *
+ * Free the license usage returned previously
+ * from the controller.
+ */
+extern void
+slurm_free_license_usage_msg(license_usage_msg_t *msg)
+{
+	int cc;
+
+	if (msg == NULL)
+		return;
+
+	if (msg->lic_array) {
+		for (cc = 0; cc < msg->num_lic; cc++) {
+			xfree(msg->lic_array[cc].name);
+			xfree(msg->lic_array[cc].members);
+			xfree(msg->lic_array[cc].in_use_members);
+			xfree(msg->lic_array[cc].reserved_members);
+			xfree(msg->lic_array[cc].avail_members);
+		}
+		xfree(msg->lic_array);
+	}
+	xfree(msg);
+}
+
 extern void slurm_free_license_info_request_msg(license_info_request_msg_t *msg)
 {
 	xfree(msg);
@@ -5304,6 +5376,10 @@ rpc_num2string(uint16_t opcode)
 		return "REQUEST_LICENSE_INFO";
 	case RESPONSE_LICENSE_INFO:
 		return "RESPONSE_LICENSE_INFO";
+	case REQUEST_LICENSE_USAGE:
+		return "REQUEST_LICENSE_USAGE";
+	case RESPONSE_LICENSE_USAGE:
+		return "RESPONSE_LICENSE_USAGE";
 	case REQUEST_SET_FS_DAMPENING_FACTOR:
 		return "REQUEST_SET_FS_DAMPENING_FACTOR,";
 
@@ -5458,6 +5534,10 @@ rpc_num2string(uint16_t opcode)
 		return "REQUEST_JOB_ALLOCATION_INFO";
 	case RESPONSE_JOB_ALLOCATION_INFO:
 		return "RESPONSE_JOB_ALLOCATION_INFO";
+	case REQUEST_SUBMIT_BATCH_JOBS:
+		return "REQUEST_SUBMIT_BATCH_JOBS";
+	case RESPONSE_SUBMIT_BATCH_JOBS:
+		return "RESPONSE_SUBMIT_BATCH_JOBS";
 	case REQUEST_HET_JOB_ALLOCATION:
 		return "REQUEST_HET_JOB_ALLOCATION";
 	case RESPONSE_HET_JOB_ALLOCATION:
@@ -5629,6 +5709,8 @@ rpc_num2string(uint16_t opcode)
 		return "RESPONSE_SLURM_RC_MSG";
 	case RESPONSE_SLURM_REROUTE_MSG:
 		return "RESPONSE_SLURM_REROUTE_MSG";
+	case RESPONSE_SLURM_RC_BACKOFF:
+		return "RESPONSE_SLURM_RC_BACKOFF";
 
 	case RESPONSE_FORWARD_FAILED:				/* 9001 */
 		return "RESPONSE_FORWARD_FAILED";
@@ -240,8 +240,8 @@ typedef enum {
 	RESPONSE_NODE_INFO,
 	REQUEST_PARTITION_INFO,
 	RESPONSE_PARTITION_INFO,	/* 2010 */
-	DEFUNCT_RPC_2011,
-	DEFUNCT_RPC_2012,
+	REQUEST_LICENSE_USAGE,
+	RESPONSE_LICENSE_USAGE,
 	REQUEST_JOB_ID,
 	RESPONSE_JOB_ID,
 	REQUEST_CONFIG,
@@ -316,8 +316,8 @@ typedef enum {
 	RESPONSE_JOB_WILL_RUN,
 	REQUEST_JOB_ALLOCATION_INFO,
 	RESPONSE_JOB_ALLOCATION_INFO,
-	DEFUNCT_RPC_4017, /* free for reuse */
-	DEFUNCT_RPC_4018, /* free for reuse */
+	REQUEST_SUBMIT_BATCH_JOBS,
+	RESPONSE_SUBMIT_BATCH_JOBS,
 	REQUEST_UPDATE_JOB_TIME,
 	REQUEST_JOB_READY,
 	RESPONSE_JOB_READY,		/* 4020 */
@@ -423,6 +423,7 @@ typedef enum {
 	RESPONSE_SLURM_RC = 8001,
 	RESPONSE_SLURM_RC_MSG,
 	RESPONSE_SLURM_REROUTE_MSG,
+	RESPONSE_SLURM_RC_BACKOFF,
 
 	RESPONSE_FORWARD_FAILED = 9001,
 
@@ -907,6 +908,10 @@ typedef struct return_code2_msg {
 	uint32_t return_code;
 	char *err_msg;
 } return_code2_msg_t;
+typedef struct return_code_backoff_msg {
+	uint32_t return_code;
+	uint32_t retry_msec;	/* retry no earlier than this */
+} return_code_backoff_msg_t;
 
 typedef struct {
 	slurmdb_cluster_rec_t *working_cluster_rec;
@@ -1382,6 +1387,8 @@ extern void slurm_free_dep_msg(dep_msg_t *msg);
 extern void slurm_free_dep_update_origin_msg(dep_update_origin_msg_t *msg);
 extern void slurm_free_last_update_msg(last_update_msg_t * msg);
 extern void slurm_free_return_code_msg(return_code_msg_t * msg);
+extern void slurm_free_return_code_backoff_msg(
+	return_code_backoff_msg_t *msg);
 extern void slurm_free_reroute_msg(reroute_msg_t *msg);
 extern void slurm_free_job_alloc_info_msg(job_alloc_info_msg_t * msg);
 extern void slurm_free_job_info_request_msg(job_info_request_msg_t *msg);
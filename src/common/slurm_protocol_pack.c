@@ -48,6 +48,7 @@
 #include "src/common/forward.h"
 #include "src/common/gres.h"
 #include "src/common/job_options.h"
+#include "src/common/lock_stats.h"
 #include "src/common/log.h"
 #include "src/common/node_select.h"
 #include "src/common/pack.h"
@@ -1601,6 +1602,55 @@ unpack_error:
 	return SLURM_ERROR;
 }
 
+static void
+_pack_submit_batch_response_msg(submit_batch_response_msg_t *msg, Buf buffer,
+				uint16_t protocol_version)
+{
+	xassert(msg);
+
+	if (protocol_version >= SLURM_MIN_PROTOCOL_VERSION) {
+		pack32_array(msg->job_id, msg->job_cnt, buffer);
+		pack32_array(msg->error_code, msg->job_cnt, buffer);
+		packstr(msg->job_submit_user_msg, buffer);
+	} else {
+		error("%s: protocol_version %hu not supported", __func__,
+		      protocol_version);
+	}
+}
+
+static int
+_unpack_submit_batch_response_msg(submit_batch_response_msg_t **msg,
+				  Buf buffer, uint16_t protocol_version)
+{
+	submit_batch_response_msg_t *tmp_ptr;
+	uint32_t uint32_tmp;
+
+	xassert(msg);
+	tmp_ptr = xmalloc(sizeof(submit_batch_response_msg_t));
+	*msg = tmp_ptr;
+
+	if (protocol_version >= SLURM_MIN_PROTOCOL_VERSION) {
+		safe_unpack32_array(&tmp_ptr->job_id, &tmp_ptr->job_cnt,
+				    buffer);
+		safe_unpack32_array(&tmp_ptr->error_code, &uint32_tmp, buffer);
+		if (uint32_tmp != tmp_ptr->job_cnt)
+			goto unpack_error;
+		safe_unpackstr_xmalloc(&tmp_ptr->job_submit_user_msg,
+				       &uint32_tmp, buffer);
+	} else {
+		error("%s: protocol_version %hu not supported", __func__,
+		      protocol_version);
+		goto unpack_error;
+	}
+
+	return SLURM_SUCCESS;
+
+unpack_error:
+	slurm_free_submit_batch_response_msg(tmp_ptr);
+	*msg = NULL;
+	return SLURM_ERROR;
+}
+
 static int _unpack_node_info_msg(node_info_msg_t **msg, Buf buffer,
 				 uint16_t protocol_version)
 {
@@ -7601,6 +7651,35 @@ unpack_error:
 	return SLURM_ERROR;
 }
 
+static void
+_pack_return_code_backoff_msg(return_code_backoff_msg_t *msg, Buf buffer,
+			      uint16_t protocol_version)
+{
+	xassert(msg);
+	pack32(msg->return_code, buffer);
+	pack32(msg->retry_msec, buffer);
+}
+
+static int
+_unpack_return_code_backoff_msg(return_code_backoff_msg_t **msg, Buf buffer,
+				uint16_t protocol_version)
+{
+	return_code_backoff_msg_t *backoff_msg;
+
+	xassert(msg);
+	backoff_msg = xmalloc(sizeof(return_code_backoff_msg_t));
+	*msg = backoff_msg;
+
+	safe_unpack32(&backoff_msg->return_code, buffer);
+	safe_unpack32(&backoff_msg->retry_msec, buffer);
+	return SLURM_SUCCESS;
+
+unpack_error:
+	slurm_free_return_code_backoff_msg(backoff_msg);
+	*msg = NULL;
+	return SLURM_ERROR;
+}
+
 static void
 _pack_reroute_msg(reroute_msg_t * msg, Buf buffer, uint16_t protocol_version)
 {
@@ -11387,6 +11466,7 @@ static int  _unpack_stats_response_msg(stats_info_response_msg_t **msg_ptr,
 				       Buf buffer, uint16_t protocol_version)
 {
 	uint32_t uint32_tmp = 0;
+	int i;
 	stats_info_response_msg_t * msg;
 	xassert(msg_ptr);
 
@@ -11441,6 +11521,76 @@ static int  _unpack_stats_response_msg(stats_info_response_msg_t **msg_ptr,
 			safe_unpack32(&msg->bf_active,		buffer);
 			safe_unpack32(&msg->bf_backfilled_het_jobs, buffer);
 		}
+		if (msg->parts_packed &&
+		    (protocol_version >= SLURM_20_02_VISIONS_PROTOCOL_VERSION)) {
+			safe_unpack32(&msg->bf_plan_full,	buffer);
+			safe_unpack32(&msg->bf_plan_incr,	buffer);
+			safe_unpack32(&msg->bf_plan_last_reused, buffer);
+			safe_unpack32(&msg->bf_plan_reused_sum,	buffer);
+
+			safe_unpack32(&msg->job_info_cache_hits, buffer);
+			safe_unpack32(&msg->job_info_cache_misses, buffer);
+			safe_unpack32(&msg->node_info_cache_hits, buffer);
+			safe_unpack32(&msg->node_info_cache_misses, buffer);
+			safe_unpack32(&msg->part_info_cache_hits, buffer);
+			safe_unpack32(&msg->part_info_cache_misses, buffer);
+
+			safe_unpack32(&msg->job_rec_locks, buffer);
+			safe_unpack32(&msg->job_rec_lock_rpcs, buffer);
+			safe_unpack64(&msg->job_rec_lock_cnt, buffer);
+			safe_unpack64(&msg->job_rec_lock_wait_cnt, buffer);
+			safe_unpack64(&msg->job_rec_lock_wait_usec, buffer);
+			safe_unpack32(&msg->job_rec_lock_wait_max, buffer);
+
+			if (lock_stats_unpack(&msg->lock_stats,
+					      &msg->lock_stats_cnt, buffer,
+					      protocol_version))
+				goto unpack_error;
+
+			safe_unpack32(&msg->rpc_workers, buffer);
+			safe_unpack32(&uint32_tmp, buffer);
+			if (uint32_tmp > NO_VAL)
+				goto unpack_error;
+			if (uint32_tmp)
+				msg->rpc_class_stats =
+					xcalloc(uint32_tmp,
+						sizeof(rpc_class_stats_t));
+			msg->rpc_class_cnt = uint32_tmp;
+			for (i = 0; i < msg->rpc_class_cnt; i++) {
+				rpc_class_stats_t *rec =
+					&msg->rpc_class_stats[i];
+				safe_unpackstr_xmalloc(&rec->name, &uint32_tmp,
+						       buffer);
+				safe_unpack32(&rec->max_workers, buffer);
+				safe_unpack32(&rec->active, buffer);
+				safe_unpack32(&rec->queued, buffer);
+				safe_unpack64(&rec->cnt, buffer);
+				safe_unpack64(&rec->wait_usec, buffer);
+				safe_unpack32(&rec->wait_max_usec, buffer);
+			}
+
+			safe_unpack32(&uint32_tmp, buffer);
+			if (uint32_tmp > NO_VAL)
+				goto unpack_error;
+			if (uint32_tmp)
+				msg->state_file_stats =
+					xcalloc(uint32_tmp,
+						sizeof(state_file_stats_t));
+			msg->state_file_cnt = uint32_tmp;
+			for (i = 0; i < msg->state_file_cnt; i++) {
+				state_file_stats_t *rec =
+					&msg->state_file_stats[i];
+				safe_unpackstr_xmalloc(&rec->name, &uint32_tmp,
+						       buffer);
+				safe_unpack32(&rec->packed, buffer);
+				safe_unpack32(&rec->written, buffer);
+				safe_unpack64(&rec->lock_usec, buffer);
+				safe_unpack32(&rec->lock_max_usec, buffer);
+				safe_unpack64(&rec->io_usec, buffer);
+				safe_unpack32(&rec->io_max_usec, buffer);
+				safe_unpack32(&rec->size, buffer);
+			}
+		}
 
 		safe_unpack32(&msg->rpc_type_size,		buffer);
 		safe_unpack16_array(&msg->rpc_type_id,   &uint32_tmp, buffer);
@@ -11451,6 +11601,16 @@ static int  _unpack_stats_response_msg(stats_info_response_msg_t **msg_ptr,
 		safe_unpack32_array(&msg->rpc_user_id,   &uint32_tmp, buffer);
 		safe_unpack32_array(&msg->rpc_user_cnt,  &uint32_tmp, buffer);
 		safe_unpack64_array(&msg->rpc_user_time, &uint32_tmp, buffer);
+		if (protocol_version >= SLURM_20_02_VISIONS_PROTOCOL_VERSION) {
+			safe_unpack32_array(&msg->rpc_user_limited,
+					    &uint32_tmp, buffer);
+			if (uint32_tmp != msg->rpc_user_size)
+				goto unpack_error;
+		} else if (msg->rpc_user_size) {
+			/* Stock controllers do not limit RPC rates */
+			msg->rpc_user_limited = xcalloc(msg->rpc_user_size,
+							sizeof(uint32_t));
+		}
 
 		safe_unpack32_array(&msg->rpc_queue_type_id,
 				    &msg->rpc_queue_type_count,
@@ -11523,6 +11683,10 @@ static int  _unpack_stats_response_msg(stats_info_response_msg_t **msg_ptr,
 		safe_unpack32_array(&msg->rpc_user_id,   &uint32_tmp, buffer);
 		safe_unpack32_array(&msg->rpc_user_cnt,  &uint32_tmp, buffer);
 		safe_unpack64_array(&msg->rpc_user_time, &uint32_tmp, buffer);
+		/* Stock controllers do not limit RPC rates */
+		if (msg->rpc_user_size)
+			msg->rpc_user_limited = xcalloc(msg->rpc_user_size,
+							sizeof(uint32_t));
 
 		safe_unpack32_array(&msg->rpc_queue_type_id,
 				    &msg->rpc_queue_type_count,
@@ -11656,6 +11820,66 @@ unpack_error:
 	return SLURM_ERROR;
 }
 
+/* _unpack_license_usage_msg()
+ *
+ * Decode the license usage as it comes from the controller, see
+ * get_all_license_usage()
+ */
+static int
+_unpack_license_usage_msg(license_usage_msg_t **msg, Buf buffer,
+			  uint16_t protocol_version)
+{
+	slurm_license_usage_t *lic;
+	int i;
+	uint32_t zz;
+
+	xassert(msg);
+	*msg = xmalloc(sizeof(license_usage_msg_t));
+
+	if (protocol_version >= SLURM_MIN_PROTOCOL_VERSION) {
+		safe_unpack32(&((*msg)->num_lic), buffer);
+		safe_unpack_time(&((*msg)->last_update), buffer);
+
+		safe_xcalloc((*msg)->lic_array, (*msg)->num_lic,
+			     sizeof(slurm_license_usage_t));
+
+		for (i = 0; i < (*msg)->num_lic; i++) {
+			lic = &(*msg)->lic_array[i];
+			safe_unpackstr_xmalloc(&lic->name, &zz, buffer);
+			safe_unpack32(&lic->total, buffer);
+			safe_unpack32(&lic->in_use, buffer);
+			safe_unpack32(&lic->reserved, buffer);
+			safe_unpack8(&lic->remote, buffer);
+			safe_unpackstr_xmalloc(&lic->members, &zz, buffer);
+			safe_unpackstr_xmalloc(&lic->in_use_members, &zz,
+					       buffer);
+			safe_unpackstr_xmalloc(&lic->reserved_members, &zz,
+					       buffer);
+			safe_unpackstr_xmalloc(&lic->avail_members, &zz,
+					       buffer);
+			/* The total number of licenses can decrease
+			 * at runtime.
+			 */
+			if (lic->total < (lic->in_use + lic->reserved))
+				lic->available = 0;
+			else
+				lic->available = lic->total - lic->in_use -
+						 lic->reserved;
+		}
+	} else {
+		error("%s: protocol_version %hu not supported",
+		      __func__, protocol_version);
+		goto unpack_error;
+	}
+
+	return SLURM_SUCCESS;
+
+unpack_error:
+	slurm_free_license_usage_msg(*msg);
+	*msg = NULL;
+	return SLURM_ERROR;
+}
+
 static void _pack_job_array_resp_msg(job_array_resp_msg_t *msg, Buf buffer,
 				     uint16_t protocol_version)
 {
@@ -12117,6 +12341,7 @@ pack_msg(slurm_msg_t const *msg, Buf buffer)
 		break;
 	case REQUEST_HET_JOB_ALLOCATION:
 	case REQUEST_SUBMIT_BATCH_HET_JOB:
+	case REQUEST_SUBMIT_BATCH_JOBS:
 		_pack_job_desc_list_msg((List) msg->data, buffer,
 					msg->protocol_version);
 		break;
@@ -12205,6 +12430,11 @@ pack_msg(slurm_msg_t const *msg, Buf buffer)
 					  msg->data, buffer,
 					  msg->protocol_version);
 		break;
+	case RESPONSE_SUBMIT_BATCH_JOBS:
+		_pack_submit_batch_response_msg((submit_batch_response_msg_t *)
+						msg->data, buffer,
+						msg->protocol_version);
+		break;
 	case RESPONSE_JOB_ALLOCATION_INFO:
 	case RESPONSE_RESOURCE_ALLOCATION:
 		_pack_resource_allocation_response_msg
@@ -12400,6 +12630,11 @@ pack_msg(slurm_msg_t const *msg, Buf buffer)
 		_pack_reroute_msg((reroute_msg_t *)msg->data, buffer,
 				  msg->protocol_version);
 		break;
+	case RESPONSE_SLURM_RC_BACKOFF:
+		_pack_return_code_backoff_msg(
+			(return_code_backoff_msg_t *) msg->data, buffer,
+			msg->protocol_version);
+		break;
 	case RESPONSE_JOB_STEP_CREATE:
 		_pack_job_step_create_response_msg(
 			(job_step_create_response_msg_t *)
@@ -12625,12 +12860,14 @@ pack_msg(slurm_msg_t const *msg, Buf buffer)
 				       buffer, msg->protocol_version);
 		break;
 	case REQUEST_LICENSE_INFO:
+	case REQUEST_LICENSE_USAGE:
 		 _pack_license_info_request_msg((license_info_request_msg_t *)
 						msg->data,
 						buffer,
 						msg->protocol_version);
 			break;
 	case RESPONSE_LICENSE_INFO:
+	case RESPONSE_LICENSE_USAGE:
 		_pack_license_info_msg((slurm_msg_t *) msg, buffer);
 		break;
 	case MESSAGE_COMPOSITE:
@@ -12785,6 +13022,7 @@ unpack_msg(slurm_msg_t * msg, Buf buffer)
 		break;
 	case REQUEST_HET_JOB_ALLOCATION:
 	case REQUEST_SUBMIT_BATCH_HET_JOB:
+	case REQUEST_SUBMIT_BATCH_JOBS:
 		rc = _unpack_job_desc_list_msg((List *) &(msg->data),
 					       buffer, msg->protocol_version);
 		break;
@@ -12877,6 +13115,11 @@ unpack_msg(slurm_msg_t * msg, Buf buffer)
 						 & (msg->data), buffer,
 						 msg->protocol_version);
 		break;
+	case RESPONSE_SUBMIT_BATCH_JOBS:
+		rc = _unpack_submit_batch_response_msg(
+			(submit_batch_response_msg_t **) &(msg->data),
+			buffer, msg->protocol_version);
+		break;
 	case RESPONSE_JOB_ALLOCATION_INFO:
 	case RESPONSE_RESOURCE_ALLOCATION:
 		rc = _unpack_resource_allocation_response_msg(
@@ -13092,6 +13335,11 @@ unpack_msg(slurm_msg_t * msg, Buf buffer)
 		rc = _unpack_reroute_msg((reroute_msg_t **)&(msg->data), buffer,
 					 msg->protocol_version);
 		break;
+	case RESPONSE_SLURM_RC_BACKOFF:
+		rc = _unpack_return_code_backoff_msg(
+			(return_code_backoff_msg_t **) &(msg->data), buffer,
+			msg->protocol_version);
+		break;
 	case RESPONSE_JOB_STEP_CREATE:
 		rc = _unpack_job_step_create_response_msg(
 			(job_step_create_response_msg_t **)
@@ -13345,7 +13593,13 @@ unpack_msg(slurm_msg_t * msg, Buf buffer)
 					      buffer,
 					      msg->protocol_version);
 		break;
+	case RESPONSE_LICENSE_USAGE:
+		rc = _unpack_license_usage_msg((license_usage_msg_t **)
+					       &(msg->data), buffer,
+					       msg->protocol_version);
+		break;
 	case REQUEST_LICENSE_INFO:
+	case REQUEST_LICENSE_USAGE:
 		rc = _unpack_license_info_request_msg((license_info_request_msg_t **)
 						      &(msg->data),
 						      buffer,
@@ -37,6 +37,7 @@
  *  51 Franklin Street, Fifth Floor, Boston, MA 02110-1301  USA.
 \*****************************************************************************/
 
+#include <limits.h>
 #include <pthread.h>
 
 #include "src/common/log.h"
@@ -58,6 +59,16 @@ struct hypercube_switch *hypercube_switch_table = NULL;
 int hypercube_switch_cnt = 0;
 struct hypercube_switch ***hypercube_switches = NULL; 
 
+/* defined here but is really wafer plugin related */
+wafer_record_t *wafer_record_table = NULL;
+int wafer_record_cnt = 0;
+int wafer_hicann_cnt = 0;
+int wafer_reticle_cnt = 0;
+int *wafer_hicann_reticle = NULL;
+bitstr_t **wafer_hicann_neighbors = NULL;
+bitstr_t **wafer_reticle_hicanns = NULL;
+bitstr_t **wafer_reticle_neighbors = NULL;
+
 typedef struct slurm_topo_ops {
 	int		(*build_config)		( void );
 	bool		(*node_ranking)		( void );
@@ -167,3 +178,164 @@ extern int slurm_topo_get_node_addr(char* node_name,
 
 	return (*(ops.get_node_addr))(node_name,addr,pattern);
 }
+
+/* Count usable HICANNs of a reticle */
+static int _wafer_reticle_hicann_cnt(bitstr_t *usable_hicanns, int reticle)
+{
+	return bit_overlap(wafer_reticle_hicanns[reticle], usable_hicanns);
+}
+
+/*
+ * Grow a connected set of free reticles from seed until it holds hicann_cnt
+ * HICANNs. Each step adds the adjacent free reticle with the most neighbors
+ * which are picked already or not free, so the set fills holes first.
+ * RET number of reticles picked, 0 if not enough HICANNs are reachable
+ */
+static int _wafer_grow(bitstr_t *usable_hicanns, bitstr_t *free_reticles,
+		       int seed, uint32_t hicann_cnt, bitstr_t *picked,
+		       int *last)
+{
+	uint32_t hicanns;
+	int picked_cnt = 1, best, best_score, score, r;
+
+	bit_clear_all(picked);
+	bit_set(picked, seed);
+	*last = seed;
+	hicanns = _wafer_reticle_hicann_cnt(usable_hicanns, seed);
+	while (hicanns < hicann_cnt) {
+		best = -1;
+		best_score = -1;
+		for (r = 0; r < wafer_reticle_cnt; r++) {
+			if (!bit_test(free_reticles, r) || bit_test(picked, r) ||
+			    !bit_overlap_any(wafer_reticle_neighbors[r], picked))
+				continue;
+			score = bit_set_count(wafer_reticle_neighbors[r]) -
+				bit_overlap(wafer_reticle_neighbors[r],
+					    free_reticles) +
+				bit_overlap(wafer_reticle_neighbors[r], picked);
+			if (score > best_score) {
+				best = r;
+				best_score = score;
+			}
+		}
+		if (best == -1)
+			return 0;
+		bit_set(picked, best);
+		*last = best;
+		picked_cnt++;
+		hicanns += _wafer_reticle_hicann_cnt(usable_hicanns, best);
+	}
+
+	return picked_cnt;
+}
+
+/* Count free reticles adjacent to the picked ones */
+static int _wafer_perimeter(bitstr_t *free_reticles, bitstr_t *picked)
+{
+	bitstr_t *border = bit_alloc(wafer_reticle_cnt);
+	int r, cnt;
+
+	for (r = 0; r < wafer_reticle_cnt; r++) {
+		if (bit_test(picked, r))
+			bit_or(border, wafer_reticle_neighbors[r]);
+	}
+	bit_and(border, free_reticles);
+	bit_and_not(border, picked);
+	cnt = bit_set_count(border);
+	FREE_NULL_BITMAP(border);
+
+	return cnt;
+}
+
+extern int wafer_topo_select(uint32_t hicann_cnt, bitstr_t **avail_reticles,
+			     bitstr_t **avail_hicanns, int *wafer_inx,
+			     bitstr_t **hicann_bitmap)
+{
+	bitstr_t *free_reticles, *picked, *best_picked = NULL, *hicanns;
+	bitstr_t *usable_hicanns, *best_usable = NULL;
+	int best_inx = -1, best_cnt = 0, best_perim = 0, best_free = 0;
+	int best_last = -1, free_cnt, picked_cnt, perim, last;
+	int i, r, h, h_min, nbr_cnt, nbr_min;
+	uint32_t surplus;
+
+	*hicann_bitmap = NULL;
+	if (!wafer_record_cnt || !hicann_cnt)
+		return SLURM_ERROR;
+
+	picked = bit_alloc(wafer_reticle_cnt);
+	for (i = 0; i < wafer_record_cnt; i++) {
+		free_reticles = bit_copy(wafer_record_table[i].reticle_bitmap);
+		if (avail_reticles && avail_reticles[i])
+			bit_and(free_reticles, avail_reticles[i]);
+		usable_hicanns = bit_copy(wafer_record_table[i].hicann_bitmap);
+		if (avail_hicanns && avail_hicanns[i])
+			bit_and(usable_hicanns, avail_hicanns[i]);
+		free_cnt = bit_set_count(free_reticles);
+		for (r = 0; free_cnt && (r < wafer_reticle_cnt); r++) {
+			if (!bit_test(free_reticles, r))
+				continue;
+			picked_cnt = _wafer_grow(usable_hicanns, free_reticles,
+						 r, hicann_cnt, picked, &last);
+			if (!picked_cnt)
+				continue;
+			perim = _wafer_perimeter(free_reticles, picked);
+			if (best_picked &&
+			    ((picked_cnt > best_cnt) ||
+			     ((picked_cnt == best_cnt) &&
+			      ((perim > best_perim) ||
+			       ((perim == best_perim) &&
+				(free_cnt >= best_free))))))
+				continue;
+			FREE_NULL_BITMAP(best_picked);
+			best_picked = bit_copy(picked);
+			FREE_NULL_BITMAP(best_usable);
+			best_usable = bit_copy(usable_hicanns);
+			best_inx = i;
+			best_cnt = picked_cnt;
+			best_perim = perim;
+			best_free = free_cnt;
+			best_last = last;
+		}
+		FREE_NULL_BITMAP(free_reticles);
+		FREE_NULL_BITMAP(usable_hicanns);
+	}
+	FREE_NULL_BITMAP(picked);
+
+	if (!best_picked)
+		return SLURM_ERROR;
+
+	hicanns = bit_alloc(wafer_hicann_cnt);
+	for (r = 0; r < wafer_reticle_cnt; r++) {
+		if (bit_test(best_picked, r))
+			bit_or(hicanns, wafer_reticle_hicanns[r]);
+	}
+	bit_and(hicanns, best_usable);
+	FREE_NULL_BITMAP(best_picked);
+	FREE_NULL_BITMAP(best_usable);
+
+	/*
+	 * Drop surplus HICANNs of the reticle added last, those with the
+	 * fewest neighbors in the set first
+	 */
+	surplus = bit_set_count(hicanns) - hicann_cnt;
+	while (surplus--) {
+		h_min = -1;
+		nbr_min = INT_MAX;
+		for (h = 0; h < wafer_hicann_cnt; h++) {
+			if (!bit_test(hicanns, h) ||
+			    (wafer_hicann_reticle[h] != best_last))
+				continue;
+			nbr_cnt = bit_overlap(wafer_hicann_neighbors[h],
+					      hicanns);
+			if (nbr_cnt < nbr_min) {
+				h_min = h;
+				nbr_min = nbr_cnt;
+			}
+		}
+		bit_clear(hicanns, h_min);
+	}
+
+	*wafer_inx = best_inx;
+	*hicann_bitmap = hicanns;
+	return SLURM_SUCCESS;
+}
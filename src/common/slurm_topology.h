@@ -93,6 +93,50 @@ extern int hypercube_switch_cnt; /* size of hypercube_switch_table */
  * with the sorting of the Hilbert curve. */
 extern struct hypercube_switch ***hypercube_switches; 
 
+/*****************************************************************************\
+ *  Wafer topology data structures
+ *  defined here but is really wafer plugin related
+ *
+ *  Reticles are indexed like the FPGAs serving them (FPGAOnWafer), HICANNs
+ *  by HICANNOnWafer. The layout of reticles and HICANNs is the same on all
+ *  wafers, only the components present in the hardware database differ.
+\*****************************************************************************/
+typedef struct {
+	uint32_t wafer_id;		/* wafer module id */
+	bitstr_t *hicann_bitmap;	/* HICANNs present, with their FPGA */
+	bitstr_t *reticle_bitmap;	/* reticles with FPGA present */
+} wafer_record_t;
+
+extern wafer_record_t *wafer_record_table;  /* ptr to wafer records */
+extern int wafer_record_cnt;		/* size of wafer_record_table */
+extern int wafer_hicann_cnt;		/* HICANNs per wafer */
+extern int wafer_reticle_cnt;		/* reticles per wafer */
+extern int *wafer_hicann_reticle;	/* reticle of each HICANN */
+extern bitstr_t **wafer_hicann_neighbors;  /* adjacent HICANNs of each
+					    * HICANN */
+extern bitstr_t **wafer_reticle_hicanns;   /* HICANNs of each reticle */
+extern bitstr_t **wafer_reticle_neighbors; /* adjacent reticles of each
+					    * reticle */
+
+/*
+ * wafer_topo_select - Choose a wafer and a compact set of HICANNs on it.
+ *	Whole reticles are blocked by the use of their FPGA, so the HICANNs
+ *	are placed on as few connected reticles as possible, preferring
+ *	reticles enclosed by reticles in use and wafers with the fewest
+ *	reticles left, to keep free reticles contiguous.
+ * IN hicann_cnt - number of HICANNs requested
+ * IN avail_reticles - reticles not in use, by wafer index, NULL if unknown
+ *	(all available)
+ * IN avail_hicanns - HICANNs not blacklisted, by wafer index, NULL if
+ *	unknown (all usable)
+ * OUT wafer_inx - index of the chosen wafer in wafer_record_table
+ * OUT hicann_bitmap - HICANNs chosen, must be freed by caller
+ * RET SLURM_SUCCESS or SLURM_ERROR if no wafer has enough HICANNs available
+ */
+extern int wafer_topo_select(uint32_t hicann_cnt, bitstr_t **avail_reticles,
+			     bitstr_t **avail_hicanns,
+			     int *wafer_inx, bitstr_t **hicann_bitmap);
+
 /*****************************************************************************\
  *  Slurm topology functions
 \*****************************************************************************/
@@ -352,6 +352,7 @@ extern int as_mysql_job_start(mysql_conn_t *mysql_conn, job_record_t *job_ptr)
 
 		job_state &= (~JOB_RESIZING);
 		job_ptr->db_index = 0;
+		job_ptr->state_dirty = true;
 	}
 
 	job_state &= JOB_STATE_BASE;
@@ -652,6 +653,7 @@ no_rollup_change:
 			} else
 				rc = SLURM_ERROR;
 		}
+		job_ptr->state_dirty = true;
 	} else {
 		query = xstrdup_printf("update \"%s_%s\" set nodelist='%s', ",
 				       mysql_conn->cluster_name,
@@ -319,6 +319,7 @@ static void *_set_db_inx_thread(void *no_data)
 				 * it accordingly.
 				 */
 				job_ptr->db_index = NO_VAL64;
+				job_ptr->state_dirty = true;
 			}
 
 			req = xmalloc(sizeof(dbd_job_start_msg_t));
@@ -2591,8 +2592,10 @@ extern int jobacct_storage_p_job_start(void *db_conn, job_record_t *job_ptr)
 		 * same job.  This can happen when an account is being
 		 * deleted and hense the associations dealing with it.
 		 */
-		if (!req.db_index)
+		if (!req.db_index) {
 			job_ptr->db_index = NO_VAL64;
+			job_ptr->state_dirty = true;
+		}
 
 		if (send_slurmdbd_msg(SLURM_PROTOCOL_VERSION, &msg) < 0) {
 			_partial_free_dbd_job_start(&req);
@@ -2616,6 +2619,7 @@ extern int jobacct_storage_p_job_start(void *db_conn, job_record_t *job_ptr)
 	} else {
 		resp = (dbd_id_rc_msg_t *) msg_rc.data;
 		job_ptr->db_index = resp->db_index;
+		job_ptr->state_dirty = true;
 		rc = resp->return_code;
 		//info("here got %d for return code", resp->rc);
 		slurmdbd_free_id_rc_msg(resp);
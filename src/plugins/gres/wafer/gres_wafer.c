@@ -0,0 +1,473 @@
+/*****************************************************************************\
+ *  gres_wafer.c - Support the components of the wafer modules of the
+ *  neuromorphic physical model platform as generic resources.
+ *
+ *  This plugin has been developed by staff and students
+ *  of Heidelberg University as part of the research carried out by the
+ *  Electronic Vision(s) group at the Kirchhoff-Institute for Physics.
+ *  The research is funded by Heidelberg University, the State of
+ *  Baden-Württemberg, the Seventh Framework Programme under grant agreements
+ *  no 604102 (HBP) as well as the Horizon 2020 Framework Programme under grant
+ *  agreement 720270 (HBP).
+\*****************************************************************************/
+
+/*
+ * Each wafer module is controlled by one host node, whose gres.conf (or
+ * slurm.conf) describes the components of the wafer as typed GRES:
+ *
+ *	Name=wafer Type=hicann Count=384 Cores=0-7
+ *	Name=wafer Type=fpga Count=48 Cores=0-7
+ *	Name=wafer Type=adc Count=2 Cores=8-9
+ *
+ * Wafer components have no device files on the host node, so this plugin
+ * gives each record a placeholder File specification. This makes slurmctld
+ * track every component individually, so that a job is allocated specific
+ * HICANNs, FPGAs and ADCs together with the host CPUs they are bound to by
+ * the regular GRES scheduling of select/cons_tres. The components allocated
+ * are made available to the job by index within their type.
+ *
+ * This covers requests for a number of components per node. Requests for
+ * specific components, their neighbours and readout are still made through
+ * job_submit/nmpm_custom_resource, which allocates wafer components as
+ * licenses and rejects jobs that also request this GRES. A wafer is managed
+ * either way, but not both.
+ */
+
+#include <inttypes.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <sys/types.h>
+#include <unistd.h>
+
+#include "slurm/slurm.h"
+#include "slurm/slurm_errno.h"
+
+#include "src/common/slurm_xlator.h"
+#include "src/common/bitstring.h"
+#include "src/common/env.h"
+#include "src/common/gres.h"
+#include "src/common/list.h"
+#include "src/common/xstring.h"
+
+/*
+ * These variables are required by the generic plugin interface.  If they
+ * are not found in the plugin, the plugin loader will ignore it.
+ *
+ * plugin_name - A string giving a human-readable description of the
+ * plugin.  There is no maximum length, but the symbol must refer to
+ * a valid string.
+ *
+ * plugin_type - A string suggesting the type of the plugin or its
+ * applicability to a particular form of data or method of data handling.
+ * If the low-level plugin API is used, the contents of this string are
+ * unimportant and may be anything.  Slurm uses the higher-level plugin
+ * interface which requires this string to be of the form
+ *
+ *	<application>/<method>
+ *
+ * where <application> is a description of the intended application of
+ * the plugin (e.g., "auth" for Slurm authentication) and <method> is a
+ * description of how this plugin satisfies that application.  Slurm will
+ * only load authentication plugins if the plugin_type string has a prefix
+ * of "auth/".
+ *
+ * plugin_version - an unsigned 32-bit integer containing the Slurm version
+ * (major.minor.micro combined into a single number).
+ */
+const char	plugin_name[]		= "Gres wafer plugin";
+const char	plugin_type[]		= "gres/wafer";
+const uint32_t	plugin_version		= SLURM_VERSION_NUMBER;
+
+static char	gres_name[]		= "wafer";
+
+/* Types of wafer components */
+typedef struct {
+	char *type_name;	/* GRES type */
+	char *env_name;		/* suffix of environment variables */
+	int max_cnt;		/* maximum count per wafer, 0 if unlimited */
+} wafer_comp_t;
+
+#define WAFER_COMP_CNT 3
+static wafer_comp_t wafer_comps[WAFER_COMP_CNT] = {
+	{ "hicann", "HICANNS", 384 },
+	{ "fpga",   "FPGAS",   48 },
+	{ "adc",    "ADCS",    0 },
+};
+
+/*
+ * A gres.conf record of wafer components, mapping the GRES indices of the
+ * node to component indices within their type
+ */
+typedef struct {
+	int comp;		/* index in wafer_comps */
+	int gres_inx;		/* first GRES index on the node */
+	int comp_inx;		/* first component index */
+	int cnt;		/* number of components */
+} wafer_range_t;
+
+static wafer_range_t *wafer_ranges = NULL;
+static int wafer_range_cnt = 0;
+static int wafer_comp_cnt[WAFER_COMP_CNT];
+
+static int _comp_find(char *type_name)
+{
+	int i;
+
+	for (i = 0; i < WAFER_COMP_CNT; i++) {
+		if (!xstrcasecmp(type_name, wafer_comps[i].type_name))
+			return i;
+	}
+	return -1;
+}
+
+static void _ranges_reset(void)
+{
+	xfree(wafer_ranges);
+	wafer_range_cnt = 0;
+	memset(wafer_comp_cnt, 0, sizeof(wafer_comp_cnt));
+}
+
+static void _ranges_add(int comp, int gres_inx, int cnt)
+{
+	wafer_range_t *range;
+
+	xrecalloc(wafer_ranges, wafer_range_cnt + 1, sizeof(wafer_range_t));
+	range = &wafer_ranges[wafer_range_cnt++];
+	range->comp = comp;
+	range->gres_inx = gres_inx;
+	range->comp_inx = wafer_comp_cnt[comp];
+	range->cnt = cnt;
+	wafer_comp_cnt[comp] += cnt;
+}
+
+/*
+ * Format the components of one type in a GRES allocation
+ * RET indexes of the components in ranged form or NULL if none, xfree
+ */
+static char *_comp_fmt(bitstr_t *gres_bit_alloc, bitstr_t *usable_gres,
+		       int comp)
+{
+	bitstr_t *comp_bitmap = NULL;
+	wafer_range_t *range;
+	char *comp_str = NULL;
+	int i, j, gres_inx;
+
+	for (i = 0; i < wafer_range_cnt; i++) {
+		range = &wafer_ranges[i];
+		if (range->comp != comp)
+			continue;
+		for (j = 0; j < range->cnt; j++) {
+			gres_inx = range->gres_inx + j;
+			if ((gres_inx >= bit_size(gres_bit_alloc)) ||
+			    !bit_test(gres_bit_alloc, gres_inx))
+				continue;
+			if (usable_gres &&
+			    ((gres_inx >= bit_size(usable_gres)) ||
+			     !bit_test(usable_gres, gres_inx)))
+				continue;
+			if (!comp_bitmap)
+				comp_bitmap = bit_alloc(wafer_comp_cnt[comp]);
+			bit_set(comp_bitmap, range->comp_inx + j);
+		}
+	}
+	if (comp_bitmap) {
+		comp_str = bit_fmt_full(comp_bitmap);
+		bit_free(comp_bitmap);
+	}
+
+	return comp_str;
+}
+
+static void _set_env(char ***env_ptr, bitstr_t *gres_bit_alloc,
+		     bitstr_t *usable_gres, char *env_prefix)
+{
+	char *comp_str, *env_name = NULL;
+	int i;
+
+	for (i = 0; i < WAFER_COMP_CNT; i++) {
+		xstrfmtcat(env_name, "%s_%s", env_prefix,
+			   wafer_comps[i].env_name);
+		comp_str = NULL;
+		if (gres_bit_alloc)
+			comp_str = _comp_fmt(gres_bit_alloc, usable_gres, i);
+		if (comp_str) {
+			env_array_overwrite(env_ptr, env_name, comp_str);
+			xfree(comp_str);
+		} else if (getenvp(*env_ptr, env_name)) {
+			unsetenvp(*env_ptr, env_name);
+		}
+		xfree(env_name);
+	}
+}
+
+static bitstr_t *_job_bit_alloc(void *gres_ptr, int node_inx)
+{
+	gres_job_state_t *gres_job_ptr = (gres_job_state_t *) gres_ptr;
+
+	if (gres_job_ptr &&
+	    (node_inx >= 0) &&
+	    (node_inx < gres_job_ptr->node_cnt) &&
+	    gres_job_ptr->gres_bit_alloc)
+		return gres_job_ptr->gres_bit_alloc[node_inx];
+	return NULL;
+}
+
+static bitstr_t *_step_bit_alloc(void *gres_ptr)
+{
+	gres_step_state_t *gres_step_ptr = (gres_step_state_t *) gres_ptr;
+
+	if (gres_step_ptr &&
+	    (gres_step_ptr->node_cnt == 1) &&
+	    gres_step_ptr->gres_bit_alloc)
+		return gres_step_ptr->gres_bit_alloc[0];
+	return NULL;
+}
+
+extern int init(void)
+{
+	debug("%s: %s loaded", __func__, plugin_name);
+
+	return SLURM_SUCCESS;
+}
+extern int fini(void)
+{
+	debug("%s: unloading %s", __func__, plugin_name);
+	_ranges_reset();
+
+	return SLURM_SUCCESS;
+}
+
+/*
+ * Validate the types and counts of the wafer components configured and give
+ * each record a placeholder File so the components are tracked individually.
+ */
+extern int node_config_load(List gres_conf_list, node_config_load_t *config)
+{
+	gres_slurmd_conf_t *gres_slurmd_conf;
+	ListIterator itr;
+	uint32_t plugin_id = gres_plugin_build_id(gres_name);
+	int comp, gres_inx = 0, rc = SLURM_SUCCESS;
+
+	/* Assume this state is caused by an scontrol reconfigure */
+	_ranges_reset();
+
+	itr = list_iterator_create(gres_conf_list);
+	while ((gres_slurmd_conf = list_next(itr))) {
+		if (gres_slurmd_conf->plugin_id != plugin_id)
+			continue;
+		if ((comp = _comp_find(gres_slurmd_conf->type_name)) < 0) {
+			error("%s: invalid Type=%s, must be hicann, fpga or adc",
+			      plugin_type, gres_slurmd_conf->type_name);
+			rc = SLURM_ERROR;
+			continue;
+		}
+		if (wafer_comps[comp].max_cnt &&
+		    ((wafer_comp_cnt[comp] + gres_slurmd_conf->count) >
+		     wafer_comps[comp].max_cnt)) {
+			error("%s: more than %d components of Type=%s configured",
+			      plugin_type, wafer_comps[comp].max_cnt,
+			      wafer_comps[comp].type_name);
+			rc = SLURM_ERROR;
+			continue;
+		}
+		if (!gres_slurmd_conf->count)
+			continue;
+		if (!(gres_slurmd_conf->config_flags & GRES_CONF_HAS_FILE)) {
+			xfree(gres_slurmd_conf->file);
+			xstrfmtcat(gres_slurmd_conf->file, "wafer_%s[%d-%"PRIu64"]",
+				   wafer_comps[comp].type_name,
+				   wafer_comp_cnt[comp],
+				   wafer_comp_cnt[comp] +
+				   gres_slurmd_conf->count - 1);
+			gres_slurmd_conf->config_flags |= GRES_CONF_HAS_FILE;
+		}
+		_ranges_add(comp, gres_inx, gres_slurmd_conf->count);
+		gres_inx += gres_slurmd_conf->count;
+	}
+	list_iterator_destroy(itr);
+
+	if (rc != SLURM_SUCCESS)
+		fatal("%s failed to load configuration", plugin_name);
+
+	return rc;
+}
+
+/*
+ * Set environment variables as appropriate for a job (i.e. all tasks) based
+ * upon the job's GRES state.
+ */
+extern void job_set_env(char ***job_env_ptr, void *gres_ptr, int node_inx)
+{
+	_set_env(job_env_ptr, _job_bit_alloc(gres_ptr, node_inx), NULL,
+		 "SLURM_JOB");
+}
+
+/*
+ * Set environment variables as appropriate for a job (i.e. all tasks) based
+ * upon the job step's GRES state.
+ */
+extern void step_set_env(char ***step_env_ptr, void *gres_ptr)
+{
+	_set_env(step_env_ptr, _step_bit_alloc(gres_ptr), NULL, "SLURM_STEP");
+}
+
+/*
+ * Reset environment variables as appropriate for a job (i.e. this one task)
+ * based upon the job step's GRES state and assigned CPUs.
+ */
+extern void step_reset_env(char ***step_env_ptr, void *gres_ptr,
+			   bitstr_t *usable_gres)
+{
+	/* If we are resetting and we don't have a usable_gres we just exit */
+	if (!usable_gres)
+		return;
+
+	_set_env(step_env_ptr, _step_bit_alloc(gres_ptr), usable_gres,
+		 "SLURM_STEP");
+}
+
+/* Send GRES information to slurmstepd on the specified file descriptor*/
+extern void send_stepd(int fd)
+{
+	safe_write(fd, &wafer_range_cnt, sizeof(int));
+	if (wafer_range_cnt) {
+		safe_write(fd, wafer_ranges,
+			   sizeof(wafer_range_t) * wafer_range_cnt);
+	}
+
+	return;
+
+rwfail:
+	error("%s: failed", __func__);
+	return;
+}
+
+/* Receive GRES information from slurmd on the specified file descriptor */
+extern void recv_stepd(int fd)
+{
+	int i, cnt;
+
+	_ranges_reset();
+	safe_read(fd, &cnt, sizeof(int));
+	if (!cnt)
+		return;
+	wafer_ranges = xcalloc(cnt, sizeof(wafer_range_t));
+	safe_read(fd, wafer_ranges, sizeof(wafer_range_t) * cnt);
+	wafer_range_cnt = cnt;
+	for (i = 0; i < cnt; i++) {
+		if ((wafer_ranges[i].comp < 0) ||
+		    (wafer_ranges[i].comp >= WAFER_COMP_CNT))
+			goto rwfail;
+		wafer_comp_cnt[wafer_ranges[i].comp] += wafer_ranges[i].cnt;
+	}
+
+	return;
+
+rwfail:
+	error("%s: failed", __func__);
+	_ranges_reset();
+	return;
+}
+
+/*
+ * get data from a job's GRES data structure
+ * IN job_gres_data  - job's GRES data structure
+ * IN node_inx - zero-origin index of the node within the job's allocation
+ *	for which data is desired
+ * IN data_type - type of data to get from the job's data
+ * OUT data - pointer to the data from job's GRES data structure
+ *            DO NOT FREE: This is a pointer into the job's data structure
+ * RET - SLURM_SUCCESS or error code
+ */
+extern int job_info(gres_job_state_t *job_gres_data, uint32_t node_inx,
+		     enum gres_job_data_type data_type, void *data)
+{
+	return EINVAL;
+}
+
+/*
+ * get data from a step's GRES data structure
+ * IN step_gres_data  - step's GRES data structure
+ * IN node_inx - zero-origin index of the node within the job's allocation
+ *	for which data is desired. Note this can differ from the step's
+ *	node allocation index.
+ * IN data_type - type of data to get from the step's data
+ * OUT data - pointer to the data from step's GRES data structure
+ *            DO NOT FREE: This is a pointer into the step's data structure
+ * RET - SLURM_SUCCESS or error code
+ */
+extern int step_info(gres_step_state_t *step_gres_data, uint32_t node_inx,
+		     enum gres_step_data_type data_type, void *data)
+{
+	return EINVAL;
+}
+
+/*
+ * Return a list of devices of this type. The list elements are of type
+ * "gres_device_t" and the list should be freed using FREE_NULL_LIST().
+ *
+ * Wafer components have no device files on the host node to be constrained.
+ */
+extern List get_devices(void)
+{
+	return NULL;
+}
+
+extern void step_hardware_init(bitstr_t *usable_gres, char *settings)
+{
+	return;
+}
+
+extern void step_hardware_fini(void)
+{
+	return;
+}
+
+/*
+ * Build record used to set environment variables as appropriate for a job's
+ * prolog or epilog based GRES allocated to the job.
+ */
+extern gres_epilog_info_t *epilog_build_env(gres_job_state_t *gres_job_ptr)
+{
+	int i;
+	gres_epilog_info_t *epilog_info;
+
+	epilog_info = xmalloc(sizeof(gres_epilog_info_t));
+	epilog_info->node_cnt = gres_job_ptr->node_cnt;
+	epilog_info->gres_bit_alloc = xcalloc(epilog_info->node_cnt,
+					      sizeof(bitstr_t *));
+	for (i = 0; i < epilog_info->node_cnt; i++) {
+		if (gres_job_ptr->gres_bit_alloc &&
+		    gres_job_ptr->gres_bit_alloc[i]) {
+			epilog_info->gres_bit_alloc[i] =
+				bit_copy(gres_job_ptr->gres_bit_alloc[i]);
+		}
+	}
+
+	return epilog_info;
+}
+
+/*
+ * Set environment variables as appropriate for a job's prolog or epilog based
+ * GRES allocated to the job.
+ */
+extern void epilog_set_env(char ***epilog_env_ptr,
+			   gres_epilog_info_t *epilog_info, int node_inx)
+{
+	xassert(epilog_env_ptr);
+
+	if (!epilog_info || !epilog_info->gres_bit_alloc)
+		return;
+
+	if (node_inx >= epilog_info->node_cnt) {
+		error("%s: %s: bad node index (%d >= %u)", plugin_type,
+		      __func__, node_inx, epilog_info->node_cnt);
+		return;
+	}
+
+	if (!*epilog_env_ptr)
+		*epilog_env_ptr = env_array_create();
+	_set_env(epilog_env_ptr, epilog_info->gres_bit_alloc[node_inx], NULL,
+		 "SLURM_JOB");
+}
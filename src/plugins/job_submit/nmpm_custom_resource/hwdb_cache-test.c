@@ -0,0 +1,240 @@
+/*****************************************************************************\
+ *  hwdb_cache-test.c - Test of the cache of parsed hardware databases of the
+ *  job_submit/nmpm_custom_resource plugin
+ *
+ *  This plugin has been developed by staff and students
+ *  of Heidelberg University as part of the research carried out by the
+ *  Electronic Vision(s) group at the Kirchhoff-Institute for Physics.
+ *  The research is funded by Heidelberg University, the State of
+ *  Baden-Württemberg, the Seventh Framework Programme under grant agreements
+ *  no 604102 (HBP) as well as the Horizon 2020 Framework Programme under grant
+ *  agreement 720270 (HBP).
+\*****************************************************************************/
+
+/* Run as "hwdb_cache-test HWDB", without HWDB only the default hwdb of hwdb4c
+ * is tested. Changes of HWDB are tested on a temporary copy of it.
+ */
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <unistd.h>
+#include <sys/stat.h>
+#include <sys/time.h>
+
+#include "slurm/slurm_errno.h"
+#include "src/common/bitstring.h"
+#include "src/common/xmalloc.h"
+#include "src/common/xstring.h"
+
+#include "hwdb_cache.h"
+
+#include <testsuite/dejagnu.h>
+
+/* Test for failure:
+*/
+#define TEST(_tst, _msg) do {		\
+	if (! (_tst))			\
+		fail( _msg );		\
+	else				\
+		pass( _msg );		\
+} while (0)
+
+/* Copy the hwdb to a temporary file whose mtime the test may change,
+ * RET name of the copy to be unlinked and xfreed or NULL on error */
+static char *_hwdb_copy(char const *path)
+{
+	char *tmp_path = xstrdup("/tmp/hwdb_cache-test.XXXXXX");
+	char buf[4096];
+	FILE *in;
+	size_t len;
+	int fd, rc = 0;
+
+	if (!(in = fopen(path, "r"))) {
+		xfree(tmp_path);
+		return NULL;
+	}
+	if ((fd = mkstemp(tmp_path)) < 0) {
+		fclose(in);
+		xfree(tmp_path);
+		return NULL;
+	}
+	while ((len = fread(buf, 1, sizeof(buf), in)) > 0) {
+		if (write(fd, buf, len) != (ssize_t) len) {
+			rc = -1;
+			break;
+		}
+	}
+	fclose(in);
+	close(fd);
+	if (rc) {
+		unlink(tmp_path);
+		xfree(tmp_path);
+	}
+	return tmp_path;
+}
+
+/* Write the defects file of wafer_id in directory path */
+static int _defects_write(char const *path, size_t wafer_id, char const *content)
+{
+	char *file_name = NULL;
+	FILE *fp;
+	int rc = 0;
+
+	xstrfmtcat(file_name, DEFECTS_FILE_FORMAT, path, wafer_id);
+	if (!(fp = fopen(file_name, "w"))) {
+		xfree(file_name);
+		return -1;
+	}
+	if (fputs(content, fp) == EOF)
+		rc = -1;
+	fclose(fp);
+	xfree(file_name);
+	return rc;
+}
+
+/* Set the mtime of path back by sec seconds */
+static int _mtime_shift(char const *path, int sec)
+{
+	struct stat stat_buf;
+	struct timeval times[2];
+
+	if (stat(path, &stat_buf) != 0)
+		return -1;
+	times[0].tv_sec = stat_buf.st_atime;
+	times[0].tv_usec = 0;
+	times[1].tv_sec = stat_buf.st_mtime - sec;
+	times[1].tv_usec = 0;
+	return utimes(path, times);
+}
+
+int
+main(int argc, char *argv[])
+{
+	hwdb_instance_t *instance = NULL, *instance2 = NULL;
+	char const *path = (argc > 1) ? argv[1] : NULL;
+	char *tmp_path = NULL, *yaml, *yaml2;
+	char defects_path[] = "/tmp/hwdb_cache-test.XXXXXX";
+	char *file_name = NULL;
+	char err_buf[256];
+	bitstr_t *hicanns = NULL, *fpgas = NULL;
+
+	if (hwdb_cache_init() != SLURM_SUCCESS) {
+		fail("cache init");
+		totals();
+		return failed;
+	}
+	TEST(hwdb_cache_init() != SLURM_SUCCESS, "second init rejected");
+
+	if (mkdtemp(defects_path)) {
+		note("Testing cached defects");
+
+		TEST(_defects_write(defects_path, 3, "# comment\nhicann 5\nfpga 2\n")
+		     == 0, "defects file written");
+		TEST(hwdb_cache_defects(defects_path, 3, &hicanns, &fpgas,
+					err_buf, sizeof(err_buf)) == SLURM_SUCCESS,
+		     "defects read");
+		TEST(bit_test(hicanns, 5) && bit_test(fpgas, 2) &&
+		     (bit_set_count(fpgas) == 1), "blacklisted components set");
+		FREE_NULL_BITMAP(hicanns);
+		FREE_NULL_BITMAP(fpgas);
+
+		TEST(hwdb_cache_defects(defects_path, 4, &hicanns, &fpgas,
+					err_buf, sizeof(err_buf)) == SLURM_SUCCESS,
+		     "missing defects file accepted");
+		TEST(!bit_set_count(hicanns) && !bit_set_count(fpgas),
+		     "nothing blacklisted without defects file");
+		FREE_NULL_BITMAP(hicanns);
+		FREE_NULL_BITMAP(fpgas);
+
+		/* Changes are only seen after a refresh */
+		_defects_write(defects_path, 3, "hicann 7\n");
+		xstrfmtcat(file_name, DEFECTS_FILE_FORMAT, defects_path, (size_t) 3);
+		_mtime_shift(file_name, 10);
+		hwdb_cache_defects(defects_path, 3, &hicanns, &fpgas, err_buf,
+				   sizeof(err_buf));
+		TEST(bit_test(hicanns, 5) && !bit_test(hicanns, 7),
+		     "previous defects served until refresh");
+		FREE_NULL_BITMAP(hicanns);
+		FREE_NULL_BITMAP(fpgas);
+		hwdb_cache_refresh();
+		hwdb_cache_defects(defects_path, 3, &hicanns, &fpgas, err_buf,
+				   sizeof(err_buf));
+		TEST(!bit_test(hicanns, 5) && bit_test(hicanns, 7) &&
+		     !bit_set_count(fpgas), "changed defects read by refresh");
+		FREE_NULL_BITMAP(hicanns);
+		FREE_NULL_BITMAP(fpgas);
+		unlink(file_name);
+		xfree(file_name);
+
+		_defects_write(defects_path, 5, "hicann 384\n");
+		TEST(hwdb_cache_defects(defects_path, 5, &hicanns, &fpgas,
+					err_buf, sizeof(err_buf)) == SLURM_ERROR,
+		     "invalid defects file rejected");
+		xstrfmtcat(file_name, DEFECTS_FILE_FORMAT, defects_path, (size_t) 5);
+		unlink(file_name);
+		xfree(file_name);
+		rmdir(defects_path);
+	}
+
+	if (hwdb_cache_acquire(path, &instance) != SLURM_SUCCESS) {
+		untested("hwdb %s not loadable", path ? path : "at default path");
+		hwdb_cache_fini();
+		totals();
+		return failed;
+	}
+
+	note("Testing cached hwdb");
+	{
+		TEST(hwdb_cache_acquire(path, &instance2) == SLURM_SUCCESS,
+		     "second acquire");
+		TEST(instance == instance2, "instance reused");
+		TEST(instance->refcnt == 3, "references counted");
+		hwdb_cache_hold(instance2);
+		TEST(instance->refcnt == 4, "reference added");
+		hwdb_cache_release(instance2);
+		hwdb_cache_release(instance2);
+		hwdb_cache_release(instance);
+		TEST(instance->refcnt == 1, "cache keeps its reference");
+	}
+
+	if (path && (tmp_path = _hwdb_copy(path))) {
+		note("Testing changed hwdb");
+
+		TEST(hwdb_cache_acquire(tmp_path, &instance) == SLURM_SUCCESS,
+		     "acquire copy");
+		yaml = hwdb_cache_hxcube_yaml(instance, 0);
+		TEST(_mtime_shift(tmp_path, 10) == 0, "copy changed");
+		TEST(hwdb_cache_acquire(tmp_path, &instance2) == SLURM_SUCCESS,
+		     "acquire changed copy");
+		TEST(instance == instance2,
+		     "previous version served until refresh");
+		hwdb_cache_release(instance2);
+
+		hwdb_cache_refresh();
+		TEST(hwdb_cache_acquire(tmp_path, &instance2) == SLURM_SUCCESS,
+		     "acquire refreshed copy");
+		TEST(instance != instance2, "changed copy parsed again");
+		TEST(instance->refcnt == 1, "old version kept while in use");
+		hwdb_cache_release(instance);
+
+		/* The yaml entries of the new version were read by the
+		 * refresh, lookups no longer touch the file */
+		unlink(tmp_path);
+		yaml2 = hwdb_cache_hxcube_yaml(instance2, 0);
+		TEST(!xstrcmp(yaml, yaml2), "hx cube entries served from cache");
+		xfree(yaml);
+		xfree(yaml2);
+
+		hwdb_cache_refresh();
+		TEST(hwdb_cache_acquire(tmp_path, &instance) == SLURM_SUCCESS,
+		     "acquire removed copy");
+		TEST(instance == instance2, "last version of removed copy kept");
+		hwdb_cache_release(instance);
+		hwdb_cache_release(instance2);
+		xfree(tmp_path);
+	}
+
+	hwdb_cache_fini();
+	totals();
+	return failed;
+}
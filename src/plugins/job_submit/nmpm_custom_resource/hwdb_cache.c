@@ -0,0 +1,758 @@
+/*****************************************************************************\
+ *  hwdb_cache.c - Process-wide cache of parsed hardware databases for the
+ *  job_submit/nmpm_custom_resource plugin
+ *
+ *  This plugin has been developed by staff and students
+ *  of Heidelberg University as part of the research carried out by the
+ *  Electronic Vision(s) group at the Kirchhoff-Institute for Physics.
+ *  The research is funded by Heidelberg University, the State of
+ *  Baden-Württemberg, the Seventh Framework Programme under grant agreements
+ *  no 604102 (HBP) as well as the Horizon 2020 Framework Programme under grant
+ *  agreement 720270 (HBP).
+\*****************************************************************************/
+
+#include <dirent.h>
+#include <errno.h>
+#include <pthread.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+#include <sys/stat.h>
+#include <sys/types.h>
+
+#include "hwdb4cpp/hwdb4c.h"
+#include "slurm/slurm.h"
+#include "slurm/slurm_errno.h"
+#include "src/common/slurm_xlator.h"
+#include "src/common/list.h"
+#include "src/common/log.h"
+#include "src/common/macros.h"
+#include "src/common/xmalloc.h"
+#include "src/common/xstring.h"
+
+#include "hwdb_cache.h"
+
+// cache entry of one hwdb path, path is NULL for the default hwdb
+typedef struct hwdb_cache_entry {
+	char* path;
+	hwdb_instance_t* instance;
+	time_t last_used;
+} hwdb_cache_entry_t;
+
+// yaml entries of one hx cube in the file of an hwdb instance
+typedef struct hxcube_yaml_entry {
+	size_t hxcube_id;
+	char* yaml;
+} hxcube_yaml_entry_t;
+
+// version of a cached hwdb, taken to check its file without holding the cache lock
+typedef struct hwdb_cache_check {
+	char* path; // "" for the default hwdb
+	time_t mtime;
+	ino_t inode;
+	time_t load_time;
+} hwdb_cache_check_t;
+
+// result of checking a defects path
+typedef struct defects_path_entry {
+	char* path;
+	int error; // errno of opening the path as directory, 0 if it is one
+	time_t check_time;
+} defects_path_entry_t;
+
+// blacklisted components of one wafer in a defects path
+typedef struct defects_cache_entry {
+	char* path;
+	size_t wafer_id;
+	bitstr_t* hicanns; // blacklisted HICANNs, including those of blacklisted FPGAs
+	bitstr_t* fpgas; // blacklisted FPGAs
+	time_t mtime; // mtime of the defects file when it was read, 0 if there is none
+	ino_t inode; // inode of the defects file when it was read, 0 if there is none
+	time_t last_used;
+} defects_cache_entry_t;
+
+// cached hwdbs, keyed by path
+static List hwdb_cache = NULL;
+static pthread_mutex_t hwdb_cache_mutex = PTHREAD_MUTEX_INITIALIZER;
+static pthread_cond_t hwdb_cache_cond = PTHREAD_COND_INITIALIZER;
+static pthread_t hwdb_cache_thread = 0;
+static bool hwdb_cache_shutdown = false;
+// recently checked defects paths, protected by hwdb_cache_mutex, expired entries are
+// dropped by the cache thread
+static List defects_path_cache = NULL;
+// blacklisted components per defects path and wafer, protected by hwdb_cache_mutex
+static List defects_cache = NULL;
+
+/* parses hwdb at path (default hwdb if path is NULL) into a new instance with refcnt 0
+ * returns SLURM_SUCCESS on success, SLURM_ERROR on failure */
+static int _hwdb_instance_load(char const* path, hwdb_instance_t** instance)
+{
+	struct stat stat_buf;
+	struct hwdb4c_database_t* handle = NULL;
+	char* load_path = NULL;
+	int retval = SLURM_SUCCESS;
+
+	if (path && (stat(path, &stat_buf) != 0)) {
+		debug("%s: stat of HWDB %s failed: %m", __func__, path);
+		return SLURM_ERROR;
+	}
+	if (hwdb4c_alloc_hwdb(&handle) != HWDB4C_SUCCESS) {
+		error("%s: HWDB alloc failed", __func__);
+		return SLURM_ERROR;
+	}
+	// hwdb4c takes a non-const path, NULL loads default hwdb
+	load_path = xstrdup(path);
+	if (hwdb4c_load_hwdb(handle, load_path) != HWDB4C_SUCCESS) {
+		debug("%s: HWDB load of %s failed", __func__, path ? path : "default path");
+		hwdb4c_free_hwdb(handle);
+		retval = SLURM_ERROR;
+		goto LOAD_CLEANUP;
+	}
+
+	*instance = xmalloc(sizeof(hwdb_instance_t));
+	(*instance)->handle = handle;
+	(*instance)->path = xstrdup(path);
+	(*instance)->mtime = path ? stat_buf.st_mtime : 0;
+	(*instance)->inode = path ? stat_buf.st_ino : 0;
+	(*instance)->load_time = time(NULL);
+	(*instance)->hxcube_yaml = list_create(NULL);
+	(*instance)->refcnt = 0;
+	debug("%s: parsed HWDB %s", __func__, path ? path : "at default path");
+
+LOAD_CLEANUP:
+	xfree(load_path);
+	return retval;
+}
+
+/* frees instance, its hwdb handle and its yaml entries */
+static void _hwdb_instance_free(hwdb_instance_t* instance)
+{
+	hxcube_yaml_entry_t* yaml_entry;
+
+	if (instance->handle) {
+		hwdb4c_free_hwdb(instance->handle);
+	}
+	while ((yaml_entry = list_pop(instance->hxcube_yaml))) {
+		xfree(yaml_entry->yaml);
+		xfree(yaml_entry);
+	}
+	FREE_NULL_LIST(instance->hxcube_yaml);
+	xfree(instance->path);
+	xfree(instance);
+}
+
+/* find yaml entry by hx cube id (for use by list_find_first) */
+static int _hxcube_yaml_find(void* x, void* key)
+{
+	hxcube_yaml_entry_t* yaml_entry = (hxcube_yaml_entry_t*) x;
+
+	return (yaml_entry->hxcube_id == *(size_t*) key);
+}
+
+/* reads the yaml entries of hx cube hxcube_id from the file of instance
+ * returns xmalloc'd entries, empty if the hwdb has none */
+static char* _hxcube_yaml_read(hwdb_instance_t* instance, size_t hxcube_id)
+{
+	char* path = xstrdup(instance->path);
+	char id_str[32];
+	char* yaml_string;
+	char* yaml;
+
+	snprintf(id_str, sizeof(id_str), "%zu", hxcube_id);
+	yaml_string = hwdb4c_get_yaml_entries(path, "hxcube_id", id_str);
+	yaml = xstrdup(yaml_string ? yaml_string : "");
+	free(yaml_string);
+	xfree(path);
+	return yaml;
+}
+
+/* adds yaml entries read for hxcube_id to instance unless another thread was faster
+ * hwdb_cache_mutex must be locked */
+static void _hxcube_yaml_store(hwdb_instance_t* instance, size_t hxcube_id, char* yaml)
+{
+	hxcube_yaml_entry_t* yaml_entry;
+
+	if (list_find_first(instance->hxcube_yaml, _hxcube_yaml_find, &hxcube_id)) {
+		xfree(yaml);
+		return;
+	}
+	yaml_entry = xmalloc(sizeof(hxcube_yaml_entry_t));
+	yaml_entry->hxcube_id = hxcube_id;
+	yaml_entry->yaml = yaml;
+	list_append(instance->hxcube_yaml, yaml_entry);
+}
+
+/* find cache entry by path, NULL path matches the default hwdb entry
+ * (for use by list_find_first) */
+static int _hwdb_cache_find(void* x, void* key)
+{
+	hwdb_cache_entry_t* entry = (hwdb_cache_entry_t*) x;
+	char const* path = (char const*) key;
+
+	if (!entry->path || !path) {
+		return (!entry->path && !path);
+	}
+	return (strcmp(entry->path, path) == 0);
+}
+
+/* checks if the file of a cached hwdb changed since it was parsed */
+static bool _hwdb_cache_check_stale(hwdb_cache_check_t* check, time_t now)
+{
+	struct stat stat_buf;
+
+	// file of default hwdb is not known, reparse it periodically instead
+	if (!check->path[0]) {
+		return (difftime(now, check->load_time) >= HWDB_CACHE_DEFAULT_MAX_AGE);
+	}
+	// vanished file, keep serving the last valid version until reload succeeds
+	if (stat(check->path, &stat_buf) != 0) {
+		return false;
+	}
+	return ((stat_buf.st_mtime != check->mtime) || (stat_buf.st_ino != check->inode));
+}
+
+/* make instance the current version of path in the cache, takes over reference
+ * hwdb_cache_mutex must be locked */
+static void _hwdb_cache_store(char const* path, hwdb_instance_t* instance, time_t now)
+{
+	hwdb_cache_entry_t* entry;
+
+	instance->refcnt++;
+	entry = list_find_first(hwdb_cache, _hwdb_cache_find, (void*) path);
+	if (entry) {
+		if (--entry->instance->refcnt == 0) {
+			_hwdb_instance_free(entry->instance);
+		}
+		entry->instance = instance;
+	} else {
+		entry = xmalloc(sizeof(hwdb_cache_entry_t));
+		entry->path = xstrdup(path);
+		entry->instance = instance;
+		entry->last_used = now;
+		list_append(hwdb_cache, entry);
+	}
+}
+
+/* reparses the hwdb at path, path "" is the default hwdb
+ * the yaml entries looked up in the previous version are read again before the new
+ * version replaces it, submissions keep using the previous version meanwhile */
+static void _hwdb_cache_reload(char const* path, time_t now)
+{
+	char const* load_path = path[0] ? path : NULL;
+	hwdb_cache_entry_t* entry;
+	hwdb_instance_t* loaded = NULL;
+	hxcube_yaml_entry_t* yaml_entry;
+	ListIterator iter;
+	size_t* hxcube_ids = NULL;
+	size_t hxcube_cnt = 0;
+	size_t counter;
+
+	if (_hwdb_instance_load(load_path, &loaded) != SLURM_SUCCESS) {
+		error("%s: reload of HWDB %s failed, keeping previous version", __func__, load_path ? load_path : "at default path");
+		// back off on default hwdb, custom ones are retried next poll
+		if (!load_path) {
+			slurm_mutex_lock(&hwdb_cache_mutex);
+			entry = list_find_first(hwdb_cache, _hwdb_cache_find, NULL);
+			if (entry) {
+				entry->instance->load_time = now;
+			}
+			slurm_mutex_unlock(&hwdb_cache_mutex);
+		}
+		return;
+	}
+
+	slurm_mutex_lock(&hwdb_cache_mutex);
+	entry = list_find_first(hwdb_cache, _hwdb_cache_find, (void*) load_path);
+	if (entry) {
+		hxcube_ids = xcalloc(list_count(entry->instance->hxcube_yaml) + 1, sizeof(size_t));
+		iter = list_iterator_create(entry->instance->hxcube_yaml);
+		while ((yaml_entry = list_next(iter))) {
+			hxcube_ids[hxcube_cnt++] = yaml_entry->hxcube_id;
+		}
+		list_iterator_destroy(iter);
+	}
+	slurm_mutex_unlock(&hwdb_cache_mutex);
+
+	// loaded is not visible to submissions yet, no lock needed
+	for (counter = 0; counter < hxcube_cnt; counter++) {
+		_hxcube_yaml_store(loaded, hxcube_ids[counter], _hxcube_yaml_read(loaded, hxcube_ids[counter]));
+	}
+	xfree(hxcube_ids);
+
+	slurm_mutex_lock(&hwdb_cache_mutex);
+	// skip if evicted meanwhile
+	if (list_find_first(hwdb_cache, _hwdb_cache_find, (void*) load_path)) {
+		_hwdb_cache_store(load_path, loaded, now);
+		info("%s: reloaded changed HWDB %s", __func__, load_path ? load_path : "at default path");
+	} else {
+		_hwdb_instance_free(loaded);
+	}
+	slurm_mutex_unlock(&hwdb_cache_mutex);
+}
+
+/* find defects path entry by path (for use by list_find_first) */
+static int _defects_path_find(void* x, void* key)
+{
+	defects_path_entry_t* entry = (defects_path_entry_t*) x;
+
+	return (strcmp(entry->path, (char const*) key) == 0);
+}
+
+/* reads the blacklisted components of wafer_id in defects path into new bitmaps of entry
+ * one component per line, "hicann <HICANNOnWafer>" or "fpga <FPGAOnWafer>", lines
+ * starting with # are ignored
+ * returns SLURM_SUCCESS on success, SLURM_ERROR with the reason in err_buf on failure */
+static int _defects_load(char const* path, size_t wafer_id, defects_cache_entry_t* entry, char* err_buf, size_t err_len)
+{
+	struct stat stat_buf;
+	char* file_name = NULL;
+	char line[128];
+	char component[50];
+	size_t id, hicann_id, fpga_id;
+	size_t line_num = 0;
+	FILE* fp = NULL;
+	int retval = SLURM_SUCCESS;
+
+	entry->hicanns = bit_alloc(NUM_HICANNS_ON_WAFER);
+	entry->fpgas = bit_alloc(NUM_FPGAS_ON_WAFER);
+	entry->mtime = 0;
+	entry->inode = 0;
+
+	xstrfmtcat(file_name, DEFECTS_FILE_FORMAT, path, wafer_id);
+	// no defects file, nothing blacklisted on this wafer
+	if (stat(file_name, &stat_buf) != 0) {
+		goto DEFECTS_CLEANUP;
+	}
+	if (!(fp = fopen(file_name, "r"))) {
+		snprintf(err_buf, err_len, "Opening defects file %s failed: %s", file_name, strerror(errno));
+		retval = SLURM_ERROR;
+		goto DEFECTS_CLEANUP;
+	}
+	entry->mtime = stat_buf.st_mtime;
+	entry->inode = stat_buf.st_ino;
+
+	while (fgets(line, sizeof(line), fp)) {
+		line_num++;
+		if ((sscanf(line, " %49s", component) != 1) || (component[0] == '#')) {
+			continue;
+		}
+		if (sscanf(line, " %49s %zu", component, &id) != 2) {
+			snprintf(err_buf, err_len, "Invalid line %zu in defects file %s", line_num, file_name);
+			retval = SLURM_ERROR;
+			break;
+		}
+		if ((strcmp(component, "hicann") == 0) && (id < NUM_HICANNS_ON_WAFER)) {
+			bit_set(entry->hicanns, id);
+		} else if ((strcmp(component, "fpga") == 0) && (id < NUM_FPGAS_ON_WAFER)) {
+			bit_set(entry->fpgas, id);
+			// HICANNs of a blacklisted FPGA can not be used either
+			for (hicann_id = 0; hicann_id < NUM_HICANNS_ON_WAFER; hicann_id++) {
+				if ((hwdb4c_HICANNOnWafer_toFPGAOnWafer(hicann_id, &fpga_id) == HWDB4C_SUCCESS) && (fpga_id == id)) {
+					bit_set(entry->hicanns, hicann_id);
+				}
+			}
+		} else {
+			snprintf(err_buf, err_len, "Invalid component %s %zu in line %zu of defects file %s", component, id, line_num, file_name);
+			retval = SLURM_ERROR;
+			break;
+		}
+	}
+	fclose(fp);
+	if (retval == SLURM_SUCCESS) {
+		debug("%s: read defects file %s", __func__, file_name);
+	}
+
+DEFECTS_CLEANUP:
+	if (retval != SLURM_SUCCESS) {
+		FREE_NULL_BITMAP(entry->hicanns);
+		FREE_NULL_BITMAP(entry->fpgas);
+	}
+	xfree(file_name);
+	return retval;
+}
+
+/* frees entry and its bitmaps */
+static void _defects_entry_free(defects_cache_entry_t* entry)
+{
+	FREE_NULL_BITMAP(entry->hicanns);
+	FREE_NULL_BITMAP(entry->fpgas);
+	xfree(entry->path);
+	xfree(entry);
+}
+
+/* find defects cache entry by path and wafer id of key (for use by list_find_first) */
+static int _defects_cache_find(void* x, void* key)
+{
+	defects_cache_entry_t* entry = (defects_cache_entry_t*) x;
+	defects_cache_entry_t* match = (defects_cache_entry_t*) key;
+
+	return ((entry->wafer_id == match->wafer_id) && (strcmp(entry->path, match->path) == 0));
+}
+
+/* checks if the defects file of a cached entry changed since it was read */
+static bool _defects_cache_check_stale(defects_cache_entry_t* check)
+{
+	struct stat stat_buf;
+	char* file_name = NULL;
+	bool stale;
+
+	xstrfmtcat(file_name, DEFECTS_FILE_FORMAT, check->path, check->wafer_id);
+	if (stat(file_name, &stat_buf) != 0) {
+		stale = (check->mtime != 0);
+	} else {
+		stale = ((stat_buf.st_mtime != check->mtime) || (stat_buf.st_ino != check->inode));
+	}
+	xfree(file_name);
+	return stale;
+}
+
+/* make loaded the current version of its path and wafer in the defects cache, takes
+ * over the bitmaps of loaded
+ * hwdb_cache_mutex must be locked */
+static void _defects_cache_store(defects_cache_entry_t* loaded, time_t now)
+{
+	defects_cache_entry_t* entry;
+
+	entry = list_find_first(defects_cache, _defects_cache_find, loaded);
+	if (!entry) {
+		entry = xmalloc(sizeof(defects_cache_entry_t));
+		entry->path = xstrdup(loaded->path);
+		entry->wafer_id = loaded->wafer_id;
+		entry->last_used = now;
+		list_append(defects_cache, entry);
+	}
+	FREE_NULL_BITMAP(entry->hicanns);
+	FREE_NULL_BITMAP(entry->fpgas);
+	entry->hicanns = loaded->hicanns;
+	entry->fpgas = loaded->fpgas;
+	entry->mtime = loaded->mtime;
+	entry->inode = loaded->inode;
+	loaded->hicanns = NULL;
+	loaded->fpgas = NULL;
+}
+
+/* rereads the defects file of check, the previous version is kept if that fails */
+static void _defects_cache_reload(defects_cache_entry_t* check, time_t now)
+{
+	char err_buf[256];
+
+	if (_defects_load(check->path, check->wafer_id, check, err_buf, sizeof(err_buf)) != SLURM_SUCCESS) {
+		error("%s: reload of defects of Wafer-Module %zu in %s failed, keeping previous version: %s", __func__, check->wafer_id, check->path, err_buf);
+		return;
+	}
+	slurm_mutex_lock(&hwdb_cache_mutex);
+	// skip if evicted meanwhile
+	if (list_find_first(defects_cache, _defects_cache_find, check)) {
+		_defects_cache_store(check, now);
+		info("%s: reloaded changed defects of Wafer-Module %zu in %s", __func__, check->wafer_id, check->path);
+	}
+	slurm_mutex_unlock(&hwdb_cache_mutex);
+}
+
+/* background thread which reparses changed hwdbs and evicts unused ones */
+static void* _hwdb_cache_agent(void* arg)
+{
+	struct timespec ts = {0, 0};
+
+	slurm_mutex_lock(&hwdb_cache_mutex);
+	while (!hwdb_cache_shutdown) {
+		ts.tv_sec = time(NULL) + HWDB_CACHE_POLL_INTERVAL;
+		slurm_cond_timedwait(&hwdb_cache_cond, &hwdb_cache_mutex, &ts);
+		if (hwdb_cache_shutdown) {
+			break;
+		}
+		slurm_mutex_unlock(&hwdb_cache_mutex);
+		hwdb_cache_refresh();
+		slurm_mutex_lock(&hwdb_cache_mutex);
+	}
+	slurm_mutex_unlock(&hwdb_cache_mutex);
+	return NULL;
+}
+
+extern int hwdb_cache_init(void)
+{
+	slurm_mutex_lock(&hwdb_cache_mutex);
+	if (hwdb_cache) {
+		slurm_mutex_unlock(&hwdb_cache_mutex);
+		return SLURM_ERROR;
+	}
+	hwdb_cache = list_create(NULL);
+	defects_path_cache = list_create(NULL);
+	defects_cache = list_create(NULL);
+	hwdb_cache_shutdown = false;
+	slurm_thread_create(&hwdb_cache_thread, _hwdb_cache_agent, NULL);
+	slurm_mutex_unlock(&hwdb_cache_mutex);
+	return SLURM_SUCCESS;
+}
+
+extern void hwdb_cache_fini(void)
+{
+	hwdb_cache_entry_t* entry;
+	defects_path_entry_t* defects_entry;
+	defects_cache_entry_t* defects_cache_entry;
+
+	slurm_mutex_lock(&hwdb_cache_mutex);
+	hwdb_cache_shutdown = true;
+	slurm_cond_broadcast(&hwdb_cache_cond);
+	slurm_mutex_unlock(&hwdb_cache_mutex);
+	if (hwdb_cache_thread) {
+		pthread_join(hwdb_cache_thread, NULL);
+		hwdb_cache_thread = 0;
+	}
+
+	slurm_mutex_lock(&hwdb_cache_mutex);
+	if (hwdb_cache) {
+		while ((entry = list_pop(hwdb_cache))) {
+			if (--entry->instance->refcnt == 0) {
+				_hwdb_instance_free(entry->instance);
+			}
+			xfree(entry->path);
+			xfree(entry);
+		}
+		FREE_NULL_LIST(hwdb_cache);
+	}
+	if (defects_path_cache) {
+		while ((defects_entry = list_pop(defects_path_cache))) {
+			xfree(defects_entry->path);
+			xfree(defects_entry);
+		}
+		FREE_NULL_LIST(defects_path_cache);
+	}
+	if (defects_cache) {
+		while ((defects_cache_entry = list_pop(defects_cache))) {
+			_defects_entry_free(defects_cache_entry);
+		}
+		FREE_NULL_LIST(defects_cache);
+	}
+	slurm_mutex_unlock(&hwdb_cache_mutex);
+}
+
+extern int hwdb_cache_acquire(char const* path, hwdb_instance_t** instance)
+{
+	hwdb_cache_entry_t* entry;
+	hwdb_instance_t* loaded = NULL;
+	time_t now = time(NULL);
+
+	// cached versions are served as they are, changes of the file are picked up by
+	// the background thread, the submit path neither stats nor parses
+	slurm_mutex_lock(&hwdb_cache_mutex);
+	entry = list_find_first(hwdb_cache, _hwdb_cache_find, (void*) path);
+	if (entry) {
+		entry->last_used = now;
+		entry->instance->refcnt++;
+		*instance = entry->instance;
+		slurm_mutex_unlock(&hwdb_cache_mutex);
+		return SLURM_SUCCESS;
+	}
+	slurm_mutex_unlock(&hwdb_cache_mutex);
+
+	// first use of this hwdb, parse outside of the cache lock
+	if (_hwdb_instance_load(path, &loaded) != SLURM_SUCCESS) {
+		return SLURM_ERROR;
+	}
+
+	slurm_mutex_lock(&hwdb_cache_mutex);
+	entry = list_find_first(hwdb_cache, _hwdb_cache_find, (void*) path);
+	if (entry) {
+		// parsed concurrently, use the cached version
+		_hwdb_instance_free(loaded);
+		loaded = entry->instance;
+	} else {
+		_hwdb_cache_store(path, loaded, now);
+		entry = list_find_first(hwdb_cache, _hwdb_cache_find, (void*) path);
+	}
+	entry->last_used = now;
+	loaded->refcnt++;
+	*instance = loaded;
+	slurm_mutex_unlock(&hwdb_cache_mutex);
+	return SLURM_SUCCESS;
+}
+
+extern void hwdb_cache_hold(hwdb_instance_t* instance)
+{
+	slurm_mutex_lock(&hwdb_cache_mutex);
+	instance->refcnt++;
+	slurm_mutex_unlock(&hwdb_cache_mutex);
+}
+
+extern void hwdb_cache_release(hwdb_instance_t* instance)
+{
+	slurm_mutex_lock(&hwdb_cache_mutex);
+	if (--instance->refcnt == 0) {
+		_hwdb_instance_free(instance);
+	}
+	slurm_mutex_unlock(&hwdb_cache_mutex);
+}
+
+extern char* hwdb_cache_hxcube_yaml(hwdb_instance_t* instance, size_t hxcube_id)
+{
+	hxcube_yaml_entry_t* yaml_entry;
+	char* yaml;
+
+	slurm_mutex_lock(&hwdb_cache_mutex);
+	yaml_entry = list_find_first(instance->hxcube_yaml, _hxcube_yaml_find, &hxcube_id);
+	if (yaml_entry) {
+		yaml = xstrdup(yaml_entry->yaml);
+		slurm_mutex_unlock(&hwdb_cache_mutex);
+		return yaml;
+	}
+	slurm_mutex_unlock(&hwdb_cache_mutex);
+
+	yaml = _hxcube_yaml_read(instance, hxcube_id);
+	slurm_mutex_lock(&hwdb_cache_mutex);
+	_hxcube_yaml_store(instance, hxcube_id, xstrdup(yaml));
+	slurm_mutex_unlock(&hwdb_cache_mutex);
+	return yaml;
+}
+
+extern void hwdb_cache_refresh(void)
+{
+	ListIterator iter;
+	hwdb_cache_entry_t* entry;
+	defects_path_entry_t* defects_entry;
+	defects_cache_entry_t* defects_cache_entry;
+	defects_cache_entry_t* defects_check;
+	hwdb_cache_check_t* check;
+	List checks = list_create(NULL);
+	List defects_checks = list_create(NULL);
+	time_t now = time(NULL);
+
+	// drop custom hwdbs nobody used for a while, note the version of the others
+	slurm_mutex_lock(&hwdb_cache_mutex);
+	iter = list_iterator_create(hwdb_cache);
+	while ((entry = list_next(iter))) {
+		if (entry->path && (difftime(now, entry->last_used) >= HWDB_CACHE_MAX_IDLE)) {
+			debug("%s: evicting unused HWDB %s", __func__, entry->path);
+			list_remove(iter);
+			if (--entry->instance->refcnt == 0) {
+				_hwdb_instance_free(entry->instance);
+			}
+			xfree(entry->path);
+			xfree(entry);
+			continue;
+		}
+		check = xmalloc(sizeof(hwdb_cache_check_t));
+		// list of NULL pointers is not possible, mark default hwdb with ""
+		check->path = xstrdup(entry->path ? entry->path : "");
+		check->mtime = entry->instance->mtime;
+		check->inode = entry->instance->inode;
+		check->load_time = entry->instance->load_time;
+		list_append(checks, check);
+	}
+	list_iterator_destroy(iter);
+
+	// expired defects path checks are redone on next use anyway
+	iter = list_iterator_create(defects_path_cache);
+	while ((defects_entry = list_next(iter))) {
+		if (difftime(now, defects_entry->check_time) >= DEFECTS_PATH_CHECK_MAX_AGE) {
+			list_remove(iter);
+			xfree(defects_entry->path);
+			xfree(defects_entry);
+		}
+	}
+	list_iterator_destroy(iter);
+
+	// same for the defects of all wafers
+	iter = list_iterator_create(defects_cache);
+	while ((defects_cache_entry = list_next(iter))) {
+		if (difftime(now, defects_cache_entry->last_used) >= HWDB_CACHE_MAX_IDLE) {
+			list_remove(iter);
+			_defects_entry_free(defects_cache_entry);
+			continue;
+		}
+		defects_check = xmalloc(sizeof(defects_cache_entry_t));
+		defects_check->path = xstrdup(defects_cache_entry->path);
+		defects_check->wafer_id = defects_cache_entry->wafer_id;
+		defects_check->mtime = defects_cache_entry->mtime;
+		defects_check->inode = defects_cache_entry->inode;
+		list_append(defects_checks, defects_check);
+	}
+	list_iterator_destroy(iter);
+	slurm_mutex_unlock(&hwdb_cache_mutex);
+
+	// reread without holding the lock, submissions keep using the old version
+	while ((defects_check = list_pop(defects_checks))) {
+		if (_defects_cache_check_stale(defects_check)) {
+			_defects_cache_reload(defects_check, now);
+		}
+		_defects_entry_free(defects_check);
+	}
+	FREE_NULL_LIST(defects_checks);
+
+	// stat and reparse without holding the lock, submissions keep using the old version
+	while ((check = list_pop(checks))) {
+		if (_hwdb_cache_check_stale(check, now)) {
+			_hwdb_cache_reload(check->path, now);
+		}
+		xfree(check->path);
+		xfree(check);
+	}
+	FREE_NULL_LIST(checks);
+}
+
+extern int hwdb_cache_defects_path_check(char const* path)
+{
+	defects_path_entry_t* entry;
+	DIR* dir;
+	int error = 0;
+	time_t now = time(NULL);
+
+	slurm_mutex_lock(&hwdb_cache_mutex);
+	entry = list_find_first(defects_path_cache, _defects_path_find, (void*) path);
+	if (entry && (difftime(now, entry->check_time) < DEFECTS_PATH_CHECK_MAX_AGE)) {
+		error = entry->error;
+		slurm_mutex_unlock(&hwdb_cache_mutex);
+		return error;
+	}
+	slurm_mutex_unlock(&hwdb_cache_mutex);
+
+	dir = opendir(path);
+	if (dir) {
+		closedir(dir);
+	} else {
+		error = errno;
+	}
+
+	slurm_mutex_lock(&hwdb_cache_mutex);
+	entry = list_find_first(defects_path_cache, _defects_path_find, (void*) path);
+	if (!entry) {
+		entry = xmalloc(sizeof(defects_path_entry_t));
+		entry->path = xstrdup(path);
+		list_append(defects_path_cache, entry);
+	}
+	entry->error = error;
+	entry->check_time = now;
+	slurm_mutex_unlock(&hwdb_cache_mutex);
+	return error;
+}
+
+extern int hwdb_cache_defects(char const* path, size_t wafer_id, bitstr_t** hicanns, bitstr_t** fpgas, char* err_buf, size_t err_len)
+{
+	defects_cache_entry_t key = { .path = (char*) path, .wafer_id = wafer_id };
+	defects_cache_entry_t* entry;
+	time_t now = time(NULL);
+
+	slurm_mutex_lock(&hwdb_cache_mutex);
+	entry = list_find_first(defects_cache, _defects_cache_find, &key);
+	if (!entry) {
+		// first use of this defects file, read outside of the cache lock
+		slurm_mutex_unlock(&hwdb_cache_mutex);
+		if (_defects_load(path, wafer_id, &key, err_buf, err_len) != SLURM_SUCCESS) {
+			return SLURM_ERROR;
+		}
+		slurm_mutex_lock(&hwdb_cache_mutex);
+		// keep a version stored concurrently, it is no older than ours
+		if (!list_find_first(defects_cache, _defects_cache_find, &key)) {
+			_defects_cache_store(&key, now);
+		}
+		FREE_NULL_BITMAP(key.hicanns);
+		FREE_NULL_BITMAP(key.fpgas);
+		entry = list_find_first(defects_cache, _defects_cache_find, &key);
+	}
+	entry->last_used = now;
+	*hicanns = bit_copy(entry->hicanns);
+	*fpgas = bit_copy(entry->fpgas);
+	slurm_mutex_unlock(&hwdb_cache_mutex);
+	return SLURM_SUCCESS;
+}
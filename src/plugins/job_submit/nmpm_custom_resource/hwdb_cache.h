@@ -0,0 +1,86 @@
+/*****************************************************************************\
+ *  hwdb_cache.h - Process-wide cache of parsed hardware databases for the
+ *  job_submit/nmpm_custom_resource plugin
+ *
+ *  This plugin has been developed by staff and students
+ *  of Heidelberg University as part of the research carried out by the
+ *  Electronic Vision(s) group at the Kirchhoff-Institute for Physics.
+ *  The research is funded by Heidelberg University, the State of
+ *  Baden-Württemberg, the Seventh Framework Programme under grant agreements
+ *  no 604102 (HBP) as well as the Horizon 2020 Framework Programme under grant
+ *  agreement 720270 (HBP).
+\*****************************************************************************/
+
+#ifndef _HWDB_CACHE_H
+#define _HWDB_CACHE_H
+
+#include <stddef.h>
+#include <time.h>
+#include <sys/types.h>
+
+#include "src/common/bitstring.h"
+#include "src/common/list.h"
+
+#define NUM_FPGAS_ON_WAFER 48
+#define NUM_HICANNS_ON_WAFER 384
+
+#define HWDB_CACHE_POLL_INTERVAL 10 //seconds between checks of cached hwdbs for changes
+#define HWDB_CACHE_DEFAULT_MAX_AGE 300 //seconds after which the default hwdb is reparsed
+#define HWDB_CACHE_MAX_IDLE 3600 //seconds after which unused custom hwdbs are evicted
+#define DEFECTS_PATH_CHECK_MAX_AGE 60 //seconds for which the check of a defects path is reused
+#define DEFECTS_FILE_FORMAT "%s/wafer_%zu.defects" //blacklisted components of one wafer in a defects path
+
+// parsed hardware database, shared between the cache and running submissions
+typedef struct hwdb_instance {
+	struct hwdb4c_database_t* handle;
+	char* path; // path of the yaml file, NULL for default hwdb
+	time_t mtime; // mtime of the yaml file when it was parsed, 0 for default hwdb
+	ino_t inode; // inode of the yaml file when it was parsed, 0 for default hwdb
+	time_t load_time;
+	List hxcube_yaml; // yaml entries of hx cubes read from the file of this version
+	int refcnt;
+} hwdb_instance_t;
+
+/* creates the cache and starts the background thread refreshing it
+ * returns SLURM_SUCCESS on success, SLURM_ERROR if the cache exists already */
+extern int hwdb_cache_init(void);
+
+/* stops the background thread and frees the cache, instances still referenced
+ * are freed by their last hwdb_cache_release */
+extern void hwdb_cache_fini(void);
+
+/* returns a referenced instance of the hwdb at path (default hwdb if path is NULL)
+ * the hwdb is only parsed if it is not cached yet, changed files are reparsed by
+ * the background thread which serves the previous version meanwhile
+ * instance has to be released with hwdb_cache_release
+ * returns SLURM_SUCCESS on success, SLURM_ERROR if the hwdb can not be parsed */
+extern int hwdb_cache_acquire(char const* path, hwdb_instance_t** instance);
+
+/* adds a reference to an acquired instance */
+extern void hwdb_cache_hold(hwdb_instance_t* instance);
+
+/* drops reference to instance, frees it if it was replaced in or evicted from the cache */
+extern void hwdb_cache_release(hwdb_instance_t* instance);
+
+/* returns xmalloc'd yaml entries of hx cube hxcube_id in the file instance was parsed
+ * from, the file is read on the first lookup of an id only, reloads of the hwdb read
+ * the ids looked up in the previous version again */
+extern char* hwdb_cache_hxcube_yaml(hwdb_instance_t* instance, size_t hxcube_id);
+
+/* reparses changed hwdbs and defects files and evicts unused ones, as done by the
+ * background thread every HWDB_CACHE_POLL_INTERVAL seconds */
+extern void hwdb_cache_refresh(void);
+
+/* returns the errno of opening path as directory, 0 if it is one
+ * a result is reused for DEFECTS_PATH_CHECK_MAX_AGE seconds */
+extern int hwdb_cache_defects_path_check(char const* path);
+
+/* copies the blacklisted HICANNs and FPGAs of wafer_id in defects path, HICANNs of a
+ * blacklisted FPGA are blacklisted as well, a missing defects file blacklists nothing
+ * the defects file is only read on first use, changes are picked up by the background
+ * thread which serves the previous version meanwhile
+ * hicanns and fpgas have to be freed by the caller
+ * returns SLURM_SUCCESS on success, SLURM_ERROR with the reason in err_buf of size err_len */
+extern int hwdb_cache_defects(char const* path, size_t wafer_id, bitstr_t** hicanns, bitstr_t** fpgas, char* err_buf, size_t err_len);
+
+#endif /* !_HWDB_CACHE_H */
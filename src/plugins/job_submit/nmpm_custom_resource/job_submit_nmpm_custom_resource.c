@@ -11,6 +11,7 @@
  *  agreement 720270 (HBP).
 \*****************************************************************************/
 
+#include <ctype.h>
 #include <dirent.h>
 #include <inttypes.h>
 #include <limits.h>
@@ -25,12 +26,15 @@
 #include "slurm/slurm_errno.h"
 #include "slurm/vision_defines.h"
 #include "src/common/slurm_xlator.h"
+#include "src/common/slurm_topology.h"
+#include "src/slurmctld/job_submit.h"
+#include "src/slurmctld/licenses.h"
 #include "src/slurmctld/slurmctld.h"
 
-#define SPANK_OPT_PREFIX "_SLURM_SPANK_OPTION_wafer_res_opts_"
+#include "hwdb_cache.h"
+
+#define SPANK_OPT_PLUGIN "wafer_res_opts"
 
-#define NUM_FPGAS_ON_WAFER 48
-#define NUM_HICANNS_ON_WAFER 384
 #define MAX_ADCS_PER_WAFER 12
 #define NUM_TRIGGER_PER_WAFER 12
 #define NUM_ANANAS_PER_WAFER 2
@@ -67,6 +71,8 @@ typedef struct wafer_res {
 	bool active_trigger[NUM_TRIGGER_PER_WAFER];
 	bool active_ananas[NUM_ANANAS_PER_WAFER];
 	bool active_hicann_neighbor[NUM_HICANNS_ON_WAFER];
+	bool defect_hicanns[NUM_HICANNS_ON_WAFER];
+	bool defect_fpgas[NUM_FPGAS_ON_WAFER];
 	size_t num_active_adcs;
 } wafer_res_t;
 
@@ -83,7 +89,7 @@ typedef struct option_index {
 } option_index_t;
 
 //global array of valid options
-#define NUM_OPTIONS 20
+#define NUM_OPTIONS 21
 // options that are only valid if single wafer option is given
 #define WMOD_DEPENDENT_MIN_INDEX 4
 #define WMOD_DEPENDENT_MAX_INDEX 11
@@ -107,13 +113,25 @@ static const option_index_t custom_res_options[NUM_OPTIONS] = {
 	{ "reticle_of_hicann_without_aout", 11},
 	{ "skip_hicann_init",               12},
 	{ "force_hicann_init",              13},
-	{ "defects_path",                   14}
+	{ "defects_path",                   14},
+	{ "hicann_count",                   15}
 };
 
-// global handle of hwdb
+// hwdb resolved once for all jobs of a batch submission
+typedef struct batch_hwdb {
+	char* path;
+	hwdb_instance_t* instance;
+} batch_hwdb_t;
+
+// handle of hwdb used by the submission currently processed
 static struct hwdb4c_database_t* hwdb_handle = NULL;
+// hwdbs resolved in the current batch submission, each entry holds one reference
+// on its instance, NULL outside of batch submissions
+static List batch_hwdbs = NULL;
 // global string to hold error message for slurm
 static char function_error_msg[MAX_ERROR_LENGTH] = "";
+// lookup table of the names in custom_res_options, built once in init
+static job_submit_spank_table_t* spank_option_table = NULL;
 
 enum analog_out_mode {ONLY_AOUT0, ONLY_AOUT1, BOTH_AOUT};
 
@@ -163,6 +181,17 @@ static int _add_fpga_of_hicann(size_t hicann_id, int aout, wafer_res_t* allocate
  * if aout is > -1 _add_analog will be called */
 static int _add_hicann(size_t hicann_id, int aout, wafer_res_t* allocated_module);
 
+/* resets allocated_module to no resources of wafer_id */
+static void _init_module(size_t wafer_id, wafer_res_t* allocated_module);
+
+/* chooses a wafer and a compact set of hicann_count HICANNs on it which are not blocked by
+ * FPGAs in use or held by reservations other than the job's one, using the wafer topology
+ * plugin, and adds them to allocated_module */
+static int _add_hicanns_on_any_wafer(size_t hicann_count, char const* defects_path, char* reservation, wafer_res_t* allocated_module);
+
+/* marks the components blacklisted in defects path in allocated_module */
+static int _defects_apply(char const* path, wafer_res_t* allocated_module);
+
 /* checks if FPGA and either ADC based or ananas based readout are in hwdb and adds licenses accordingly
  * valid aout values are 0/1 to get one of the two corresponding ADCs or 2 for both
  * in case of ananas aout is ignored*/
@@ -182,13 +211,43 @@ static int _allocate_neighbor(size_t hicann_id, wafer_res_t *allocated_module, i
 /* Convert give id with provided to_slurm_license conversion function to license string and append to env_string. */
 static int _append_slurm_license(size_t id, int (*to_slurm_license)(size_t, char**), char *env_string);
 
+/* Returns xmalloc'd copy of the comma separated license string in which wafer component licenses
+ * (WxxFyy, WxxTyy, ...) are merged into license group range form (WxxF[0-3,7]), others are kept as is */
+static char* _compact_licenses(char const* licenses);
+
+/* like hwdb_cache_acquire, but during a batch submission each hwdb is resolved only once
+ * for all jobs of the batch */
+static int _hwdb_acquire(char const* path, hwdb_instance_t** instance);
+
+/* returns true if the TRES string of a job requests the wafer GRES (gres/wafer plugin) */
+static bool _wafer_gres_requested(char const* tres);
+
 /***********************\
 * function definitions *
 \***********************/
 
 //slurm required functions
-int init (void) {return SLURM_SUCCESS;}
-void fini (void) {}
+int init (void)
+{
+	char const* option_names[NUM_OPTIONS];
+	size_t optioncounter;
+
+	if (hwdb_cache_init() != SLURM_SUCCESS) {
+		return SLURM_ERROR;
+	}
+	for (optioncounter = 0; optioncounter < NUM_OPTIONS; optioncounter++) {
+		option_names[optioncounter] = custom_res_options[optioncounter].option_name;
+	}
+	spank_option_table = job_submit_spank_table_create(SPANK_OPT_PLUGIN, option_names, NUM_OPTIONS);
+	return SLURM_SUCCESS;
+}
+
+void fini (void)
+{
+	hwdb_cache_fini();
+	job_submit_spank_table_destroy(spank_option_table);
+	spank_option_table = NULL;
+}
 
 //main plugin function
 extern int job_submit(struct job_descriptor *job_desc, uint32_t submit_uid, char **err_msg)
@@ -200,6 +259,7 @@ extern int job_submit(struct job_descriptor *job_desc, uint32_t submit_uid, char
 	size_t num_allocated_modules = 0; //track number of modules, used as index for allocated_modules
 	char my_errmsg[MAX_ERROR_LENGTH]; //string for temporary error message
 	char* hwdb_path = NULL;
+	hwdb_instance_t* hwdb_instance = NULL;
 	char* defects_path = NULL;
 	bool zero_res_args = true;
 	bool wmod_only_hw_option = true;
@@ -210,6 +270,7 @@ extern int job_submit(struct job_descriptor *job_desc, uint32_t submit_uid, char
 	size_t counter;
 	size_t modulecounter;
 	char* slurm_licenses_string = NULL;
+	char* slurm_compact_licenses_string = NULL;
 	char* slurm_licenses_environment_string = NULL;
 	char* slurm_neighbor_hicanns_environment_string = NULL;
 	char* slurm_neighbor_licenses_raw_string = NULL;
@@ -246,6 +307,16 @@ extern int job_submit(struct job_descriptor *job_desc, uint32_t submit_uid, char
 		goto CLEANUP;
 	}
 
+	// wafer components are allocated as licenses here, the wafer GRES tracks them separately
+	if (_wafer_gres_requested(job_desc->tres_per_job) ||
+	    _wafer_gres_requested(job_desc->tres_per_node) ||
+	    _wafer_gres_requested(job_desc->tres_per_socket) ||
+	    _wafer_gres_requested(job_desc->tres_per_task)) {
+		snprintf(my_errmsg, MAX_ERROR_LENGTH, "Wafer GRES can not be combined with wafer module options");
+		retval = ESLURM_NOT_SUPPORTED;
+		goto CLEANUP;
+	}
+
 	//check if more modules are tried to be allocated than allowed
 	if (parsed_options[_option_lookup("wmod")].num_arguments > MAX_ALLOCATED_MODULES) {
 		snprintf(my_errmsg, MAX_ERROR_LENGTH,
@@ -263,12 +334,7 @@ extern int job_submit(struct job_descriptor *job_desc, uint32_t submit_uid, char
 		}
 	}
 
-	// alloc hwdb struct and load hwdb with either given or default path
-	if (hwdb4c_alloc_hwdb(&hwdb_handle) != HWDB4C_SUCCESS) {
-		snprintf(my_errmsg, MAX_ERROR_LENGTH, "HWDB alloc failed!");
-		retval = SLURM_ERROR;
-		goto CLEANUP;
-	}
+	// get hwdb with either given or default path from cache
 	if (parsed_options[_option_lookup("hwdb_path")].num_arguments == 1) {
 		hwdb_path = parsed_options[_option_lookup("hwdb_path")].arguments[0];
 	} else if (parsed_options[_option_lookup("hwdb_path")].num_arguments > 1) {
@@ -276,11 +342,12 @@ extern int job_submit(struct job_descriptor *job_desc, uint32_t submit_uid, char
 		retval = SLURM_ERROR;
 		goto CLEANUP;
 	}
-	if (hwdb4c_load_hwdb(hwdb_handle, hwdb_path) != HWDB4C_SUCCESS) {
+	if (_hwdb_acquire(hwdb_path, &hwdb_instance) != NMPM_PLUGIN_SUCCESS) {
 		snprintf(my_errmsg, MAX_ERROR_LENGTH, "HWDB load failed, maybe wrong path?");
 		retval = SLURM_ERROR;
 		goto CLEANUP;
 	}
+	hwdb_handle = hwdb_instance->handle;
 
 	if (parsed_options[_option_lookup("skip_master_alloc")].num_arguments == 1) {
 		if (strcmp(parsed_options[_option_lookup("skip_master_alloc")].arguments[0], NMPM_MAGIC_BINARY_OPTION) != 0) {
@@ -320,11 +387,9 @@ extern int job_submit(struct job_descriptor *job_desc, uint32_t submit_uid, char
 
 	if (parsed_options[_option_lookup("defects_path")].num_arguments == 1) {
 		defects_path = parsed_options[_option_lookup("defects_path")].arguments[0];
-		DIR* dir = opendir(defects_path);
-		if (dir) {
-		    closedir(dir);
-		} else {
-			switch(errno) {
+		int defects_path_error = hwdb_cache_defects_path_check(defects_path);
+		if (defects_path_error) {
+			switch(defects_path_error) {
 				case ENOENT: snprintf(my_errmsg, MAX_ERROR_LENGTH, "Defects path \"%s\" does not exist", parsed_options[_option_lookup("defects_path")].arguments[0]);
 				             retval = SLURM_ERROR;
 				             goto CLEANUP;
@@ -378,23 +443,40 @@ extern int job_submit(struct job_descriptor *job_desc, uint32_t submit_uid, char
 			}
 		}
 		// initialize new module entry
-		allocated_modules[num_allocated_modules].wafer_id = wafer_id;
-		allocated_modules[num_allocated_modules].num_active_adcs = 0;
-		for (counter = 0; counter < NUM_FPGAS_ON_WAFER; counter++) {
-			allocated_modules[num_allocated_modules].active_fpgas[counter] = false;
-			allocated_modules[num_allocated_modules].active_fpga_neighbor[counter] = false;
+		_init_module(wafer_id, &allocated_modules[num_allocated_modules]);
+		if (defects_path && _defects_apply(defects_path, &allocated_modules[num_allocated_modules]) != NMPM_PLUGIN_SUCCESS) {
+			snprintf(my_errmsg, MAX_ERROR_LENGTH, "Loading defects of Wafer-Module %zu failed: %s", wafer_id, function_error_msg);
+			retval = SLURM_ERROR;
+			goto CLEANUP;
 		}
-		for (counter = 0; counter < NUM_HICANNS_ON_WAFER; counter++) {
-			allocated_modules[num_allocated_modules].active_hicanns[counter] = false;
-			allocated_modules[num_allocated_modules].active_hicann_neighbor[counter] = false;
+		num_allocated_modules++;
+	}
+
+	// place requested number of HICANNs on any wafer instead of explicit IDs
+	if (parsed_options[_option_lookup("hicann_count")].num_arguments == 1) {
+		size_t hicann_count;
+		if (num_allocated_modules > 0 || !wmod_only_hw_option) {
+			snprintf(my_errmsg, MAX_ERROR_LENGTH, "hicann_count can not be combined with wafer or other resource options");
+			retval = SLURM_ERROR;
+			goto CLEANUP;
 		}
-		for (counter = 0; counter < NUM_TRIGGER_PER_WAFER; counter++) {
-			allocated_modules[num_allocated_modules].active_trigger[counter] = false;
+		if (_str2ul(parsed_options[_option_lookup("hicann_count")].arguments[0], &hicann_count) != NMPM_PLUGIN_SUCCESS || hicann_count == 0) {
+			snprintf(my_errmsg, MAX_ERROR_LENGTH, "Invalid hicann_count argument %s", parsed_options[_option_lookup("hicann_count")].arguments[0]);
+			retval = ESLURM_INVALID_LICENSES;
+			goto CLEANUP;
 		}
-		for (counter = 0; counter < NUM_ANANAS_PER_WAFER; counter++) {
-			allocated_modules[num_allocated_modules].active_ananas[counter] = false;
+		if (_add_hicanns_on_any_wafer(hicann_count, defects_path, job_desc->reservation, &allocated_modules[0]) != NMPM_PLUGIN_SUCCESS) {
+			snprintf(my_errmsg, MAX_ERROR_LENGTH, "Adding %zu HICANNs on any wafer failed: %s", hicann_count, function_error_msg);
+			retval = ESLURM_INVALID_LICENSES;
+			goto CLEANUP;
 		}
-		num_allocated_modules++;
+		num_allocated_modules = 1;
+		// HICANNs are set, do not add whole module below
+		wmod_only_hw_option = false;
+	} else if (parsed_options[_option_lookup("hicann_count")].num_arguments > 1) {
+		snprintf(my_errmsg, MAX_ERROR_LENGTH, "multiple hicann_count arguments given!");
+		retval = SLURM_ERROR;
+		goto CLEANUP;
 	}
 
 	if (num_allocated_modules > 1 && !wmod_only_hw_option) {
@@ -527,7 +609,8 @@ extern int job_submit(struct job_descriptor *job_desc, uint32_t submit_uid, char
 					retval = ESLURM_INVALID_LICENSES;
 					goto CLEANUP;
 				}
-				if (has_fpga_entry) {
+				// blacklisted FPGAs are left out of whole modules
+				if (has_fpga_entry && !allocated_modules[modulecounter].defect_fpgas[fpgacounter]) {
 					//check for both possible adcs
 					bool has_adc0_entry, has_adc1_entry;
 					if (hwdb4c_has_adc_entry(hwdb_handle, allocated_modules[modulecounter].wafer_id * NUM_FPGAS_ON_WAFER + fpgacounter, 0, &has_adc0_entry) != HWDB4C_SUCCESS) {
@@ -648,12 +731,10 @@ extern int job_submit(struct job_descriptor *job_desc, uint32_t submit_uid, char
 		size_t ananascounter = 0;
 		size_t const hx_cube_id_min = 60;
 		if (allocated_modules[modulecounter].wafer_id >= hx_cube_id_min) {
-			char id_str[50];
-			sprintf(id_str, "%ld", allocated_modules[modulecounter].wafer_id - hx_cube_id_min);
-			char* yaml_string = hwdb4c_get_yaml_entries(hwdb_path, "hxcube_id", id_str);
-			xrealloc(hwdb_yaml_environment_string, strlen(hwdb_yaml_environment_string) +  strlen(yaml_string) + 1);
-			strcat(hwdb_yaml_environment_string, yaml_string);
-			free(yaml_string);
+			// read from the hwdb file once per parsed version, not per submission
+			char* yaml_string = hwdb_cache_hxcube_yaml(hwdb_instance, allocated_modules[modulecounter].wafer_id - hx_cube_id_min);
+			xstrcat(hwdb_yaml_environment_string, yaml_string);
+			xfree(yaml_string);
 		}
 		for (hicanncounter = 0; hicanncounter < NUM_HICANNS_ON_WAFER; hicanncounter++) {
 			if (allocated_modules[modulecounter].active_hicanns[hicanncounter]) {
@@ -793,11 +874,12 @@ extern int job_submit(struct job_descriptor *job_desc, uint32_t submit_uid, char
 	job_desc->env_size += 7;
 
 	//set slurm licenses (including neighbor licenses, those will be removed in prolog script)
+	//in range form, so that wafer licenses are handled as license groups by slurmctld
+	slurm_compact_licenses_string = _compact_licenses(slurm_licenses_string);
 	if(job_desc->licenses) {
-		xrealloc(job_desc->licenses,strlen(slurm_licenses_string) + strlen(job_desc->licenses) + 1);
-		xstrcat(job_desc->licenses, slurm_licenses_string);
+		xstrcat(job_desc->licenses, slurm_compact_licenses_string);
 	} else {
-		job_desc->licenses = xstrdup(slurm_licenses_string);
+		job_desc->licenses = xstrdup(slurm_compact_licenses_string);
 	}
 
 	// write prolog relevant information into slurm admin comment
@@ -833,6 +915,9 @@ CLEANUP:
 		xfree(slurm_licenses_string);
 		slurm_licenses_string = NULL;
 	}
+	if (slurm_compact_licenses_string) {
+		xfree(slurm_compact_licenses_string);
+	}
 	if (slurm_licenses_environment_string) {
 		xfree(slurm_licenses_environment_string);
 		slurm_licenses_environment_string = NULL;
@@ -861,13 +946,38 @@ CLEANUP:
 		xfree(adc_environment_string);
 		adc_environment_string = NULL;
 	}
-	if (hwdb_handle) {
-		hwdb4c_free_hwdb(hwdb_handle);
-		hwdb_handle = NULL;
+	if (hwdb_instance) {
+		hwdb_cache_release(hwdb_instance);
+		hwdb_instance = NULL;
 	}
+	hwdb_handle = NULL;
 	return retval;
 }
 
+// called before job_submit for the jobs of a batch submission
+extern void job_submit_batch_begin(List job_desc_list, uint32_t submit_uid)
+{
+	if (!batch_hwdbs) {
+		batch_hwdbs = list_create(NULL);
+	}
+}
+
+// called after job_submit was called for all jobs of a batch submission
+extern void job_submit_batch_end(void)
+{
+	batch_hwdb_t* entry;
+
+	if (!batch_hwdbs) {
+		return;
+	}
+	while ((entry = list_pop(batch_hwdbs))) {
+		hwdb_cache_release(entry->instance);
+		xfree(entry->path);
+		xfree(entry);
+	}
+	FREE_NULL_LIST(batch_hwdbs);
+}
+
 extern int job_modify(struct job_descriptor *job_desc, struct job_record *job_ptr, uint32_t submit_uid)
 {
 	return SLURM_SUCCESS;
@@ -958,92 +1068,70 @@ SPLIT_AOUT_ARG_CLEANUP:
 
 static int _option_lookup(char const *option_string)
 {
-	size_t indexcounter;
-	for (indexcounter = 0; indexcounter < NUM_OPTIONS; indexcounter++) {
-		if (strcmp(custom_res_options[indexcounter].option_name, option_string) == 0) {
-			return custom_res_options[indexcounter].index;
-		}
+	int name_index = job_submit_spank_lookup(spank_option_table, option_string, strlen(option_string));
+	if (name_index < 0) {
+		return NMPM_PLUGIN_FAILURE;
 	}
-	return NMPM_PLUGIN_FAILURE;
+	return custom_res_options[name_index].index;
 }
 
 static int _parse_options(struct job_descriptor const *job_desc, option_entry_t *parsed_options, bool *zero_res_args)
 {
 	size_t optioncount, argcount;
-	char argumentsrc[MAX_ARGUMENT_CHAIN_LENGTH] = {0};
-	char *spank_string = NULL;
-	char *arguments = NULL;
-	char *option = NULL;
+	char const* option_values[NUM_OPTIONS];
+	char argumentsrc[MAX_ARGUMENT_CHAIN_LENGTH + 1] = {0};
+	char *bad_option = NULL;
 	char *argument_token = NULL;
 	char *save_ptr = NULL;
-	int retval = NMPM_PLUGIN_SUCCESS;
+	option_entry_t *entry = NULL;
+	int num_found;
 
 	// each option is formated the following way
 	// _SLURM_SPANK_OPTION_wafer_res_opts_[option]=[argument,argument,...]
-	// we iterate over all arguments of all options and save them in parsed_options
-	for (optioncount = 0; optioncount < job_desc->spank_job_env_size; optioncount++) {
-		spank_string = xmalloc(strlen(job_desc->spank_job_env[optioncount]) + 1);
-		strcpy(spank_string, job_desc->spank_job_env[optioncount]);
-		option = strstr(spank_string, SPANK_OPT_PREFIX);
-
-		// some other spank option, skip
-		if (option==NULL) {
-			goto PARSE_OPTIONS_CLEANUP;
-		}
+	// all of them are collected in one pass over the spank job environment
+	num_found = job_submit_spank_parse(spank_option_table, job_desc, option_values, &bad_option);
+	if (num_found < 0) {
+		snprintf(function_error_msg, MAX_ERROR_LENGTH, "Invalid option %s, please update spank arguments", bad_option);
+		xfree(bad_option);
+		return NMPM_PLUGIN_FAILURE;
+	}
+	if (num_found > 0) {
 		*zero_res_args = false;
+	}
 
-		//truncate SPANK_OPT_PREFIX
-		option += strlen(SPANK_OPT_PREFIX);
-		strncpy(argumentsrc, option, MAX_ARGUMENT_CHAIN_LENGTH);
-		//get string after = symbol
-		arguments = strstr(argumentsrc, "=");
-		if (arguments==NULL) {
-			snprintf(function_error_msg, MAX_ERROR_LENGTH, "'=' not present in spank option string, this should never happen");
-			retval = NMPM_PLUGIN_FAILURE;
-			goto PARSE_OPTIONS_CLEANUP;
-		}
-
-		// truncate '=' at end of option string (replace = with 0)
-		option[strlen(option) - strlen(arguments)] = 0;
-		// truncate '=' at beginning of argument chain
-		arguments += 1;
-
-		if (_option_lookup(option) < 0) {
-			snprintf(function_error_msg, MAX_ERROR_LENGTH, "Invalid option %s, please update spank arguments", option);
-			retval = NMPM_PLUGIN_FAILURE;
-			goto PARSE_OPTIONS_CLEANUP;
+	// we iterate over all arguments of all given options and save them in parsed_options
+	for (optioncount = 0; optioncount < NUM_OPTIONS; optioncount++) {
+		if (option_values[optioncount] == NULL) {
+			continue;
 		}
+		entry = &parsed_options[custom_res_options[optioncount].index];
 
 		// options that don't need an argument have literal string "(null)" as argument
 		// set them to magic string to check validity
-		if (strcmp(arguments, "(null)") == 0) {
-			strcpy(parsed_options[_option_lookup(option)].arguments[0], NMPM_MAGIC_BINARY_OPTION);
-			parsed_options[_option_lookup(option)].num_arguments = 1;
-		} else {
-			if (strlen(arguments) > MAX_ARGUMENT_CHAIN_LENGTH) {
-				snprintf(function_error_msg, MAX_ERROR_LENGTH, "To long argument, over %d chars", MAX_ARGUMENT_CHAIN_LENGTH);
-				retval = NMPM_PLUGIN_FAILURE;
-				goto PARSE_OPTIONS_CLEANUP;
-			}
-			argcount = parsed_options[_option_lookup(option)].num_arguments;
-			argument_token = strtok_r(arguments, ",", &save_ptr);
-			while(argument_token != NULL) {
-				strcpy(parsed_options[_option_lookup(option)].arguments[argcount], argument_token);
-				argcount++;
-				parsed_options[_option_lookup(option)].num_arguments = argcount;
-				argument_token = strtok_r(NULL, ",", &save_ptr);
-			}
+		if (strcmp(option_values[optioncount], "(null)") == 0) {
+			strcpy(entry->arguments[0], NMPM_MAGIC_BINARY_OPTION);
+			entry->num_arguments = 1;
+			continue;
 		}
-PARSE_OPTIONS_CLEANUP:
-		if (spank_string) {
-			xfree(spank_string);
-			spank_string = NULL;
+		if (strlen(option_values[optioncount]) > MAX_ARGUMENT_CHAIN_LENGTH) {
+			snprintf(function_error_msg, MAX_ERROR_LENGTH, "To long argument, over %d chars", MAX_ARGUMENT_CHAIN_LENGTH);
+			return NMPM_PLUGIN_FAILURE;
 		}
-		if(retval == NMPM_PLUGIN_FAILURE) {
-			break;
+		strcpy(argumentsrc, option_values[optioncount]);
+		argcount = entry->num_arguments;
+		argument_token = strtok_r(argumentsrc, ",", &save_ptr);
+		while(argument_token != NULL) {
+			if (argcount >= MAX_NUM_ARGUMENTS || strlen(argument_token) >= MAX_ARGUMENT_LENGTH) {
+				snprintf(function_error_msg, MAX_ERROR_LENGTH, "To many or to long arguments for option %s", custom_res_options[optioncount].option_name);
+				return NMPM_PLUGIN_FAILURE;
+			}
+			strcpy(entry->arguments[argcount], argument_token);
+			argcount++;
+			entry->num_arguments = argcount;
+			argument_token = strtok_r(NULL, ",", &save_ptr);
 		}
 	}
-	return retval;
+	return NMPM_PLUGIN_SUCCESS;
 }
 
 static int _add_reticle(size_t reticle_id, int aout, wafer_res_t *allocated_module)
@@ -1097,15 +1185,22 @@ static int _add_fpga(size_t fpga_id, int aout, wafer_res_t *allocated_module)
 		snprintf(function_error_msg, MAX_ERROR_LENGTH, "FPGA %zu on Wafer-Module %zu not in HWDB", fpga_id, allocated_module->wafer_id);
 		return NMPM_PLUGIN_FAILURE;
 	}
+	if (allocated_module->defect_fpgas[fpga_id]) {
+		snprintf(function_error_msg, MAX_ERROR_LENGTH, "FPGA %zu on Wafer-Module %zu is blacklisted in defects path", fpga_id, allocated_module->wafer_id);
+		return NMPM_PLUGIN_FAILURE;
+	}
 
 	if (hwdb4c_get_hicann_entries_of_FPGAGlobal(hwdb_handle, global_fpga_id, &hicann_entries, &num_hicanns) != HWDB4C_SUCCESS) {
 		snprintf(function_error_msg, MAX_ERROR_LENGTH, "Failed to get HICANN entries for FPGA %zu on Wafer-Module %zu ", fpga_id, allocated_module->wafer_id);
 		return NMPM_PLUGIN_FAILURE;
 	}
 
-	// add_hicanns
+	// add_hicanns, except blacklisted ones
 	for (hicanncounter = 0; hicanncounter < num_hicanns; hicanncounter++) {
-		allocated_module->active_hicanns[ hicann_entries[hicanncounter]->hicannglobal_id % NUM_HICANNS_ON_WAFER ] = true;
+		size_t hicann_id = hicann_entries[hicanncounter]->hicannglobal_id % NUM_HICANNS_ON_WAFER;
+		if (!allocated_module->defect_hicanns[hicann_id]) {
+			allocated_module->active_hicanns[hicann_id] = true;
+		}
 	}
 
 	hwdb4c_free_hicann_entries(hicann_entries, num_hicanns);
@@ -1119,6 +1214,132 @@ static int _add_fpga(size_t fpga_id, int aout, wafer_res_t *allocated_module)
 	return NMPM_PLUGIN_SUCCESS;
 }
 
+static void _init_module(size_t wafer_id, wafer_res_t *allocated_module)
+{
+	size_t counter;
+
+	allocated_module->wafer_id = wafer_id;
+	allocated_module->num_active_adcs = 0;
+	for (counter = 0; counter < NUM_FPGAS_ON_WAFER; counter++) {
+		allocated_module->active_fpgas[counter] = false;
+		allocated_module->active_fpga_neighbor[counter] = false;
+		allocated_module->defect_fpgas[counter] = false;
+	}
+	for (counter = 0; counter < NUM_HICANNS_ON_WAFER; counter++) {
+		allocated_module->active_hicanns[counter] = false;
+		allocated_module->active_hicann_neighbor[counter] = false;
+		allocated_module->defect_hicanns[counter] = false;
+	}
+	for (counter = 0; counter < NUM_TRIGGER_PER_WAFER; counter++) {
+		allocated_module->active_trigger[counter] = false;
+	}
+	for (counter = 0; counter < NUM_ANANAS_PER_WAFER; counter++) {
+		allocated_module->active_ananas[counter] = false;
+	}
+}
+
+static int _add_hicanns_on_any_wafer(size_t hicann_count, char const* defects_path, char* reservation, wafer_res_t *allocated_module)
+{
+	bitstr_t **avail_reticles = NULL;
+	bitstr_t **avail_hicanns = NULL;
+	bitstr_t *defect_fpgas = NULL;
+	bitstr_t *hicann_bitmap = NULL;
+	char *license_string = NULL;
+	size_t license_len;
+	size_t hicann_id;
+	int wafer_inx;
+	int counter;
+	int retval = NMPM_PLUGIN_FAILURE;
+
+	if (wafer_record_cnt == 0) {
+		snprintf(function_error_msg, MAX_ERROR_LENGTH, "no wafer topology, requires TopologyPlugin=topology/wafer");
+		return NMPM_PLUGIN_FAILURE;
+	}
+
+	// reticles whose FPGA license is in use or reserved for others are not available
+	avail_reticles = xcalloc(wafer_record_cnt, sizeof(bitstr_t*));
+	avail_hicanns = xcalloc(wafer_record_cnt, sizeof(bitstr_t*));
+	for (counter = 0; counter < wafer_record_cnt; counter++) {
+		if (hwdb4c_FPGAGlobal_slurm_license(wafer_record_table[counter].wafer_id * NUM_FPGAS_ON_WAFER, &license_string) != HWDB4C_SUCCESS) {
+			snprintf(function_error_msg, MAX_ERROR_LENGTH, "Conversion of FPGAs of Wafer-Module %u to slurm license failed", wafer_record_table[counter].wafer_id);
+			goto ANY_WAFER_CLEANUP;
+		}
+		// strip FPGA index to get license group prefix, e.g. W20F0 -> W20F
+		license_len = strlen(license_string);
+		while (license_len > 0 && isdigit(license_string[license_len - 1])) {
+			license_len--;
+		}
+		license_string[license_len] = '\0';
+		avail_reticles[counter] = license_group_avail(license_string, reservation);
+		free(license_string);
+		license_string = NULL;
+
+		// blacklisted reticles and HICANNs are masked out, reticles are indexed like FPGAs
+		if (!defects_path) {
+			continue;
+		}
+		if (hwdb_cache_defects(defects_path, wafer_record_table[counter].wafer_id, &avail_hicanns[counter], &defect_fpgas, function_error_msg, MAX_ERROR_LENGTH) != SLURM_SUCCESS) {
+			goto ANY_WAFER_CLEANUP;
+		}
+		bit_not(avail_hicanns[counter]);
+		if (avail_reticles[counter]) {
+			bit_and_not(avail_reticles[counter], defect_fpgas);
+		} else {
+			bit_not(defect_fpgas);
+			avail_reticles[counter] = defect_fpgas;
+			defect_fpgas = NULL;
+		}
+		FREE_NULL_BITMAP(defect_fpgas);
+	}
+
+	if (wafer_topo_select(hicann_count, avail_reticles, avail_hicanns, &wafer_inx, &hicann_bitmap) != SLURM_SUCCESS) {
+		snprintf(function_error_msg, MAX_ERROR_LENGTH, "no wafer with %zu available HICANNs", hicann_count);
+		goto ANY_WAFER_CLEANUP;
+	}
+
+	_init_module(wafer_record_table[wafer_inx].wafer_id, allocated_module);
+	if (defects_path && _defects_apply(defects_path, allocated_module) != NMPM_PLUGIN_SUCCESS) {
+		goto ANY_WAFER_CLEANUP;
+	}
+	for (hicann_id = 0; hicann_id < NUM_HICANNS_ON_WAFER; hicann_id++) {
+		if (bit_test(hicann_bitmap, hicann_id) && _add_hicann(hicann_id, -1, allocated_module) != NMPM_PLUGIN_SUCCESS) {
+			goto ANY_WAFER_CLEANUP;
+		}
+	}
+	info("%s: placed %zu HICANNs on Wafer-Module %zu", plugin_type, hicann_count, allocated_module->wafer_id);
+	retval = NMPM_PLUGIN_SUCCESS;
+
+ANY_WAFER_CLEANUP:
+	for (counter = 0; counter < wafer_record_cnt; counter++) {
+		FREE_NULL_BITMAP(avail_reticles[counter]);
+		FREE_NULL_BITMAP(avail_hicanns[counter]);
+	}
+	xfree(avail_reticles);
+	xfree(avail_hicanns);
+	FREE_NULL_BITMAP(hicann_bitmap);
+	return retval;
+}
+
+static int _defects_apply(char const* path, wafer_res_t* allocated_module)
+{
+	bitstr_t* hicanns = NULL;
+	bitstr_t* fpgas = NULL;
+	size_t counter;
+
+	if (hwdb_cache_defects(path, allocated_module->wafer_id, &hicanns, &fpgas, function_error_msg, MAX_ERROR_LENGTH) != SLURM_SUCCESS) {
+		return NMPM_PLUGIN_FAILURE;
+	}
+	for (counter = 0; counter < NUM_HICANNS_ON_WAFER; counter++) {
+		allocated_module->defect_hicanns[counter] = bit_test(hicanns, counter);
+	}
+	for (counter = 0; counter < NUM_FPGAS_ON_WAFER; counter++) {
+		allocated_module->defect_fpgas[counter] = bit_test(fpgas, counter);
+	}
+	FREE_NULL_BITMAP(hicanns);
+	FREE_NULL_BITMAP(fpgas);
+	return NMPM_PLUGIN_SUCCESS;
+}
+
 static int _add_hicann(size_t hicann_id, int aout, wafer_res_t *allocated_module)
 {
 	bool has_hicann_entry;
@@ -1145,6 +1366,10 @@ static int _add_hicann(size_t hicann_id, int aout, wafer_res_t *allocated_module
 		snprintf(function_error_msg, MAX_ERROR_LENGTH, "FPGA %zu for HICANN %zu on Wafer-Module %zu not in HWDB",fpga_id, hicann_id, allocated_module->wafer_id);
 		return NMPM_PLUGIN_FAILURE;
 	}
+	if (allocated_module->defect_hicanns[hicann_id]) {
+		snprintf(function_error_msg, MAX_ERROR_LENGTH, "HICANN %zu on Wafer-Module %zu is blacklisted in defects path", hicann_id, allocated_module->wafer_id);
+		return NMPM_PLUGIN_FAILURE;
+	}
 	allocated_module->active_hicanns[hicann_id] = true;
 	allocated_module->active_fpgas[fpga_id] = true;
 	if (aout > -1) {
@@ -1336,3 +1561,103 @@ static int _append_slurm_license(size_t id,
 	free(license_string);
 	return NMPM_PLUGIN_SUCCESS;
 }
+
+/* find batch hwdb by path, NULL path matches the default hwdb (for use by list_find_first) */
+static int _batch_hwdb_find(void* x, void* key)
+{
+	batch_hwdb_t* entry = (batch_hwdb_t*) x;
+	char const* path = (char const*) key;
+
+	if (!entry->path || !path) {
+		return (!entry->path && !path);
+	}
+	return (strcmp(entry->path, path) == 0);
+}
+
+static int _hwdb_acquire(char const* path, hwdb_instance_t** instance)
+{
+	batch_hwdb_t* entry;
+
+	if (batch_hwdbs) {
+		entry = list_find_first(batch_hwdbs, _batch_hwdb_find, (void*) path);
+		if (entry) {
+			hwdb_cache_hold(entry->instance);
+			*instance = entry->instance;
+			return NMPM_PLUGIN_SUCCESS;
+		}
+	}
+	if (hwdb_cache_acquire(path, instance) != SLURM_SUCCESS) {
+		return NMPM_PLUGIN_FAILURE;
+	}
+	if (batch_hwdbs) {
+		entry = xmalloc(sizeof(batch_hwdb_t));
+		entry->path = xstrdup(path);
+		entry->instance = *instance;
+		hwdb_cache_hold(*instance);
+		list_append(batch_hwdbs, entry);
+	}
+	return NMPM_PLUGIN_SUCCESS;
+}
+
+static char* _compact_licenses(char const* licenses)
+{
+	hostlist_t wafer_licenses = hostlist_create(NULL);
+	char* other_licenses = NULL;
+	char* compact = NULL;
+	char* tmp = xstrdup(licenses);
+	char* save_ptr = NULL;
+	char* token;
+
+	for (token = strtok_r(tmp, ",", &save_ptr); token; token = strtok_r(NULL, ",", &save_ptr)) {
+		size_t digits = 0;
+		// wafer component licenses are 'W', wafer id, component letter, component id
+		if (token[0] == 'W') {
+			digits = strspn(token + 1, "0123456789");
+		}
+		if ((digits > 0) && isalpha(token[digits + 1]) && isdigit(token[digits + 2]) &&
+		    (strspn(token + digits + 2, "0123456789") == strlen(token + digits + 2))) {
+			hostlist_push_host(wafer_licenses, token);
+		} else {
+			xstrfmtcat(other_licenses, "%s%s", other_licenses ? "," : "", token);
+		}
+	}
+	xfree(tmp);
+
+	hostlist_uniq(wafer_licenses);
+	if (hostlist_count(wafer_licenses) > 0) {
+		compact = hostlist_ranged_string_xmalloc(wafer_licenses);
+	}
+	hostlist_destroy(wafer_licenses);
+	if (other_licenses) {
+		xstrfmtcat(compact, "%s%s", compact ? "," : "", other_licenses);
+		xfree(other_licenses);
+	}
+	if (!compact) {
+		compact = xstrdup("");
+	}
+	return compact;
+}
+
+static bool _wafer_gres_requested(char const* tres)
+{
+	char* tmp;
+	char* save_ptr = NULL;
+	char* token;
+	bool found = false;
+
+	if (!tres) {
+		return false;
+	}
+	tmp = xstrdup(tres);
+	for (token = strtok_r(tmp, ",", &save_ptr); token && !found; token = strtok_r(NULL, ",", &save_ptr)) {
+		// requests are "[gres:]name[:type]:count"
+		if (!xstrncmp(token, "gres:", 5) || !xstrncmp(token, "gres/", 5)) {
+			token += 5;
+		}
+		if (!xstrncmp(token, "wafer", 5) && ((token[5] == '\0') || (token[5] == ':'))) {
+			found = true;
+		}
+	}
+	xfree(tmp);
+	return found;
+}
@@ -2081,7 +2081,9 @@ extern int decay_apply_weighted_factors(job_record_t *job_ptr,
 	if (((flags & PRIORITY_FLAGS_INCR_ONLY) == 0) ||
 	    (job_ptr->priority < new_prio)) {
 		job_ptr->priority = new_prio;
-		last_job_update = time(NULL);
+		job_ptr->state_dirty = true;
+		job_ptr->last_update = time(NULL);
+		last_job_update = job_ptr->last_update;
 	}
 
 	debug2("priority for job %u is now %u",
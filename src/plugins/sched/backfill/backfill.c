@@ -95,6 +95,9 @@
 #include "src/slurmctld/slurmctld.h"
 #include "src/slurmctld/srun_comm.h"
 #include "backfill.h"
+#include "backfill_plan.h"
+#include "bf_parallel.h"
+#include "node_space.h"
 
 #define BACKFILL_INTERVAL	30
 #define BACKFILL_RESOLUTION	60
@@ -113,6 +116,7 @@
 #define MAX_BF_MAX_JOB_START           10000
 #define MAX_BF_MAX_JOB_TEST            1000000
 #define MAX_BF_MAX_TIME                3600
+#define MAX_BF_PARALLEL                256
 #define MAX_BF_MIN_AGE_RESERVE         (30 * 24 * 60 * 60) /* 30 days */
 #define MAX_BF_MIN_PRIO_RESERVE        INFINITE
 #define MAX_BF_YIELD_INTERVAL          10000000 /* 10 seconds in usec */
@@ -124,18 +128,32 @@
 #define MAX_BF_MAX_JOB_USER_PART       MAX_BF_MAX_JOB_TEST
 #define MAX_BF_MAX_JOB_PART            MAX_BF_MAX_JOB_TEST
 
-typedef struct node_space_map {
-	time_t begin_time;
-	time_t end_time;
-	bitstr_t *avail_bitmap;
-	int next;	/* next record, by time, zero termination */
-} node_space_map_t;
-
 typedef struct node_space_handler {
 	node_space_map_t *node_space;
 	int *node_space_recs;
 } node_space_handler_t;
 
+/*
+ * Job parked while _try_sched() runs on a worker thread, with the state of
+ * its iteration of _attempt_backfill() needed once the outcome is known
+ */
+typedef struct bf_park {
+	job_record_t *job_ptr;
+	part_record_t *part_ptr;
+	bitstr_t *avail_bitmap;
+	bitstr_t *exc_core_bitmap;
+	bitstr_t *resv_bitmap;
+	uint32_t min_nodes, max_nodes, req_nodes;
+	uint32_t deadline_time_limit;
+	uint32_t time_limit, comp_time_limit, orig_time_limit;
+	uint32_t job_no_reserve, qos_flags;
+	time_t later_start, start_res, het_job_time, orig_start_time;
+	int mcs_select;
+	bool is_job_array_head, lic_avail_now, plan_ok, plan_tried;
+	bf_plan_req_t plan_req;
+	int rc;				/* return code of _try_sched() */
+} bf_park_t;
+
 /*
  * HetJob scheduling structures
  * NOTE: An individial hetjob component can be submitted to multiple
@@ -208,19 +226,23 @@ static int max_rpc_cnt = 0;
 static int yield_interval = YIELD_INTERVAL;
 static int yield_sleep   = YIELD_SLEEP;
 static List het_job_list = NULL;
+static bool preempt_comp_stale = true;	/* see _set_preempt_comp() */
 static xhash_t *user_usage_map = NULL; /* look up user usage when no assoc */
 
 /*********************** local functions *********************/
-static void _add_reservation(uint32_t start_time, uint32_t end_reserve,
-			     bitstr_t *res_bitmap,
-			     node_space_map_t *node_space,
-			     int *node_space_recs);
 static void _adjust_hetjob_prio(uint32_t *prio, uint32_t val);
 static int  _attempt_backfill(void);
+static bool _backfill_try(time_t *last_backfill_time);
+static int  _bf_licenses_release(void *x, void *arg);
+static void _bf_licenses_hold(job_record_t *job_ptr,
+			      node_space_map_t *node_space,
+			      int *node_space_recs);
 static int  _clear_job_estimates(void *x, void *arg);
 static int  _clear_qos_blocked_times(void *x, void *arg);
 static void _do_diag_stats(struct timeval *tv1, struct timeval *tv2,
 			   int node_space_recs);
+static int  _first_conflict(job_record_t *job_ptr, time_t now,
+			    node_space_map_t *node_space);
 static uint32_t _get_job_max_tl(job_record_t *job_ptr, time_t now,
 				node_space_map_t *node_space);
 static bool _hetjob_any_resv(job_record_t *het_leader);
@@ -228,9 +250,16 @@ static uint32_t _hetjob_calc_prio(job_record_t *het_leader);
 static uint32_t _hetjob_calc_prio_tier(job_record_t *het_leader);
 static void _het_job_deadlock_fini(void);
 static bool _het_job_deadlock_test(job_record_t *job_ptr);
+static bool _job_parallel_ok(job_record_t *job_ptr);
 static bool _job_part_valid(job_record_t *job_ptr, part_record_t *part_ptr);
+static bool _job_plan_reusable(job_record_t *job_ptr, uint32_t qos_flags,
+			       node_space_map_t *node_space);
 static void _load_config(void);
 static bool _many_pending_rpcs(void);
+static void _park_eval(void *arg);
+static void _park_free(bf_park_t *park);
+static bitstr_t *_park_next_nodes(List job_queue, time_t orig_sched_start,
+				  struct timeval *start_tv);
 static bool _more_work(time_t last_backfill_time);
 static uint32_t _my_sleep(int64_t usec);
 static int  _num_feature_count(job_record_t *job_ptr, bool *has_xand,
@@ -249,6 +278,9 @@ static void _het_job_start_test(node_space_map_t *node_space,
 static void _reset_job_time_limit(job_record_t *job_ptr, time_t now,
 				  node_space_map_t *node_space);
 static int  _set_hetjob_details(void *x, void *arg);
+static int  _set_preempt_comp(void *x, void *arg);
+static int  _split_node_space(time_t when, node_space_map_t *node_space,
+			      int *node_space_recs);
 static int  _start_job(job_record_t *job_ptr, bitstr_t *avail_bitmap);
 static bool _test_resv_overlap(node_space_map_t *node_space,
 			       bitstr_t *use_bitmap, uint32_t start_time,
@@ -678,6 +710,7 @@ static uint32_t _my_sleep(int64_t usec)
 static void _load_config(void)
 {
 	char *sched_params, *tmp_ptr, *tmp_str = NULL;
+	int bf_parallel;
 
 	sched_params = slurm_get_sched_params();
 	debug_flags  = slurm_get_debug_flags();
@@ -958,6 +991,26 @@ static void _load_config(void)
 		max_rpc_cnt = 0;
 	}
 
+	bf_plan_reconfig(xstrcasestr(sched_params, "bf_incremental"),
+			 backfill_resolution);
+
+	if ((tmp_ptr = xstrcasestr(sched_params, "bf_parallel="))) {
+		bf_parallel = atoi(tmp_ptr + 12);
+		if ((bf_parallel < 0) || (bf_parallel > MAX_BF_PARALLEL)) {
+			error("Invalid SchedulerParameters bf_parallel: %d",
+			      bf_parallel);
+			bf_parallel = 0;
+		}
+	} else {
+		bf_parallel = 0;
+	}
+	/* The plan is recorded in the order jobs are tested */
+	if (bf_parallel && xstrcasestr(sched_params, "bf_incremental")) {
+		error("SchedulerParameters bf_parallel ignored with bf_incremental");
+		bf_parallel = 0;
+	}
+	bf_parallel_reconfig(bf_parallel);
+
 	xfree(sched_params);
 }
 
@@ -1000,18 +1053,64 @@ static void _do_diag_stats(struct timeval *tv1, struct timeval *tv2,
 	slurmctld_diag_stats.bf_table_size_sum += node_space_recs;
 }
 
-/* backfill_agent - detached thread periodically attempts to backfill jobs */
-extern void *backfill_agent(void *args)
+/*
+ * Run a backfill cycle, unless the last one ended less than bf_interval ago
+ *	or there is nothing new to test
+ * IN/OUT last_backfill_time - end of the last cycle
+ * RET true if a cycle ran, false to try again shortly
+ */
+static bool _backfill_try(time_t *last_backfill_time)
 {
+	static int backfill_cnt = 0;
 	time_t now;
 	double wait_time;
-	static time_t last_backfill_time = 0;
 	/* Read config and partitions; Write jobs and nodes */
 	slurmctld_lock_t all_locks = {
 		READ_LOCK, WRITE_LOCK, WRITE_LOCK, READ_LOCK, READ_LOCK };
 	bool load_config;
+
+	list_flush(het_job_list);
+	slurm_mutex_lock(&config_lock);
+	if (config_flag) {
+		config_flag = false;
+		load_config = true;
+	} else {
+		load_config = false;
+	}
+	slurm_mutex_unlock(&config_lock);
+	if (load_config)
+		_load_config();
+	now = time(NULL);
+	wait_time = difftime(now, *last_backfill_time);
+	if ((wait_time < backfill_interval) ||
+	    job_is_completing(NULL) || _many_pending_rpcs() ||
+	    !avail_front_end(NULL) || !_more_work(*last_backfill_time))
+		return false;
+
+	slurm_mutex_lock(&check_bf_running_lock);
+	slurmctld_diag_stats.bf_active = 1;
+	slurm_mutex_unlock(&check_bf_running_lock);
+
+	lock_slurmctld(all_locks);
+	if ((backfill_cnt++ % 2) == 0)
+		_het_job_start_clear();
+	(void) _attempt_backfill();
+	*last_backfill_time = time(NULL);
+	(void) bb_g_job_try_stage_in();
+	unlock_slurmctld(all_locks);
+
+	slurm_mutex_lock(&check_bf_running_lock);
+	slurmctld_diag_stats.bf_active = 0;
+	slurm_mutex_unlock(&check_bf_running_lock);
+
+	return true;
+}
+
+/* backfill_agent - detached thread periodically attempts to backfill jobs */
+extern void *backfill_agent(void *args)
+{
+	static time_t last_backfill_time = 0;
 	bool short_sleep = false;
-	int backfill_cnt = 0;
 
 #if HAVE_SYS_PRCTL_H
 	if (prctl(PR_SET_NAME, "bckfl", NULL, NULL, NULL) < 0) {
@@ -1032,46 +1131,12 @@ extern void *backfill_agent(void *args)
 		if (slurmctld_config.scheduling_disabled)
 			continue;
 
-		list_flush(het_job_list);
-		slurm_mutex_lock(&config_lock);
-		if (config_flag) {
-			config_flag = false;
-			load_config = true;
-		} else {
-			load_config = false;
-		}
-		slurm_mutex_unlock(&config_lock);
-		if (load_config)
-			_load_config();
-		now = time(NULL);
-		wait_time = difftime(now, last_backfill_time);
-		if ((wait_time < backfill_interval) ||
-		    job_is_completing(NULL) || _many_pending_rpcs() ||
-		    !avail_front_end(NULL) || !_more_work(last_backfill_time)) {
-			short_sleep = true;
-			continue;
-		}
-
-		slurm_mutex_lock(&check_bf_running_lock);
-		slurmctld_diag_stats.bf_active = 1;
-		slurm_mutex_unlock(&check_bf_running_lock);
-
-		lock_slurmctld(all_locks);
-		if ((backfill_cnt++ % 2) == 0)
-			_het_job_start_clear();
-		(void) _attempt_backfill();
-		last_backfill_time = time(NULL);
-		(void) bb_g_job_try_stage_in();
-		unlock_slurmctld(all_locks);
-
-		slurm_mutex_lock(&check_bf_running_lock);
-		slurmctld_diag_stats.bf_active = 0;
-		slurm_mutex_unlock(&check_bf_running_lock);
-
-		short_sleep = false;
+		short_sleep = !_backfill_try(&last_backfill_time);
 	}
 	FREE_NULL_LIST(het_job_list);
 	xhash_free(user_usage_map); /* May have been init'ed if used */
+	bf_plan_fini();
+	bf_parallel_fini();
 
 	return NULL;
 }
@@ -1104,6 +1169,7 @@ static int _yield_locks(int64_t usec)
 	int yield_rpc_cnt;
 
 	yield_rpc_cnt = MAX((max_rpc_cnt / 10), 20);
+	preempt_comp_stale = true;
 	job_update  = last_job_update;
 	node_update = last_node_update;
 	part_update = last_part_update;
@@ -1162,6 +1228,25 @@ static bool _job_part_valid(job_record_t *job_ptr, part_record_t *part_ptr)
 
 /* Determine if job in the backfill queue is still runnable.
  * Job state could change when lock are periodically released */
+/*
+ * Return true if the outcome of testing a job depends only on its request
+ * and the resources of its partition, so it may be kept for the next cycle
+ */
+static bool _job_plan_reusable(job_record_t *job_ptr, uint32_t qos_flags,
+			       node_space_map_t *node_space)
+{
+	if (job_ptr->het_job_id || job_ptr->array_recs ||
+	    job_ptr->time_min || job_ptr->burst_buffer)
+		return false;
+	if (job_ptr->deadline && (job_ptr->deadline != NO_VAL))
+		return false;
+	if (job_ptr->license_list && node_space[0].licenses)
+		return false;
+	if (assoc_limit_stop || (qos_flags & QOS_FLAG_NO_RESERVE))
+		return false;
+	return true;
+}
+
 static bool _job_runnable_now(job_record_t *job_ptr)
 {
 	uint16_t cleaning = 0;
@@ -1208,6 +1293,109 @@ static void _restore_preempt_state(job_record_t *job_ptr,
 	}
 }
 
+/*
+ * Test if a job may be parked while _try_sched() runs on a worker thread.
+ * Its outcome must not depend on the outcome of jobs of higher priority,
+ * other than through nodes of its partition, and it must only be tested
+ * against the nodes currently available (see build_active_feature_bitmap()).
+ */
+static bool _job_parallel_ok(job_record_t *job_ptr)
+{
+	if (!bf_parallel_workers())
+		return false;
+	if (assoc_limit_stop)		/* QOS blocked_until set by others */
+		return false;
+	if (job_ptr->het_job_id || job_ptr->license_list ||
+	    job_ptr->array_recs || (job_ptr->array_task_id != NO_VAL) ||
+	    job_ptr->details->depend_list)
+		return false;
+	if (job_ptr->details->feature_list && node_features_g_count())
+		return false;
+	return true;
+}
+
+/*
+ * Run _try_sched() for a parked job on a worker thread, while the backfill
+ * thread holds the slurmctld locks and goes on with jobs of other partitions.
+ * Its callees may only write state of the parked job, state private to the
+ * call or thread local state:
+ * - select (cons_common): job_resrcs, total_cpus, start_time and details
+ *   (mc_ptr, core_spec, whole_node, min_gres_cpu) of the job. Node usage and
+ *   partition rows are only read, or copied to simulate jobs ending. The
+ *   per-call statics sockets_core_cnt (dist_tasks.c) and the GPU defaults of
+ *   _set_gpu_defaults() (job_test.c) are thread local. select/linear tests
+ *   jobs under its cr_mutex.
+ * - gres: node gres state is only read, the sock_gres lists are built per
+ *   call and plugin calls take gres_context_lock.
+ * - preempt: job_list is only read, but slurm_job_preempt_mode() sets the
+ *   job_preempt_comp of running hetjobs on first use, which is why
+ *   _set_preempt_comp() sets it before jobs are parked.
+ * - features: details->feature_list of the job is swapped while each feature
+ *   is tested, node features are only read.
+ * The backfill thread must not change the parked job, nor the node, partition
+ * or job state read here: it only starts jobs, or yields the locks, once no
+ * job is parked.
+ */
+static void _park_eval(void *arg)
+{
+	bf_park_t *park = (bf_park_t *) arg;
+
+	park->rc = _try_sched(park->job_ptr, &park->avail_bitmap,
+			      park->min_nodes, park->max_nodes,
+			      park->req_nodes, park->exc_core_bitmap);
+}
+
+static void _park_free(bf_park_t *park)
+{
+	FREE_NULL_BITMAP(park->avail_bitmap);
+	FREE_NULL_BITMAP(park->exc_core_bitmap);
+	FREE_NULL_BITMAP(park->resv_bitmap);
+	xfree(park);
+}
+
+/*
+ * Find the nodes the next job in the queue may use if it may be parked too
+ * RET nodes of its partition, NULL if the parked jobs must be resumed first:
+ *     the next job may not be parked, is parked already for another partition
+ *     or the locks must be released
+ */
+static bitstr_t *_park_next_nodes(List job_queue, time_t orig_sched_start,
+				  struct timeval *start_tv)
+{
+	job_queue_rec_t *job_queue_rec;
+
+	if (slurmctld_config.shutdown_time ||
+	    (difftime(time(NULL), orig_sched_start) >= bf_max_time))
+		return NULL;
+	if (_many_pending_rpcs() ||
+	    (slurm_delta_tv(start_tv) >= yield_interval))
+		return NULL;
+	if (!(job_queue_rec = list_peek(job_queue)))
+		return NULL;
+	if (!job_queue_rec->part_ptr || !job_queue_rec->part_ptr->node_bitmap)
+		return NULL;
+	if (job_queue_rec->job_ptr->bit_flags & BACKFILL_TEST)
+		return NULL;	/* Parked for another partition */
+	if (!_job_parallel_ok(job_queue_rec->job_ptr))
+		return NULL;
+	return job_queue_rec->part_ptr->node_bitmap;
+}
+
+/*
+ * Set the component whose PreemptMode applies to a running hetjob, before
+ * worker threads may look it up (see _park_eval())
+ */
+static int _set_preempt_comp(void *x, void *arg)
+{
+	job_record_t *job_ptr = (job_record_t *) x;
+
+	if (job_ptr->het_job_list && !job_ptr->job_preempt_comp &&
+	    (IS_JOB_RUNNING(job_ptr) || IS_JOB_SUSPENDED(job_ptr)))
+		(void) slurm_job_preempt_mode(job_ptr);
+
+	return 0;
+}
+
 /*
  * IN/OUT: prio to be adjusted
  * IN: value from current component partition
@@ -1364,14 +1552,42 @@ static int _bf_reserve_running(void *x, void *arg)
 	bit_not(tmp_bitmap);
 	end_time = (end_time / backfill_resolution) * backfill_resolution;
 
-	_add_reservation(start_time, end_time, tmp_bitmap, node_space,
-			 ns_recs_ptr);
+	node_space_add_reservation(node_space, start_time, end_time, tmp_bitmap,
+				   NULL, ns_recs_ptr);
 
 	FREE_NULL_BITMAP(tmp_bitmap);
 
 	return SLURM_SUCCESS;
 }
 
+/*
+ * Make the licenses of a running job available in the backfill table from
+ * the time that the job is expected to end
+ */
+static int _bf_licenses_release(void *x, void *arg)
+{
+	job_record_t *job_ptr = (job_record_t *) x;
+	node_space_handler_t *ns_h = (node_space_handler_t *) arg;
+	node_space_map_t *node_space = ns_h->node_space;
+	time_t end_time;
+	int j;
+
+	if (!job_ptr->license_list || !IS_JOB_RUNNING(job_ptr))
+		return SLURM_SUCCESS;
+
+	end_time = (job_ptr->end_time / backfill_resolution) *
+		   backfill_resolution;
+	/* Jobs past their end time are expected to end shortly */
+	end_time = MAX(end_time,
+		       node_space[0].begin_time + backfill_resolution);
+	j = _split_node_space(end_time, node_space, ns_h->node_space_recs);
+	if (j < 0)	/* Ends after the backfill window or table full */
+		return SLURM_SUCCESS;
+	node_space_licenses_return(node_space, job_ptr, end_time);
+
+	return SLURM_SUCCESS;
+}
+
 static int _set_hetjob_details(void *x, void *arg)
 {
 	job_record_t *job_ptr = (job_record_t *) x;
@@ -1574,7 +1790,7 @@ static int _attempt_backfill(void)
 	DEF_TIMERS;
 	List job_queue;
 	job_queue_rec_t *job_queue_rec;
-	int bb, i, j, node_space_recs, mcs_select = 0;
+	int bb, j, node_space_recs, mcs_select = 0;
 	slurmdb_qos_rec_t *qos_ptr = NULL;
 	job_record_t *job_ptr = NULL;
 	part_record_t *part_ptr;
@@ -1584,9 +1800,12 @@ static int _attempt_backfill(void)
 	uint32_t min_nodes, max_nodes, req_nodes;
 	bitstr_t *active_bitmap = NULL, *avail_bitmap = NULL;
 	bitstr_t *exc_core_bitmap = NULL, *resv_bitmap = NULL;
+	bitstr_t *tmp_bitmap = NULL;
 	time_t now, sched_start, later_start, start_res, resv_end, window_end;
 	time_t het_job_time, orig_sched_start, orig_start_time = (time_t) 0;
 	node_space_map_t *node_space;
+	bf_park_t *park;
+	bool job_parked = false, job_resumed = false;
 	struct timeval bf_time1, bf_time2;
 	int rc = 0, error_code;
 	int job_test_count = 0, test_time_count = 0, pend_time;
@@ -1600,14 +1819,17 @@ static int _attempt_backfill(void)
 	uint32_t test_array_job_id = 0;
 	uint32_t test_array_count = 0;
 	uint32_t job_no_reserve;
-	bool is_job_array_head, resv_overlap = false;
+	bool is_job_array_head, resv_overlap = false, lic_avail_now = true;
+	time_t lic_start;
 	uint8_t save_share_res = 0, save_whole_node = 0;
 	int test_fini;
 	uint32_t qos_flags = 0;
 	time_t qos_blocked_until = 0, qos_part_blocked_until = 0;
 	time_t tmp_preempt_start_time = 0;
 	bool tmp_preempt_in_progress = false;
-	bitstr_t *tmp_bitmap = NULL;
+	bool plan_ok = false, plan_tried = false, add_resv;
+	bf_plan_req_t plan_req;
+	bf_plan_outcome_t plan_outcome;
 	/* QOS Read lock */
 	assoc_mgr_lock_t qos_read_lock =
 		{ NO_LOCK, NO_LOCK, READ_LOCK, NO_LOCK,
@@ -1631,6 +1853,7 @@ static int _attempt_backfill(void)
 		debug("backfill: beginning");
 	sched_start = orig_sched_start = now = time(NULL);
 	gettimeofday(&start_tv, NULL);
+	preempt_comp_stale = true;
 
 	job_queue = build_job_queue(true, true);
 	job_test_count = list_count(job_queue);
@@ -1660,31 +1883,36 @@ static int _attempt_backfill(void)
 	slurmctld_diag_stats.bf_last_depth_try = 0;
 	slurmctld_diag_stats.bf_when_last_cycle = now;
 
-	node_space = xmalloc(sizeof(node_space_map_t) *
-			     (max_backfill_job_cnt * 2 + 1));
-	node_space[0].begin_time = sched_start;
 	window_end = sched_start + backfill_window;
-	node_space[0].end_time = window_end;
-
-	node_space[0].avail_bitmap = bit_copy(avail_node_bitmap);
+	tmp_bitmap = bit_copy(avail_node_bitmap);
 	/* Make "resuming" nodes available to be scheduled in backfill */
-	bit_or(node_space[0].avail_bitmap, rs_node_bitmap);
-
-	node_space[0].next = 0;
+	bit_or(tmp_bitmap, rs_node_bitmap);
+	node_space = node_space_create(max_backfill_job_cnt * 2 + 1,
+				       sched_start, window_end, tmp_bitmap,
+				       license_avail_create());
+	tmp_bitmap = NULL;
 	node_space_recs = 1;
 
-	if (bf_running_job_reserve) {
+	if (bf_running_job_reserve || node_space[0].licenses) {
 		node_space_handler_t node_space_handler;
 		node_space_handler.node_space = node_space;
 		node_space_handler.node_space_recs = &node_space_recs;
 
-		list_for_each(job_list, _bf_reserve_running,
-			      &node_space_handler);
+		if (bf_running_job_reserve)
+			list_for_each(job_list, _bf_reserve_running,
+				      &node_space_handler);
+		if (node_space[0].licenses)
+			list_for_each(job_list, _bf_licenses_release,
+				      &node_space_handler);
 	}
 
 	if (debug_flags & DEBUG_FLAG_BACKFILL_MAP)
 		_dump_node_space_table(node_space);
 
+	if (bf_plan_begin(sched_start, window_end) &&
+	    (debug_flags & DEBUG_FLAG_BACKFILL))
+		info("backfill: reusing plan of last cycle");
+
 	if (assoc_limit_stop) {
 		assoc_mgr_lock(&qos_read_lock);
 		list_for_each(assoc_mgr_qos_list,
@@ -1703,10 +1931,56 @@ static int _attempt_backfill(void)
 		bool get_boot_time = false;
 
 		/* Run some final guaranteed logic after each job iteration */
-		if (job_ptr) {
+		if (job_ptr && !job_parked) {
 			job_resv_clear_promiscous_flag(job_ptr);
 			fill_array_reasons(job_ptr, reject_array_job);
 		}
+		job_parked = false;
+		job_resumed = false;
+
+		/* Go on with parked jobs in order of priority */
+		if (bf_parallel_count() &&
+		    (park = bf_parallel_resume(
+			    _park_next_nodes(job_queue, orig_sched_start,
+					     &start_tv)))) {
+			FREE_NULL_BITMAP(avail_bitmap);
+			FREE_NULL_BITMAP(exc_core_bitmap);
+			FREE_NULL_BITMAP(resv_bitmap);
+			job_ptr = park->job_ptr;
+			part_ptr = park->part_ptr;
+			avail_bitmap = park->avail_bitmap;
+			exc_core_bitmap = park->exc_core_bitmap;
+			resv_bitmap = park->resv_bitmap;
+			park->avail_bitmap = NULL;
+			park->exc_core_bitmap = NULL;
+			park->resv_bitmap = NULL;
+			min_nodes = park->min_nodes;
+			max_nodes = park->max_nodes;
+			req_nodes = park->req_nodes;
+			deadline_time_limit = park->deadline_time_limit;
+			time_limit = park->time_limit;
+			comp_time_limit = park->comp_time_limit;
+			orig_time_limit = park->orig_time_limit;
+			job_no_reserve = park->job_no_reserve;
+			qos_flags = park->qos_flags;
+			later_start = park->later_start;
+			start_res = park->start_res;
+			het_job_time = park->het_job_time;
+			orig_start_time = park->orig_start_time;
+			mcs_select = park->mcs_select;
+			is_job_array_head = park->is_job_array_head;
+			lic_avail_now = park->lic_avail_now;
+			plan_ok = park->plan_ok;
+			plan_tried = park->plan_tried;
+			plan_req = park->plan_req;
+			j = park->rc;
+			_park_free(park);
+			already_counted = true;
+			boot_time = 0;
+			job_resumed = true;
+			goto job_tested;
+		}
+
 		job_queue_rec = (job_queue_rec_t *) list_pop(job_queue);
 		if (!job_queue_rec) {
 			if (debug_flags & DEBUG_FLAG_BACKFILL)
@@ -1733,7 +2007,10 @@ static int _attempt_backfill(void)
 			many_rpcs = true;
 		slurm_mutex_unlock(&slurmctld_config.thread_count_lock);
 
-		if (many_rpcs || (slurm_delta_tv(&start_tv) >= yield_interval)) {
+		/* Locks are only yielded once no jobs are parked */
+		if ((many_rpcs ||
+		     (slurm_delta_tv(&start_tv) >= yield_interval)) &&
+		    !bf_parallel_count()) {
 			if (debug_flags & DEBUG_FLAG_BACKFILL) {
 				END_TIMER;
 				info("backfill: yielding locks after testing "
@@ -1756,6 +2033,7 @@ static int _attempt_backfill(void)
 			}
 			if (stop_backfill)
 				break;
+			bf_plan_sync(time(NULL));
 			/* Reset backfill scheduling timers, resume testing */
 			sched_start = time(NULL);
 			gettimeofday(&start_tv, NULL);
@@ -1816,7 +2094,7 @@ static int _attempt_backfill(void)
 				job_ptr->state_reason = WAIT_NO_REASON;
 				xfree(job_ptr->state_desc);
 				job_ptr->assoc_id = assoc_rec.id;
-				last_job_update = now;
+				job_state_changed(job_ptr, now);
 			} else {
 				debug("backfill: %pJ has invalid association",
 				      job_ptr);
@@ -1845,12 +2123,12 @@ static int _attempt_backfill(void)
 				      job_ptr);
 				assoc_mgr_unlock(&locks);
 				job_fail_qos(job_ptr, __func__);
-				last_job_update = now;
+				job_state_changed(job_ptr, now);
 				continue;
 			} else if (job_ptr->state_reason == FAIL_QOS) {
 				xfree(job_ptr->state_desc);
 				job_ptr->state_reason = WAIT_NO_REASON;
-				last_job_update = now;
+				job_state_changed(job_ptr, now);
 			}
 			assoc_mgr_unlock(&locks);
 		}
@@ -2002,13 +2280,20 @@ next_task:
 			continue;
 		}
 
-		if ((!job_independent(job_ptr)) ||
-		    (license_job_test(job_ptr, time(NULL), true) !=
-		     SLURM_SUCCESS)) {
+		/*
+		 * Jobs waiting for licenses are not skipped, but planned
+		 * against the licenses which running jobs will return. This
+		 * keeps them from being overtaken indefinitely by jobs using
+		 * fewer licenses.
+		 */
+		j = license_job_test(job_ptr, time(NULL), true);
+		if ((!job_independent(job_ptr)) || (j == SLURM_ERROR) ||
+		    ((j != SLURM_SUCCESS) && !node_space[0].licenses)) {
 			if (debug_flags & DEBUG_FLAG_BACKFILL)
 				info("backfill: %pJ not runable now", job_ptr);
 			continue;
 		}
+		lic_avail_now = (j == SLURM_SUCCESS);
 
 		/* Determine minimum and maximum node counts */
 		error_code = get_node_cnts(job_ptr, qos_flags, part_ptr,
@@ -2085,6 +2370,14 @@ next_task:
 			}
 		}
 
+		plan_req.time_limit = time_limit;
+		plan_req.min_nodes = min_nodes;
+		plan_req.req_nodes = req_nodes;
+		plan_req.max_nodes = max_nodes;
+		plan_ok = !job_no_reserve &&
+			  _job_plan_reusable(job_ptr, qos_flags, node_space);
+		plan_tried = false;
+
  TRY_LATER:
 		if (slurmctld_config.shutdown_time ||
 		    (difftime(time(NULL), orig_sched_start) >=
@@ -2101,7 +2394,9 @@ next_task:
 			many_rpcs = true;
 		slurm_mutex_unlock(&slurmctld_config.thread_count_lock);
 
-		if (many_rpcs || (slurm_delta_tv(&start_tv) >= yield_interval)) {
+		if ((many_rpcs ||
+		     (slurm_delta_tv(&start_tv) >= yield_interval)) &&
+		    !bf_parallel_count()) {
 			uint32_t save_time_limit = job_ptr->time_limit;
 			_set_job_time_limit(job_ptr, orig_time_limit);
 			if (debug_flags & DEBUG_FLAG_BACKFILL) {
@@ -2126,6 +2421,7 @@ next_task:
 			}
 			if (stop_backfill)
 				break;
+			bf_plan_sync(time(NULL));
 
 			/* Reset backfill scheduling timers, resume testing */
 			sched_start = time(NULL);
@@ -2167,6 +2463,18 @@ next_task:
 			_set_job_time_limit(job_ptr, orig_time_limit);
 			continue;
 		}
+		/* Determine impact of licenses held or reserved by others */
+		lic_start = node_space_licenses_start(node_space, job_ptr,
+						      start_res,
+						      (time_t) time_limit * 60,
+						      lic_avail_now);
+		if (lic_start >= window_end) {
+			if (debug_flags & DEBUG_FLAG_BACKFILL)
+				info("backfill: %pJ licenses defer", job_ptr);
+			_set_job_time_limit(job_ptr, orig_time_limit);
+			continue;
+		}
+		start_res = MAX(start_res, lic_start);
 		if (start_res > now)
 			end_time = (time_limit * 60) + start_res;
 		else
@@ -2181,45 +2489,46 @@ next_task:
 		bit_and_not(avail_bitmap, bf_ignore_node_bitmap);
 		filter_by_node_owner(job_ptr, avail_bitmap);
 		filter_by_node_mcs(job_ptr, mcs_select, avail_bitmap);
-		tmp_bitmap = bit_copy(avail_bitmap);
-		for (j = 0; ; ) {
-			if ((node_space[j].end_time > start_res) &&
-			     node_space[j].next && (later_start == 0)) {
-				int tmp = node_space[j].next;
-				bitstr_t *next_bitmap = bit_copy(tmp_bitmap);
-				bitstr_t *current_bitmap =
-					bit_copy(avail_bitmap);
-				bit_and(next_bitmap,
-					node_space[tmp].avail_bitmap);
-				bit_and(current_bitmap,
-					node_space[j].avail_bitmap);
-				/*
-				 * Normally later_start is set at the end of the
-				 * first backfill reservation when the select
-				 * plugin predicts start time after later_start.
-				 * Then it goes to TRY_LATER and tries again on
-				 * a new set of nodes to check if the job can
-				 * start earlier. But if the next set of nodes
-				 * is a subset of the currently tested ones then
-				 * calling _try_sched (expensive function) would
-				 * be useless and would impact performance.
-				 */
-				if (!bit_super_set(next_bitmap, current_bitmap))
-					later_start = node_space[j].end_time;
-				FREE_NULL_BITMAP(next_bitmap);
-				FREE_NULL_BITMAP(current_bitmap);
-			}
-			if (node_space[j].end_time <= start_res)
+
+		/* Outcome of the last cycle still valid, skip _try_sched */
+		if (plan_ok && !plan_tried) {
+			plan_tried = true;
+			if (!bf_plan_reuse(job_ptr, part_ptr, &plan_req,
+					   start_res, now, &plan_outcome)) {
 				;
-			else if (node_space[j].begin_time <= end_time) {
-				bit_and(avail_bitmap,
-					node_space[j].avail_bitmap);
-			} else
-				break;
-			if ((j = node_space[j].next) == 0)
-				break;
+			} else if (plan_outcome.node_bitmap) {
+				FREE_NULL_BITMAP(avail_bitmap);
+				avail_bitmap = bit_copy(plan_outcome.node_bitmap);
+				job_ptr->start_time = plan_outcome.start_time;
+				boot_time = 0;
+				j = SLURM_SUCCESS;
+				goto plan_reused;
+			} else {
+				/* Not runnable or too far in the future */
+				_set_job_time_limit(job_ptr, orig_time_limit);
+				job_ptr->start_time = plan_outcome.start_time;
+				if (!job_ptr->start_time ||
+				    (orig_start_time &&
+				     (orig_start_time < job_ptr->start_time)))
+					job_ptr->start_time = orig_start_time;
+				bf_plan_record(job_ptr, part_ptr, &plan_req,
+					       true, &plan_outcome);
+				continue;
+			}
 		}
-		FREE_NULL_BITMAP(tmp_bitmap);
+
+		/*
+		 * Normally later_start is set at the end of the first backfill
+		 * reservation when the select plugin predicts start time after
+		 * later_start. Then it goes to TRY_LATER and tries again on a
+		 * new set of nodes to check if the job can start earlier. But
+		 * if no usable nodes are freed, calling _try_sched (expensive
+		 * function) would be useless and would impact performance.
+		 */
+		later_start = node_space_freed(node_space, avail_bitmap,
+					       start_res, end_time);
+		node_space_avail(node_space, start_res, 0, end_time,
+				 avail_bitmap);
 		if (resv_end && (++resv_end < window_end) &&
 		    ((later_start == 0) || (resv_end < later_start))) {
 			later_start = resv_end;
@@ -2328,23 +2637,55 @@ next_task:
 			orig_end_time = end_time;
 			end_time += boot_time;
 
-			for (j = 0; ; ) {
-				if (node_space[j].end_time <= start_res)
-					;
-				else if (node_space[j].begin_time <= end_time) {
-					if (node_space[j].begin_time >
-					    orig_end_time)
-						bit_and(avail_bitmap,
-						node_space[j].avail_bitmap);
-				} else
-					break;
-				if ((j = node_space[j].next) == 0)
-					break;
-			}
+			node_space_avail(node_space, start_res, orig_end_time,
+					 end_time, avail_bitmap);
 		}
 		if (test_fini != 1) {
 			/* Either active_bitmap was NULL or not usable by the
 			 * job. Test using avail_bitmap instead */
+			if ((test_fini == -1) && _job_parallel_ok(job_ptr) &&
+			    bf_parallel_may_park(job_resumed)) {
+				/* Park the job, go on with the next one */
+				if (preempt_comp_stale) {
+					if (slurm_preemption_enabled())
+						list_for_each(job_list,
+							_set_preempt_comp,
+							NULL);
+					preempt_comp_stale = false;
+				}
+				park = xmalloc(sizeof(bf_park_t));
+				park->job_ptr = job_ptr;
+				park->part_ptr = part_ptr;
+				park->avail_bitmap = avail_bitmap;
+				park->exc_core_bitmap = exc_core_bitmap;
+				park->resv_bitmap = resv_bitmap;
+				avail_bitmap = NULL;
+				exc_core_bitmap = NULL;
+				resv_bitmap = NULL;
+				park->min_nodes = min_nodes;
+				park->max_nodes = max_nodes;
+				park->req_nodes = req_nodes;
+				park->deadline_time_limit = deadline_time_limit;
+				park->time_limit = time_limit;
+				park->comp_time_limit = comp_time_limit;
+				park->orig_time_limit = orig_time_limit;
+				park->job_no_reserve = job_no_reserve;
+				park->qos_flags = qos_flags;
+				park->later_start = later_start;
+				park->start_res = start_res;
+				park->het_job_time = het_job_time;
+				park->orig_start_time = orig_start_time;
+				park->mcs_select = mcs_select;
+				park->is_job_array_head = is_job_array_head;
+				park->lic_avail_now = lic_avail_now;
+				park->plan_ok = plan_ok;
+				park->plan_tried = plan_tried;
+				park->plan_req = plan_req;
+				bf_parallel_submit(_park_eval, park,
+						   part_ptr->node_bitmap);
+				job_parked = true;
+				continue;
+			}
 			j = _try_sched(job_ptr, &avail_bitmap, min_nodes,
 				       max_nodes, req_nodes, exc_core_bitmap);
 			if (test_fini == 0) {
@@ -2352,10 +2693,12 @@ next_task:
 				job_ptr->details->whole_node = save_whole_node;
 			}
 		}
+job_tested:
 		job_ptr->bit_flags &= ~BACKFILL_TEST;
 		job_ptr->bit_flags &= ~BF_WHOLE_NODE_TEST;
 		job_ptr->bit_flags &= ~TEST_NOW_ONLY;
 
+plan_reused:
 		now = time(NULL);
 		if (j != SLURM_SUCCESS) {
 			_set_job_time_limit(job_ptr, orig_time_limit);
@@ -2364,17 +2707,27 @@ next_task:
 				goto TRY_LATER;
 			}
 			job_ptr->start_time = orig_start_time;
+			if (!job_no_reserve) {
+				plan_outcome.start_time = 0;
+				plan_outcome.end_time = window_end;
+				plan_outcome.node_bitmap = NULL;
+				bf_plan_record(job_ptr, part_ptr, &plan_req,
+					       plan_ok, &plan_outcome);
+			}
 			continue;	/* not runable in this partition */
 		}
 
 		if (start_res > job_ptr->start_time) {
 			job_ptr->start_time = start_res;
+			job_ptr->last_update = now;
 			last_job_update = now;
 		}
 		/*
 		 * avail_bitmap at this point contains a bitmap of nodes
 		 * selected for this job to be allocated
 		 */
+		if (job_ptr->start_time <= now)
+			plan_ok = false;	/* start attempted */
 		if ((job_ptr->start_time <= now) &&
 		    (bit_overlap_any(avail_bitmap, cg_node_bitmap) ||
 		     bit_overlap_any(avail_bitmap, rs_node_bitmap))) {
@@ -2402,7 +2755,7 @@ next_task:
 				     job_state_string(job_ptr->job_state),
 				     job_reason_string(job_ptr->state_reason),
 				     job_ptr->priority);
-			last_job_update = now;
+			job_state_changed(job_ptr, now);
 			_set_job_time_limit(job_ptr, orig_time_limit);
 			later_start = 0;
 			if (bb == -1)
@@ -2414,6 +2767,9 @@ next_task:
 			bool reset_time = false;
 			int rc;
 
+			/* Job and node state change once started */
+			bf_parallel_wait();
+
 			/* get fed job lock from origin cluster */
 			if (fed_mgr_job_lock(job_ptr)) {
 				if (debug_flags & DEBUG_FLAG_BACKFILL)
@@ -2542,6 +2898,9 @@ skip_start:
 				later_start = 0;
 			} else {
 				/* Started this job, move to next one */
+				_bf_licenses_hold(job_ptr, node_space,
+						  &node_space_recs);
+				bf_plan_started(job_ptr, now);
 
 				/* Clear assumed rejected array status */
 				reject_array_job = NULL;
@@ -2626,6 +2985,11 @@ skip_start:
 			if (debug_flags & DEBUG_FLAG_BACKFILL)
 				_dump_job_sched(job_ptr, end_reserve,
 						avail_bitmap);
+			plan_outcome.start_time = job_ptr->start_time;
+			plan_outcome.end_time = window_end;
+			plan_outcome.node_bitmap = NULL;
+			bf_plan_record(job_ptr, part_ptr, &plan_req, plan_ok,
+				       &plan_outcome);
 			if ((orig_start_time != 0) &&
 			    (orig_start_time < job_ptr->start_time)) {
 				/* Can start earlier in different partition */
@@ -2663,6 +3027,26 @@ skip_start:
 			break;
 		}
 
+		if (job_ptr->start_time > now) {
+			lic_start = node_space_licenses_start(
+				node_space, job_ptr, job_ptr->start_time,
+				end_reserve - start_time, lic_avail_now);
+		} else
+			lic_start = 0;
+		if (lic_start > job_ptr->start_time) {
+			/* Nodes are available before licenses, which are
+			 * reserved for jobs of higher priority. Try again
+			 * when the licenses are available. */
+			later_start = lic_start;
+			job_ptr->start_time = 0;
+			if (debug_flags & DEBUG_FLAG_BACKFILL) {
+				info("backfill: %pJ licenses reserved start_time=%u end_reserve=%u later_start %ld",
+				     job_ptr, start_time, end_reserve,
+				     later_start);
+			}
+			goto TRY_LATER;
+		}
+
 		if ((job_ptr->start_time > now) &&
 		    (job_ptr->state_reason != WAIT_BURST_BUFFER_RESOURCE) &&
 		    (job_ptr->state_reason != WAIT_BURST_BUFFER_STAGING) &&
@@ -2765,11 +3149,19 @@ skip_start:
 			xfree(job_ptr->sched_nodes);
 			job_ptr->sched_nodes = bitmap2node_name(avail_bitmap);
 		}
+		add_resv = (!bf_one_resv_per_job || !orig_start_time) &&
+			   !(job_ptr->bit_flags & JOB_PROM);
+		plan_outcome.start_time = job_ptr->start_time;
+		plan_outcome.end_time = end_reserve;
+		plan_outcome.node_bitmap = add_resv ? avail_bitmap : NULL;
+		bf_plan_record(job_ptr, part_ptr, &plan_req,
+			       (plan_ok && add_resv && !boot_time),
+			       &plan_outcome);
 		bit_not(avail_bitmap);
-		if ((!bf_one_resv_per_job || !orig_start_time) &&
-		    !(job_ptr->bit_flags & JOB_PROM)) {
-			_add_reservation(start_time, end_reserve, avail_bitmap,
-					 node_space, &node_space_recs);
+		if (add_resv) {
+			node_space_add_reservation(node_space, start_time,
+						   end_reserve, avail_bitmap,
+						   job_ptr, &node_space_recs);
 		}
 		if (debug_flags & DEBUG_FLAG_BACKFILL_MAP)
 			_dump_node_space_table(node_space);
@@ -2803,6 +3195,16 @@ skip_start:
 		}
 	}
 
+	/* Drop the outcome of jobs still parked */
+	while ((park = bf_parallel_next())) {
+		park->job_ptr->bit_flags &= ~BACKFILL_TEST;
+		park->job_ptr->bit_flags &= ~TEST_NOW_ONLY;
+		_set_job_time_limit(park->job_ptr, park->orig_time_limit);
+		park->job_ptr->start_time = park->orig_start_time;
+		job_resv_clear_promiscous_flag(park->job_ptr);
+		_park_free(park);
+	}
+
 	/* Restore preemption state if needed. */
 	_restore_preempt_state(job_ptr, &tmp_preempt_start_time,
 			       &tmp_preempt_in_progress);
@@ -2817,12 +3219,8 @@ skip_start:
 	FREE_NULL_BITMAP(exc_core_bitmap);
 	FREE_NULL_BITMAP(resv_bitmap);
 
-	for (i = 0; ; ) {
-		FREE_NULL_BITMAP(node_space[i].avail_bitmap);
-		if ((i = node_space[i].next) == 0)
-			break;
-	}
-	xfree(node_space);
+	bf_plan_end();
+	node_space_free(node_space);
 	FREE_NULL_LIST(job_queue);
 
 	gettimeofday(&bf_time2, NULL);
@@ -2853,6 +3251,7 @@ static int _start_job(job_record_t *job_ptr, bitstr_t *resv_bitmap)
 	bool is_job_array_head = false;
 	static uint32_t fail_jobid = 0;
 
+	preempt_comp_stale = true;
 	if (job_ptr->details->exc_node_bitmap) {
 		orig_exc_nodes = bit_copy(job_ptr->details->exc_node_bitmap);
 		bit_or(job_ptr->details->exc_node_bitmap, resv_bitmap);
@@ -2881,7 +3280,7 @@ static int _start_job(job_record_t *job_ptr, bitstr_t *resv_bitmap)
 		FREE_NULL_BITMAP(orig_exc_nodes);
 	if (rc == SLURM_SUCCESS) {
 		/* job initiated */
-		last_job_update = time(NULL);
+		job_state_changed(job_ptr, time(NULL));
 		info("backfill: Started %pJ in %s on %s",
 		     job_ptr, job_ptr->part_ptr->name, job_ptr->nodes);
 		power_g_job_start(job_ptr);
@@ -2917,6 +3316,26 @@ static int _start_job(job_record_t *job_ptr, bitstr_t *resv_bitmap)
 	return rc;
 }
 
+/*
+ * Find the first record of the backfill table, other than one beginning now,
+ *	lacking some nodes of a job before the job ends
+ * RET index of the record, -1 if none
+ */
+static int _first_conflict(job_record_t *job_ptr, time_t now,
+			   node_space_map_t *node_space)
+{
+	int j;
+
+	j = node_space_busy(node_space, job_ptr->node_bitmap,
+			    node_space[0].begin_time - 1);
+	if ((j != -1) && (node_space[j].begin_time == now))
+		j = node_space_busy(node_space, job_ptr->node_bitmap, now);
+	if ((j != -1) && (node_space[j].begin_time >= job_ptr->end_time))
+		j = -1;
+
+	return j;
+}
+
 /*
  * Compute a job's maximum time based upon conflicts in resources
  * planned for use by other jobs and that job's min/max time limit
@@ -2932,19 +3351,9 @@ static uint32_t _get_job_max_tl(job_record_t *job_ptr, time_t now,
 	if (job_ptr->time_min == 0)
 		return max_tl;
 
-	for (j = 0; ; ) {
-		if ((node_space[j].begin_time != now) && // No current conflicts
-		    (node_space[j].begin_time < job_ptr->end_time) &&
-		    (!bit_super_set(job_ptr->node_bitmap,
-				    node_space[j].avail_bitmap))) {
-			/* Job overlaps pending job's resource reservation */
-			if ((comp_time == 0) ||
-			    (comp_time > node_space[j].begin_time))
-				comp_time = node_space[j].begin_time;
-		}
-		if ((j = node_space[j].next) == 0)
-			break;
-	}
+	/* Job overlaps pending job's resource reservation */
+	if ((j = _first_conflict(job_ptr, now, node_space)) != -1)
+		comp_time = node_space[j].begin_time;
 
 	if (comp_time != 0)
 		max_tl = (comp_time - now + 59) / 60;
@@ -2965,19 +3374,12 @@ static void _reset_job_time_limit(job_record_t *job_ptr, time_t now,
 	uint32_t orig_time_limit = job_ptr->time_limit;
 	uint32_t new_time_limit;
 
-	for (j = 0; ; ) {
-		if ((node_space[j].begin_time != now) && // No current conflicts
-		    (node_space[j].begin_time < job_ptr->end_time) &&
-		    (!bit_super_set(job_ptr->node_bitmap,
-				    node_space[j].avail_bitmap))) {
-			/* Job overlaps pending job's resource reservation */
-			resv_delay = difftime(node_space[j].begin_time, now);
-			resv_delay /= 60;	/* seconds to minutes */
-			if (resv_delay < job_ptr->time_limit)
-				job_ptr->time_limit = resv_delay;
-		}
-		if ((j = node_space[j].next) == 0)
-			break;
+	if ((j = _first_conflict(job_ptr, now, node_space)) != -1) {
+		/* Job overlaps pending job's resource reservation */
+		resv_delay = difftime(node_space[j].begin_time, now);
+		resv_delay /= 60;	/* seconds to minutes */
+		if (resv_delay < job_ptr->time_limit)
+			job_ptr->time_limit = resv_delay;
 	}
 	new_time_limit = MAX(job_ptr->time_min, job_ptr->time_limit);
 	acct_policy_alter_job(job_ptr, new_time_limit);
@@ -3008,96 +3410,45 @@ static bool _more_work (time_t last_backfill_time)
 	return rc;
 }
 
-/* Create a reservation for a job in the future */
-static void _add_reservation(uint32_t start_time, uint32_t end_reserve,
-			     bitstr_t *res_bitmap,
-			     node_space_map_t *node_space,
+/*
+ * Split the record of the backfill table covering the given time, so that a
+ * record begins at that time
+ * RET index of the record beginning at when, -1 if when is outside of the
+ *     table or the table is full
+ */
+static int _split_node_space(time_t when, node_space_map_t *node_space,
 			     int *node_space_recs)
 {
-	bool placed = false;
-	int i, j;
+	int j;
 
-#if 0	
-	info("add job start:%u end:%u", start_time, end_reserve);
-	for (j = 0; ; ) {
-		info("node start:%u end:%u",
-		     (uint32_t) node_space[j].begin_time,
-		     (uint32_t) node_space[j].end_time);
-		if ((j = node_space[j].next) == 0)
-			break;
-	}
-#endif
+	if ((j = node_space_find(node_space, when)) == -1)
+		return -1;
+	if (node_space[j].begin_time == when)
+		return j;
+	if (*node_space_recs >= max_backfill_job_cnt)
+		return -1;
 
-	start_time = MAX(start_time, node_space[0].begin_time);
-	for (j = 0; ; ) {
-		if (node_space[j].end_time > start_time) {
-			/* insert start entry record */
-			i = *node_space_recs;
-			node_space[i].begin_time = start_time;
-			node_space[i].end_time = node_space[j].end_time;
-			node_space[j].end_time = start_time;
-			node_space[i].avail_bitmap =
-				bit_copy(node_space[j].avail_bitmap);
-			node_space[i].next = node_space[j].next;
-			node_space[j].next = i;
-			(*node_space_recs)++;
-			placed = true;
-		}
-		if (node_space[j].end_time == start_time) {
-			/* no need to insert new start entry record */
-			placed = true;
-		}
-		if (placed == true) {
-			while ((j = node_space[j].next)) {
-				if (end_reserve < node_space[j].end_time) {
-					/* insert end entry record */
-					i = *node_space_recs;
-					node_space[i].begin_time = end_reserve;
-					node_space[i].end_time = node_space[j].
-								 end_time;
-					node_space[j].end_time = end_reserve;
-					node_space[i].avail_bitmap =
-						bit_copy(node_space[j].
-							 avail_bitmap);
-					node_space[i].next = node_space[j].next;
-					node_space[j].next = i;
-					(*node_space_recs)++;
-					break;
-				}
-				if (end_reserve == node_space[j].end_time) {
-					break;
-				}
-			}
-			break;
-		}
-		if ((j = node_space[j].next) == 0)
-			break;
-	}
+	return node_space_split(node_space, j, when, node_space_recs);
+}
 
-	for (j = 0; ; ) {
-		if ((node_space[j].begin_time >= start_time) &&
-		    (node_space[j].end_time <= end_reserve))
-			bit_and(node_space[j].avail_bitmap, res_bitmap);
-		if ((node_space[j].begin_time >= end_reserve) ||
-		    ((j = node_space[j].next) == 0))
-			break;
-	}
+/*
+ * Remove the licenses of a job just started from the backfill table until
+ *	the job is expected to end
+ */
+static void _bf_licenses_hold(job_record_t *job_ptr,
+			      node_space_map_t *node_space,
+			      int *node_space_recs)
+{
+	time_t end_time;
 
-	/* Drop records with identical bitmaps (up to one record).
-	 * This can significantly improve performance of the backfill tests. */
-	for (i = 0; ; ) {
-		if ((j = node_space[i].next) == 0)
-			break;
-		if (!bit_equal(node_space[i].avail_bitmap,
-			       node_space[j].avail_bitmap)) {
-			i = j;
-			continue;
-		}
-		node_space[i].end_time = node_space[j].end_time;
-		node_space[i].next = node_space[j].next;
-		FREE_NULL_BITMAP(node_space[j].avail_bitmap);
-		break;
-	}
+	if (!job_ptr->license_list || !node_space[0].licenses)
+		return;
+
+	end_time = ((job_ptr->end_time + backfill_resolution - 1) /
+		    backfill_resolution) * backfill_resolution;
+	(void) _split_node_space(end_time, node_space, node_space_recs);
+	node_space_licenses_remove(node_space, job_ptr,
+				   node_space[0].begin_time, end_time);
 }
 
 /*
@@ -3112,19 +3463,15 @@ static bool _test_resv_overlap(node_space_map_t *node_space,
 			       bitstr_t *use_bitmap, uint32_t start_time,
 			       uint32_t end_reserve)
 {
-	bool overlap = false;
-	int j;
+	bitstr_t *tmp_bitmap;
+	bool overlap;
+
+	tmp_bitmap = bit_copy(use_bitmap);
+	node_space_avail(node_space, start_time, 0,
+			 ((time_t) end_reserve) - 1, tmp_bitmap);
+	overlap = !bit_equal(tmp_bitmap, use_bitmap);
+	FREE_NULL_BITMAP(tmp_bitmap);
 
-	for (j=0; ; ) {
-		if ((node_space[j].end_time   > start_time) &&
-		    (node_space[j].begin_time < end_reserve) &&
-		    (!bit_super_set(use_bitmap, node_space[j].avail_bitmap))) {
-			overlap = true;
-			break;
-		}
-		if ((j = node_space[j].next) == 0)
-			break;
-	}
 	return overlap;
 }
 
@@ -3243,11 +3590,11 @@ static time_t _het_job_start_find(job_record_t *job_ptr, time_t now)
 		if (job_ptr->details->begin_time <= now) {
 			if (job_ptr->state_reason == WAIT_TIME) {
 				job_ptr->state_reason = WAIT_NO_REASON;
-				last_job_update = now;
+				job_state_changed(job_ptr, now);
 			}
 			if (job_ptr->state_reason_prev == WAIT_TIME) {
 				job_ptr->state_reason_prev = WAIT_NO_REASON;
-				last_job_update = now;
+				job_state_changed(job_ptr, now);
 			}
 		}
 
@@ -3595,7 +3942,7 @@ static void _het_job_kill_now(het_job_map_t *map)
 		job_ptr->details->begin_time = now + cred_lifetime + 1;
 		job_ptr->end_time   = now;
 		job_ptr->job_state  = JOB_PENDING | JOB_COMPLETING;
-		last_job_update     = now;
+		job_state_changed(job_ptr, now);
 		build_cg_bitmap(job_ptr);
 		job_completion_logger(job_ptr, false);
 		deallocate_nodes(job_ptr, false, false, false);
@@ -0,0 +1,476 @@
+/*****************************************************************************\
+ *  backfill_plan.c - Backfill plan kept across backfill cycles
+ *
+ *  Outcomes are kept in an array in the order the jobs were tested, with a
+ *  hash table to find them by job and partition. Jobs holding resources are
+ *  kept in a hash table by job id, to find the jobs started, ended or with a
+ *  new end time at the start of a cycle and after locks were released.
+ *
+ *  This file has been developed by staff and students
+ *  of Heidelberg University as part of the research carried out by the
+ *  Electronic Vision(s) group at the Kirchhoff-Institute for Physics.
+ *  The research is funded by Heidelberg University, the State of
+ *  Baden-Württemberg, the Seventh Framework Programme under grant agreements
+ *  no 604102 (HBP) as well as the Horizon 2020 Framework Programme under grant
+ *  agreement 720270 (HBP).
+\*****************************************************************************/
+
+#include "config.h"
+
+#include <string.h>
+
+#include "src/common/bitstring.h"
+#include "src/common/list.h"
+#include "src/common/log.h"
+#include "src/common/macros.h"
+#include "src/common/xhash.h"
+#include "src/common/xmalloc.h"
+#include "src/slurmctld/slurmctld.h"
+#include "backfill_plan.h"
+
+#define BF_PLAN_FULL_CYCLES	10	/* test all jobs at least this often */
+#define BF_PLAN_MAX_DIRTY	64	/* dirty ranges kept apart */
+
+typedef struct {
+	uint32_t job_id;
+	part_record_t *part_ptr;
+} bf_plan_key_t;
+
+typedef struct {
+	bf_plan_key_t key;
+	uint32_t update_cnt;		/* job_ptr->update_cnt when tested */
+	bf_plan_req_t req;
+	bf_plan_outcome_t outcome;
+	bool matched;			/* found in this cycle */
+	bool recorded;			/* recorded again in this cycle */
+} bf_plan_rec_t;
+
+/* Job holding resources */
+typedef struct {
+	uint32_t job_id;
+	time_t end_time;
+	bitstr_t *node_bitmap;
+	uint32_t sync_cnt;		/* last sync finding the job */
+} bf_plan_run_t;
+
+typedef struct {
+	bitstr_t *node_bitmap;
+	time_t begin_time;
+	time_t end_time;
+} bf_plan_dirty_t;
+
+static bool plan_enabled = false;
+static int plan_resolution = 60;
+static bool plan_reuse = false;		/* outcomes reusable in this cycle */
+static uint32_t plan_cycles = 0;	/* cycles since all jobs were tested */
+static time_t plan_time = 0;		/* start of the cycle of the plan */
+static time_t cycle_time = 0;
+static time_t cycle_window_end = 0;
+
+/* Outcomes of the last cycle, in the order tested */
+static bf_plan_rec_t *plan_recs = NULL;
+static uint32_t plan_rec_cnt = 0;
+static xhash_t *plan_hash = NULL;
+static uint32_t plan_cursor = 0;	/* next outcome in order */
+static bf_plan_rec_t *plan_last_match = NULL;
+
+/* Outcomes of this cycle */
+static bf_plan_rec_t *new_recs = NULL;
+static uint32_t new_rec_cnt = 0, new_rec_size = 0;
+static uint32_t reused_cnt = 0;
+
+static xhash_t *run_hash = NULL;
+static uint32_t sync_cnt = 0;
+static bitstr_t *sync_avail_bitmap = NULL;
+
+static bf_plan_dirty_t dirty[BF_PLAN_MAX_DIRTY];
+static int dirty_cnt = 0;
+
+static void _rec_key_id(void *item, const char **key, uint32_t *key_len)
+{
+	bf_plan_rec_t *rec = (bf_plan_rec_t *) item;
+
+	*key = (const char *) &rec->key;
+	*key_len = sizeof(rec->key);
+}
+
+static void _run_key_id(void *item, const char **key, uint32_t *key_len)
+{
+	bf_plan_run_t *run = (bf_plan_run_t *) item;
+
+	*key = (const char *) &run->job_id;
+	*key_len = sizeof(run->job_id);
+}
+
+static void _run_free(void *item)
+{
+	bf_plan_run_t *run = (bf_plan_run_t *) item;
+
+	FREE_NULL_BITMAP(run->node_bitmap);
+	xfree(run);
+}
+
+static void _free_recs(bf_plan_rec_t *recs, uint32_t rec_cnt)
+{
+	uint32_t i;
+
+	for (i = 0; i < rec_cnt; i++)
+		FREE_NULL_BITMAP(recs[i].outcome.node_bitmap);
+	xfree(recs);
+}
+
+static void _clear_dirty(void)
+{
+	int i;
+
+	for (i = 0; i < dirty_cnt; i++)
+		FREE_NULL_BITMAP(dirty[i].node_bitmap);
+	dirty_cnt = 0;
+}
+
+/* Mark nodes changed from begin_time to end_time */
+static void _add_dirty(bitstr_t *node_bitmap, time_t begin_time,
+		       time_t end_time)
+{
+	bf_plan_dirty_t *range;
+
+	if (!plan_reuse || !node_bitmap || (bit_ffs(node_bitmap) == -1))
+		return;
+
+	if (dirty_cnt < BF_PLAN_MAX_DIRTY) {
+		range = &dirty[dirty_cnt++];
+		range->node_bitmap = bit_copy(node_bitmap);
+		range->begin_time = begin_time;
+		range->end_time = end_time;
+		return;
+	}
+
+	/* Widen the last range to cover this one too */
+	range = &dirty[BF_PLAN_MAX_DIRTY - 1];
+	bit_or(range->node_bitmap, node_bitmap);
+	range->begin_time = MIN(range->begin_time, begin_time);
+	range->end_time = MAX(range->end_time, end_time);
+}
+
+static void _add_dirty_outcome(bf_plan_outcome_t *outcome)
+{
+	time_t begin_time;
+
+	if (!outcome->node_bitmap)
+		return;
+	/* Reservations start at the resolution below the expected start */
+	begin_time = (outcome->start_time / plan_resolution) * plan_resolution;
+	_add_dirty(outcome->node_bitmap, begin_time, outcome->end_time);
+}
+
+static bool _same_outcome(bf_plan_outcome_t *o1, bf_plan_outcome_t *o2)
+{
+	if (!o1->node_bitmap || !o2->node_bitmap)
+		return (o1->node_bitmap == o2->node_bitmap);
+	return ((o1->start_time == o2->start_time) &&
+		(o1->end_time == o2->end_time) &&
+		bit_equal(o1->node_bitmap, o2->node_bitmap));
+}
+
+/* An outcome found but not recorded again is gone, e.g. the job was held */
+static void _check_last_match(void)
+{
+	if (plan_last_match && !plan_last_match->recorded)
+		_add_dirty_outcome(&plan_last_match->outcome);
+	plan_last_match = NULL;
+}
+
+static void _free_plan(void)
+{
+	_clear_dirty();
+	xhash_free(plan_hash);
+	_free_recs(plan_recs, plan_rec_cnt);
+	plan_recs = NULL;
+	plan_rec_cnt = 0;
+	_free_recs(new_recs, new_rec_cnt);
+	new_recs = NULL;
+	new_rec_cnt = new_rec_size = 0;
+	plan_last_match = NULL;
+	xhash_free(run_hash);
+	FREE_NULL_BITMAP(sync_avail_bitmap);
+	plan_reuse = false;
+	plan_time = 0;
+	plan_cycles = 0;
+}
+
+extern void bf_plan_reconfig(bool enable, int resolution)
+{
+	_free_plan();
+	plan_enabled = enable;
+	plan_resolution = resolution;
+}
+
+extern void bf_plan_fini(void)
+{
+	_free_plan();
+	plan_enabled = false;
+}
+
+static void _find_gone(void *item, void *arg)
+{
+	bf_plan_run_t *run = (bf_plan_run_t *) item;
+
+	if (run->sync_cnt != sync_cnt)
+		list_append((List) arg, run);
+}
+
+extern void bf_plan_sync(time_t now)
+{
+	ListIterator job_iterator;
+	job_record_t *job_ptr;
+	bf_plan_run_t *run;
+	bitstr_t *avail_bitmap, *tmp_bitmap;
+	List gone_list;
+
+	if (!plan_enabled)
+		return;
+
+	/* Reservations and partitions are not tracked in detail */
+	if ((last_part_update >= cycle_time) ||
+	    (last_resv_update >= cycle_time) ||
+	    (slurmctld_conf.last_update >= cycle_time))
+		plan_reuse = false;
+
+	if (!run_hash)
+		run_hash = xhash_init(_run_key_id, _run_free);
+	sync_cnt++;
+	job_iterator = list_iterator_create(job_list);
+	while ((job_ptr = list_next(job_iterator))) {
+		if (!job_ptr->node_bitmap ||
+		    (!IS_JOB_RUNNING(job_ptr) && !IS_JOB_SUSPENDED(job_ptr) &&
+		     !IS_JOB_COMPLETING(job_ptr)))
+			continue;
+		run = xhash_get(run_hash, (const char *) &job_ptr->job_id,
+				sizeof(job_ptr->job_id));
+		if (!run) {
+			run = xmalloc(sizeof(bf_plan_run_t));
+			run->job_id = job_ptr->job_id;
+			run->end_time = job_ptr->end_time;
+			run->node_bitmap = bit_copy(job_ptr->node_bitmap);
+			xhash_add(run_hash, run);
+			_add_dirty(run->node_bitmap, now, run->end_time);
+		} else if ((run->end_time != job_ptr->end_time) ||
+			   !bit_equal(run->node_bitmap,
+				      job_ptr->node_bitmap)) {
+			_add_dirty(run->node_bitmap, now, run->end_time);
+			_add_dirty(job_ptr->node_bitmap, now,
+				   job_ptr->end_time);
+			run->end_time = job_ptr->end_time;
+			FREE_NULL_BITMAP(run->node_bitmap);
+			run->node_bitmap = bit_copy(job_ptr->node_bitmap);
+		} else if (run->end_time <= now) {
+			/* Past its end time, will end at an unknown time */
+			_add_dirty(run->node_bitmap, now, now);
+		}
+		run->sync_cnt = sync_cnt;
+	}
+	list_iterator_destroy(job_iterator);
+
+	gone_list = list_create(NULL);
+	xhash_walk(run_hash, _find_gone, gone_list);
+	while ((run = list_pop(gone_list))) {
+		_add_dirty(run->node_bitmap, now, MAX(run->end_time, now));
+		xhash_delete(run_hash, (const char *) &run->job_id,
+			     sizeof(run->job_id));
+	}
+	FREE_NULL_LIST(gone_list);
+
+	/* Nodes usable by backfill as in _attempt_backfill() */
+	avail_bitmap = bit_copy(avail_node_bitmap);
+	bit_or(avail_bitmap, rs_node_bitmap);
+	bit_and(avail_bitmap, up_node_bitmap);
+	if (sync_avail_bitmap) {
+		tmp_bitmap = bit_copy(sync_avail_bitmap);
+		bit_and_not(tmp_bitmap, avail_bitmap);
+		_add_dirty(tmp_bitmap, now, (time_t) INFINITE);
+		bit_copybits(tmp_bitmap, avail_bitmap);
+		bit_and_not(tmp_bitmap, sync_avail_bitmap);
+		_add_dirty(tmp_bitmap, now, (time_t) INFINITE);
+		FREE_NULL_BITMAP(tmp_bitmap);
+		FREE_NULL_BITMAP(sync_avail_bitmap);
+	}
+	sync_avail_bitmap = avail_bitmap;
+}
+
+extern bool bf_plan_begin(time_t now, time_t window_end)
+{
+	if (!plan_enabled)
+		return false;
+
+	_clear_dirty();
+	plan_reuse = plan_time && (plan_cycles < BF_PLAN_FULL_CYCLES) &&
+		     (last_part_update < plan_time) &&
+		     (last_resv_update < plan_time) &&
+		     (slurmctld_conf.last_update < plan_time);
+	cycle_time = now;
+	cycle_window_end = window_end;
+	bf_plan_sync(now);
+
+	plan_cursor = 0;
+	plan_last_match = NULL;
+	reused_cnt = 0;
+	if (plan_reuse) {
+		plan_cycles++;
+		slurmctld_diag_stats.bf_plan_incr++;
+	} else {
+		plan_cycles = 0;
+		slurmctld_diag_stats.bf_plan_full++;
+	}
+
+	return plan_reuse;
+}
+
+extern bool bf_plan_reuse(job_record_t *job_ptr, part_record_t *part_ptr,
+			  bf_plan_req_t *req, time_t start_res, time_t now,
+			  bf_plan_outcome_t *outcome)
+{
+	bf_plan_key_t key;
+	bf_plan_rec_t *rec;
+	uint32_t inx;
+	int i;
+
+	if (!plan_reuse || !plan_hash)
+		return false;
+
+	_check_last_match();
+	memset(&key, 0, sizeof(key));
+	key.job_id = job_ptr->job_id;
+	key.part_ptr = part_ptr;
+	if (!(rec = xhash_get(plan_hash, (const char *) &key, sizeof(key))))
+		return false;
+
+	/* Tested in another order, the jobs before it had other outcomes */
+	inx = rec - plan_recs;
+	if (inx < plan_cursor)
+		return false;
+	/* Jobs skipped since the last match no longer hold reservations */
+	for ( ; plan_cursor < inx; plan_cursor++)
+		_add_dirty_outcome(&plan_recs[plan_cursor].outcome);
+	plan_cursor++;
+	rec->matched = true;
+	plan_last_match = rec;
+
+	if ((rec->update_cnt != job_ptr->update_cnt) ||
+	    memcmp(&rec->req, req, sizeof(bf_plan_req_t)))
+		return false;
+	if (rec->outcome.node_bitmap) {
+		if ((rec->outcome.start_time <= now) ||
+		    (rec->outcome.start_time < start_res))
+			return false;
+	} else if ((rec->outcome.start_time &&
+		    (rec->outcome.start_time < start_res)) ||
+		   (rec->outcome.end_time + plan_resolution <
+		    cycle_window_end)) {
+		/* Window moved on, the job may fit in now */
+		return false;
+	}
+
+	for (i = 0; i < dirty_cnt; i++) {
+		if ((dirty[i].begin_time <= rec->outcome.end_time) &&
+		    (dirty[i].end_time >= now) &&
+		    bit_overlap_any(dirty[i].node_bitmap,
+				    part_ptr->node_bitmap))
+			return false;
+	}
+
+	*outcome = rec->outcome;
+	reused_cnt++;
+	return true;
+}
+
+extern void bf_plan_record(job_record_t *job_ptr, part_record_t *part_ptr,
+			   bf_plan_req_t *req, bool reusable,
+			   bf_plan_outcome_t *outcome)
+{
+	bf_plan_rec_t *rec, *old = NULL;
+
+	if (!plan_enabled)
+		return;
+
+	if (plan_last_match &&
+	    (plan_last_match->key.job_id == job_ptr->job_id) &&
+	    (plan_last_match->key.part_ptr == part_ptr)) {
+		old = plan_last_match;
+		old->recorded = true;
+	}
+	if (!old || !reusable || !_same_outcome(&old->outcome, outcome)) {
+		if (old)
+			_add_dirty_outcome(&old->outcome);
+		_add_dirty_outcome(outcome);
+	}
+	if (!reusable)
+		return;
+
+	if (new_rec_cnt >= new_rec_size) {
+		new_rec_size = MAX(new_rec_size * 2, 128);
+		xrealloc(new_recs, sizeof(bf_plan_rec_t) * new_rec_size);
+	}
+	rec = &new_recs[new_rec_cnt++];
+	memset(rec, 0, sizeof(bf_plan_rec_t));
+	rec->key.job_id = job_ptr->job_id;
+	rec->key.part_ptr = part_ptr;
+	rec->update_cnt = job_ptr->update_cnt;
+	rec->req = *req;
+	rec->outcome = *outcome;
+	if (outcome->node_bitmap)
+		rec->outcome.node_bitmap = bit_copy(outcome->node_bitmap);
+}
+
+extern void bf_plan_started(job_record_t *job_ptr, time_t now)
+{
+	bf_plan_run_t *run;
+
+	if (!plan_enabled || !job_ptr->node_bitmap || !run_hash)
+		return;
+
+	_add_dirty(job_ptr->node_bitmap, now, job_ptr->end_time);
+
+	/* Jobs tested after it knew, not a change for the next cycle */
+	run = xhash_get(run_hash, (const char *) &job_ptr->job_id,
+			sizeof(job_ptr->job_id));
+	if (!run) {
+		run = xmalloc(sizeof(bf_plan_run_t));
+		run->job_id = job_ptr->job_id;
+		xhash_add(run_hash, run);
+	}
+	run->end_time = job_ptr->end_time;
+	FREE_NULL_BITMAP(run->node_bitmap);
+	run->node_bitmap = bit_copy(job_ptr->node_bitmap);
+	run->sync_cnt = sync_cnt;
+}
+
+extern void bf_plan_end(void)
+{
+	uint32_t i;
+
+	if (!plan_enabled)
+		return;
+
+	_clear_dirty();
+	xhash_free(plan_hash);
+	_free_recs(plan_recs, plan_rec_cnt);
+
+	plan_recs = new_recs;
+	plan_rec_cnt = new_rec_cnt;
+	new_recs = NULL;
+	new_rec_cnt = new_rec_size = 0;
+	plan_last_match = NULL;
+
+	/* A job tested twice in a partition is found by its first outcome */
+	plan_hash = xhash_init(_rec_key_id, NULL);
+	for (i = 0; i < plan_rec_cnt; i++) {
+		if (!xhash_get(plan_hash, (const char *) &plan_recs[i].key,
+			       sizeof(bf_plan_key_t)))
+			xhash_add(plan_hash, &plan_recs[i]);
+	}
+	plan_time = cycle_time;
+	plan_reuse = false;
+
+	slurmctld_diag_stats.bf_plan_last_reused = reused_cnt;
+	slurmctld_diag_stats.bf_plan_reused_sum += reused_cnt;
+}
@@ -0,0 +1,100 @@
+/*****************************************************************************\
+ *  backfill_plan.h - Backfill plan kept across backfill cycles
+ *
+ *  This file has been developed by staff and students
+ *  of Heidelberg University as part of the research carried out by the
+ *  Electronic Vision(s) group at the Kirchhoff-Institute for Physics.
+ *  The research is funded by Heidelberg University, the State of
+ *  Baden-Württemberg, the Seventh Framework Programme under grant agreements
+ *  no 604102 (HBP) as well as the Horizon 2020 Framework Programme under grant
+ *  agreement 720270 (HBP).
+\*****************************************************************************/
+
+#ifndef _BACKFILL_PLAN_H
+#define _BACKFILL_PLAN_H
+
+#include <stdbool.h>
+#include <stdint.h>
+#include <time.h>
+
+#include "src/common/bitstring.h"
+#include "src/slurmctld/slurmctld.h"
+
+/*
+ * With SchedulerParameters=bf_incremental, the outcome of testing each job
+ * in a backfill cycle is kept for the next cycle, in the order the jobs were
+ * tested. Changes to resources since then are collected as dirty nodes in
+ * time ranges: jobs started, ended or with a new end time, nodes becoming
+ * available or unavailable and outcomes of this cycle which differ from the
+ * last one. A job tested in the same order as before, with the same request
+ * and no dirty nodes of its partition before the end of its last outcome, is
+ * given its last outcome without being tested again.
+ */
+
+/* Request of a job in a partition, as planned */
+typedef struct {
+	uint32_t time_limit;	/* minutes */
+	uint32_t min_nodes;
+	uint32_t req_nodes;
+	uint32_t max_nodes;
+} bf_plan_req_t;
+
+/* Outcome of testing a job in a partition */
+typedef struct {
+	time_t start_time;	/* expected start, 0 if unknown */
+	time_t end_time;	/* end of the reservation or of the window */
+	bitstr_t *node_bitmap;	/* nodes reserved, NULL if not reserved */
+} bf_plan_outcome_t;
+
+/*
+ * Enable or disable the plan and drop the current one
+ * IN enable - keep a plan across cycles
+ * IN resolution - bf_resolution in seconds
+ */
+extern void bf_plan_reconfig(bool enable, int resolution);
+
+/* Free the plan */
+extern void bf_plan_fini(void);
+
+/*
+ * Start a backfill cycle, collecting the changes since the last one.
+ *	Every few cycles and on partition, reservation or configuration
+ *	changes all jobs are tested again.
+ * IN now - start of the cycle
+ * IN window_end - end of the backfill window
+ * RET true if outcomes of the last cycle may be reused
+ */
+extern bool bf_plan_begin(time_t now, time_t window_end);
+
+/* Collect the changes made while the backfill locks were released */
+extern void bf_plan_sync(time_t now);
+
+/*
+ * Find the outcome of a job in the last cycle, if still valid. Call in the
+ *	order jobs are tested, once for each job and partition.
+ * IN start_res - earliest start time of the job
+ * IN now - current time
+ * OUT outcome - valid until the end of the cycle, node_bitmap not to be freed
+ * RET true if the outcome of the last cycle is still valid
+ */
+extern bool bf_plan_reuse(job_record_t *job_ptr, part_record_t *part_ptr,
+			  bf_plan_req_t *req, time_t start_res, time_t now,
+			  bf_plan_outcome_t *outcome);
+
+/*
+ * Record the outcome of testing a job for the next cycle
+ * IN reusable - false if the outcome depends on more than the request, then
+ *	a reservation only marks its nodes dirty
+ * IN outcome - node_bitmap is copied
+ */
+extern void bf_plan_record(job_record_t *job_ptr, part_record_t *part_ptr,
+			   bf_plan_req_t *req, bool reusable,
+			   bf_plan_outcome_t *outcome);
+
+/* Note a job started by the backfill scheduler */
+extern void bf_plan_started(job_record_t *job_ptr, time_t now);
+
+/* End a backfill cycle, its outcomes become the plan for the next one */
+extern void bf_plan_end(void);
+
+#endif /* !_BACKFILL_PLAN_H */
@@ -0,0 +1,246 @@
+/*****************************************************************************\
+ *  bf_parallel.c - Evaluate backfill jobs of disjoint partitions in parallel
+ *
+ *  Tasks in flight are kept in a ring of as many entries as there are worker
+ *  threads, in order of submission. Workers take the oldest task not yet
+ *  started, so with a single worker tasks are evaluated one at a time in
+ *  order of submission.
+ *
+ *  This file has been developed by staff and students
+ *  of Heidelberg University as part of the research carried out by the
+ *  Electronic Vision(s) group at the Kirchhoff-Institute for Physics.
+ *  The research is funded by Heidelberg University, the State of
+ *  Baden-Württemberg, the Seventh Framework Programme under grant agreements
+ *  no 604102 (HBP) as well as the Horizon 2020 Framework Programme under grant
+ *  agreement 720270 (HBP).
+\*****************************************************************************/
+
+#include "config.h"
+
+#if HAVE_SYS_PRCTL_H
+#  include <sys/prctl.h>
+#endif
+
+#include <pthread.h>
+
+#include "src/common/bitstring.h"
+#include "src/common/log.h"
+#include "src/common/macros.h"
+#include "src/common/xassert.h"
+#include "src/common/xmalloc.h"
+#include "bf_parallel.h"
+
+typedef struct bf_task {
+	void (*eval) (void *arg);
+	void *arg;
+	bitstr_t *node_bitmap;
+	bool started;
+	bool done;
+} bf_task_t;
+
+static pthread_mutex_t task_mutex = PTHREAD_MUTEX_INITIALIZER;
+static pthread_cond_t task_cond = PTHREAD_COND_INITIALIZER;
+static pthread_cond_t done_cond = PTHREAD_COND_INITIALIZER;
+static bf_task_t *task_ring = NULL;	/* worker_cnt entries */
+static int task_head = 0;		/* oldest task in flight */
+static int task_cnt = 0;		/* count of tasks in flight */
+static pthread_t *worker_threads = NULL;
+static int worker_cnt = 0;
+static bool worker_shutdown = false;
+
+static bf_task_t *_task(int i)
+{
+	return &task_ring[(task_head + i) % worker_cnt];
+}
+
+/* Find the oldest task not yet started, call with task_mutex locked */
+static bf_task_t *_task_queued(void)
+{
+	bf_task_t *task;
+	int i;
+
+	for (i = 0; i < task_cnt; i++) {
+		task = _task(i);
+		if (!task->started)
+			return task;
+	}
+	return NULL;
+}
+
+static void *_worker(void *arg)
+{
+	bf_task_t *task;
+
+#if HAVE_SYS_PRCTL_H
+	if (prctl(PR_SET_NAME, "bckfl_eval", NULL, NULL, NULL) < 0) {
+		error("%s: cannot set my name to %s %m",
+		      __func__, "bckfl_eval");
+	}
+#endif
+
+	slurm_mutex_lock(&task_mutex);
+	while (!worker_shutdown) {
+		if (!(task = _task_queued())) {
+			slurm_cond_wait(&task_cond, &task_mutex);
+			continue;
+		}
+		task->started = true;
+		slurm_mutex_unlock(&task_mutex);
+
+		(task->eval)(task->arg);
+
+		slurm_mutex_lock(&task_mutex);
+		task->done = true;
+		slurm_cond_broadcast(&done_cond);
+	}
+	slurm_mutex_unlock(&task_mutex);
+
+	return NULL;
+}
+
+extern void bf_parallel_reconfig(int workers)
+{
+	int i;
+
+	if (workers == worker_cnt)
+		return;
+
+	bf_parallel_fini();
+	if (workers <= 0)
+		return;
+
+	slurm_mutex_lock(&task_mutex);
+	worker_shutdown = false;
+	worker_cnt = workers;
+	task_ring = xcalloc(worker_cnt, sizeof(bf_task_t));
+	task_head = task_cnt = 0;
+	worker_threads = xcalloc(worker_cnt, sizeof(pthread_t));
+	for (i = 0; i < worker_cnt; i++)
+		slurm_thread_create(&worker_threads[i], _worker, NULL);
+	slurm_mutex_unlock(&task_mutex);
+}
+
+extern void bf_parallel_fini(void)
+{
+	int i;
+
+	if (!worker_cnt)
+		return;
+
+	while (task_cnt)
+		(void) bf_parallel_next();
+
+	slurm_mutex_lock(&task_mutex);
+	worker_shutdown = true;
+	slurm_cond_broadcast(&task_cond);
+	slurm_mutex_unlock(&task_mutex);
+
+	for (i = 0; i < worker_cnt; i++)
+		pthread_join(worker_threads[i], NULL);
+
+	slurm_mutex_lock(&task_mutex);
+	xfree(worker_threads);
+	xfree(task_ring);
+	worker_cnt = 0;
+	slurm_mutex_unlock(&task_mutex);
+}
+
+extern int bf_parallel_workers(void)
+{
+	return worker_cnt;
+}
+
+extern int bf_parallel_count(void)
+{
+	return task_cnt;
+}
+
+extern bool bf_parallel_full(void)
+{
+	return (task_cnt >= worker_cnt);
+}
+
+extern bool bf_parallel_overlap(bitstr_t *node_bitmap)
+{
+	int i;
+
+	for (i = 0; i < task_cnt; i++) {
+		if (bit_overlap_any(_task(i)->node_bitmap, node_bitmap))
+			return true;
+	}
+	return false;
+}
+
+extern void bf_parallel_submit(void (*eval) (void *arg), void *arg,
+			       bitstr_t *node_bitmap)
+{
+	bf_task_t *task;
+
+	xassert(task_cnt < worker_cnt);
+
+	slurm_mutex_lock(&task_mutex);
+	task = _task(task_cnt++);
+	task->eval = eval;
+	task->arg = arg;
+	task->node_bitmap = node_bitmap;
+	task->started = false;
+	task->done = false;
+	slurm_cond_signal(&task_cond);
+	slurm_mutex_unlock(&task_mutex);
+}
+
+extern void *bf_parallel_next(void)
+{
+	bf_task_t *task;
+	void *arg;
+
+	if (!task_cnt)
+		return NULL;
+
+	slurm_mutex_lock(&task_mutex);
+	task = _task(0);
+	while (!task->done)
+		slurm_cond_wait(&done_cond, &task_mutex);
+	arg = task->arg;
+	task->arg = NULL;
+	task->node_bitmap = NULL;
+	task_head = (task_head + 1) % worker_cnt;
+	task_cnt--;
+	slurm_mutex_unlock(&task_mutex);
+
+	return arg;
+}
+
+extern bool bf_parallel_may_park(bool resumed)
+{
+	if (!worker_cnt || bf_parallel_full())
+		return false;
+	if (resumed && task_cnt)
+		return false;
+	return true;
+}
+
+extern void *bf_parallel_resume(bitstr_t *next_node_bitmap)
+{
+	if (!task_cnt)
+		return NULL;
+	if (!bf_parallel_full() && next_node_bitmap &&
+	    !bf_parallel_overlap(next_node_bitmap))
+		return NULL;
+	return bf_parallel_next();
+}
+
+extern void bf_parallel_wait(void)
+{
+	int i;
+
+	if (!task_cnt)
+		return;
+
+	slurm_mutex_lock(&task_mutex);
+	for (i = 0; i < task_cnt; i++) {
+		while (!_task(i)->done)
+			slurm_cond_wait(&done_cond, &task_mutex);
+	}
+	slurm_mutex_unlock(&task_mutex);
+}
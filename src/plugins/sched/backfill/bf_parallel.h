@@ -0,0 +1,96 @@
+/*****************************************************************************\
+ *  bf_parallel.h - Evaluate backfill jobs of disjoint partitions in parallel
+ *
+ *  This file has been developed by staff and students
+ *  of Heidelberg University as part of the research carried out by the
+ *  Electronic Vision(s) group at the Kirchhoff-Institute for Physics.
+ *  The research is funded by Heidelberg University, the State of
+ *  Baden-Württemberg, the Seventh Framework Programme under grant agreements
+ *  no 604102 (HBP) as well as the Horizon 2020 Framework Programme under grant
+ *  agreement 720270 (HBP).
+\*****************************************************************************/
+
+#ifndef _BACKFILL_BF_PARALLEL_H
+#define _BACKFILL_BF_PARALLEL_H
+
+#include <stdbool.h>
+
+#include "src/common/bitstring.h"
+
+/*
+ * Worker threads run the expensive part of testing when a job could start
+ * (the select plugin's will-run test) while the backfill thread goes on with
+ * the next jobs of the queue. Tasks are returned by bf_parallel_next() in the
+ * order they were submitted, so that their outcome is applied to the table of
+ * node space in order of job priority. The caller must only submit tasks
+ * which do not depend on the outcome of the tasks in flight, which is why
+ * each task notes the nodes its job may use (see bf_parallel_overlap()).
+ *
+ * All functions but the eval callbacks are called from the backfill thread
+ * only, which keeps holding the slurmctld locks while tasks are in flight.
+ */
+
+/*
+ * Start or stop worker threads, waits for any tasks in flight
+ * IN workers - count of worker threads, 0 to evaluate jobs serially
+ */
+extern void bf_parallel_reconfig(int workers);
+
+/* End all worker threads */
+extern void bf_parallel_fini(void);
+
+/* RET count of worker threads, 0 if disabled */
+extern int bf_parallel_workers(void);
+
+/* RET count of tasks submitted but not yet returned by bf_parallel_next() */
+extern int bf_parallel_count(void);
+
+/* RET true if no more tasks may be submitted before one is returned */
+extern bool bf_parallel_full(void);
+
+/* RET true if some of the nodes are used by a task in flight */
+extern bool bf_parallel_overlap(bitstr_t *node_bitmap);
+
+/*
+ * Submit a task to a worker thread
+ * IN eval - function to run on a worker thread
+ * IN arg - argument of eval, returned by bf_parallel_next()
+ * IN node_bitmap - nodes the task may use, must remain unchanged until the
+ *	task is returned
+ * NOTE: Only call if !bf_parallel_full()
+ */
+extern void bf_parallel_submit(void (*eval) (void *arg), void *arg,
+			       bitstr_t *node_bitmap);
+
+/*
+ * Wait for the oldest task in flight to be evaluated and remove it
+ * RET arg of the task, NULL if no task is in flight
+ */
+extern void *bf_parallel_next(void);
+
+/*
+ * Test if a job may be parked, its task submitted instead of evaluated on the
+ *	calling thread
+ * IN resumed - true if the job was resumed and is tested again at a later
+ *	start time, which may only be parked once no older task is in flight
+ *	to keep outcomes in order of submission
+ */
+extern bool bf_parallel_may_park(bool resumed);
+
+/*
+ * Resume the oldest parked job if it must be before testing the next job:
+ *	no more tasks may be submitted, the next job may not be parked or it
+ *	may use nodes of a task in flight. Whether the task was evaluated
+ *	already does not matter, so that jobs are resumed independent of the
+ *	timing of the worker threads.
+ * IN next_node_bitmap - nodes the next job may use, NULL if it may not be
+ *	parked or there is no next job
+ * RET arg of the task resumed, NULL if the next job may be tested first or no
+ *	task is in flight
+ */
+extern void *bf_parallel_resume(bitstr_t *next_node_bitmap);
+
+/* Wait for all tasks in flight to be evaluated */
+extern void bf_parallel_wait(void);
+
+#endif /* !_BACKFILL_BF_PARALLEL_H */
@@ -0,0 +1,619 @@
+/*****************************************************************************\
+ *  node_space.c - Table of the nodes available over time to backfill jobs
+ *
+ *  The tree is a treap with priorities derived from the record index, the
+ *  record 0 having the highest one, so that it always remains the root. As
+ *  the records of a subtree cover consecutive time ranges, the time range
+ *  of a subtree follows from its ancestors and is passed down while walking
+ *  the tree rather than stored.
+ *
+ *  This file has been developed by staff and students
+ *  of Heidelberg University as part of the research carried out by the
+ *  Electronic Vision(s) group at the Kirchhoff-Institute for Physics.
+ *  The research is funded by Heidelberg University, the State of
+ *  Baden-Württemberg, the Seventh Framework Programme under grant agreements
+ *  no 604102 (HBP) as well as the Horizon 2020 Framework Programme under grant
+ *  agreement 720270 (HBP).
+\*****************************************************************************/
+
+#include "config.h"
+
+#include "slurm/slurm.h"
+
+#include "src/common/bitstring.h"
+#include "src/common/xmalloc.h"
+#include "src/slurmctld/licenses.h"
+#include "node_space.h"
+
+/* End of the time range of the whole tree */
+#define TREE_END	((time_t) INFINITE)
+
+static uint32_t _prio(int i)
+{
+	if (i == 0)
+		return UINT32_MAX;
+	return ((uint32_t) i * 2654435761U) >> 1;
+}
+
+/* Remove nodes from a record and all records of its subtree */
+static void _tree_apply(node_space_map_t *node_space, int t,
+			bitstr_t *res_bitmap)
+{
+	node_space_map_t *rec = &node_space[t];
+
+	/* Nodes freed after the previous record are reserved too */
+	bit_and(rec->avail_bitmap, res_bitmap);
+	bit_and(rec->freed_bitmap, res_bitmap);
+	bit_and(rec->tree_avail_bitmap, res_bitmap);
+	bit_and(rec->tree_freed_bitmap, res_bitmap);
+	if ((rec->left == -1) && (rec->right == -1))
+		return;
+	if (rec->tree_res_bitmap)
+		bit_and(rec->tree_res_bitmap, res_bitmap);
+	else
+		rec->tree_res_bitmap = bit_copy(res_bitmap);
+}
+
+/* Pass the nodes removed from a subtree down to the children of its root */
+static void _tree_push(node_space_map_t *node_space, int t)
+{
+	node_space_map_t *rec = &node_space[t];
+
+	if (!rec->tree_res_bitmap)
+		return;
+	if (rec->left != -1)
+		_tree_apply(node_space, rec->left, rec->tree_res_bitmap);
+	if (rec->right != -1)
+		_tree_apply(node_space, rec->right, rec->tree_res_bitmap);
+	FREE_NULL_BITMAP(rec->tree_res_bitmap);
+}
+
+/* Bring the bitmaps of a record up to date by pushing down from the root */
+static void _tree_push_path(node_space_map_t *node_space, int t)
+{
+	if (node_space[t].parent != -1)
+		_tree_push_path(node_space, node_space[t].parent);
+	_tree_push(node_space, t);
+}
+
+/* Update the summaries of a record from its own bitmaps and its children */
+static void _tree_sum(node_space_map_t *node_space, int t)
+{
+	node_space_map_t *rec = &node_space[t];
+
+	_tree_push(node_space, t);
+	bit_copybits(rec->tree_avail_bitmap, rec->avail_bitmap);
+	bit_copybits(rec->tree_freed_bitmap, rec->freed_bitmap);
+	if (rec->left != -1) {
+		bit_and(rec->tree_avail_bitmap,
+			node_space[rec->left].tree_avail_bitmap);
+		bit_or(rec->tree_freed_bitmap,
+		       node_space[rec->left].tree_freed_bitmap);
+	}
+	if (rec->right != -1) {
+		bit_and(rec->tree_avail_bitmap,
+			node_space[rec->right].tree_avail_bitmap);
+		bit_or(rec->tree_freed_bitmap,
+		       node_space[rec->right].tree_freed_bitmap);
+	}
+}
+
+/* Update the summaries of a record and all of its ancestors */
+static void _tree_fix(node_space_map_t *node_space, int t)
+{
+	for ( ; t != -1; t = node_space[t].parent)
+		_tree_sum(node_space, t);
+}
+
+/* Rotate a record above its parent, updating the parent's summaries */
+static void _tree_rotate_up(node_space_map_t *node_space, int x)
+{
+	int p = node_space[x].parent;
+	int g = node_space[p].parent;
+	int c;
+
+	_tree_push(node_space, p);
+	_tree_push(node_space, x);
+	if (node_space[p].left == x) {
+		c = node_space[x].right;
+		node_space[p].left = c;
+		node_space[x].right = p;
+	} else {
+		c = node_space[x].left;
+		node_space[p].right = c;
+		node_space[x].left = p;
+	}
+	if (c != -1)
+		node_space[c].parent = p;
+	node_space[p].parent = x;
+	node_space[x].parent = g;
+	if (node_space[g].left == p)
+		node_space[g].left = x;
+	else
+		node_space[g].right = x;
+	_tree_sum(node_space, p);
+}
+
+/* Add record i to the tree, following record j in time */
+static void _tree_insert(node_space_map_t *node_space, int i, int j)
+{
+	int p;
+
+	node_space[i].left = node_space[i].right = -1;
+	_tree_push(node_space, j);
+	if ((p = node_space[j].right) == -1) {
+		node_space[j].right = i;
+		node_space[i].parent = j;
+	} else {
+		_tree_push(node_space, p);
+		while (node_space[p].left != -1) {
+			p = node_space[p].left;
+			_tree_push(node_space, p);
+		}
+		node_space[p].left = i;
+		node_space[i].parent = p;
+	}
+	while (_prio(i) > _prio(node_space[i].parent))
+		_tree_rotate_up(node_space, i);
+	_tree_fix(node_space, i);
+}
+
+/* Remove record k, other than record 0, from the tree */
+static void _tree_remove(node_space_map_t *node_space, int k)
+{
+	int c, p;
+
+	while ((node_space[k].left != -1) && (node_space[k].right != -1)) {
+		if (_prio(node_space[k].left) > _prio(node_space[k].right))
+			_tree_rotate_up(node_space, node_space[k].left);
+		else
+			_tree_rotate_up(node_space, node_space[k].right);
+	}
+	_tree_push(node_space, k);
+	c = (node_space[k].left != -1) ? node_space[k].left :
+					  node_space[k].right;
+	p = node_space[k].parent;
+	if (node_space[p].left == k)
+		node_space[p].left = c;
+	else
+		node_space[p].right = c;
+	if (c != -1)
+		node_space[c].parent = p;
+	_tree_fix(node_space, p);
+}
+
+/*
+ * Find the record preceding record k in time, -1 if none. If the bitmaps of
+ *	record k are up to date, so are those of the record found.
+ */
+static int _tree_prev(node_space_map_t *node_space, int k)
+{
+	int p;
+
+	_tree_push(node_space, k);
+	if ((p = node_space[k].left) != -1) {
+		_tree_push(node_space, p);
+		while (node_space[p].right != -1) {
+			p = node_space[p].right;
+			_tree_push(node_space, p);
+		}
+		return p;
+	}
+	while (((p = node_space[k].parent) != -1) &&
+	       (node_space[p].left == k))
+		k = p;
+	return p;
+}
+
+extern node_space_map_t *node_space_create(int max_recs, time_t begin_time,
+					   time_t end_time,
+					   bitstr_t *avail_bitmap,
+					   license_avail_t *licenses)
+{
+	node_space_map_t *node_space;
+
+	node_space = xcalloc(max_recs, sizeof(node_space_map_t));
+	node_space[0].begin_time = begin_time;
+	node_space[0].end_time = end_time;
+	node_space[0].avail_bitmap = avail_bitmap;
+	node_space[0].licenses = licenses;
+	node_space[0].next = 0;
+	node_space[0].left = node_space[0].right = -1;
+	node_space[0].parent = -1;
+	node_space[0].freed_bitmap = bit_alloc(bit_size(avail_bitmap));
+	node_space[0].tree_avail_bitmap = bit_copy(avail_bitmap);
+	node_space[0].tree_freed_bitmap = bit_alloc(bit_size(avail_bitmap));
+
+	return node_space;
+}
+
+static void _free_rec(node_space_map_t *rec)
+{
+	FREE_NULL_BITMAP(rec->avail_bitmap);
+	FREE_NULL_BITMAP(rec->freed_bitmap);
+	FREE_NULL_BITMAP(rec->tree_avail_bitmap);
+	FREE_NULL_BITMAP(rec->tree_freed_bitmap);
+	FREE_NULL_BITMAP(rec->tree_res_bitmap);
+	license_avail_free(rec->licenses);
+	rec->licenses = NULL;
+}
+
+extern void node_space_free(node_space_map_t *node_space)
+{
+	int i;
+
+	if (!node_space)
+		return;
+
+	for (i = 0; ; ) {
+		_free_rec(&node_space[i]);
+		if ((i = node_space[i].next) == 0)
+			break;
+	}
+	xfree(node_space);
+}
+
+extern int node_space_find(node_space_map_t *node_space, time_t when)
+{
+	int t = 0;
+
+	while (t != -1) {
+		if (when < node_space[t].begin_time)
+			t = node_space[t].left;
+		else if (when >= node_space[t].end_time)
+			t = node_space[t].right;
+		else
+			return t;
+	}
+	return -1;
+}
+
+extern int node_space_split(node_space_map_t *node_space, int j, time_t when,
+			    int *node_space_recs)
+{
+	int i = *node_space_recs;
+
+	_tree_push_path(node_space, j);
+	node_space[i].begin_time = when;
+	node_space[i].end_time = node_space[j].end_time;
+	node_space[j].end_time = when;
+	node_space[i].avail_bitmap = bit_copy(node_space[j].avail_bitmap);
+	node_space[i].licenses = license_avail_copy(node_space[j].licenses);
+	node_space[i].next = node_space[j].next;
+	node_space[j].next = i;
+	(*node_space_recs)++;
+
+	/* Nothing freed, the records are identical */
+	node_space[i].freed_bitmap = bit_alloc(bit_size(
+					node_space[i].avail_bitmap));
+	node_space[i].tree_avail_bitmap = bit_copy(node_space[i].avail_bitmap);
+	node_space[i].tree_freed_bitmap = bit_alloc(bit_size(
+					node_space[i].avail_bitmap));
+	_tree_insert(node_space, i, j);
+
+	return i;
+}
+
+static void _tree_reserve(node_space_map_t *node_space, int t, time_t lo,
+			  time_t hi, time_t start_time, time_t end_time,
+			  bitstr_t *res_bitmap)
+{
+	node_space_map_t *rec;
+
+	if ((t == -1) || (hi <= start_time) || (lo >= end_time))
+		return;
+
+	if ((lo >= start_time) && (hi <= end_time)) {
+		/* All records of the subtree, passed down when walked */
+		_tree_apply(node_space, t, res_bitmap);
+		return;
+	}
+
+	_tree_push(node_space, t);
+	rec = &node_space[t];
+	_tree_reserve(node_space, rec->left, lo, rec->begin_time,
+		      start_time, end_time, res_bitmap);
+	if ((rec->begin_time >= start_time) && (rec->end_time <= end_time)) {
+		/* Nodes freed after the previous record are reserved too */
+		bit_and(rec->avail_bitmap, res_bitmap);
+		bit_and(rec->freed_bitmap, res_bitmap);
+	}
+	_tree_reserve(node_space, rec->right, rec->end_time, hi,
+		      start_time, end_time, res_bitmap);
+	_tree_sum(node_space, t);
+}
+
+extern void node_space_reserve(node_space_map_t *node_space,
+			       time_t start_time, time_t end_time,
+			       bitstr_t *res_bitmap)
+{
+	int j, k;
+
+	_tree_reserve(node_space, 0, node_space[0].begin_time, TREE_END,
+		      start_time, end_time, res_bitmap);
+
+	/* Reserved nodes are freed after the end of the reservation */
+	if (((k = node_space_find(node_space, end_time)) <= 0) ||
+	    (node_space[k].begin_time < start_time))
+		return;
+	_tree_push_path(node_space, k);
+	j = _tree_prev(node_space, k);
+	bit_copybits(node_space[k].freed_bitmap, node_space[k].avail_bitmap);
+	bit_and_not(node_space[k].freed_bitmap, node_space[j].avail_bitmap);
+	_tree_fix(node_space, k);
+}
+
+/* Merge record k with the previous record if nodes and licenses match */
+static void _merge_prev(node_space_map_t *node_space, int k)
+{
+	int p;
+
+	if (k <= 0)
+		return;
+	_tree_push_path(node_space, k);
+	p = _tree_prev(node_space, k);
+	if (!bit_equal(node_space[p].avail_bitmap,
+		       node_space[k].avail_bitmap) ||
+	    !license_avail_equal(node_space[p].licenses,
+				 node_space[k].licenses))
+		return;
+
+	/* Nothing freed in record k, the next record is unchanged */
+	_tree_remove(node_space, k);
+	node_space[p].end_time = node_space[k].end_time;
+	node_space[p].next = node_space[k].next;
+	_free_rec(&node_space[k]);
+}
+
+extern void node_space_merge(node_space_map_t *node_space, time_t start_time,
+			     time_t end_time)
+{
+	_merge_prev(node_space, node_space_find(node_space, end_time));
+	_merge_prev(node_space, node_space_find(node_space, start_time));
+}
+
+typedef struct {
+	time_t end_after;
+	time_t begin_after;
+	time_t begin_until;
+	bitstr_t *node_bitmap;
+} avail_query_t;
+
+static void _tree_avail(node_space_map_t *node_space, int t, time_t lo,
+			time_t hi, avail_query_t *query)
+{
+	node_space_map_t *rec;
+
+	if ((t == -1) || (hi <= query->end_after) ||
+	    (hi <= query->begin_after) || (lo > query->begin_until))
+		return;
+
+	rec = &node_space[t];
+	if ((lo > query->end_after) && (lo > query->begin_after) &&
+	    (hi <= query->begin_until)) {
+		/* All records of the subtree match */
+		bit_and(query->node_bitmap, rec->tree_avail_bitmap);
+		return;
+	}
+
+	_tree_push(node_space, t);
+	_tree_avail(node_space, rec->left, lo, rec->begin_time, query);
+	if ((rec->end_time > query->end_after) &&
+	    (rec->begin_time > query->begin_after) &&
+	    (rec->begin_time <= query->begin_until))
+		bit_and(query->node_bitmap, rec->avail_bitmap);
+	_tree_avail(node_space, rec->right, rec->end_time, hi, query);
+}
+
+extern void node_space_avail(node_space_map_t *node_space, time_t end_after,
+			     time_t begin_after, time_t begin_until,
+			     bitstr_t *node_bitmap)
+{
+	avail_query_t query;
+
+	query.end_after = end_after;
+	query.begin_after = begin_after;
+	query.begin_until = begin_until;
+	query.node_bitmap = node_bitmap;
+	_tree_avail(node_space, 0, node_space[0].begin_time, TREE_END, &query);
+}
+
+/* Find the first record beginning after a time with some nodes freed */
+static int _tree_first_freed(node_space_map_t *node_space, int t, time_t hi,
+			     time_t after, bitstr_t *node_bitmap)
+{
+	node_space_map_t *rec;
+	int k;
+
+	if ((t == -1) || (hi <= after))
+		return -1;
+
+	rec = &node_space[t];
+	if (!bit_overlap_any(rec->tree_freed_bitmap, node_bitmap))
+		return -1;
+	_tree_push(node_space, t);
+	k = _tree_first_freed(node_space, rec->left, rec->begin_time, after,
+			      node_bitmap);
+	if (k != -1)
+		return k;
+	if ((rec->begin_time > after) &&
+	    bit_overlap_any(rec->freed_bitmap, node_bitmap))
+		return t;
+	return _tree_first_freed(node_space, rec->right, hi, after,
+				 node_bitmap);
+}
+
+extern time_t node_space_freed(node_space_map_t *node_space,
+			       bitstr_t *node_bitmap, time_t start_time,
+			       time_t end_time)
+{
+	int j, k;
+
+	/*
+	 * Nodes freed in record k were unavailable in the record before it,
+	 * or in an earlier one if those are still unavailable there.
+	 */
+	k = _tree_first_freed(node_space, 0, TREE_END, start_time,
+			      node_bitmap);
+	if (k == -1)
+		return 0;
+	j = _tree_prev(node_space, k);
+	if ((j > 0) && (node_space[j].begin_time > end_time) &&
+	    (node_space[_tree_prev(node_space, j)].begin_time > end_time))
+		return 0;
+	return node_space[k].begin_time;
+}
+
+/* Find the first record beginning after a time missing some nodes */
+static int _tree_first_busy(node_space_map_t *node_space, int t, time_t hi,
+			    time_t after, bitstr_t *node_bitmap)
+{
+	node_space_map_t *rec;
+	int k;
+
+	if ((t == -1) || (hi <= after))
+		return -1;
+
+	rec = &node_space[t];
+	if (bit_super_set(node_bitmap, rec->tree_avail_bitmap))
+		return -1;
+	_tree_push(node_space, t);
+	k = _tree_first_busy(node_space, rec->left, rec->begin_time, after,
+			     node_bitmap);
+	if (k != -1)
+		return k;
+	if ((rec->begin_time > after) &&
+	    !bit_super_set(node_bitmap, rec->avail_bitmap))
+		return t;
+	return _tree_first_busy(node_space, rec->right, hi, after,
+				node_bitmap);
+}
+
+extern int node_space_busy(node_space_map_t *node_space,
+			   bitstr_t *node_bitmap, time_t after)
+{
+	return _tree_first_busy(node_space, 0, TREE_END, after, node_bitmap);
+}
+
+static void _tree_sync(node_space_map_t *node_space, int t)
+{
+	if (t == -1)
+		return;
+	_tree_push(node_space, t);
+	_tree_sync(node_space, node_space[t].left);
+	_tree_sync(node_space, node_space[t].right);
+}
+
+extern void node_space_sync(node_space_map_t *node_space)
+{
+	_tree_sync(node_space, 0);
+}
+
+extern time_t node_space_licenses_start(node_space_map_t *node_space,
+					job_record_t *job_ptr,
+					time_t start_res, time_t run_time,
+					bool avail_now)
+{
+	time_t start_time = start_res;
+	int j;
+
+	if (!job_ptr->license_list || !node_space[0].licenses)
+		return start_time;
+
+	for (j = 0; ; ) {
+		if (node_space[j].end_time <= start_time)
+			;
+		else if (node_space[j].begin_time >= (start_time + run_time))
+			break;
+		else if (((j == 0) && !avail_now) ||
+			 !license_avail_test(node_space[j].licenses, job_ptr))
+			start_time = node_space[j].end_time;
+		if ((j = node_space[j].next) == 0)
+			break;
+	}
+
+	return start_time;
+}
+
+/* RET index of the record covering start_time, the first record if it
+ *     begins later, -1 if start_time is after the end of the table */
+static int _licenses_first(node_space_map_t *node_space, time_t start_time)
+{
+	if (start_time <= node_space[0].begin_time)
+		return 0;
+	return node_space_find(node_space, start_time);
+}
+
+extern void node_space_licenses_remove(node_space_map_t *node_space,
+				       job_record_t *job_ptr,
+				       time_t start_time, time_t end_time)
+{
+	int j;
+
+	if (!job_ptr->license_list || !node_space[0].licenses)
+		return;
+	if ((j = _licenses_first(node_space, start_time)) == -1)
+		return;
+
+	for ( ; ; ) {
+		if (node_space[j].begin_time >= end_time)
+			break;
+		if (node_space[j].begin_time >= start_time)
+			license_avail_remove(node_space[j].licenses, job_ptr);
+		if ((j = node_space[j].next) == 0)
+			break;
+	}
+}
+
+extern void node_space_licenses_return(node_space_map_t *node_space,
+				       job_record_t *job_ptr,
+				       time_t start_time)
+{
+	int j;
+
+	if (!job_ptr->license_list || !node_space[0].licenses)
+		return;
+	if ((j = _licenses_first(node_space, start_time)) == -1)
+		return;
+
+	for ( ; ; ) {
+		if (node_space[j].begin_time >= start_time)
+			license_avail_return(node_space[j].licenses, job_ptr);
+		if ((j = node_space[j].next) == 0)
+			break;
+	}
+}
+
+extern void node_space_add_reservation(node_space_map_t *node_space,
+				       time_t start_time, time_t end_reserve,
+				       bitstr_t *res_bitmap,
+				       job_record_t *lic_job_ptr,
+				       int *node_space_recs)
+{
+	int i, j;
+
+	start_time = MAX(start_time, node_space[0].begin_time);
+	if ((i = node_space_find(node_space, start_time)) == -1)
+		return;		/* after the end of the table */
+
+	/* insert start entry record */
+	if (node_space[i].begin_time < start_time)
+		(void) node_space_split(node_space, i, start_time,
+					node_space_recs);
+	/* insert end entry record */
+	if ((end_reserve > start_time) &&
+	    ((j = node_space_find(node_space, end_reserve)) != -1) &&
+	    (node_space[j].begin_time < end_reserve))
+		(void) node_space_split(node_space, j, end_reserve,
+					node_space_recs);
+
+	node_space_reserve(node_space, start_time, end_reserve, res_bitmap);
+	if (lic_job_ptr)
+		node_space_licenses_remove(node_space, lic_job_ptr,
+					   start_time, end_reserve);
+
+	/* Drop records with identical bitmaps and licenses at either end of
+	 * the reservation.
+	 * This can significantly improve performance of the backfill tests. */
+	node_space_merge(node_space, start_time, end_reserve);
+}
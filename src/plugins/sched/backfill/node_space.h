@@ -0,0 +1,176 @@
+/*****************************************************************************\
+ *  node_space.h - Table of the nodes available over time to backfill jobs
+ *
+ *  This file has been developed by staff and students
+ *  of Heidelberg University as part of the research carried out by the
+ *  Electronic Vision(s) group at the Kirchhoff-Institute for Physics.
+ *  The research is funded by Heidelberg University, the State of
+ *  Baden-Württemberg, the Seventh Framework Programme under grant agreements
+ *  no 604102 (HBP) as well as the Horizon 2020 Framework Programme under grant
+ *  agreement 720270 (HBP).
+\*****************************************************************************/
+
+#ifndef _BACKFILL_NODE_SPACE_H
+#define _BACKFILL_NODE_SPACE_H
+
+#include <time.h>
+
+#include "src/common/bitstring.h"
+#include "src/slurmctld/licenses.h"
+
+/*
+ * The table is an array of records covering consecutive time ranges, linked
+ * in order of time from record 0, which begins at the start of the backfill
+ * cycle. The same records also form a balanced tree (a treap, record 0 being
+ * its root) which holds for each subtree the nodes available throughout it
+ * and the nodes freed anywhere in it. Nodes available throughout a time range
+ * and the next time nodes are freed are found from O(log n) of these
+ * summaries instead of the bitmaps of every record in the range. Nodes
+ * reserved throughout a subtree are only removed from its root and passed down
+ * to the other records of the subtree when the tree is walked below it.
+ *
+ * Only the functions below may add or remove records, or change the
+ * avail_bitmap of a record. The avail_bitmap of records may lack nodes
+ * reserved since node_space_sync() was last called.
+ */
+typedef struct node_space_map {
+	time_t begin_time;
+	time_t end_time;
+	bitstr_t *avail_bitmap;
+	license_avail_t *licenses;	/* licenses available, NULL if none
+					 * configured */
+	int next;	/* next record, by time, zero termination */
+
+	int left, right, parent;	/* tree links, -1 if none */
+	bitstr_t *freed_bitmap;		/* nodes of avail_bitmap not available
+					 * in the previous record */
+	bitstr_t *tree_avail_bitmap;	/* avail_bitmap of all records of the
+					 * subtree ANDed */
+	bitstr_t *tree_freed_bitmap;	/* freed_bitmap of all records of the
+					 * subtree ORed */
+	bitstr_t *tree_res_bitmap;	/* nodes still available in the records
+					 * of the subtree below this one, NULL
+					 * if all */
+} node_space_map_t;
+
+/*
+ * Create a table with a single record
+ * IN max_recs - count of records the table may grow to
+ * IN avail_bitmap - nodes available, owned by the table from now on
+ * IN licenses - licenses available, owned by the table from now on
+ * RET table to be freed by node_space_free()
+ */
+extern node_space_map_t *node_space_create(int max_recs, time_t begin_time,
+					   time_t end_time,
+					   bitstr_t *avail_bitmap,
+					   license_avail_t *licenses);
+
+extern void node_space_free(node_space_map_t *node_space);
+
+/*
+ * Find the record covering a time
+ * RET index of the record, -1 if the time is outside the table
+ */
+extern int node_space_find(node_space_map_t *node_space, time_t when);
+
+/*
+ * Split a record so that a new record begins at the given time
+ * IN j - index of the record covering when, beginning before it
+ * IN/OUT node_space_recs - count of records used, incremented
+ * RET index of the new record
+ */
+extern int node_space_split(node_space_map_t *node_space, int j, time_t when,
+			    int *node_space_recs);
+
+/*
+ * Remove nodes from the records beginning no earlier than start_time and
+ *	ending no later than end_time
+ * IN res_bitmap - nodes which remain available
+ */
+extern void node_space_reserve(node_space_map_t *node_space,
+			       time_t start_time, time_t end_time,
+			       bitstr_t *res_bitmap);
+
+/*
+ * Merge the records covering start_time and end_time with the previous
+ *	record if their nodes and licenses available are identical
+ */
+extern void node_space_merge(node_space_map_t *node_space, time_t start_time,
+			     time_t end_time);
+
+/*
+ * Remove from a bitmap the nodes not available in all records ending after
+ *	end_after and beginning after begin_after, but no later than
+ *	begin_until
+ */
+extern void node_space_avail(node_space_map_t *node_space, time_t end_after,
+			     time_t begin_after, time_t begin_until,
+			     bitstr_t *node_bitmap);
+
+/*
+ * Find when some of the given nodes are freed, after they were unavailable
+ *	in a record ending after start_time and beginning no later than
+ *	end_time (or in the first record beginning after end_time)
+ * RET end of that record, 0 if no nodes are freed
+ */
+extern time_t node_space_freed(node_space_map_t *node_space,
+			       bitstr_t *node_bitmap, time_t start_time,
+			       time_t end_time);
+
+/*
+ * Find the first record beginning after a time in which some of the given
+ *	nodes are not available
+ * RET index of the record, -1 if none
+ */
+extern int node_space_busy(node_space_map_t *node_space,
+			   bitstr_t *node_bitmap, time_t after);
+
+/* Bring the avail_bitmap of all records up to date */
+extern void node_space_sync(node_space_map_t *node_space);
+
+/*
+ * Find when the licenses required by a job are available for its whole
+ *	run time
+ * IN start_res - earliest start time of the job
+ * IN run_time - run time of the job in seconds
+ * IN avail_now - false if the licenses are unavailable in the first record
+ *		  for reasons not recorded in the table
+ * RET earliest start time of the job, the end of the table if the licenses
+ *     are not available within it
+ */
+extern time_t node_space_licenses_start(node_space_map_t *node_space,
+					job_record_t *job_ptr,
+					time_t start_res, time_t run_time,
+					bool avail_now);
+
+/*
+ * Remove the licenses required for a job from the records beginning no
+ *	earlier than start_time and before end_time
+ */
+extern void node_space_licenses_remove(node_space_map_t *node_space,
+				       job_record_t *job_ptr,
+				       time_t start_time, time_t end_time);
+
+/*
+ * Return the licenses allocated to a job to the records beginning no earlier
+ *	than start_time
+ */
+extern void node_space_licenses_return(node_space_map_t *node_space,
+				       job_record_t *job_ptr,
+				       time_t start_time);
+
+/*
+ * Reserve nodes and licenses for a job from start_time until end_reserve,
+ *	splitting records at either end and merging them again where nothing
+ *	changed
+ * IN res_bitmap - nodes available to other jobs during the reservation
+ * IN lic_job_ptr - job whose licenses are reserved, NULL to reserve nodes only
+ * IN/OUT node_space_recs - count of records used
+ */
+extern void node_space_add_reservation(node_space_map_t *node_space,
+				       time_t start_time, time_t end_reserve,
+				       bitstr_t *res_bitmap,
+				       job_record_t *lic_job_ptr,
+				       int *node_space_recs);
+
+#endif /* !_BACKFILL_NODE_SPACE_H */
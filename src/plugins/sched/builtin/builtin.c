@@ -205,6 +205,7 @@ static void _compute_start_times(void)
 				       NULL, NULL,
 				       exc_core_bitmap);
 		if (rc == SLURM_SUCCESS) {
+			job_ptr->last_update = now;
 			last_job_update = now;
 			if (job_ptr->time_limit == INFINITE)
 				time_limit = 365 * 24 * 60 * 60;
@@ -60,7 +60,7 @@ static uint32_t comb_counts[MAX_BOARDS][MAX_BOARDS] =
  {7,21,35,35,21,7,1,0},
  {8,28,56,70,56,28,8,1}};
 
-static int *sockets_core_cnt = NULL;
+static __thread int *sockets_core_cnt = NULL;
 
 /*
  * Generate all combinations of k integers from the
@@ -118,7 +118,7 @@ static int _cmp_int_descend(const void *a, const void *b)
 
 
 /* qsort compare function for board combination socket list
- * NOTE: sockets_core_cnt is a global symbol in this module */
+ * NOTE: sockets_core_cnt is a thread local symbol in this module */
 static int _cmp_sock(const void *a, const void *b)
 {
 	return (sockets_core_cnt[*(int*)b] - sockets_core_cnt[*(int*)a]);
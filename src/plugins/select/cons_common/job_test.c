@@ -214,9 +214,9 @@ static uint16_t _get_job_node_req(job_record_t *job_ptr)
 
 static void _set_gpu_defaults(job_record_t *job_ptr)
 {
-	static part_record_t *last_part_ptr = NULL;
-	static uint64_t last_cpu_per_gpu = NO_VAL64;
-	static uint64_t last_mem_per_gpu = NO_VAL64;
+	static __thread part_record_t *last_part_ptr = NULL;
+	static __thread uint64_t last_cpu_per_gpu = NO_VAL64;
+	static __thread uint64_t last_mem_per_gpu = NO_VAL64;
 	uint64_t cpu_per_gpu, mem_per_gpu;
 
 	if (!is_cons_tres || !job_ptr->gres_list)
@@ -0,0 +1,288 @@
+/*****************************************************************************\
+ *  topology_wafer.c - Topology of the wafer modules of the neuromorphic
+ *  physical model platform, used for neighbor-aware HICANN placement
+ *
+ *  This plugin has been developed by staff and students
+ *  of Heidelberg University as part of the research carried out by the
+ *  Electronic Vision(s) group at the Kirchhoff-Institute for Physics.
+ *  The research is funded by Heidelberg University, the State of
+ *  Baden-Württemberg, the Seventh Framework Programme under grant agreements
+ *  no 604102 (HBP) as well as the Horizon 2020 Framework Programme under grant
+ *  agreement 720270 (HBP).
+\*****************************************************************************/
+
+#include "config.h"
+
+#include <stdbool.h>
+#include <stdlib.h>
+
+#include "hwdb4cpp/hwdb4c.h"
+#include "slurm/slurm_errno.h"
+#include "src/common/bitstring.h"
+#include "src/common/log.h"
+#include "src/common/node_conf.h"
+#include "src/common/slurm_topology.h"
+#include "src/common/xmalloc.h"
+#include "src/common/xstring.h"
+
+#define NUM_FPGAS_ON_WAFER 48
+#define NUM_HICANNS_ON_WAFER 384
+#define MAX_WAFER_ID 128 /* wafer module ids scanned in the hwdb */
+
+/*
+ * These variables are required by the generic plugin interface.  If they
+ * are not found in the plugin, the plugin loader will ignore it.
+ *
+ * plugin_name - a string giving a human-readable description of the
+ * plugin.  There is no maximum length, but the symbol must refer to
+ * a valid string.
+ *
+ * plugin_type - a string suggesting the type of the plugin or its
+ * applicability to a particular form of data or method of data handling.
+ * If the low-level plugin API is used, the contents of this string are
+ * unimportant and may be anything.  Slurm uses the higher-level plugin
+ * interface which requires this string to be of the form
+ *
+ *      <application>/<method>
+ *
+ * where <application> is a description of the intended application of
+ * the plugin (e.g., "task" for task control) and <method> is a description
+ * of how this plugin satisfies that application.  Slurm will only load
+ * a task plugin if the plugin_type string has a prefix of "task/".
+ *
+ * plugin_version - an unsigned 32-bit integer containing the Slurm version
+ * (major.minor.micro combined into a single number).
+ */
+const char plugin_name[]        = "topology wafer plugin";
+const char plugin_type[]        = "topology/wafer";
+const uint32_t plugin_version   = SLURM_VERSION_NUMBER;
+
+#define NUM_HICANN_NEIGHBOR_FUNCS 4
+static int (*hicann_neighbor_funcs[NUM_HICANN_NEIGHBOR_FUNCS])
+	(size_t, size_t *) = {
+	hwdb4c_HICANNOnWafer_east,
+	hwdb4c_HICANNOnWafer_south,
+	hwdb4c_HICANNOnWafer_west,
+	hwdb4c_HICANNOnWafer_north,
+};
+
+static void _free_wafer_topology(void);
+static int _build_wafer_geometry(void);
+static int _build_wafer_records(struct hwdb4c_database_t *hwdb);
+
+/*
+ * init() is called when the plugin is loaded, before any other functions
+ *	are called.  Put global initialization here.
+ */
+extern int init(void)
+{
+	verbose("%s loaded", plugin_name);
+	return SLURM_SUCCESS;
+}
+
+/*
+ * fini() is called when the plugin is removed. Clear any allocated
+ *	storage here.
+ */
+extern int fini(void)
+{
+	_free_wafer_topology();
+	return SLURM_SUCCESS;
+}
+
+/*
+ * topo_build_config - build or rebuild system topology information
+ *	after a system startup or reconfiguration.
+ */
+extern int topo_build_config(void)
+{
+	struct hwdb4c_database_t *hwdb = NULL;
+	int rc = SLURM_ERROR;
+
+	_free_wafer_topology();
+
+	if (hwdb4c_alloc_hwdb(&hwdb) != HWDB4C_SUCCESS) {
+		error("%s: HWDB alloc failed", plugin_type);
+		return SLURM_ERROR;
+	}
+	/* NULL loads the default hwdb */
+	if (hwdb4c_load_hwdb(hwdb, NULL) != HWDB4C_SUCCESS) {
+		error("%s: HWDB load failed", plugin_type);
+		goto fini;
+	}
+
+	if ((_build_wafer_geometry() != SLURM_SUCCESS) ||
+	    (_build_wafer_records(hwdb) != SLURM_SUCCESS)) {
+		_free_wafer_topology();
+		goto fini;
+	}
+	info("%s: found %d wafer modules", plugin_type, wafer_record_cnt);
+	rc = SLURM_SUCCESS;
+
+fini:
+	hwdb4c_free_hwdb(hwdb);
+	return rc;
+}
+
+/*
+ * topo_generate_node_ranking  -  this plugin does not set any node_rank fields
+ */
+extern bool topo_generate_node_ranking(void)
+{
+	return false;
+}
+
+/*
+ * topo_get_node_addr - build node address and the associated pattern
+ *      based on the topology information
+ *
+ * wafer modules are not nodes, so only use node name as the topology address
+ */
+extern int topo_get_node_addr(char* node_name, char** paddr, char** ppattern)
+{
+#ifndef HAVE_FRONT_END
+	if (find_node_record(node_name) == NULL)
+		return SLURM_ERROR;
+#endif
+
+	*paddr = xstrdup(node_name);
+	*ppattern = xstrdup("node");
+	return SLURM_SUCCESS;
+}
+
+static void _free_bitmap_array(bitstr_t **bitmaps, int cnt)
+{
+	int i;
+
+	if (!bitmaps)
+		return;
+	for (i = 0; i < cnt; i++)
+		FREE_NULL_BITMAP(bitmaps[i]);
+	xfree(bitmaps);
+}
+
+static void _free_wafer_topology(void)
+{
+	int i;
+
+	for (i = 0; i < wafer_record_cnt; i++) {
+		FREE_NULL_BITMAP(wafer_record_table[i].hicann_bitmap);
+		FREE_NULL_BITMAP(wafer_record_table[i].reticle_bitmap);
+	}
+	xfree(wafer_record_table);
+	wafer_record_cnt = 0;
+
+	_free_bitmap_array(wafer_hicann_neighbors, wafer_hicann_cnt);
+	wafer_hicann_neighbors = NULL;
+	_free_bitmap_array(wafer_reticle_hicanns, wafer_reticle_cnt);
+	wafer_reticle_hicanns = NULL;
+	_free_bitmap_array(wafer_reticle_neighbors, wafer_reticle_cnt);
+	wafer_reticle_neighbors = NULL;
+	xfree(wafer_hicann_reticle);
+	wafer_hicann_cnt = 0;
+	wafer_reticle_cnt = 0;
+}
+
+/*
+ * Build the layout of HICANNs and reticles common to all wafers: the reticle
+ * of each HICANN and the adjacency of HICANNs and of reticles
+ */
+static int _build_wafer_geometry(void)
+{
+	size_t fpga_id, neighbor_id;
+	int h, i, r;
+
+	wafer_hicann_cnt = NUM_HICANNS_ON_WAFER;
+	wafer_reticle_cnt = NUM_FPGAS_ON_WAFER;
+	wafer_hicann_reticle = xcalloc(wafer_hicann_cnt, sizeof(int));
+	wafer_hicann_neighbors = xcalloc(wafer_hicann_cnt, sizeof(bitstr_t *));
+	wafer_reticle_hicanns = xcalloc(wafer_reticle_cnt, sizeof(bitstr_t *));
+	wafer_reticle_neighbors = xcalloc(wafer_reticle_cnt,
+					  sizeof(bitstr_t *));
+	for (r = 0; r < wafer_reticle_cnt; r++) {
+		wafer_reticle_hicanns[r] = bit_alloc(wafer_hicann_cnt);
+		wafer_reticle_neighbors[r] = bit_alloc(wafer_reticle_cnt);
+	}
+
+	for (h = 0; h < wafer_hicann_cnt; h++) {
+		if (hwdb4c_HICANNOnWafer_toFPGAOnWafer(h, &fpga_id) !=
+		    HWDB4C_SUCCESS) {
+			error("%s: conversion of HICANNOnWafer %d to FPGAOnWafer failed",
+			      plugin_type, h);
+			return SLURM_ERROR;
+		}
+		wafer_hicann_reticle[h] = fpga_id;
+		bit_set(wafer_reticle_hicanns[fpga_id], h);
+		wafer_hicann_neighbors[h] = bit_alloc(wafer_hicann_cnt);
+		for (i = 0; i < NUM_HICANN_NEIGHBOR_FUNCS; i++) {
+			/* HICANNs at the wafer edge lack some neighbors */
+			if (hicann_neighbor_funcs[i](h, &neighbor_id) ==
+			    HWDB4C_SUCCESS)
+				bit_set(wafer_hicann_neighbors[h], neighbor_id);
+		}
+	}
+
+	/* Reticles are adjacent if any of their HICANNs are */
+	for (h = 0; h < wafer_hicann_cnt; h++) {
+		r = wafer_hicann_reticle[h];
+		for (i = 0; i < wafer_hicann_cnt; i++) {
+			if (bit_test(wafer_hicann_neighbors[h], i) &&
+			    (wafer_hicann_reticle[i] != r))
+				bit_set(wafer_reticle_neighbors[r],
+					wafer_hicann_reticle[i]);
+		}
+	}
+
+	return SLURM_SUCCESS;
+}
+
+/*
+ * Build a record of each wafer in the hwdb with its usable reticles and
+ * HICANNs. A HICANN is only usable if the FPGA of its reticle is present.
+ */
+static int _build_wafer_records(struct hwdb4c_database_t *hwdb)
+{
+	wafer_record_t *wafer;
+	bool has_entry;
+	size_t wafer_id;
+	int h, r;
+
+	for (wafer_id = 0; wafer_id < MAX_WAFER_ID; wafer_id++) {
+		if ((hwdb4c_has_wafer_entry(hwdb, wafer_id, &has_entry) !=
+		     HWDB4C_SUCCESS) || !has_entry)
+			continue;
+
+		xrecalloc(wafer_record_table, wafer_record_cnt + 1,
+			  sizeof(wafer_record_t));
+		wafer = &wafer_record_table[wafer_record_cnt++];
+		wafer->wafer_id = wafer_id;
+		wafer->reticle_bitmap = bit_alloc(wafer_reticle_cnt);
+		wafer->hicann_bitmap = bit_alloc(wafer_hicann_cnt);
+
+		for (r = 0; r < wafer_reticle_cnt; r++) {
+			if ((hwdb4c_has_fpga_entry(
+				     hwdb, wafer_id * NUM_FPGAS_ON_WAFER + r,
+				     &has_entry) != HWDB4C_SUCCESS) ||
+			    !has_entry)
+				continue;
+			bit_set(wafer->reticle_bitmap, r);
+		}
+		for (h = 0; h < wafer_hicann_cnt; h++) {
+			if (!bit_test(wafer->reticle_bitmap,
+				      wafer_hicann_reticle[h]))
+				continue;
+			if ((hwdb4c_has_hicann_entry(
+				     hwdb, wafer_id * NUM_HICANNS_ON_WAFER + h,
+				     &has_entry) != HWDB4C_SUCCESS) ||
+			    !has_entry)
+				continue;
+			bit_set(wafer->hicann_bitmap, h);
+		}
+		debug("%s: wafer %zu has %d reticles and %d HICANNs",
+		      plugin_type, wafer_id,
+		      bit_set_count(wafer->reticle_bitmap),
+		      bit_set_count(wafer->hicann_bitmap));
+	}
+
+	return SLURM_SUCCESS;
+}
@@ -1104,6 +1104,7 @@ static void _usage(void)
 "              [--switches=max-switches{@max-time-to-wait}] [--reboot]\n"
 "              [--core-spec=cores] [--thread-spec=threads]\n"
 "              [--bb=burst_buffer_spec] [--bbf=burst_buffer_file]\n"
+"              [--batch-file=file]\n"
 "              [--array=index_values] [--profile=...] [--ignore-pbs] [--spread-job]\n"
 "              [--export[=names]] [--export-file=file|fd] [--delay-boot=mins]\n"
 "              [--use-min-nodes]\n"
@@ -1123,6 +1124,8 @@ static void _help(void)
 "Parallel run options:\n"
 "  -a, --array=indexes         job array index values\n"
 "  -A, --account=name          charge job to specified account\n"
+"      --batch-file=file       submit one job per line of file, each line\n"
+"                              holding additional options of the job\n"
 "      --bb=<spec>             burst buffer specifications\n"
 "      --bbf=<file_name>       burst buffer specification file\n"
 "  -b, --begin=time            defer job until HH:MM MM/DD/YY\n"
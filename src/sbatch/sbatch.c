@@ -38,6 +38,7 @@
  *  51 Franklin Street, Fifth Floor, Boston, MA 02110-1301  USA.
 \*****************************************************************************/
 
+#include <ctype.h>
 #include <fcntl.h>
 #include <pwd.h>
 #include <stdio.h>
@@ -75,6 +76,7 @@ static void  _env_merge_filter(job_desc_msg_t *desc);
 static int   _fill_job_desc_from_opts(job_desc_msg_t *desc);
 static void *_get_script_buffer(const char *filename, int *size);
 static int   _job_wait(uint32_t job_id);
+static void  _post_opt_setup(void);
 static char *_script_wrap(char *command_string);
 static void  _set_exit_code(void);
 static void  _set_prio_process_env(void);
@@ -82,6 +84,9 @@ static int   _set_rlimit_env(void);
 static void  _set_spank_env(void);
 static void  _set_submit_dir_env(void);
 static int   _set_umask_env(void);
+static int   _submit_batch_file(int argc, char **argv, char *script_name,
+				char *script_body, int script_size,
+				bool quiet);
 
 int main(int argc, char **argv)
 {
@@ -139,6 +144,10 @@ int main(int argc, char **argv)
 	if (script_body == NULL)
 		exit(error_exit);
 
+	if (sbopt.batch_file)
+		return _submit_batch_file(argc, argv, script_name, script_body,
+					  script_size, quiet);
+
 	het_job_argc = argc - sbopt.script_argc;
 	het_job_argv = argv;
 	for (het_job_inx = 0; !het_job_fini; het_job_inx++) {
@@ -175,29 +184,7 @@ int main(int argc, char **argv)
 			free_buf(buf);
 		}
 
-		if (spank_init_post_opt() < 0) {
-			error("Plugin stack post-option processing failed");
-			exit(error_exit);
-		}
-
-		if (opt.get_user_env_time < 0) {
-			/* Moab doesn't propagate the user's resource limits, so
-			 * slurmd determines the values at the same time that it
-			 * gets the user's default environment variables. */
-			(void) _set_rlimit_env();
-		}
-
-		/*
-		 * if the environment is coming from a file, the
-		 * environment at execution startup, must be unset.
-		 */
-		if (sbopt.export_file != NULL)
-			env_unset_environment();
-
-		_set_prio_process_env();
-		_set_spank_env();
-		_set_submit_dir_env();
-		_set_umask_env();
+		_post_opt_setup();
 		if (local_env && !job_env_list) {
 			job_env_list = list_create(NULL);
 			list_append(job_env_list, local_env);
@@ -356,6 +343,170 @@ int main(int argc, char **argv)
 	return rc;
 }
 
+/* Set up plugins and environment after the options of a job were processed */
+static void _post_opt_setup(void)
+{
+	if (spank_init_post_opt() < 0) {
+		error("Plugin stack post-option processing failed");
+		exit(error_exit);
+	}
+
+	if (opt.get_user_env_time < 0) {
+		/* Moab doesn't propagate the user's resource limits, so
+		 * slurmd determines the values at the same time that it
+		 * gets the user's default environment variables. */
+		(void) _set_rlimit_env();
+	}
+
+	/*
+	 * if the environment is coming from a file, the
+	 * environment at execution startup, must be unset.
+	 */
+	if (sbopt.export_file != NULL)
+		env_unset_environment();
+
+	_set_prio_process_env();
+	_set_spank_env();
+	_set_submit_dir_env();
+	_set_umask_env();
+}
+
+/*
+ * Submit one job per line of the file given by --batch-file in one RPC. Each
+ * line holds whitespace separated options which are added to the options
+ * given on the command line for that job, e.g. the wafer modules of a job.
+ * Empty lines and lines starting with '#' are ignored.
+ */
+static int _submit_batch_file(int argc, char **argv, char *script_name,
+			      char *script_body, int script_size, bool quiet)
+{
+	List job_req_list = list_create((ListDelF) slurm_free_job_desc_msg);
+	submit_batch_response_msg_t *resp = NULL;
+	job_desc_msg_t *desc;
+	Buf buf;
+	char *line, *tok, *save_ptr = NULL, *line_ptr = NULL;
+	char **job_argv;
+	int opt_argc = argc - sbopt.script_argc, job_argc, job_argc_off;
+	int i, rc = SLURM_SUCCESS, retries = 0, line_cnt = 0;
+	bool more_het_comps;
+
+	for (i = 0; i < argc; i++) {
+		if (!xstrcmp(argv[i], ":")) {
+			error("--batch-file can not be used with heterogeneous jobs");
+			exit(error_exit);
+		}
+	}
+	if (sbopt.test_only || sbopt.wait || opt.clusters) {
+		error("--batch-file can not be used with --test-only, --wait or --clusters");
+		exit(error_exit);
+	}
+	if (!(buf = create_mmap_buf(sbopt.batch_file))) {
+		error("Invalid --batch-file specification");
+		exit(error_exit);
+	}
+
+	/* room for the command line, the options of a line and a NULL */
+	job_argv = xcalloc(argc + size_buf(buf) / 2 + 2, sizeof(char *));
+	while ((line = next_line(get_buf_data(buf), size_buf(buf),
+				 (void **) &line_ptr))) {
+		line_cnt++;
+		for (tok = line; isspace((int) *tok); tok++)
+			;
+		if ((*tok == '\0') || (*tok == '#')) {
+			xfree(line);
+			continue;
+		}
+
+		/* argv[0] and the options, the line, then the script and its
+		 * arguments */
+		job_argc = 0;
+		for (i = 0; i < opt_argc; i++)
+			job_argv[job_argc++] = argv[i];
+		tok = strtok_r(line, " \t", &save_ptr);
+		while (tok) {
+			job_argv[job_argc++] = tok;
+			tok = strtok_r(NULL, " \t", &save_ptr);
+		}
+		for (i = opt_argc; i < argc; i++)
+			job_argv[job_argc++] = argv[i];
+		job_argv[job_argc] = NULL;
+
+		init_envs(&het_job_env);
+		job_argc_off = 0;
+		process_options_second_pass(job_argc, job_argv, &job_argc_off,
+					    0, &more_het_comps, script_name ?
+					    xbasename(script_name) : "stdin",
+					    script_body, script_size);
+		if (opt.burst_buffer_file) {
+			error("--bbf can not be used with --batch-file");
+			exit(error_exit);
+		}
+		_post_opt_setup();
+
+		desc = xmalloc(sizeof(job_desc_msg_t));
+		slurm_init_job_desc_msg(desc);
+		if (_fill_job_desc_from_opts(desc) == -1) {
+			error("Invalid options in line %d of --batch-file",
+			      line_cnt);
+			exit(error_exit);
+		}
+		set_env_from_opts(&opt, &desc->environment, -1);
+		desc->script = xstrdup(script_body);
+		set_envs(&desc->environment, &het_job_env, -1);
+		desc->env_size = envcount(desc->environment);
+		list_append(job_req_list, desc);
+		xfree(line);
+	}
+	xfree(job_argv);
+	free_buf(buf);
+
+	if (list_count(job_req_list) == 0) {
+		error("No jobs in --batch-file %s", sbopt.batch_file);
+		exit(error_exit);
+	}
+
+	while (slurm_submit_batch_jobs(job_req_list, &resp) < 0) {
+		if (((errno != ESLURM_ERROR_ON_DESC_TO_RECORD_COPY) &&
+		     (errno != EAGAIN)) || (retries >= MAX_RETRIES)) {
+			error("Batch job submission failed: %m");
+			exit(error_exit);
+		}
+		if (retries)
+			debug("Slurm temporarily unable to accept jobs, sleeping and retrying");
+		else
+			error("Slurm temporarily unable to accept jobs, sleeping and retrying");
+		sleep(++retries);
+	}
+	if (!resp) {
+		error("Batch job submission failed: %m");
+		exit(error_exit);
+	}
+
+	print_multi_line_string(resp->job_submit_user_msg, -1, LOG_LEVEL_INFO);
+
+	for (i = 0; i < resp->job_cnt; i++) {
+		if (!resp->job_id[i]) {
+			error("Batch job %d submission failed: %s", i,
+			      slurm_strerror(resp->error_code[i]));
+			rc = error_exit;
+			continue;
+		}
+		cli_filter_plugin_post_submit(0, resp->job_id[i], NO_VAL);
+		if (quiet)
+			continue;
+		if (!sbopt.parsable)
+			printf("Submitted batch job %u\n", resp->job_id[i]);
+		else
+			printf("%u\n", resp->job_id[i]);
+	}
+
+	slurm_free_submit_batch_response_msg(resp);
+	FREE_NULL_LIST(job_req_list);
+	xfree(script_body);
+
+	return rc;
+}
+
 /* Insert the contents of "burst_buffer_file" into "script_body" */
 static void  _add_bb_to_script(char **script_body, char *burst_buffer_file)
 {
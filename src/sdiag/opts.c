@@ -72,6 +72,7 @@ extern void parse_command_line(int argc, char **argv)
 	static struct option long_options[] = {
 		{"all",		no_argument,	0,	'a'},
 		{"help",	no_argument,	0,	'h'},
+		{"licenses",	no_argument,	0,	'l'},
 		{"reset",	no_argument,	0,	'r'},
 		{"sort-by-id",	no_argument,	0,	'i'},
 		{"cluster",     required_argument, 0,   'M'},
@@ -90,7 +91,7 @@ extern void parse_command_line(int argc, char **argv)
 	/* get defaults from environment */
 	_opt_env();
 
-	while ((opt_char = getopt_long(argc, argv, "ahiM:rtTV", long_options,
+	while ((opt_char = getopt_long(argc, argv, "ahilM:rtTV", long_options,
 				       &option_index)) != -1) {
 		switch (opt_char) {
 			case (int)'?':
@@ -108,6 +109,9 @@ extern void parse_command_line(int argc, char **argv)
 			case (int)'i':
 				params.sort = SORT_ID;
 				break;
+			case (int)'l':
+				params.licenses = true;
+				break;
 			case (int)'M':
 				if (params.clusters)
 					FREE_NULL_LIST(params.clusters);
@@ -147,7 +151,7 @@ extern void parse_command_line(int argc, char **argv)
 
 static void _usage( void )
 {
-	printf("Usage: sdiag [-M cluster] [-aritT] \n");
+	printf("Usage: sdiag [-M cluster] [-ailrtT] \n");
 }
 
 static void _help( void )
@@ -155,6 +159,7 @@ static void _help( void )
 	printf ("\
 Usage: sdiag [OPTIONS]\n\
   -a, --all           all statistics\n\
+  -l, --licenses      license usage, including license group members\n\
   -r, --reset         reset statistics\n\
   -M, --cluster       direct the request to a specific cluster\n\
   -i, --sort-by-id    sort RPCs by id\n\
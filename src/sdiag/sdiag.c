@@ -58,6 +58,8 @@ struct sdiag_parameters params;
 stats_info_response_msg_t *buf;
 uint32_t *rpc_type_ave_time = NULL, *rpc_user_ave_time = NULL;
 
+static int  _print_licenses(void);
+static void _print_lock_stats(void);
 static int  _print_stats(void);
 static void _sort_rpc(void);
 
@@ -72,7 +74,9 @@ int main(int argc, char **argv)
 	slurm_conf_init(NULL);
 	parse_command_line(argc, argv);
 
-	if (params.mode == STAT_COMMAND_RESET) {
+	if (params.licenses) {
+		rc = _print_licenses();
+	} else if (params.mode == STAT_COMMAND_RESET) {
 		req.command_id = STAT_COMMAND_RESET;
 		rc = slurm_reset_statistics((stats_info_request_msg_t *)&req);
 		if (rc == SLURM_SUCCESS)
@@ -98,6 +102,39 @@ int main(int argc, char **argv)
 	exit(rc);
 }
 
+static int _print_licenses(void)
+{
+	license_usage_msg_t *lic_usage = NULL;
+	slurm_license_usage_t *lic;
+	int i;
+
+	if (slurm_load_license_usage((time_t) 0, &lic_usage)) {
+		slurm_perror("slurm_load_license_usage");
+		return -1;
+	}
+
+	printf("*******************************************************\n");
+	printf("License usage at %s (%ld)\n",
+	       slurm_ctime2(&lic_usage->last_update), lic_usage->last_update);
+	printf("*******************************************************\n");
+
+	for (i = 0; i < lic_usage->num_lic; i++) {
+		lic = &lic_usage->lic_array[i];
+		printf("%s:%s total:%u in use:%u reserved:%u available:%u\n",
+		       lic->name, lic->remote ? " (remote)" : "",
+		       lic->total, lic->in_use, lic->reserved, lic->available);
+		if (!lic->members)
+			continue;
+		printf("\tMembers:   %s\n", lic->members);
+		printf("\tIn use:    %s\n", lic->in_use_members);
+		printf("\tReserved:  %s\n", lic->reserved_members);
+		printf("\tAvailable: %s\n", lic->avail_members);
+	}
+
+	slurm_free_license_usage_msg(lic_usage);
+	return 0;
+}
+
 static int _print_stats(void)
 {
 	int i;
@@ -192,6 +229,69 @@ static int _print_stats(void)
 		printf("\tMean table size: %u\n",
 		       buf->bf_table_size_sum / buf->bf_cycle_counter);
 	}
+	if (buf->bf_plan_full || buf->bf_plan_incr) {
+		printf("\tPlan cycles full/incremental: %u/%u\n",
+		       buf->bf_plan_full, buf->bf_plan_incr);
+		printf("\tLast cycle jobs reusing plan: %u\n",
+		       buf->bf_plan_last_reused);
+		printf("\tJobs reusing plan mean: %u\n",
+		       buf->bf_plan_reused_sum /
+		       (buf->bf_plan_full + buf->bf_plan_incr));
+	}
+
+	printf("\nInfo response cache (hits/misses)\n");
+	printf("\tJobs:       %u/%u\n", buf->job_info_cache_hits,
+	       buf->job_info_cache_misses);
+	printf("\tNodes:      %u/%u\n", buf->node_info_cache_hits,
+	       buf->node_info_cache_misses);
+	printf("\tPartitions: %u/%u\n", buf->part_info_cache_hits,
+	       buf->part_info_cache_misses);
+
+	if (buf->rpc_class_cnt) {
+		printf("\nRPC worker pool: %u workers\n", buf->rpc_workers);
+		for (i = 0; i < buf->rpc_class_cnt; i++) {
+			rpc_class_stats_t *rec = &buf->rpc_class_stats[i];
+
+			printf("\t%-8s workers:%u/%-4u queued:%-6u count:%-8"PRIu64" ave_wait:%-6"PRIu64" max_wait:%u\n",
+			       rec->name, rec->active, rec->max_workers,
+			       rec->queued, rec->cnt,
+			       rec->cnt ? (rec->wait_usec / rec->cnt) : 0,
+			       rec->wait_max_usec);
+		}
+	}
+
+	if (buf->state_file_cnt) {
+		printf("\nState files (times in microseconds)\n");
+		for (i = 0; i < buf->state_file_cnt; i++) {
+			state_file_stats_t *rec = &buf->state_file_stats[i];
+
+			printf("	%-18s packed:%-6u written:%-6u ave_lock:%-6"PRIu64" max_lock:%-6u ave_io:%-6"PRIu64" max_io:%-6u size:%u\n",
+			       rec->name, rec->packed, rec->written,
+			       rec->packed ? (rec->lock_usec / rec->packed) : 0,
+			       rec->lock_max_usec,
+			       rec->written ? (rec->io_usec / rec->written) : 0,
+			       rec->io_max_usec, rec->size);
+		}
+	}
+
+	if (buf->job_rec_locks) {
+		printf("\nFine grained job locks\n");
+		printf("\tRPCs:                %u\n", buf->job_rec_lock_rpcs);
+		printf("\tLocks taken:         %"PRIu64"\n",
+		       buf->job_rec_lock_cnt);
+		printf("\tLocks waited for:    %"PRIu64"\n",
+		       buf->job_rec_lock_wait_cnt);
+		if (buf->job_rec_lock_wait_cnt) {
+			printf("\tMean wait time:      %"PRIu64" us\n",
+			       buf->job_rec_lock_wait_usec /
+			       buf->job_rec_lock_wait_cnt);
+		}
+		printf("\tMax wait time:       %u us\n",
+		       buf->job_rec_lock_wait_max);
+	}
+
+	if (buf->lock_stats_cnt)
+		_print_lock_stats();
 
 	printf("\nLatency for 1000 calls to gettimeofday(): %d microseconds\n",
 	       buf->gettimeofday_latency);
@@ -212,9 +312,10 @@ static int _print_stats(void)
 			xstrfmtcat(user, "%u", buf->rpc_user_id[i]);
 
 		printf("\t%-16s(%8u) count:%-6u "
-		       "ave_time:%-6u total_time:%"PRIu64"\n",
+		       "ave_time:%-6u total_time:%"PRIu64" limited:%u\n",
 		       user, buf->rpc_user_id[i], buf->rpc_user_cnt[i],
-		       rpc_user_ave_time[i], buf->rpc_user_time[i]);
+		       rpc_user_ave_time[i], buf->rpc_user_time[i],
+		       buf->rpc_user_limited[i]);
 
 		xfree(user);
 	}
@@ -243,11 +344,58 @@ static int _print_stats(void)
 	return 0;
 }
 
+/* Sort by total time held, descending */
+static int _cmp_lock_stats(const void *x, const void *y)
+{
+	const lock_stats_t *a = x, *b = y;
+
+	if (a->hold_usec > b->hold_usec)
+		return -1;
+	if (a->hold_usec < b->hold_usec)
+		return 1;
+	return 0;
+}
+
+static void _print_lock_hist(char *name, uint64_t usec, uint32_t max_usec,
+			     uint64_t cnt, uint32_t *hist)
+{
+	int i;
+
+	printf("\t\t%s ave:%"PRIu64" max:%u hist:", name, usec / cnt,
+	       max_usec);
+	for (i = 0; i < LOCK_STATS_HIST_CNT; i++)
+		printf("%s%u", i ? " " : "", hist[i]);
+	printf("\n");
+}
+
+static void _print_lock_stats(void)
+{
+	lock_stats_t *rec;
+	int i;
+
+	qsort(buf->lock_stats, buf->lock_stats_cnt, sizeof(lock_stats_t),
+	      _cmp_lock_stats);
+
+	printf("\nLock statistics by caller, sorted by total time held\n");
+	printf("\tTimes in microseconds, histogram buckets <1 <10 <100 <1K <10K <100K <1M >=1M\n");
+	for (i = 0, rec = buf->lock_stats; i < buf->lock_stats_cnt;
+	     i++, rec++) {
+		if (!rec->cnt)
+			continue;
+		printf("\t%-15s %-5s %-40s count:%"PRIu64"\n", rec->lock,
+		       rec->write ? "write" : "read", rec->caller, rec->cnt);
+		_print_lock_hist("wait", rec->wait_usec, rec->wait_max_usec,
+				 rec->cnt, rec->wait_hist);
+		_print_lock_hist("hold", rec->hold_usec, rec->hold_max_usec,
+				 rec->cnt, rec->hold_hist);
+	}
+}
+
 static void _sort_rpc(void)
 {
 	int i, j;
 	uint16_t type_id;
-	uint32_t type_ave, type_cnt, user_ave, user_cnt, user_id;
+	uint32_t type_ave, type_cnt, user_ave, user_cnt, user_id, user_limited;
 	uint64_t type_time, user_time;
 
 	rpc_type_ave_time = xmalloc(sizeof(uint32_t) * buf->rpc_type_size);
@@ -280,12 +428,15 @@ static void _sort_rpc(void)
 				user_id   = buf->rpc_user_id[i];
 				user_cnt  = buf->rpc_user_cnt[i];
 				user_time = buf->rpc_user_time[i];
+				user_limited = buf->rpc_user_limited[i];
 				buf->rpc_user_id[i]   = buf->rpc_user_id[j];
 				buf->rpc_user_cnt[i]  = buf->rpc_user_cnt[j];
 				buf->rpc_user_time[i] = buf->rpc_user_time[j];
+				buf->rpc_user_limited[i] = buf->rpc_user_limited[j];
 				buf->rpc_user_id[j]   = user_id;
 				buf->rpc_user_cnt[j]  = user_cnt;
 				buf->rpc_user_time[j] = user_time;
+				buf->rpc_user_limited[j] = user_limited;
 			}
 			if (buf->rpc_user_cnt[i]) {
 				rpc_user_ave_time[i] = buf->rpc_user_time[i] /
@@ -319,12 +470,15 @@ static void _sort_rpc(void)
 				user_id   = buf->rpc_user_id[i];
 				user_cnt  = buf->rpc_user_cnt[i];
 				user_time = buf->rpc_user_time[i];
+				user_limited = buf->rpc_user_limited[i];
 				buf->rpc_user_id[i]   = buf->rpc_user_id[j];
 				buf->rpc_user_cnt[i]  = buf->rpc_user_cnt[j];
 				buf->rpc_user_time[i] = buf->rpc_user_time[j];
+				buf->rpc_user_limited[i] = buf->rpc_user_limited[j];
 				buf->rpc_user_id[j]   = user_id;
 				buf->rpc_user_cnt[j]  = user_cnt;
 				buf->rpc_user_time[j] = user_time;
+				buf->rpc_user_limited[j] = user_limited;
 			}
 			if (buf->rpc_user_cnt[i]) {
 				rpc_user_ave_time[i] = buf->rpc_user_time[i] /
@@ -370,14 +524,17 @@ static void _sort_rpc(void)
 				user_id   = buf->rpc_user_id[i];
 				user_cnt  = buf->rpc_user_cnt[i];
 				user_time = buf->rpc_user_time[i];
+				user_limited = buf->rpc_user_limited[i];
 				rpc_user_ave_time[i]  = rpc_user_ave_time[j];
 				buf->rpc_user_id[i]   = buf->rpc_user_id[j];
 				buf->rpc_user_cnt[i]  = buf->rpc_user_cnt[j];
 				buf->rpc_user_time[i] = buf->rpc_user_time[j];
+				buf->rpc_user_limited[i] = buf->rpc_user_limited[j];
 				rpc_user_ave_time[j]  = user_ave;
 				buf->rpc_user_id[j]   = user_id;
 				buf->rpc_user_cnt[j]  = user_cnt;
 				buf->rpc_user_time[j] = user_time;
+				buf->rpc_user_limited[j] = user_limited;
 			}
 		}
 	} else { /* sort by count */
@@ -407,12 +564,15 @@ static void _sort_rpc(void)
 				user_id   = buf->rpc_user_id[i];
 				user_cnt  = buf->rpc_user_cnt[i];
 				user_time = buf->rpc_user_time[i];
+				user_limited = buf->rpc_user_limited[i];
 				buf->rpc_user_id[i]   = buf->rpc_user_id[j];
 				buf->rpc_user_cnt[i]  = buf->rpc_user_cnt[j];
 				buf->rpc_user_time[i] = buf->rpc_user_time[j];
+				buf->rpc_user_limited[i] = buf->rpc_user_limited[j];
 				buf->rpc_user_id[j]   = user_id;
 				buf->rpc_user_cnt[j]  = user_cnt;
 				buf->rpc_user_time[j] = user_time;
+				buf->rpc_user_limited[j] = user_limited;
 			}
 			if (buf->rpc_user_cnt[i]) {
 				rpc_user_ave_time[i] = buf->rpc_user_time[i] /
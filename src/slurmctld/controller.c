@@ -53,6 +53,7 @@
 #include <stdlib.h>
 #include <string.h>
 #include <sys/resource.h>
+#include <sys/socket.h>
 #include <sys/stat.h>
 #include <unistd.h>
 
@@ -112,8 +113,11 @@
 #include "src/slurmctld/powercapping.h"
 #include "src/slurmctld/preempt.h"
 #include "src/slurmctld/proc_req.h"
+#include "src/slurmctld/rate_limit.h"
 #include "src/slurmctld/read_config.h"
 #include "src/slurmctld/reservation.h"
+#include "src/slurmctld/resp_cache.h"
+#include "src/slurmctld/rpc_pool.h"
 #include "src/slurmctld/sched_plugin.h"
 #include "src/slurmctld/slurmctld.h"
 #include "src/slurmctld/slurmctld_plugstack.h"
@@ -212,6 +216,8 @@ static int	recover   = DEFAULT_RECOVER;
 static pthread_mutex_t sched_cnt_mutex = PTHREAD_MUTEX_INITIALIZER;
 static pid_t	slurmctld_pid;
 static char *	slurm_conf_filename;
+static bool	rpc_mgr_paused = false;	/* protected by thread_count_lock */
+static int	rpc_wake_fd[2] = { -1, -1 };
 
 /*
  * Static list of signals to block in this process
@@ -228,6 +234,21 @@ typedef struct primary_thread_arg {
 	char *prog_type;
 } primary_thread_arg_t;
 
+/* Accepted connection waiting for its request to arrive */
+typedef struct {
+	connection_arg_t *conn;
+	time_t accepted;
+	int peek_cnt;		/* times the header was found incomplete */
+} pending_conn_t;
+
+/*
+ * Bytes of a request to peek at: message length, then header version,
+ * flags, msg_index and msg_type
+ */
+#define PEEK_HEADER_SIZE 12
+/* Queue a connection with an incomplete header after this many polls */
+#define MAX_HEADER_PEEKS 10
+
 static int          _accounting_cluster_ready();
 static int          _accounting_mark_all_nodes_down(char *reason);
 static void *       _assoc_cache_mgr(void *no_data);
@@ -236,6 +257,7 @@ static void         _become_slurm_user(void);
 static void         _create_clustername_file(void);
 static void         _default_sigaction(int sig);
 static void         _get_fed_updates();
+static bool         _get_server_thread(void);
 static void         _init_config(void);
 static void         _init_pidfile(void);
 static int          _init_tres(void);
@@ -245,7 +267,7 @@ static void *       _purge_files_thread(void *no_data);
 static void         _remove_assoc(slurmdb_assoc_rec_t *rec);
 static void         _remove_qos(slurmdb_qos_rec_t *rec);
 static void         _run_primary_prog(bool primary_on);
-static void *       _service_connection(void *arg);
+static void         _service_connection(connection_arg_t *conn);
 static void         _set_work_dir(void);
 static int          _shutdown_backup_controller(void);
 static void *       _slurmctld_background(void *no_data);
@@ -260,7 +282,6 @@ static void         _update_nice(void);
 static void         _update_qos(slurmdb_qos_rec_t *rec);
 inline static void  _usage(char *prog_name);
 static bool         _verify_clustername(void);
-static bool         _wait_for_server_thread(void);
 static void *       _wait_primary_prog(void *arg);
 
 /* main - slurmctld main function, start various threads and process RPCs */
@@ -908,6 +929,8 @@ int main(int argc, char **argv)
 	assoc_mgr_fini(1);
 	reserve_port_config(NULL);
 	free_rpc_stats();
+	rate_limit_fini();
+	resp_cache_fini();
 
 	/* Some plugins are needed to purge job/node data structures,
 	 * unplug after other data structures are purged */
@@ -1132,7 +1155,45 @@ static void _sig_handler(int signal)
 }
 
 /*
- * _slurmctld_rpc_mgr - Read incoming RPCs and create pthread for each
+ * Peek at the message type in the header of a connection's request, without
+ * receiving it. RET -1 if not fully arrived yet, 0 if of an unknown version.
+ */
+static int _peek_msg_type(int fd)
+{
+	uint16_t hdr[PEEK_HEADER_SIZE / 2];
+	ssize_t len;
+
+	len = recv(fd, hdr, sizeof(hdr), MSG_PEEK | MSG_DONTWAIT);
+	if (len <= 0)
+		return 0;	/* closed or failed, let the worker report it */
+	if (len < (ssize_t) sizeof(hdr))
+		return -1;
+	if (ntohs(hdr[2]) < SLURM_MIN_PROTOCOL_VERSION)
+		return 0;
+	return ntohs(hdr[5]);
+}
+
+/*
+ * Set the bytes to be received before poll() reports a connection readable.
+ * Where poll() ignores it, headers arriving in pieces are retried instead.
+ */
+static void _set_rcvlowat(int fd, int bytes)
+{
+	if (setsockopt(fd, SOL_SOCKET, SO_RCVLOWAT, &bytes, sizeof(bytes)))
+		debug("%s: setsockopt(SO_RCVLOWAT): %m", __func__);
+}
+
+/* Wake up _slurmctld_rpc_mgr from poll() */
+static void _wake_rpc_mgr(void)
+{
+	if ((rpc_wake_fd[1] >= 0) && (write(rpc_wake_fd[1], "w", 1) < 0) &&
+	    (errno != EAGAIN))
+		error("%s: write: %m", __func__);
+}
+
+/*
+ * _slurmctld_rpc_mgr - Accept incoming connections and queue them for the
+ *	RPC worker threads once their request arrived
  */
 static void *_slurmctld_rpc_mgr(void *no_data)
 {
@@ -1140,9 +1201,13 @@ static void *_slurmctld_rpc_mgr(void *no_data)
 	struct pollfd *fds;
 	slurm_addr_t cli_addr, srv_addr;
 	uint16_t port;
-	char ip[32];
-	int fd_next = 0, i, nports;
+	char ip[32], addr_buf[32];
+	int i, j, nports, nfds, pending_cnt = 0, msg_timeout, msg_type;
+	bool accepting;
 	connection_arg_t *conn_arg = NULL;
+	pending_conn_t *pending;
+	time_t now;
+	char buf[64];
 	/* Locks: Read config */
 	slurmctld_lock_t config_read_lock = {
 		READ_LOCK, NO_LOCK, NO_LOCK, NO_LOCK, NO_LOCK };
@@ -1158,6 +1223,15 @@ static void *_slurmctld_rpc_mgr(void *no_data)
 	(void) pthread_setcanceltype(PTHREAD_CANCEL_ASYNCHRONOUS, NULL);
 	debug3("%s pid = %u", __func__, getpid());
 
+	if (pipe(rpc_wake_fd) < 0) {
+		fatal("%s: pipe: %m", __func__);
+		return NULL;	/* Fix CLANG false positive */
+	}
+	for (i = 0; i < 2; i++) {
+		fd_set_nonblocking(rpc_wake_fd[i]);
+		fd_set_close_on_exec(rpc_wake_fd[i]);
+	}
+
 	/* initialize ports for RPCs */
 	lock_slurmctld(config_read_lock);
 	nports = slurmctld_conf.slurmctld_port_count;
@@ -1165,10 +1239,18 @@ static void *_slurmctld_rpc_mgr(void *no_data)
 		fatal("slurmctld port count is zero");
 		return NULL;	/* Fix CLANG false positive */
 	}
-	fds = xcalloc(nports, sizeof(struct pollfd));
-	for (i = 0; i < nports; i++) {
+	/*
+	 * Poll the wake up pipe, the listening ports and each accepted
+	 * connection until its request arrives. Accepted connections count
+	 * against max_server_threads until processed.
+	 */
+	fds = xcalloc(1 + nports + max_server_threads, sizeof(struct pollfd));
+	pending = xcalloc(max_server_threads, sizeof(pending_conn_t));
+	fds[0].fd = rpc_wake_fd[0];
+	fds[0].events = POLLIN;
+	for (i = 1; i <= nports; i++) {
 		fds[i].fd = slurm_init_msg_engine_port(
-			slurmctld_conf.slurmctld_port + i);
+			slurmctld_conf.slurmctld_port + i - 1);
 		fds[i].events = POLLIN;
 		if (fds[i].fd == SLURM_ERROR) {
 			fatal("slurm_init_msg_engine_port error %m");
@@ -1182,10 +1264,11 @@ static void *_slurmctld_rpc_mgr(void *no_data)
 			debug2("slurmctld listening on %s:%d", ip, ntohs(port));
 		}
 	}
+	rpc_pool_init(_service_connection, max_server_threads);
 	unlock_slurmctld(config_read_lock);
 
 	/*
-	 * Prepare to catch SIGUSR1 to interrupt accept().
+	 * Prepare to catch SIGUSR1 to interrupt poll().
 	 * This signal is generated by the slurmctld signal
 	 * handler thread upon receipt of SIGABRT, SIGINT,
 	 * or SIGTERM. That thread does all processing of
@@ -1197,83 +1280,135 @@ static void *_slurmctld_rpc_mgr(void *no_data)
 	/*
 	 * Process incoming RPCs until told to shutdown
 	 */
-	while (_wait_for_server_thread()) {
-		if (poll(fds, nports, -1) == -1) {
+	while (!slurmctld_config.shutdown_time) {
+		/* Stop accepting while at max_server_threads */
+		slurm_mutex_lock(&slurmctld_config.thread_count_lock);
+		accepting = (slurmctld_config.server_thread_count <
+			     max_server_threads);
+		rpc_mgr_paused = !accepting;
+		slurm_mutex_unlock(&slurmctld_config.thread_count_lock);
+
+		for (i = 1; i <= nports; i++)
+			fds[i].events = accepting ? POLLIN : 0;
+		nfds = 1 + nports;
+		for (i = 0; i < pending_cnt; i++, nfds++) {
+			fds[nfds].fd = pending[i].conn->newsockfd;
+			fds[nfds].events = POLLIN;
+		}
+
+		if (poll(fds, nfds, 1000) == -1) {
 			if (errno != EINTR)
-				error("slurm_accept_msg_conn select: %m");
-			server_thread_decr();
+				error("%s: poll: %m", __func__);
 			continue;
 		}
 
-		/* find one to process */
-		for (i = 0; i < nports; i++) {
-			if (fds[(fd_next + i) % nports].revents) {
-				i = (fd_next + i) % nports;
-				break;
-			}
+		if (fds[0].revents) {
+			while (read(rpc_wake_fd[0], buf, sizeof(buf)) > 0)
+				;
 		}
-		fd_next = (i + 1) % nports;
 
-		/*
-		 * accept needed for stream implementation is a no-op in
-		 * message implementation that just passes sockfd to newsockfd
-		 */
-		if ((newsockfd = slurm_accept_msg_conn(fds[i].fd, &cli_addr))
-		    == SLURM_ERROR) {
-			if (errno != EINTR)
-				error("slurm_accept_msg_conn: %m");
-			server_thread_decr();
-			continue;
+		/* Queue connections whose request arrived, keep the others */
+		now = time(NULL);
+		msg_timeout = slurm_get_msg_timeout();
+		for (i = 0, j = 0; i < pending_cnt; i++) {
+			conn_arg = pending[i].conn;
+			if (fds[1 + nports + i].revents &&
+			    (((msg_type = _peek_msg_type(conn_arg->newsockfd))
+			      >= 0) ||
+			     (++pending[i].peek_cnt >= MAX_HEADER_PEEKS))) {
+				_set_rcvlowat(conn_arg->newsockfd, 1);
+				rpc_pool_queue(conn_arg, MAX(msg_type, 0));
+			} else if (difftime(now, pending[i].accepted) >
+				   msg_timeout) {
+				slurm_print_slurm_addr(&conn_arg->cli_addr,
+						       addr_buf,
+						       sizeof(addr_buf));
+				error("%s: no request from %s in %d seconds",
+				      __func__, addr_buf, msg_timeout);
+				close(conn_arg->newsockfd);
+				xfree(conn_arg);
+				server_thread_decr();
+			} else {
+				pending[j++] = pending[i];
+			}
 		}
-		fd_set_close_on_exec(newsockfd);
-		conn_arg = xmalloc(sizeof(connection_arg_t));
-		conn_arg->newsockfd = newsockfd;
-		memcpy(&conn_arg->cli_addr, &cli_addr, sizeof(slurm_addr_t));
+		pending_cnt = j;
 
-		if (slurmctld_conf.debug_flags & DEBUG_FLAG_PROTOCOL) {
-			char inetbuf[64];
+		for (i = 1; accepting && (i <= nports); i++) {
+			if (!fds[i].revents)
+				continue;
+			if (!_get_server_thread())
+				break;
 
-			slurm_print_slurm_addr(&cli_addr,
-						inetbuf,
-						sizeof(inetbuf));
-			info("%s: accept() connection from %s", __func__, inetbuf);
-		}
+			/*
+			 * accept needed for stream implementation is a no-op
+			 * in message implementation that just passes sockfd
+			 * to newsockfd
+			 */
+			if ((newsockfd = slurm_accept_msg_conn(fds[i].fd,
+							       &cli_addr))
+			    == SLURM_ERROR) {
+				if (errno != EINTR)
+					error("slurm_accept_msg_conn: %m");
+				server_thread_decr();
+				continue;
+			}
+			fd_set_close_on_exec(newsockfd);
+			_set_rcvlowat(newsockfd, PEEK_HEADER_SIZE);
+			conn_arg = xmalloc(sizeof(connection_arg_t));
+			conn_arg->newsockfd = newsockfd;
+			memcpy(&conn_arg->cli_addr, &cli_addr,
+			       sizeof(slurm_addr_t));
+
+			if (slurmctld_conf.debug_flags & DEBUG_FLAG_PROTOCOL) {
+				char inetbuf[64];
+
+				slurm_print_slurm_addr(&cli_addr,
+							inetbuf,
+							sizeof(inetbuf));
+				info("%s: accept() connection from %s",
+				     __func__, inetbuf);
+			}
 
-		if (slurmctld_config.shutdown_time) {
-			slurmctld_diag_stats.proc_req_raw++;
-			_service_connection(conn_arg);
-		} else {
-			slurm_thread_create_detached(NULL, _service_connection,
-						     conn_arg);
+			pending[pending_cnt].conn = conn_arg;
+			pending[pending_cnt].accepted = now;
+			pending[pending_cnt].peek_cnt = 0;
+			pending_cnt++;
 		}
 	}
 
 	debug3("%s shutting down", __func__);
-	for (i = 0; i < nports; i++)
+	rpc_pool_fini();
+	for (i = 0; i < pending_cnt; i++) {
+		close(pending[i].conn->newsockfd);
+		xfree(pending[i].conn);
+		server_thread_decr();
+	}
+	for (i = 1; i <= nports; i++)
 		close(fds[i].fd);
 	xfree(fds);
+	xfree(pending);
+	slurm_mutex_lock(&slurmctld_config.thread_count_lock);
+	rpc_mgr_paused = false;
+	for (i = 0; i < 2; i++) {
+		close(rpc_wake_fd[i]);
+		rpc_wake_fd[i] = -1;
+	}
+	slurm_mutex_unlock(&slurmctld_config.thread_count_lock);
 	server_thread_decr();
 	pthread_exit((void *) 0);
 	return NULL;
 }
 
 /*
- * _service_connection - service the RPC
- * IN/OUT arg - really just the connection's file descriptor, freed
+ * _service_connection - service the RPC, called by the RPC worker threads
+ * IN/OUT conn - the connection's file descriptor and address, freed
  *	upon completion
- * RET - NULL
  */
-static void *_service_connection(void *arg)
+static void _service_connection(connection_arg_t *conn)
 {
-	connection_arg_t *conn = (connection_arg_t *) arg;
-	void *return_code = NULL;
 	slurm_msg_t msg;
 
-#if HAVE_SYS_PRCTL_H
-	if (prctl(PR_SET_NAME, "srvcn", NULL, NULL, NULL) < 0) {
-		error("%s: cannot set my name to %s %m", __func__, "srvcn");
-	}
-#endif
 	slurm_msg_t_init(&msg);
 	msg.flags |= SLURM_MSG_KEEP_BUFFER;
 	/*
@@ -1305,50 +1440,38 @@ static void *_service_connection(void *arg)
 
 cleanup:
 	slurm_free_msg_members(&msg);
-	xfree(arg);
+	xfree(conn);
 	server_thread_decr();
-
-	return return_code;
 }
 
-/* Increment slurmctld_config.server_thread_count and don't return
- * until its value is no larger than MAX_SERVER_THREADS,
- * RET true unless shutdown in progress */
-static bool _wait_for_server_thread(void)
+/*
+ * Increment slurmctld_config.server_thread_count unless at
+ * max_server_threads, RET false if at the limit. Accepting new connections
+ * then stops until server_thread_decr() wakes up _slurmctld_rpc_mgr.
+ */
+static bool _get_server_thread(void)
 {
-	bool print_it = true;
+	static time_t last_print_time = 0;
 	bool rc = true;
+	time_t now;
 
 	slurm_mutex_lock(&slurmctld_config.thread_count_lock);
-	while (1) {
-		if (slurmctld_config.shutdown_time) {
-			rc = false;
-			break;
-		}
-		if (slurmctld_config.server_thread_count < max_server_threads) {
-			slurmctld_config.server_thread_count++;
-			break;
-		} else {
-			/* wait for state change and retry,
-			 * just a delay and not an error.
-			 * This can happen when the epilog completes
-			 * on a bunch of nodes at the same time, which
-			 * can easily happen for highly parallel jobs. */
-			if (print_it) {
-				static time_t last_print_time = 0;
-				time_t now = time(NULL);
-				if (difftime(now, last_print_time) > 2) {
-					verbose("server_thread_count over "
-						"limit (%d), waiting",
-						slurmctld_config.
-						server_thread_count);
-					last_print_time = now;
-				}
-				print_it = false;
-			}
-			slurm_cond_wait(&slurmctld_config.thread_count_cond,
-					&slurmctld_config.thread_count_lock);
+	if (slurmctld_config.server_thread_count < max_server_threads) {
+		slurmctld_config.server_thread_count++;
+	} else {
+		/*
+		 * Just a delay and not an error. This can happen when the
+		 * epilog completes on a bunch of nodes at the same time,
+		 * which can easily happen for highly parallel jobs.
+		 */
+		now = time(NULL);
+		if (difftime(now, last_print_time) > 2) {
+			verbose("server_thread_count over limit (%d), waiting",
+				slurmctld_config.server_thread_count);
+			last_print_time = now;
 		}
+		rpc_mgr_paused = true;
+		rc = false;
 	}
 	slurm_mutex_unlock(&slurmctld_config.thread_count_lock);
 	return rc;
@@ -1362,6 +1485,11 @@ extern void server_thread_decr(void)
 		slurmctld_config.server_thread_count--;
 	else
 		error("slurmctld_config.server_thread_count underflow");
+	if (rpc_mgr_paused &&
+	    (slurmctld_config.server_thread_count < max_server_threads)) {
+		rpc_mgr_paused = false;
+		_wake_rpc_mgr();
+	}
 	slurm_cond_broadcast(&slurmctld_config.thread_count_cond);
 	slurm_mutex_unlock(&slurmctld_config.thread_count_lock);
 }
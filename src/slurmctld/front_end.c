@@ -668,13 +668,14 @@ extern int dump_all_front_end_state(void)
 #ifdef HAVE_FRONT_END
 	/* Save high-water mark to avoid buffer growth with copies */
 	static int high_buffer_size = (1024 * 1024);
-	int error_code = 0, i, log_fd;
-	char *old_file, *new_file, *reg_file;
+	int error_code, i;
 	front_end_record_t *front_end_ptr;
 	/* Locks: Read config and node */
 	slurmctld_lock_t node_read_lock = { READ_LOCK, NO_LOCK, READ_LOCK,
 					    NO_LOCK, NO_LOCK };
 	Buf buffer = init_buf(high_buffer_size);
+	struct timespec locked;
+	uint64_t lock_usec;
 	DEF_TIMERS;
 
 	START_TIMER;
@@ -685,65 +686,21 @@ extern int dump_all_front_end_state(void)
 
 	/* write node records to buffer */
 	lock_slurmctld (node_read_lock);
+	clock_gettime(CLOCK_MONOTONIC, &locked);
 
 	for (i = 0, front_end_ptr = front_end_nodes;
 	     i < front_end_node_cnt; i++, front_end_ptr++) {
 		xassert(front_end_ptr->magic == FRONT_END_MAGIC);
 		_dump_front_end_state(front_end_ptr, buffer);
 	}
-
-	old_file = xstrdup (slurmctld_conf.state_save_location);
-	xstrcat (old_file, "/front_end_state.old");
-	reg_file = xstrdup (slurmctld_conf.state_save_location);
-	xstrcat (reg_file, "/front_end_state");
-	new_file = xstrdup (slurmctld_conf.state_save_location);
-	xstrcat (new_file, "/front_end_state.new");
+	lock_usec = state_save_usec_since(&locked);
 	unlock_slurmctld (node_read_lock);
 
-	/* write the buffer to file */
-	lock_state_files();
-	log_fd = creat (new_file, 0600);
-	if (log_fd < 0) {
-		error ("Can't save state, error creating file %s %m", new_file);
-		error_code = errno;
-	} else {
-		int pos = 0, nwrite = get_buf_offset(buffer), amount, rc;
-		char *data = (char *)get_buf_data(buffer);
-		high_buffer_size = MAX(nwrite, high_buffer_size);
-		while (nwrite > 0) {
-			amount = write(log_fd, &data[pos], nwrite);
-			if ((amount < 0) && (errno != EINTR)) {
-				error("Error writing file %s, %m", new_file);
-				error_code = errno;
-				break;
-			}
-			nwrite -= amount;
-			pos    += amount;
-		}
-
-		rc = fsync_and_close(log_fd, "front_end");
-		if (rc && !error_code)
-			error_code = rc;
-	}
-	if (error_code)
-		(void) unlink (new_file);
-	else {	/* file shuffle */
-		(void) unlink (old_file);
-		if (link(reg_file, old_file))
-			debug4("unable to create link for %s -> %s: %m",
-			       reg_file, old_file);
-		(void) unlink (reg_file);
-		if (link(new_file, reg_file))
-			debug4("unable to create link for %s -> %s: %m",
-			       new_file, reg_file);
-		(void) unlink (new_file);
-	}
-	xfree (old_file);
-	xfree (reg_file);
-	xfree (new_file);
-	unlock_state_files ();
+	/* queue the buffer to be written to file */
+	high_buffer_size = MAX(get_buf_offset(buffer), high_buffer_size);
+	error_code = state_file_write("front_end_state", STATE_FILE_BACKUP,
+				      buffer, lock_usec, false);
 
-	free_buf (buffer);
 	END_TIMER2("dump_all_front_end_state");
 	return error_code;
 #else
@@ -0,0 +1,348 @@
+/*****************************************************************************\
+ *  job_hash.c - Hash tables of job records by job ID and job array task
+ *
+ *  Open addressing tables with linear probing. Each slot holds the key next
+ *  to the record pointer, so a lookup compares keys in consecutive memory
+ *  without touching other job records. A table is resized by allocating the
+ *  new table and moving the entries of the old one a few slots per update,
+ *  lookups search both tables until the old one is empty.
+ *
+ *  This file has been developed by staff and students
+ *  of Heidelberg University as part of the research carried out by the
+ *  Electronic Vision(s) group at the Kirchhoff-Institute for Physics.
+ *  The research is funded by Heidelberg University, the State of
+ *  Baden-Württemberg, the Seventh Framework Programme under grant agreements
+ *  no 604102 (HBP) as well as the Horizon 2020 Framework Programme under grant
+ *  agreement 720270 (HBP).
+\*****************************************************************************/
+
+#include "config.h"
+
+#include <string.h>
+
+#include "src/common/log.h"
+#include "src/common/xmalloc.h"
+#include "src/slurmctld/job_hash.h"
+
+#define HASH_MIN_BITS	10	/* smallest table has 1024 slots */
+#define HASH_MOVE_SLOTS	64	/* old table slots moved per update */
+
+/*
+ * Tables grow when more than half full and shrink when less than 1/16 full.
+ * Moving HASH_MOVE_SLOTS slots per update empties the old table long before
+ * the new one reaches either limit.
+ */
+#define HASH_GROW(_t)	((_t)->count > ((_t)->mask >> 1))
+#define HASH_SHRINK(_h)	(((_h)->cur.bits > (_h)->min_bits) && \
+			 ((_h)->cur.count < ((_h)->cur.mask >> 4)))
+
+typedef struct {
+	uint64_t key;
+	job_record_t *job_ptr;	/* NULL if slot is empty */
+} hash_slot_t;
+
+typedef struct {
+	uint32_t bits;		/* table has 2^bits slots */
+	uint32_t count;		/* slots in use */
+	uint32_t mask;		/* slot count - 1 */
+	hash_slot_t *slots;
+} hash_tbl_t;
+
+typedef struct {
+	hash_tbl_t cur;		/* new entries are added here */
+	hash_tbl_t old;		/* being moved to cur, slots NULL if not */
+	uint32_t min_bits;	/* do not shrink below 2^min_bits slots */
+	uint32_t move_inx;	/* next old slot to move */
+} job_hash_t;
+
+static job_hash_t *job_id_hash = NULL;		/* by job_id */
+static job_hash_t *array_task_hash = NULL;	/* by array job/task id */
+static job_hash_t *array_job_hash = NULL;	/* first task by array_job_id */
+
+static inline uint32_t _slot_inx(hash_tbl_t *tbl, uint64_t key)
+{
+	/* Fibonacci hashing spreads sequential job IDs over the table */
+	key ^= key >> 32;
+	return (uint32_t) ((key * 0x9e3779b97f4a7c15ULL) >> (64 - tbl->bits));
+}
+
+static inline uint64_t _array_key(uint32_t array_job_id,
+				  uint32_t array_task_id)
+{
+	return (((uint64_t) array_job_id << 32) | array_task_id);
+}
+
+static void _tbl_alloc(hash_tbl_t *tbl, uint32_t bits)
+{
+	tbl->bits = bits;
+	tbl->count = 0;
+	tbl->mask = (1U << bits) - 1;
+	tbl->slots = xcalloc(tbl->mask + 1, sizeof(hash_slot_t));
+}
+
+static void _tbl_insert(hash_tbl_t *tbl, uint64_t key, job_record_t *job_ptr)
+{
+	uint32_t i = _slot_inx(tbl, key);
+
+	while (tbl->slots[i].job_ptr)
+		i = (i + 1) & tbl->mask;
+	tbl->slots[i].key = key;
+	tbl->slots[i].job_ptr = job_ptr;
+	tbl->count++;
+}
+
+/* Return the slot of a key, or of a key and record if job_ptr is set */
+static int64_t _tbl_search(hash_tbl_t *tbl, uint64_t key,
+			   job_record_t *job_ptr)
+{
+	uint32_t i;
+
+	if (!tbl->slots)
+		return -1;
+	for (i = _slot_inx(tbl, key); tbl->slots[i].job_ptr;
+	     i = (i + 1) & tbl->mask) {
+		if ((tbl->slots[i].key == key) &&
+		    (!job_ptr || (tbl->slots[i].job_ptr == job_ptr)))
+			return i;
+	}
+	return -1;
+}
+
+/*
+ * Empty a slot, shifting later entries of its probe sequence back so that
+ * no entry is separated from its home slot by an empty one
+ */
+static void _tbl_delete(hash_tbl_t *tbl, uint32_t i)
+{
+	uint32_t j = i, home;
+
+	tbl->count--;
+	while (1) {
+		j = (j + 1) & tbl->mask;
+		if (!tbl->slots[j].job_ptr)
+			break;
+		home = _slot_inx(tbl, tbl->slots[j].key);
+		/* Entry stays if its home is cyclically in (i, j] */
+		if ((i <= j) ? ((i < home) && (home <= j)) :
+			       ((i < home) || (home <= j)))
+			continue;
+		tbl->slots[i] = tbl->slots[j];
+		i = j;
+	}
+	tbl->slots[i].key = 0;
+	tbl->slots[i].job_ptr = NULL;
+}
+
+/*
+ * Move some entries of the old table to the current one. Deleting an entry
+ * may shift a later one back into the same slot, so a slot is only passed
+ * once empty. All slots before move_inx are then empty, so no probe sequence
+ * wraps around into them.
+ */
+static void _move_slots(job_hash_t *hash, uint32_t slot_cnt)
+{
+	hash_tbl_t *old = &hash->old;
+	hash_slot_t *slot;
+
+	while (slot_cnt-- && (hash->move_inx <= old->mask)) {
+		slot = &old->slots[hash->move_inx];
+		while (slot->job_ptr) {
+			_tbl_insert(&hash->cur, slot->key, slot->job_ptr);
+			_tbl_delete(old, hash->move_inx);
+		}
+		hash->move_inx++;
+	}
+	if (!old->count) {
+		xfree(old->slots);
+		memset(old, 0, sizeof(hash_tbl_t));
+	}
+}
+
+static void _resize(job_hash_t *hash, uint32_t bits)
+{
+	debug2("%s: %u entries, %u -> %u slots", __func__, hash->cur.count,
+	       hash->cur.mask + 1, (1U << bits));
+	hash->old = hash->cur;
+	hash->move_inx = 0;
+	_tbl_alloc(&hash->cur, bits);
+}
+
+/* Progress or start a resize, called on each update */
+static void _update(job_hash_t *hash)
+{
+	if (hash->old.slots)
+		_move_slots(hash, HASH_MOVE_SLOTS);
+	else if (HASH_GROW(&hash->cur))
+		_resize(hash, hash->cur.bits + 1);
+	else if (HASH_SHRINK(hash))
+		_resize(hash, hash->cur.bits - 1);
+}
+
+static job_hash_t *_hash_create(uint32_t min_cnt)
+{
+	job_hash_t *hash = xmalloc(sizeof(job_hash_t));
+	uint32_t bits = HASH_MIN_BITS;
+
+	/* Keep min_cnt entries at most half full */
+	while ((bits < 31) && (((1U << bits) >> 1) < min_cnt))
+		bits++;
+	hash->min_bits = bits;
+	_tbl_alloc(&hash->cur, bits);
+
+	return hash;
+}
+
+static void _hash_free(job_hash_t *hash)
+{
+	if (!hash)
+		return;
+	xfree(hash->cur.slots);
+	xfree(hash->old.slots);
+	xfree(hash);
+}
+
+static void _hash_add(job_hash_t *hash, uint64_t key, job_record_t *job_ptr)
+{
+	_update(hash);
+	_tbl_insert(&hash->cur, key, job_ptr);
+}
+
+static job_record_t *_hash_find(job_hash_t *hash, uint64_t key)
+{
+	int64_t i;
+
+	if (!hash)
+		return NULL;
+	if ((i = _tbl_search(&hash->cur, key, NULL)) >= 0)
+		return hash->cur.slots[i].job_ptr;
+	if ((i = _tbl_search(&hash->old, key, NULL)) >= 0)
+		return hash->old.slots[i].job_ptr;
+	return NULL;
+}
+
+/* Remove the entry of a key and record, RET false if not found */
+static bool _hash_remove(job_hash_t *hash, uint64_t key,
+			 job_record_t *job_ptr)
+{
+	int64_t i;
+
+	if (!hash)
+		return false;
+	if ((i = _tbl_search(&hash->cur, key, job_ptr)) >= 0)
+		_tbl_delete(&hash->cur, i);
+	else if ((i = _tbl_search(&hash->old, key, job_ptr)) >= 0)
+		_tbl_delete(&hash->old, i);
+	else
+		return false;
+	_update(hash);
+	return true;
+}
+
+/* Replace the record of a key, RET false if not found */
+static bool _hash_replace(job_hash_t *hash, uint64_t key,
+			  job_record_t *old_ptr, job_record_t *new_ptr)
+{
+	int64_t i;
+
+	if ((i = _tbl_search(&hash->cur, key, old_ptr)) >= 0)
+		hash->cur.slots[i].job_ptr = new_ptr;
+	else if ((i = _tbl_search(&hash->old, key, old_ptr)) >= 0)
+		hash->old.slots[i].job_ptr = new_ptr;
+	else
+		return false;
+	return true;
+}
+
+extern void job_hash_init(uint32_t job_cnt)
+{
+	if (job_id_hash)
+		return;
+	job_id_hash = _hash_create(job_cnt);
+	array_task_hash = _hash_create(0);
+	array_job_hash = _hash_create(0);
+}
+
+extern void job_hash_fini(void)
+{
+	_hash_free(job_id_hash);
+	_hash_free(array_task_hash);
+	_hash_free(array_job_hash);
+	job_id_hash = array_task_hash = array_job_hash = NULL;
+}
+
+extern void job_hash_add(job_record_t *job_ptr)
+{
+	_hash_add(job_id_hash, job_ptr->job_id, job_ptr);
+}
+
+extern int job_hash_remove(job_record_t *job_ptr)
+{
+	if (!_hash_remove(job_id_hash, job_ptr->job_id, job_ptr))
+		return SLURM_ERROR;
+	return SLURM_SUCCESS;
+}
+
+extern job_record_t *job_hash_find(uint32_t job_id)
+{
+	return _hash_find(job_id_hash, job_id);
+}
+
+extern void job_hash_array_add(job_record_t *job_ptr)
+{
+	job_record_t *first_ptr;
+
+	xassert(job_ptr->array_task_id != NO_VAL);
+
+	_hash_add(array_task_hash, _array_key(job_ptr->array_job_id,
+					      job_ptr->array_task_id),
+		  job_ptr);
+
+	/* New tasks are put in front of the array's list of tasks */
+	job_ptr->job_array_prev_j = NULL;
+	first_ptr = _hash_find(array_job_hash, job_ptr->array_job_id);
+	job_ptr->job_array_next_j = first_ptr;
+	if (first_ptr) {
+		first_ptr->job_array_prev_j = job_ptr;
+		_hash_replace(array_job_hash, job_ptr->array_job_id,
+			      first_ptr, job_ptr);
+	} else
+		_hash_add(array_job_hash, job_ptr->array_job_id, job_ptr);
+}
+
+extern int job_hash_array_remove(job_record_t *job_ptr)
+{
+	job_record_t *next_ptr = job_ptr->job_array_next_j;
+	job_record_t *prev_ptr = job_ptr->job_array_prev_j;
+
+	if (!_hash_remove(array_task_hash,
+			  _array_key(job_ptr->array_job_id,
+				     job_ptr->array_task_id),
+			  job_ptr))
+		return SLURM_ERROR;
+
+	if (prev_ptr)
+		prev_ptr->job_array_next_j = next_ptr;
+	else if (next_ptr)
+		_hash_replace(array_job_hash, job_ptr->array_job_id,
+			      job_ptr, next_ptr);
+	else
+		_hash_remove(array_job_hash, job_ptr->array_job_id, job_ptr);
+	if (next_ptr)
+		next_ptr->job_array_prev_j = prev_ptr;
+	job_ptr->job_array_next_j = NULL;
+	job_ptr->job_array_prev_j = NULL;
+
+	return SLURM_SUCCESS;
+}
+
+extern job_record_t *job_hash_array_find(uint32_t array_job_id,
+					 uint32_t array_task_id)
+{
+	return _hash_find(array_task_hash,
+			  _array_key(array_job_id, array_task_id));
+}
+
+extern job_record_t *job_hash_array_first(uint32_t array_job_id)
+{
+	return _hash_find(array_job_hash, array_job_id);
+}
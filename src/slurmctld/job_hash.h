@@ -0,0 +1,73 @@
+/*****************************************************************************\
+ *  job_hash.h - Hash tables of job records by job ID and job array task
+ *
+ *  This file has been developed by staff and students
+ *  of Heidelberg University as part of the research carried out by the
+ *  Electronic Vision(s) group at the Kirchhoff-Institute for Physics.
+ *  The research is funded by Heidelberg University, the State of
+ *  Baden-Württemberg, the Seventh Framework Programme under grant agreements
+ *  no 604102 (HBP) as well as the Horizon 2020 Framework Programme under grant
+ *  agreement 720270 (HBP).
+\*****************************************************************************/
+
+#ifndef _SLURMCTLD_JOB_HASH_H
+#define _SLURMCTLD_JOB_HASH_H
+
+#include "src/slurmctld/slurmctld.h"
+
+/*
+ * Job records are indexed by job ID and, for job array tasks with their own
+ * record, by (array_job_id, array_task_id) and by array_job_id. The tables
+ * grow and shrink with the number of jobs, moving a few entries to the
+ * resized table on each update rather than all at once.
+ *
+ * Updates must be done with the job write lock, lookups with the job read
+ * lock, as lookups do not modify the tables.
+ */
+
+/*
+ * job_hash_init - Create the tables, if not yet created
+ * IN job_cnt - expected number of job records, the job ID table never
+ *	shrinks below the size needed for that many jobs
+ */
+extern void job_hash_init(uint32_t job_cnt);
+
+/* Free the tables, not the job records in them */
+extern void job_hash_fini(void);
+
+/* Add a job record by its job_id, which must already be set */
+extern void job_hash_add(job_record_t *job_ptr);
+
+/*
+ * job_hash_remove - Remove a job record added by job_hash_add()
+ * RET SLURM_SUCCESS or SLURM_ERROR if not found
+ */
+extern int job_hash_remove(job_record_t *job_ptr);
+
+/* Return the job record with the given job ID, NULL if none */
+extern job_record_t *job_hash_find(uint32_t job_id);
+
+/*
+ * job_hash_array_add - Add a job array task record by its array_job_id and
+ *	array_task_id, which must already be set
+ */
+extern void job_hash_array_add(job_record_t *job_ptr);
+
+/*
+ * job_hash_array_remove - Remove a job record added by job_hash_array_add()
+ * RET SLURM_SUCCESS or SLURM_ERROR if not found
+ */
+extern int job_hash_array_remove(job_record_t *job_ptr);
+
+/* Return the record of a job array task, NULL if it has none of its own */
+extern job_record_t *job_hash_array_find(uint32_t array_job_id,
+					 uint32_t array_task_id);
+
+/*
+ * job_hash_array_first - Return the first task record of a job array, the
+ *	remaining ones follow through job_array_next_j. The meta job record
+ *	of the array's pending tasks is not included.
+ */
+extern job_record_t *job_hash_array_first(uint32_t array_job_id);
+
+#endif /* !_SLURMCTLD_JOB_HASH_H */
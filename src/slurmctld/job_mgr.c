@@ -84,6 +84,7 @@
 #include "src/common/tres_frequency.h"
 #include "src/common/uid.h"
 #include "src/common/xassert.h"
+#include "src/common/xhash.h"
 #include "src/common/xstring.h"
 
 #include "src/slurmctld/acct_policy.h"
@@ -92,6 +93,7 @@
 #include "src/slurmctld/fed_mgr.h"
 #include "src/slurmctld/front_end.h"
 #include "src/slurmctld/gang.h"
+#include "src/slurmctld/job_hash.h"
 #include "src/slurmctld/job_scheduler.h"
 #include "src/slurmctld/job_submit.h"
 #include "src/slurmctld/licenses.h"
@@ -101,6 +103,7 @@
 #include "src/slurmctld/proc_req.h"
 #include "src/slurmctld/reservation.h"
 #include "src/slurmctld/sched_plugin.h"
+#include "src/slurmctld/sched_queue.h"
 #include "src/slurmctld/slurmctld.h"
 #include "src/slurmctld/slurmctld_plugstack.h"
 #include "src/slurmctld/srun_comm.h"
@@ -114,17 +117,17 @@
 #define TOP_PRIORITY 0xffff0000	/* large, but leave headroom for higher */
 #define PURGE_OLD_JOB_IN_SEC 2592000 /* 30 days in seconds */
 
-#define JOB_HASH_INX(_job_id)	(_job_id % hash_table_size)
-#define JOB_ARRAY_HASH_INX(_job_id, _task_id) \
-	((_job_id + _task_id) % hash_table_size)
-
 /* No need to change we always pack SLURM_PROTOCOL_VERSION */
 #define JOB_STATE_VERSION     "PROTOCOL_VERSION"
 #define JOB_CKPT_VERSION      "PROTOCOL_VERSION"
 
+/* Types of job state journal records */
+#define JOB_JOURNAL_SAVE	1	/* state of a new or changed job */
+#define JOB_JOURNAL_PURGE	2	/* job record purged */
+#define JOB_JOURNAL_ID_SEQ	3	/* job id sequence */
+
 typedef enum {
 	JOB_HASH_JOB,
-	JOB_HASH_ARRAY_JOB,
 	JOB_HASH_ARRAY_TASK,
 } job_hash_type_t;
 
@@ -149,23 +152,71 @@ typedef struct {
 	int rc;
 } job_overlap_args_t;
 
+/* Packed record of one job in a job table snapshot */
+typedef struct {
+	char *account;
+	uint32_t job_id;
+	job_record_t *job_ptr;		/* job packed, only compared */
+	char *mcs_label;
+	uint32_t offset;		/* offset of the packed job in buffer */
+	uint16_t part_cnt;
+	uint16_t *part_inx;		/* partitions of the job, indexes in
+					 * parts of the snapshot */
+	bool revoked;
+	uint32_t size;			/* size of the packed job */
+	uint32_t user_id;
+} job_snap_rec_t;
+
+/*
+ * Snapshot of all jobs packed with one set of show_flags and protocol version.
+ * Never modified once built, so it is read without slurmctld job locks. Once
+ * jobs changed, the next snapshot copies the records of the jobs unchanged
+ * from it. It is freed once replaced and released by all readers.
+ */
+typedef struct {
+	Buf buffer;			/* packed jobs */
+	time_t build_time;
+	time_t full_time;		/* build time of the last snapshot
+					 * which packed all jobs */
+	time_t last_used;
+	uint16_t part_cnt;
+	part_record_t **parts;		/* partitions at build time */
+	uint16_t protocol_version;
+	uint32_t rec_cnt;
+	job_snap_rec_t *recs;
+	int ref_cnt;			/* protected by job_snap_mutex */
+	uint16_t show_flags;
+} job_snap_t;
+
 /* Global variables */
 List   job_list = NULL;		/* job_record list */
 time_t last_job_update;		/* time of last update to job records */
 
 List purge_files_list = NULL;	/* job files to delete */
 
+#define JOB_SNAP_MAX 4			/* job table snapshots kept */
+#define JOB_SNAP_FULL_AGE 60		/* seconds until all jobs are repacked,
+					 * also refreshing values pack_job()
+					 * derives from the time and other
+					 * jobs */
+static List job_snap_list = NULL;	/* job table snapshots, job_snap_t */
+static pthread_mutex_t job_snap_mutex = PTHREAD_MUTEX_INITIALIZER;
+static pthread_mutex_t job_snap_build_mutex = PTHREAD_MUTEX_INITIALIZER;
+
 /* Local variables */
 static int      bf_min_age_reserve = 0;
 static uint32_t delay_boot = 0;
 static uint32_t highest_prio = 0;
 static uint32_t lowest_prio  = TOP_PRIORITY;
-static int      hash_table_size = 0;
 static int      job_count = 0;		/* job's in the system */
 static uint32_t job_id_sequence = 0;	/* first job_id to assign new job */
-static struct   job_record **job_hash = NULL;
-static struct   job_record **job_array_hash_j = NULL;
-static struct   job_record **job_array_hash_t = NULL;
+static List     job_journal_purged = NULL;	/* ids of jobs purged since
+						 * the last job state save */
+static bool     job_journal_valid = false;	/* journal applies to the
+						 * current job state file */
+static uint32_t job_journal_id_seq = 0;	/* job_id_sequence journaled */
+static uint32_t job_journal_size = 0;	/* bytes in job state journal */
+static uint32_t job_state_size = 0;	/* bytes in job state file */
 static bool     kill_invalid_dep;
 static time_t   last_file_write_time = (time_t) 0;
 static uint32_t max_array_size = NO_VAL;
@@ -192,6 +243,8 @@ static slurmdb_qos_rec_t *_determine_and_validate_qos(
 	bool locked, log_level_t log_lvl);
 static void _dump_job_details(struct job_details *detail_ptr, Buf buffer);
 static void _dump_job_state(job_record_t *dump_job_ptr, Buf buffer);
+static void _pack_job_rec(job_record_t *dump_job_ptr, uint16_t show_flags,
+			  Buf buffer, uint16_t protocol_version, uid_t uid);
 static void _dump_job_fed_details(job_fed_details_t *fed_details_ptr,
 				  Buf buffer);
 static job_fed_details_t *_dup_job_fed_details(job_fed_details_t *src);
@@ -216,6 +269,7 @@ static uint32_t _max_switch_wait(uint32_t input_wait);
 static void _notify_srun_missing_step(job_record_t *job_ptr, int node_inx,
 				      time_t now, time_t node_boot_time);
 static Buf  _open_job_state_file(char **state_file);
+static int  _unpack_job_state_version(Buf buffer, uint16_t *protocol_version);
 static time_t _get_last_job_state_write_time(void);
 static void _pack_default_job_details(job_record_t *job_ptr, Buf buffer,
 				      uint16_t protocol_version);
@@ -608,7 +662,7 @@ static job_record_t *_create_job_record(uint32_t num_jobs)
 	}
 
 	job_count += num_jobs;
-	last_job_update = time(NULL);
+	job_state_changed(job_ptr, time(NULL));
 
 	job_ptr->magic = JOB_MAGIC;
 	job_ptr->array_task_id = NO_VAL;
@@ -797,8 +851,164 @@ static slurmdb_qos_rec_t *_determine_and_validate_qos(
 	return qos_ptr;
 }
 
+static int _set_job_changed(void *x, void *arg)
+{
+	job_record_t *job_ptr = (job_record_t *) x;
+
+	job_ptr->state_dirty = true;
+	job_ptr->last_update = *(time_t *) arg;
+	return 0;
+}
+
+extern void job_state_changed(job_record_t *job_ptr, time_t now)
+{
+	if (job_ptr)
+		(void) _set_job_changed(job_ptr, &now);
+	else if (job_list)
+		(void) list_for_each(job_list, _set_job_changed, &now);
+	last_job_update = now;
+}
+
+/*
+ * Start an empty job state journal for the job state file just written
+ * IN state_time - time stamp of the job state file
+ * RET 0 or error code
+ */
+static int _create_job_journal(time_t state_time)
+{
+	int error_code;
+	uint32_t size;
+	Buf buffer = init_buf(BUF_SIZE);
+
+	/* write header: version, time of the job state file */
+	packstr(JOB_STATE_VERSION, buffer);
+	pack16(SLURM_PROTOCOL_VERSION, buffer);
+	pack_time(state_time, buffer);
+
+	size = get_buf_offset(buffer);
+	error_code = state_file_write("job_state.journal", STATE_FILE_REPLACE,
+				      buffer, 0, true);
+	if (!error_code)
+		job_journal_size = size;
+
+	return error_code;
+}
+
+/*
+ * Append the jobs changed or purged since the last save to the job state
+ *	journal. Changed jobs are those marked by job_state_changed(), only
+ *	they are packed.
+ * RET 0 or error code
+ */
+static int _dump_job_journal(void)
+{
+	/* Save high-water mark to avoid buffer growth with copies */
+	static int high_buffer_size = BUF_SIZE;
+	int error_code;
+	uint32_t *job_id_ptr, size, save_cnt = 0, purge_cnt = 0;
+	uint32_t size_offset, job_offset;
+	uint64_t lock_usec;
+	struct timespec locked;
+	/* Locks: Read config and job */
+	slurmctld_lock_t job_read_lock =
+		{ READ_LOCK, READ_LOCK, NO_LOCK, NO_LOCK, NO_LOCK };
+	ListIterator job_iterator;
+	job_record_t *job_ptr;
+	Buf buffer = init_buf(high_buffer_size);
+
+	lock_slurmctld(job_read_lock);
+	clock_gettime(CLOCK_MONOTONIC, &locked);
+	/* Purges go first, as the id of a purged job may be in use again */
+	while ((job_id_ptr = list_pop(job_journal_purged))) {
+		pack16(JOB_JOURNAL_PURGE, buffer);
+		pack32(*job_id_ptr, buffer);
+		xfree(job_id_ptr);
+		purge_cnt++;
+	}
+	job_iterator = list_iterator_create(job_list);
+	while ((job_ptr = list_next(job_iterator))) {
+		if (!job_ptr->state_dirty)
+			continue;
+		pack16(JOB_JOURNAL_SAVE, buffer);
+		pack32(job_ptr->job_id, buffer);
+		/* Same layout as packmem(), size filled in once packed */
+		size_offset = get_buf_offset(buffer);
+		pack32(0, buffer);
+		job_offset = get_buf_offset(buffer);
+		lock_job_rec(job_ptr->job_id);
+		_dump_job_state(job_ptr, buffer);
+		job_ptr->state_dirty = false;
+		unlock_job_rec(job_ptr->job_id);
+		size = get_buf_offset(buffer) - job_offset;
+		set_buf_offset(buffer, size_offset);
+		pack32(size, buffer);
+		set_buf_offset(buffer, job_offset + size);
+		save_cnt++;
+	}
+	list_iterator_destroy(job_iterator);
+	if (job_journal_id_seq != job_id_sequence) {
+		pack16(JOB_JOURNAL_ID_SEQ, buffer);
+		pack32(job_id_sequence, buffer);
+		job_journal_id_seq = job_id_sequence;
+	}
+	lock_usec = state_save_usec_since(&locked);
+	unlock_slurmctld(job_read_lock);
+
+	size = get_buf_offset(buffer);
+	if (size == 0) {
+		free_buf(buffer);
+		return SLURM_SUCCESS;
+	}
+	high_buffer_size = MAX(size, high_buffer_size);
+
+	error_code = state_file_write("job_state.journal", STATE_FILE_APPEND,
+				      buffer, lock_usec, true);
+	if (error_code) {
+		/* Jobs were marked saved, save all jobs next time */
+		job_journal_valid = false;
+	} else {
+		job_journal_size += size;
+		debug2("%s: journaled %u changed and %u purged jobs",
+		       __func__, save_cnt, purge_cnt);
+	}
+
+	return error_code;
+}
+
+/*
+ * Write the index of the job state file just written. A load uses it to skip
+ *	the records of jobs replaced or purged by the job state journal without
+ *	decoding them. The job state file itself keeps its usual format, so
+ *	that it can still be read without the index.
+ * IN entries - job id, offset and size of each job record, freed here
+ * IN state_time - time stamp of the job state file
+ * IN state_size - size of the job state file
+ */
+static void _dump_job_state_index(Buf entries, time_t state_time,
+				  uint32_t state_size)
+{
+	uint32_t entries_size = get_buf_offset(entries);
+	Buf buffer = init_buf(entries_size + BUF_SIZE);
+
+	/* write header: version, time and size of the job state file */
+	packstr(JOB_STATE_VERSION, buffer);
+	pack16(SLURM_PROTOCOL_VERSION, buffer);
+	pack_time(state_time, buffer);
+	pack32(state_size, buffer);
+	packmem(get_buf_data(entries), entries_size, buffer);
+	free_buf(entries);
+
+	/* Without a current index the job state file is decoded in full */
+	(void) state_file_write("job_state.index", STATE_FILE_REPLACE, buffer,
+				0, false);
+}
+
 /*
  * dump_all_job_state - save the state of all jobs to file for checkpoint
+ *	Jobs changed or purged since the last save are appended to the job
+ *	state journal. Once the journal has grown as large as the job state
+ *	file, the state of all jobs is written to a new job state file and the
+ *	journal is restarted.
  *	Changes here should be reflected in load_last_job_id() and
  *	load_all_job_state().
  * RET 0 or error code
@@ -807,17 +1017,20 @@ int dump_all_job_state(void)
 {
 	/* Save high-water mark to avoid buffer growth with copies */
 	static int high_buffer_size = (1024 * 1024);
-	int error_code = SLURM_SUCCESS, log_fd;
-	char *old_file, *new_file, *reg_file;
+	int error_code = SLURM_SUCCESS;
+	char *reg_file;
 	struct stat stat_buf;
 	/* Locks: Read config and job */
 	slurmctld_lock_t job_read_lock =
 		{ READ_LOCK, READ_LOCK, NO_LOCK, NO_LOCK, NO_LOCK };
 	ListIterator job_iterator;
 	job_record_t *job_ptr;
-	Buf buffer = init_buf(high_buffer_size);
+	Buf buffer, index_buffer;
 	time_t now = time(NULL);
 	time_t last_state_file_time;
+	uint32_t job_offset, job_size, size;
+	uint64_t lock_usec;
+	struct timespec locked;
 	DEF_TIMERS;
 
 	START_TIMER;
@@ -840,7 +1053,15 @@ int dump_all_job_state(void)
 		}
 	}
 
+	if (job_journal_valid && last_file_write_time &&
+	    (job_journal_size < job_state_size)) {
+		error_code = _dump_job_journal();
+		END_TIMER2("dump_all_job_state");
+		return error_code;
+	}
+
 	/* write header: version, time */
+	buffer = init_buf(high_buffer_size);
 	packstr(JOB_STATE_VERSION, buffer);
 	pack16(SLURM_PROTOCOL_VERSION, buffer);
 	pack_time(now, buffer);
@@ -857,20 +1078,29 @@ int dump_all_job_state(void)
 
 	/* write individual job records */
 	lock_slurmctld(job_read_lock);
+	clock_gettime(CLOCK_MONOTONIC, &locked);
+	index_buffer = init_buf(BUF_SIZE);
 	job_iterator = list_iterator_create(job_list);
 	while ((job_ptr = list_next(job_iterator))) {
+		job_offset = get_buf_offset(buffer);
+		lock_job_rec(job_ptr->job_id);
 		_dump_job_state(job_ptr, buffer);
+		job_ptr->state_dirty = false;
+		unlock_job_rec(job_ptr->job_id);
+		job_size = get_buf_offset(buffer) - job_offset;
+		pack32(job_ptr->job_id, index_buffer);
+		pack32(job_offset, index_buffer);
+		pack32(job_size, index_buffer);
 	}
 	list_iterator_destroy(job_iterator);
+	/* The job state file supersedes all journaled changes */
+	list_flush(job_journal_purged);
+	job_journal_id_seq = job_id_sequence;
 
 
-	/* write the buffer to file */
-	old_file = xstrdup(slurmctld_conf.state_save_location);
-	xstrcat(old_file, "/job_state.old");
 	reg_file = xstrdup(slurmctld_conf.state_save_location);
 	xstrcat(reg_file, "/job_state");
-	new_file = xstrdup(slurmctld_conf.state_save_location);
-	xstrcat(new_file, "/job_state.new");
+	lock_usec = state_save_usec_since(&locked);
 	unlock_slurmctld(job_read_lock);
 
 	if (stat(reg_file, &stat_buf) == 0) {
@@ -888,54 +1118,24 @@ int dump_all_job_state(void)
 		last_mtime = time(NULL);
 	}
 
-	lock_state_files();
-	log_fd = open(new_file, O_CREAT|O_WRONLY|O_TRUNC|O_CLOEXEC, 0600);
-	if (log_fd < 0) {
-		error("Can't save state, create file %s error %m",
-		      new_file);
-		error_code = errno;
-	} else {
-		int pos = 0, nwrite, amount, rc;
-		char *data;
-
-		nwrite = get_buf_offset(buffer);
-		data = (char *)get_buf_data(buffer);
-		high_buffer_size = MAX(nwrite, high_buffer_size);
-		while (nwrite > 0) {
-			amount = write(log_fd, &data[pos], nwrite);
-			if ((amount < 0) && (errno != EINTR)) {
-				error("Error writing file %s, %m", new_file);
-				error_code = errno;
-				break;
-			}
-			nwrite -= amount;
-			pos    += amount;
-		}
+	xfree(reg_file);
 
-		rc = fsync_and_close(log_fd, "job");
-		if (rc && !error_code)
-			error_code = rc;
-	}
-	if (error_code)
-		(void) unlink(new_file);
-	else {			/* file shuffle */
-		(void) unlink(old_file);
-		if (link(reg_file, old_file))
-			debug4("unable to create link for %s -> %s: %m",
-			       reg_file, old_file);
-		(void) unlink(reg_file);
-		if (link(new_file, reg_file))
-			debug4("unable to create link for %s -> %s: %m",
-			       new_file, reg_file);
-		(void) unlink(new_file);
+	/* write the buffer to file, the journal depends on the result */
+	size = get_buf_offset(buffer);
+	high_buffer_size = MAX(size, high_buffer_size);
+	error_code = state_file_write("job_state", STATE_FILE_BACKUP, buffer,
+				      lock_usec, true);
+	if (error_code) {
+		job_journal_valid = false;
+		free_buf(index_buffer);
+	} else {
 		last_file_write_time = now;
+		job_state_size = size;
+		job_journal_valid = (_create_job_journal(now) ==
+				     SLURM_SUCCESS);
+		_dump_job_state_index(index_buffer, now, size);
 	}
-	xfree(old_file);
-	xfree(reg_file);
-	xfree(new_file);
-	unlock_state_files();
 
-	free_buf(buffer);
 	END_TIMER2("dump_all_job_state");
 	return error_code;
 }
@@ -1003,7 +1203,7 @@ extern void set_job_failed_assoc_qos_ptr(job_record_t *job_ptr)
 
 			job_ptr->state_reason = WAIT_NO_REASON;
 			xfree(job_ptr->state_desc);
-			last_job_update = time(NULL);
+			job_state_changed(job_ptr, time(NULL));
 		}
 	}
 
@@ -1022,7 +1222,7 @@ extern void set_job_failed_assoc_qos_ptr(job_record_t *job_ptr)
 			      __func__, job_ptr, qos_rec.name, job_ptr->qos_id);
 			job_ptr->state_reason = WAIT_NO_REASON;
 			xfree(job_ptr->state_desc);
-			last_job_update = time(NULL);
+			job_state_changed(job_ptr, time(NULL));
 		}
 	}
 }
@@ -1076,6 +1276,31 @@ extern void backup_slurmctld_restart(void)
 	last_file_write_time = (time_t) 0;
 }
 
+/*
+ * Unpack the version from the header of a job state file or its index
+ * OUT protocol_version - protocol version of the job records, NO_VAL16 if the
+ *	version string is not known
+ * RET 0 or error code
+ */
+static int _unpack_job_state_version(Buf buffer, uint16_t *protocol_version)
+{
+	char *ver_str = NULL;
+	uint32_t ver_str_len;
+
+	*protocol_version = NO_VAL16;
+
+	safe_unpackstr_xmalloc(&ver_str, &ver_str_len, buffer);
+	debug3("Version string in job_state header is %s", ver_str);
+	if (ver_str && !xstrcmp(ver_str, JOB_STATE_VERSION))
+		safe_unpack16(protocol_version, buffer);
+	xfree(ver_str);
+	return SLURM_SUCCESS;
+
+unpack_error:
+	xfree(ver_str);
+	return SLURM_ERROR;
+}
+
 /* Return the time stamp in the current job state save file, 0 is returned on
  * error */
 static time_t _get_last_job_state_write_time(void)
@@ -1084,8 +1309,6 @@ static time_t _get_last_job_state_write_time(void)
 	char *state_file = NULL;
 	Buf buffer;
 	time_t buf_time = (time_t) 0;
-	char *ver_str = NULL;
-	uint32_t ver_str_len;
 	uint16_t protocol_version = NO_VAL16;
 
 	/* read the file */
@@ -1097,6 +1320,94 @@ static time_t _get_last_job_state_write_time(void)
 	if (error_code)
 		return buf_time;
 
+	if (_unpack_job_state_version(buffer, &protocol_version))
+		goto unpack_error;
+	safe_unpack_time(&buf_time, buffer);
+
+unpack_error:
+	free_buf(buffer);
+	return buf_time;
+}
+
+/* Last record of a job in the job state journal */
+typedef struct {
+	uint32_t job_id;
+	uint32_t offset;	/* offset of the record in the journal */
+} job_journal_rec_t;
+
+/* Job state journal opened for replay */
+typedef struct {
+	Buf buffer;		/* mmapped journal file */
+	char *file;
+	uint32_t data_end;	/* end of the last complete record */
+	xhash_t *recs;		/* job_journal_rec_t of each job journaled */
+} job_journal_t;
+
+static void _job_journal_rec_id(void *item, const char **key,
+				uint32_t *key_len)
+{
+	job_journal_rec_t *rec = (job_journal_rec_t *) item;
+
+	*key = (const char *) &rec->job_id;
+	*key_len = sizeof(rec->job_id);
+}
+
+static void _free_job_journal(job_journal_t *journal)
+{
+	if (!journal)
+		return;
+	xhash_free(journal->recs);
+	free_buf(journal->buffer);
+	xfree(journal->file);
+	xfree(journal);
+}
+
+/* Test if a job is replaced or purged by a record of the job state journal */
+static bool _job_journaled(job_journal_t *journal, uint32_t job_id)
+{
+	if (!journal)
+		return false;
+	return xhash_get(journal->recs, (const char *) &job_id,
+			 sizeof(job_id)) != NULL;
+}
+
+static int _list_find_job_journaled(void *job_entry, void *key)
+{
+	job_record_t *job_ptr = (job_record_t *) job_entry;
+
+	if (_job_journaled((job_journal_t *) key, job_ptr->job_id))
+		return 1;
+
+	return 0;
+}
+
+/*
+ * Open the job state journal and find the last complete record of each job.
+ *	Records of the job id sequence are applied right away.
+ * IN state_time - time stamp of the job state file being loaded
+ * RET the journal to replay or NULL if there is none for this job state file
+ */
+static job_journal_t *_open_job_journal(time_t state_time)
+{
+	char *journal_file, *ver_str = NULL, *image;
+	uint16_t protocol_version = NO_VAL16, rec_type;
+	uint32_t ver_str_len, job_id, image_size, rec_offset;
+	time_t buf_time = (time_t) 0;
+	job_journal_t *journal;
+	job_journal_rec_t *rec;
+	Buf buffer;
+
+	journal_file = xstrdup_printf("%s/job_state.journal",
+				      slurmctld_conf.state_save_location);
+	lock_state_files();
+	buffer = create_mmap_buf(journal_file);
+	unlock_state_files();
+	if (!buffer) {
+		debug("No job state journal (%s) to recover", journal_file);
+		xfree(journal_file);
+		return NULL;
+	}
+
 	safe_unpackstr_xmalloc(&ver_str, &ver_str_len, buffer);
 	if (ver_str && !xstrcmp(ver_str, JOB_STATE_VERSION))
 		safe_unpack16(&protocol_version, buffer);
@@ -1104,27 +1415,190 @@ static time_t _get_last_job_state_write_time(void)
 
 unpack_error:
 	xfree(ver_str);
-	free_buf(buffer);
-	return buf_time;
+	if ((protocol_version == NO_VAL16) || (buf_time != state_time)) {
+		info("Ignoring job state journal %s of a previous job state file",
+		     journal_file);
+		free_buf(buffer);
+		xfree(journal_file);
+		return NULL;
+	}
+
+	journal = xmalloc(sizeof(job_journal_t));
+	journal->buffer = buffer;
+	journal->file = journal_file;
+	journal->recs = xhash_init(_job_journal_rec_id, xfree_ptr);
+	journal->data_end = rec_offset = get_buf_offset(buffer);
+	while (remaining_buf(buffer) > 0) {
+		if (unpack16(&rec_type, buffer) ||
+		    unpack32(&job_id, buffer))
+			break;
+		if (rec_type == JOB_JOURNAL_SAVE) {
+			if (unpackmem_ptr(&image, &image_size, buffer))
+				break;
+		} else if (rec_type == JOB_JOURNAL_ID_SEQ) {
+			/* job_id holds the job_id_sequence */
+			if (job_id <= slurmctld_conf.max_job_id)
+				job_id_sequence = MAX(job_id, job_id_sequence);
+			journal->data_end = rec_offset = get_buf_offset(buffer);
+			continue;
+		} else if (rec_type != JOB_JOURNAL_PURGE) {
+			break;
+		}
+		if (!(rec = xhash_get(journal->recs, (const char *) &job_id,
+				      sizeof(job_id)))) {
+			rec = xmalloc(sizeof(job_journal_rec_t));
+			rec->job_id = job_id;
+			xhash_add(journal->recs, rec);
+		}
+		rec->offset = rec_offset;
+		journal->data_end = rec_offset = get_buf_offset(buffer);
+	}
+	if (journal->data_end < size_buf(buffer))
+		error("Incomplete job state journal %s, ignoring its last %u bytes",
+		      journal_file, size_buf(buffer) - journal->data_end);
+
+	return journal;
+}
+
+/*
+ * Replay the job state journal on top of the jobs loaded from the job state
+ *	file. Only the last record of each job is applied.
+ * IN journal - from _open_job_journal(), freed here
+ * RET 0 or error code
+ */
+static int _replay_job_journal(job_journal_t *journal)
+{
+	char *ver_str = NULL;
+	uint16_t protocol_version, rec_type;
+	uint32_t ver_str_len, job_id, image_size, rec_offset;
+	uint32_t replay_cnt = 0, purge_cnt = 0;
+	time_t buf_time;
+	job_journal_rec_t *rec;
+	Buf buffer = journal->buffer;
+
+	/* Drop the jobs journaled, then load their last saved state */
+	list_delete_all(job_list, _list_find_job_journaled, journal);
+	set_buf_offset(buffer, 0);
+	safe_unpackstr_xmalloc(&ver_str, &ver_str_len, buffer);
+	xfree(ver_str);
+	safe_unpack16(&protocol_version, buffer);
+	safe_unpack_time(&buf_time, buffer);
+	while ((rec_offset = get_buf_offset(buffer)) < journal->data_end) {
+		safe_unpack16(&rec_type, buffer);
+		safe_unpack32(&job_id, buffer);
+		if (rec_type == JOB_JOURNAL_ID_SEQ)
+			continue;
+		if (rec_type == JOB_JOURNAL_PURGE) {
+			purge_cnt++;
+			continue;
+		}
+		safe_unpack32(&image_size, buffer);
+		rec = xhash_get(journal->recs, (const char *) &job_id,
+				sizeof(job_id));
+		if (!rec || (rec->offset != rec_offset)) {
+			/* Superseded by a later record of this job */
+			set_buf_offset(buffer, get_buf_offset(buffer) +
+				       image_size);
+			continue;
+		}
+		rec_offset = get_buf_offset(buffer);
+		if ((_load_job_state(buffer, protocol_version) !=
+		     SLURM_SUCCESS) ||
+		    (get_buf_offset(buffer) != rec_offset + image_size))
+			goto unpack_error;
+		replay_cnt++;
+	}
+	_free_job_journal(journal);
+
+	/* The jobs deleted while replaying are not purged by slurmctld */
+	list_flush(job_journal_purged);
+	info("Replayed job state journal: %u jobs changed, %u purge records",
+	     replay_cnt, purge_cnt);
+	return SLURM_SUCCESS;
+
+unpack_error:
+	if (!ignore_state_errors)
+		fatal("Incomplete job state journal %s, start with '-i' to ignore this. Warning: using -i will lose the data that can't be recovered.",
+		      journal->file);
+	error("Incomplete job state journal %s", journal->file);
+	_free_job_journal(journal);
+	list_flush(job_journal_purged);
+	return SLURM_ERROR;
+}
+
+/*
+ * Open the index of the job state file being loaded
+ * IN state_time - time stamp of the job state file
+ * IN state_size - size of the job state file
+ * RET the index positioned at its first entry or NULL if there is no index
+ *	for this job state file
+ */
+static Buf _open_job_state_index(time_t state_time, uint32_t state_size)
+{
+	char *index_file, *entries = NULL;
+	uint16_t protocol_version = NO_VAL16;
+	uint32_t saved_size = 0, entries_size = 0;
+	time_t buf_time = (time_t) 0;
+	bool complete = false;
+	Buf buffer;
+
+	index_file = xstrdup_printf("%s/job_state.index",
+				    slurmctld_conf.state_save_location);
+	lock_state_files();
+	buffer = create_mmap_buf(index_file);
+	unlock_state_files();
+	if (!buffer) {
+		debug("No job state index (%s)", index_file);
+		xfree(index_file);
+		return NULL;
+	}
+
+	if (_unpack_job_state_version(buffer, &protocol_version) ||
+	    (protocol_version == NO_VAL16))
+		goto unpack_error;
+	safe_unpack_time(&buf_time, buffer);
+	safe_unpack32(&saved_size, buffer);
+	safe_unpackmem_ptr(&entries, &entries_size, buffer);
+	complete = !remaining_buf(buffer);
+
+unpack_error:
+	/* Each entry is a job id, offset and size */
+	if (!complete || (buf_time != state_time) ||
+	    (saved_size != state_size) ||
+	    (entries_size % (3 * sizeof(uint32_t)))) {
+		info("Ignoring job state index %s of a previous job state file",
+		     index_file);
+		free_buf(buffer);
+		xfree(index_file);
+		return NULL;
+	}
+	xfree(index_file);
+
+	/* The entries end the file, unpack them from their start */
+	set_buf_offset(buffer, size_buf(buffer) - entries_size);
+	return buffer;
 }
 
 /*
  * load_all_job_state - load the job state from file, recover from last
  *	checkpoint. Execute this after loading the configuration file data.
+ *	The job state journal is scanned first. If the index of the job state
+ *	file is current, the records of jobs the journal replaces or purges
+ *	are skipped without decoding. All other job records are decoded here,
+ *	job_record_t fields are read directly throughout slurmctld.
  *	Changes here should be reflected in load_last_job_id().
  * RET 0 or error code
  */
 extern int load_all_job_state(void)
 {
 	int error_code = SLURM_SUCCESS;
-	int job_cnt = 0;
+	int job_cnt = 0, skip_cnt = 0;
 	char *state_file = NULL;
-	Buf buffer;
+	Buf buffer, index = NULL;
 	time_t buf_time;
-	uint32_t saved_job_id;
-	char *ver_str = NULL;
-	uint32_t ver_str_len;
+	uint32_t saved_job_id, job_id, job_offset = 0, job_size = 0;
 	uint16_t protocol_version = NO_VAL16;
+	job_journal_t *journal = NULL;
 
 	/* read the file */
 	lock_state_files();
@@ -1139,11 +1613,8 @@ extern int load_all_job_state(void)
 
 	job_id_sequence = MAX(job_id_sequence, slurmctld_conf.first_job_id);
 
-	safe_unpackstr_xmalloc(&ver_str, &ver_str_len, buffer);
-	debug3("Version string in job_state header is %s", ver_str);
-	if (ver_str && !xstrcmp(ver_str, JOB_STATE_VERSION))
-		safe_unpack16(&protocol_version, buffer);
-	xfree(ver_str);
+	if (_unpack_job_state_version(buffer, &protocol_version))
+		goto unpack_error;
 
 	if (protocol_version == NO_VAL16) {
 		if (!ignore_state_errors)
@@ -1161,6 +1632,10 @@ extern int load_all_job_state(void)
 		job_id_sequence = MAX(saved_job_id, job_id_sequence);
 	debug3("Job id in job_state header is %u", saved_job_id);
 
+	journal = _open_job_journal(buf_time);
+	if (journal)
+		index = _open_job_state_index(buf_time, size_buf(buffer));
+
 	/*
 	 * Previously we locked the tres read lock before this loop.  It turned
 	 * out that created a double lock when steps were being loaded during
@@ -1169,15 +1644,37 @@ extern int load_all_job_state(void)
 	 * into the _load_job_state function than any other option.
 	 */
 	while (remaining_buf(buffer) > 0) {
+		if (index &&
+		    (unpack32(&job_id, index) ||
+		     unpack32(&job_offset, index) ||
+		     unpack32(&job_size, index) ||
+		     (job_offset != get_buf_offset(buffer)) ||
+		     (job_size > remaining_buf(buffer)))) {
+			error("Job state index does not match the job state file, ignoring it");
+			FREE_NULL_BUFFER(index);
+		}
+		if (index && _job_journaled(journal, job_id)) {
+			set_buf_offset(buffer, job_offset + job_size);
+			skip_cnt++;
+			continue;
+		}
 		error_code = _load_job_state(buffer, protocol_version);
 		if (error_code != SLURM_SUCCESS)
 			goto unpack_error;
+		if (index && (get_buf_offset(buffer) != job_offset + job_size))
+			goto unpack_error;
 		job_cnt++;
 	}
-	debug3("Set job_id_sequence to %u", job_id_sequence);
-
 	free_buf(buffer);
-	info("Recovered information about %d jobs", job_cnt);
+	FREE_NULL_BUFFER(index);
+	if (skip_cnt)
+		debug("%s: skipped %d job records superseded by the job state journal",
+		      __func__, skip_cnt);
+
+	if (journal)
+		error_code = _replay_job_journal(journal);
+	debug3("Set job_id_sequence to %u", job_id_sequence);
+	info("Recovered information about %d jobs", list_count(job_list));
 	return error_code;
 
 unpack_error:
@@ -1185,6 +1682,8 @@ unpack_error:
 		fatal("Incomplete job state save file, start with '-i' to ignore this. Warning: using -i will lose the data that can't be recovered.");
 	error("Incomplete job state save file");
 	info("Recovered information about %d jobs", job_cnt);
+	_free_job_journal(journal);
+	FREE_NULL_BUFFER(index);
 	free_buf(buffer);
 	return SLURM_ERROR;
 }
@@ -1199,8 +1698,6 @@ extern int load_last_job_id( void )
 	char *state_file = NULL;
 	Buf buffer;
 	time_t buf_time;
-	char *ver_str = NULL;
-	uint32_t ver_str_len;
 	uint16_t protocol_version = NO_VAL16;
 
 	/* read the file */
@@ -1214,11 +1711,8 @@ extern int load_last_job_id( void )
 	xfree(state_file);
 	unlock_state_files();
 
-	safe_unpackstr_xmalloc(&ver_str, &ver_str_len, buffer);
-	debug3("Version string in job_state header is %s", ver_str);
-	if (ver_str && !xstrcmp(ver_str, JOB_STATE_VERSION))
-		safe_unpack16(&protocol_version, buffer);
-	xfree(ver_str);
+	if (_unpack_job_state_version(buffer, &protocol_version))
+		goto unpack_error;
 
 	if (protocol_version == NO_VAL16) {
 		if (!ignore_state_errors)
@@ -1236,7 +1730,6 @@ extern int load_last_job_id( void )
 
 	/* Ignore the state for individual jobs stored here */
 
-	xfree(ver_str);
 	free_buf(buffer);
 	return SLURM_SUCCESS;
 
@@ -1244,7 +1737,6 @@ unpack_error:
 	if (!ignore_state_errors)
 		fatal("Invalid job data checkpoint file, start with '-i' to ignore this. Warning: using -i will lose the data that can't be recovered.");
 	error("Invalid job data checkpoint file");
-	xfree(ver_str);
 	free_buf(buffer);
 	return SLURM_ERROR;
 }
@@ -2996,11 +3488,7 @@ unpack_error:
  */
 static void _add_job_hash(job_record_t *job_ptr)
 {
-	int inx;
-
-	inx = JOB_HASH_INX(job_ptr->job_id);
-	job_ptr->job_next = job_hash[inx];
-	job_hash[inx] = job_ptr;
+	job_hash_add(job_ptr);
 }
 
 /* _remove_job_hash - remove a job hash entry for given job record, job_id must
@@ -3011,80 +3499,26 @@ static void _add_job_hash(job_record_t *job_ptr)
  */
 static void _remove_job_hash(job_record_t *job_entry, job_hash_type_t type)
 {
-	job_record_t *job_ptr, **job_pptr;
-
 	xassert(job_entry);
 
 	switch (type) {
 	case JOB_HASH_JOB:
-		job_pptr = &job_hash[JOB_HASH_INX(job_entry->job_id)];
-		break;
-	case JOB_HASH_ARRAY_JOB:
-		job_pptr = &job_array_hash_j[
-			JOB_HASH_INX(job_entry->array_job_id)];
-		break;
-	case JOB_HASH_ARRAY_TASK:
-		job_pptr = &job_array_hash_t[
-			JOB_ARRAY_HASH_INX(job_entry->array_job_id,
-					   job_entry->array_task_id)];
-		break;
-	default:
-		fatal("%s: unknown job_hash_type_t %d", __func__, type);
-		return;
-	}
-
-	while ((job_pptr != NULL) && (*job_pptr != NULL) &&
-	       ((job_ptr = *job_pptr) != job_entry)) {
-		xassert(job_ptr->magic == JOB_MAGIC);
-		switch (type) {
-		case JOB_HASH_JOB:
-			job_pptr = &job_ptr->job_next;
-			break;
-		case JOB_HASH_ARRAY_JOB:
-			job_pptr = &job_ptr->job_array_next_j;
-			break;
-		case JOB_HASH_ARRAY_TASK:
-			job_pptr = &job_ptr->job_array_next_t;
-			break;
-		}
-	}
-
-	if (job_pptr == NULL || *job_pptr == NULL) {
-		if (job_entry->job_id == NO_VAL)
-			return;
-
-		switch (type) {
-		case JOB_HASH_JOB:
+		if ((job_hash_remove(job_entry) != SLURM_SUCCESS) &&
+		    (job_entry->job_id != NO_VAL)) {
 			error("%s: Could not find hash entry for JobId=%u",
 			      __func__, job_entry->job_id);
-			break;
-		case JOB_HASH_ARRAY_JOB:
-			error("%s: job array hash error %u", __func__,
-			      job_entry->array_job_id);
-			break;
-		case JOB_HASH_ARRAY_TASK:
+		}
+		break;
+	case JOB_HASH_ARRAY_TASK:
+		if (job_hash_array_remove(job_entry) != SLURM_SUCCESS) {
 			error("%s: job array, task ID hash error %u_%u",
 			      __func__,
 			      job_entry->array_job_id,
 			      job_entry->array_task_id);
-			break;
 		}
-		return;
-	}
-
-	switch (type) {
-	case JOB_HASH_JOB:
-		*job_pptr = job_entry->job_next;
-		job_entry->job_next = NULL;
-		break;
-	case JOB_HASH_ARRAY_JOB:
-		*job_pptr = job_entry->job_array_next_j;
-		job_entry->job_array_next_j = NULL;
-		break;
-	case JOB_HASH_ARRAY_TASK:
-		*job_pptr = job_entry->job_array_next_t;
-		job_entry->job_array_next_t = NULL;
 		break;
+	default:
+		fatal("%s: unknown job_hash_type_t %d", __func__, type);
 	}
 }
 
@@ -3095,18 +3529,10 @@ static void _remove_job_hash(job_record_t *job_entry, job_hash_type_t type)
  */
 void _add_job_array_hash(job_record_t *job_ptr)
 {
-	int inx;
-
 	if (job_ptr->array_task_id == NO_VAL)
 		return;	/* Not a job array */
 
-	inx = JOB_HASH_INX(job_ptr->array_job_id);
-	job_ptr->job_array_next_j = job_array_hash_j[inx];
-	job_array_hash_j[inx] = job_ptr;
-
-	inx = JOB_ARRAY_HASH_INX(job_ptr->array_job_id,job_ptr->array_task_id);
-	job_ptr->job_array_next_t = job_array_hash_t[inx];
-	job_array_hash_t[inx] = job_ptr;
+	job_hash_array_add(job_ptr);
 }
 
 /* For the job array data structure, build the string representation of the
@@ -3150,7 +3576,6 @@ extern void build_array_str(job_record_t *job_ptr)
 extern bool test_job_array_complete(uint32_t array_job_id)
 {
 	job_record_t *job_ptr;
-	int inx;
 
 	job_ptr = find_job_record(array_job_id);
 	if (job_ptr) {
@@ -3161,14 +3586,10 @@ extern bool test_job_array_complete(uint32_t array_job_id)
 	}
 
 	/* Need to test individual job array records */
-	inx = JOB_HASH_INX(array_job_id);
-	job_ptr = job_array_hash_j[inx];
-	while (job_ptr) {
-		if (job_ptr->array_job_id == array_job_id) {
-			if (!IS_JOB_COMPLETE(job_ptr))
-				return false;
-		}
-		job_ptr = job_ptr->job_array_next_j;
+	for (job_ptr = job_hash_array_first(array_job_id); job_ptr;
+	     job_ptr = job_ptr->job_array_next_j) {
+		if (!IS_JOB_COMPLETE(job_ptr))
+			return false;
 	}
 	return true;
 }
@@ -3177,7 +3598,6 @@ extern bool test_job_array_complete(uint32_t array_job_id)
 extern bool test_job_array_completed(uint32_t array_job_id)
 {
 	job_record_t *job_ptr;
-	int inx;
 
 	job_ptr = find_job_record(array_job_id);
 	if (job_ptr) {
@@ -3186,14 +3606,10 @@ extern bool test_job_array_completed(uint32_t array_job_id)
 	}
 
 	/* Need to test individual job array records */
-	inx = JOB_HASH_INX(array_job_id);
-	job_ptr = job_array_hash_j[inx];
-	while (job_ptr) {
-		if (job_ptr->array_job_id == array_job_id) {
-			if (!IS_JOB_COMPLETED(job_ptr))
-				return false;
-		}
-		job_ptr = job_ptr->job_array_next_j;
+	for (job_ptr = job_hash_array_first(array_job_id); job_ptr;
+	     job_ptr = job_ptr->job_array_next_j) {
+		if (!IS_JOB_COMPLETED(job_ptr))
+			return false;
 	}
 	return true;
 }
@@ -3205,7 +3621,6 @@ extern bool test_job_array_completed(uint32_t array_job_id)
 extern bool _test_job_array_purged(uint32_t array_job_id)
 {
 	job_record_t *job_ptr, *head_job_ptr;
-	int inx;
 
 	head_job_ptr = find_job_record(array_job_id);
 	if (head_job_ptr) {
@@ -3214,14 +3629,10 @@ extern bool _test_job_array_purged(uint32_t array_job_id)
 	}
 
 	/* Need to test individual job array records */
-	inx = JOB_HASH_INX(array_job_id);
-	job_ptr = job_array_hash_j[inx];
-	while (job_ptr) {
-		if ((job_ptr->array_job_id == array_job_id) &&
-		    (job_ptr != head_job_ptr)) {
+	for (job_ptr = job_hash_array_first(array_job_id); job_ptr;
+	     job_ptr = job_ptr->job_array_next_j) {
+		if (job_ptr != head_job_ptr)
 			return false;
-		}
-		job_ptr = job_ptr->job_array_next_j;
 	}
 	return true;
 }
@@ -3230,7 +3641,6 @@ extern bool _test_job_array_purged(uint32_t array_job_id)
 extern bool test_job_array_finished(uint32_t array_job_id)
 {
 	job_record_t *job_ptr;
-	int inx;
 
 	job_ptr = find_job_record(array_job_id);
 	if (job_ptr) {
@@ -3239,14 +3649,10 @@ extern bool test_job_array_finished(uint32_t array_job_id)
 	}
 
 	/* Need to test individual job array records */
-	inx = JOB_HASH_INX(array_job_id);
-	job_ptr = job_array_hash_j[inx];
-	while (job_ptr) {
-		if (job_ptr->array_job_id == array_job_id) {
-			if (!IS_JOB_FINISHED(job_ptr))
-				return false;
-		}
-		job_ptr = job_ptr->job_array_next_j;
+	for (job_ptr = job_hash_array_first(array_job_id); job_ptr;
+	     job_ptr = job_ptr->job_array_next_j) {
+		if (!IS_JOB_FINISHED(job_ptr))
+			return false;
 	}
 
 	return true;
@@ -3256,7 +3662,6 @@ extern bool test_job_array_finished(uint32_t array_job_id)
 extern bool test_job_array_pending(uint32_t array_job_id)
 {
 	job_record_t *job_ptr;
-	int inx;
 
 	job_ptr = find_job_record(array_job_id);
 	if (job_ptr) {
@@ -3267,14 +3672,10 @@ extern bool test_job_array_pending(uint32_t array_job_id)
 	}
 
 	/* Need to test individual job array records */
-	inx = JOB_HASH_INX(array_job_id);
-	job_ptr = job_array_hash_j[inx];
-	while (job_ptr) {
-		if (job_ptr->array_job_id == array_job_id) {
-			if (IS_JOB_PENDING(job_ptr))
-				return true;
-		}
-		job_ptr = job_ptr->job_array_next_j;
+	for (job_ptr = job_hash_array_first(array_job_id); job_ptr;
+	     job_ptr = job_ptr->job_array_next_j) {
+		if (IS_JOB_PENDING(job_ptr))
+			return true;
 	}
 	return false;
 }
@@ -3284,15 +3685,12 @@ extern bool test_job_array_pending(uint32_t array_job_id)
 extern int num_pending_job_array_tasks(uint32_t array_job_id)
 {
 	job_record_t *job_ptr;
-	int count = 0, inx;
+	int count = 0;
 
-	inx = JOB_HASH_INX(array_job_id);
-	job_ptr = job_array_hash_j[inx];
-	while (job_ptr) {
-		if ((job_ptr->array_job_id == array_job_id) &&
-		    IS_JOB_PENDING(job_ptr))
+	for (job_ptr = job_hash_array_first(array_job_id); job_ptr;
+	     job_ptr = job_ptr->job_array_next_j) {
+		if (IS_JOB_PENDING(job_ptr))
 			count++;
-		job_ptr = job_ptr->job_array_next_j;
 	}
 
 	return count;
@@ -3323,28 +3721,17 @@ extern job_record_t *find_job_array_rec(uint32_t array_job_id,
 		    (job_ptr->array_job_id == array_job_id))
 			return job_ptr;
 
-		inx = JOB_HASH_INX(array_job_id);
-		job_ptr = job_array_hash_j[inx];
-		while (job_ptr) {
-			if (job_ptr->array_job_id == array_job_id) {
-				match_job_ptr = job_ptr;
-				if (!IS_JOB_FINISHED(job_ptr)) {
-					return job_ptr;
-				}
-			}
-			job_ptr = job_ptr->job_array_next_j;
+		for (job_ptr = job_hash_array_first(array_job_id); job_ptr;
+		     job_ptr = job_ptr->job_array_next_j) {
+			match_job_ptr = job_ptr;
+			if (!IS_JOB_FINISHED(job_ptr))
+				return job_ptr;
 		}
 		return match_job_ptr;
 	} else {		/* Find specific task ID */
-		inx = JOB_ARRAY_HASH_INX(array_job_id, array_task_id);
-		job_ptr = job_array_hash_t[inx];
-		while (job_ptr) {
-			if ((job_ptr->array_job_id == array_job_id) &&
-			    (job_ptr->array_task_id == array_task_id)) {
-				return job_ptr;
-			}
-			job_ptr = job_ptr->job_array_next_t;
-		}
+		job_ptr = job_hash_array_find(array_job_id, array_task_id);
+		if (job_ptr)
+			return job_ptr;
 		/* Look for job record with all of the pending tasks */
 		job_ptr = find_job_record(array_job_id);
 		if (job_ptr && job_ptr->array_recs &&
@@ -3371,12 +3758,7 @@ extern job_record_t *find_het_job_record(uint32_t job_id, uint32_t het_job_id)
 	job_record_t *het_job_leader, *het_job;
 	ListIterator iter;
 
-	het_job_leader = job_hash[JOB_HASH_INX(job_id)];
-	while (het_job_leader) {
-		if (het_job_leader->job_id == job_id)
-			break;
-		het_job_leader = het_job_leader->job_next;
-	}
+	het_job_leader = job_hash_find(job_id);
 	if (!het_job_leader)
 		return NULL;
 	if (het_job_leader->het_job_offset == het_job_id)
@@ -3406,16 +3788,7 @@ extern job_record_t *find_het_job_record(uint32_t job_id, uint32_t het_job_id)
  */
 extern job_record_t *find_job_record(uint32_t job_id)
 {
-	job_record_t *job_ptr;
-
-	job_ptr = job_hash[JOB_HASH_INX(job_id)];
-	while (job_ptr) {
-		if (job_ptr->job_id == job_id)
-			return job_ptr;
-		job_ptr = job_ptr->job_next;
-	}
-
-	return NULL;
+	return job_hash_find(job_id);
 }
 
 /* rebuild a job's partition name list based upon the contents of its
@@ -3430,7 +3803,7 @@ static void _rebuild_part_name_list(job_record_t *job_ptr)
 
 	if (!job_ptr->part_ptr_list) {
 		job_ptr->partition = xstrdup(job_ptr->part_ptr->name);
-		last_job_update = time(NULL);
+		job_state_changed(job_ptr, time(NULL));
 		return;
 	}
 
@@ -3454,7 +3827,7 @@ static void _rebuild_part_name_list(job_record_t *job_ptr)
 		xstrcat(job_ptr->partition, part_ptr->name);
 	}
 	list_iterator_destroy(part_iterator);
-	last_job_update = time(NULL);
+	job_state_changed(job_ptr, time(NULL));
 }
 
 /*
@@ -3673,6 +4046,7 @@ extern int kill_job_by_part_name(char *part_name)
 		}
 		if (IS_JOB_RUNNING(job_ptr) || suspended) {
 			kill_job_cnt++;
+			job_state_changed(job_ptr, now);
 			info("Killing %pJ on defunct partition %s",
 			     job_ptr, part_name);
 			job_ptr->job_state = JOB_NODE_FAIL | JOB_COMPLETING;
@@ -3691,6 +4065,7 @@ extern int kill_job_by_part_name(char *part_name)
 						 false);
 		} else if (pending) {
 			kill_job_cnt++;
+			job_state_changed(job_ptr, now);
 			info("Killing %pJ on defunct partition %s",
 			     job_ptr, part_name);
 			job_ptr->job_state	= JOB_CANCELLED;
@@ -3705,8 +4080,6 @@ extern int kill_job_by_part_name(char *part_name)
 	}
 	list_iterator_destroy(job_iterator);
 
-	if (kill_job_cnt)
-		last_job_update = now;
 	return kill_job_cnt;
 }
 
@@ -3758,6 +4131,7 @@ extern int kill_job_by_front_end_name(char *node_name)
 		}
 		if (IS_JOB_COMPLETING(job_ptr)) {
 			kill_job_cnt++;
+			job_state_changed(job_ptr, now);
 			while ((i = bit_ffs(job_ptr->node_bitmap_cg)) >= 0) {
 				bit_clear(job_ptr->node_bitmap_cg, i);
 				if (job_ptr->node_cnt)
@@ -3780,6 +4154,7 @@ extern int kill_job_by_front_end_name(char *node_name)
 			}
 		} else if (IS_JOB_RUNNING(job_ptr) || suspended) {
 			kill_job_cnt++;
+			job_state_changed(job_ptr, now);
 			if (job_ptr->batch_flag && job_ptr->details &&
 			    slurmctld_conf.job_requeue &&
 			    (job_ptr->details->requeue > 0)) {
@@ -3863,8 +4238,6 @@ extern int kill_job_by_front_end_name(char *node_name)
 	}
 	list_iterator_destroy(job_iterator);
 
-	if (kill_job_cnt)
-		last_job_update = now;
 	return kill_job_cnt;
 #else
 	return 0;
@@ -4011,6 +4384,7 @@ extern int kill_running_job_by_node_name(char *node_name)
 			if (!bit_test(job_ptr->node_bitmap_cg, node_inx))
 				continue;
 			kill_job_cnt++;
+			job_state_changed(job_ptr, now);
 			bit_clear(job_ptr->node_bitmap_cg, node_inx);
 			job_update_tres_cnt(job_ptr, node_inx);
 			if (job_ptr->node_cnt)
@@ -4029,6 +4403,7 @@ extern int kill_running_job_by_node_name(char *node_name)
 			}
 		} else if (IS_JOB_RUNNING(job_ptr) || suspended) {
 			kill_job_cnt++;
+			job_state_changed(job_ptr, now);
 			if ((job_ptr->details) &&
 			    (job_ptr->kill_on_node_fail == 0) &&
 			    (job_ptr->node_cnt > 1) &&
@@ -4129,8 +4504,6 @@ extern int kill_running_job_by_node_name(char *node_name)
 
 	}
 	list_iterator_destroy(job_iterator);
-	if (kill_job_cnt)
-		last_job_update = now;
 
 	return kill_job_cnt;
 }
@@ -4437,6 +4810,9 @@ int init_job_conf(void)
 		purge_files_list = list_create(xfree_ptr);
 	}
 
+	if (!job_journal_purged)
+		job_journal_purged = list_create(xfree_ptr);
+
 	return SLURM_SUCCESS;
 }
 
@@ -4448,21 +4824,9 @@ extern void rehash_jobs(void)
 	xassert(verify_lock(CONF_LOCK, READ_LOCK));
 	xassert(verify_lock(JOB_LOCK, WRITE_LOCK));
 
-	if (job_hash == NULL) {
-		hash_table_size = slurmctld_conf.max_job_cnt;
-		job_hash = xcalloc(hash_table_size, sizeof(job_record_t *));
-		job_array_hash_j = xcalloc(hash_table_size,
-					   sizeof(job_record_t *));
-		job_array_hash_t = xcalloc(hash_table_size,
-					   sizeof(job_record_t *));
-	} else if (hash_table_size < (slurmctld_conf.max_job_cnt / 2)) {
-		/* If the MaxJobCount grows by too much, the hash table will
-		 * be ineffective without rebuilding. We don't presently bother
-		 * to rebuild the hash table, but cut MaxJobCount back as
-		 * needed. */
-		error ("MaxJobCount reset too high, restart slurmctld");
-		slurmctld_conf.max_job_cnt = hash_table_size;
-	}
+	/* The tables are resized as jobs are added, also beyond MaxJobCount
+	 * if it is raised later on */
+	job_hash_init(slurmctld_conf.max_job_cnt);
 }
 
 /* Create an exact copy of an existing job record for a job array.
@@ -4472,7 +4836,7 @@ extern void rehash_jobs(void)
  * RET - The new job record, which is the new META job record. */
 extern job_record_t *job_array_split(job_record_t *job_ptr)
 {
-	job_record_t *job_ptr_pend = NULL, *save_job_next;
+	job_record_t *job_ptr_pend = NULL;
 	struct job_details *job_details, *details_new, *save_details;
 	uint32_t save_job_id;
 	uint64_t save_db_index = job_ptr->db_index;
@@ -4498,18 +4862,19 @@ extern job_record_t *job_array_split(job_record_t *job_ptr)
 	 * This could be done in parallel, but performance was worse.
 	 */
 	save_job_id   = job_ptr_pend->job_id;
-	save_job_next = job_ptr_pend->job_next;
 	save_details  = job_ptr_pend->details;
 	save_prio_factors = job_ptr_pend->prio_factors;
 	save_step_list = job_ptr_pend->step_list;
 	memcpy(job_ptr_pend, job_ptr, sizeof(job_record_t));
 
 	job_ptr_pend->job_id   = save_job_id;
-	job_ptr_pend->job_next = save_job_next;
+	job_ptr_pend->job_array_next_j = NULL;
+	job_ptr_pend->job_array_prev_j = NULL;
 	job_ptr_pend->details  = save_details;
 	job_ptr_pend->db_flags = 0;
 	job_ptr_pend->step_list = save_step_list;
 	job_ptr_pend->db_index = save_db_index;
+	sched_queue_move_job(job_ptr, job_ptr_pend);
 
 	job_ptr_pend->prio_factors = save_prio_factors;
 	slurm_copy_priority_factors_object(job_ptr_pend->prio_factors,
@@ -4562,8 +4927,8 @@ extern job_record_t *job_array_split(job_record_t *job_ptr)
 	memcpy(job_ptr_pend->limit_set.tres, job_ptr->limit_set.tres,
 	       sizeof(uint16_t) * slurmctld_tres_cnt);
 
-	_add_job_hash(job_ptr);		/* Sets job_next */
-	_add_job_hash(job_ptr_pend);	/* Sets job_next */
+	_add_job_hash(job_ptr);
+	_add_job_hash(job_ptr_pend);
 	_add_job_array_hash(job_ptr);
 	job_ptr_pend->job_resrcs = NULL;
 
@@ -4704,6 +5069,9 @@ extern job_record_t *job_array_split(job_record_t *job_ptr)
 							   false);
 	}
 
+	job_state_changed(job_ptr, time(NULL));
+	job_state_changed(job_ptr_pend, last_job_update);
+
 	return job_ptr_pend;
 }
 
@@ -5141,8 +5509,10 @@ extern int job_allocate(job_desc_msg_t * job_specs, int immediate,
 
 	error_code = _select_nodes_parts(job_ptr, no_alloc, NULL, err_msg);
 	if (!test_only) {
-		last_job_update = now;
+		job_state_changed(job_ptr, now);
 	}
+	if (IS_JOB_PENDING(job_ptr))
+		schedule_job_changed(job_ptr);
 
 	if (held_user)
 		job_ptr->state_reason = WAIT_HELD_USER;
@@ -5266,7 +5636,7 @@ static int _job_fail(job_record_t *job_ptr, uint32_t job_state)
 				difftime(now, job_ptr->suspend_time);
 		} else
 			job_ptr->end_time       = now;
-		last_job_update                 = now;
+		job_state_changed(job_ptr, now);
 		job_ptr->job_state = job_state | JOB_COMPLETING;
 		job_ptr->exit_code = 1;
 		job_ptr->state_reason = FAIL_LAUNCH;
@@ -5394,7 +5764,7 @@ extern int job_signal(job_record_t *job_ptr, uint16_t signal,
 
 	/* let node select plugin do any state-dependent signaling actions */
 	select_g_job_signal(job_ptr, signal);
-	last_job_update = now;
+	job_state_changed(job_ptr, now);
 
 	/* save user ID of the one who requested the job be cancelled */
 	if (signal == SIGKILL)
@@ -5414,7 +5784,7 @@ extern int job_signal(job_record_t *job_ptr, uint16_t signal,
 		job_ptr->bit_flags |= JOB_KILL_HURRY;
 
 	if (IS_JOB_CONFIGURING(job_ptr) && (signal == SIGKILL)) {
-		last_job_update         = now;
+		job_state_changed(job_ptr, now);
 		job_ptr->end_time       = now;
 		job_ptr->job_state      = JOB_CANCELLED | JOB_COMPLETING;
 		if (flags & KILL_FED_REQUEUE)
@@ -5459,7 +5829,7 @@ extern int job_signal(job_record_t *job_ptr, uint16_t signal,
 	else
 		job_term_state = JOB_CANCELLED;
 	if (IS_JOB_SUSPENDED(job_ptr) && (signal == SIGKILL)) {
-		last_job_update         = now;
+		job_state_changed(job_ptr, now);
 		job_ptr->end_time       = job_ptr->suspend_time;
 		job_ptr->tot_sus_time  += difftime(now, job_ptr->suspend_time);
 		job_ptr->job_state      = job_term_state | JOB_COMPLETING;
@@ -5495,7 +5865,7 @@ extern int job_signal(job_record_t *job_ptr, uint16_t signal,
 			 */
 			job_ptr->time_last_active	= now;
 			job_ptr->end_time		= now;
-			last_job_update			= now;
+			job_state_changed(job_ptr, now);
 			job_ptr->job_state = job_term_state | JOB_COMPLETING;
 			if (flags & KILL_FED_REQUEUE)
 				job_ptr->job_state |= JOB_REQUEUE;
@@ -5718,19 +6088,13 @@ extern int job_str_signal(char *job_id_str, uint16_t signal, uint16_t flags,
 		}
 
 		/* Signal all tasks of this job array */
-		job_ptr = job_array_hash_j[JOB_HASH_INX(job_id)];
+		job_ptr = job_hash_array_first(job_id);
 		if (!job_ptr && !job_ptr_done) {
 			info("%s(3): invalid JobId=%u", __func__, job_id);
 			return ESLURM_INVALID_JOB_ID;
 		}
 		while (job_ptr) {
-			if (job_ptr->array_job_id == job_id)
-				break;
-			job_ptr = job_ptr->job_array_next_j;
-		}
-		while (job_ptr) {
-			if ((job_ptr->array_job_id == job_id) &&
-			    (job_ptr != job_ptr_done)) {
+			if (job_ptr != job_ptr_done) {
 				rc2 = job_signal(job_ptr, signal, flags, uid,
 						 preempt);
 				jobs_signaled++;
@@ -5770,14 +6134,8 @@ extern int job_str_signal(char *job_id_str, uint16_t signal, uint16_t flags,
 
 	/* Find some job record and validate the user signaling the job */
 	job_ptr = find_job_record(job_id);
-	if (job_ptr == NULL) {
-		job_ptr = job_array_hash_j[JOB_HASH_INX(job_id)];
-		while (job_ptr) {
-			if (job_ptr->array_job_id == job_id)
-				break;
-			job_ptr = job_ptr->job_array_next_j;
-		}
-	}
+	if (job_ptr == NULL)
+		job_ptr = job_hash_array_first(job_id);
 	if ((job_ptr == NULL) ||
 	    ((job_ptr->array_task_id == NO_VAL) &&
 	     (job_ptr->array_recs == NULL))) {
@@ -5813,6 +6171,7 @@ extern int job_str_signal(char *job_id_str, uint16_t signal, uint16_t flags,
 			bitstr_t *task_id_bitmap_orig =
 				bit_copy(job_ptr->array_recs->task_id_bitmap);
 
+			job_state_changed(job_ptr, now);
 			bit_and_not(job_ptr->array_recs->task_id_bitmap,
 				array_bitmap);
 			xfree(job_ptr->array_recs->task_id_str);
@@ -5820,7 +6179,6 @@ extern int job_str_signal(char *job_id_str, uint16_t signal, uint16_t flags,
 			new_task_count = bit_set_count(job_ptr->array_recs->
 						       task_id_bitmap);
 			if (!new_task_count) {
-				last_job_update		= now;
 				job_ptr->job_state	= JOB_CANCELLED;
 				job_ptr->start_time	= now;
 				job_ptr->end_time	= now;
@@ -5978,7 +6336,7 @@ static int _job_complete(job_record_t *job_ptr, uid_t uid, bool requeue,
 	int use_cloud = false;
 	uint16_t over_time_limit;
 
-	xassert(verify_lock(JOB_LOCK, WRITE_LOCK));
+	xassert(verify_job_rec_lock(job_ptr->job_id));
 	xassert(verify_lock(FED_LOCK, READ_LOCK));
 
 	if (IS_JOB_FINISHED(job_ptr)) {
@@ -6160,7 +6518,7 @@ static int _job_complete(job_record_t *job_ptr, uid_t uid, bool requeue,
 		job_completion_logger(job_ptr, false);
 	}
 
-	last_job_update = now;
+	job_state_changed(job_ptr, now);
 	job_ptr->time_last_active = now;   /* Timer for resending kill RPC */
 	if (job_comp_flag) {	/* job was running */
 		build_cg_bitmap(job_ptr);
@@ -6194,7 +6552,7 @@ extern int job_complete(uint32_t job_id, uid_t uid, bool requeue,
 	ListIterator iter;
 	int rc, rc1;
 
-	xassert(verify_lock(JOB_LOCK, WRITE_LOCK));
+	xassert(verify_job_rec_lock(job_id));
 	xassert(verify_lock(FED_LOCK, READ_LOCK));
 
 	job_ptr = find_job_record(job_id);
@@ -6210,6 +6568,8 @@ extern int job_complete(uint32_t job_id, uid_t uid, bool requeue,
 	}
 
 	if (job_ptr->het_job_list) {
+		/* Completes the other components too */
+		xassert(verify_lock(JOB_LOCK, WRITE_LOCK));
 		rc = SLURM_SUCCESS;
 		iter = list_iterator_create(job_ptr->het_job_list);
 		while ((het_job_ptr = list_next(iter))) {
@@ -7310,6 +7670,7 @@ static int _job_create(job_desc_msg_t *job_desc, int allocate, int will_run,
 
 	job_ptr->license_list = license_list;
 	license_list = NULL;
+	license_job_compact(job_ptr);
 
 	if (job_desc->req_switch != NO_VAL) {	/* Max # of switches */
 		job_ptr->req_switch = job_desc->req_switch;
@@ -8654,7 +9015,7 @@ extern void job_config_fini(job_record_t *job_ptr)
 {
 	time_t now = time(NULL);
 
-	last_job_update = now;
+	job_state_changed(job_ptr, now);
 	job_ptr->job_state &= ~JOB_CONFIGURING;
 	if (IS_JOB_POWER_UP_NODE(job_ptr)) {
 		info("Resetting %pJ start time for node power up", job_ptr);
@@ -8809,7 +9170,7 @@ void job_time_limit(void)
 		    IS_JOB_PENDING(job_ptr) && (job_ptr->priority == 0)) {
 			job_ptr->state_reason = WAIT_NO_REASON;
 			set_job_prio(job_ptr);
-			last_job_update = now;
+			job_state_changed(job_ptr, now);
 		}
 
 		/* Don't enforce time limits for configuring hetjobs */
@@ -8889,7 +9250,7 @@ void job_time_limit(void)
 			else
 				over_run = now - (over_time_limit  * 60);
 			if (job_ptr->end_time <= over_run) {
-				last_job_update = now;
+				job_state_changed(job_ptr, now);
 				info("Time limit exhausted for %pJ", job_ptr);
 				_job_timed_out(job_ptr, false);
 				job_ptr->state_reason = FAIL_TIMEOUT;
@@ -8901,7 +9262,7 @@ void job_time_limit(void)
 		if (job_ptr->resv_ptr &&
 		    !(job_ptr->resv_ptr->flags & RESERVE_FLAG_FLEX) &&
 		    (job_ptr->resv_ptr->end_time + resv_over_run) < time(NULL)){
-			last_job_update = now;
+			job_state_changed(job_ptr, now);
 			info("Reservation ended for %pJ", job_ptr);
 			_job_timed_out(job_ptr, false);
 			job_ptr->state_reason = FAIL_TIMEOUT;
@@ -8920,7 +9281,7 @@ void job_time_limit(void)
 		acct_policy_job_time_out(job_ptr);
 
 		if (job_ptr->state_reason == FAIL_TIMEOUT) {
-			last_job_update = now;
+			job_state_changed(job_ptr, now);
 			_job_timed_out(job_ptr, false);
 			xfree(job_ptr->state_desc);
 			goto time_check;
@@ -9368,12 +9729,14 @@ static void _delete_job_common(job_record_t *job_ptr)
 	/* Remove record from fed_job_list */
 	fed_mgr_remove_fed_job_info(job_ptr->job_id);
 
+	/* Remove the job's records from the main scheduler's queue */
+	sched_queue_remove_job(job_ptr);
+
 	/* Remove the record from job hash table */
 	_remove_job_hash(job_ptr, JOB_HASH_JOB);
 
 	/* Remove the record from job array hash tables, if applicable */
 	if (job_ptr->array_task_id != NO_VAL) {
-		_remove_job_hash(job_ptr, JOB_HASH_ARRAY_JOB);
 		_remove_job_hash(job_ptr, JOB_HASH_ARRAY_TASK);
 	}
 }
@@ -9394,6 +9757,12 @@ static void _list_delete_job(void *job_entry)
 
 	_delete_job_common(job_ptr);
 
+	if (job_journal_purged && job_ptr->job_id) {
+		uint32_t *job_id_ptr = xmalloc(sizeof(uint32_t));
+		*job_id_ptr = job_ptr->job_id;
+		list_append(job_journal_purged, job_id_ptr);
+	}
+
 	if (job_ptr->array_recs) {
 		job_array_size = MAX(1, job_ptr->array_recs->task_cnt);
 	} else {
@@ -9602,6 +9971,21 @@ end_it:
 	return 1;		/* Purge the job */
 }
 
+/*
+ * Determine if ALL partitions of a job table snapshot record are hidden
+ * IN part_visible - visibility of the snapshot's partitions to the user
+ */
+static bool _all_snap_parts_hidden(job_snap_rec_t *rec, bool *part_visible)
+{
+	int i;
+
+	for (i = 0; i < rec->part_cnt; i++) {
+		if (part_visible[rec->part_inx[i]])
+			return false;
+	}
+	return true;
+}
+
 /* Determine if ALL partitions associated with a job are hidden */
 static bool _all_parts_hidden(job_record_t *job_ptr, uid_t uid)
 {
@@ -9627,23 +10011,30 @@ static bool _all_parts_hidden(job_record_t *job_ptr, uid_t uid)
 	return true;
 }
 
-/* Determine if a given job should be seen by a specific user */
-static bool _hide_job(job_record_t *job_ptr, uid_t uid, uint16_t show_flags)
+/* Determine if a job of the given user, account and MCS label is private */
+static bool _hide_job_private(uint32_t user_id, char *account,
+			      char *mcs_label, uid_t uid)
 {
-	if (!(show_flags & SHOW_ALL) && IS_JOB_REVOKED(job_ptr))
-		return true;
-
 	if ((slurmctld_conf.private_data & PRIVATE_DATA_JOBS) &&
-	    (job_ptr->user_id != uid) && !validate_operator(uid) &&
+	    (user_id != uid) && !validate_operator(uid) &&
 	    (((slurm_mcs_get_privatedata() == 0) &&
-	      !assoc_mgr_is_user_acct_coord(acct_db_conn, uid,
-					    job_ptr->account)) ||
+	      !assoc_mgr_is_user_acct_coord(acct_db_conn, uid, account)) ||
 	     ((slurm_mcs_get_privatedata() == 1) &&
-	      (mcs_g_check_mcs_label(uid, job_ptr->mcs_label) != 0))))
+	      (mcs_g_check_mcs_label(uid, mcs_label) != 0))))
 		return true;
 	return false;
 }
 
+/* Determine if a given job should be seen by a specific user */
+static bool _hide_job(job_record_t *job_ptr, uid_t uid, uint16_t show_flags)
+{
+	if (!(show_flags & SHOW_ALL) && IS_JOB_REVOKED(job_ptr))
+		return true;
+
+	return _hide_job_private(job_ptr->user_id, job_ptr->account,
+				 job_ptr->mcs_label, uid);
+}
+
 static void _pack_job(job_record_t *job_ptr,
 		      _foreach_pack_job_info_t *pack_info)
 {
@@ -9738,6 +10129,417 @@ extern void pack_all_jobs(char **buffer_ptr, int *buffer_size,
 	buffer_ptr[0] = xfer_buf_data(buffer);
 }
 
+static void _job_snap_free(void *x)
+{
+	job_snap_t *snap = (job_snap_t *) x;
+	uint32_t i;
+
+	if (!snap)
+		return;
+	for (i = 0; i < snap->rec_cnt; i++) {
+		xfree(snap->recs[i].account);
+		xfree(snap->recs[i].mcs_label);
+		xfree(snap->recs[i].part_inx);
+	}
+	xfree(snap->recs);
+	xfree(snap->parts);
+	free_buf(snap->buffer);
+	xfree(snap);
+}
+
+/* Drop a reference to a job table snapshot. job_snap_mutex must be locked */
+static void _job_snap_unref(job_snap_t *snap)
+{
+	if (--snap->ref_cnt == 0)
+		_job_snap_free(snap);
+}
+
+static void _job_snap_list_del(void *x)
+{
+	_job_snap_unref((job_snap_t *) x);
+}
+
+/*
+ * A snapshot is current if built in a later second than the last change to
+ *	jobs and partitions, so it also covers changes made in the second it was
+ *	built in.
+ * NOTE: Partition read lock must be held
+ */
+static bool _job_snap_current(job_snap_t *snap)
+{
+	return ((snap->build_time > last_job_update) &&
+		(snap->build_time > last_part_update));
+}
+
+/*
+ * Get a reference to the job table snapshot packed with the given show_flags
+ *	and protocol version, removing snapshots whose partition pointers are
+ *	out of date. A current snapshot found is counted as job info cache hit
+ *	for sdiag.
+ * OUT base - if not NULL, set to a reference to the snapshot if it is out of
+ *	date but can be updated by _job_snap_build(), else NULL
+ * NOTE: Partition read lock must be held
+ * RET current snapshot to be released with _job_snap_put(), or NULL if none
+ */
+static job_snap_t *_job_snap_get(uint16_t show_flags,
+				 uint16_t protocol_version, job_snap_t **base)
+{
+	job_snap_t *snap, *found = NULL;
+	ListIterator iter;
+
+	if (base)
+		*base = NULL;
+
+	slurm_mutex_lock(&job_snap_mutex);
+	if (!job_snap_list)
+		job_snap_list = list_create(_job_snap_list_del);
+	iter = list_iterator_create(job_snap_list);
+	while ((snap = list_next(iter))) {
+		if (snap->build_time <= last_part_update) {
+			list_delete_item(iter);
+			continue;
+		}
+		if ((snap->show_flags != show_flags) ||
+		    (snap->protocol_version != protocol_version))
+			continue;
+		if (_job_snap_current(snap)) {
+			snap->ref_cnt++;
+			snap->last_used = time(NULL);
+			found = snap;
+		} else if (base) {
+			snap->ref_cnt++;
+			*base = snap;
+		}
+	}
+	list_iterator_destroy(iter);
+	if (found)
+		slurmctld_diag_stats.job_info_cache_hits++;
+	slurm_mutex_unlock(&job_snap_mutex);
+
+	return found;
+}
+
+static void _job_snap_put(job_snap_t *snap)
+{
+	slurm_mutex_lock(&job_snap_mutex);
+	_job_snap_unref(snap);
+	slurm_mutex_unlock(&job_snap_mutex);
+}
+
+static int _job_snap_lru(void *x, void *key)
+{
+	job_snap_t *snap = (job_snap_t *) x;
+	job_snap_t *lru = (job_snap_t *) key;
+
+	return (snap == lru);
+}
+
+static int _job_snap_same_key(void *x, void *key)
+{
+	job_snap_t *snap = (job_snap_t *) x;
+	job_snap_t *new_snap = (job_snap_t *) key;
+
+	return ((snap->show_flags == new_snap->show_flags) &&
+		(snap->protocol_version == new_snap->protocol_version));
+}
+
+/* Get the index of a partition in a job table snapshot being built */
+static uint16_t _job_snap_part_inx(job_snap_t *snap, part_record_t *part_ptr)
+{
+	uint16_t i;
+
+	for (i = 0; i < snap->part_cnt; i++) {
+		if (snap->parts[i] == part_ptr)
+			break;
+	}
+	xassert(i < snap->part_cnt);
+
+	return i;
+}
+
+/* Pack a job into a record of a job table snapshot being built */
+static void _job_snap_rec_pack(job_snap_t *snap, job_snap_rec_t *rec,
+			       job_record_t *job_ptr)
+{
+	part_record_t *part_ptr;
+	ListIterator part_iterator;
+
+	rec->account = xstrdup(job_ptr->account);
+	rec->job_id = job_ptr->job_id;
+	rec->job_ptr = job_ptr;
+	rec->mcs_label = xstrdup(job_ptr->mcs_label);
+	rec->revoked = IS_JOB_REVOKED(job_ptr);
+	rec->user_id = job_ptr->user_id;
+	if (job_ptr->part_ptr_list) {
+		rec->part_inx = xcalloc(list_count(job_ptr->part_ptr_list),
+					sizeof(uint16_t));
+		part_iterator = list_iterator_create(job_ptr->part_ptr_list);
+		while ((part_ptr = list_next(part_iterator)))
+			rec->part_inx[rec->part_cnt++] =
+				_job_snap_part_inx(snap, part_ptr);
+		list_iterator_destroy(part_iterator);
+	} else if (job_ptr->part_ptr) {
+		rec->part_inx = xcalloc(1, sizeof(uint16_t));
+		rec->part_inx[rec->part_cnt++] =
+			_job_snap_part_inx(snap, job_ptr->part_ptr);
+	}
+	rec->offset = get_buf_offset(snap->buffer);
+	pack_job(job_ptr, snap->show_flags, snap->buffer,
+		 snap->protocol_version, 0);
+	rec->size = get_buf_offset(snap->buffer) - rec->offset;
+}
+
+/*
+ * Find the record of a job in the snapshot a new snapshot is built from.
+ *	Records are in job_list order, so the search starts after the record
+ *	found last.
+ * IN/OUT base_inx - index of the base record to search from
+ * RET base record of the job or NULL if not found
+ */
+static job_snap_rec_t *_job_snap_rec_find(job_snap_t *base,
+					  uint32_t *base_inx,
+					  job_record_t *job_ptr)
+{
+	uint32_t i;
+
+	for (i = *base_inx; i < base->rec_cnt; i++) {
+		if ((base->recs[i].job_ptr == job_ptr) &&
+		    (base->recs[i].job_id == job_ptr->job_id)) {
+			*base_inx = i + 1;
+			return &base->recs[i];
+		}
+	}
+
+	return NULL;
+}
+
+/* Copy a record of an unchanged job into a job table snapshot being built */
+static void _job_snap_rec_copy(job_snap_t *snap, job_snap_rec_t *rec,
+			       job_snap_t *base, job_snap_rec_t *base_rec)
+{
+	rec->account = xstrdup(base_rec->account);
+	rec->job_id = base_rec->job_id;
+	rec->job_ptr = base_rec->job_ptr;
+	rec->mcs_label = xstrdup(base_rec->mcs_label);
+	rec->revoked = base_rec->revoked;
+	rec->user_id = base_rec->user_id;
+	rec->part_cnt = base_rec->part_cnt;
+	if (rec->part_cnt) {
+		rec->part_inx = xcalloc(rec->part_cnt, sizeof(uint16_t));
+		memcpy(rec->part_inx, base_rec->part_inx,
+		       rec->part_cnt * sizeof(uint16_t));
+	}
+	rec->offset = get_buf_offset(snap->buffer);
+	packmem_array(get_buf_data(base->buffer) + base_rec->offset,
+		      base_rec->size, snap->buffer);
+	rec->size = base_rec->size;
+}
+
+/*
+ * Build a new job table snapshot and publish it, replacing the out of date
+ *	snapshot with the same show_flags and protocol version, and the least
+ *	recently used snapshot once JOB_SNAP_MAX are kept. Counted as job info
+ *	cache miss for sdiag.
+ * IN base - out of date snapshot from _job_snap_get() or NULL. Jobs not
+ *	changed since it was built are copied from it instead of packed again,
+ *	unless its jobs were last all packed JOB_SNAP_FULL_AGE seconds ago.
+ * NOTE: Config, job and partition read locks must be held
+ * RET snapshot to be released with _job_snap_put()
+ */
+static job_snap_t *_job_snap_build(uint16_t show_flags,
+				   uint16_t protocol_version, job_snap_t *base)
+{
+	job_snap_t *snap, *lru = NULL;
+	job_snap_rec_t *rec, *base_rec;
+	job_record_t *job_ptr;
+	part_record_t *part_ptr;
+	ListIterator itr;
+	uint32_t base_inx = 0;
+
+	snap = xmalloc(sizeof(job_snap_t));
+	snap->build_time = time(NULL);
+	snap->last_used = snap->build_time;
+	snap->protocol_version = protocol_version;
+	snap->ref_cnt = 2;	/* caller and job_snap_list */
+	snap->show_flags = show_flags;
+	snap->buffer = init_buf(BUF_SIZE);
+	snap->recs = xcalloc(list_count(job_list) + 1, sizeof(job_snap_rec_t));
+
+	if (base && ((snap->build_time - base->full_time) < JOB_SNAP_FULL_AGE))
+		snap->full_time = base->full_time;
+	else {
+		base = NULL;
+		snap->full_time = snap->build_time;
+	}
+
+	snap->parts = xcalloc(list_count(part_list) + 1,
+			      sizeof(part_record_t *));
+	itr = list_iterator_create(part_list);
+	while ((part_ptr = list_next(itr)))
+		snap->parts[snap->part_cnt++] = part_ptr;
+	list_iterator_destroy(itr);
+
+	itr = list_iterator_create(job_list);
+	while ((job_ptr = list_next(itr))) {
+		xassert (job_ptr->magic == JOB_MAGIC);
+		rec = &snap->recs[snap->rec_cnt++];
+		if (base && (job_ptr->last_update < base->build_time) &&
+		    (base_rec = _job_snap_rec_find(base, &base_inx, job_ptr)))
+			_job_snap_rec_copy(snap, rec, base, base_rec);
+		else
+			_job_snap_rec_pack(snap, rec, job_ptr);
+	}
+	list_iterator_destroy(itr);
+
+	slurm_mutex_lock(&job_snap_mutex);
+	if (!job_snap_list)
+		job_snap_list = list_create(_job_snap_list_del);
+	list_delete_all(job_snap_list, _job_snap_same_key, snap);
+	if (list_count(job_snap_list) >= JOB_SNAP_MAX) {
+		job_snap_t *tmp_snap;
+		itr = list_iterator_create(job_snap_list);
+		while ((tmp_snap = list_next(itr))) {
+			if (!lru || (tmp_snap->last_used < lru->last_used))
+				lru = tmp_snap;
+		}
+		list_iterator_destroy(itr);
+		list_delete_all(job_snap_list, _job_snap_lru, lru);
+	}
+	list_append(job_snap_list, snap);
+	slurmctld_diag_stats.job_info_cache_misses++;
+	slurm_mutex_unlock(&job_snap_mutex);
+
+	return snap;
+}
+
+/*
+ * Get the visibility of the partitions of a current job table snapshot to a
+ *	user, NULL if partitions are not filtered
+ * NOTE: Partition read lock must be held
+ * NOTE: the returned array must be xfreed by the caller
+ */
+static bool *_job_snap_part_visible(job_snap_t *snap, uint16_t show_flags,
+				    uid_t uid)
+{
+	bool *part_visible;
+	uint16_t i;
+
+	if ((show_flags & SHOW_ALL) || (uid == 0))
+		return NULL;
+
+	part_visible = xcalloc(snap->part_cnt + 1, sizeof(bool));
+	for (i = 0; i < snap->part_cnt; i++)
+		part_visible[i] = part_is_visible(snap->parts[i], uid);
+
+	return part_visible;
+}
+
+/* Copy the records of a job table snapshot visible to a user into a buffer */
+static uint32_t _job_snap_pack(job_snap_t *snap, Buf buffer,
+			       uint16_t show_flags, uid_t uid,
+			       uint32_t filter_uid, bool *part_visible)
+{
+	job_snap_rec_t *rec;
+	uint32_t i, jobs_packed = 0;
+	char *data = get_buf_data(snap->buffer);
+
+	for (i = 0; i < snap->rec_cnt; i++) {
+		rec = &snap->recs[i];
+		if ((filter_uid != NO_VAL) && (filter_uid != rec->user_id))
+			continue;
+		if (part_visible && _all_snap_parts_hidden(rec, part_visible))
+			continue;
+		if (!(show_flags & SHOW_ALL) && rec->revoked)
+			continue;
+		if (_hide_job_private(rec->user_id, rec->account,
+				      rec->mcs_label, uid))
+			continue;
+		packmem_array(data + rec->offset, rec->size, buffer);
+		jobs_packed++;
+	}
+
+	return jobs_packed;
+}
+
+/*
+ * pack_all_jobs_snapshot - dump all job information for all jobs in
+ *	machine independent form (for network transmission) like
+ *	pack_all_jobs(), but copy the packed jobs from a snapshot of the job
+ *	table shared by all requests. Once jobs changed, the snapshot is
+ *	updated under the job read lock, packing only the jobs changed.
+ *	Requests for an unchanged job table only take the partition read lock
+ *	to check the visibility of the partitions.
+ * OUT buffer_ptr - the pointer is set to the allocated buffer.
+ * OUT buffer_size - set to size of the buffer in bytes
+ * IN show_flags - job filtering options
+ * IN uid - uid of user making request (for partition filtering)
+ * IN filter_uid - pack only jobs belonging to this user if not NO_VAL
+ * NOTE: the buffer at *buffer_ptr must be xfreed by the caller
+ * NOTE: call without any slurmctld locks held
+ */
+extern void pack_all_jobs_snapshot(char **buffer_ptr, int *buffer_size,
+				   uint16_t show_flags, uid_t uid,
+				   uint32_t filter_uid,
+				   uint16_t protocol_version)
+{
+	/* Locks: Read partition */
+	slurmctld_lock_t part_read_lock = {
+		NO_LOCK, NO_LOCK, NO_LOCK, READ_LOCK, NO_LOCK };
+	/* Locks: Read config job part */
+	slurmctld_lock_t job_read_lock = {
+		READ_LOCK, READ_LOCK, NO_LOCK, READ_LOCK, READ_LOCK };
+	uint32_t jobs_packed, tmp_offset;
+	job_snap_t *snap, *base;
+	bool *part_visible;
+	Buf buffer;
+
+	buffer = init_buf(BUF_SIZE);
+
+	/* write message body header : size and time */
+	/* put in a place holder job record count and time for now */
+	pack32((uint32_t) 0, buffer);
+	pack_time((time_t) 0, buffer);
+
+	lock_slurmctld(part_read_lock);
+	if ((snap = _job_snap_get(show_flags, protocol_version, NULL))) {
+		part_visible = _job_snap_part_visible(snap, show_flags, uid);
+		unlock_slurmctld(part_read_lock);
+	} else {
+		unlock_slurmctld(part_read_lock);
+		/* Let one request update the snapshot, the others reuse it */
+		slurm_mutex_lock(&job_snap_build_mutex);
+		lock_slurmctld(job_read_lock);
+		if (!(snap = _job_snap_get(show_flags, protocol_version,
+					   &base))) {
+			snap = _job_snap_build(show_flags, protocol_version,
+					       base);
+		}
+		if (base)
+			_job_snap_put(base);
+		slurm_mutex_unlock(&job_snap_build_mutex);
+		part_visible = _job_snap_part_visible(snap, show_flags, uid);
+		unlock_slurmctld(job_read_lock);
+	}
+
+	jobs_packed = _job_snap_pack(snap, buffer, show_flags, uid,
+				     filter_uid, part_visible);
+	xfree(part_visible);
+
+	/*
+	 * put the real record count and the time of the snapshot in the
+	 * message body header, so clients don't miss changes made after
+	 */
+	tmp_offset = get_buf_offset(buffer);
+	set_buf_offset(buffer, 0);
+	pack32(jobs_packed, buffer);
+	pack_time(snap->build_time, buffer);
+	set_buf_offset(buffer, tmp_offset);
+	_job_snap_put(snap);
+
+	*buffer_size = get_buf_offset(buffer);
+	buffer_ptr[0] = xfer_buf_data(buffer);
+}
+
 /*
  * pack_spec_jobs - dump job information for specified jobs in
  *	machine independent form (for network transmission)
@@ -9874,11 +10676,11 @@ extern int pack_one_job(char **buffer_ptr, int *buffer_size,
 			}
 		}
 
-		job_ptr = job_array_hash_j[JOB_HASH_INX(job_id)];
+		job_ptr = job_hash_array_first(job_id);
 		while (job_ptr) {
 			if ((job_ptr->job_id == job_id) && packed_head) {
 				;	/* Already packed */
-			} else if (job_ptr->array_job_id == job_id) {
+			} else {
 				if (_hide_job(job_ptr, uid, show_flags))
 					break;
 				pack_job(job_ptr, show_flags, buffer,
@@ -9932,6 +10734,14 @@ static void _pack_job_gres(job_record_t *dump_job_ptr, Buf buffer,
  */
 void pack_job(job_record_t *dump_job_ptr, uint16_t show_flags, Buf buffer,
 	      uint16_t protocol_version, uid_t uid)
+{
+	lock_job_rec(dump_job_ptr->job_id);
+	_pack_job_rec(dump_job_ptr, show_flags, buffer, protocol_version, uid);
+	unlock_job_rec(dump_job_ptr->job_id);
+}
+
+static void _pack_job_rec(job_record_t *dump_job_ptr, uint16_t show_flags,
+			  Buf buffer, uint16_t protocol_version, uid_t uid)
 {
 	struct job_details *detail_ptr;
 	time_t accrue_time = 0, begin_time = 0, start_time = 0, end_time = 0;
@@ -11197,7 +12007,7 @@ void reset_job_bitmaps(void)
 	}
 	list_iterator_destroy(job_iterator);
 
-	last_job_update = now;
+	job_state_changed(NULL, now);
 }
 
 static int _reset_detail_bitmaps(job_record_t *job_ptr)
@@ -11759,6 +12569,8 @@ static int _update_job(job_record_t *job_ptr, job_desc_msg_t *job_specs,
 	if (job_ptr->db_index == NO_VAL64)
 		return ESLURM_JOB_SETTING_DB_INX;
 
+	job_ptr->update_cnt++;
+	schedule_job_changed(job_ptr);
 	operator = validate_operator(uid);
 	if (job_specs->burst_buffer) {
 		/*
@@ -11770,7 +12582,7 @@ static int _update_job(job_record_t *job_ptr, job_desc_msg_t *job_specs,
 		if (IS_JOB_COMPLETED(job_ptr) && operator &&
 		    (job_specs->burst_buffer[0] == '\0')) {
 			xfree(job_ptr->burst_buffer);
-			last_job_update = now;
+			job_state_changed(job_ptr, now);
 		} else {
 			error_code = ESLURM_NOT_SUPPORTED;
 		}
@@ -11870,7 +12682,7 @@ static int _update_job(job_record_t *job_ptr, job_desc_msg_t *job_specs,
 	detail_ptr = job_ptr->details;
 	if (detail_ptr)
 		mc_ptr = detail_ptr->mc_ptr;
-	last_job_update = now;
+	job_state_changed(job_ptr, now);
 
 	/*
 	 * Check to see if the new requested job_specs exceeds any
@@ -13677,6 +14489,7 @@ static int _update_job(job_record_t *job_ptr, job_desc_msg_t *job_specs,
 				   job_specs->licenses, job_ptr);
 			xfree(job_ptr->licenses);
 			job_ptr->licenses = xstrdup(job_specs->licenses);
+			license_job_compact(job_ptr);
 		} else if (IS_JOB_RUNNING(job_ptr)) {
 			/*
 			 * Operators can modify license counts on running jobs,
@@ -13703,6 +14516,7 @@ static int _update_job(job_record_t *job_ptr, job_desc_msg_t *job_specs,
 				   job_specs->licenses, job_ptr);
 			xfree(job_ptr->licenses);
 			job_ptr->licenses = xstrdup(job_specs->licenses);
+			license_job_compact(job_ptr);
 			license_job_get(job_ptr);
 		} else {
 			/*
@@ -14189,15 +15003,14 @@ extern int update_job_str(slurm_msg_t *msg, uid_t uid)
 		}
 
 		/* Update all tasks of this job array */
-		job_ptr = job_array_hash_j[JOB_HASH_INX(job_id)];
+		job_ptr = job_hash_array_first(job_id);
 		if (!job_ptr && !job_ptr_done) {
 			info("%s: invalid JobId=%u", __func__, job_id);
 			rc = ESLURM_INVALID_JOB_ID;
 			goto reply;
 		}
 		while (job_ptr) {
-			if ((job_ptr->array_job_id == job_id) &&
-			    (job_ptr != job_ptr_done)) {
+			if (job_ptr != job_ptr_done) {
 				rc2 = _update_job(job_ptr, job_specs, uid);
 				if (rc2 == ESLURM_JOB_SETTING_DB_INX) {
 					rc = rc2;
@@ -15021,7 +15834,7 @@ extern int job_alloc_info_ptr(uint32_t uid, job_record_t *job_ptr)
 	if (job_ptr->alias_list && !xstrcmp(job_ptr->alias_list, "TBD") &&
 	    (prolog == 0) && job_ptr->node_bitmap &&
 	    (bit_overlap_any(power_node_bitmap, job_ptr->node_bitmap) == 0)) {
-		last_job_update = time(NULL);
+		job_state_changed(job_ptr, time(NULL));
 		set_job_alias_list(job_ptr);
 	}
 
@@ -15173,12 +15986,9 @@ static void _validate_job_files(List batch_dirs)
 		}
 		if (job_ptr && job_ptr->array_recs) { /* Update all tasks */
 			array_job_id = job_ptr->array_job_id;
-			job_ptr = job_array_hash_j[JOB_HASH_INX(array_job_id)];
-			while (job_ptr) {
-				if (job_ptr->array_job_id == array_job_id)
-					job_ptr->bit_flags |= HAS_STATE_DIR;
-				job_ptr = job_ptr->job_array_next_j;
-			}
+			for (job_ptr = job_hash_array_first(array_job_id);
+			     job_ptr; job_ptr = job_ptr->job_array_next_j)
+				job_ptr->bit_flags |= HAS_STATE_DIR;
 		}
 	}
 	list_iterator_destroy(batch_dir_iter);
@@ -15521,10 +16331,13 @@ void batch_requeue_fini(job_record_t *job_ptr)
 /* job_fini - free all memory associated with job records */
 void job_fini (void)
 {
+	slurm_mutex_lock(&job_snap_mutex);
+	FREE_NULL_LIST(job_snap_list);
+	slurm_mutex_unlock(&job_snap_mutex);
+	sched_queue_clear();
 	FREE_NULL_LIST(job_list);
-	xfree(job_hash);
-	xfree(job_array_hash_j);
-	xfree(job_array_hash_t);
+	FREE_NULL_LIST(job_journal_purged);
+	job_hash_fini();
 	FREE_NULL_LIST(purge_files_list);
 	FREE_NULL_BITMAP(requeue_exit);
 	FREE_NULL_BITMAP(requeue_exit_hold);
@@ -15539,6 +16352,7 @@ extern void job_array_start(job_record_t *job_ptr)
 		base_job_ptr = find_job_record(job_ptr->array_job_id);
 		if (base_job_ptr && base_job_ptr->array_recs) {
 			base_job_ptr->array_recs->tot_run_tasks++;
+			job_state_changed(base_job_ptr, time(NULL));
 		}
 	}
 }
@@ -15582,6 +16396,7 @@ static void _job_array_comp(job_record_t *job_ptr, bool was_running,
 		}
 		base_job_ptr = find_job_record(job_ptr->array_job_id);
 		if (base_job_ptr && base_job_ptr->array_recs) {
+			xassert(verify_job_rec_lock(base_job_ptr->job_id));
 			if (requeue) {
 				base_job_ptr->array_recs->array_flags |=
 					ARRAY_TASK_REQUEUED;
@@ -15602,6 +16417,7 @@ static void _job_array_comp(job_record_t *job_ptr, bool was_running,
 			    base_job_ptr->array_recs->tot_run_tasks)
 				base_job_ptr->array_recs->tot_run_tasks--;
 			base_job_ptr->array_recs->tot_comp_tasks++;
+			job_state_changed(base_job_ptr, time(NULL));
 		}
 	}
 }
@@ -15616,7 +16432,10 @@ extern void job_completion_logger(job_record_t *job_ptr, bool requeue)
 	uint32_t max_exit_code = 0;
 
 	xassert(job_ptr);
+	xassert(verify_job_rec_lock(job_ptr->job_id));
 
+	schedule_job_changed(job_ptr);
+	job_state_changed(job_ptr, time(NULL));
 	acct_policy_remove_job_submit(job_ptr);
 	if (job_ptr->nodes && ((job_ptr->bit_flags & JOB_KILL_HURRY) == 0)
 	    && !IS_JOB_RESIZING(job_ptr)) {
@@ -15845,7 +16664,7 @@ extern int job_node_ready(uint32_t job_id, int *ready)
 	    job_ptr->alias_list && !xstrcmp(job_ptr->alias_list, "TBD") &&
 	    job_ptr->node_bitmap &&
 	    (bit_overlap_any(power_node_bitmap, job_ptr->node_bitmap) == 0)) {
-		last_job_update = time(NULL);
+		job_state_changed(job_ptr, time(NULL));
 		set_job_alias_list(job_ptr);
 	}
 
@@ -16097,7 +16916,8 @@ static int _suspend_job_nodes(job_record_t *job_ptr, bool indf_susp)
 			node_ptr->last_idle  = now;
 		}
 	}
-	last_job_update = last_node_update = now;
+	last_node_update = now;
+	job_state_changed(job_ptr, now);
 	return rc;
 }
 
@@ -16151,7 +16971,8 @@ static int _resume_job_nodes(job_record_t *job_ptr, bool indf_susp)
 		node_flags = node_ptr->node_state & NODE_STATE_FLAGS;
 		node_ptr->node_state = NODE_STATE_ALLOCATED | node_flags;
 	}
-	last_job_update = last_node_update = time(NULL);
+	last_node_update = time(NULL);
+	job_state_changed(job_ptr, last_node_update);
 	return rc;
 }
 
@@ -16475,14 +17296,13 @@ extern int job_suspend2(suspend_msg_t *sus_ptr, uid_t uid,
 		}
 
 		/* Suspend all tasks of this job array */
-		job_ptr = job_array_hash_j[JOB_HASH_INX(job_id)];
+		job_ptr = job_hash_array_first(job_id);
 		if (!job_ptr && !job_ptr_done) {
 			rc = ESLURM_INVALID_JOB_ID;
 			goto reply;
 		}
 		while (job_ptr) {
-			if ((job_ptr->array_job_id == job_id) &&
-			    (job_ptr != job_ptr_done)) {
+			if (job_ptr != job_ptr_done) {
 				rc2 = _job_suspend(job_ptr, sus_ptr->op,
 						   indf_susp);
 				_resp_array_add(&resp_array, job_ptr, rc2);
@@ -16635,7 +17455,7 @@ static int _job_requeue_op(uid_t uid, job_record_t *job_ptr, bool preempt,
 			return SLURM_SUCCESS;
 	}
 
-	last_job_update = now;
+	job_state_changed(job_ptr, now);
 
 	/*
 	 * In the job is in the process of completing
@@ -16940,14 +17760,13 @@ extern int job_requeue2(uid_t uid, requeue_msg_t *req_ptr, slurm_msg_t *msg,
 		}
 
 		/* Requeue all tasks of this job array */
-		job_ptr = job_array_hash_j[JOB_HASH_INX(job_id)];
+		job_ptr = job_hash_array_first(job_id);
 		if (!job_ptr && !job_ptr_done) {
 			rc = ESLURM_INVALID_JOB_ID;
 			goto reply;
 		}
 		while (job_ptr) {
-			if ((job_ptr->array_job_id == job_id) &&
-			    (job_ptr != job_ptr_done)) {
+			if (job_ptr != job_ptr_done) {
 				rc2 = _job_requeue(uid, job_ptr, preempt,flags);
 				_resp_array_add(&resp_array, job_ptr, rc2);
 			}
@@ -17052,6 +17871,7 @@ static int _set_top(List top_job_list, uid_t uid)
 	int64_t delta_prio, delta_nice, total_delta = 0;
 	int other_job_cnt = 0;
 	uint32_t *prio_elem;
+	time_t now = time(NULL);
 
 	xassert(job_list);
 	xassert(top_job_list);
@@ -17156,6 +17976,7 @@ static int _set_top(List top_job_list, uid_t uid)
 		job_ptr->priority = next_prio;
 		job_ptr->details->nice -= delta_nice;
 		job_ptr->bit_flags &= (~TOP_PRIO_TMP);
+		job_state_changed(job_ptr, now);
 	}
 	list_iterator_destroy(iter);
 	FREE_NULL_LIST(prio_list);
@@ -17174,6 +17995,7 @@ static int _set_top(List top_job_list, uid_t uid)
 			job_ptr->priority = next_prio;
 			job_ptr->details->nice += delta_nice;
 			job_ptr->bit_flags &= (~TOP_PRIO_TMP);
+			job_state_changed(job_ptr, now);
 			total_delta -= delta_nice;
 			if (--other_job_cnt == 0)
 				break;	/* Count will match list size anyway */
@@ -17182,8 +18004,6 @@ static int _set_top(List top_job_list, uid_t uid)
 	}
 	FREE_NULL_LIST(other_job_list);
 
-	last_job_update = time(NULL);
-
 	return rc;
 }
 
@@ -17460,7 +18280,7 @@ extern int update_job_wckey(char *module, job_record_t *job_ptr,
 		info("%s: cleared wckey for %pJ", module, job_ptr);
 	}
 
-	last_job_update = time(NULL);
+	job_state_changed(job_ptr, time(NULL));
 
 	return SLURM_SUCCESS;
 }
@@ -18037,7 +18857,7 @@ static void _kill_dependent(job_record_t *job_ptr)
 	job_ptr->start_time = now;
 	job_ptr->end_time = now;
 	job_completion_logger(job_ptr, false);
-	last_job_update = now;
+	job_state_changed(job_ptr, now);
 	srun_allocate_abort(job_ptr);
 }
 
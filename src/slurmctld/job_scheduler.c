@@ -90,6 +90,7 @@
 #include "src/slurmctld/preempt.h"
 #include "src/slurmctld/proc_req.h"
 #include "src/slurmctld/reservation.h"
+#include "src/slurmctld/sched_queue.h"
 #include "src/slurmctld/slurmctld.h"
 #include "src/slurmctld/srun_comm.h"
 #include "src/slurmctld/state_save.h"
@@ -100,6 +101,7 @@
 #endif
 #define BUILD_TIMEOUT 2000000	/* Max build_job_queue() run time in usec */
 #define MAX_FAILED_RESV 10
+#define SCHED_CHANGED_MAX 10000	/* Max changed jobs between incremental runs */
 
 typedef struct wait_boot_arg {
 	uint32_t job_id;
@@ -110,6 +112,8 @@ static batch_job_launch_msg_t *_build_launch_job_msg(job_record_t *job_ptr,
 						     uint16_t protocol_version);
 static void	_job_queue_append(List job_queue, job_record_t *job_ptr,
 				  part_record_t *part_ptr, uint32_t priority);
+static void	_job_ids_add(uint32_t **job_ids, int *job_cnt, int *job_size,
+			     uint32_t job_id);
 static bool	_job_runnable_test1(job_record_t *job_ptr, bool clear_start);
 static bool	_job_runnable_test2(job_record_t *job_ptr, bool check_min_time);
 static bool	_scan_depend(List dependency_list, uint32_t job_id);
@@ -136,6 +140,27 @@ static int sched_min_interval = 2;
 static int bb_array_stage_cnt = 10;
 extern diag_stats_t slurmctld_diag_stats;
 
+/* State of the job queue kept between runs with sched_incremental */
+static bool sched_incr = false;
+static bool sched_queue_valid = false;
+static time_t queue_conf_update = 0;
+static time_t queue_part_update = 0;
+static time_t queue_resv_update = 0;
+static uint32_t *changed_jobs = NULL;	/* Jobs changed since last run */
+static int changed_job_cnt = 0, changed_job_size = 0;
+static uint32_t *parked_jobs = NULL;	/* Pending jobs without records */
+static int parked_job_cnt = 0, parked_job_size = 0;
+static time_t parked_begin_min = 0;	/* Earliest begin time of parked jobs
+					 * still to come, 0 if none */
+static bitstr_t **node_state_bitmaps[] = {
+	&avail_node_bitmap, &booting_node_bitmap, &cg_node_bitmap,
+	&future_node_bitmap, &idle_node_bitmap, &power_node_bitmap,
+	&rs_node_bitmap, &share_node_bitmap, &up_node_bitmap
+};
+#define NODE_STATE_CNT \
+	(sizeof(node_state_bitmaps) / sizeof(node_state_bitmaps[0]))
+static bitstr_t *node_state_last[NODE_STATE_CNT];
+
 static int _find_singleton_job (void *x, void *key)
 {
 	struct job_record *qjob_ptr = (struct job_record *) x;
@@ -291,7 +316,7 @@ static bool _job_runnable_test1(job_record_t *job_ptr, bool sched_plugin)
 	if (job_ptr->state_reason == WAIT_FRONT_END) {
 		job_ptr->state_reason = WAIT_NO_REASON;
 		xfree(job_ptr->state_desc);
-		last_job_update = now;
+		job_state_changed(job_ptr, now);
 	}
 #endif
 
@@ -307,7 +332,7 @@ static bool _job_runnable_test1(job_record_t *job_ptr, bool sched_plugin)
 		    && job_ptr->state_reason != WAIT_MAX_REQUEUE) {
 			job_ptr->state_reason = WAIT_HELD;
 			xfree(job_ptr->state_desc);
-			last_job_update = now;
+			job_state_changed(job_ptr, now);
 		}
 		sched_debug3("%pJ. State=%s. Reason=%s. Priority=%u.",
 			     job_ptr,
@@ -388,6 +413,88 @@ extern void job_queue_rec_prom_resv(job_queue_rec_t *job_queue_rec)
 	job_queue_rec->job_ptr->bit_flags |= JOB_PROM;
 }
 
+/*
+ * Append the records of a pending job to a job queue, for each partition the
+ * job can run in now
+ * RET count of records appended
+ */
+static int _job_queue_add(List job_queue, job_record_t *job_ptr,
+			  bool clear_start, bool backfill, time_t now)
+{
+	ListIterator part_iterator;
+	part_record_t *part_ptr;
+	int pairs = 0, reason;
+
+	job_ptr->preempt_in_progress = false;	/* initialize */
+	if (job_ptr->array_recs)
+		job_ptr->array_recs->pend_run_tasks = 0;
+	if (job_ptr->state_reason != WAIT_NO_REASON) {
+		job_ptr->state_reason_prev = job_ptr->state_reason;
+		if ((job_ptr->state_reason != WAIT_PRIORITY) &&
+		    (job_ptr->state_reason != WAIT_RESOURCES))
+			job_ptr->state_reason_prev_db = job_ptr->state_reason;
+		job_state_changed(job_ptr, now);
+	} else if ((job_ptr->state_reason_prev == WAIT_TIME) &&
+		   job_ptr->details &&
+		   (job_ptr->details->begin_time <= now)) {
+		job_ptr->state_reason_prev = job_ptr->state_reason;
+		if ((job_ptr->state_reason != WAIT_PRIORITY) &&
+		    (job_ptr->state_reason != WAIT_RESOURCES))
+			job_ptr->state_reason_prev_db = job_ptr->state_reason;
+		job_state_changed(job_ptr, now);
+	}
+	if (!_job_runnable_test1(job_ptr, clear_start))
+		return 0;
+
+	if (job_ptr->part_ptr_list) {
+		int inx = -1;
+		part_iterator = list_iterator_create(job_ptr->part_ptr_list);
+		while ((part_ptr = list_next(part_iterator))) {
+			job_ptr->part_ptr = part_ptr;
+			reason = job_limits_check(&job_ptr, backfill);
+			if ((reason != WAIT_NO_REASON) &&
+			    (reason != job_ptr->state_reason)) {
+				job_ptr->state_reason = reason;
+				xfree(job_ptr->state_desc);
+				job_state_changed(job_ptr, now);
+			}
+			/* priority_array index matches part_ptr_list
+			 * position: increment inx */
+			inx++;
+			if (reason != WAIT_NO_REASON)
+				continue;
+			pairs++;
+			if (job_ptr->priority_array) {
+				_job_queue_append(job_queue, job_ptr, part_ptr,
+						  job_ptr->priority_array[inx]);
+			} else {
+				_job_queue_append(job_queue, job_ptr, part_ptr,
+						  job_ptr->priority);
+			}
+		}
+		list_iterator_destroy(part_iterator);
+	} else {
+		if (job_ptr->part_ptr == NULL) {
+			part_ptr = find_part_record(job_ptr->partition);
+			if (part_ptr == NULL) {
+				error("Could not find partition %s for %pJ",
+				      job_ptr->partition, job_ptr);
+				return 0;
+			}
+			job_ptr->part_ptr = part_ptr;
+			error("partition pointer reset for %pJ, part %s",
+			      job_ptr, job_ptr->partition);
+		}
+		if (!_job_runnable_test2(job_ptr, backfill))
+			return 0;
+		pairs++;
+		_job_queue_append(job_queue, job_ptr, job_ptr->part_ptr,
+				  job_ptr->priority);
+	}
+
+	return pairs;
+}
+
 /*
  * build_job_queue - build (non-priority ordered) list of pending jobs
  * IN clear_start - if set then clear the start_time for pending jobs,
@@ -400,11 +507,10 @@ extern List build_job_queue(bool clear_start, bool backfill)
 {
 	static time_t last_log_time = 0;
 	List job_queue;
-	ListIterator depend_iter, job_iterator, part_iterator;
+	ListIterator depend_iter, job_iterator;
 	job_record_t *job_ptr = NULL, *new_job_ptr;
-	part_record_t *part_ptr;
 	depend_spec_t *dep_ptr;
-	int i, pend_cnt, reason, dep_corr;
+	int i, pend_cnt, dep_corr;
 	struct timeval start_tv = {0, 0};
 	int tested_jobs = 0;
 	int job_part_pairs = 0;
@@ -446,6 +552,7 @@ extern List build_job_queue(bool clear_start, bool backfill)
 		if (new_job_ptr) {
 			debug("%s: Split out %pJ for burst buffer use",
 			      __func__, job_ptr);
+			schedule_job_changed(job_ptr);
 			new_job_ptr->job_state = JOB_PENDING;
 			new_job_ptr->start_time = (time_t) 0;
 			/* Do NOT clear db_index here, it is handled when
@@ -505,6 +612,7 @@ extern List build_job_queue(bool clear_start, bool backfill)
 		if (new_job_ptr) {
 			info("%s: Split out %pJ for SLURM_DEPEND_AFTER_CORRESPOND use",
 			     __func__, job_ptr);
+			schedule_job_changed(job_ptr);
 			new_job_ptr->job_state = JOB_PENDING;
 			new_job_ptr->start_time = (time_t) 0;
 			/* Do NOT clear db_index here, it is handled when
@@ -537,78 +645,8 @@ extern List build_job_queue(bool clear_start, bool backfill)
 			break;
 		}
 		tested_jobs++;
-		job_ptr->preempt_in_progress = false;	/* initialize */
-		if (job_ptr->array_recs)
-			job_ptr->array_recs->pend_run_tasks = 0;
-		if (job_ptr->state_reason != WAIT_NO_REASON) {
-			job_ptr->state_reason_prev = job_ptr->state_reason;
-			if ((job_ptr->state_reason != WAIT_PRIORITY) &&
-			    (job_ptr->state_reason != WAIT_RESOURCES))
-				job_ptr->state_reason_prev_db =
-					job_ptr->state_reason;
-			last_job_update = now;
-		} else if ((job_ptr->state_reason_prev == WAIT_TIME) &&
-			   job_ptr->details &&
-			   (job_ptr->details->begin_time <= now)) {
-			job_ptr->state_reason_prev = job_ptr->state_reason;
-			if ((job_ptr->state_reason != WAIT_PRIORITY) &&
-			    (job_ptr->state_reason != WAIT_RESOURCES))
-				job_ptr->state_reason_prev_db =
-					job_ptr->state_reason;
-			last_job_update = now;
-		}
-		if (!_job_runnable_test1(job_ptr, clear_start))
-			continue;
-
-		if (job_ptr->part_ptr_list) {
-			int inx = -1;
-			part_iterator = list_iterator_create(
-				job_ptr->part_ptr_list);
-			while ((part_ptr = list_next(part_iterator))) {
-				job_ptr->part_ptr = part_ptr;
-				reason = job_limits_check(&job_ptr, backfill);
-				if ((reason != WAIT_NO_REASON) &&
-				    (reason != job_ptr->state_reason)) {
-					job_ptr->state_reason = reason;
-					xfree(job_ptr->state_desc);
-					last_job_update = now;
-				}
-				/* priority_array index matches part_ptr_list
-				 * position: increment inx */
-				inx++;
-				if (reason != WAIT_NO_REASON)
-					continue;
-				job_part_pairs++;
-				if (job_ptr->priority_array) {
-					_job_queue_append(job_queue, job_ptr,
-							  part_ptr,
-							  job_ptr->
-							  priority_array[inx]);
-				} else {
-					_job_queue_append(job_queue, job_ptr,
-							  part_ptr,
-							  job_ptr->priority);
-				}
-			}
-			list_iterator_destroy(part_iterator);
-		} else {
-			if (job_ptr->part_ptr == NULL) {
-				part_ptr = find_part_record(job_ptr->partition);
-				if (part_ptr == NULL) {
-					error("Could not find partition %s for %pJ",
-					      job_ptr->partition, job_ptr);
-					continue;
-				}
-				job_ptr->part_ptr = part_ptr;
-				error("partition pointer reset for %pJ, part %s",
-				      job_ptr, job_ptr->partition);
-			}
-			if (!_job_runnable_test2(job_ptr, backfill))
-				continue;
-			job_part_pairs++;
-			_job_queue_append(job_queue, job_ptr,
-					  job_ptr->part_ptr, job_ptr->priority);
-		}
+		job_part_pairs += _job_queue_add(job_queue, job_ptr,
+						 clear_start, backfill, now);
 	}
 	list_iterator_destroy(job_iterator);
 
@@ -760,10 +798,11 @@ static bool _all_partition_priorities_same(void)
  * Note: If the scheduler has executed recently, rather than executing again
  *	right away, a thread will be spawned to execute later in an effort
  *	to reduce system overhead.
- * Note: We re-build the queue every time. Jobs can not only be added
- *	or removed from the queue, but have their priority or partition
- *	changed with the update_job RPC. In general nodes will be in priority
- *	order (by submit time), so the sorting should be pretty fast.
+ * Note: We re-build the queue every time, unless SchedulerParameters has
+ *	sched_incremental. Jobs can not only be added or removed from the
+ *	queue, but have their priority or partition changed with the
+ *	update_job RPC. In general nodes will be in priority order (by submit
+ *	time), so the sorting should be pretty fast.
  * Note: job_write_lock must be unlocked before calling this.
  */
 extern int schedule(uint32_t job_limit)
@@ -831,6 +870,27 @@ extern int schedule(uint32_t job_limit)
 }
 
 /* Thread used to possibly start job scheduler later, if nothing else does */
+/*
+ * schedule_job_changed - note that a job was submitted, completed or changed,
+ *	so that the next run of schedule() with sched_incremental tests it again
+ * IN job_ptr - job that changed
+ * NOTE: Caller must hold the job write lock
+ */
+extern void schedule_job_changed(job_record_t *job_ptr)
+{
+	sched_queue_remove_job(job_ptr);
+
+	if (!sched_incr || !sched_queue_valid)
+		return;
+	if (changed_job_cnt >= SCHED_CHANGED_MAX) {
+		/* Cheaper to build the queue again */
+		sched_queue_valid = false;
+		return;
+	}
+	_job_ids_add(&changed_jobs, &changed_job_cnt, &changed_job_size,
+		     job_ptr->job_id);
+}
+
 static void *_sched_agent(void *args)
 {
 	long delta_t;
@@ -905,7 +965,7 @@ extern bool deadline_ok(job_record_t *job_ptr, char *func)
 		}
 	}
 	if (fail_job) {
-		last_job_update = now;
+		job_state_changed(job_ptr, now);
 		job_ptr->job_state = JOB_DEADLINE;
 		job_ptr->exit_code = 1;
 		job_ptr->state_reason = FAIL_DEADLINE;
@@ -975,6 +1035,398 @@ extern void job_queue_append_internal(job_queue_req_t *job_queue_req)
 	list_append(job_queue_req->job_queue, job_queue_rec);
 }
 
+static void _job_ids_add(uint32_t **job_ids, int *job_cnt, int *job_size,
+			 uint32_t job_id)
+{
+	if (*job_cnt >= *job_size) {
+		*job_size = MAX(*job_size * 2, 64);
+		xrealloc(*job_ids, *job_size * sizeof(uint32_t));
+	}
+	(*job_ids)[(*job_cnt)++] = job_id;
+}
+
+static int _cmp_job_id(const void *x, const void *y)
+{
+	uint32_t job_id1 = *(uint32_t *) x, job_id2 = *(uint32_t *) y;
+
+	if (job_id1 < job_id2)
+		return -1;
+	if (job_id1 > job_id2)
+		return 1;
+	return 0;
+}
+
+/* Free the job queue kept between runs */
+static void _sched_queue_fini(void)
+{
+	int i;
+
+	sched_queue_clear();
+	sched_queue_valid = false;
+	xfree(changed_jobs);
+	changed_job_cnt = changed_job_size = 0;
+	xfree(parked_jobs);
+	parked_job_cnt = parked_job_size = 0;
+	parked_begin_min = 0;
+	for (i = 0; i < NODE_STATE_CNT; i++)
+		FREE_NULL_BITMAP(node_state_last[i]);
+}
+
+/* Save the state of all nodes as of the end of this run */
+static void _node_state_save(void)
+{
+	bitstr_t *bitmap;
+	int i;
+
+	for (i = 0; i < NODE_STATE_CNT; i++) {
+		bitmap = *node_state_bitmaps[i];
+		if (node_state_last[i] && bitmap &&
+		    (bit_size(node_state_last[i]) == bit_size(bitmap))) {
+			bit_copybits(node_state_last[i], bitmap);
+		} else {
+			FREE_NULL_BITMAP(node_state_last[i]);
+			if (bitmap)
+				node_state_last[i] = bit_copy(bitmap);
+		}
+	}
+}
+
+/*
+ * Mark the partitions of nodes which changed state since the last run dirty
+ * RET false if the node table changed, so the queue must be built again
+ */
+static bool _node_state_dirty(void)
+{
+	bitstr_t *bitmap, *changed, *tmp_bitmap;
+	int i;
+
+	for (i = 0; i < NODE_STATE_CNT; i++) {
+		bitmap = *node_state_bitmaps[i];
+		if (!bitmap || !node_state_last[i] ||
+		    (bit_size(bitmap) != bit_size(node_state_last[i])))
+			return false;
+		if (bit_equal(bitmap, node_state_last[i]))
+			continue;
+		changed = bit_copy(bitmap);
+		bit_and_not(changed, node_state_last[i]);
+		tmp_bitmap = bit_copy(node_state_last[i]);
+		bit_and_not(tmp_bitmap, bitmap);
+		bit_or(changed, tmp_bitmap);
+		sched_queue_dirty_nodes(changed);
+		FREE_NULL_BITMAP(tmp_bitmap);
+		FREE_NULL_BITMAP(changed);
+	}
+	return true;
+}
+
+static void _dirty_job_parts(job_record_t *job_ptr)
+{
+	ListIterator part_iterator;
+	part_record_t *part_ptr;
+
+	if (job_ptr->part_ptr_list) {
+		part_iterator = list_iterator_create(job_ptr->part_ptr_list);
+		while ((part_ptr = list_next(part_iterator)))
+			sched_queue_set_dirty(part_ptr, true);
+		list_iterator_destroy(part_iterator);
+	} else if (job_ptr->part_ptr) {
+		sched_queue_set_dirty(job_ptr->part_ptr, true);
+	}
+}
+
+static void _dirty_all_parts(void)
+{
+	ListIterator part_iterator;
+	part_record_t *part_ptr;
+
+	part_iterator = list_iterator_create(part_list);
+	while ((part_ptr = list_next(part_iterator)))
+		sched_queue_set_dirty(part_ptr, true);
+	list_iterator_destroy(part_iterator);
+}
+
+/* Keep a pending job which can not run now to be tested again later */
+static void _sched_queue_park(job_record_t *job_ptr, time_t now)
+{
+	time_t begin_time;
+
+	_job_ids_add(&parked_jobs, &parked_job_cnt, &parked_job_size,
+		     job_ptr->job_id);
+	if (!job_ptr->details)
+		return;
+	begin_time = job_ptr->details->begin_time;
+	if ((begin_time > now) &&
+	    (!parked_begin_min || (begin_time < parked_begin_min)))
+		parked_begin_min = begin_time;
+}
+
+/*
+ * Queue the records of a pending job, marking their partitions dirty. A
+ * pending job which can not run now in any partition is kept to be tested
+ * again on the next run.
+ */
+static void _sched_queue_job(List job_queue, job_record_t *job_ptr,
+			     time_t now)
+{
+	job_queue_rec_t *job_queue_rec;
+
+	sched_queue_remove_job(job_ptr);
+	if (!IS_JOB_PENDING(job_ptr))
+		return;
+
+	set_job_failed_assoc_qos_ptr(job_ptr);
+	acct_policy_handle_accrue_time(job_ptr, false);
+	if (!_job_queue_add(job_queue, job_ptr, false, false, now)) {
+		if (job_ptr->priority)
+			_sched_queue_park(job_ptr, now);
+		return;
+	}
+	while ((job_queue_rec = list_pop(job_queue))) {
+		sched_queue_set_dirty(job_queue_rec->part_ptr, true);
+		sched_queue_push(job_queue_rec);
+	}
+}
+
+/* Build the job queue kept between runs from all pending jobs */
+static void _sched_queue_build(time_t now)
+{
+	ListIterator job_iterator;
+	List job_queue;
+	job_queue_rec_t *job_queue_rec;
+	job_record_t *job_ptr;
+
+	job_queue = build_job_queue(false, false);
+	sched_queue_init(part_list);
+	while ((job_queue_rec = list_pop(job_queue)))
+		sched_queue_push(job_queue_rec);
+	FREE_NULL_LIST(job_queue);
+
+	changed_job_cnt = 0;
+	parked_job_cnt = 0;
+	parked_begin_min = 0;
+	job_iterator = list_iterator_create(job_list);
+	while ((job_ptr = list_next(job_iterator))) {
+		if (IS_JOB_PENDING(job_ptr) && job_ptr->priority &&
+		    !job_ptr->queue_rec)
+			_sched_queue_park(job_ptr, now);
+	}
+	list_iterator_destroy(job_iterator);
+
+	sched_queue_valid = true;
+	queue_conf_update = slurmctld_conf.last_update;
+	queue_part_update = last_part_update;
+	queue_resv_update = last_resv_update;
+}
+
+/*
+ * Test if the changes since the last run may let parked jobs run: a job ended,
+ * started or was purged (dependencies, association and QOS limits), or the
+ * begin time of a parked job passed. Changes of parked jobs themselves queue
+ * them again anyway.
+ */
+static bool _sched_queue_park_retest(uint32_t *job_ids, int job_cnt,
+				     time_t now)
+{
+	job_record_t *job_ptr;
+	int i;
+
+	if (parked_begin_min && (parked_begin_min <= now))
+		return true;
+	for (i = 0; i < job_cnt; i++) {
+		if (!(job_ptr = find_job_record(job_ids[i])) ||
+		    !IS_JOB_PENDING(job_ptr))
+			return true;
+	}
+	return false;
+}
+
+/* Drop the parked jobs which are queued again as changed jobs */
+static void _sched_queue_park_remove(uint32_t *job_ids, int job_cnt)
+{
+	int i, j;
+
+	for (i = 0, j = 0; i < parked_job_cnt; i++) {
+		if (bsearch(&parked_jobs[i], job_ids, job_cnt,
+			    sizeof(uint32_t), _cmp_job_id))
+			continue;
+		parked_jobs[j++] = parked_jobs[i];
+	}
+	parked_job_cnt = j;
+}
+
+/*
+ * Queue again the jobs changed since the last run, and the pending jobs which
+ * could not run then if those changes may let them run. Mark the partitions
+ * they and the nodes which changed state since the last run belong to dirty
+ * RET false if the queue must be built again
+ */
+static bool _sched_queue_jobs(time_t now)
+{
+	List job_queue;
+	job_record_t *job_ptr;
+	uint32_t *job_ids = changed_jobs, *parked_ids = NULL;
+	int job_cnt = changed_job_cnt, parked_cnt = 0, i;
+
+	if (!_node_state_dirty())
+		return false;
+
+	/* Jobs changed or parked during this run are kept for the next one */
+	changed_jobs = NULL;
+	changed_job_cnt = changed_job_size = 0;
+	qsort(job_ids, job_cnt, sizeof(uint32_t), _cmp_job_id);
+	if (_sched_queue_park_retest(job_ids, job_cnt, now)) {
+		parked_ids = parked_jobs;
+		parked_cnt = parked_job_cnt;
+		parked_jobs = NULL;
+		parked_job_cnt = parked_job_size = 0;
+		parked_begin_min = 0;
+	} else {
+		_sched_queue_park_remove(job_ids, job_cnt);
+	}
+
+	job_queue = list_create(xfree_ptr);
+	for (i = 0; i < job_cnt; i++) {
+		if (i && (job_ids[i] == job_ids[i - 1]))
+			continue;
+		if (!(job_ptr = find_job_record(job_ids[i])))
+			continue;
+		/* Licenses are not bound to the job's partitions */
+		if (job_ptr->license_list)
+			_dirty_all_parts();
+		else
+			_dirty_job_parts(job_ptr);
+		if (job_ptr->node_bitmap)
+			sched_queue_dirty_nodes(job_ptr->node_bitmap);
+		_sched_queue_job(job_queue, job_ptr, now);
+	}
+	for (i = 0; i < parked_cnt; i++) {
+		if (bsearch(&parked_ids[i], job_ids, job_cnt, sizeof(uint32_t),
+			    _cmp_job_id))
+			continue;
+		if ((job_ptr = find_job_record(parked_ids[i])))
+			_sched_queue_job(job_queue, job_ptr, now);
+	}
+	FREE_NULL_LIST(job_queue);
+	xfree(job_ids);
+	xfree(parked_ids);
+
+	return true;
+}
+
+/*
+ * Update the job queue kept between runs for this run. A full run, or a run
+ * after changes of the configuration, partitions or reservations, builds the
+ * queue again from all pending jobs. Otherwise only the jobs changed since the
+ * last run are queued again, and only partitions in which more jobs may start
+ * are tested.
+ * RET count of partitions to test
+ */
+static int _sched_queue_update(bool full_sched, time_t now)
+{
+	bool build = full_sched || !sched_queue_valid;
+
+	if ((queue_conf_update != slurmctld_conf.last_update) ||
+	    (queue_part_update != last_part_update) ||
+	    (queue_resv_update != last_resv_update))
+		build = true;
+
+	if (build || !_sched_queue_jobs(now))
+		_sched_queue_build(now);
+
+	return sched_queue_dirty_overlap();
+}
+
+/*
+ * Remove the next record to test from the job queue kept between runs
+ * RET the record, which the caller must free, or NULL if none is left
+ */
+static job_queue_rec_t *_sched_queue_next(time_t now)
+{
+	ListIterator part_iterator;
+	job_queue_rec_t *job_queue_rec;
+	job_record_t *job_ptr;
+	part_record_t *part_ptr;
+	uint32_t priority;
+	int inx;
+
+	while ((job_queue_rec = sched_queue_pop())) {
+		job_ptr = job_queue_rec->job_ptr;
+		if (!IS_JOB_PENDING(job_ptr)) {
+			/* started in other partition */
+			xfree(job_queue_rec);
+			sched_queue_remove_job(job_ptr);
+			continue;
+		}
+
+		priority = job_ptr->priority;
+		if (job_ptr->priority_array && job_ptr->part_ptr_list) {
+			/* priority_array index matches part_ptr_list
+			 * position */
+			inx = 0;
+			part_iterator = list_iterator_create(
+				job_ptr->part_ptr_list);
+			while ((part_ptr = list_next(part_iterator))) {
+				if (part_ptr == job_queue_rec->part_ptr) {
+					priority = job_ptr->priority_array[inx];
+					break;
+				}
+				inx++;
+			}
+			list_iterator_destroy(part_iterator);
+		}
+		if (priority != job_queue_rec->priority) {
+			/* Heap order is stale, build it again next run */
+			job_queue_rec->priority = priority;
+			sched_queue_valid = false;
+		}
+
+		if (!_job_runnable_test1(job_ptr, false)) {
+			xfree(job_queue_rec);
+			sched_queue_remove_job(job_ptr);
+			if (job_ptr->priority)
+				_sched_queue_park(job_ptr, now);
+			continue;
+		}
+		return job_queue_rec;
+	}
+
+	return NULL;
+}
+
+/*
+ * Put the records tested in this run back into the job queue kept between
+ * runs, unless their job started or changed during this run
+ */
+static void _sched_queue_requeue(List job_queue)
+{
+	job_queue_rec_t *job_queue_rec;
+	job_record_t *job_ptr;
+
+	qsort(changed_jobs, changed_job_cnt, sizeof(uint32_t), _cmp_job_id);
+	while ((job_queue_rec = list_pop(job_queue))) {
+		job_ptr = job_queue_rec->job_ptr;
+		if ((job_ptr->array_task_id != job_queue_rec->array_task_id) &&
+		    (job_queue_rec->array_task_id == NO_VAL)) {
+			/* Job array element started, move the record to the
+			 * "master" job array record */
+			job_ptr = find_job_record(job_ptr->array_job_id);
+			job_queue_rec->job_ptr = job_ptr;
+		}
+		if (!job_ptr || !IS_JOB_PENDING(job_ptr) ||
+		    bsearch(&job_ptr->job_id, changed_jobs, changed_job_cnt,
+			    sizeof(uint32_t), _cmp_job_id)) {
+			xfree(job_queue_rec);
+			continue;
+		}
+		job_ptr->preempt_in_progress = false;
+		if (job_ptr->array_recs)
+			job_ptr->array_recs->pend_run_tasks = 0;
+		sched_queue_push(job_queue_rec);
+	}
+
+	_node_state_save();
+}
+
 static int _schedule(uint32_t job_limit)
 {
 	ListIterator job_iterator = NULL, part_iterator = NULL;
@@ -1007,7 +1459,9 @@ static int _schedule(uint32_t job_limit)
 	time_t now, last_job_sched_start, sched_start;
 	job_record_t *reject_array_job = NULL;
 	part_record_t *reject_array_part = NULL;
-	bool fail_by_part, wait_on_resv;
+	bool fail_by_part, part_busy = false, wait_on_resv;
+	bool full_sched = (job_limit == INFINITE);
+	int dirty_part_cnt;
 	uint32_t deadline_time_limit, save_time_limit = 0;
 	uint32_t prio_reserve;
 #if HAVE_SYS_PRCTL_H
@@ -1213,6 +1667,12 @@ static int _schedule(uint32_t job_limit)
 			sched_max_job_start = 0;
 		}
 
+		if (!fifo_sched &&
+		    xstrcasestr(sched_params, "sched_incremental"))
+			sched_incr = true;
+		else
+			sched_incr = false;
+
 		xfree(sched_params);
 		sched_update = slurmctld_conf.last_update;
 		info("SchedulerParameters=default_queue_depth=%d,"
@@ -1327,6 +1787,9 @@ static int _schedule(uint32_t job_limit)
 		list_iterator_destroy(part_iterator);
 	}
 
+	if (!sched_incr)
+		_sched_queue_fini();	/* sched_incremental no longer set */
+
 	sched_debug("Running job scheduler");
 	/*
 	 * If we are doing FIFO scheduling, use the job records right off the
@@ -1340,6 +1803,18 @@ static int _schedule(uint32_t job_limit)
 	if (fifo_sched) {
 		slurmctld_diag_stats.schedule_queue_len = list_count(job_list);
 		job_iterator = list_iterator_create(job_list);
+	} else if (sched_incr) {
+		/*
+		 * Records are taken from the queue kept between runs, those
+		 * tested are put in job_queue and queued again at the end.
+		 */
+		dirty_part_cnt = _sched_queue_update(full_sched, now);
+		for (i = 0; i < failed_part_cnt; i++)
+			sched_queue_set_dirty(failed_parts[i], false);
+		sched_debug2("%d job queue records, %d of %d partitions to test",
+			     sched_queue_count(), dirty_part_cnt, part_cnt);
+		slurmctld_diag_stats.schedule_queue_len = sched_queue_count();
+		job_queue = list_create(xfree_ptr);
 	} else {
 		job_queue = build_job_queue(false, false);
 		slurmctld_diag_stats.schedule_queue_len = list_count(job_queue);
@@ -1372,7 +1847,7 @@ static int _schedule(uint32_t job_limit)
 			if (!avail_front_end(job_ptr)) {
 				job_ptr->state_reason = WAIT_FRONT_END;
 				xfree(job_ptr->state_desc);
-				last_job_update = now;
+				job_state_changed(job_ptr, now);
 				continue;
 			}
 			if (!_job_runnable_test1(job_ptr, false))
@@ -1401,7 +1876,10 @@ next_part:
 					continue;
 			}
 		} else {
-			job_queue_rec = list_pop(job_queue);
+			if (sched_incr)
+				job_queue_rec = _sched_queue_next(now);
+			else
+				job_queue_rec = list_pop(job_queue);
 			if (!job_queue_rec)
 				break;
 			array_task_id = job_queue_rec->array_task_id;
@@ -1410,12 +1888,15 @@ next_part:
 			job_ptr->priority = job_queue_rec->priority;
 
 			job_queue_rec_prom_resv(job_queue_rec);
-			xfree(job_queue_rec);
+			if (sched_incr)
+				list_append(job_queue, job_queue_rec);
+			else
+				xfree(job_queue_rec);
 
 			if (!avail_front_end(job_ptr)) {
 				job_ptr->state_reason = WAIT_FRONT_END;
 				xfree(job_ptr->state_desc);
-				last_job_update = now;
+				job_state_changed(job_ptr, now);
 				continue;
 			}
 			if ((job_ptr->array_task_id != array_task_id) &&
@@ -1440,6 +1921,7 @@ next_part:
 
 		if (job_ptr->het_job_id) {
 			fail_by_part = true;
+			part_busy = false;
 			goto fail_this_part;
 		}
 
@@ -1569,7 +2051,7 @@ next_task:
 					     job_ptr->state_desc,
 					     job_ptr->priority);
 			}
-			last_job_update = now;
+			job_state_changed(job_ptr, now);
 
 			continue;
 		} else if (wait_on_resv &&
@@ -1596,7 +2078,7 @@ next_task:
 				job_ptr->state_reason = WAIT_NO_REASON;
 				xfree(job_ptr->state_desc);
 				job_ptr->assoc_id = assoc_rec.id;
-				last_job_update = now;
+				job_state_changed(job_ptr, now);
 			} else {
 				sched_debug("%pJ has invalid association",
 					    job_ptr);
@@ -1622,12 +2104,12 @@ next_task:
 				assoc_mgr_unlock(&locks);
 				sched_debug("%pJ has invalid QOS", job_ptr);
 				job_fail_qos(job_ptr, __func__);
-				last_job_update = now;
+				job_state_changed(job_ptr, now);
 				continue;
 			} else if (job_ptr->state_reason == FAIL_QOS) {
 				xfree(job_ptr->state_desc);
 				job_ptr->state_reason = WAIT_NO_REASON;
-				last_job_update = now;
+				job_state_changed(job_ptr, now);
 			}
 			assoc_mgr_unlock(&locks);
 		}
@@ -1684,20 +2166,21 @@ next_task:
 			job_ptr->state_reason = WAIT_RESOURCES;
 			xfree(job_ptr->state_desc);
 			job_ptr->state_desc = xstrdup("Nodes required for job are DOWN, DRAINED or reserved for jobs in higher priority partitions");
-			last_job_update = now;
+			job_state_changed(job_ptr, now);
 			sched_debug3("%pJ. State=%s. Reason=%s. Priority=%u. Partition=%s.",
 				     job_ptr,
 				     job_state_string(job_ptr->job_state),
 				     job_reason_string(job_ptr->state_reason),
 				     job_ptr->priority, job_ptr->partition);
 			fail_by_part = true;
+			part_busy = true;
 			goto fail_this_part;
 		}
 		if (license_job_test(job_ptr, time(NULL), true) !=
 		    SLURM_SUCCESS) {
 			job_ptr->state_reason = WAIT_LICENSES;
 			xfree(job_ptr->state_desc);
-			last_job_update = now;
+			job_state_changed(job_ptr, now);
 			sched_debug3("%pJ. State=%s. Reason=%s. Priority=%u.",
 				     job_ptr,
 				     job_state_string(job_ptr->job_state),
@@ -1714,7 +2197,7 @@ next_task:
 			 * the time we consider running it. It should be
 			 * very rare. */
 			sched_info("%pJ has invalid account", job_ptr);
-			last_job_update = now;
+			job_state_changed(job_ptr, now);
 			job_ptr->state_reason = FAIL_ACCOUNT;
 			xfree(job_ptr->state_desc);
 			continue;
@@ -1751,6 +2234,7 @@ next_task:
 skip_start:
 
 		fail_by_part = false;
+		part_busy = false;
 		if ((error_code != SLURM_SUCCESS) && deadline_time_limit)
 			job_ptr->time_limit = save_time_limit;
 		if ((error_code == ESLURM_NODES_BUSY) ||
@@ -1762,6 +2246,7 @@ skip_start:
 				     job_reason_string(job_ptr->state_reason),
 				     job_ptr->priority, job_ptr->partition);
 			fail_by_part = true;
+			part_busy = true;
 		} else if (error_code == ESLURM_BURST_BUFFER_WAIT) {
 			if (job_ptr->start_time == 0) {
 				job_ptr->start_time = last_job_sched_start;
@@ -1799,7 +2284,7 @@ skip_start:
 		} else if (error_code == ESLURM_FED_JOB_LOCK) {
 			job_ptr->state_reason = WAIT_FED_JOB_LOCK;
 			xfree(job_ptr->state_desc);
-			last_job_update = now;
+			job_state_changed(job_ptr, now);
 			sched_debug3("%pJ. State=%s. Reason=%s. Priority=%u. Partition=%s.",
 				     job_ptr,
 				     job_state_string(job_ptr->job_state),
@@ -1809,7 +2294,7 @@ skip_start:
 		} else if (error_code == SLURM_SUCCESS) {
 			/* job initiated */
 			sched_debug3("%pJ initiated", job_ptr);
-			last_job_update = now;
+			job_state_changed(job_ptr, now);
 
 			/* Clear assumed rejected array status */
 			reject_array_job = NULL;
@@ -1859,7 +2344,7 @@ skip_start:
 			   (error_code != ESLURM_INVALID_BURST_BUFFER_REQUEST)){
 			sched_info("schedule: %pJ non-runnable: %s",
 				   job_ptr, slurm_strerror(error_code));
-			last_job_update = now;
+			job_state_changed(job_ptr, now);
 			job_ptr->job_state = JOB_PENDING;
 			job_ptr->state_reason = FAIL_BAD_CONSTRAINTS;
 			xfree(job_ptr->state_desc);
@@ -1927,6 +2412,12 @@ fail_this_part:	if (fail_by_part) {
 			failed_parts[failed_part_cnt++] = job_ptr->part_ptr;
 			bit_and_not(avail_node_bitmap,
 				    job_ptr->part_ptr->node_bitmap);
+			/*
+			 * No job of this partition can start until some of
+			 * its nodes change state or some of its jobs change
+			 */
+			if (sched_incr && part_busy)
+				sched_queue_set_dirty(job_ptr->part_ptr, false);
 		}
 	}
 
@@ -1944,6 +2435,8 @@ fail_this_part:	if (fail_by_part) {
 		if (part_iterator)
 			list_iterator_destroy(part_iterator);
 	} else if (job_queue) {
+		if (sched_incr)
+			_sched_queue_requeue(job_queue);
 		FREE_NULL_LIST(job_queue);
 	}
 	xfree(sched_part_ptr);
@@ -4107,7 +4600,7 @@ next_part:
  */
 extern void epilog_slurmctld(job_record_t *job_ptr)
 {
-	xassert(verify_lock(JOB_LOCK, WRITE_LOCK));
+	xassert(verify_job_rec_lock(job_ptr->job_id));
 
 	prep_epilog_slurmctld(job_ptr);
 }
@@ -4944,6 +5437,8 @@ void cleanup_completing(job_record_t *job_ptr)
 {
 	time_t delay;
 
+	xassert(verify_job_rec_lock(job_ptr->job_id));
+
 	trace_job(job_ptr, __func__, "");
 
 	delay = last_job_update - job_ptr->end_time;
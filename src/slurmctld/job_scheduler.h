@@ -54,6 +54,10 @@ typedef struct job_queue_rec {
 	slurmctld_resv_t *resv_ptr;     /* If job didn't ask for a reservation,
 					 * this reservation is one it can run
 					 * in without requesting */
+	struct job_queue_rec *job_next;	/* Next record of the job kept in
+					 * sched_queue */
+	int queue_inx;			/* Position in the sched_queue heap of
+					 * the partition */
 } job_queue_rec_t;
 
 /* Use as return values for test_job_dependency. */
@@ -217,13 +221,26 @@ extern void rebuild_job_part_list(job_record_t *job_ptr);
  * Note: If the scheduler has executed recently, rather than executing again
  *	right away, a thread will be spawned to execute later in an effort
  *	to reduce system overhead.
- * Note: We re-build the queue every time. Jobs can not only be added
- *	or removed from the queue, but have their priority or partition
- *	changed with the update_job RPC. In general nodes will be in priority
- *	order (by submit time), so the sorting should be pretty fast.
+ * Note: We re-build the queue every time, unless SchedulerParameters has
+ *	sched_incremental. Jobs can not only be added or removed from the
+ *	queue, but have their priority or partition changed with the
+ *	update_job RPC. In general nodes will be in priority order (by submit
+ *	time), so the sorting should be pretty fast.
+ * Note: With sched_incremental the queue is kept between runs and built
+ *	again only by runs with job_limit INFINITE or after the configuration,
+ *	partitions or reservations change. Other runs only test partitions
+ *	in which jobs or nodes changed since the last run.
  */
 extern int schedule(uint32_t job_limit);
 
+/*
+ * schedule_job_changed - note that a job was submitted, completed or changed,
+ *	so that the next run of schedule() with sched_incremental tests it again
+ * IN job_ptr - job that changed
+ * NOTE: Caller must hold the job write lock
+ */
+extern void schedule_job_changed(job_record_t *job_ptr);
+
 /*
  * set_job_elig_time - set the eligible time for pending jobs once their
  *	dependencies are lifted (in job->details->begin_time)
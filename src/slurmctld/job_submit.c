@@ -70,8 +70,26 @@ static const char *syms[] = {
 	"job_modify"
 };
 
+/*
+ * Optional functions of job submit plugins which want to see all jobs of a
+ * batch submission before job_submit() is called for each of them.
+ */
+typedef struct slurm_submit_batch_ops {
+	void (*batch_begin)(List job_desc_list, uint32_t submit_uid);
+	void (*batch_end)(void);
+} slurm_submit_batch_ops_t;
+
+/*
+ * Must be synchronized with slurm_submit_batch_ops_t above.
+ */
+static const char *batch_syms[] = {
+	"job_submit_batch_begin",
+	"job_submit_batch_end"
+};
+
 static int g_context_cnt = -1;
 static slurm_submit_ops_t *ops = NULL;
+static slurm_submit_batch_ops_t *batch_ops = NULL;
 static plugin_context_t **g_context = NULL;
 static char *submit_plugin_list = NULL;
 static pthread_mutex_t g_context_lock = PTHREAD_MUTEX_INITIALIZER;
@@ -105,6 +123,8 @@ extern int job_submit_plugin_init(void)
 	names = tmp_plugin_list;
 	while ((type = strtok_r(names, ",", &last))) {
 		xrecalloc(ops, g_context_cnt + 1, sizeof(slurm_submit_ops_t));
+		xrecalloc(batch_ops, g_context_cnt + 1,
+			  sizeof(slurm_submit_batch_ops_t));
 		xrecalloc(g_context, g_context_cnt + 1,
 			  sizeof(plugin_context_t *));
 		if (xstrncmp(type, "job_submit/", 11) == 0)
@@ -122,6 +142,11 @@ extern int job_submit_plugin_init(void)
 		}
 
 		xfree(type);
+		/* Batch functions are optional, missing ones are left NULL */
+		(void) plugin_get_syms(g_context[g_context_cnt]->cur_plugin,
+				       (sizeof(batch_syms) / sizeof(char *)),
+				       batch_syms,
+				       (void **) &batch_ops[g_context_cnt]);
 		g_context_cnt++;
 		names = NULL; /* for next strtok_r() iteration */
 	}
@@ -159,6 +184,7 @@ extern int job_submit_plugin_fini(void)
 		}
 	}
 	xfree(ops);
+	xfree(batch_ops);
 	xfree(g_context);
 	xfree(submit_plugin_list);
 	g_context_cnt = -1;
@@ -241,6 +267,37 @@ extern int job_submit_plugin_submit(job_desc_msg_t *job_desc,
 	return rc;
 }
 
+extern void job_submit_plugin_batch_begin(List job_desc_list,
+					  uint32_t submit_uid)
+{
+	int i;
+
+	xassert(verify_lock(CONF_LOCK, READ_LOCK));
+	xassert(verify_lock(JOB_LOCK, READ_LOCK));
+
+	if (job_submit_plugin_init() != SLURM_SUCCESS)
+		return;
+	slurm_mutex_lock(&g_context_lock);
+	for (i = 0; i < g_context_cnt; i++) {
+		if (batch_ops[i].batch_begin)
+			(*(batch_ops[i].batch_begin))(job_desc_list,
+						      submit_uid);
+	}
+	slurm_mutex_unlock(&g_context_lock);
+}
+
+extern void job_submit_plugin_batch_end(void)
+{
+	int i;
+
+	slurm_mutex_lock(&g_context_lock);
+	for (i = 0; i < g_context_cnt; i++) {
+		if (batch_ops[i].batch_end)
+			(*(batch_ops[i].batch_end))();
+	}
+	slurm_mutex_unlock(&g_context_lock);
+}
+
 /*
  * Execute the job_modify() function in each job submit plugin.
  * If any plugin function returns anything other than SLURM_SUCCESS
@@ -272,3 +329,147 @@ extern int job_submit_plugin_modify(job_desc_msg_t *job_desc,
 
 	return rc;
 }
+
+/*
+ **************************************************************************
+ *                 S P A N K   O P T I O N   P A R S I N G                *
+ **************************************************************************
+ */
+
+#define SPANK_HASH_SEED_TRIES 64
+
+struct job_submit_spank_table {
+	char *prefix;		/* _SLURM_SPANK_OPTION_<spank_plugin>_ */
+	size_t prefix_len;
+	char **opt_names;
+	int opt_cnt;
+	uint32_t seed;		/* hash seed without collisions */
+	uint32_t slot_cnt;	/* hash table size, a power of two */
+	int *slots;		/* option index by hash slot, -1 if empty */
+};
+
+/* FNV-1a hash of name, varied by seed */
+static uint32_t _spank_hash(const char *name, size_t len, uint32_t seed)
+{
+	uint32_t hash = 2166136261U ^ seed;
+	size_t i;
+
+	for (i = 0; i < len; i++) {
+		hash ^= (unsigned char) name[i];
+		hash *= 16777619U;
+	}
+	return hash;
+}
+
+/* Try to place all option names without collision, RET true on success */
+static bool _spank_table_fill(job_submit_spank_table_t *table)
+{
+	uint32_t slot;
+	int i, prev;
+
+	for (i = 0; i < table->slot_cnt; i++)
+		table->slots[i] = -1;
+	for (i = 0; i < table->opt_cnt; i++) {
+		slot = _spank_hash(table->opt_names[i],
+				   strlen(table->opt_names[i]), table->seed) &
+		       (table->slot_cnt - 1);
+		if ((prev = table->slots[slot]) == -1) {
+			table->slots[slot] = i;
+		} else if (!xstrcmp(table->opt_names[prev],
+				    table->opt_names[i])) {
+			error("%s: duplicate spank option %s, ignored",
+			      __func__, table->opt_names[i]);
+		} else {
+			return false;
+		}
+	}
+	return true;
+}
+
+extern job_submit_spank_table_t *job_submit_spank_table_create(
+	const char *spank_plugin, const char **opt_names, int opt_cnt)
+{
+	job_submit_spank_table_t *table;
+	int i;
+
+	table = xmalloc(sizeof(job_submit_spank_table_t));
+	table->prefix = xstrdup_printf("_SLURM_SPANK_OPTION_%s_",
+				       spank_plugin);
+	table->prefix_len = strlen(table->prefix);
+	table->opt_cnt = opt_cnt;
+	table->opt_names = xcalloc(opt_cnt, sizeof(char *));
+	for (i = 0; i < opt_cnt; i++)
+		table->opt_names[i] = xstrdup(opt_names[i]);
+
+	/* Grow the table until some seed maps all names to distinct slots */
+	table->slot_cnt = 1;
+	while (table->slot_cnt < (opt_cnt * 2))
+		table->slot_cnt <<= 1;
+	while (true) {
+		table->slots = xcalloc(table->slot_cnt, sizeof(int));
+		for (table->seed = 0; table->seed < SPANK_HASH_SEED_TRIES;
+		     table->seed++) {
+			if (_spank_table_fill(table))
+				return table;
+		}
+		xfree(table->slots);
+		table->slot_cnt <<= 1;
+	}
+}
+
+extern void job_submit_spank_table_destroy(job_submit_spank_table_t *table)
+{
+	int i;
+
+	if (!table)
+		return;
+	for (i = 0; i < table->opt_cnt; i++)
+		xfree(table->opt_names[i]);
+	xfree(table->opt_names);
+	xfree(table->prefix);
+	xfree(table->slots);
+	xfree(table);
+}
+
+extern int job_submit_spank_lookup(job_submit_spank_table_t *table,
+				   const char *name, size_t len)
+{
+	uint32_t slot;
+	int inx;
+
+	slot = _spank_hash(name, len, table->seed) & (table->slot_cnt - 1);
+	inx = table->slots[slot];
+	if ((inx == -1) || xstrncmp(table->opt_names[inx], name, len) ||
+	    (table->opt_names[inx][len] != '\0'))
+		return -1;
+	return inx;
+}
+
+extern int job_submit_spank_parse(job_submit_spank_table_t *table,
+				  const job_desc_msg_t *job_desc,
+				  const char **opt_values, char **bad_opt)
+{
+	const char *name, *value;
+	int found = 0, i, inx;
+
+	for (i = 0; i < table->opt_cnt; i++)
+		opt_values[i] = NULL;
+
+	for (i = 0; i < job_desc->spank_job_env_size; i++) {
+		name = job_desc->spank_job_env[i];
+		if (xstrncmp(name, table->prefix, table->prefix_len))
+			continue;
+		name += table->prefix_len;
+		if (!(value = strchr(name, '=')))
+			value = name + strlen(name);
+		inx = job_submit_spank_lookup(table, name, value - name);
+		if ((inx == -1) || (*value != '=')) {
+			*bad_opt = xstrndup(name, value - name);
+			return -1;
+		}
+		opt_values[inx] = value + 1;
+		found++;
+	}
+
+	return found;
+}
@@ -41,6 +41,8 @@
 
 #include "slurm/slurm.h"
 
+#include "src/common/list.h"
+
 /*
  * Initialize the job submit plugin.
  *
@@ -77,6 +79,19 @@ extern int job_submit_plugin_reconfig(void);
 extern int job_submit_plugin_submit(job_desc_msg_t *job_desc,
 				    uint32_t submit_uid, char **err_msg);
 
+/*
+ * Notify the job submit plugins of a batch of independent jobs, before
+ * job_submit_plugin_submit() is called for each of them, and of its end.
+ * Plugins may e.g. resolve data shared by the jobs once for the batch.
+ * Calls the optional job_submit_batch_begin() and job_submit_batch_end()
+ * functions of each job submit plugin.
+ * IN job_desc_list - Job request specifications, type job_desc_msg_t
+ * IN submit_uid - User issuing job submit request
+ */
+extern void job_submit_plugin_batch_begin(List job_desc_list,
+					  uint32_t submit_uid);
+extern void job_submit_plugin_batch_end(void);
+
 /*
  * Execute the job_modify() function in each job submit plugin.
  * This should be called 
@@ -87,4 +102,57 @@ extern int job_submit_plugin_modify(job_desc_msg_t *job_desc,
 				    job_record_t *job_ptr,
 				    uint32_t submit_uid);
 
+/*
+ **************************************************************************
+ *                 S P A N K   O P T I O N   P A R S I N G                *
+ **************************************************************************
+ */
+
+/*
+ * Table of the options of one spank plugin, for job submit plugins which
+ * evaluate the options a job was submitted with. Option names are looked up
+ * by a perfect hash built once when the table is created, so parsing a job's
+ * spank_job_env is a single pass independent of the number of options.
+ */
+typedef struct job_submit_spank_table job_submit_spank_table_t;
+
+/*
+ * Create a table of spank plugin options.
+ * IN spank_plugin - name of the spank plugin, as used in the
+ *	_SLURM_SPANK_OPTION_<spank_plugin>_<option> environment variables
+ * IN opt_names - option names, an option's index in this array is used by
+ *	job_submit_spank_lookup() and job_submit_spank_parse()
+ * IN opt_cnt - number of option names
+ * RET table to be freed by job_submit_spank_table_destroy()
+ */
+extern job_submit_spank_table_t *job_submit_spank_table_create(
+	const char *spank_plugin, const char **opt_names, int opt_cnt);
+
+extern void job_submit_spank_table_destroy(job_submit_spank_table_t *table);
+
+/*
+ * Find an option in a spank option table.
+ * IN name - option name
+ * IN len - length of name
+ * RET index of the option in opt_names or -1 if not found
+ */
+extern int job_submit_spank_lookup(job_submit_spank_table_t *table,
+				   const char *name, size_t len);
+
+/*
+ * Get the values of a spank plugin's options from a job request in one pass
+ * over its spank_job_env.
+ * IN table - options of the spank plugin
+ * IN job_desc - Job request specification
+ * OUT opt_values - value of each option indexed like opt_names, pointing
+ *	into job_desc->spank_job_env, NULL if the option was not given. Options
+ *	without argument have the value "(null)".
+ * OUT bad_opt - name of an option of the spank plugin not in the table,
+ *	caller to xfree results
+ * RET number of options found or -1 if an unknown option was given
+ */
+extern int job_submit_spank_parse(job_submit_spank_table_t *table,
+				  const job_desc_msg_t *job_desc,
+				  const char **opt_values, char **bad_opt);
+
 #endif /* !_JOB_SUBMIT_H */
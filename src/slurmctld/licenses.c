@@ -45,9 +45,11 @@
 #include "slurm/slurm_errno.h"
 
 #include "src/common/assoc_mgr.h"
+#include "src/common/bitstring.h"
 #include "src/common/list.h"
 #include "src/common/log.h"
 #include "src/common/macros.h"
+#include "src/common/xhash.h"
 #include "src/common/xmalloc.h"
 #include "src/common/xstring.h"
 #include "src/slurmctld/licenses.h"
@@ -55,9 +57,25 @@
 #include "src/slurmctld/slurmctld.h"
 #include "src/common/slurm_accounting_storage.h"
 
+/* Upper bound of license group member indices, keeps bitmaps small */
+#define LICENSE_GROUP_MAX_MEMBERS 65536
+
 List license_list = (List) NULL;
 time_t last_license_update = 0;
 static pthread_mutex_t license_mutex = PTHREAD_MUTEX_INITIALIZER;
+
+/*
+ * Index over license_list, so that testing, allocating and returning a job's
+ * licenses does not search the list once per requested license. Rebuilt
+ * whenever records are added to or removed from license_list, which also
+ * bumps license_table_gen so that indices cached in job license records
+ * get resolved again by name.
+ */
+static xhash_t *license_hash = NULL;
+static licenses_t **license_table = NULL;
+static uint32_t license_table_cnt = 0;
+static uint32_t license_table_gen = 0;
+
 static void _pack_license(struct licenses *lic, Buf buffer, uint16_t protocol_version);
 
 /* Print all licenses on a list */
@@ -93,10 +111,84 @@ extern void license_free_rec(void *x)
 
 	if (license_entry) {
 		xfree(license_entry->name);
+		FREE_NULL_BITMAP(license_entry->bits);
+		FREE_NULL_BITMAP(license_entry->used_bits);
 		xfree(license_entry);
 	}
 }
 
+/* Identify a license_t record by its name (for use by xhash) */
+static void _license_hash_id(void *item, const char **key, uint32_t *key_len)
+{
+	licenses_t *license_entry = (licenses_t *) item;
+
+	*key = license_entry->name;
+	*key_len = strlen(license_entry->name);
+}
+
+/*
+ * Rebuild license_hash and license_table from license_list.
+ * license_mutex should be locked before calling this.
+ */
+static void _license_index_rebuild(void)
+{
+	ListIterator iter;
+	licenses_t *license_entry;
+
+	xhash_free(license_hash);
+	xfree(license_table);
+	license_table_cnt = 0;
+	if (++license_table_gen == 0)	/* 0 is reserved for "not resolved" */
+		license_table_gen = 1;
+
+	if (!license_list)
+		return;
+
+	license_hash = xhash_init(_license_hash_id, NULL);
+	license_table = xcalloc(list_count(license_list), sizeof(licenses_t *));
+	iter = list_iterator_create(license_list);
+	while ((license_entry = list_next(iter))) {
+		license_entry->id = license_table_cnt;
+		license_entry->id_gen = license_table_gen;
+		license_table[license_table_cnt++] = license_entry;
+		/* First record wins on duplicate names, like list_find_first */
+		if (!xhash_get_str(license_hash, license_entry->name))
+			xhash_add(license_hash, license_entry);
+	}
+	list_iterator_destroy(iter);
+}
+
+/*
+ * Find a configured license by name.
+ * license_mutex should be locked before calling this.
+ */
+static licenses_t *_license_find_name(char *name)
+{
+	if (!license_hash || !name)
+		return NULL;
+	return xhash_get_str(license_hash, name);
+}
+
+/*
+ * Find the configured license matching a job's license record, caching the
+ * license table index in the job record for subsequent calls.
+ * license_mutex should be locked before calling this.
+ */
+static licenses_t *_license_find_job_rec(licenses_t *license_entry)
+{
+	licenses_t *match;
+
+	if ((license_entry->id_gen == license_table_gen) &&
+	    (license_entry->id < license_table_cnt))
+		return license_table[license_entry->id];
+
+	if ((match = _license_find_name(license_entry->name))) {
+		license_entry->id = match->id;
+		license_entry->id_gen = license_table_gen;
+	}
+	return match;
+}
+
 /* Find a license_t record by license name (for use by list_find_first) */
 static int _license_find_rec(void *x, void *key)
 {
@@ -110,6 +202,14 @@ static int _license_find_rec(void *x, void *key)
 	return 1;
 }
 
+/* Find a license group record (for use by list_find_first) */
+static int _license_find_group(void *x, void *key)
+{
+	licenses_t *license_entry = (licenses_t *) x;
+
+	return (license_entry->bits != NULL);
+}
+
 /* Find a license_t record by license name (for use by list_find_first) */
 static int _license_find_remote_rec(void *x, void *key)
 {
@@ -120,29 +220,132 @@ static int _license_find_remote_rec(void *x, void *key)
 	return _license_find_rec(x, key);
 }
 
+/*
+ * Return the next license token of str, splitting on ',' and ';' outside of
+ * license group brackets. Empty tokens are skipped, NULL returned at the end.
+ */
+static char *_next_license_token(char **str)
+{
+	char *token, *ptr;
+	int depth = 0;
+
+	while (**str && ((**str == ',') || (**str == ';')))
+		(*str)++;
+	if (**str == '\0')
+		return NULL;
+
+	token = *str;
+	for (ptr = token; *ptr; ptr++) {
+		if (*ptr == '[')
+			depth++;
+		else if ((*ptr == ']') && (depth > 0))
+			depth--;
+		else if (!depth && ((*ptr == ',') || (*ptr == ';')))
+			break;
+	}
+	if (*ptr)
+		*ptr++ = '\0';
+	*str = ptr;
+	return token;
+}
+
+/*
+ * Build the member bitmap of a license group from a range expression as
+ * found between the brackets of "prefix[0-3,7]".
+ * RET bitmap sized to hold the highest member, NULL if invalid
+ */
+static bitstr_t *_license_group_bits(char *ranges)
+{
+	int32_t *inx, *p, max_inx = -1;
+	bitstr_t *bits = NULL;
+	int i;
+
+	if (!ranges[0])
+		return NULL;
+	for (i = 0; ranges[i]; i++) {
+		if (!isdigit(ranges[i]) && (ranges[i] != '-') &&
+		    (ranges[i] != ','))
+			return NULL;
+	}
+	if (!(inx = bitfmt2int(ranges)))
+		return NULL;
+	for (p = inx; *p != -1; p += 2) {
+		if ((p[0] > p[1]) || (p[1] >= LICENSE_GROUP_MAX_MEMBERS)) {
+			xfree(inx);
+			return NULL;
+		}
+		max_inx = MAX(max_inx, p[1]);
+	}
+	if (max_inx >= 0) {
+		bits = bit_alloc(max_inx + 1);
+		if (inx2bitstr(bits, inx))
+			FREE_NULL_BITMAP(bits);
+	}
+	xfree(inx);
+	return bits;
+}
+
+/* Grow a group bitmap to nbits, members are never dropped */
+static bitstr_t *_license_group_grow(bitstr_t *bits, bitoff_t nbits)
+{
+	if (bit_size(bits) < nbits)
+		bits = bit_realloc(bits, nbits);
+	return bits;
+}
+
+/* Add members to a license group record and update its count */
+static void _license_group_add(licenses_t *license_entry, bitstr_t *bits)
+{
+	license_entry->bits = _license_group_grow(license_entry->bits,
+						  bit_size(bits));
+	bits = _license_group_grow(bits, bit_size(license_entry->bits));
+	bit_or(license_entry->bits, bits);
+	license_entry->total = bit_set_count(license_entry->bits);
+}
+
 /* Given a license string, return a list of license_t records */
 static List _build_license_list(char *licenses, bool *valid)
 {
 	int i;
-	char *end_num, *tmp_str, *token, *last;
+	char *end_num, *tmp_str, *token, *next, *bracket;
+	bitstr_t *bits;
 	licenses_t *license_entry;
 	List lic_list;
+	xhash_t *lic_hash;
 
 	*valid = true;
 	if ((licenses == NULL) || (licenses[0] == '\0'))
 		return NULL;
 
 	lic_list = list_create(license_free_rec);
+	lic_hash = xhash_init(_license_hash_id, NULL);
 	tmp_str = xstrdup(licenses);
-	token = strtok_r(tmp_str, ",;", &last);
+	next = tmp_str;
+	token = _next_license_token(&next);
 	while (token && *valid) {
 		int32_t num = 1;
+		bits = NULL;
 		for (i = 0; token[i]; i++) {
 			if (isspace(token[i])) {
 				*valid = false;
 				break;
 			}
 
+			if (token[i] == '[') {
+				/* License group, "prefix[ranges]" */
+				bracket = &token[i];
+				i = strlen(token) - 1;
+				if ((bracket == token) || (token[i] != ']')) {
+					*valid = false;
+					break;
+				}
+				token[i] = '\0';
+				*bracket = '\0';
+				if (!(bits = _license_group_bits(bracket + 1)))
+					*valid = false;
+				break;
+			}
+
 			if (token[i] == ':') {
 				token[i++] = '\0';
 				num = (int32_t)strtol(&token[i], &end_num, 10);
@@ -156,19 +359,32 @@ static List _build_license_list(char *licenses, bool *valid)
 			break;
 		}
 
-		license_entry = list_find_first(lic_list, _license_find_rec,
-						token);
-		if (license_entry) {
+		license_entry = xhash_get_str(lic_hash, token);
+		if (license_entry && (!license_entry->bits != !bits)) {
+			/* Mix of counted license and group of same name */
+			FREE_NULL_BITMAP(bits);
+			*valid = false;
+			break;
+		} else if (license_entry && bits) {
+			_license_group_add(license_entry, bits);
+			FREE_NULL_BITMAP(bits);
+		} else if (license_entry) {
 			license_entry->total += num;
 		} else {
 			license_entry = xmalloc(sizeof(licenses_t));
 			license_entry->name = xstrdup(token);
-			license_entry->total = num;
+			if (bits) {
+				license_entry->bits = bits;
+				license_entry->total = bit_set_count(bits);
+			} else
+				license_entry->total = num;
 			list_push(lic_list, license_entry);
+			xhash_add(lic_hash, license_entry);
 		}
-		token = strtok_r(NULL, ",;", &last);
+		token = _next_license_token(&next);
 	}
 	xfree(tmp_str);
+	xhash_free(lic_hash);
 
 	if (*valid == false) {
 		FREE_NULL_LIST(lic_list);
@@ -176,6 +392,160 @@ static List _build_license_list(char *licenses, bool *valid)
 	return lic_list;
 }
 
+/*
+ * Size a job's license group bitmap like the configured group's bitmap.
+ * Members which are not configured fail the test if validate_existing is
+ * set, otherwise they are dropped from the request.
+ * RET true if the request fits the configured group
+ */
+static bool _license_group_fit(licenses_t *license_entry, licenses_t *match,
+			       bool validate_existing)
+{
+	bitoff_t bit, nbits = bit_size(match->bits);
+	bitstr_t *bits;
+
+	if (bit_size(license_entry->bits) != nbits) {
+		bits = bit_alloc(nbits);
+		for (bit = 0; bit < bit_size(license_entry->bits); bit++) {
+			if (!bit_test(license_entry->bits, bit))
+				continue;
+			if (bit >= nbits) {
+				if (validate_existing) {
+					FREE_NULL_BITMAP(bits);
+					return false;
+				}
+				continue;
+			}
+			bit_set(bits, bit);
+		}
+		FREE_NULL_BITMAP(license_entry->bits);
+		license_entry->bits = bits;
+	}
+
+	if (!bit_super_set(license_entry->bits, match->bits)) {
+		if (validate_existing)
+			return false;
+		bit_and(license_entry->bits, match->bits);
+	}
+	license_entry->total = bit_set_count(license_entry->bits);
+	return true;
+}
+
+/* Set up usage tracking of configured license groups */
+static void _license_groups_init(List lic_list)
+{
+	ListIterator iter;
+	licenses_t *license_entry;
+
+	if (!lic_list)
+		return;
+
+	iter = list_iterator_create(lic_list);
+	while ((license_entry = list_next(iter))) {
+		if (license_entry->bits && !license_entry->used_bits)
+			license_entry->used_bits =
+				bit_alloc(bit_size(license_entry->bits));
+	}
+	list_iterator_destroy(iter);
+}
+
+/*
+ * Translate between the two spellings of license group members in a job's
+ * request: members of a configured group requested by individual name
+ * ("W20F3") are folded into the group's bitmap and group ranges
+ * ("W20F[0-3]") with no group of that name configured are expanded into
+ * individual licenses.
+ * license_mutex should be locked before calling this.
+ */
+static void _license_job_list_normalize(List job_license_list)
+{
+	ListIterator iter;
+	licenses_t *license_entry, *match, *group, *new_entry;
+	List add_list;
+	xhash_t *job_hash;
+	char *name, *suffix, *end_num;
+	long inx;
+	bitoff_t bit;
+
+	job_hash = xhash_init(_license_hash_id, NULL);
+	add_list = list_create(NULL);
+	iter = list_iterator_create(job_license_list);
+	while ((license_entry = list_next(iter)))
+		xhash_add(job_hash, license_entry);
+
+	list_iterator_reset(iter);
+	while ((license_entry = list_next(iter))) {
+		match = _license_find_name(license_entry->name);
+		if (license_entry->bits && !(match && match->bits)) {
+			/* Range of a group which is not configured as such */
+			xhash_pop_str(job_hash, license_entry->name);
+			list_remove(iter);
+			for (bit = 0; bit < bit_size(license_entry->bits);
+			     bit++) {
+				if (!bit_test(license_entry->bits, bit))
+					continue;
+				name = xstrdup_printf("%s%"BITSTR_FMT,
+						      license_entry->name, bit);
+				if ((new_entry = xhash_get_str(job_hash,
+							       name))) {
+					new_entry->total++;
+					xfree(name);
+					continue;
+				}
+				new_entry = xmalloc(sizeof(licenses_t));
+				new_entry->name = name;
+				new_entry->total = 1;
+				list_append(add_list, new_entry);
+				xhash_add(job_hash, new_entry);
+			}
+			license_free_rec(license_entry);
+			continue;
+		}
+		if (license_entry->bits || match ||
+		    (license_entry->total != 1))
+			continue;
+
+		/* Unknown name, test if it is a member of a license group */
+		suffix = license_entry->name + strlen(license_entry->name);
+		while ((suffix > license_entry->name) &&
+		       isdigit(*(suffix - 1)))
+			suffix--;
+		if ((suffix == license_entry->name) || !*suffix)
+			continue;
+		inx = strtol(suffix, &end_num, 10);
+		name = xstrndup(license_entry->name,
+				suffix - license_entry->name);
+		match = _license_find_name(name);
+		if (!match || !match->bits || (inx >= bit_size(match->bits)) ||
+		    !bit_test(match->bits, inx)) {
+			xfree(name);
+			continue;
+		}
+		if (!(group = xhash_get_str(job_hash, name))) {
+			group = xmalloc(sizeof(licenses_t));
+			group->name = name;
+			group->bits = bit_alloc(bit_size(match->bits));
+			list_append(add_list, group);
+			xhash_add(job_hash, group);
+		} else
+			xfree(name);
+		if (!group->bits) {
+			/* Also requested as counted license, leave it be */
+			continue;
+		}
+		group->bits = _license_group_grow(group->bits, inx + 1);
+		bit_set(group->bits, inx);
+		group->total = bit_set_count(group->bits);
+		xhash_pop_str(job_hash, license_entry->name);
+		list_delete_item(iter);
+	}
+	list_iterator_destroy(iter);
+	xhash_free(job_hash);
+
+	list_transfer(job_license_list, add_list);
+	FREE_NULL_LIST(add_list);
+}
+
 /*
  * Given a list of license_t records, return a license string.
  *
@@ -197,8 +567,15 @@ extern char *license_list_to_string(List license_list)
 
 	iter = list_iterator_create(license_list);
 	while ((license_entry = list_next(iter))) {
-		xstrfmtcat(licenses, "%s%s:%u",
-			   sep, license_entry->name, license_entry->total);
+		if (license_entry->bits) {
+			char *ranges = bit_fmt_full(license_entry->bits);
+			xstrfmtcat(licenses, "%s%s[%s]",
+				   sep, license_entry->name, ranges);
+			xfree(ranges);
+		} else {
+			xstrfmtcat(licenses, "%s%s:%u", sep,
+				   license_entry->name, license_entry->total);
+		}
 		sep = ",";
 	}
 	list_iterator_destroy(iter);
@@ -235,6 +612,8 @@ extern int license_init(char *licenses)
 	if (!valid)
 		fatal("Invalid configured licenses: %s", licenses);
 
+	_license_groups_init(license_list);
+	_license_index_rebuild();
 	_licenses_print("init_license", license_list, NULL);
 	slurm_mutex_unlock(&license_mutex);
 	return SLURM_SUCCESS;
@@ -252,10 +631,12 @@ extern int license_update(char *licenses)
         new_list = _build_license_list(licenses, &valid);
         if (!valid)
                 fatal("Invalid configured licenses: %s", licenses);
+        _license_groups_init(new_list);
 
         slurm_mutex_lock(&license_mutex);
         if (!license_list) {        /* no licenses before now */
                 license_list = new_list;
+                _license_index_rebuild();
                 slurm_mutex_unlock(&license_mutex);
                 return SLURM_SUCCESS;
         }
@@ -292,6 +673,7 @@ extern int license_update(char *licenses)
 
         FREE_NULL_LIST(license_list);
         license_list = new_list;
+        _license_index_rebuild();
         _licenses_print("update_license", license_list, NULL);
         slurm_mutex_unlock(&license_mutex);
         return SLURM_SUCCESS;
@@ -323,8 +705,10 @@ extern void license_add_remote(slurmdb_res_rec_t *rec)
 
 	if (license_entry)
 		error("license_add_remote: license %s already exists!", name);
-	else
+	else {
 		_add_res_rec_2_lic_list(rec, 0);
+		_license_index_rebuild();
+	}
 
 	xfree(name);
 
@@ -359,6 +743,7 @@ extern void license_update_remote(slurmdb_res_rec_t *rec)
 		debug("license_update_remote: License '%s' not found, adding",
 		      name);
 		_add_res_rec_2_lic_list(rec, 0);
+		_license_index_rebuild();
 	} else {
 		license_entry->total =
 			((rec->count *
@@ -409,6 +794,8 @@ extern void license_remove_remote(slurmdb_res_rec_t *rec)
 
 	if (!license_entry)
 		error("license_remote_remote: License '%s' not found", name);
+	else
+		_license_index_rebuild();
 
 	xfree(name);
 	slurm_mutex_unlock(&license_mutex);
@@ -474,6 +861,7 @@ extern void license_sync_remote(List res_list)
 			license_entry->remote = 1;
 	}
 	list_iterator_destroy(iter);
+	_license_index_rebuild();
 
 	slurm_mutex_unlock(&license_mutex);
 }
@@ -483,6 +871,7 @@ extern void license_free(void)
 {
 	slurm_mutex_lock(&license_mutex);
 	FREE_NULL_LIST(license_list);
+	_license_index_rebuild();
 	slurm_mutex_unlock(&license_mutex);
 }
 
@@ -523,15 +912,11 @@ extern List license_validate(char *licenses, bool validate_configured,
 	}
 
 	slurm_mutex_lock(&license_mutex);
+	_license_job_list_normalize(job_license_list);
 	_licenses_print("request_license", job_license_list, NULL);
 	iter = list_iterator_create(job_license_list);
 	while ((license_entry = list_next(iter))) {
-		if (license_list) {
-			match = list_find_first(license_list,
-						_license_find_rec,
-						license_entry->name);
-		} else
-			match = NULL;
+		match = _license_find_job_rec(license_entry);
 		if (!match) {
 			debug("License name requested (%s) does not exist",
 			      license_entry->name);
@@ -541,6 +926,23 @@ extern List license_validate(char *licenses, bool validate_configured,
 			}
 			*valid = false;
 			break;
+		} else if (!license_entry->bits != !match->bits) {
+			debug("License %s requested as %s but configured as %s",
+			      license_entry->name,
+			      license_entry->bits ? "group" : "counted",
+			      match->bits ? "group" : "counted");
+			*valid = false;
+			break;
+		} else if (license_entry->bits &&
+			   !_license_group_fit(license_entry, match,
+					       validate_existing)) {
+			debug("License group members requested (%s) do not exist",
+			      license_entry->name);
+			*valid = false;
+			break;
+		} else if (license_entry->bits && !license_entry->total) {
+			list_delete_item(iter);
+			continue;
 		} else if (validate_configured &&
 			   (license_entry->total > match->total)) {
 			debug("Licenses count requested higher than configured "
@@ -583,6 +985,22 @@ extern void license_job_merge(job_record_t *job_ptr)
 	job_ptr->licenses = license_list_to_string(job_ptr->license_list);
 }
 
+/*
+ * license_job_compact - Rebuild a job's license string from its license_list
+ *	if it requests license groups, so that group members requested by
+ *	individual name are rendered, packed and saved in range form.
+ * IN job_ptr - job identification
+ */
+extern void license_job_compact(job_record_t *job_ptr)
+{
+	if (!job_ptr->license_list ||
+	    !list_find_first(job_ptr->license_list, _license_find_group, NULL))
+		return;
+
+	xfree(job_ptr->licenses);
+	job_ptr->licenses = license_list_to_string(job_ptr->license_list);
+}
+
 /*
  * license_job_test - Test if the licenses required for a job are available
  * IN job_ptr - job identification
@@ -595,6 +1013,8 @@ extern int license_job_test(job_record_t *job_ptr, time_t when, bool reboot)
 	ListIterator iter;
 	licenses_t *license_entry, *match;
 	int rc = SLURM_SUCCESS, resv_licenses;
+	bitstr_t *resv_bits;
+	bool resv_overlap;
 
 	if (!job_ptr->license_list)	/* no licenses needed */
 		return rc;
@@ -602,13 +1022,24 @@ extern int license_job_test(job_record_t *job_ptr, time_t when, bool reboot)
 	slurm_mutex_lock(&license_mutex);
 	iter = list_iterator_create(job_ptr->license_list);
 	while ((license_entry = list_next(iter))) {
-		match = list_find_first(license_list, _license_find_rec,
-			license_entry->name);
+		match = _license_find_job_rec(license_entry);
 		if (!match) {
 			error("could not find license %s for job %u",
 			      license_entry->name, job_ptr->job_id);
 			rc = SLURM_ERROR;
 			break;
+		} else if ((!license_entry->bits != !match->bits) ||
+			   (license_entry->bits &&
+			    !_license_group_fit(license_entry, match, true))) {
+			info("job %u wants %s licenses which are not configured",
+			     job_ptr->job_id, match->name);
+			rc = SLURM_ERROR;
+			break;
+		} else if (license_entry->bits &&
+			   bit_overlap_any(license_entry->bits,
+					   match->used_bits)) {
+			rc = EAGAIN;
+			break;
 		} else if (license_entry->total > match->total) {
 			info("job %u wants more %s licenses than configured",
 			     job_ptr->job_id, match->name);
@@ -618,12 +1049,25 @@ extern int license_job_test(job_record_t *job_ptr, time_t when, bool reboot)
 			   match->total) {
 			rc = EAGAIN;
 			break;
+		} else if (license_entry->bits) {
+			/* Reservations hold specific members of a group, the
+			 * job must not get any of them */
+			resv_bits = bit_alloc(bit_size(match->bits));
+			(void) job_test_lic_resv(job_ptr, license_entry->name,
+						 when, reboot, resv_bits);
+			resv_overlap = bit_overlap_any(license_entry->bits,
+						       resv_bits);
+			FREE_NULL_BITMAP(resv_bits);
+			if (resv_overlap) {
+				rc = EAGAIN;
+				break;
+			}
 		} else {
 			/* Assume node reboot required since we have not
 			 * selected the compute nodes yet */
 			resv_licenses = job_test_lic_resv(job_ptr,
 							  license_entry->name,
-							  when, reboot);
+							  when, reboot, NULL);
 			if ((license_entry->total + match->used +
 			     resv_licenses) > match->total) {
 				rc = EAGAIN;
@@ -636,6 +1080,242 @@ extern int license_job_test(job_record_t *job_ptr, time_t when, bool reboot)
 	return rc;
 }
 
+/*
+ * license_avail_create - Create a record of the licenses available now
+ * RET license availability, NULL if no licenses are configured,
+ *	must be freed by license_avail_free()
+ */
+extern license_avail_t *license_avail_create(void)
+{
+	license_avail_t *avail = NULL;
+	licenses_t *match;
+	uint32_t i;
+
+	slurm_mutex_lock(&license_mutex);
+	if (license_table_cnt) {
+		avail = xmalloc(sizeof(license_avail_t));
+		avail->cnt = license_table_cnt;
+		avail->gen = license_table_gen;
+		avail->remaining = xcalloc(avail->cnt, sizeof(uint32_t));
+		avail->avail_bits = xcalloc(avail->cnt, sizeof(bitstr_t *));
+		for (i = 0; i < avail->cnt; i++) {
+			match = license_table[i];
+			if (match->used < match->total)
+				avail->remaining[i] = match->total - match->used;
+			if (match->bits && match->used_bits) {
+				avail->avail_bits[i] = bit_copy(match->bits);
+				bit_and_not(avail->avail_bits[i],
+					    match->used_bits);
+			}
+		}
+	}
+	slurm_mutex_unlock(&license_mutex);
+
+	return avail;
+}
+
+/*
+ * license_avail_copy - Create a copy of license availability
+ * IN avail - license availability to be copied
+ * RET a copy of the original license availability
+ */
+extern license_avail_t *license_avail_copy(license_avail_t *avail)
+{
+	license_avail_t *avail_dest;
+	uint32_t i;
+
+	if (!avail)
+		return NULL;
+
+	avail_dest = xmalloc(sizeof(license_avail_t));
+	avail_dest->cnt = avail->cnt;
+	avail_dest->gen = avail->gen;
+	avail_dest->remaining = xcalloc(avail->cnt, sizeof(uint32_t));
+	memcpy(avail_dest->remaining, avail->remaining,
+	       avail->cnt * sizeof(uint32_t));
+	avail_dest->avail_bits = xcalloc(avail->cnt, sizeof(bitstr_t *));
+	for (i = 0; i < avail->cnt; i++) {
+		if (avail->avail_bits[i])
+			avail_dest->avail_bits[i] =
+				bit_copy(avail->avail_bits[i]);
+	}
+
+	return avail_dest;
+}
+
+/* Free a license_avail_t record */
+extern void license_avail_free(license_avail_t *avail)
+{
+	uint32_t i;
+
+	if (!avail)
+		return;
+
+	for (i = 0; i < avail->cnt; i++)
+		FREE_NULL_BITMAP(avail->avail_bits[i]);
+	xfree(avail->avail_bits);
+	xfree(avail->remaining);
+	xfree(avail);
+}
+
+/*
+ * license_avail_equal - Test if two records of license availability match
+ */
+extern bool license_avail_equal(license_avail_t *avail_1,
+				license_avail_t *avail_2)
+{
+	uint32_t i;
+
+	if (!avail_1 || !avail_2)
+		return (avail_1 == avail_2);
+	if ((avail_1->cnt != avail_2->cnt) || (avail_1->gen != avail_2->gen))
+		return false;
+	if (memcmp(avail_1->remaining, avail_2->remaining,
+		   avail_1->cnt * sizeof(uint32_t)))
+		return false;
+	for (i = 0; i < avail_1->cnt; i++) {
+		if (!avail_1->avail_bits[i] != !avail_2->avail_bits[i])
+			return false;
+		if (avail_1->avail_bits[i] &&
+		    !bit_equal(avail_1->avail_bits[i], avail_2->avail_bits[i]))
+			return false;
+	}
+
+	return true;
+}
+
+/*
+ * Find the configured license matching a job's license record, if license
+ * availability was created from the current license table.
+ * license_mutex should be locked before calling this.
+ */
+static licenses_t *_license_avail_find(license_avail_t *avail,
+				       licenses_t *license_entry)
+{
+	licenses_t *match;
+
+	if (avail->gen != license_table_gen)
+		return NULL;
+	if (!(match = _license_find_job_rec(license_entry)) ||
+	    (match->id >= avail->cnt))
+		return NULL;
+	if (license_entry->bits && match->bits)
+		(void) _license_group_fit(license_entry, match, false);
+
+	return match;
+}
+
+/*
+ * license_avail_test - Test if the licenses required for a job are available
+ * IN avail - license availability to test against
+ * IN job_ptr - job identification
+ * RET true if available or availability is unknown (e.g. licenses
+ *	reconfigured since avail was created)
+ */
+extern bool license_avail_test(license_avail_t *avail, job_record_t *job_ptr)
+{
+	ListIterator iter;
+	licenses_t *license_entry, *match;
+	bitstr_t *avail_bits;
+	bool rc = true;
+
+	if (!avail || !job_ptr->license_list)
+		return rc;
+
+	slurm_mutex_lock(&license_mutex);
+	iter = list_iterator_create(job_ptr->license_list);
+	while ((license_entry = list_next(iter))) {
+		if (!(match = _license_avail_find(avail, license_entry)))
+			continue;	/* Reported by license_job_test() */
+		avail_bits = avail->avail_bits[match->id];
+		if (license_entry->bits && avail_bits) {
+			if (!bit_super_set(license_entry->bits, avail_bits)) {
+				rc = false;
+				break;
+			}
+		} else if (license_entry->total >
+			   avail->remaining[match->id]) {
+			rc = false;
+			break;
+		}
+	}
+	list_iterator_destroy(iter);
+	slurm_mutex_unlock(&license_mutex);
+
+	return rc;
+}
+
+/*
+ * license_avail_remove - Remove the licenses required for a job from
+ *	license availability, as done by license_job_get()
+ * IN/OUT avail - license availability to update
+ * IN job_ptr - job identification
+ */
+extern void license_avail_remove(license_avail_t *avail,
+				 job_record_t *job_ptr)
+{
+	ListIterator iter;
+	licenses_t *license_entry, *match;
+	bitstr_t *avail_bits;
+	uint32_t *remaining;
+
+	if (!avail || !job_ptr->license_list)
+		return;
+
+	slurm_mutex_lock(&license_mutex);
+	iter = list_iterator_create(job_ptr->license_list);
+	while ((license_entry = list_next(iter))) {
+		if (!(match = _license_avail_find(avail, license_entry)))
+			continue;
+		avail_bits = avail->avail_bits[match->id];
+		remaining = &avail->remaining[match->id];
+		if (license_entry->bits && avail_bits) {
+			bit_and_not(avail_bits, license_entry->bits);
+			*remaining = bit_set_count(avail_bits);
+		} else {
+			*remaining -= MIN(*remaining, license_entry->total);
+		}
+	}
+	list_iterator_destroy(iter);
+	slurm_mutex_unlock(&license_mutex);
+}
+
+/*
+ * license_avail_return - Add the licenses allocated to a job to license
+ *	availability, as done by license_job_return()
+ * IN/OUT avail - license availability to update
+ * IN job_ptr - job identification
+ */
+extern void license_avail_return(license_avail_t *avail,
+				 job_record_t *job_ptr)
+{
+	ListIterator iter;
+	licenses_t *license_entry, *match;
+	bitstr_t *avail_bits;
+	uint32_t *remaining;
+
+	if (!avail || !job_ptr->license_list)
+		return;
+
+	slurm_mutex_lock(&license_mutex);
+	iter = list_iterator_create(job_ptr->license_list);
+	while ((license_entry = list_next(iter))) {
+		if (!(match = _license_avail_find(avail, license_entry)))
+			continue;
+		avail_bits = avail->avail_bits[match->id];
+		remaining = &avail->remaining[match->id];
+		if (license_entry->bits && avail_bits) {
+			bit_or(avail_bits, license_entry->bits);
+			*remaining = bit_set_count(avail_bits);
+		} else {
+			*remaining = MIN(*remaining + license_entry->total,
+					 match->total);
+		}
+	}
+	list_iterator_destroy(iter);
+	slurm_mutex_unlock(&license_mutex);
+}
+
 /*
  * license_job_copy - create a copy of a job's license list
  * IN license_list_src - job license list to be copied
@@ -656,6 +1336,11 @@ extern List license_job_copy(List license_list_src)
 		license_entry_dest = xmalloc(sizeof(licenses_t));
 		license_entry_dest->name = xstrdup(license_entry_src->name);
 		license_entry_dest->total = license_entry_src->total;
+		license_entry_dest->id = license_entry_src->id;
+		license_entry_dest->id_gen = license_entry_src->id_gen;
+		if (license_entry_src->bits)
+			license_entry_dest->bits =
+				bit_copy(license_entry_src->bits);
 		list_push(license_list_dest, license_entry_dest);
 	}
 	list_iterator_destroy(iter);
@@ -681,9 +1366,14 @@ extern int license_job_get(job_record_t *job_ptr)
 	slurm_mutex_lock(&license_mutex);
 	iter = list_iterator_create(job_ptr->license_list);
 	while ((license_entry = list_next(iter))) {
-		match = list_find_first(license_list, _license_find_rec,
-			license_entry->name);
-		if (match) {
+		match = _license_find_job_rec(license_entry);
+		if (match && license_entry->bits && match->bits) {
+			/* Members may have vanished by reconfiguration */
+			(void) _license_group_fit(license_entry, match, false);
+			bit_or(match->used_bits, license_entry->bits);
+			match->used = bit_set_count(match->used_bits);
+			license_entry->used += license_entry->total;
+		} else if (match) {
 			match->used += license_entry->total;
 			license_entry->used += license_entry->total;
 		} else {
@@ -717,9 +1407,20 @@ extern int license_job_return(job_record_t *job_ptr)
 	slurm_mutex_lock(&license_mutex);
 	iter = list_iterator_create(job_ptr->license_list);
 	while ((license_entry = list_next(iter))) {
-		match = list_find_first(license_list, _license_find_rec,
-			license_entry->name);
-		if (match) {
+		match = _license_find_job_rec(license_entry);
+		if (match && license_entry->bits && match->bits &&
+		    (bit_size(license_entry->bits) ==
+		     bit_size(match->used_bits))) {
+			if (!bit_super_set(license_entry->bits,
+					   match->used_bits)) {
+				error("%s: license use count underflow for %s",
+				      __func__, match->name);
+				rc = SLURM_ERROR;
+			}
+			bit_and_not(match->used_bits, license_entry->bits);
+			match->used = bit_set_count(match->used_bits);
+			license_entry->used = 0;
+		} else if (match) {
 			if (match->used >= license_entry->total)
 				match->used -= license_entry->total;
 			else {
@@ -823,22 +1524,215 @@ get_all_license_info(char **buffer_ptr,
 	buffer_ptr[0] = xfer_buf_data(buffer);
 }
 
+/*
+ * Add the licenses of the active reservations to the reserved counts and
+ * group members of the license table.
+ * license_mutex should be locked before calling this.
+ */
+static void _license_usage_resv(List resv_records, uint32_t *reserved,
+				bitstr_t **reserved_bits)
+{
+	ListIterator resv_iter, iter;
+	slurmctld_resv_t *resv_ptr;
+	licenses_t *license_entry, *match;
+	bitoff_t bit, nbits;
+	time_t now = time(NULL);
+
+	if (!resv_records)
+		return;
+
+	resv_iter = list_iterator_create(resv_records);
+	while ((resv_ptr = list_next(resv_iter))) {
+		if (!resv_ptr->license_list ||
+		    (resv_ptr->start_time > now) || (resv_ptr->end_time <= now))
+			continue;
+		iter = list_iterator_create(resv_ptr->license_list);
+		while ((license_entry = list_next(iter))) {
+			if (!(match = _license_find_name(license_entry->name)))
+				continue;
+			if (!license_entry->bits || !match->bits) {
+				reserved[match->id] += license_entry->total;
+				continue;
+			}
+			/* The reservation's bitmap may be sized differently */
+			nbits = MIN(bit_size(license_entry->bits),
+				    bit_size(match->bits));
+			for (bit = 0; bit < nbits; bit++) {
+				if (bit_test(license_entry->bits, bit))
+					bit_set(reserved_bits[match->id], bit);
+			}
+		}
+		list_iterator_destroy(iter);
+	}
+	list_iterator_destroy(resv_iter);
+}
+
+/* get_all_license_usage()
+ *
+ * Return license usage to the library, including the members of license
+ * groups in use, reserved or available.
+ */
+extern void get_all_license_usage(char **buffer_ptr, int *buffer_size,
+				  List resv_records, time_t last_update,
+				  uint16_t protocol_version)
+{
+	licenses_t *lic_entry;
+	uint32_t *reserved = NULL, lic_cnt, used_cnt, resv_cnt;
+	bitstr_t **reserved_bits = NULL, *avail_bits;
+	char *members, *used_members, *resv_members, *avail_members;
+	Buf buffer;
+	int i;
+
+	debug2("%s: calling for all licenses", __func__);
+
+	buffer_ptr[0] = NULL;
+	*buffer_size = 0;
+
+	buffer = init_buf(BUF_SIZE);
+
+	slurm_mutex_lock(&license_mutex);
+	lic_cnt = license_table_cnt;
+	if (protocol_version < SLURM_MIN_PROTOCOL_VERSION) {
+		error("%s: protocol_version %hu not supported",
+		      __func__, protocol_version);
+		lic_cnt = 0;
+	}
+	pack32(lic_cnt, buffer);
+	pack_time(last_update, buffer);
+
+	if (lic_cnt) {
+		reserved = xcalloc(lic_cnt, sizeof(uint32_t));
+		reserved_bits = xcalloc(lic_cnt, sizeof(bitstr_t *));
+		for (i = 0; i < lic_cnt; i++) {
+			if (license_table[i]->bits)
+				reserved_bits[i] =
+					bit_alloc(bit_size(
+						license_table[i]->bits));
+		}
+		_license_usage_resv(resv_records, reserved, reserved_bits);
+	}
+
+	for (i = 0; i < lic_cnt; i++) {
+		lic_entry = license_table[i];
+		used_cnt = lic_entry->used;
+		members = used_members = resv_members = avail_members = NULL;
+		if (lic_entry->bits) {
+			/* Reserved members in use are reported as in use */
+			bit_and(reserved_bits[i], lic_entry->bits);
+			bit_and_not(reserved_bits[i], lic_entry->used_bits);
+			avail_bits = bit_copy(lic_entry->bits);
+			bit_and_not(avail_bits, lic_entry->used_bits);
+			bit_and_not(avail_bits, reserved_bits[i]);
+			used_cnt = bit_set_count(lic_entry->used_bits);
+			resv_cnt = bit_set_count(reserved_bits[i]);
+			members = bit_fmt_full(lic_entry->bits);
+			used_members = bit_fmt_full(lic_entry->used_bits);
+			resv_members = bit_fmt_full(reserved_bits[i]);
+			avail_members = bit_fmt_full(avail_bits);
+			FREE_NULL_BITMAP(avail_bits);
+		} else if (lic_entry->total > used_cnt) {
+			resv_cnt = MIN(reserved[i], lic_entry->total - used_cnt);
+		} else {
+			resv_cnt = 0;
+		}
+
+		packstr(lic_entry->name, buffer);
+		pack32(lic_entry->total, buffer);
+		pack32(used_cnt, buffer);
+		pack32(resv_cnt, buffer);
+		pack8(lic_entry->remote, buffer);
+		packstr(members, buffer);
+		packstr(used_members, buffer);
+		packstr(resv_members, buffer);
+		packstr(avail_members, buffer);
+		xfree(members);
+		xfree(used_members);
+		xfree(resv_members);
+		xfree(avail_members);
+		FREE_NULL_BITMAP(reserved_bits[i]);
+	}
+	debug2("%s: processed %u licenses", __func__, lic_cnt);
+	slurm_mutex_unlock(&license_mutex);
+
+	xfree(reserved);
+	xfree(reserved_bits);
+
+	*buffer_size = get_buf_offset(buffer);
+	buffer_ptr[0] = xfer_buf_data(buffer);
+}
+
 extern uint32_t get_total_license_cnt(char *name)
 {
 	uint32_t count = 0;
 	licenses_t *lic;
 
 	slurm_mutex_lock(&license_mutex);
-	if (license_list) {
-		lic = list_find_first(
-			license_list, _license_find_rec, name);
+	if ((lic = _license_find_name(name)))
+		count = lic->total;
+	slurm_mutex_unlock(&license_mutex);
+
+	return count;
+}
 
-		if (lic)
-			count = lic->total;
+extern void license_list_group_bits(List license_list, char *lic_name,
+				    bitstr_t *bits)
+{
+	ListIterator iter;
+	licenses_t *license_entry;
+	bitoff_t bit, nbits;
+
+	if (!license_list)
+		return;
+
+	iter = list_iterator_create(license_list);
+	while ((license_entry = list_next(iter))) {
+		if (!license_entry->bits ||
+		    xstrcmp(license_entry->name, lic_name))
+			continue;
+		/* The reservation's bitmap may be sized differently */
+		nbits = MIN(bit_size(license_entry->bits), bit_size(bits));
+		for (bit = 0; bit < nbits; bit++) {
+			if (bit_test(license_entry->bits, bit))
+				bit_set(bits, bit);
+		}
+	}
+	list_iterator_destroy(iter);
+}
+
+extern bitstr_t *license_group_avail(char *name, char *resv_name)
+{
+	ListIterator iter;
+	slurmctld_resv_t *resv_ptr;
+	bitstr_t *avail = NULL, *resv_bits;
+	licenses_t *lic;
+	time_t now = time(NULL);
+
+	slurm_mutex_lock(&license_mutex);
+	if ((lic = _license_find_name(name)) && lic->bits) {
+		avail = bit_copy(lic->bits);
+		bit_and_not(avail, lic->used_bits);
 	}
 	slurm_mutex_unlock(&license_mutex);
 
-	return count;
+	if (!avail || !resv_list)
+		return avail;
+
+	/* Members held by active reservations the job is not in */
+	resv_bits = bit_alloc(bit_size(avail));
+	iter = list_iterator_create(resv_list);
+	while ((resv_ptr = list_next(iter))) {
+		if ((resv_ptr->start_time > now) || (resv_ptr->end_time <= now))
+			continue;
+		if (resv_name && !xstrcmp(resv_name, resv_ptr->name))
+			continue;
+		license_list_group_bits(resv_ptr->license_list, name,
+					resv_bits);
+	}
+	list_iterator_destroy(iter);
+	bit_and_not(avail, resv_bits);
+	FREE_NULL_BITMAP(resv_bits);
+
+	return avail;
 }
 
 /* node_read should be locked before coming in here
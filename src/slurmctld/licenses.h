@@ -39,16 +39,47 @@
 #ifndef _LICENSES_H
 #define _LICENSES_H
 
+#include "src/common/bitstring.h"
 #include "src/common/list.h"
 #include "src/slurmctld/slurmctld.h"
 
+/*
+ * Licenses are either counted ("name:count") or license groups. A group
+ * ("prefix[0-47]") is a set of single-count licenses named prefix<index>,
+ * which is stored as a bitmap of its members instead of one record per
+ * member. Jobs may request group members by range or by individual name.
+ */
 typedef struct licenses {
-	char *		name;		/* name associated with a license */
+	char *		name;		/* name associated with a license,
+					 * prefix of a license group */
 	uint32_t	total;		/* total license configued */
 	uint32_t	used;		/* used licenses */
 	uint8_t         remote;	        /* non-zero if remote (from database) */
+	bitstr_t *	bits;		/* configured or requested members of a
+					 * license group, NULL if counted */
+	bitstr_t *	used_bits;	/* members of a configured license group
+					 * in use, NULL if counted */
+	uint32_t	id;		/* index in the license table, for job
+					 * records the resolved index of the
+					 * configured license */
+	uint32_t	id_gen;		/* license table generation id was
+					 * resolved in, 0 if not resolved */
 } licenses_t;
 
+/*
+ * Licenses available during a span of time, used by the backfill scheduler
+ * to plan the license use of pending jobs. Indexed like the license table,
+ * so only meaningful as long as the license configuration is unchanged.
+ */
+typedef struct license_avail {
+	uint32_t	cnt;		/* number of configured licenses */
+	uint32_t	gen;		/* license table generation */
+	uint32_t *	remaining;	/* licenses available, by license id */
+	bitstr_t **	avail_bits;	/* members of a license group
+					 * available, by license id, NULL if
+					 * counted */
+} license_avail_t;
+
 extern List license_list;
 extern List clus_license_list;
 extern time_t last_license_update;
@@ -71,6 +102,56 @@ extern void license_free(void);
 /* Free a license_t record (for use by list_destroy) */
 extern void license_free_rec(void *x);
 
+/*
+ * license_avail_create - Create a record of the licenses available now
+ * RET license availability, NULL if no licenses are configured,
+ *	must be freed by license_avail_free()
+ */
+extern license_avail_t *license_avail_create(void);
+
+/*
+ * license_avail_copy - Create a copy of license availability
+ * IN avail - license availability to be copied
+ * RET a copy of the original license availability
+ */
+extern license_avail_t *license_avail_copy(license_avail_t *avail);
+
+/* Free a license_avail_t record */
+extern void license_avail_free(license_avail_t *avail);
+
+/*
+ * license_avail_equal - Test if two records of license availability match
+ */
+extern bool license_avail_equal(license_avail_t *avail_1,
+				license_avail_t *avail_2);
+
+/*
+ * license_avail_test - Test if the licenses required for a job are available
+ * IN avail - license availability to test against
+ * IN job_ptr - job identification
+ * RET true if available or availability is unknown (e.g. licenses
+ *	reconfigured since avail was created)
+ */
+extern bool license_avail_test(license_avail_t *avail, job_record_t *job_ptr);
+
+/*
+ * license_avail_remove - Remove the licenses required for a job from
+ *	license availability, as done by license_job_get()
+ * IN/OUT avail - license availability to update
+ * IN job_ptr - job identification
+ */
+extern void license_avail_remove(license_avail_t *avail,
+				 job_record_t *job_ptr);
+
+/*
+ * license_avail_return - Add the licenses allocated to a job to license
+ *	availability, as done by license_job_return()
+ * IN/OUT avail - license availability to update
+ * IN job_ptr - job identification
+ */
+extern void license_avail_return(license_avail_t *avail,
+				 job_record_t *job_ptr);
+
 /*
  * license_job_copy - create a copy of a job's license list
  * IN license_list_src - job license list to be copied
@@ -93,6 +174,14 @@ extern int license_job_get(job_record_t *job_ptr);
  */
 extern void license_job_merge(job_record_t *job_ptr);
 
+/*
+ * license_job_compact - Rebuild a job's license string from its license_list
+ *	if it requests license groups, so that group members requested by
+ *	individual name are rendered, packed and saved in range form.
+ * IN job_ptr - job identification
+ */
+extern void license_job_compact(job_record_t *job_ptr);
+
 /*
  * license_job_return - Return the licenses allocated to a job
  * IN job_ptr - job identification
@@ -155,12 +244,46 @@ get_all_license_info(char **buffer_ptr,
                      uid_t uid,
                      uint16_t protocol_version);
 
+/*
+ * get_all_license_usage - Pack the usage of all licenses, including the
+ *	members of license groups in use, reserved or available
+ * IN resv_records - list of reservations, whose licenses are reported as
+ *	reserved while active, node_read should be locked
+ * IN last_update - time of last license or reservation update
+ * OUT buffer_ptr - the pointer is set to the allocated buffer
+ * OUT buffer_size - set to size of the buffer in bytes
+ */
+extern void get_all_license_usage(char **buffer_ptr, int *buffer_size,
+				  List resv_records, time_t last_update,
+				  uint16_t protocol_version);
+
 /*
  * get_total_license_cnt - give me the total count of a given license name.
  *
  */
 extern uint32_t get_total_license_cnt(char *name);
 
+/*
+ * license_group_avail - Get the members of a license group neither in use
+ *	nor held by an active reservation other than resv_name
+ * IN name - prefix of the license group
+ * IN resv_name - reservation the job is submitted to, NULL if none
+ * RET bitmap of available members, NULL if no such license group is
+ *	configured, must be freed by caller
+ * NOTE: node_read should be locked before calling this (resv_list)
+ */
+extern bitstr_t *license_group_avail(char *name, char *resv_name);
+
+/*
+ * license_list_group_bits - Set the members of a license group requested in
+ *	a license list, e.g. those held by a reservation
+ * IN license_list - licenses of a job or reservation
+ * IN lic_name - prefix of the license group
+ * IN/OUT bits - members requested are set, members beyond its size ignored
+ */
+extern void license_list_group_bits(List license_list, char *lic_name,
+				    bitstr_t *bits);
+
 /* node_read should be locked before coming in here
  * returns tres_str of the license_list.
  */
@@ -41,14 +41,42 @@
 #include <pthread.h>
 #include <string.h>
 #include <sys/types.h>
+#include <time.h>
 
+#include "src/common/lock_stats.h"
 #include "src/slurmctld/locks.h"
 #include "src/slurmctld/slurmctld.h"
 
+#define JOB_REC_LOCK_CNT 64	/* stripes of job record locks */
+
+typedef struct {
+	pthread_mutex_t mutex;	/* recursive */
+	/* Statistics, only changed while the mutex is held */
+	uint32_t rpc_cnt;
+	uint64_t lock_cnt;
+	uint64_t wait_cnt;
+	uint64_t wait_usec;
+	uint32_t wait_max_usec;
+} job_rec_lock_t;
+
 static pthread_mutex_t state_mutex = PTHREAD_MUTEX_INITIALIZER;
 
 static pthread_rwlock_t slurmctld_locks[ENTITY_COUNT];
 
+#ifdef LOCK_STATS
+static const char *lock_names[ENTITY_COUNT] = {
+	"conf", "job", "node", "part", "fed"
+};
+
+/* Statistics and acquisition times of the locks held by this thread */
+static __thread lock_stats_ent_t *held_stats[ENTITY_COUNT];
+static __thread struct timespec held_since[ENTITY_COUNT];
+#endif
+
+static job_rec_lock_t job_rec_locks[JOB_REC_LOCK_CNT];
+static pthread_once_t job_rec_locks_once = PTHREAD_ONCE_INIT;
+static bool job_rec_locks_enabled = false;
+
 #ifndef NDEBUG
 /*
  * Used to protect against double-locking within a single thread. Calling
@@ -69,6 +97,9 @@ static __thread bool slurmctld_locked = false;
 
 static __thread slurmctld_lock_t thread_locks;
 
+/* Count of locks held by this thread on each stripe of job records */
+static __thread uint16_t thread_job_recs_locked[JOB_REC_LOCK_CNT];
+
 static bool _store_locks(slurmctld_lock_t lock_levels)
 {
 	if (slurmctld_locked)
@@ -100,10 +131,56 @@ extern bool verify_lock(lock_datatype_t datatype, lock_level_t level)
 {
 	return (((lock_level_t *) &thread_locks)[datatype] >= level);
 }
+
+extern bool verify_job_rec_lock(uint32_t job_id)
+{
+	if (thread_locks.job == WRITE_LOCK)
+		return true;
+	return ((thread_locks.job == READ_LOCK) &&
+		thread_job_recs_locked[job_id % JOB_REC_LOCK_CNT]);
+}
+#endif
+
+static void _lock_entity(lock_datatype_t datatype, lock_level_t level,
+			 const char *caller)
+{
+#ifdef LOCK_STATS
+	struct timespec requested;
+
+	if (level == NO_LOCK)
+		return;
+	clock_gettime(CLOCK_MONOTONIC, &requested);
+#endif
+
+	if (level == READ_LOCK)
+		slurm_rwlock_rdlock(&slurmctld_locks[datatype]);
+	else if (level == WRITE_LOCK)
+		slurm_rwlock_wrlock(&slurmctld_locks[datatype]);
+
+#ifdef LOCK_STATS
+	held_stats[datatype] = lock_stats_acquired(lock_names[datatype],
+						   (level == WRITE_LOCK),
+						   caller, &requested,
+						   &held_since[datatype]);
+#endif
+}
+
+static void _unlock_entity(lock_datatype_t datatype, lock_level_t level)
+{
+	if (level == NO_LOCK)
+		return;
+
+	slurm_rwlock_unlock(&slurmctld_locks[datatype]);
+
+#ifdef LOCK_STATS
+	lock_stats_released(held_stats[datatype], &held_since[datatype]);
+	held_stats[datatype] = NULL;
 #endif
+}
 
 /* lock_slurmctld - Issue the required lock requests in a well defined order */
-extern void lock_slurmctld(slurmctld_lock_t lock_levels)
+extern void lock_slurmctld_caller(slurmctld_lock_t lock_levels,
+				  const char *caller)
 {
 	static bool init_run = false;
 	xassert(_store_locks(lock_levels));
@@ -114,30 +191,17 @@ extern void lock_slurmctld(slurmctld_lock_t lock_levels)
 			slurm_rwlock_init(&slurmctld_locks[i]);
 	}
 
-	if (lock_levels.conf == READ_LOCK)
-		slurm_rwlock_rdlock(&slurmctld_locks[CONF_LOCK]);
-	else if (lock_levels.conf == WRITE_LOCK)
-		slurm_rwlock_wrlock(&slurmctld_locks[CONF_LOCK]);
-
-	if (lock_levels.job == READ_LOCK)
-		slurm_rwlock_rdlock(&slurmctld_locks[JOB_LOCK]);
-	else if (lock_levels.job == WRITE_LOCK)
-		slurm_rwlock_wrlock(&slurmctld_locks[JOB_LOCK]);
-
-	if (lock_levels.node == READ_LOCK)
-		slurm_rwlock_rdlock(&slurmctld_locks[NODE_LOCK]);
-	else if (lock_levels.node == WRITE_LOCK)
-		slurm_rwlock_wrlock(&slurmctld_locks[NODE_LOCK]);
-
-	if (lock_levels.part == READ_LOCK)
-		slurm_rwlock_rdlock(&slurmctld_locks[PART_LOCK]);
-	else if (lock_levels.part == WRITE_LOCK)
-		slurm_rwlock_wrlock(&slurmctld_locks[PART_LOCK]);
+	_lock_entity(CONF_LOCK, lock_levels.conf, caller);
+	_lock_entity(JOB_LOCK, lock_levels.job, caller);
+	_lock_entity(NODE_LOCK, lock_levels.node, caller);
+	_lock_entity(PART_LOCK, lock_levels.part, caller);
+	_lock_entity(FED_LOCK, lock_levels.fed, caller);
+}
 
-	if (lock_levels.fed == READ_LOCK)
-		slurm_rwlock_rdlock(&slurmctld_locks[FED_LOCK]);
-	else if (lock_levels.fed == WRITE_LOCK)
-		slurm_rwlock_wrlock(&slurmctld_locks[FED_LOCK]);
+/* Parentheses keep the LOCK_STATS macro of locks.h from expanding */
+extern void (lock_slurmctld)(slurmctld_lock_t lock_levels)
+{
+	lock_slurmctld_caller(lock_levels, NULL);
 }
 
 /* unlock_slurmctld - Issue the required unlock requests in a well
@@ -146,20 +210,11 @@ extern void unlock_slurmctld(slurmctld_lock_t lock_levels)
 {
 	xassert(_clear_locks(lock_levels));
 
-	if (lock_levels.fed)
-		slurm_rwlock_unlock(&slurmctld_locks[FED_LOCK]);
-
-	if (lock_levels.part)
-		slurm_rwlock_unlock(&slurmctld_locks[PART_LOCK]);
-
-	if (lock_levels.node)
-		slurm_rwlock_unlock(&slurmctld_locks[NODE_LOCK]);
-
-	if (lock_levels.job)
-		slurm_rwlock_unlock(&slurmctld_locks[JOB_LOCK]);
-
-	if (lock_levels.conf)
-		slurm_rwlock_unlock(&slurmctld_locks[CONF_LOCK]);
+	_unlock_entity(FED_LOCK, lock_levels.fed);
+	_unlock_entity(PART_LOCK, lock_levels.part);
+	_unlock_entity(NODE_LOCK, lock_levels.node);
+	_unlock_entity(JOB_LOCK, lock_levels.job);
+	_unlock_entity(CONF_LOCK, lock_levels.conf);
 }
 
 /*
@@ -216,3 +271,164 @@ extern void unlock_state_files(void)
 {
 	slurm_mutex_unlock(&state_mutex);
 }
+
+static void _init_job_rec_locks(void)
+{
+	pthread_mutexattr_t attr;
+	int i;
+
+	pthread_mutexattr_init(&attr);
+	pthread_mutexattr_settype(&attr, PTHREAD_MUTEX_RECURSIVE);
+	for (i = 0; i < JOB_REC_LOCK_CNT; i++)
+		pthread_mutex_init(&job_rec_locks[i].mutex, &attr);
+	pthread_mutexattr_destroy(&attr);
+}
+
+/* Lock a stripe of job records, counting the time waited if contended */
+static void _lock_job_rec_inx(int inx)
+{
+	job_rec_lock_t *lock = &job_rec_locks[inx];
+	struct timespec start, end;
+	uint64_t wait_usec;
+	int err;
+
+	if (!(err = pthread_mutex_trylock(&lock->mutex))) {
+		lock->lock_cnt++;
+		return;
+	}
+	if (err != EBUSY) {
+		errno = err;
+		fatal("%s: pthread_mutex_trylock(): %m", __func__);
+	}
+
+	clock_gettime(CLOCK_MONOTONIC, &start);
+	slurm_mutex_lock(&lock->mutex);
+	clock_gettime(CLOCK_MONOTONIC, &end);
+	wait_usec = ((end.tv_sec - start.tv_sec) * USEC_IN_SEC) +
+		    ((end.tv_nsec - start.tv_nsec) / NSEC_IN_USEC);
+	lock->lock_cnt++;
+	lock->wait_cnt++;
+	lock->wait_usec += wait_usec;
+	if (wait_usec > lock->wait_max_usec)
+		lock->wait_max_usec = wait_usec;
+}
+
+extern void set_job_rec_locking(bool enable)
+{
+	xassert(verify_lock(JOB_LOCK, WRITE_LOCK));
+
+	pthread_once(&job_rec_locks_once, _init_job_rec_locks);
+	if (enable != job_rec_locks_enabled)
+		info("Fine grained job locks %s",
+		     enable ? "enabled" : "disabled");
+	job_rec_locks_enabled = enable;
+}
+
+extern bool job_rec_locking(void)
+{
+	return job_rec_locks_enabled;
+}
+
+extern void lock_job_rec(uint32_t job_id)
+{
+	if (!job_rec_locks_enabled)
+		return;
+	_lock_job_rec_inx(job_id % JOB_REC_LOCK_CNT);
+#ifndef NDEBUG
+	thread_job_recs_locked[job_id % JOB_REC_LOCK_CNT]++;
+#endif
+}
+
+extern void unlock_job_rec(uint32_t job_id)
+{
+	if (!job_rec_locks_enabled)
+		return;
+#ifndef NDEBUG
+	thread_job_recs_locked[job_id % JOB_REC_LOCK_CNT]--;
+#endif
+	slurm_mutex_unlock(&job_rec_locks[job_id % JOB_REC_LOCK_CNT].mutex);
+}
+
+extern void lock_slurmctld_job_caller(slurmctld_lock_t *lock_levels,
+				      uint32_t job_id, const char *caller)
+{
+	slurmctld_lock_t fine_levels = *lock_levels;
+	bool fine;
+
+	xassert(lock_levels->job == WRITE_LOCK);
+	xassert(job_id != NO_VAL);
+
+	fine_levels.job = READ_LOCK;
+	while (1) {
+		/* The mode only changes beneath the job write lock */
+		fine = job_rec_locks_enabled;
+		lock_slurmctld_caller(fine ? fine_levels : *lock_levels,
+				      caller);
+		if (fine == job_rec_locks_enabled)
+			break;
+		unlock_slurmctld(fine ? fine_levels : *lock_levels);
+	}
+	if (!fine)
+		return;
+
+	*lock_levels = fine_levels;
+	_lock_job_rec_inx(job_id % JOB_REC_LOCK_CNT);
+	job_rec_locks[job_id % JOB_REC_LOCK_CNT].rpc_cnt++;
+#ifndef NDEBUG
+	thread_job_recs_locked[job_id % JOB_REC_LOCK_CNT]++;
+#endif
+}
+
+/* Parentheses keep the LOCK_STATS macro of locks.h from expanding */
+extern void (lock_slurmctld_job)(slurmctld_lock_t *lock_levels,
+				 uint32_t job_id)
+{
+	lock_slurmctld_job_caller(lock_levels, job_id, NULL);
+}
+
+extern void unlock_slurmctld_job(slurmctld_lock_t lock_levels,
+				 uint32_t job_id)
+{
+	if (lock_levels.job == READ_LOCK) {
+#ifndef NDEBUG
+		thread_job_recs_locked[job_id % JOB_REC_LOCK_CNT]--;
+#endif
+		slurm_mutex_unlock(
+			&job_rec_locks[job_id % JOB_REC_LOCK_CNT].mutex);
+	}
+	unlock_slurmctld(lock_levels);
+}
+
+extern void get_job_rec_lock_stats(job_rec_lock_stats_t *stats)
+{
+	job_rec_lock_t *lock;
+	int i;
+
+	/* Read without locking, an update in progress may be missed */
+	memset(stats, 0, sizeof(job_rec_lock_stats_t));
+	for (i = 0, lock = job_rec_locks; i < JOB_REC_LOCK_CNT; i++, lock++) {
+		stats->rpc_cnt += lock->rpc_cnt;
+		stats->lock_cnt += lock->lock_cnt;
+		stats->wait_cnt += lock->wait_cnt;
+		stats->wait_usec += lock->wait_usec;
+		stats->wait_max_usec = MAX(stats->wait_max_usec,
+					   lock->wait_max_usec);
+	}
+}
+
+extern void reset_job_rec_lock_stats(void)
+{
+	job_rec_lock_t *lock;
+	int i;
+
+	pthread_once(&job_rec_locks_once, _init_job_rec_locks);
+	for (i = 0, lock = job_rec_locks; i < JOB_REC_LOCK_CNT; i++, lock++) {
+		slurm_mutex_lock(&lock->mutex);
+		lock->rpc_cnt = 0;
+		lock->lock_cnt = 0;
+		lock->wait_cnt = 0;
+		lock->wait_usec = 0;
+		lock->wait_max_usec = 0;
+		slurm_mutex_unlock(&lock->mutex);
+	}
+}
@@ -92,6 +92,7 @@
 #define _SLURMCTLD_LOCKS_H
 
 #include <stdbool.h>
+#include <stdint.h>
 
 /* levels of locking required for each data structure */
 typedef enum {
@@ -120,6 +121,12 @@ typedef enum {
 
 #ifndef NDEBUG
 extern bool verify_lock(lock_datatype_t datatype, lock_level_t level);
+
+/*
+ * Return true if this thread may modify the job's record: it holds the job
+ * write lock, or the job read lock and the lock of the job's record
+ */
+extern bool verify_job_rec_lock(uint32_t job_id);
 #endif
 
 /* init_locks - create locks used for slurmctld data structure access
@@ -129,14 +136,93 @@ extern void init_locks ( void );
 /* lock_slurmctld - Issue the required lock requests in a well defined order */
 extern void lock_slurmctld (slurmctld_lock_t lock_levels);
 
+/*
+ * lock_slurmctld_caller - lock_slurmctld() with the function issuing the lock
+ *	requests, recorded in the lock statistics if built with LOCK_STATS
+ */
+extern void lock_slurmctld_caller(slurmctld_lock_t lock_levels,
+				  const char *caller);
+
 /* unlock_slurmctld - Issue the required unlock requests in a well
  *	defined order */
 extern void unlock_slurmctld (slurmctld_lock_t lock_levels);
 
 extern int report_locks_set(void);
 
+/*
+ * Job record locks
+ *
+ * With SlurmctldParameters=fine_grained_job_locks, the RPCs creating job steps
+ * and completing jobs (REQUEST_JOB_STEP_CREATE,
+ * REQUEST_COMPLETE_JOB_ALLOCATION and REQUEST_COMPLETE_BATCH_SCRIPT) modify
+ * their job beneath the job read lock rather than the job write lock, holding
+ * the lock of the job's record instead. The functions they call check
+ * verify_job_rec_lock() rather than the job write lock:
+ * - step_create() modifies the job's step list, next step ID, time last
+ *   active and the step allocations of its resources and GRES.
+ * - job_complete() and what it calls modify the job's state, times, exit
+ *   code, reason, steps and allocated nodes and TRES, and the task counts
+ *   and exit codes of its job array's meta record, which is locked too.
+ *   They hold the node write lock, so completions run one at a time and not
+ *   along with step creation. Het jobs are completed with the job write lock.
+ * Code reading these fields beneath the job read lock must hold the lock of
+ * the job's record, as pack_job() does. Everything else modifying jobs still
+ * holds the job write lock. Job records are locked in stripes by job ID, the
+ * lock of one job record may be taken more than once by the same thread.
+ * Only completions lock two job records at once.
+ *
+ * Without fine grained job locks lock_job_rec() and unlock_job_rec() do
+ * nothing. The mode only changes beneath the job write lock, so callers must
+ * hold the job read lock at least.
+ */
+
+/* Contention statistics of job record locks, reported by sdiag */
+typedef struct {
+	uint32_t rpc_cnt;	/* RPCs processed beneath the job read lock */
+	uint64_t lock_cnt;	/* job record locks taken */
+	uint64_t wait_cnt;	/* job record locks waited for */
+	uint64_t wait_usec;	/* total time waited for job record locks */
+	uint32_t wait_max_usec;	/* longest time waited for a job record lock */
+} job_rec_lock_stats_t;
+
+/* Set if RPCs modify jobs with job record locks, job write lock needed */
+extern void set_job_rec_locking(bool enable);
+
+/* Return true if fine grained job locks are enabled */
+extern bool job_rec_locking(void);
+
+/* un/lock the record of a job, the job lock must be set */
+extern void lock_job_rec(uint32_t job_id);
+extern void unlock_job_rec(uint32_t job_id);
+
+/*
+ * lock_slurmctld_job - Issue the required lock requests of an RPC modifying
+ *	one job. With fine grained job locks the job write lock is replaced by
+ *	the job read lock and the lock of the job's record.
+ * IN/OUT lock_levels - lock requests with a job write lock, set to the
+ *	locks issued, to be passed to unlock_slurmctld_job()
+ * IN job_id - job to modify
+ */
+extern void lock_slurmctld_job(slurmctld_lock_t *lock_levels, uint32_t job_id);
+extern void lock_slurmctld_job_caller(slurmctld_lock_t *lock_levels,
+				      uint32_t job_id, const char *caller);
+
+/* unlock_slurmctld_job - Release the locks of lock_slurmctld_job() */
+extern void unlock_slurmctld_job(slurmctld_lock_t lock_levels,
+				 uint32_t job_id);
+
+/* Get or reset the contention statistics of job record locks */
+extern void get_job_rec_lock_stats(job_rec_lock_stats_t *stats);
+extern void reset_job_rec_lock_stats(void);
+
 /* un/lock semaphore used for saving state of slurmctld */
 extern void lock_state_files ( void );
 extern void unlock_state_files ( void );
 
+#ifdef LOCK_STATS
+/* Record the wait and hold times of locks by the function locking them */
+#define lock_slurmctld(_l) lock_slurmctld_caller(_l, __func__)
+#define lock_slurmctld_job(_l, _j) lock_slurmctld_job_caller(_l, _j, __func__)
+#endif
+
 #endif
@@ -487,6 +487,7 @@ extern void deallocate_nodes(job_record_t *job_ptr, bool timeout,
 
 	xassert(job_ptr);
 	xassert(job_ptr->details);
+	xassert(verify_job_rec_lock(job_ptr->job_id));
 
 	trace_job(job_ptr, __func__, "");
 
@@ -2707,7 +2708,7 @@ extern int select_nodes(job_record_t *job_ptr, bool test_only,
 		    (job_ptr->state_reason == FAIL_BURST_BUFFER_OP))
 			return ESLURM_BURST_BUFFER_WAIT; /* Fatal BB event */
 		xfree(job_ptr->state_desc);
-		last_job_update = now;
+		job_state_changed(job_ptr, now);
 		if (bb == 0)
 			job_ptr->state_reason = WAIT_BURST_BUFFER_STAGING;
 		else
@@ -2869,7 +2870,7 @@ extern int select_nodes(job_record_t *job_ptr, bool test_only,
 			       __func__, job_ptr);
 			job_ptr->state_reason = WAIT_PART_NODE_LIMIT;
 			xfree(job_ptr->state_desc);
-			last_job_update = now;
+			job_state_changed(job_ptr, now);
 
 		/* Non-fatal errors for job below */
 		} else if (error_code == ESLURM_NODE_NOT_AVAIL) {
@@ -2908,7 +2909,7 @@ extern int select_nodes(job_record_t *job_ptr, bool test_only,
 					   "for other job");
 			}
 			xfree(unavail_node);
-			last_job_update = now;
+			job_state_changed(job_ptr, now);
 		} else if (error_code == ESLURM_RESERVATION_MAINT) {
 			error_code = ESLURM_RESERVATION_BUSY;	/* All reserved */
 			job_ptr->state_reason = WAIT_NODE_NOT_AVAIL;
@@ -2989,7 +2990,7 @@ extern int select_nodes(job_record_t *job_ptr, bool test_only,
 		job_ptr->end_time = 0;
 		job_ptr->priority = 0;
 		job_ptr->state_reason = WAIT_HELD;
-		last_job_update = now;
+		job_state_changed(job_ptr, now);
 		goto cleanup;
 	}
 	if (select_g_job_begin(job_ptr) != SLURM_SUCCESS) {
@@ -3004,7 +3005,7 @@ extern int select_nodes(job_record_t *job_ptr, bool test_only,
 		job_ptr->time_last_active = 0;
 		job_ptr->end_time = 0;
 		job_ptr->state_reason = WAIT_RESOURCES;
-		last_job_update = now;
+		job_state_changed(job_ptr, now);
 		goto cleanup;
 	}
 
@@ -3027,7 +3028,7 @@ extern int select_nodes(job_record_t *job_ptr, bool test_only,
 		job_ptr->time_last_active = 0;
 		job_ptr->end_time = 0;
 		job_ptr->state_reason = WAIT_RESOURCES;
-		last_job_update = now;
+		job_state_changed(job_ptr, now);
 		goto cleanup;
 	}
 
@@ -3055,7 +3056,7 @@ extern int select_nodes(job_record_t *job_ptr, bool test_only,
 			job_ptr->end_time = 0;
 			job_ptr->state_reason = WAIT_RESOURCES;
 			job_ptr->job_state = JOB_PENDING;
-			last_job_update = now;
+			job_state_changed(job_ptr, now);
 			goto cleanup;
 		}
 	}
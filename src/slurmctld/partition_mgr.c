@@ -70,6 +70,7 @@
 #include "src/slurmctld/proc_req.h"
 #include "src/slurmctld/read_config.h"
 #include "src/slurmctld/reservation.h"
+#include "src/slurmctld/sched_queue.h"
 #include "src/slurmctld/slurmctld.h"
 #include "src/slurmctld/state_save.h"
 
@@ -418,12 +419,13 @@ int dump_all_part_state(void)
 {
 	/* Save high-water mark to avoid buffer growth with copies */
 	static int high_buffer_size = BUF_SIZE;
-	int error_code = 0, log_fd;
-	char *old_file, *new_file, *reg_file;
+	int error_code;
 	/* Locks: Read partition */
 	slurmctld_lock_t part_read_lock =
 	    { READ_LOCK, NO_LOCK, NO_LOCK, READ_LOCK, NO_LOCK };
 	Buf buffer = init_buf(high_buffer_size);
+	struct timespec locked;
+	uint64_t lock_usec;
 	DEF_TIMERS;
 
 	START_TIMER;
@@ -434,65 +436,18 @@ int dump_all_part_state(void)
 
 	/* write partition records to buffer */
 	lock_slurmctld(part_read_lock);
+	clock_gettime(CLOCK_MONOTONIC, &locked);
 	list_for_each(part_list, _dump_part_state, buffer);
-
-	old_file = xstrdup(slurmctld_conf.state_save_location);
-	xstrcat(old_file, "/part_state.old");
-	reg_file = xstrdup(slurmctld_conf.state_save_location);
-	xstrcat(reg_file, "/part_state");
-	new_file = xstrdup(slurmctld_conf.state_save_location);
-	xstrcat(new_file, "/part_state.new");
+	lock_usec = state_save_usec_since(&locked);
 	unlock_slurmctld(part_read_lock);
 
-	/* write the buffer to file */
-	lock_state_files();
-	log_fd = creat(new_file, 0600);
-	if (log_fd < 0) {
-		error("Can't save state, error creating file %s, %m",
-		      new_file);
-		error_code = errno;
-	} else {
-		int pos = 0, nwrite = get_buf_offset(buffer), amount, rc;
-		char *data = (char *)get_buf_data(buffer);
-		high_buffer_size = MAX(nwrite, high_buffer_size);
-		while (nwrite > 0) {
-			amount = write(log_fd, &data[pos], nwrite);
-			if ((amount < 0) && (errno != EINTR)) {
-				error("Error writing file %s, %m", new_file);
-				error_code = errno;
-				break;
-			}
-			nwrite -= amount;
-			pos    += amount;
-		}
+	/* queue the buffer to be written to file */
+	high_buffer_size = MAX(get_buf_offset(buffer), high_buffer_size);
+	error_code = state_file_write("part_state", STATE_FILE_BACKUP, buffer,
+				      lock_usec, false);
 
-		rc = fsync_and_close(log_fd, "partition");
-		if (rc && !error_code)
-			error_code = rc;
-	}
-	if (error_code)
-		(void) unlink(new_file);
-	else {			/* file shuffle */
-		(void) unlink(old_file);
-		if (link(reg_file, old_file)) {
-			debug4("unable to create link for %s -> %s: %m",
-			       reg_file, old_file);
-		}
-		(void) unlink(reg_file);
-		if (link(new_file, reg_file)) {
-			debug4("unable to create link for %s -> %s: %m",
-			       new_file, reg_file);
-		}
-		(void) unlink(new_file);
-	}
-	xfree(old_file);
-	xfree(reg_file);
-	xfree(new_file);
-	unlock_state_files();
-
-	free_buf(buffer);
 	END_TIMER2("dump_all_part_state");
-	return 0;
+	return error_code;
 }
 
 /*
@@ -977,6 +932,8 @@ static void _list_delete_part(void *part_entry)
 	int i, j, k;
 
 	part_ptr = (part_record_t *) part_entry;
+	/* The main scheduler's queue is built again on its next run */
+	sched_queue_clear();
 	node_ptr = &node_record_table_ptr[0];
 	for (i = 0; i < node_record_count; i++, node_ptr++) {
 		for (j=0; j<node_ptr->part_cnt; j++) {
@@ -2196,7 +2153,7 @@ extern int part_policy_valid_acct(part_record_t *part_ptr, char *acct,
 				xfree(job_ptr->state_desc);
 				job_ptr->state_desc = tmp_err;
 				job_ptr->state_reason = WAIT_ACCOUNT;
-				last_job_update = time(NULL);
+				job_state_changed(job_ptr, time(NULL));
 			} else {
 				xfree(tmp_err);
 			}
@@ -2220,7 +2177,7 @@ extern int part_policy_valid_acct(part_record_t *part_ptr, char *acct,
 				xfree(job_ptr->state_desc);
 				job_ptr->state_desc = tmp_err;
 				job_ptr->state_reason = WAIT_ACCOUNT;
-				last_job_update = time(NULL);
+				job_state_changed(job_ptr, time(NULL));
 			} else {
 				xfree(tmp_err);
 			}
@@ -2251,7 +2208,7 @@ extern int part_policy_valid_acct(part_record_t *part_ptr, char *acct,
 				xfree(job_ptr->state_desc);
 				job_ptr->state_desc = tmp_err;
 				job_ptr->state_reason = WAIT_ACCOUNT;
-				last_job_update = time(NULL);
+				job_state_changed(job_ptr, time(NULL));
 			} else {
 				xfree(tmp_err);
 			}
@@ -2287,7 +2244,7 @@ extern int part_policy_valid_qos(part_record_t *part_ptr,
 				xfree(job_ptr->state_desc);
 				job_ptr->state_desc = tmp_err;
 				job_ptr->state_reason = WAIT_QOS;
-				last_job_update = time(NULL);
+				job_state_changed(job_ptr, time(NULL));
 			} else {
 				xfree(tmp_err);
 			}
@@ -2306,7 +2263,7 @@ extern int part_policy_valid_qos(part_record_t *part_ptr,
 				xfree(job_ptr->state_desc);
 				job_ptr->state_desc = tmp_err;
 				job_ptr->state_reason = WAIT_QOS;
-				last_job_update = time(NULL);
+				job_state_changed(job_ptr, time(NULL));
 			} else {
 				xfree(tmp_err);
 			}
@@ -2332,7 +2289,7 @@ extern int part_policy_valid_qos(part_record_t *part_ptr,
 				xfree(job_ptr->state_desc);
 				job_ptr->state_desc = tmp_err;
 				job_ptr->state_reason = WAIT_QOS;
-				last_job_update = time(NULL);
+				job_state_changed(job_ptr, time(NULL));
 			} else {
 				xfree(tmp_err);
 			}
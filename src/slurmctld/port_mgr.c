@@ -37,11 +37,13 @@
  *  51 Franklin Street, Fifth Floor, Boston, MA 02110-1301  USA.
 \*****************************************************************************/
 
+#include <pthread.h>
 #include <stdlib.h>
 #include <string.h>
 
 #include "src/common/bitstring.h"
 #include "src/common/hostlist.h"
+#include "src/common/macros.h"
 #include "src/common/xmalloc.h"
 #include "src/common/xstring.h"
 
@@ -54,6 +56,12 @@ int        port_resv_cnt   = 0;
 int        port_resv_min   = 0;
 int        port_resv_max   = 0;
 
+/*
+ * Steps of different jobs may be created and completed at the same time with
+ * fine grained job locks, the table is only configured with the job write lock
+ */
+static pthread_mutex_t port_mutex = PTHREAD_MUTEX_INITIALIZER;
+
 static void _dump_resv_port_info(void);
 static void _make_all_resv(void);
 static void _make_step_resv(step_record_t *step_ptr);
@@ -223,9 +231,6 @@ extern int resv_port_alloc(step_record_t *step_ptr)
 	static int last_port_alloc = 0;
 	static int dims = -1;
 
-	if (dims == -1)
-		dims = slurmdb_setup_cluster_name_dims();
-
 	if (step_ptr->resv_port_cnt > port_resv_cnt) {
 		info("%pS needs %u reserved ports, but only %d exist",
 		     step_ptr, step_ptr->resv_port_cnt, port_resv_cnt);
@@ -235,6 +240,9 @@ extern int resv_port_alloc(step_record_t *step_ptr)
 	/* Identify available ports */
 	port_array = xmalloc(sizeof(int) * step_ptr->resv_port_cnt);
 	port_inx = 0;
+	slurm_mutex_lock(&port_mutex);
+	if (dims == -1)
+		dims = slurmdb_setup_cluster_name_dims();
 	for (i=0; i<port_resv_cnt; i++) {
 		if (++last_port_alloc >= port_resv_cnt)
 			last_port_alloc = 0;
@@ -248,6 +256,7 @@ extern int resv_port_alloc(step_record_t *step_ptr)
 	if (port_inx < step_ptr->resv_port_cnt) {
 		info("insufficient ports for %pS to reserve (%d of %u)",
 		     step_ptr, port_inx, step_ptr->resv_port_cnt);
+		slurm_mutex_unlock(&port_mutex);
 		xfree(port_array);
 		return ESLURM_PORTS_BUSY;
 	}
@@ -261,6 +270,7 @@ extern int resv_port_alloc(step_record_t *step_ptr)
 		snprintf(port_str, sizeof(port_str), "%d", port_array[i]);
 		hostlist_push_host(hl, port_str);
 	}
+	slurm_mutex_unlock(&port_mutex);
 	hostlist_sort(hl);
 	/* get the ranged string with no brackets on it */
 	step_ptr->resv_ports = hostlist_ranged_string_xmalloc_dims(hl, dims, 0);
@@ -282,6 +292,7 @@ extern void resv_port_free(step_record_t *step_ptr)
 	if (step_ptr->resv_port_array == NULL)
 		return;
 
+	slurm_mutex_lock(&port_mutex);
 	for (i=0; i<step_ptr->resv_port_cnt; i++) {
 		if ((step_ptr->resv_port_array[i] < port_resv_min) ||
 		    (step_ptr->resv_port_array[i] > port_resv_max))
@@ -290,6 +301,7 @@ extern void resv_port_free(step_record_t *step_ptr)
 		bit_and_not(port_resv_table[j], step_ptr->step_node_bitmap);
 
 	}
+	slurm_mutex_unlock(&port_mutex);
 	xfree(step_ptr->resv_port_array);
 
 	debug("freed ports %s for %pS",
@@ -331,17 +331,24 @@ extern uint16_t slurm_job_preempt_mode(job_record_t *job_ptr)
 		static const int preempt_modes_cnt = sizeof(preempt_modes) /
 			sizeof(preempt_modes[0]);
 
+		job_record_t *comp_ptr = NULL;
+
 		for (int pm_index = 0; pm_index < preempt_modes_cnt;
 		     pm_index++) {
 			data = preempt_modes[pm_index];
-			if ((job_ptr->job_preempt_comp = list_find_first(
+			if ((comp_ptr = list_find_first(
 				     job_ptr->het_job_list,
 				     _find_job_by_preempt_mode,
 				     &data)))
 				break;
 		}
-		/* if not found look up the mode (CANCEL expected) */
-		if (!job_ptr->job_preempt_comp)
+		/*
+		 * Only set once found, the backfill scheduler may call this
+		 * from several threads (see _park_eval() in backfill.c)
+		 */
+		if (comp_ptr)
+			job_ptr->job_preempt_comp = comp_ptr;
+		else	/* if not found look up the mode (CANCEL expected) */
 			data = _job_preempt_mode_internal(job_ptr);
 	} else
 		data = _job_preempt_mode_internal(job_ptr->job_preempt_comp ?
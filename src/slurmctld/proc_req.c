@@ -91,13 +91,16 @@
 #include "src/slurmctld/front_end.h"
 #include "src/slurmctld/gang.h"
 #include "src/slurmctld/job_scheduler.h"
+#include "src/slurmctld/job_submit.h"
 #include "src/slurmctld/licenses.h"
 #include "src/slurmctld/locks.h"
 #include "src/slurmctld/power_save.h"
 #include "src/slurmctld/powercapping.h"
 #include "src/slurmctld/proc_req.h"
+#include "src/slurmctld/rate_limit.h"
 #include "src/slurmctld/read_config.h"
 #include "src/slurmctld/reservation.h"
+#include "src/slurmctld/resp_cache.h"
 #include "src/slurmctld/sched_plugin.h"
 #include "src/slurmctld/slurmctld.h"
 #include "src/slurmctld/slurmctld_plugstack.h"
@@ -114,6 +117,7 @@ static int rpc_user_size = 0;	/* Size of rpc_user_* arrays */
 static uint32_t *rpc_user_id = NULL;
 static uint32_t *rpc_user_cnt = NULL;
 static uint64_t *rpc_user_time = NULL;
+static uint32_t *rpc_user_limited = NULL;
 
 static config_response_msg_t *config_for_slurmd = NULL;
 static config_response_msg_t *config_for_clients = NULL;
@@ -157,6 +161,7 @@ inline static void  _slurm_rpc_dump_jobs(slurm_msg_t * msg);
 inline static void  _slurm_rpc_dump_jobs_user(slurm_msg_t * msg);
 inline static void  _slurm_rpc_dump_job_single(slurm_msg_t * msg);
 inline static void  _slurm_rpc_dump_licenses(slurm_msg_t * msg);
+inline static void  _slurm_rpc_dump_license_usage(slurm_msg_t *msg);
 inline static void  _slurm_rpc_dump_nodes(slurm_msg_t * msg);
 inline static void  _slurm_rpc_dump_node_single(slurm_msg_t * msg);
 inline static void  _slurm_rpc_dump_partitions(slurm_msg_t * msg);
@@ -210,6 +215,7 @@ inline static void  _slurm_rpc_step_layout(slurm_msg_t * msg);
 inline static void  _slurm_rpc_step_update(slurm_msg_t * msg);
 inline static void  _slurm_rpc_submit_batch_job(slurm_msg_t * msg);
 inline static void  _slurm_rpc_submit_batch_het_job(slurm_msg_t * msg);
+inline static void  _slurm_rpc_submit_batch_jobs(slurm_msg_t * msg);
 inline static void  _slurm_rpc_suspend(slurm_msg_t * msg);
 inline static void  _slurm_rpc_top_job(slurm_msg_t * msg);
 inline static void  _slurm_rpc_trigger_clear(slurm_msg_t * msg);
@@ -257,7 +263,7 @@ void slurmctld_req(slurm_msg_t *msg, connection_arg_t *arg)
 {
 	DEF_TIMERS;
 	int i, rpc_type_index = -1, rpc_user_index = -1;
-	uint32_t rpc_uid;
+	uint32_t rpc_uid, retry_msec = 0;
 
 	if (arg && (arg->newsockfd >= 0))
 		fd_set_nonblocking(arg->newsockfd);
@@ -294,6 +300,7 @@ void slurmctld_req(slurm_msg_t *msg, connection_arg_t *arg)
 		rpc_user_id   = xmalloc(sizeof(uint32_t) * rpc_user_size);
 		rpc_user_cnt  = xmalloc(sizeof(uint32_t) * rpc_user_size);
 		rpc_user_time = xmalloc(sizeof(uint64_t) * rpc_user_size);
+		rpc_user_limited = xmalloc(sizeof(uint32_t) * rpc_user_size);
 	}
 	for (i = 0; i < rpc_user_size; i++) {
 		if ((rpc_user_id[i] == 0) && (i != 0))
@@ -305,6 +312,21 @@ void slurmctld_req(slurm_msg_t *msg, connection_arg_t *arg)
 	}
 	slurm_mutex_unlock(&rpc_mutex);
 
+	/* Requests on persistent connections are not limited */
+	if (!msg->conn &&
+	    rate_limit_exceeded(rpc_uid, msg->msg_type, &retry_msec)) {
+		debug2("%s: rate limited %s from uid %u, retry in %u msec",
+		       __func__, rpc_num2string(msg->msg_type), rpc_uid,
+		       retry_msec);
+		slurm_mutex_lock(&rpc_mutex);
+		if (rpc_user_index >= 0)
+			rpc_user_limited[rpc_user_index]++;
+		slurm_mutex_unlock(&rpc_mutex);
+		slurm_send_rc_backoff_msg(msg, SLURMCTLD_COMMUNICATIONS_BACKOFF,
+					  retry_msec);
+		return;
+	}
+
 	/* Debug the protocol layer.
 	 */
 	START_TIMER;
@@ -443,6 +465,9 @@ void slurmctld_req(slurm_msg_t *msg, connection_arg_t *arg)
 	case REQUEST_SUBMIT_BATCH_HET_JOB:
 		_slurm_rpc_submit_batch_het_job(msg);
 		break;
+	case REQUEST_SUBMIT_BATCH_JOBS:
+		_slurm_rpc_submit_batch_jobs(msg);
+		break;
 	case REQUEST_UPDATE_FRONT_END:
 		_slurm_rpc_update_front_end(msg);
 		break;
@@ -563,6 +588,9 @@ void slurmctld_req(slurm_msg_t *msg, connection_arg_t *arg)
 	case REQUEST_LICENSE_INFO:
 		_slurm_rpc_dump_licenses(msg);
 		break;
+	case REQUEST_LICENSE_USAGE:
+		_slurm_rpc_dump_license_usage(msg);
+		break;
 	case REQUEST_KILL_JOB:
 		_slurm_rpc_kill_job(msg);
 		break;
@@ -1940,24 +1968,26 @@ static void _slurm_rpc_dump_jobs(slurm_msg_t * msg)
 
 	START_TIMER;
 	debug3("Processing RPC: REQUEST_JOB_INFO from uid=%d", uid);
-	lock_slurmctld(job_read_lock);
 
+	/* last_job_update is read without locks, as time_t is written whole */
 	if ((job_info_request_msg->last_update - 1) >= last_job_update) {
-		unlock_slurmctld(job_read_lock);
 		debug3("_slurm_rpc_dump_jobs, no change");
 		slurm_send_rc_msg(msg, SLURM_NO_CHANGE_IN_DATA);
 	} else {
 		if (job_info_request_msg->job_ids) {
+			lock_slurmctld(job_read_lock);
 			pack_spec_jobs(&dump, &dump_size,
 				       job_info_request_msg->job_ids,
 				       job_info_request_msg->show_flags, uid,
 				       NO_VAL, msg->protocol_version);
+			unlock_slurmctld(job_read_lock);
 		} else {
-			pack_all_jobs(&dump, &dump_size,
-				      job_info_request_msg->show_flags, uid,
-				      NO_VAL, msg->protocol_version);
+			/* Served from a snapshot without the job lock */
+			pack_all_jobs_snapshot(&dump, &dump_size,
+					       job_info_request_msg->show_flags,
+					       uid, NO_VAL,
+					       msg->protocol_version);
 		}
-		unlock_slurmctld(job_read_lock);
 		END_TIMER2("_slurm_rpc_dump_jobs");
 #if 0
 		info("_slurm_rpc_dump_jobs, size=%d %s", dump_size, TIME_STR);
@@ -1983,17 +2013,14 @@ static void _slurm_rpc_dump_jobs_user(slurm_msg_t * msg)
 	slurm_msg_t response_msg;
 	job_user_id_msg_t *job_info_request_msg =
 		(job_user_id_msg_t *) msg->data;
-	/* Locks: Read config job part */
-	slurmctld_lock_t job_read_lock = {
-		READ_LOCK, READ_LOCK, NO_LOCK, READ_LOCK, READ_LOCK };
 	uid_t uid = g_slurm_auth_get_uid(msg->auth_cred);
 
 	START_TIMER;
 	debug3("Processing RPC: REQUEST_JOB_USER_INFO from uid=%d", uid);
-	lock_slurmctld(job_read_lock);
-	pack_all_jobs(&dump, &dump_size, job_info_request_msg->show_flags, uid,
-		      job_info_request_msg->user_id, msg->protocol_version);
-	unlock_slurmctld(job_read_lock);
+	pack_all_jobs_snapshot(&dump, &dump_size,
+			       job_info_request_msg->show_flags, uid,
+			       job_info_request_msg->user_id,
+			       msg->protocol_version);
 	END_TIMER2("_slurm_rpc_dump_job_user");
 #if 0
 	info("_slurm_rpc_dump_user_jobs, size=%d %s", dump_size, TIME_STR);
@@ -2209,6 +2236,7 @@ static void _slurm_rpc_dump_nodes(slurm_msg_t * msg)
 	slurmctld_lock_t node_write_lock = {
 		READ_LOCK, NO_LOCK, WRITE_LOCK, READ_LOCK, NO_LOCK };
 	uid_t uid = g_slurm_auth_get_uid(msg->auth_cred);
+	uint32_t vis_class;
 
 	START_TIMER;
 	debug3("Processing RPC: REQUEST_NODE_INFO from uid=%d", uid);
@@ -2223,30 +2251,43 @@ static void _slurm_rpc_dump_nodes(slurm_msg_t * msg)
 
 	lock_slurmctld(node_write_lock);
 
+	/*
+	 * Set the select plugin's node info before any cached response is
+	 * used. It only changes along with last_node_update.
+	 */
 	select_g_select_nodeinfo_set_all();
 
 	if ((node_req_msg->last_update - 1) >= last_node_update) {
 		unlock_slurmctld(node_write_lock);
 		debug3("_slurm_rpc_dump_nodes, no change");
 		slurm_send_rc_msg(msg, SLURM_NO_CHANGE_IN_DATA);
-	} else {
+		return;
+	}
+	vis_class = resp_cache_vis_class(node_req_msg->show_flags, uid);
+	if (!resp_cache_get(RESP_CACHE_NODE, node_req_msg->show_flags,
+			    vis_class, msg->protocol_version,
+			    MAX(last_node_update, last_part_update),
+			    &dump, &dump_size)) {
 		pack_all_node(&dump, &dump_size, node_req_msg->show_flags,
 			      uid, msg->protocol_version);
-		unlock_slurmctld(node_write_lock);
-		END_TIMER2("_slurm_rpc_dump_nodes");
+		resp_cache_add(RESP_CACHE_NODE, node_req_msg->show_flags,
+			       vis_class, msg->protocol_version,
+			       dump, dump_size);
+	}
+	unlock_slurmctld(node_write_lock);
+	END_TIMER2("_slurm_rpc_dump_nodes");
 #if 0
-		info("_slurm_rpc_dump_nodes, size=%d %s", dump_size, TIME_STR);
+	info("_slurm_rpc_dump_nodes, size=%d %s", dump_size, TIME_STR);
 #endif
 
-		response_init(&response_msg, msg);
-		response_msg.msg_type = RESPONSE_NODE_INFO;
-		response_msg.data = dump;
-		response_msg.data_size = dump_size;
+	response_init(&response_msg, msg);
+	response_msg.msg_type = RESPONSE_NODE_INFO;
+	response_msg.data = dump;
+	response_msg.data_size = dump_size;
 
-		/* send message */
-		slurm_send_node_msg(msg->conn_fd, &response_msg);
-		xfree(dump);
-	}
+	/* send message */
+	slurm_send_node_msg(msg->conn_fd, &response_msg);
+	xfree(dump);
 }
 
 /* _slurm_rpc_dump_node_single - done RPC state information for one node */
@@ -2308,6 +2349,7 @@ static void _slurm_rpc_dump_partitions(slurm_msg_t * msg)
 	int dump_size;
 	slurm_msg_t response_msg;
 	part_info_request_msg_t  *part_req_msg;
+	uint32_t vis_class;
 
 	/* Locks: Read configuration and partition */
 	slurmctld_lock_t part_read_lock = {
@@ -2330,8 +2372,17 @@ static void _slurm_rpc_dump_partitions(slurm_msg_t * msg)
 		debug2("_slurm_rpc_dump_partitions, no change");
 		slurm_send_rc_msg(msg, SLURM_NO_CHANGE_IN_DATA);
 	} else {
-		pack_all_part(&dump, &dump_size, part_req_msg->show_flags,
-			      uid, msg->protocol_version);
+		vis_class = resp_cache_vis_class(part_req_msg->show_flags, uid);
+		if (!resp_cache_get(RESP_CACHE_PART, part_req_msg->show_flags,
+				    vis_class, msg->protocol_version,
+				    last_part_update, &dump, &dump_size)) {
+			pack_all_part(&dump, &dump_size,
+				      part_req_msg->show_flags, uid,
+				      msg->protocol_version);
+			resp_cache_add(RESP_CACHE_PART,
+				       part_req_msg->show_flags, vis_class,
+				       msg->protocol_version, dump, dump_size);
+		}
 		unlock_slurmctld(part_read_lock);
 		END_TIMER2("_slurm_rpc_dump_partitions");
 		debug2("_slurm_rpc_dump_partitions, size=%d %s",
@@ -2452,6 +2503,58 @@ static void _slurm_rpc_job_step_kill(uint32_t uid, slurm_msg_t * msg)
 	slurm_send_rc_msg(msg, error_code);
 }
 
+/*
+ * Issue the lock requests of an RPC completing a job. With fine grained job
+ * locks the records of the job and of its job array's meta record are locked
+ * beneath the job read lock, the job write lock is issued for a het job.
+ * IN/OUT lock_levels - lock requests with a job write lock, set to the
+ *	locks issued, to be passed to _unlock_job_complete()
+ * IN job_id - job to complete
+ * RET job ID of the job array meta record locked or NO_VAL
+ */
+static uint32_t _lock_job_complete(slurmctld_lock_t *lock_levels,
+				   uint32_t job_id)
+{
+	job_record_t *job_ptr;
+
+	lock_slurmctld_job(lock_levels, job_id);
+	if ((lock_levels->job != READ_LOCK) ||
+	    !(job_ptr = find_job_record(job_id)))
+		return NO_VAL;
+
+	if (job_ptr->het_job_id) {
+		/* Completing a het job completes all of its components */
+		unlock_slurmctld_job(*lock_levels, job_id);
+		lock_levels->job = WRITE_LOCK;
+		lock_slurmctld(*lock_levels);
+		return NO_VAL;
+	}
+	if ((job_ptr->array_task_id != NO_VAL) &&
+	    (job_ptr->array_job_id != job_id)) {
+		/*
+		 * The meta record counts the completed tasks. Other threads
+		 * lock only one job record at a time, and completions are
+		 * serialized by the node write lock, so this can not deadlock.
+		 */
+		lock_job_rec(job_ptr->array_job_id);
+		return job_ptr->array_job_id;
+	}
+	return NO_VAL;
+}
+
+/* Release the locks of _lock_job_complete() */
+static void _unlock_job_complete(slurmctld_lock_t lock_levels,
+				 uint32_t job_id, uint32_t array_job_id)
+{
+	if (lock_levels.job == READ_LOCK) {
+		if (array_job_id != NO_VAL)
+			unlock_job_rec(array_job_id);
+		unlock_slurmctld_job(lock_levels, job_id);
+	} else {
+		unlock_slurmctld(lock_levels);
+	}
+}
+
 /* _slurm_rpc_complete_job_allocation - process RPC to note the
  *	completion of a job allocation */
 static void _slurm_rpc_complete_job_allocation(slurm_msg_t * msg)
@@ -2466,6 +2569,7 @@ static void _slurm_rpc_complete_job_allocation(slurm_msg_t * msg)
 		NO_LOCK, WRITE_LOCK, WRITE_LOCK, NO_LOCK, READ_LOCK };
 	uid_t uid = g_slurm_auth_get_uid(msg->auth_cred);
 	job_record_t *job_ptr;
+	uint32_t array_job_id;
 
 	/* init */
 	START_TIMER;
@@ -2474,7 +2578,7 @@ static void _slurm_rpc_complete_job_allocation(slurm_msg_t * msg)
 	       uid, comp_msg->job_id, comp_msg->job_rc);
 
 	_throttle_start(&active_rpc_cnt);
-	lock_slurmctld(job_write_lock);
+	array_job_id = _lock_job_complete(&job_write_lock, comp_msg->job_id);
 	job_ptr = find_job_record(comp_msg->job_id);
 	trace_job(job_ptr, __func__, "enter");
 
@@ -2488,7 +2592,7 @@ static void _slurm_rpc_complete_job_allocation(slurm_msg_t * msg)
 		debug2("%s: %pJ %s", __func__, job_ptr, TIME_STR);
 	}
 
-	unlock_slurmctld(job_write_lock);
+	_unlock_job_complete(job_write_lock, comp_msg->job_id, array_job_id);
 	_throttle_fini(&active_rpc_cnt);
 	END_TIMER2("_slurm_rpc_complete_job_allocation");
 
@@ -2566,6 +2670,7 @@ static void _slurm_rpc_complete_batch_script(slurm_msg_t *msg,
 	job_record_t *job_ptr = NULL;
 	char *msg_title = "node(s)";
 	char *nodes = comp_msg->node_name;
+	uint32_t array_job_id = NO_VAL;
 
 	/* init */
 	START_TIMER;
@@ -2583,7 +2688,8 @@ static void _slurm_rpc_complete_batch_script(slurm_msg_t *msg,
 
 	if (!running_composite) {
 		_throttle_start(&active_rpc_cnt);
-		lock_slurmctld(job_write_lock);
+		array_job_id = _lock_job_complete(&job_write_lock,
+						  comp_msg->job_id);
 	}
 
 	job_ptr = find_job_record(comp_msg->job_id);
@@ -2598,7 +2704,8 @@ static void _slurm_rpc_complete_batch_script(slurm_msg_t *msg,
 		      comp_msg->job_id,
 		      comp_msg->node_name, job_ptr->batch_host);
 		if (!running_composite) {
-			unlock_slurmctld(job_write_lock);
+			_unlock_job_complete(job_write_lock, comp_msg->job_id,
+					     array_job_id);
 			_throttle_fini(&active_rpc_cnt);
 		}
 		slurm_send_rc_msg(msg, error_code);
@@ -2716,7 +2823,8 @@ static void _slurm_rpc_complete_batch_script(slurm_msg_t *msg,
 			 comp_msg->job_rc);
 	error_code = MAX(error_code, i);
 	if (!running_composite) {
-		unlock_slurmctld(job_write_lock);
+		_unlock_job_complete(job_write_lock, comp_msg->job_id,
+				     array_job_id);
 		_throttle_fini(&active_rpc_cnt);
 	}
 
@@ -2815,6 +2923,8 @@ static void _slurm_rpc_job_step_create(slurm_msg_t * msg)
 	slurmctld_lock_t job_write_lock = {
 		NO_LOCK, WRITE_LOCK, READ_LOCK, NO_LOCK, NO_LOCK };
 	uid_t uid = g_slurm_auth_get_uid(msg->auth_cred);
+	uint32_t lock_job_id = req_step_msg->job_id;
+	job_record_t *job_ptr;
 
 	START_TIMER;
 	log_flag(STEPS, "Processing RPC: REQUEST_JOB_STEP_CREATE from uid=%d",
@@ -2856,7 +2966,18 @@ static void _slurm_rpc_job_step_create(slurm_msg_t * msg)
 #endif
 
 	_throttle_start(&active_rpc_cnt);
+#if defined HAVE_NATIVE_CRAY
 	lock_slurmctld(job_write_lock);
+#else
+	lock_slurmctld_job(&job_write_lock, lock_job_id);
+	if ((job_write_lock.job == READ_LOCK) &&
+	    (job_ptr = find_job_record(lock_job_id)) && job_ptr->het_job_id) {
+		/* Steps of a het job component modify the other components */
+		unlock_slurmctld_job(job_write_lock, lock_job_id);
+		job_write_lock.job = WRITE_LOCK;
+		lock_slurmctld(job_write_lock);
+	}
+#endif
 
 	error_code = step_create(req_step_msg, &step_rec,
 				 msg->protocol_version);
@@ -2870,7 +2991,7 @@ static void _slurm_rpc_job_step_create(slurm_msg_t * msg)
 
 	/* return result */
 	if (error_code) {
-		unlock_slurmctld(job_write_lock);
+		unlock_slurmctld_job(job_write_lock, lock_job_id);
 		_throttle_fini(&active_rpc_cnt);
 		if (slurmctld_conf.debug_flags & DEBUG_FLAG_STEPS) {
 			if ((error_code == ESLURM_PROLOG_RUNNING) ||
@@ -2915,7 +3036,7 @@ static void _slurm_rpc_job_step_create(slurm_msg_t * msg)
 		job_step_resp.select_jobinfo = step_rec->select_jobinfo;
 		job_step_resp.switch_job     = step_rec->switch_job;
 
-		unlock_slurmctld(job_write_lock);
+		unlock_slurmctld_job(job_write_lock, lock_job_id);
 		_throttle_fini(&active_rpc_cnt);
 		response_init(&resp, msg);
 		resp.msg_type = RESPONSE_JOB_STEP_CREATE;
@@ -3506,6 +3627,9 @@ static void _slurm_rpc_job_sbcast_cred(slurm_msg_t * msg)
 
 	if ((error_code == SLURM_SUCCESS) && job_ptr
 	    && (job_info_msg->step_id != NO_VAL)) {
+		uint32_t lock_job_id = job_ptr->job_id;
+		/* Steps may be created or completed beneath the read lock */
+		lock_job_rec(lock_job_id);
 		step_ptr = find_step_record(job_ptr, job_info_msg->step_id);
 		if (!step_ptr) {
 			job_ptr = NULL;
@@ -3514,7 +3638,9 @@ static void _slurm_rpc_job_sbcast_cred(slurm_msg_t * msg)
 			   (step_ptr->step_layout->node_cnt !=
 			    job_ptr->node_cnt)) {
 			node_cnt  = step_ptr->step_layout->node_cnt;
-			node_list = step_ptr->step_layout->node_list;
+			local_node_list =
+				xstrdup(step_ptr->step_layout->node_list);
+			node_list = local_node_list;
 			if ((host_list = hostlist_create(node_list)) == NULL) {
 				fatal("hostlist_create error for %s: %m",
 				      node_list);
@@ -3535,6 +3661,7 @@ static void _slurm_rpc_job_sbcast_cred(slurm_msg_t * msg)
 			}
 			hostlist_destroy(host_list);
 		}
+		unlock_job_rec(lock_job_id);
 	}
 	if ((error_code == SLURM_SUCCESS) && job_ptr && !node_addr) {
 		node_addr = job_ptr->node_addr;
@@ -3965,8 +4092,11 @@ static void _slurm_rpc_step_layout(slurm_msg_t *msg)
 		return;
 	}
 
+	/* Steps may be created or completed beneath the read lock */
+	lock_job_rec(job_ptr->job_id);
 	step_ptr = find_step_record(job_ptr, req->step_id);
 	if (!step_ptr) {
+		unlock_job_rec(job_ptr->job_id);
 		unlock_slurmctld(job_read_lock);
 		if (slurmctld_conf.debug_flags & DEBUG_FLAG_STEPS)
 			info("%s: %pJ StepId=%u Not Found",
@@ -3975,6 +4105,7 @@ static void _slurm_rpc_step_layout(slurm_msg_t *msg)
 		return;
 	}
 	step_layout = slurm_step_layout_copy(step_ptr->step_layout);
+	unlock_job_rec(job_ptr->job_id);
 #ifdef HAVE_FRONT_END
 	if (job_ptr->batch_host)
 		step_layout->front_end = xstrdup(job_ptr->batch_host);
@@ -4459,6 +4590,169 @@ send_msg:
 	xfree(job_submit_user_msg);
 }
 
+/*
+ * _slurm_rpc_submit_batch_jobs - process RPC to submit many independent batch
+ *	jobs at once. All jobs are validated under one read lock, with the job
+ *	submit plugins aware of the whole batch, and created under one write
+ *	lock. Each job is accepted or rejected on its own.
+ */
+static void _slurm_rpc_submit_batch_jobs(slurm_msg_t *msg)
+{
+	static int active_rpc_cnt = 0;
+	ListIterator iter;
+	int error_code = SLURM_SUCCESS;
+	DEF_TIMERS;
+	uint32_t job_inx, job_cnt = 0, accept_cnt = 0;
+	job_record_t *job_ptr;
+	slurm_msg_t response_msg;
+	submit_batch_response_msg_t submit_msg;
+	job_desc_msg_t *job_desc_msg;
+	/* Locks: Read config, read job, read node, read partition */
+	slurmctld_lock_t job_read_lock = {
+		READ_LOCK, READ_LOCK, READ_LOCK, READ_LOCK, NO_LOCK };
+	/* Locks: Read config, write job, write node, read partition, read fed */
+	slurmctld_lock_t job_write_lock = {
+		READ_LOCK, WRITE_LOCK, WRITE_LOCK, READ_LOCK, READ_LOCK };
+	List job_req_list = (List) msg->data;
+	uid_t uid = g_slurm_auth_get_uid(msg->auth_cred);
+	gid_t gid = g_slurm_auth_get_gid(msg->auth_cred);
+	char *err_msg = NULL, *job_submit_user_msg = NULL;
+
+	START_TIMER;
+	debug2("Processing RPC: REQUEST_SUBMIT_BATCH_JOBS from uid=%d", uid);
+	memset(&submit_msg, 0, sizeof(submit_msg));
+	if (job_req_list)
+		job_cnt = list_count(job_req_list);
+	if (job_cnt == 0) {
+		info("REQUEST_SUBMIT_BATCH_JOBS from uid=%d with empty job list",
+		     uid);
+		error_code = SLURM_ERROR;
+		goto send_msg;
+	}
+	if (slurmctld_config.submissions_disabled) {
+		info("Submissions disabled on system");
+		error_code = ESLURM_SUBMISSIONS_DISABLED;
+		goto send_msg;
+	}
+	if (fed_mgr_fed_rec) {
+		/* Sibling jobs are submitted one by one */
+		error_code = ESLURM_NOT_SUPPORTED;
+		goto send_msg;
+	}
+
+	submit_msg.job_cnt = job_cnt;
+	submit_msg.job_id = xcalloc(job_cnt, sizeof(uint32_t));
+	submit_msg.error_code = xcalloc(job_cnt, sizeof(uint32_t));
+
+	/* Validate the individual requests */
+	lock_slurmctld(job_read_lock);     /* Locks for job_submit plugin use */
+	job_submit_plugin_batch_begin(job_req_list, uid);
+	job_inx = 0;
+	iter = list_iterator_create(job_req_list);
+	while ((job_desc_msg = list_next(iter))) {
+		if ((error_code = _valid_id("REQUEST_SUBMIT_BATCH_JOBS",
+					    job_desc_msg, uid, gid)))
+			goto next_validate;
+
+		_set_hostname(msg, job_desc_msg);
+
+		if ((job_desc_msg->alloc_node == NULL) ||
+		    (job_desc_msg->alloc_node[0] == '\0')) {
+			error("REQUEST_SUBMIT_BATCH_JOBS lacks alloc_node from uid=%d",
+			      uid);
+			error_code = ESLURM_INVALID_NODE_NAME;
+			goto next_validate;
+		}
+
+		dump_job_desc(job_desc_msg);
+
+		job_desc_msg->het_job_offset = NO_VAL;
+		error_code = validate_job_create_req(job_desc_msg, uid,
+						     &err_msg);
+		if (err_msg) {
+			char *save_ptr = NULL, *tok;
+			tok = strtok_r(err_msg, "\n", &save_ptr);
+			while (tok) {
+				char *sep = "";
+				if (job_submit_user_msg)
+					sep = "\n";
+				xstrfmtcat(job_submit_user_msg, "%s%u: %s",
+					   sep, job_inx, tok);
+				tok = strtok_r(NULL, "\n", &save_ptr);
+			}
+			xfree(err_msg);
+		}
+next_validate:
+		submit_msg.error_code[job_inx++] = error_code;
+	}
+	list_iterator_destroy(iter);
+	job_submit_plugin_batch_end();
+	unlock_slurmctld(job_read_lock);
+
+	/* Create new job allocations */
+	_throttle_start(&active_rpc_cnt);
+	lock_slurmctld(job_write_lock);
+	START_TIMER;	/* Restart after we have locks */
+	job_inx = 0;
+	iter = list_iterator_create(job_req_list);
+	while ((job_desc_msg = list_next(iter))) {
+		if (submit_msg.error_code[job_inx] != SLURM_SUCCESS) {
+			job_inx++;
+			continue;
+		}
+		job_ptr = NULL;
+		job_desc_msg->het_job_offset = NO_VAL;
+		error_code = job_allocate(job_desc_msg,
+					  job_desc_msg->immediate,
+					  false, NULL, 0, uid, &job_ptr,
+					  &err_msg, msg->protocol_version);
+		if (job_desc_msg->immediate && (error_code != SLURM_SUCCESS))
+			error_code = ESLURM_CAN_NOT_START_IMMEDIATELY;
+		else if (job_ptr &&
+			 (!error_code || (job_ptr->job_state != JOB_FAILED))) {
+			submit_msg.job_id[job_inx] = job_ptr->job_id;
+			accept_cnt++;
+		}
+		submit_msg.error_code[job_inx] = error_code;
+		if (err_msg) {
+			xstrfmtcat(job_submit_user_msg, "%s%u: %s",
+				   job_submit_user_msg ? "\n" : "", job_inx,
+				   err_msg);
+			xfree(err_msg);
+		}
+		job_inx++;
+	}
+	list_iterator_destroy(iter);
+	unlock_slurmctld(job_write_lock);
+	_throttle_fini(&active_rpc_cnt);
+	error_code = SLURM_SUCCESS;
+
+send_msg:
+	END_TIMER2("_slurm_rpc_submit_batch_jobs");
+	if (error_code) {
+		info("%s: %s", __func__, slurm_strerror(error_code));
+		slurm_send_rc_msg(msg, error_code);
+	} else {
+		info("%s: %u of %u jobs submitted %s",
+		     __func__, accept_cnt, job_cnt, TIME_STR);
+		submit_msg.job_submit_user_msg = job_submit_user_msg;
+		response_init(&response_msg, msg);
+		response_msg.msg_type = RESPONSE_SUBMIT_BATCH_JOBS;
+		response_msg.data = &submit_msg;
+		slurm_send_node_msg(msg->conn_fd, &response_msg);
+
+		if (accept_cnt) {
+			/* One state save for the whole batch */
+			schedule_job_save();	/* Has own locks */
+			schedule_node_save();	/* Has own locks */
+			queue_job_scheduler();
+		}
+	}
+	xfree(submit_msg.job_id);
+	xfree(submit_msg.error_code);
+	xfree(job_submit_user_msg);
+}
+
 /* _slurm_rpc_update_job - process RPC to update the configuration of a
  * job (e.g. priority)
  */
@@ -6059,6 +6353,7 @@ static void _clear_rpc_stats(void)
 		rpc_user_cnt[i] = 0;
 		rpc_user_id[i] = 0;
 		rpc_user_time[i] = 0;
+		rpc_user_limited[i] = 0;
 	}
 	slurm_mutex_unlock(&rpc_mutex);
 }
@@ -6091,6 +6386,8 @@ static void _pack_rpc_stats(int resp, char **buffer_ptr, int *buffer_size,
 		pack32_array(rpc_user_id,   i, buffer);
 		pack32_array(rpc_user_cnt,  i, buffer);
 		pack64_array(rpc_user_time, i, buffer);
+		if (protocol_version >= SLURM_20_02_VISIONS_PROTOCOL_VERSION)
+			pack32_array(rpc_user_limited, i, buffer);
 
 		agent_pack_pending_rpc_stats(buffer);
 
@@ -6207,6 +6504,68 @@ _slurm_rpc_dump_licenses(slurm_msg_t * msg)
 	xfree(dump);
 }
 
+/* _slurm_rpc_dump_license_usage()
+ *
+ * Pack the usage of all licenses, including license group members in use
+ * and reserved, and send it back to the library.
+ */
+inline static void _slurm_rpc_dump_license_usage(slurm_msg_t *msg)
+{
+	DEF_TIMERS;
+	char *dump;
+	int dump_size;
+	time_t last_update, now = time(NULL);
+	slurm_msg_t response_msg;
+	license_info_request_msg_t *lic_req_msg;
+	slurmctld_resv_t *resv_ptr;
+	ListIterator iter;
+	/* Locks: Read node (reservations) */
+	slurmctld_lock_t node_read_lock = {
+		NO_LOCK, NO_LOCK, READ_LOCK, NO_LOCK, NO_LOCK };
+	uid_t uid = g_slurm_auth_get_uid(msg->auth_cred);
+
+	START_TIMER;
+	debug2("%s: Processing RPC: REQUEST_LICENSE_USAGE uid=%d",
+	       __func__, uid);
+	lic_req_msg = (license_info_request_msg_t *)msg->data;
+
+	lock_slurmctld(node_read_lock);
+	last_update = MAX(last_license_update, last_resv_update);
+	/* Reservations starting or ending change the reserved licenses */
+	iter = list_iterator_create(resv_list);
+	while ((resv_ptr = list_next(iter))) {
+		if (!resv_ptr->license_list)
+			continue;
+		if ((resv_ptr->start_time <= now) &&
+		    (resv_ptr->start_time > last_update))
+			last_update = resv_ptr->start_time;
+		if ((resv_ptr->end_time <= now) &&
+		    (resv_ptr->end_time > last_update))
+			last_update = resv_ptr->end_time;
+	}
+	list_iterator_destroy(iter);
+	if ((lic_req_msg->last_update - 1) >= last_update) {
+		unlock_slurmctld(node_read_lock);
+		debug2("%s: no change SLURM_NO_CHANGE_IN_DATA", __func__);
+		slurm_send_rc_msg(msg, SLURM_NO_CHANGE_IN_DATA);
+		return;
+	}
+	get_all_license_usage(&dump, &dump_size, resv_list, last_update,
+			      msg->protocol_version);
+	unlock_slurmctld(node_read_lock);
+
+	END_TIMER2("_slurm_rpc_dump_license_usage");
+	debug2("%s: size=%d %s", __func__, dump_size, TIME_STR);
+
+	response_init(&response_msg, msg);
+	response_msg.msg_type = RESPONSE_LICENSE_USAGE;
+	response_msg.data = dump;
+	response_msg.data_size = dump_size;
+
+	slurm_send_node_msg(msg->conn_fd, &response_msg);
+	xfree(dump);
+}
+
 /* Free memory used to track RPC usage by type and user */
 extern void free_rpc_stats(void)
 {
@@ -6219,6 +6578,7 @@ extern void free_rpc_stats(void)
 	xfree(rpc_user_cnt);
 	xfree(rpc_user_id);
 	xfree(rpc_user_time);
+	xfree(rpc_user_limited);
 	rpc_user_size = 0;
 	slurm_mutex_unlock(&rpc_mutex);
 }
@@ -0,0 +1,223 @@
+/*****************************************************************************\
+ *  rate_limit.c - Limit the rate of RPCs by user
+ *
+ *  Token buckets are kept in a table indexed by a hash of the user ID. A
+ *  user is looked for in a few consecutive slots. If all of them hold other
+ *  users, the one used least recently is taken over along with its buckets,
+ *  so memory use is fixed no matter how many users send RPCs and users
+ *  sharing a slot can not send more than one user could. Tokens are
+ *  counted in thousandths so that refill rates below one token per
+ *  millisecond refill a bucket gradually.
+ *
+ *  This file has been developed by staff and students
+ *  of Heidelberg University as part of the research carried out by the
+ *  Electronic Vision(s) group at the Kirchhoff-Institute for Physics.
+ *  The research is funded by Heidelberg University, the State of
+ *  Baden-Württemberg, the Seventh Framework Programme under grant agreements
+ *  no 604102 (HBP) as well as the Horizon 2020 Framework Programme under grant
+ *  agreement 720270 (HBP).
+\*****************************************************************************/
+
+#include "config.h"
+
+#include <pthread.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+
+#include "src/common/log.h"
+#include "src/common/macros.h"
+#include "src/common/slurm_protocol_defs.h"
+#include "src/common/xmalloc.h"
+#include "src/common/xstring.h"
+#include "src/slurmctld/rate_limit.h"
+#include "src/slurmctld/rpc_pool.h"
+#include "src/slurmctld/slurmctld.h"
+
+#define RL_TBL_BITS		13	/* 8192 users */
+#define RL_PROBE_CNT		4	/* slots searched for a user */
+#define RL_BUCKET_SIZE_DEFAULT	30	/* tokens */
+#define RL_REFILL_RATE_DEFAULT	2	/* tokens per second */
+#define RL_MILLI		1000	/* token fractions counted */
+
+typedef struct {
+	uint32_t bucket_size;		/* tokens, 0 if not limited */
+	uint32_t refill_rate;		/* tokens per second */
+	const char *size_param;		/* SlurmctldParameters overrides */
+	const char *rate_param;
+} rl_class_t;
+
+typedef struct {
+	uint32_t uid;
+	bool used;
+	uint64_t used_msec;		/* last RPC, CLOCK_MONOTONIC */
+	uint64_t tokens[RPC_CLASS_CNT];	/* thousandths of a token */
+	uint64_t last_msec[RPC_CLASS_CNT]; /* last refill, CLOCK_MONOTONIC */
+} rl_ent_t;
+
+static pthread_mutex_t rl_mutex = PTHREAD_MUTEX_INITIALIZER;
+static bool rl_enabled = false;
+static rl_ent_t *rl_tbl = NULL;
+static rl_class_t rl_class[RPC_CLASS_CNT] = {
+	[RPC_CLASS_USER] = { .size_param = "rl_user_bucket_size=",
+			     .rate_param = "rl_user_refill_rate=" },
+	[RPC_CLASS_QUERY] = { .size_param = "rl_query_bucket_size=",
+			      .rate_param = "rl_query_refill_rate=" },
+};
+
+static uint64_t _now_msec(void)
+{
+	struct timespec now;
+
+	clock_gettime(CLOCK_MONOTONIC, &now);
+	return ((uint64_t) now.tv_sec * MSEC_IN_SEC) +
+	       (now.tv_nsec / NSEC_IN_MSEC);
+}
+
+/* Return the value of a SlurmctldParameters option, or def if not set */
+static uint32_t _get_param(const char *param, uint32_t def)
+{
+	char *tmp_ptr;
+	int val;
+
+	if (!(tmp_ptr = xstrcasestr(slurmctld_conf.slurmctld_params, param)))
+		return def;
+	val = atoi(tmp_ptr + strlen(param));
+	if (val < 0) {
+		error("Invalid SlurmctldParameters %s%d, using %u",
+		      param, val, def);
+		return def;
+	}
+	return val;
+}
+
+extern void rate_limit_reconfig(void)
+{
+	uint32_t bucket_size, refill_rate;
+	int i;
+
+	slurm_mutex_lock(&rl_mutex);
+	rl_enabled = xstrcasestr(slurmctld_conf.slurmctld_params,
+				 "rl_enable");
+	bucket_size = _get_param("rl_bucket_size=", RL_BUCKET_SIZE_DEFAULT);
+	refill_rate = _get_param("rl_refill_rate=", RL_REFILL_RATE_DEFAULT);
+	for (i = 0; i < RPC_CLASS_CNT; i++) {
+		if (i == RPC_CLASS_SYSTEM)
+			continue;
+		rl_class[i].bucket_size = _get_param(rl_class[i].size_param,
+						     bucket_size);
+		rl_class[i].refill_rate = _get_param(rl_class[i].rate_param,
+						     refill_rate);
+		if (rl_class[i].bucket_size && !rl_class[i].refill_rate) {
+			error("Invalid SlurmctldParameters %s0, using %u",
+			      rl_class[i].rate_param, RL_REFILL_RATE_DEFAULT);
+			rl_class[i].refill_rate = RL_REFILL_RATE_DEFAULT;
+		}
+	}
+	if (rl_enabled && !rl_tbl)
+		rl_tbl = xcalloc((1 << RL_TBL_BITS), sizeof(rl_ent_t));
+	else if (!rl_enabled)
+		xfree(rl_tbl);
+	slurm_mutex_unlock(&rl_mutex);
+
+	if (rl_enabled)
+		debug("%s: user requests %u tokens refilled at %u/sec, queries %u tokens refilled at %u/sec",
+		      __func__, rl_class[RPC_CLASS_USER].bucket_size,
+		      rl_class[RPC_CLASS_USER].refill_rate,
+		      rl_class[RPC_CLASS_QUERY].bucket_size,
+		      rl_class[RPC_CLASS_QUERY].refill_rate);
+}
+
+extern void rate_limit_fini(void)
+{
+	slurm_mutex_lock(&rl_mutex);
+	rl_enabled = false;
+	xfree(rl_tbl);
+	slurm_mutex_unlock(&rl_mutex);
+}
+
+/*
+ * Find the slot of a user. A new user gets a free slot or else takes over the
+ * slot used least recently, either way with full buckets.
+ */
+static rl_ent_t *_find_ent(uint32_t uid, uint64_t now)
+{
+	rl_ent_t *ent, *free_ent = NULL, *old_ent = NULL;
+	uint32_t inx;
+	int i;
+
+	inx = (uint32_t) (uid * 0x9e3779b9U) >> (32 - RL_TBL_BITS);
+	for (i = 0; i < RL_PROBE_CNT; i++) {
+		ent = &rl_tbl[(inx + i) & ((1 << RL_TBL_BITS) - 1)];
+		if (!ent->used) {
+			if (!free_ent)
+				free_ent = ent;
+		} else if (ent->uid == uid) {
+			return ent;
+		} else if (!old_ent || (ent->used_msec < old_ent->used_msec)) {
+			old_ent = ent;
+		}
+	}
+
+	/* Tokens left by the evicted user must not throttle the new one */
+	if (!free_ent)
+		free_ent = old_ent;
+
+	free_ent->uid = uid;
+	free_ent->used = true;
+	for (i = 0; i < RPC_CLASS_CNT; i++) {
+		free_ent->tokens[i] = (uint64_t) rl_class[i].bucket_size *
+				      RL_MILLI;
+		free_ent->last_msec[i] = now;
+	}
+	return free_ent;
+}
+
+extern bool rate_limit_exceeded(uint32_t uid, uint16_t msg_type,
+				uint32_t *retry_msec)
+{
+	rpc_class_t class;
+	rl_class_t *limit;
+	rl_ent_t *ent;
+	uint64_t now, max_tokens;
+	bool exceeded = false;
+
+	if (!rl_enabled)
+		return false;
+	if ((uid == 0) || (uid == slurmctld_conf.slurm_user_id))
+		return false;
+	class = rpc_pool_class(msg_type);
+	if (class == RPC_CLASS_SYSTEM)
+		return false;
+
+	slurm_mutex_lock(&rl_mutex);
+	limit = &rl_class[class];
+	if (!rl_tbl || !limit->bucket_size) {
+		slurm_mutex_unlock(&rl_mutex);
+		return false;
+	}
+
+	now = _now_msec();
+	ent = _find_ent(uid, now);
+	ent->used_msec = now;
+
+	/* A refill rate of 1 token per second is 1 thousandth per msec */
+	max_tokens = (uint64_t) limit->bucket_size * RL_MILLI;
+	if (now > ent->last_msec[class]) {
+		ent->tokens[class] += (now - ent->last_msec[class]) *
+				      limit->refill_rate;
+		ent->last_msec[class] = now;
+	}
+	ent->tokens[class] = MIN(ent->tokens[class], max_tokens);
+
+	if (ent->tokens[class] >= RL_MILLI) {
+		ent->tokens[class] -= RL_MILLI;
+	} else {
+		exceeded = true;
+		*retry_msec = ((RL_MILLI - ent->tokens[class]) +
+			       limit->refill_rate - 1) / limit->refill_rate;
+	}
+	slurm_mutex_unlock(&rl_mutex);
+
+	return exceeded;
+}
@@ -0,0 +1,43 @@
+/*****************************************************************************\
+ *  rate_limit.h - Limit the rate of RPCs by user
+ *
+ *  This file has been developed by staff and students
+ *  of Heidelberg University as part of the research carried out by the
+ *  Electronic Vision(s) group at the Kirchhoff-Institute for Physics.
+ *  The research is funded by Heidelberg University, the State of
+ *  Baden-Württemberg, the Seventh Framework Programme under grant agreements
+ *  no 604102 (HBP) as well as the Horizon 2020 Framework Programme under grant
+ *  agreement 720270 (HBP).
+\*****************************************************************************/
+
+#ifndef _SLURMCTLD_RATE_LIMIT_H
+#define _SLURMCTLD_RATE_LIMIT_H
+
+#include <stdbool.h>
+#include <stdint.h>
+
+/*
+ * Each user has a bucket of tokens for user requests and one for queries,
+ * refilled at a fixed rate up to the bucket size. Each RPC takes a token,
+ * an RPC finding its bucket empty is rejected and the client told when to
+ * retry. System messages, root and SlurmUser are never limited.
+ */
+
+/* Read the limits from SlurmctldParameters, called with the configuration
+ * write lock */
+extern void rate_limit_reconfig(void);
+
+/* Free the buckets of all users */
+extern void rate_limit_fini(void);
+
+/*
+ * rate_limit_exceeded - Take a token from the bucket of a user
+ * IN uid - user sending the RPC
+ * IN msg_type - type of the RPC, its class selects the bucket
+ * OUT retry_msec - if limited, time until the next token is available
+ * RET true if the bucket was empty and the RPC must be rejected
+ */
+extern bool rate_limit_exceeded(uint32_t uid, uint16_t msg_type,
+				uint32_t *retry_msec);
+
+#endif /* !_SLURMCTLD_RATE_LIMIT_H */
@@ -86,8 +86,10 @@
 #include "src/slurmctld/port_mgr.h"
 #include "src/slurmctld/preempt.h"
 #include "src/slurmctld/proc_req.h"
+#include "src/slurmctld/rate_limit.h"
 #include "src/slurmctld/read_config.h"
 #include "src/slurmctld/reservation.h"
+#include "src/slurmctld/rpc_pool.h"
 #include "src/slurmctld/sched_plugin.h"
 #include "src/slurmctld/slurmctld.h"
 #include "src/slurmctld/srun_comm.h"
@@ -1282,6 +1284,10 @@ int read_slurm_conf(int recover, bool reconfig)
 	cpu_freq_reconfig();
 
 	rehash_jobs();
+	set_job_rec_locking(xstrcasestr(slurmctld_conf.slurmctld_params,
+					"fine_grained_job_locks"));
+	rpc_pool_reconfig();
+	rate_limit_reconfig();
 	_set_slurmd_addr();
 
 	_stat_slurm_dirs();
@@ -2820,8 +2826,10 @@ static void _acct_restore_active_jobs(void)
 			if (!with_slurmdbd)
 				jobacct_storage_g_job_start(
 					acct_db_conn, job_ptr);
-			else if (job_ptr->db_index != NO_VAL64)
+			else if (job_ptr->db_index != NO_VAL64) {
 				job_ptr->db_index = 0;
+				job_state_changed(job_ptr, time(NULL));
+			}
 			step_iterator = list_iterator_create(
 				job_ptr->step_list);
 			while ((step_ptr = list_next(step_iterator))) {
@@ -3188,12 +3188,13 @@ extern int dump_all_resv_state(void)
 {
 	ListIterator iter;
 	slurmctld_resv_t *resv_ptr;
-	int error_code = 0, log_fd;
-	char *old_file, *new_file, *reg_file;
+	int error_code;
 	/* Locks: Read node */
 	slurmctld_lock_t resv_read_lock =
 	    { READ_LOCK, NO_LOCK, READ_LOCK, NO_LOCK, NO_LOCK };
 	Buf buffer = init_buf(BUF_SIZE);
+	struct timespec locked;
+	uint64_t lock_usec;
 	DEF_TIMERS;
 
 	START_TIMER;
@@ -3207,65 +3208,20 @@ extern int dump_all_resv_state(void)
 
 	/* write reservation records to buffer */
 	lock_slurmctld(resv_read_lock);
+	clock_gettime(CLOCK_MONOTONIC, &locked);
 	iter = list_iterator_create(resv_list);
 	while ((resv_ptr = list_next(iter)))
 		_pack_resv(resv_ptr, buffer, true, SLURM_PROTOCOL_VERSION);
 	list_iterator_destroy(iter);
-
-	old_file = xstrdup(slurmctld_conf.state_save_location);
-	xstrcat(old_file, "/resv_state.old");
-	reg_file = xstrdup(slurmctld_conf.state_save_location);
-	xstrcat(reg_file, "/resv_state");
-	new_file = xstrdup(slurmctld_conf.state_save_location);
-	xstrcat(new_file, "/resv_state.new");
+	lock_usec = state_save_usec_since(&locked);
 	unlock_slurmctld(resv_read_lock);
 
-	/* write the buffer to file */
-	lock_state_files();
-	log_fd = creat(new_file, 0600);
-	if (log_fd < 0) {
-		error("Can't save state, error creating file %s, %m",
-		      new_file);
-		error_code = errno;
-	} else {
-		int pos = 0, nwrite = get_buf_offset(buffer), amount, rc;
-		char *data = (char *)get_buf_data(buffer);
-
-		while (nwrite > 0) {
-			amount = write(log_fd, &data[pos], nwrite);
-			if ((amount < 0) && (errno != EINTR)) {
-				error("Error writing file %s, %m", new_file);
-				error_code = errno;
-				break;
-			}
-			nwrite -= amount;
-			pos    += amount;
-		}
-		rc = fsync_and_close(log_fd, "reservation");
-		if (rc && !error_code)
-			error_code = rc;
-	}
-	if (error_code)
-		(void) unlink(new_file);
-	else {			/* file shuffle */
-		(void) unlink(old_file);
-		if (link(reg_file, old_file))
-			debug4("unable to create link for %s -> %s: %m",
-			       reg_file, old_file);
-		(void) unlink(reg_file);
-		if (link(new_file, reg_file))
-			debug4("unable to create link for %s -> %s: %m",
-			       new_file, reg_file);
-		(void) unlink(new_file);
-	}
-	xfree(old_file);
-	xfree(reg_file);
-	xfree(new_file);
-	unlock_state_files();
+	/* queue the buffer to be written to file */
+	error_code = state_file_write("resv_state", STATE_FILE_BACKUP, buffer,
+				      lock_usec, false);
 
-	free_buf(buffer);
 	END_TIMER2("dump_all_resv_state");
-	return 0;
+	return error_code;
 }
 
 /* Validate one reservation record, return true if good */
@@ -4804,10 +4760,12 @@ extern burst_buffer_info_msg_t *job_test_bb_resv(job_record_t *job_ptr,
  * IN lic_name  - name of license
  * IN when      - when the job is expected to start
  * IN reboot    - true if node reboot required to start job
+ * IN/OUT resv_bits - if not NULL, the members of license group lic_name
+ *		  held by these reservations are set, sized like the group
  * RET number of licenses of this type the job is prevented from using
  */
 extern int job_test_lic_resv(job_record_t *job_ptr, char *lic_name,
-			     time_t when, bool reboot)
+			     time_t when, bool reboot, bitstr_t *resv_bits)
 {
 	slurmctld_resv_t * resv_ptr;
 	time_t job_start_time, job_end_time, now = time(NULL);
@@ -4837,6 +4795,9 @@ extern int job_test_lic_resv(job_record_t *job_ptr, char *lic_name,
 			continue;	/* job can use this reservation */
 
 		resv_cnt += _license_cnt(resv_ptr->license_list, lic_name);
+		if (resv_bits)
+			license_list_group_bits(resv_ptr->license_list,
+						lic_name, resv_bits);
 	}
 	list_iterator_destroy(iter);
 
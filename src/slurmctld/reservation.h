@@ -133,10 +133,12 @@ extern burst_buffer_info_msg_t *job_test_bb_resv(job_record_t *job_ptr,
  * IN lic_name  - name of license
  * IN when      - when the job is expected to start
  * IN reboot    - true if node reboot required to start job
+ * IN/OUT resv_bits - if not NULL, the members of license group lic_name
+ *		  held by these reservations are set, sized like the group
  * RET number of licenses of this type the job is prevented from using
  */
 extern int job_test_lic_resv(job_record_t *job_ptr, char *lic_name,
-			     time_t when, bool reboot);
+			     time_t when, bool reboot, bitstr_t *resv_bits);
 
 /*
  * Determine how many watts the specified job is prevented from using
@@ -0,0 +1,204 @@
+/*****************************************************************************\
+ *  resp_cache.c - Cache of packed node and partition info responses
+ *
+ *  Clients polling the controller often request the same node or partition
+ *  information within the same second. The packed responses are cached by
+ *  request and reused until the records they hold change. Job information
+ *  is served from the job table snapshots of pack_all_jobs_snapshot().
+ *
+ *  This file has been developed by staff and students
+ *  of Heidelberg University as part of the research carried out by the
+ *  Electronic Vision(s) group at the Kirchhoff-Institute for Physics.
+ *  The research is funded by Heidelberg University, the State of
+ *  Baden-Württemberg, the Seventh Framework Programme under grant agreements
+ *  no 604102 (HBP) as well as the Horizon 2020 Framework Programme under grant
+ *  agreement 720270 (HBP).
+\*****************************************************************************/
+
+#include "config.h"
+
+#include <pthread.h>
+#include <string.h>
+
+#include "src/common/list.h"
+#include "src/common/log.h"
+#include "src/common/macros.h"
+#include "src/common/pack.h"
+#include "src/common/xmalloc.h"
+#include "src/slurmctld/resp_cache.h"
+#include "src/slurmctld/slurmctld.h"
+
+#define RESP_CACHE_MAX 16	/* cached responses of each type */
+
+typedef struct {
+	char *buffer;
+	int buffer_size;
+	time_t last_used;
+	time_t pack_time;	/* from the response header */
+	uint16_t protocol_version;
+	uint16_t show_flags;
+	uint32_t vis_class;
+} resp_cache_ent_t;
+
+static pthread_mutex_t resp_cache_mutex = PTHREAD_MUTEX_INITIALIZER;
+static List resp_cache_list[RESP_CACHE_TYPE_CNT];
+
+static void _resp_cache_ent_free(void *x)
+{
+	resp_cache_ent_t *ent = (resp_cache_ent_t *) x;
+
+	if (!ent)
+		return;
+	xfree(ent->buffer);
+	xfree(ent);
+}
+
+static void _count_hit(resp_cache_type_t type, bool hit)
+{
+	switch (type) {
+	case RESP_CACHE_NODE:
+		if (hit)
+			slurmctld_diag_stats.node_info_cache_hits++;
+		else
+			slurmctld_diag_stats.node_info_cache_misses++;
+		break;
+	case RESP_CACHE_PART:
+		if (hit)
+			slurmctld_diag_stats.part_info_cache_hits++;
+		else
+			slurmctld_diag_stats.part_info_cache_misses++;
+		break;
+	default:
+		break;
+	}
+}
+
+extern uint32_t resp_cache_vis_class(uint16_t show_flags, uid_t uid)
+{
+	/* SlurmUser and root see all partitions and private data */
+	if (validate_slurm_user(uid))
+		return RESP_CACHE_VIS_ALL;
+
+	/* Only hidden partitions are filtered by user */
+	if (show_flags & SHOW_ALL)
+		return RESP_CACHE_VIS_ALL;
+
+	return (uint32_t) uid;
+}
+
+extern bool resp_cache_get(resp_cache_type_t type, uint16_t show_flags,
+			   uint32_t vis_class, uint16_t protocol_version,
+			   time_t last_update, char **buffer_ptr,
+			   int *buffer_size)
+{
+	resp_cache_ent_t *ent;
+	ListIterator iter;
+	bool found = false;
+
+	xassert(type < RESP_CACHE_TYPE_CNT);
+
+	slurm_mutex_lock(&resp_cache_mutex);
+	if (resp_cache_list[type]) {
+		iter = list_iterator_create(resp_cache_list[type]);
+		while ((ent = list_next(iter))) {
+			/* Packed in the second of the last change or before */
+			if (ent->pack_time <= last_update) {
+				list_delete_item(iter);
+				continue;
+			}
+			if (found ||
+			    (ent->show_flags != show_flags) ||
+			    (ent->vis_class != vis_class) ||
+			    (ent->protocol_version != protocol_version))
+				continue;
+			ent->last_used = time(NULL);
+			*buffer_ptr = xmalloc_nz(ent->buffer_size);
+			memcpy(*buffer_ptr, ent->buffer, ent->buffer_size);
+			*buffer_size = ent->buffer_size;
+			found = true;
+		}
+		list_iterator_destroy(iter);
+	}
+	_count_hit(type, found);
+	slurm_mutex_unlock(&resp_cache_mutex);
+
+	return found;
+}
+
+static int _find_ent(void *x, void *key)
+{
+	return (x == key);
+}
+
+static int _find_same_req(void *x, void *key)
+{
+	resp_cache_ent_t *ent = (resp_cache_ent_t *) x;
+	resp_cache_ent_t *new_ent = (resp_cache_ent_t *) key;
+
+	return ((ent->pack_time <= new_ent->pack_time) &&
+		(ent->show_flags == new_ent->show_flags) &&
+		(ent->vis_class == new_ent->vis_class) &&
+		(ent->protocol_version == new_ent->protocol_version));
+}
+
+extern void resp_cache_add(resp_cache_type_t type, uint16_t show_flags,
+			   uint32_t vis_class, uint16_t protocol_version,
+			   char *buffer, int buffer_size)
+{
+	resp_cache_ent_t *ent, *lru = NULL;
+	uint32_t rec_cnt;
+	time_t pack_time;
+	ListIterator iter;
+	char *copy;
+	Buf copy_buf;
+
+	xassert(type < RESP_CACHE_TYPE_CNT);
+
+	copy = xmalloc_nz(buffer_size);
+	memcpy(copy, buffer, buffer_size);
+	copy_buf = create_buf(copy, buffer_size);
+	if (unpack32(&rec_cnt, copy_buf) ||
+	    unpack_time(&pack_time, copy_buf)) {
+		error("%s: response of type %d too short to cache",
+		      __func__, type);
+		free_buf(copy_buf);
+		return;
+	}
+
+	ent = xmalloc(sizeof(resp_cache_ent_t));
+	ent->buffer = xfer_buf_data(copy_buf);
+	ent->buffer_size = buffer_size;
+	ent->last_used = time(NULL);
+	ent->pack_time = pack_time;
+	ent->protocol_version = protocol_version;
+	ent->show_flags = show_flags;
+	ent->vis_class = vis_class;
+
+	slurm_mutex_lock(&resp_cache_mutex);
+	if (!resp_cache_list[type])
+		resp_cache_list[type] = list_create(_resp_cache_ent_free);
+	/* Replace the response to the same request packed concurrently */
+	list_delete_all(resp_cache_list[type], _find_same_req, ent);
+	if (list_count(resp_cache_list[type]) >= RESP_CACHE_MAX) {
+		resp_cache_ent_t *tmp_ent;
+		iter = list_iterator_create(resp_cache_list[type]);
+		while ((tmp_ent = list_next(iter))) {
+			if (!lru || (tmp_ent->last_used < lru->last_used))
+				lru = tmp_ent;
+		}
+		list_iterator_destroy(iter);
+		list_delete_all(resp_cache_list[type], _find_ent, lru);
+	}
+	list_append(resp_cache_list[type], ent);
+	slurm_mutex_unlock(&resp_cache_mutex);
+}
+
+extern void resp_cache_fini(void)
+{
+	int i;
+
+	slurm_mutex_lock(&resp_cache_mutex);
+	for (i = 0; i < RESP_CACHE_TYPE_CNT; i++)
+		FREE_NULL_LIST(resp_cache_list[i]);
+	slurm_mutex_unlock(&resp_cache_mutex);
+}
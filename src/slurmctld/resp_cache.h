@@ -0,0 +1,73 @@
+/*****************************************************************************\
+ *  resp_cache.h - Cache of packed node and partition info responses
+ *
+ *  This file has been developed by staff and students
+ *  of Heidelberg University as part of the research carried out by the
+ *  Electronic Vision(s) group at the Kirchhoff-Institute for Physics.
+ *  The research is funded by Heidelberg University, the State of
+ *  Baden-Württemberg, the Seventh Framework Programme under grant agreements
+ *  no 604102 (HBP) as well as the Horizon 2020 Framework Programme under grant
+ *  agreement 720270 (HBP).
+\*****************************************************************************/
+
+#ifndef _SLURMCTLD_RESP_CACHE_H
+#define _SLURMCTLD_RESP_CACHE_H
+
+#include <stdbool.h>
+#include <stdint.h>
+#include <sys/types.h>
+#include <time.h>
+
+typedef enum {
+	RESP_CACHE_NODE,	/* REQUEST_NODE_INFO */
+	RESP_CACHE_PART,	/* REQUEST_PARTITION_INFO */
+	RESP_CACHE_TYPE_CNT
+} resp_cache_type_t;
+
+/* Visibility class of users who are shown all records */
+#define RESP_CACHE_VIS_ALL NO_VAL
+
+/*
+ * resp_cache_vis_class - Get the visibility class of a user: users in the
+ *	same class are shown the same records, so may share cached responses
+ * IN show_flags - filtering options of the request
+ * IN uid - uid of user making request
+ * RET RESP_CACHE_VIS_ALL or uid
+ */
+extern uint32_t resp_cache_vis_class(uint16_t show_flags, uid_t uid);
+
+/*
+ * resp_cache_get - Get a copy of a cached response packed after the last
+ *	change to the records it holds
+ * IN type - type of response
+ * IN show_flags - filtering options of the request
+ * IN vis_class - from resp_cache_vis_class()
+ * IN protocol_version - slurm protocol version of client
+ * IN last_update - time of last change to the records of the response
+ * OUT buffer_ptr - set to a copy of the response, must be xfreed by caller
+ * OUT buffer_size - set to size of the response in bytes
+ * RET true if found, counted as cache hit or miss for sdiag
+ */
+extern bool resp_cache_get(resp_cache_type_t type, uint16_t show_flags,
+			   uint32_t vis_class, uint16_t protocol_version,
+			   time_t last_update, char **buffer_ptr,
+			   int *buffer_size);
+
+/*
+ * resp_cache_add - Add a copy of a packed response to the cache
+ * IN type, show_flags, vis_class, protocol_version - as for resp_cache_get()
+ * IN buffer - packed response, not modified
+ * IN buffer_size - size of the response in bytes
+ * NOTE: The response must start with its record count and the time its
+ *	records were packed at, as packed by pack_all_node() and
+ *	pack_all_part(). It is only used while that time is later than
+ *	last_update.
+ */
+extern void resp_cache_add(resp_cache_type_t type, uint16_t show_flags,
+			   uint32_t vis_class, uint16_t protocol_version,
+			   char *buffer, int buffer_size);
+
+/* Free all cached responses */
+extern void resp_cache_fini(void);
+
+#endif /* !_SLURMCTLD_RESP_CACHE_H */
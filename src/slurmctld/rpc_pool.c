@@ -0,0 +1,370 @@
+/*****************************************************************************\
+ *  rpc_pool.c - Worker threads processing slurmctld RPCs from per class queues
+ *
+ *  The RPC manager thread accepts connections and queues each one once its
+ *  request arrived, by the class of the RPC. A fixed number of workers
+ *  process the queued connections, replacing a thread per connection. The
+ *  number of workers serving user requests and queries at once is limited,
+ *  leaving the others free for messages of slurmd and other daemons, which
+ *  release resources and locks rather than wait for them.
+ *
+ *  This file has been developed by staff and students
+ *  of Heidelberg University as part of the research carried out by the
+ *  Electronic Vision(s) group at the Kirchhoff-Institute for Physics.
+ *  The research is funded by Heidelberg University, the State of
+ *  Baden-Württemberg, the Seventh Framework Programme under grant agreements
+ *  no 604102 (HBP) as well as the Horizon 2020 Framework Programme under grant
+ *  agreement 720270 (HBP).
+\*****************************************************************************/
+
+#include "config.h"
+
+#include <pthread.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+
+#if HAVE_SYS_PRCTL_H
+#  include <sys/prctl.h>
+#endif
+
+#include "src/common/log.h"
+#include "src/common/macros.h"
+#include "src/common/slurm_protocol_defs.h"
+#include "src/common/xmalloc.h"
+#include "src/common/xstring.h"
+#include "src/slurmctld/rpc_pool.h"
+#include "src/slurmctld/slurmctld.h"
+
+#define RPC_WORKERS_DEFAULT 64
+
+typedef struct rpc_pool_ent {
+	connection_arg_t *conn;
+	struct timespec queued;		/* CLOCK_MONOTONIC */
+	struct rpc_pool_ent *next;
+} rpc_pool_ent_t;
+
+typedef struct {
+	const char *name;
+	const char *param;		/* SlurmctldParameters worker limit */
+	rpc_pool_ent_t *head;
+	rpc_pool_ent_t *tail;
+	uint32_t queued;
+	uint32_t active;
+	uint32_t max_workers;
+	uint64_t cnt;
+	uint64_t wait_nsec;
+	uint64_t wait_max_nsec;
+} rpc_queue_t;
+
+static pthread_mutex_t pool_mutex = PTHREAD_MUTEX_INITIALIZER;
+static pthread_cond_t pool_cond = PTHREAD_COND_INITIALIZER;
+static rpc_queue_t queues[RPC_CLASS_CNT] = {
+	[RPC_CLASS_SYSTEM] = { .name = "system" },
+	[RPC_CLASS_USER] = { .name = "user", .param = "rpc_user_workers=" },
+	[RPC_CLASS_QUERY] = { .name = "query", .param = "rpc_query_workers=" },
+};
+static pthread_t *workers = NULL;
+static int worker_cnt = 0;
+static bool pool_shutdown = false;
+static void (*service_func)(connection_arg_t *conn) = NULL;
+
+extern rpc_class_t rpc_pool_class(uint16_t msg_type)
+{
+	switch (msg_type) {
+	case MESSAGE_NODE_REGISTRATION_STATUS:
+	case MESSAGE_EPILOG_COMPLETE:
+	case MESSAGE_COMPOSITE:
+	case REQUEST_COMPLETE_BATCH_SCRIPT:
+	case REQUEST_COMPLETE_JOB_ALLOCATION:
+	case REQUEST_COMPLETE_PROLOG:
+	case REQUEST_STEP_COMPLETE:
+	case REQUEST_EVENT_LOG:
+	case REQUEST_CTLD_MULT_MSG:
+	case REQUEST_SIB_JOB_LOCK:
+	case REQUEST_SIB_JOB_UNLOCK:
+	case REQUEST_PERSIST_INIT:
+	case ACCOUNTING_UPDATE_MSG:
+	case ACCOUNTING_FIRST_REG:
+	case ACCOUNTING_REGISTER_CTLD:
+	case REQUEST_PING:
+	case REQUEST_CONTROL:
+	case REQUEST_CONTROL_STATUS:
+	case REQUEST_TAKEOVER:
+	case REQUEST_SHUTDOWN:
+	case REQUEST_SHUTDOWN_IMMEDIATE:
+	case REQUEST_RECONFIGURE:
+		return RPC_CLASS_SYSTEM;
+	case REQUEST_BUILD_INFO:
+	case REQUEST_JOB_INFO:
+	case REQUEST_JOB_USER_INFO:
+	case REQUEST_JOB_INFO_SINGLE:
+	case REQUEST_JOB_STEP_INFO:
+	case REQUEST_JOB_END_TIME:
+	case REQUEST_BATCH_SCRIPT:
+	case REQUEST_SHARE_INFO:
+	case REQUEST_PRIORITY_FACTORS:
+	case REQUEST_FED_INFO:
+	case REQUEST_FRONT_END_INFO:
+	case REQUEST_NODE_INFO:
+	case REQUEST_NODE_INFO_SINGLE:
+	case REQUEST_PARTITION_INFO:
+	case REQUEST_RESERVATION_INFO:
+	case REQUEST_LAYOUT_INFO:
+	case REQUEST_BURST_BUFFER_INFO:
+	case REQUEST_BURST_BUFFER_STATUS:
+	case REQUEST_TRIGGER_GET:
+	case REQUEST_TOPO_INFO:
+	case REQUEST_POWERCAP_INFO:
+	case REQUEST_STATS_INFO:
+	case REQUEST_LICENSE_INFO:
+	case REQUEST_LICENSE_USAGE:
+	case REQUEST_ASSOC_MGR_INFO:
+	case REQUEST_CONFIG:
+		return RPC_CLASS_QUERY;
+	default:
+		return RPC_CLASS_USER;
+	}
+}
+
+static uint64_t _elapsed_nsec(const struct timespec *start)
+{
+	struct timespec now;
+
+	clock_gettime(CLOCK_MONOTONIC, &now);
+	if ((now.tv_sec < start->tv_sec) ||
+	    ((now.tv_sec == start->tv_sec) && (now.tv_nsec < start->tv_nsec)))
+		return 0;
+	return ((uint64_t) (now.tv_sec - start->tv_sec) * NSEC_IN_SEC) +
+	       now.tv_nsec - start->tv_nsec;
+}
+
+/*
+ * Set the worker limits of the classes. By default user requests may use
+ * 3/4 and queries 1/2 of the workers, system messages all of them.
+ * pool_mutex and the slurmctld configuration read lock set.
+ */
+static void _set_limits(void)
+{
+	char *tmp_ptr;
+	int i, limit;
+
+	for (i = 0; i < RPC_CLASS_CNT; i++) {
+		if (i == RPC_CLASS_SYSTEM)
+			limit = worker_cnt;
+		else if (i == RPC_CLASS_USER)
+			limit = (worker_cnt * 3) / 4;
+		else
+			limit = worker_cnt / 2;
+
+		if (queues[i].param &&
+		    (tmp_ptr = xstrcasestr(slurmctld_conf.slurmctld_params,
+					   queues[i].param))) {
+			limit = atoi(tmp_ptr + strlen(queues[i].param));
+			if ((limit < 1) || (limit > worker_cnt)) {
+				error("Invalid SlurmctldParameters %s%d, must be between 1 and rpc_workers (%d)",
+				      queues[i].param, limit, worker_cnt);
+				limit = MIN(MAX(limit, 1), worker_cnt);
+			}
+		}
+		queues[i].max_workers = MAX(limit, 1);
+	}
+	slurm_cond_broadcast(&pool_cond);
+}
+
+/*
+ * Dequeue the oldest connection of the first class below its worker limit,
+ * pool_mutex set. RET NULL if there is none.
+ */
+static rpc_pool_ent_t *_dequeue(rpc_class_t *class)
+{
+	rpc_pool_ent_t *ent;
+	rpc_queue_t *q;
+	uint64_t nsec;
+	int i;
+
+	for (i = 0; i < RPC_CLASS_CNT; i++) {
+		q = &queues[i];
+		if (!q->head || (q->active >= q->max_workers))
+			continue;
+		ent = q->head;
+		if (!(q->head = ent->next))
+			q->tail = NULL;
+		q->queued--;
+		q->active++;
+		q->cnt++;
+		nsec = _elapsed_nsec(&ent->queued);
+		q->wait_nsec += nsec;
+		q->wait_max_nsec = MAX(q->wait_max_nsec, nsec);
+		*class = i;
+		return ent;
+	}
+	return NULL;
+}
+
+static bool _queues_empty(void)
+{
+	int i;
+
+	for (i = 0; i < RPC_CLASS_CNT; i++) {
+		if (queues[i].head)
+			return false;
+	}
+	return true;
+}
+
+static void *_worker(void *arg)
+{
+	rpc_pool_ent_t *ent;
+	rpc_class_t class;
+
+#if HAVE_SYS_PRCTL_H
+	if (prctl(PR_SET_NAME, "srvcn", NULL, NULL, NULL) < 0) {
+		error("%s: cannot set my name to %s %m", __func__, "srvcn");
+	}
+#endif
+
+	slurm_mutex_lock(&pool_mutex);
+	while (1) {
+		if (!(ent = _dequeue(&class))) {
+			/* Queued connections are processed before exiting */
+			if (pool_shutdown && _queues_empty())
+				break;
+			slurm_cond_wait(&pool_cond, &pool_mutex);
+			continue;
+		}
+		slurm_mutex_unlock(&pool_mutex);
+
+		(*service_func)(ent->conn);
+		xfree(ent);
+
+		slurm_mutex_lock(&pool_mutex);
+		queues[class].active--;
+		/* Another class may have been waiting for this worker */
+		slurm_cond_signal(&pool_cond);
+	}
+	slurm_mutex_unlock(&pool_mutex);
+
+	return NULL;
+}
+
+extern void rpc_pool_init(void (*service)(connection_arg_t *conn),
+			  int max_workers)
+{
+	char *tmp_ptr;
+	int i, cnt = RPC_WORKERS_DEFAULT;
+
+	if ((tmp_ptr = xstrcasestr(slurmctld_conf.slurmctld_params,
+				   "rpc_workers="))) {
+		cnt = atoi(tmp_ptr + 12);
+		if (cnt < 1) {
+			error("Invalid SlurmctldParameters rpc_workers=%d, using %d",
+			      cnt, RPC_WORKERS_DEFAULT);
+			cnt = RPC_WORKERS_DEFAULT;
+		}
+	}
+	cnt = MIN(cnt, max_workers);
+
+	slurm_mutex_lock(&pool_mutex);
+	xassert(!workers);
+	service_func = service;
+	pool_shutdown = false;
+	worker_cnt = cnt;
+	_set_limits();
+	workers = xcalloc(worker_cnt, sizeof(pthread_t));
+	for (i = 0; i < worker_cnt; i++)
+		slurm_thread_create(&workers[i], _worker, NULL);
+	slurm_mutex_unlock(&pool_mutex);
+
+	debug("%s: %d RPC workers, at most %u for user requests and %u for queries",
+	      __func__, worker_cnt, queues[RPC_CLASS_USER].max_workers,
+	      queues[RPC_CLASS_QUERY].max_workers);
+}
+
+extern void rpc_pool_fini(void)
+{
+	int i;
+
+	slurm_mutex_lock(&pool_mutex);
+	if (!workers) {
+		slurm_mutex_unlock(&pool_mutex);
+		return;
+	}
+	pool_shutdown = true;
+	slurm_cond_broadcast(&pool_cond);
+	slurm_mutex_unlock(&pool_mutex);
+
+	for (i = 0; i < worker_cnt; i++)
+		pthread_join(workers[i], NULL);
+
+	slurm_mutex_lock(&pool_mutex);
+	xfree(workers);
+	worker_cnt = 0;
+	slurm_mutex_unlock(&pool_mutex);
+}
+
+extern void rpc_pool_reconfig(void)
+{
+	slurm_mutex_lock(&pool_mutex);
+	if (workers)
+		_set_limits();
+	slurm_mutex_unlock(&pool_mutex);
+}
+
+extern void rpc_pool_queue(connection_arg_t *conn, uint16_t msg_type)
+{
+	rpc_pool_ent_t *ent = xmalloc(sizeof(rpc_pool_ent_t));
+	rpc_queue_t *q = &queues[rpc_pool_class(msg_type)];
+
+	ent->conn = conn;
+	clock_gettime(CLOCK_MONOTONIC, &ent->queued);
+
+	slurm_mutex_lock(&pool_mutex);
+	xassert(workers);
+	if (q->tail)
+		q->tail->next = ent;
+	else
+		q->head = ent;
+	q->tail = ent;
+	q->queued++;
+	slurm_cond_signal(&pool_cond);
+	slurm_mutex_unlock(&pool_mutex);
+}
+
+extern void rpc_pool_pack_stats(Buf buffer, uint16_t protocol_version)
+{
+	rpc_queue_t *q;
+	int i;
+
+	if (protocol_version < SLURM_20_02_VISIONS_PROTOCOL_VERSION)
+		return;
+
+	slurm_mutex_lock(&pool_mutex);
+	pack32((uint32_t) worker_cnt, buffer);
+	pack32((uint32_t) RPC_CLASS_CNT, buffer);
+	for (i = 0; i < RPC_CLASS_CNT; i++) {
+		q = &queues[i];
+		packstr((char *) q->name, buffer);
+		pack32(q->max_workers, buffer);
+		pack32(q->active, buffer);
+		pack32(q->queued, buffer);
+		pack64(q->cnt, buffer);
+		pack64(q->wait_nsec / NSEC_IN_USEC, buffer);
+		pack32((uint32_t) MIN(q->wait_max_nsec / NSEC_IN_USEC,
+				      INFINITE - 1), buffer);
+	}
+	slurm_mutex_unlock(&pool_mutex);
+}
+
+extern void rpc_pool_reset_stats(void)
+{
+	int i;
+
+	slurm_mutex_lock(&pool_mutex);
+	for (i = 0; i < RPC_CLASS_CNT; i++) {
+		queues[i].cnt = 0;
+		queues[i].wait_nsec = 0;
+		queues[i].wait_max_nsec = 0;
+	}
+	slurm_mutex_unlock(&pool_mutex);
+}
@@ -0,0 +1,63 @@
+/*****************************************************************************\
+ *  rpc_pool.h - Worker threads processing slurmctld RPCs from per class queues
+ *
+ *  This file has been developed by staff and students
+ *  of Heidelberg University as part of the research carried out by the
+ *  Electronic Vision(s) group at the Kirchhoff-Institute for Physics.
+ *  The research is funded by Heidelberg University, the State of
+ *  Baden-Württemberg, the Seventh Framework Programme under grant agreements
+ *  no 604102 (HBP) as well as the Horizon 2020 Framework Programme under grant
+ *  agreement 720270 (HBP).
+\*****************************************************************************/
+
+#ifndef _SLURMCTLD_RPC_POOL_H
+#define _SLURMCTLD_RPC_POOL_H
+
+#include "src/common/pack.h"
+#include "src/slurmctld/slurmctld.h"
+#include "src/slurmctld/proc_req.h"
+
+/*
+ * Accepted connections are queued by the class of the RPC they carry and
+ * processed by a fixed number of worker threads. Workers take the oldest
+ * connection of the first class in this order which is below its limit of
+ * workers, so node registrations and completions are never stuck behind
+ * user requests and queries.
+ */
+typedef enum {
+	RPC_CLASS_SYSTEM,	/* slurmd, slurmdbd and controller messages */
+	RPC_CLASS_USER,		/* requests changing jobs or configuration */
+	RPC_CLASS_QUERY,	/* requests for information */
+	RPC_CLASS_CNT
+} rpc_class_t;
+
+/* Return the class of an RPC by its message type */
+extern rpc_class_t rpc_pool_class(uint16_t msg_type);
+
+/*
+ * rpc_pool_init - Start the worker threads
+ * IN service - processes and closes a connection, then frees it
+ * IN max_workers - upper limit of the number of workers
+ * NOTE: Call with the slurmctld configuration read lock
+ */
+extern void rpc_pool_init(void (*service)(connection_arg_t *conn),
+			  int max_workers);
+
+/* Process all queued connections, then end the worker threads */
+extern void rpc_pool_fini(void);
+
+/* Update the worker limits of the classes from SlurmctldParameters */
+extern void rpc_pool_reconfig(void);
+
+/*
+ * rpc_pool_queue - Queue an accepted connection for a worker
+ * IN conn - connection, owned by the pool from now on
+ * IN msg_type - type of the RPC, determines its class
+ */
+extern void rpc_pool_queue(connection_arg_t *conn, uint16_t msg_type);
+
+/* Pack or reset the queue and worker statistics of the classes */
+extern void rpc_pool_pack_stats(Buf buffer, uint16_t protocol_version);
+extern void rpc_pool_reset_stats(void);
+
+#endif /* !_SLURMCTLD_RPC_POOL_H */
@@ -0,0 +1,320 @@
+/*****************************************************************************\
+ *  sched_queue.c - Queue of pending jobs kept between runs of the main
+ *	scheduler, one heap per partition
+ *
+ *  Each record knows its position in the heap of its partition, so that a
+ *  record can be removed without searching for it. Partitions are few, they
+ *  are searched linearly and sched_queue_pop() compares the first records of
+ *  all dirty partitions.
+ *
+ *  This file has been developed by staff and students
+ *  of Heidelberg University as part of the research carried out by the
+ *  Electronic Vision(s) group at the Kirchhoff-Institute for Physics.
+ *  The research is funded by Heidelberg University, the State of
+ *  Baden-Württemberg, the Seventh Framework Programme under grant agreements
+ *  no 604102 (HBP) as well as the Horizon 2020 Framework Programme under grant
+ *  agreement 720270 (HBP).
+\*****************************************************************************/
+
+#include "config.h"
+
+#include "src/common/xassert.h"
+#include "src/common/xmalloc.h"
+#include "src/slurmctld/sched_queue.h"
+
+typedef struct {
+	part_record_t *part_ptr;
+	job_queue_rec_t **heap;	/* first record at heap[0] */
+	int rec_cnt;
+	int rec_size;
+	bool dirty;
+} part_queue_t;
+
+static part_queue_t *part_queues = NULL;
+static int part_queue_cnt = 0;
+static bool *part_overlap = NULL;	/* part_queue_cnt^2, shares nodes */
+static int rec_total = 0;
+
+/* RET true if job_rec1 is to be tested before job_rec2 */
+static bool _before(job_queue_rec_t *job_rec1, job_queue_rec_t *job_rec2)
+{
+	return (sort_job_queue2(&job_rec1, &job_rec2) < 0);
+}
+
+static part_queue_t *_part_queue(part_record_t *part_ptr)
+{
+	int i;
+
+	for (i = 0; i < part_queue_cnt; i++) {
+		if (part_queues[i].part_ptr == part_ptr)
+			return &part_queues[i];
+	}
+	return NULL;
+}
+
+static void _heap_set(part_queue_t *queue, int inx, job_queue_rec_t *rec)
+{
+	queue->heap[inx] = rec;
+	rec->queue_inx = inx;
+}
+
+static void _sift_up(part_queue_t *queue, int inx)
+{
+	job_queue_rec_t *rec = queue->heap[inx];
+	int parent;
+
+	while (inx > 0) {
+		parent = (inx - 1) / 2;
+		if (!_before(rec, queue->heap[parent]))
+			break;
+		_heap_set(queue, inx, queue->heap[parent]);
+		inx = parent;
+	}
+	_heap_set(queue, inx, rec);
+}
+
+static void _sift_down(part_queue_t *queue, int inx)
+{
+	job_queue_rec_t *rec = queue->heap[inx];
+	int child;
+
+	while ((child = (2 * inx) + 1) < queue->rec_cnt) {
+		if (((child + 1) < queue->rec_cnt) &&
+		    _before(queue->heap[child + 1], queue->heap[child]))
+			child++;
+		if (!_before(queue->heap[child], rec))
+			break;
+		_heap_set(queue, inx, queue->heap[child]);
+		inx = child;
+	}
+	_heap_set(queue, inx, rec);
+}
+
+/* Unlink a record from the list of records of its job */
+static void _job_unlink(job_queue_rec_t *job_queue_rec)
+{
+	job_queue_rec_t **rec_pptr = &job_queue_rec->job_ptr->queue_rec;
+
+	while (*rec_pptr) {
+		if (*rec_pptr == job_queue_rec) {
+			*rec_pptr = job_queue_rec->job_next;
+			break;
+		}
+		rec_pptr = &(*rec_pptr)->job_next;
+	}
+	job_queue_rec->job_next = NULL;
+}
+
+/* Remove a record from its heap, not from the list of records of its job */
+static void _heap_remove(part_queue_t *queue, job_queue_rec_t *job_queue_rec)
+{
+	int inx = job_queue_rec->queue_inx;
+
+	xassert(queue->heap[inx] == job_queue_rec);
+
+	rec_total--;
+	if (inx != --queue->rec_cnt) {
+		_heap_set(queue, inx, queue->heap[queue->rec_cnt]);
+		_sift_down(queue, inx);
+		_sift_up(queue, inx);
+	}
+	job_queue_rec->queue_inx = -1;
+}
+
+static void _queue_free(void)
+{
+	job_queue_rec_t *rec;
+	int i, j;
+
+	for (i = 0; i < part_queue_cnt; i++) {
+		for (j = 0; j < part_queues[i].rec_cnt; j++) {
+			rec = part_queues[i].heap[j];
+			rec->job_ptr->queue_rec = NULL;
+			xfree(rec);
+		}
+		xfree(part_queues[i].heap);
+	}
+	xfree(part_queues);
+	xfree(part_overlap);
+	part_queue_cnt = 0;
+	rec_total = 0;
+}
+
+extern void sched_queue_init(List part_list)
+{
+	ListIterator part_iterator;
+	part_record_t *part_ptr;
+	part_queue_t *queue;
+	int i, j;
+
+	_queue_free();
+
+	part_queues = xcalloc(list_count(part_list), sizeof(part_queue_t));
+	part_iterator = list_iterator_create(part_list);
+	while ((part_ptr = list_next(part_iterator))) {
+		queue = &part_queues[part_queue_cnt++];
+		queue->part_ptr = part_ptr;
+		queue->dirty = true;
+	}
+	list_iterator_destroy(part_iterator);
+
+	part_overlap = xcalloc(part_queue_cnt * part_queue_cnt, sizeof(bool));
+	for (i = 0; i < part_queue_cnt; i++) {
+		for (j = 0; j < part_queue_cnt; j++) {
+			part_overlap[(i * part_queue_cnt) + j] =
+				part_queues[i].part_ptr->node_bitmap &&
+				part_queues[j].part_ptr->node_bitmap &&
+				bit_overlap_any(
+					part_queues[i].part_ptr->node_bitmap,
+					part_queues[j].part_ptr->node_bitmap);
+		}
+	}
+}
+
+extern void sched_queue_clear(void)
+{
+	_queue_free();
+}
+
+extern int sched_queue_count(void)
+{
+	return rec_total;
+}
+
+extern void sched_queue_push(job_queue_rec_t *job_queue_rec)
+{
+	part_queue_t *queue;
+
+	xassert(job_queue_rec->job_ptr);
+
+	if (!(queue = _part_queue(job_queue_rec->part_ptr))) {
+		xfree(job_queue_rec);
+		return;
+	}
+
+	if (queue->rec_cnt >= queue->rec_size) {
+		queue->rec_size = MAX(queue->rec_size * 2, 64);
+		xrealloc(queue->heap,
+			 queue->rec_size * sizeof(job_queue_rec_t *));
+	}
+	_heap_set(queue, queue->rec_cnt++, job_queue_rec);
+	_sift_up(queue, job_queue_rec->queue_inx);
+	rec_total++;
+
+	job_queue_rec->job_next = job_queue_rec->job_ptr->queue_rec;
+	job_queue_rec->job_ptr->queue_rec = job_queue_rec;
+}
+
+extern job_queue_rec_t *sched_queue_pop(void)
+{
+	part_queue_t *queue = NULL;
+	job_queue_rec_t *job_queue_rec;
+	int i;
+
+	for (i = 0; i < part_queue_cnt; i++) {
+		if (!part_queues[i].dirty || !part_queues[i].rec_cnt)
+			continue;
+		if (!queue ||
+		    _before(part_queues[i].heap[0], queue->heap[0]))
+			queue = &part_queues[i];
+	}
+	if (!queue)
+		return NULL;
+
+	job_queue_rec = queue->heap[0];
+	_heap_remove(queue, job_queue_rec);
+	_job_unlink(job_queue_rec);
+
+	return job_queue_rec;
+}
+
+extern void sched_queue_remove_job(job_record_t *job_ptr)
+{
+	job_queue_rec_t *job_queue_rec;
+	part_queue_t *queue;
+
+	while ((job_queue_rec = job_ptr->queue_rec)) {
+		job_ptr->queue_rec = job_queue_rec->job_next;
+		if ((queue = _part_queue(job_queue_rec->part_ptr)))
+			_heap_remove(queue, job_queue_rec);
+		xfree(job_queue_rec);
+	}
+}
+
+extern void sched_queue_move_job(job_record_t *old_job_ptr,
+				 job_record_t *new_job_ptr)
+{
+	job_queue_rec_t *job_queue_rec;
+
+	new_job_ptr->queue_rec = old_job_ptr->queue_rec;
+	old_job_ptr->queue_rec = NULL;
+	for (job_queue_rec = new_job_ptr->queue_rec; job_queue_rec;
+	     job_queue_rec = job_queue_rec->job_next)
+		job_queue_rec->job_ptr = new_job_ptr;
+}
+
+extern void sched_queue_set_dirty(part_record_t *part_ptr, bool dirty)
+{
+	part_queue_t *queue;
+
+	if ((queue = _part_queue(part_ptr)))
+		queue->dirty = dirty;
+}
+
+extern bool sched_queue_dirty(part_record_t *part_ptr)
+{
+	part_queue_t *queue;
+
+	if ((queue = _part_queue(part_ptr)))
+		return queue->dirty;
+	return false;
+}
+
+extern void sched_queue_dirty_nodes(bitstr_t *node_bitmap)
+{
+	int i;
+
+	for (i = 0; i < part_queue_cnt; i++) {
+		if (!part_queues[i].dirty &&
+		    part_queues[i].part_ptr->node_bitmap &&
+		    bit_overlap_any(part_queues[i].part_ptr->node_bitmap,
+				    node_bitmap))
+			part_queues[i].dirty = true;
+	}
+}
+
+extern int sched_queue_dirty_overlap(void)
+{
+	bool *overlap;
+	bool added = true;
+	int dirty_cnt = 0, i, j;
+
+	for (i = 0; i < part_queue_cnt; i++) {
+		if (!part_queues[i].rec_cnt)
+			part_queues[i].dirty = false;
+	}
+
+	/* Partitions sharing nodes with a partition sharing nodes with a
+	 * dirty one are dirty too */
+	while (added) {
+		added = false;
+		for (i = 0; i < part_queue_cnt; i++) {
+			if (!part_queues[i].dirty)
+				continue;
+			overlap = &part_overlap[i * part_queue_cnt];
+			for (j = 0; j < part_queue_cnt; j++) {
+				if (overlap[j] && !part_queues[j].dirty &&
+				    part_queues[j].rec_cnt) {
+					part_queues[j].dirty = true;
+					added = true;
+				}
+			}
+		}
+	}
+
+	for (i = 0; i < part_queue_cnt; i++) {
+		if (part_queues[i].dirty)
+			dirty_cnt++;
+	}
+	return dirty_cnt;
+}
@@ -0,0 +1,82 @@
+/*****************************************************************************\
+ *  sched_queue.h - Queue of pending jobs kept between runs of the main
+ *	scheduler, one heap per partition
+ *
+ *  This file has been developed by staff and students
+ *  of Heidelberg University as part of the research carried out by the
+ *  Electronic Vision(s) group at the Kirchhoff-Institute for Physics.
+ *  The research is funded by Heidelberg University, the State of
+ *  Baden-Württemberg, the Seventh Framework Programme under grant agreements
+ *  no 604102 (HBP) as well as the Horizon 2020 Framework Programme under grant
+ *  agreement 720270 (HBP).
+\*****************************************************************************/
+
+#ifndef _SLURMCTLD_SCHED_QUEUE_H
+#define _SLURMCTLD_SCHED_QUEUE_H
+
+#include "src/common/bitstring.h"
+#include "src/common/list.h"
+#include "src/slurmctld/job_scheduler.h"
+
+/*
+ * The job:partition records built by build_job_queue() are kept in a binary
+ * heap per partition, in the order of sort_job_queue2(). Each partition is
+ * marked dirty when something changed which may let one of its jobs start,
+ * and sched_queue_pop() only returns records of dirty partitions. A job's
+ * records are linked from its queue_rec, so that they can be removed when the
+ * job changes or its record is freed.
+ *
+ * All functions must be called with the job write lock and the partition
+ * read lock.
+ */
+
+/*
+ * Remove all records and create an empty heap for each partition, all of
+ * them dirty
+ */
+extern void sched_queue_init(List part_list);
+
+/* Remove all records and partitions */
+extern void sched_queue_clear(void);
+
+/* RET count of records in the queue */
+extern int sched_queue_count(void);
+
+/*
+ * Add a record to the heap of its partition, the record is freed if the
+ * partition has no heap
+ */
+extern void sched_queue_push(job_queue_rec_t *job_queue_rec);
+
+/*
+ * Remove the first record of all dirty partitions
+ * RET the record, which the caller must free or push again, or NULL if no
+ *	dirty partition has any record
+ */
+extern job_queue_rec_t *sched_queue_pop(void);
+
+/* Remove and free all records of a job */
+extern void sched_queue_remove_job(job_record_t *job_ptr);
+
+/* Give the records of a job to another record of the same job ID */
+extern void sched_queue_move_job(job_record_t *old_job_ptr,
+				 job_record_t *new_job_ptr);
+
+/* Mark a partition as dirty or not */
+extern void sched_queue_set_dirty(part_record_t *part_ptr, bool dirty);
+
+/* RET true if a partition is dirty */
+extern bool sched_queue_dirty(part_record_t *part_ptr);
+
+/* Mark the partitions of any of these nodes dirty */
+extern void sched_queue_dirty_nodes(bitstr_t *node_bitmap);
+
+/*
+ * Mark partitions sharing nodes with a dirty one dirty, so that jobs of
+ * partitions sharing nodes are tested in order of priority. Dirty partitions
+ * without any record are marked clean first.
+ * RET count of dirty partitions
+ */
+extern int sched_queue_dirty_overlap(void);
+
+#endif /* !_SLURMCTLD_SCHED_QUEUE_H */
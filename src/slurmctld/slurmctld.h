@@ -193,6 +193,17 @@ typedef struct diag_stats {
 	uint32_t bf_table_size;
 	uint32_t bf_table_size_sum;
 	time_t   bf_when_last_cycle;
+	uint32_t bf_plan_full;
+	uint32_t bf_plan_incr;
+	uint32_t bf_plan_last_reused;
+	uint32_t bf_plan_reused_sum;
+
+	uint32_t job_info_cache_hits;
+	uint32_t job_info_cache_misses;
+	uint32_t node_info_cache_hits;
+	uint32_t node_info_cache_misses;
+	uint32_t part_info_cache_hits;
+	uint32_t part_info_cache_misses;
 
 	uint32_t latency;
 } diag_stats_t;
@@ -736,15 +747,17 @@ struct job_record {
 	List het_job_list;		/* List of job pointers to all
 					 * components */
 	uint32_t job_id;		/* job ID */
-	job_record_t *job_next;		/* next entry with same hash index */
-	job_record_t *job_array_next_j;	/* job array linked list by job_id */
-	job_record_t *job_array_next_t;	/* job array linked list by task_id */
+	job_record_t *job_array_next_j;	/* next task of same job array */
+	job_record_t *job_array_prev_j;	/* previous task of same job array */
 	job_record_t *job_preempt_comp; /* het job preempt component */
 	job_resources_t *job_resrcs;	/* details of allocated cores */
 	uint32_t job_state;		/* state of the job */
 	uint16_t kill_on_node_fail;	/* 1 if job should be killed on
 					 * node failure */
 	time_t last_sched_eval;		/* last time job was evaluated for scheduling */
+	time_t last_update;		/* time of last change to the job,
+					 * see job_state_changed(), internal
+					 * use only, DON'T PACK */
 	char *licenses;			/* licenses required by the job */
 	List license_list;		/* structure with license info */
 	acct_policy_limit_set_t limit_set; /* flags if indicate an
@@ -808,6 +821,8 @@ struct job_record {
 					 * this job, confirm the
 					 * value before use */
 	void *qos_blocking_ptr;		/* internal use only, DON'T PACK */
+	struct job_queue_rec *queue_rec;/* first record of the job kept in
+					 * sched_queue, internal use only */
 	uint8_t reboot;			/* node reboot requested before start */
 	uint16_t restart_cnt;		/* count of restarts */
 	time_t resize_time;		/* time of latest size change */
@@ -831,6 +846,9 @@ struct job_record {
 	time_t start_time;		/* time execution begins,
 					 * actual or expected */
 	char *state_desc;		/* optional details for state_reason */
+	bool state_dirty;		/* changed since its state was last
+					 * saved, see job_state_changed(),
+					 * internal use only, DON'T PACK */
 	uint32_t state_reason;		/* reason job still pending or failed
 					 * see slurm.h:enum job_state_reason */
 	uint32_t state_reason_prev;	/* Previous state_reason, needed to
@@ -872,6 +890,8 @@ struct job_record {
 					 * assoc_mgr */
 	char *tres_alloc_str;           /* simple tres string for job */
 	char *tres_fmt_alloc_str;       /* formatted tres string for job */
+	uint32_t update_cnt;		/* count of update_job() calls, to find
+					 * jobs changed since last scheduled */
 	uint32_t user_id;		/* user the job runs as */
 	char *user_name;		/* string version of user */
 	uint16_t wait_all_nodes;	/* if set, wait for all nodes to boot
@@ -1183,10 +1203,29 @@ extern List depended_list_copy(List depend_list_src);
  */
 extern int drain_nodes ( char *nodes, char *reason, uint32_t reason_uid );
 
-/* dump_all_job_state - save the state of all jobs to file
- * RET 0 or error code */
+/*
+ * dump_all_job_state - save the state of all jobs to file. Jobs changed or
+ *	purged since the last save are appended to a journal, which is
+ *	compacted into a new job state file once it grows as large as the file.
+ * RET 0 or error code
+ */
 extern int dump_all_job_state ( void );
 
+/*
+ * job_state_changed - note a change of a job's saved state. The job is
+ *	journaled by the next job state save and repacked by the next job
+ *	table snapshot, its last_update and last_job_update are set.
+ *	Code changing a job must call this, not set last_job_update alone,
+ *	unless only the expected start time of a pending job changed, which
+ *	the schedulers compute again after a restart. Such code sets the
+ *	job's last_update along with last_job_update.
+ * IN job_ptr - job changed, NULL if any job may have changed
+ * IN now - time of the change
+ * NOTE: Caller must hold the job write lock, or the job read lock and the
+ *	lock of the job's record
+ */
+extern void job_state_changed(job_record_t *job_ptr, time_t now);
+
 /* dump_all_node_state - save the state of all nodes to file */
 extern int dump_all_node_state ( void );
 
@@ -1826,8 +1865,9 @@ extern int list_find_feature(void *feature_entry, void *key);
 extern int list_find_part (void *part_entry, void *key);
 
 /*
- * load_all_job_state - load the job state from file, recover from last
- *	checkpoint. Execute this after loading the configuration file data.
+ * load_all_job_state - load the job state from file and replay the changes
+ *	journaled since, recover from last checkpoint. Execute this after
+ *	loading the configuration file data.
  * RET 0 or error code
  */
 extern int load_all_job_state ( void );
@@ -1952,6 +1992,25 @@ extern void pack_all_jobs(char **buffer_ptr, int *buffer_size,
 			  uint16_t show_flags, uid_t uid, uint32_t filter_uid,
 			  uint16_t protocol_version);
 
+/*
+ * pack_all_jobs_snapshot - dump all job information for all jobs like
+ *	pack_all_jobs(), but copy the packed jobs from a snapshot of the job
+ *	table shared by all requests, which is only updated once jobs changed
+ * OUT buffer_ptr - the pointer is set to the allocated buffer.
+ * OUT buffer_size - set to size of the buffer in bytes
+ * IN show_flags - job filtering options
+ * IN uid - uid of user making request (for partition filtering)
+ * IN filter_uid - pack only jobs belonging to this user if not NO_VAL
+ * IN protocol_version - slurm protocol version of client
+ * NOTE: the buffer at *buffer_ptr must be xfreed by the caller
+ * NOTE: call without any slurmctld locks, the job read lock is only taken
+ *	to update the snapshot
+ */
+extern void pack_all_jobs_snapshot(char **buffer_ptr, int *buffer_size,
+				   uint16_t show_flags, uid_t uid,
+				   uint32_t filter_uid,
+				   uint16_t protocol_version);
+
 /*
  * pack_spec_jobs - dump job information for specified jobs in
  *	machine independent form (for network transmission)
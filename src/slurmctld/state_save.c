@@ -38,17 +38,27 @@
 \*****************************************************************************/
 
 #include "config.h"
+#define _GNU_SOURCE
 
 #if HAVE_SYS_PRCTL_H
 #  include <sys/prctl.h>
 #endif
 
+#include <errno.h>
+#include <fcntl.h>
 #include <pthread.h>
+#include <unistd.h>
 
+#include "src/common/fd.h"
 #include "src/common/macros.h"
+#include "src/common/slurm_protocol_defs.h"
+#include "src/common/xmalloc.h"
+#include "src/common/xstring.h"
 #include "src/slurmctld/front_end.h"
+#include "src/slurmctld/locks.h"
 #include "src/slurmctld/reservation.h"
 #include "src/slurmctld/slurmctld.h"
+#include "src/slurmctld/state_save.h"
 #include "src/slurmctld/trigger_mgr.h"
 
 /* Maximum delay for pending state save to be processed, in seconds */
@@ -56,12 +66,430 @@
 #define SAVE_MAX_WAIT	5
 #endif
 
+typedef struct state_file {
+	char *name;
+	state_file_mode_t mode;
+	Buf buffer;
+	bool wait;			/* caller frees once done */
+	bool done;
+	int rc;
+	int fd;
+	char *reg_file;
+	struct timespec start;		/* CLOCK_MONOTONIC */
+	struct state_file *next;
+} state_file_t;
+
 static pthread_mutex_t state_save_lock = PTHREAD_MUTEX_INITIALIZER;
 static pthread_cond_t  state_save_cond = PTHREAD_COND_INITIALIZER;
 static int save_jobs = 0, save_nodes = 0, save_parts = 0;
 static int save_front_end = 0, save_triggers = 0, save_resv = 0;
 static bool run_save_thread = true;
 
+/* Saves queued again if writing their state file failed */
+static const struct {
+	const char *name;
+	int *save_cnt;
+} save_retry[] = {
+	{ "front_end_state", &save_front_end },
+	{ "node_state", &save_nodes },
+	{ "part_state", &save_parts },
+	{ "resv_state", &save_resv },
+	{ "trigger_state", &save_triggers },
+	{ "job_state", &save_jobs },
+	{ "job_state.journal", &save_jobs },
+	{ NULL, NULL }
+};
+
+/* State files queued for the writer thread */
+static pthread_mutex_t writer_mutex = PTHREAD_MUTEX_INITIALIZER;
+static pthread_cond_t writer_cond = PTHREAD_COND_INITIALIZER;
+static pthread_cond_t writer_done_cond = PTHREAD_COND_INITIALIZER;
+static state_file_t *writer_head = NULL, *writer_tail = NULL;
+static pthread_t writer_thread = 0;
+static bool writer_shutdown = false;
+
+/* Statistics by state file name, writer_mutex set */
+static state_file_stats_t *file_stats = NULL;
+static uint32_t file_stats_cnt = 0;
+/* Result of the last write of each state file, indexed like file_stats */
+static int *file_rc = NULL;
+
+extern uint64_t state_save_usec_since(const struct timespec *start)
+{
+	struct timespec now;
+
+	clock_gettime(CLOCK_MONOTONIC, &now);
+	if ((now.tv_sec < start->tv_sec) ||
+	    ((now.tv_sec == start->tv_sec) && (now.tv_nsec < start->tv_nsec)))
+		return 0;
+	return ((uint64_t) (now.tv_sec - start->tv_sec) * USEC_IN_SEC) +
+	       ((now.tv_nsec - start->tv_nsec) / NSEC_IN_USEC);
+}
+
+/* Find or add the statistics of a state file, writer_mutex set */
+static state_file_stats_t *_find_stats(const char *name)
+{
+	int i;
+
+	for (i = 0; i < file_stats_cnt; i++) {
+		if (!xstrcmp(file_stats[i].name, name))
+			return &file_stats[i];
+	}
+	xrecalloc(file_stats, file_stats_cnt + 1, sizeof(state_file_stats_t));
+	xrecalloc(file_rc, file_stats_cnt + 1, sizeof(int));
+	file_stats[file_stats_cnt].name = xstrdup(name);
+	return &file_stats[file_stats_cnt++];
+}
+
+static void _free_file(state_file_t *file)
+{
+	if (file->buffer)
+		free_buf(file->buffer);
+	xfree(file->name);
+	xfree(file->reg_file);
+	xfree(file);
+}
+
+/* Create or open a state file and write its buffer, RET 0 or errno */
+static int _write_file(state_file_t *file)
+{
+	char *path, *data;
+	int flags = O_WRONLY | O_CLOEXEC, pos = 0, nwrite, amount;
+
+	if (file->mode == STATE_FILE_APPEND) {
+		/* Never create a file which only makes sense appended to */
+		path = xstrdup(file->reg_file);
+		flags |= O_APPEND;
+	} else {
+		path = xstrdup_printf("%s.new", file->reg_file);
+		flags |= O_CREAT | O_TRUNC;
+	}
+
+	if ((file->fd = open(path, flags, 0600)) < 0) {
+		error("Can't save state, error opening file %s %m", path);
+		xfree(path);
+		return errno;
+	}
+
+	nwrite = get_buf_offset(file->buffer);
+	data = get_buf_data(file->buffer);
+	while (nwrite > 0) {
+		amount = write(file->fd, &data[pos], nwrite);
+		if ((amount < 0) && (errno != EINTR)) {
+			error("Error writing file %s, %m", path);
+			xfree(path);
+			return errno;
+		}
+		if (amount < 0)
+			continue;
+		nwrite -= amount;
+		pos    += amount;
+	}
+	xfree(path);
+
+#ifdef SYNC_FILE_RANGE_WRITE
+	/* Start writeback now, the file is synced once the batch is written */
+	(void) sync_file_range(file->fd, 0, 0, SYNC_FILE_RANGE_WRITE);
+#endif
+	return SLURM_SUCCESS;
+}
+
+/*
+ * Sync a written state file and move it in place. Only moving it in place
+ * changes the registered file, so only that is done with the state files
+ * locked.
+ */
+static void _finish_file(state_file_t *file)
+{
+	char *new_file = NULL, *old_file = NULL;
+	int rc;
+
+	if (file->fd >= 0) {
+		rc = fsync_and_close(file->fd, file->name);
+		if (rc && !file->rc)
+			file->rc = rc;
+	}
+	if (file->mode == STATE_FILE_APPEND)
+		return;
+
+	new_file = xstrdup_printf("%s.new", file->reg_file);
+	if (file->rc) {
+		(void) unlink(new_file);
+		xfree(new_file);
+		return;
+	}
+
+	lock_state_files();
+	if (file->mode == STATE_FILE_REPLACE) {
+		if (rename(new_file, file->reg_file)) {
+			error("Can't save state, rename %s to %s error %m",
+			      new_file, file->reg_file);
+			file->rc = errno;
+			(void) unlink(new_file);
+		}
+	} else {		/* file shuffle */
+		old_file = xstrdup_printf("%s.old", file->reg_file);
+		(void) unlink(old_file);
+		if (link(file->reg_file, old_file))
+			debug4("unable to create link for %s -> %s: %m",
+			       file->reg_file, old_file);
+		(void) unlink(file->reg_file);
+		if (link(new_file, file->reg_file))
+			debug4("unable to create link for %s -> %s: %m",
+			       new_file, file->reg_file);
+		(void) unlink(new_file);
+	}
+	unlock_state_files();
+	xfree(new_file);
+	xfree(old_file);
+}
+
+/*
+ * Write a batch of state files. All files are written before any is synced,
+ * so the writeback of the batch overlaps rather than one fsync() waiting
+ * for the next. The state files are only locked while a registered file is
+ * changed, by appending to it or renaming a new file in its place.
+ */
+static void _write_batch(state_file_t *batch)
+{
+	state_file_t *file;
+	state_file_stats_t *stats;
+	uint64_t usec;
+
+	for (file = batch; file; file = file->next) {
+		clock_gettime(CLOCK_MONOTONIC, &file->start);
+		file->fd = -1;
+		if (file->mode == STATE_FILE_APPEND) {
+			lock_state_files();
+			file->rc = _write_file(file);
+			unlock_state_files();
+		} else {
+			file->rc = _write_file(file);
+		}
+	}
+	for (file = batch; file; file = file->next)
+		_finish_file(file);
+
+	slurm_mutex_lock(&writer_mutex);
+	for (file = batch; file; file = file->next) {
+		usec = state_save_usec_since(&file->start);
+		stats = _find_stats(file->name);
+		file_rc[stats - file_stats] = file->rc;
+		stats->written++;
+		stats->io_usec += usec;
+		stats->io_max_usec = MAX(stats->io_max_usec,
+					 MIN(usec, INFINITE - 1));
+		stats->size = get_buf_offset(file->buffer);
+		free_buf(file->buffer);
+		file->buffer = NULL;
+	}
+	slurm_mutex_unlock(&writer_mutex);
+}
+
+/*
+ * Queue the save of a state file again which could not be written, it is
+ * retried after SAVE_MAX_WAIT unless the state save thread is shutting down
+ */
+static void _save_failed(const char *name)
+{
+	int i;
+
+	slurm_mutex_lock(&state_save_lock);
+	for (i = 0; save_retry[i].name; i++) {
+		if (!xstrcmp(save_retry[i].name, name) && run_save_thread) {
+			(*save_retry[i].save_cnt)++;
+			slurm_cond_broadcast(&state_save_cond);
+			break;
+		}
+	}
+	slurm_mutex_unlock(&state_save_lock);
+}
+
+static void *_writer(void *arg)
+{
+	state_file_t *batch, *file;
+
+#if HAVE_SYS_PRCTL_H
+	if (prctl(PR_SET_NAME, "sstatewr", NULL, NULL, NULL) < 0) {
+		error("%s: cannot set my name to %s %m", __func__, "sstatewr");
+	}
+#endif
+
+	slurm_mutex_lock(&writer_mutex);
+	while (1) {
+		if (!writer_head) {
+			if (writer_shutdown)
+				break;
+			slurm_cond_wait(&writer_cond, &writer_mutex);
+			continue;
+		}
+		batch = writer_head;
+		writer_head = writer_tail = NULL;
+		slurm_mutex_unlock(&writer_mutex);
+
+		_write_batch(batch);
+
+		/* Nobody waits for these files to learn they failed */
+		for (file = batch; file; file = file->next) {
+			if (file->rc && !file->wait)
+				_save_failed(file->name);
+		}
+
+		slurm_mutex_lock(&writer_mutex);
+		while ((file = batch)) {
+			batch = file->next;
+			if (file->wait)
+				file->done = true;
+			else
+				_free_file(file);
+		}
+		slurm_cond_broadcast(&writer_done_cond);
+	}
+	slurm_mutex_unlock(&writer_mutex);
+
+	return NULL;
+}
+
+static void _writer_init(void)
+{
+	slurm_mutex_lock(&writer_mutex);
+	writer_shutdown = false;
+	slurm_thread_create(&writer_thread, _writer, NULL);
+	slurm_mutex_unlock(&writer_mutex);
+}
+
+/* Write all queued files, then end the writer thread */
+static void _writer_fini(void)
+{
+	pthread_t tid;
+
+	slurm_mutex_lock(&writer_mutex);
+	writer_shutdown = true;
+	tid = writer_thread;
+	slurm_cond_signal(&writer_cond);
+	slurm_mutex_unlock(&writer_mutex);
+
+	if (tid)
+		pthread_join(tid, NULL);
+
+	slurm_mutex_lock(&writer_mutex);
+	writer_thread = 0;
+	slurm_mutex_unlock(&writer_mutex);
+}
+
+extern int state_file_write(const char *name, state_file_mode_t mode,
+			    Buf buffer, uint64_t lock_usec, bool wait)
+{
+	/* Locks: Read config */
+	slurmctld_lock_t config_read_lock =
+		{ READ_LOCK, NO_LOCK, NO_LOCK, NO_LOCK, NO_LOCK };
+	state_file_stats_t *stats;
+	state_file_t *file, *queued;
+	int rc = SLURM_SUCCESS;
+
+	xassert(wait || (mode != STATE_FILE_APPEND));
+
+	file = xmalloc(sizeof(state_file_t));
+	file->name = xstrdup(name);
+	file->mode = mode;
+	file->buffer = buffer;
+	file->wait = wait;
+	lock_slurmctld(config_read_lock);
+	file->reg_file = xstrdup_printf("%s/%s",
+					slurmctld_conf.state_save_location,
+					name);
+	unlock_slurmctld(config_read_lock);
+
+	slurm_mutex_lock(&writer_mutex);
+	stats = _find_stats(name);
+	stats->packed++;
+	stats->lock_usec += lock_usec;
+	stats->lock_max_usec = MAX(stats->lock_max_usec,
+				   MIN(lock_usec, INFINITE - 1));
+
+	if (!writer_thread) {
+		/* No state save thread running, write the file here */
+		slurm_mutex_unlock(&writer_mutex);
+		_write_batch(file);
+		rc = file->rc;
+		_free_file(file);
+		return rc;
+	}
+
+	if (!wait) {
+		/* Report a failed write of the previous state of this file */
+		rc = file_rc[stats - file_stats];
+		for (queued = writer_head; queued; queued = queued->next) {
+			if (queued->wait || xstrcmp(queued->name, name))
+				continue;
+			/* Not being written yet, write the newer state */
+			free_buf(queued->buffer);
+			queued->buffer = buffer;
+			file->buffer = NULL;
+			_free_file(file);
+			slurm_mutex_unlock(&writer_mutex);
+			return rc;
+		}
+	}
+
+	if (writer_tail)
+		writer_tail->next = file;
+	else
+		writer_head = file;
+	writer_tail = file;
+	slurm_cond_signal(&writer_cond);
+
+	if (wait) {
+		while (!file->done)
+			slurm_cond_wait(&writer_done_cond, &writer_mutex);
+		rc = file->rc;
+		_free_file(file);
+	}
+	slurm_mutex_unlock(&writer_mutex);
+
+	return rc;
+}
+
+extern void state_save_pack_stats(Buf buffer, uint16_t protocol_version)
+{
+	state_file_stats_t *stats;
+	int i;
+
+	if (protocol_version < SLURM_20_02_VISIONS_PROTOCOL_VERSION)
+		return;
+
+	slurm_mutex_lock(&writer_mutex);
+	pack32(file_stats_cnt, buffer);
+	for (i = 0, stats = file_stats; i < file_stats_cnt; i++, stats++) {
+		packstr(stats->name, buffer);
+		pack32(stats->packed, buffer);
+		pack32(stats->written, buffer);
+		pack64(stats->lock_usec, buffer);
+		pack32(stats->lock_max_usec, buffer);
+		pack64(stats->io_usec, buffer);
+		pack32(stats->io_max_usec, buffer);
+		pack32(stats->size, buffer);
+	}
+	slurm_mutex_unlock(&writer_mutex);
+}
+
+extern void state_save_reset_stats(void)
+{
+	state_file_stats_t *stats;
+	int i;
+
+	slurm_mutex_lock(&writer_mutex);
+	for (i = 0, stats = file_stats; i < file_stats_cnt; i++, stats++) {
+		stats->packed = 0;
+		stats->written = 0;
+		stats->lock_usec = 0;
+		stats->lock_max_usec = 0;
+		stats->io_usec = 0;
+		stats->io_max_usec = 0;
+	}
+	slurm_mutex_unlock(&writer_mutex);
+}
+
 
 /* Queue saving of front_end state information */
 extern void schedule_front_end_save(void)
@@ -149,6 +577,8 @@ extern void *slurmctld_state_save(void *no_data)
 	if (test_config)	/* Should be redundant, but just to be safe */
 		return NULL;
 
+	_writer_init();
+
 	while (1) {
 		/* wait for work to perform */
 		slurm_mutex_lock(&state_save_lock);
@@ -166,6 +596,7 @@ extern void *slurmctld_state_save(void *no_data)
 			} else if (!run_save_thread) {
 				run_save_thread = true;
 				slurm_mutex_unlock(&state_save_lock);
+				_writer_fini();
 				return NULL;	/* shutdown */
 			} else if (save_count) { /* wait for a timeout */
 				struct timespec ts = {0, 0};
@@ -189,17 +620,6 @@ extern void *slurmctld_state_save(void *no_data)
 		if (run_save)
 			(void)dump_all_front_end_state();
 
-		/* save job info if necessary */
-		run_save = false;
-		slurm_mutex_lock(&state_save_lock);
-		if (save_jobs) {
-			run_save = true;
-			save_jobs = 0;
-		}
-		slurm_mutex_unlock(&state_save_lock);
-		if (run_save)
-			(void)dump_all_job_state();
-
 		/* save node info if necessary */
 		run_save = false;
 		slurm_mutex_lock(&state_save_lock);
@@ -243,5 +663,20 @@ extern void *slurmctld_state_save(void *no_data)
 		slurm_mutex_unlock(&state_save_lock);
 		if (run_save)
 			(void)trigger_state_save();
+
+		/*
+		 * save job info if necessary, last as it waits for the job
+		 * state files to be written, packing them while the files
+		 * queued above are being written
+		 */
+		run_save = false;
+		slurm_mutex_lock(&state_save_lock);
+		if (save_jobs) {
+			run_save = true;
+			save_jobs = 0;
+		}
+		slurm_mutex_unlock(&state_save_lock);
+		if (run_save && dump_all_job_state())
+			_save_failed("job_state");
 	}
 }
@@ -40,6 +40,19 @@
 #ifndef _SLURMCTLD_STATE_SAVE_H
 #define _SLURMCTLD_STATE_SAVE_H
 
+#include <stdbool.h>
+#include <stdint.h>
+#include <time.h>
+
+#include "src/common/pack.h"
+
+/* How state_file_write() writes a state file */
+typedef enum {
+	STATE_FILE_BACKUP,	/* replace, keep the previous file as .old */
+	STATE_FILE_REPLACE,	/* replace the file */
+	STATE_FILE_APPEND,	/* append to the existing file */
+} state_file_mode_t;
+
 /* Queue saving of front_end state information */
 extern void schedule_front_end_save(void);
 
@@ -61,6 +74,31 @@ extern void schedule_trigger_save(void);
 /* shutdown the slurmctld_state_save thread */
 extern void shutdown_state_save(void);
 
+/*
+ * state_file_write - Write a packed state file in StateSaveLocation
+ *	Files are written, synced and renamed by a writer thread while the
+ *	state save thread packs the next file. A buffer queued without waiting
+ *	replaces the one of the same file not yet being written.
+ * IN name - file name, such as "node_state"
+ * IN mode - how to write the file
+ * IN buffer - packed state, freed once written
+ * IN lock_usec - time locks were held to pack the state, for statistics
+ * IN wait - wait until the file is written, required for STATE_FILE_APPEND
+ * RET 0 or error code writing the file, if not waiting the error code of
+ *	the last write of this file which finished
+ * NOTE: Call without slurmctld locks or state files locked
+ */
+extern int state_file_write(const char *name, state_file_mode_t mode,
+			    Buf buffer, uint64_t lock_usec, bool wait);
+
+/* Return the microseconds since a CLOCK_MONOTONIC time, such as when locks
+ * were acquired to pack a state file */
+extern uint64_t state_save_usec_since(const struct timespec *start);
+
+/* Pack or reset the lock and I/O time statistics of the state files */
+extern void state_save_pack_stats(Buf buffer, uint16_t protocol_version);
+extern void state_save_reset_stats(void);
+
 /*
  * Run as pthread to keep saving slurmctld state information as needed,
  * Use schedule_job_save(), schedule_node_save(), schedule_part_save(),
@@ -39,14 +39,48 @@
 #include <stdio.h>
 
 #include "src/slurmctld/agent.h"
+#include "src/slurmctld/locks.h"
+#include "src/slurmctld/rpc_pool.h"
 #include "src/slurmctld/slurmctld.h"
+#include "src/slurmctld/state_save.h"
 #include "src/common/list.h"
+#include "src/common/lock_stats.h"
 #include "src/common/pack.h"
 #include "src/common/xstring.h"
 #include "src/common/slurmdbd_defs.h"
 
 extern int retry_list_size(void);
 
+/* Pack the statistics unknown to stock 20.02 */
+static void _pack_visions_stats(Buf buffer, uint16_t protocol_version)
+{
+	job_rec_lock_stats_t job_rec_lock_stats;
+
+	pack32(slurmctld_diag_stats.bf_plan_full, buffer);
+	pack32(slurmctld_diag_stats.bf_plan_incr, buffer);
+	pack32(slurmctld_diag_stats.bf_plan_last_reused, buffer);
+	pack32(slurmctld_diag_stats.bf_plan_reused_sum, buffer);
+
+	pack32(slurmctld_diag_stats.job_info_cache_hits, buffer);
+	pack32(slurmctld_diag_stats.job_info_cache_misses, buffer);
+	pack32(slurmctld_diag_stats.node_info_cache_hits, buffer);
+	pack32(slurmctld_diag_stats.node_info_cache_misses, buffer);
+	pack32(slurmctld_diag_stats.part_info_cache_hits, buffer);
+	pack32(slurmctld_diag_stats.part_info_cache_misses, buffer);
+
+	get_job_rec_lock_stats(&job_rec_lock_stats);
+	pack32((uint32_t) job_rec_locking(), buffer);
+	pack32(job_rec_lock_stats.rpc_cnt, buffer);
+	pack64(job_rec_lock_stats.lock_cnt, buffer);
+	pack64(job_rec_lock_stats.wait_cnt, buffer);
+	pack64(job_rec_lock_stats.wait_usec, buffer);
+	pack32(job_rec_lock_stats.wait_max_usec, buffer);
+
+	lock_stats_pack(buffer, protocol_version);
+	rpc_pool_pack_stats(buffer, protocol_version);
+	state_save_pack_stats(buffer, protocol_version);
+}
+
 /* Pack all scheduling statistics */
 extern void pack_all_stat(int resp, char **buffer_ptr, int *buffer_size,
 			  uint16_t protocol_version)
@@ -140,6 +174,10 @@ extern void pack_all_stat(int resp, char **buffer_ptr, int *buffer_size,
 			pack32(slurmctld_diag_stats.bf_active, buffer);
 			pack32(slurmctld_diag_stats.backfilled_het_jobs,
 			       buffer);
+
+			if (protocol_version >=
+			    SLURM_20_02_VISIONS_PROTOCOL_VERSION)
+				_pack_visions_stats(buffer, protocol_version);
 		}
 	} else if (protocol_version >= SLURM_MIN_PROTOCOL_VERSION) {
 		parts_packed = resp;
@@ -246,6 +284,22 @@ extern void reset_stats(int level)
 	slurmctld_diag_stats.bf_cycle_max = 0;
 	slurmctld_diag_stats.bf_last_depth = 0;
 	slurmctld_diag_stats.bf_last_depth_try = 0;
+	slurmctld_diag_stats.bf_plan_full = 0;
+	slurmctld_diag_stats.bf_plan_incr = 0;
+	slurmctld_diag_stats.bf_plan_last_reused = 0;
+	slurmctld_diag_stats.bf_plan_reused_sum = 0;
+
+	slurmctld_diag_stats.job_info_cache_hits = 0;
+	slurmctld_diag_stats.job_info_cache_misses = 0;
+	slurmctld_diag_stats.node_info_cache_hits = 0;
+	slurmctld_diag_stats.node_info_cache_misses = 0;
+	slurmctld_diag_stats.part_info_cache_hits = 0;
+	slurmctld_diag_stats.part_info_cache_misses = 0;
+
+	reset_job_rec_lock_stats();
+	lock_stats_reset();
+	rpc_pool_reset_stats();
+	state_save_reset_stats();
 
 	last_proc_req_start = time(NULL);
 }
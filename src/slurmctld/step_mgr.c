@@ -179,7 +179,7 @@ static step_record_t *_create_step_record(job_record_t *job_ptr,
 
 	step_ptr = xmalloc(sizeof(*step_ptr));
 
-	last_job_update = time(NULL);
+	job_state_changed(job_ptr, time(NULL));
 	step_ptr->job_ptr    = job_ptr;
 	step_ptr->exit_code  = NO_VAL;
 	step_ptr->time_limit = INFINITE;
@@ -315,7 +315,7 @@ extern void delete_step_records(job_record_t *job_ptr)
 
 	xassert(job_ptr);
 
-	last_job_update = time(NULL);
+	job_state_changed(job_ptr, time(NULL));
 	step_iterator = list_iterator_create(job_ptr->step_list);
 	while ((step_ptr = list_next(step_iterator))) {
 		/* Only check if not a pending step */
@@ -425,7 +425,7 @@ int delete_step_record(job_record_t *job_ptr, uint32_t step_id)
 	if (!job_ptr->step_list)
 		return error_code;
 
-	last_job_update = time(NULL);
+	job_state_changed(job_ptr, time(NULL));
 	step_iterator = list_iterator_create (job_ptr->step_list);
 	while ((step_ptr = list_next(step_iterator))) {
 		if (step_ptr->step_id != step_id)
@@ -826,7 +826,7 @@ int job_step_complete(uint32_t job_id, uint32_t step_id, uid_t uid,
 
 	_internal_step_complete(job_ptr, step_ptr);
 
-	last_job_update = time(NULL);
+	job_state_changed(job_ptr, time(NULL));
 
 	return SLURM_SUCCESS;
 }
@@ -2397,6 +2397,9 @@ extern int step_create(job_step_create_request_msg_t *step_specs,
 	slurm_step_layout_t *step_layout = NULL;
 	bool tmp_step_layout_used = false;
 
+	/* May run beneath the job read lock with fine grained job locks */
+	xassert(verify_job_rec_lock(step_specs->job_id));
+
 	*new_step_record = NULL;
 	job_ptr = find_job_record (step_specs->job_id);
 	if (job_ptr == NULL)
@@ -3303,6 +3306,7 @@ extern int pack_ctld_job_step_info_response_msg(
 		      (mcs_g_check_mcs_label(uid, job_ptr->mcs_label) != 0))))
 			continue;
 
+		lock_job_rec(job_ptr->job_id);
 		step_iterator = list_iterator_create(job_ptr->step_list);
 		while ((step_ptr = list_next(step_iterator))) {
 			if ((step_id != NO_VAL) &&
@@ -3313,6 +3317,7 @@ extern int pack_ctld_job_step_info_response_msg(
 			steps_packed++;
 		}
 		list_iterator_destroy(step_iterator);
+		unlock_job_rec(job_ptr->job_id);
 	}
 	list_iterator_destroy(job_iterator);
 
@@ -3549,7 +3554,8 @@ extern void step_set_alloc_tres(step_record_t *step_ptr, uint32_t node_count,
 	char *tmp_tres_str = NULL;
 
 	xassert(step_ptr);
-	xassert(verify_lock(JOB_LOCK, WRITE_LOCK));
+	/* Called by step_create() beneath the lock of the job's record */
+	xassert(verify_job_rec_lock(step_ptr->job_ptr->job_id));
 
 	xfree(step_ptr->tres_alloc_str);
 	xfree(step_ptr->tres_fmt_alloc_str);
@@ -4412,7 +4418,7 @@ extern int update_step(step_update_request_msg_t *req, uid_t uid)
 		}
 	}
 	if (mod_cnt)
-		last_job_update = time(NULL);
+		job_state_changed(job_ptr, time(NULL));
 	if (new_step) {
 		/*
 		 * This was a temporary step record, never linked to the job,
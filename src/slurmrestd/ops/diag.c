@@ -56,13 +56,16 @@ typedef enum {
 	URL_TAG_UNKNOWN = 0,
 	URL_TAG_DIAG,
 	URL_TAG_PING,
+	URL_TAG_LICENSES,
+	URL_TAG_LOCKS,
 } url_tag_t;
 
 static int _op_handler_diag(const char *context_id,
 			    http_request_method_t method, data_t *parameters,
 			    data_t *query, int tag, data_t *resp_ptr)
 {
-	int rc;
+	int rc, i;
+	data_t *rpc_classes, *state_files;
 	stats_info_response_msg_t *resp = NULL;
 	stats_info_request_msg_t *req = xmalloc(sizeof(*req));
 	req->command_id = STAT_COMMAND_GET;
@@ -130,6 +133,65 @@ static int _op_handler_diag(const char *context_id,
 	data_set_int(data_key_set(d, "bf_when_last_cycle"),
 		     resp->bf_when_last_cycle);
 	data_set_int(data_key_set(d, "bf_active"), resp->bf_active);
+	data_set_int(data_key_set(d, "bf_plan_full"), resp->bf_plan_full);
+	data_set_int(data_key_set(d, "bf_plan_incr"), resp->bf_plan_incr);
+	data_set_int(data_key_set(d, "bf_plan_last_reused"),
+		     resp->bf_plan_last_reused);
+	data_set_int(data_key_set(d, "bf_plan_reused_sum"),
+		     resp->bf_plan_reused_sum);
+	data_set_int(data_key_set(d, "job_info_cache_hits"),
+		     resp->job_info_cache_hits);
+	data_set_int(data_key_set(d, "job_info_cache_misses"),
+		     resp->job_info_cache_misses);
+	data_set_int(data_key_set(d, "node_info_cache_hits"),
+		     resp->node_info_cache_hits);
+	data_set_int(data_key_set(d, "node_info_cache_misses"),
+		     resp->node_info_cache_misses);
+	data_set_int(data_key_set(d, "part_info_cache_hits"),
+		     resp->part_info_cache_hits);
+	data_set_int(data_key_set(d, "part_info_cache_misses"),
+		     resp->part_info_cache_misses);
+	data_set_bool(data_key_set(d, "job_rec_locks"), resp->job_rec_locks);
+	data_set_int(data_key_set(d, "job_rec_lock_rpcs"),
+		     resp->job_rec_lock_rpcs);
+	data_set_int(data_key_set(d, "job_rec_lock_cnt"),
+		     resp->job_rec_lock_cnt);
+	data_set_int(data_key_set(d, "job_rec_lock_wait_cnt"),
+		     resp->job_rec_lock_wait_cnt);
+	data_set_int(data_key_set(d, "job_rec_lock_wait_usec"),
+		     resp->job_rec_lock_wait_usec);
+	data_set_int(data_key_set(d, "job_rec_lock_wait_max"),
+		     resp->job_rec_lock_wait_max);
+	data_set_int(data_key_set(d, "rpc_workers"), resp->rpc_workers);
+	rpc_classes = data_set_list(data_key_set(d, "rpc_classes"));
+	for (i = 0; i < resp->rpc_class_cnt; i++) {
+		rpc_class_stats_t *rec = &resp->rpc_class_stats[i];
+		data_t *c = data_set_dict(data_list_append(rpc_classes));
+
+		data_set_string(data_key_set(c, "name"), rec->name);
+		data_set_int(data_key_set(c, "max_workers"), rec->max_workers);
+		data_set_int(data_key_set(c, "active"), rec->active);
+		data_set_int(data_key_set(c, "queued"), rec->queued);
+		data_set_int(data_key_set(c, "count"), rec->cnt);
+		data_set_int(data_key_set(c, "wait_usec"), rec->wait_usec);
+		data_set_int(data_key_set(c, "wait_max_usec"),
+			     rec->wait_max_usec);
+	}
+	state_files = data_set_list(data_key_set(d, "state_files"));
+	for (i = 0; i < resp->state_file_cnt; i++) {
+		state_file_stats_t *rec = &resp->state_file_stats[i];
+		data_t *f = data_set_dict(data_list_append(state_files));
+
+		data_set_string(data_key_set(f, "name"), rec->name);
+		data_set_int(data_key_set(f, "packed"), rec->packed);
+		data_set_int(data_key_set(f, "written"), rec->written);
+		data_set_int(data_key_set(f, "lock_usec"), rec->lock_usec);
+		data_set_int(data_key_set(f, "lock_max_usec"),
+			     rec->lock_max_usec);
+		data_set_int(data_key_set(f, "io_usec"), rec->io_usec);
+		data_set_int(data_key_set(f, "io_max_usec"), rec->io_max_usec);
+		data_set_int(data_key_set(f, "size"), rec->size);
+	}
 
 cleanup:
 	if (rc) {
@@ -144,6 +206,126 @@ cleanup:
 	return rc;
 }
 
+static void _dump_lock_times(data_t *d, uint64_t usec, uint32_t max_usec,
+			     uint32_t *hist)
+{
+	data_t *h;
+	int i;
+
+	data_set_int(data_key_set(d, "total"), usec);
+	data_set_int(data_key_set(d, "max"), max_usec);
+	h = data_set_list(data_key_set(d, "histogram"));
+	for (i = 0; i < LOCK_STATS_HIST_CNT; i++)
+		data_set_int(data_list_append(h), hist[i]);
+}
+
+static int _op_handler_locks(const char *context_id,
+			     http_request_method_t method, data_t *parameters,
+			     data_t *query, int tag, data_t *resp_ptr)
+{
+	int rc, i;
+	uint64_t limit = 1;
+	stats_info_response_msg_t *resp = NULL;
+	stats_info_request_msg_t *req = xmalloc(sizeof(*req));
+	req->command_id = STAT_COMMAND_GET;
+
+	data_t *p = data_set_dict(resp_ptr);
+	data_t *errors = data_set_list(data_key_set(p, "errors"));
+	data_t *limits = data_set_list(data_key_set(p, "histogram_limits"));
+	data_t *locks = data_set_list(data_key_set(p, "locks"));
+	debug4("%s:[%s] locks handler called", __func__, context_id);
+
+	if ((rc = slurm_get_statistics(&resp, req)))
+		goto cleanup;
+
+	/* Upper limits of the histogram buckets in usec, none for the last */
+	for (i = 0; i < (LOCK_STATS_HIST_CNT - 1); i++, limit *= 10)
+		data_set_int(data_list_append(limits), limit);
+
+	for (i = 0; i < resp->lock_stats_cnt; i++) {
+		lock_stats_t *rec = &resp->lock_stats[i];
+		data_t *d = data_set_dict(data_list_append(locks));
+
+		data_set_string(data_key_set(d, "lock"), rec->lock);
+		data_set_string(data_key_set(d, "level"),
+				rec->write ? "write" : "read");
+		data_set_string(data_key_set(d, "caller"), rec->caller);
+		data_set_int(data_key_set(d, "count"), rec->cnt);
+		_dump_lock_times(data_set_dict(data_key_set(d, "wait")),
+				 rec->wait_usec, rec->wait_max_usec,
+				 rec->wait_hist);
+		_dump_lock_times(data_set_dict(data_key_set(d, "hold")),
+				 rec->hold_usec, rec->hold_max_usec,
+				 rec->hold_hist);
+	}
+
+cleanup:
+	if (rc) {
+		data_t *e = data_set_dict(data_list_append(errors));
+		data_set_string(data_key_set(e, "error"),
+				slurm_strerror(rc));
+		data_set_int(data_key_set(e, "errno"), rc);
+	}
+
+	slurm_free_stats_response_msg(resp);
+	xfree(req);
+	return rc;
+}
+
+static int _op_handler_licenses(const char *context_id,
+				http_request_method_t method,
+				data_t *parameters, data_t *query, int tag,
+				data_t *resp_ptr)
+{
+	int rc, i;
+	license_usage_msg_t *lic_usage = NULL;
+	slurm_license_usage_t *lic;
+
+	data_t *p = data_set_dict(resp_ptr);
+	data_t *errors = data_set_list(data_key_set(p, "errors"));
+	data_t *lics = data_set_list(data_key_set(p, "licenses"));
+	debug4("%s:[%s] licenses handler called", __func__, context_id);
+
+	if (slurm_load_license_usage(0, &lic_usage)) {
+		rc = errno;
+		goto cleanup;
+	}
+	rc = SLURM_SUCCESS;
+
+	data_set_int(data_key_set(p, "last_update"), lic_usage->last_update);
+	for (i = 0; i < lic_usage->num_lic; i++) {
+		data_t *d = data_set_dict(data_list_append(lics));
+		lic = &lic_usage->lic_array[i];
+
+		data_set_string(data_key_set(d, "name"), lic->name);
+		data_set_int(data_key_set(d, "total"), lic->total);
+		data_set_int(data_key_set(d, "in_use"), lic->in_use);
+		data_set_int(data_key_set(d, "reserved"), lic->reserved);
+		data_set_int(data_key_set(d, "available"), lic->available);
+		data_set_bool(data_key_set(d, "remote"), lic->remote);
+		if (!lic->members)
+			continue;
+		data_set_string(data_key_set(d, "members"), lic->members);
+		data_set_string(data_key_set(d, "in_use_members"),
+				lic->in_use_members);
+		data_set_string(data_key_set(d, "reserved_members"),
+				lic->reserved_members);
+		data_set_string(data_key_set(d, "available_members"),
+				lic->avail_members);
+	}
+
+cleanup:
+	if (rc) {
+		data_t *e = data_set_dict(data_list_append(errors));
+		data_set_string(data_key_set(e, "error"),
+				slurm_strerror(rc));
+		data_set_int(data_key_set(e, "errno"), rc);
+	}
+
+	slurm_free_license_usage_msg(lic_usage);
+	return rc;
+}
+
 #define _ping_error(...)                                                     \
 	do {                                                                 \
 		const char *error_string = xstrdup_printf(__VA_ARGS__);      \
@@ -217,14 +399,24 @@ extern int init_op_diag(void)
 	if ((rc = bind_operation_handler("/slurm/v0.0.35/diag/",
 					     _op_handler_diag, URL_TAG_DIAG)))
 		/* no-op */;
+	else if ((rc = bind_operation_handler("/slurm/v0.0.35/diag/locks/",
+					      _op_handler_locks,
+					      URL_TAG_LOCKS)))
+		/* no-op */;
+	else if ((rc = bind_operation_handler("/slurm/v0.0.35/ping/",
+					      _op_handler_ping, URL_TAG_DIAG)))
+		/* no-op */;
 	else
-		rc = bind_operation_handler("/slurm/v0.0.35/ping/",
-						_op_handler_ping, URL_TAG_DIAG);
+		rc = bind_operation_handler("/slurm/v0.0.35/licenses/",
+					    _op_handler_licenses,
+					    URL_TAG_LICENSES);
 	return rc;
 }
 
 extern void destroy_op_diag(void)
 {
 	unbind_operation_handler(_op_handler_diag);
+	unbind_operation_handler(_op_handler_locks);
 	unbind_operation_handler(_op_handler_ping);
+	unbind_operation_handler(_op_handler_licenses);
 }
@@ -0,0 +1,43 @@
+#!/usr/bin/env bash
+
+if [ $# != 5 ]
+then
+	echo "Usage: test9.10.bash <sbatch> <name> <iterations> <wafer> <hwdb>"
+	echo "       if <hwdb> is a directory, job N uses <hwdb>/hwdb.N.yaml"
+	exit 1
+fi
+
+sbatch=$1
+job_name=$2
+job_cnt=$3
+wafer=$4
+hwdb=$5
+
+submit() {
+	if [ -d $hwdb ]
+	then
+		path=$hwdb/hwdb.$1.yaml
+	else
+		path=$hwdb
+	fi
+	$sbatch -J $job_name -H -o /dev/null --wafer=$wafer --hwdb-path=$path --wrap true
+}
+
+inx=0
+while [ $inx -lt $job_cnt ]
+do
+	submit $inx &
+	submit $((inx+1)) &
+	submit $((inx+2)) &
+	submit $((inx+3)) &
+	submit $((inx+4)) &
+
+	submit $((inx+5)) &
+	submit $((inx+6)) &
+	submit $((inx+7)) &
+	submit $((inx+8)) &
+	submit $((inx+9)) &
+	wait
+	inx=$((inx+10))
+done
+exit 0
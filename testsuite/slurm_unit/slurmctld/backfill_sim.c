@@ -0,0 +1,891 @@
+/* What-if simulator of the backfill scheduler, replaying a job trace through
+ * slurmctld on a virtual clock.
+ *
+ * The simulator is slurmctld itself: its job, node and partition code, the
+ * main scheduler of job_scheduler.c, the select plugin configured and
+ * _attempt_backfill() of src/plugins/sched/backfill/backfill.c. Only the
+ * threads and the network are replaced, but for the thread prolog_slurmctld()
+ * starts to launch each job, which the simulator waits for:
+ * - time() returns a virtual clock, which jumps from one event to the next.
+ * - Jobs of the trace are submitted at their submit time as by sbatch, to
+ *   job_allocate().
+ * - The agent sending RPCs to the slurmd is replaced: a batch job launched
+ *   completes after the run time of the trace, no longer than its time
+ *   limit, as by the slurmstepd, then the epilog completes on its nodes.
+ * - The main scheduler runs as the background thread of slurmctld runs it
+ *   (see sim_controller.c), and after epilogs complete.
+ * - A backfill cycle runs as the backfill thread runs it (see
+ *   sim_backfill.c), once bf_interval has passed and something changed.
+ *
+ * The nodes sim[1-NODES] are idle from the start, in a single partition. The
+ * SchedulerParameters of the backfill and main schedulers apply, but those
+ * limiting real time (bf_max_time, bf_yield_interval, bf_yield_sleep and
+ * sched_min_interval) act on the real time taken, not the virtual clock.
+ *
+ *	backfill_sim -n NODES [-c CPUS] [-p PARAMS] [-P DIR] [-v] TRACE
+ *	backfill_sim -n NODES [-c CPUS] [-p PARAMS] [-P DIR] [-v] -s JOBS
+ *
+ * -c CPUS	CPUs of each node (default 1)
+ * -n NODES	Count of nodes
+ * -p PARAMS	SchedulerParameters
+ * -P DIR	PluginDir, if the plugins are not installed yet
+ * -s JOBS	Replay a synthetic workload of JOBS jobs of whole nodes,
+ *		submitted at a rate to keep 95% of the nodes busy, instead
+ *		of a trace
+ * -v		Log errors of slurmctld to stderr, more if repeated
+ *
+ * TRACE is written by
+ *
+ *	sacct -a -X -P -S START -E END --format=JobIDRaw,Priority,Submit,\
+ *	      Start,TimelimitRaw,NNodes,NCPUS,ElapsedRaw
+ *
+ * Jobs without NCPUS get whole nodes. Jobs of the trace which never started,
+ * or which need more nodes or CPUs than there are, are not replayed. A
+ * priority of 0 leaves the priority to priority/basic.
+ *
+ * This is built by make check but not run, as it loads the plugins
+ * configured from PluginDir.
+ */
+#include <dirent.h>
+#include <limits.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <sys/stat.h>
+#include <time.h>
+#include <unistd.h>
+
+#include "src/common/hostlist.h"
+#include "src/common/parse_time.h"
+#include "src/common/slurm_protocol_defs.h"
+#include "src/common/uid.h"
+#include "src/common/xmalloc.h"
+#include "src/common/xstring.h"
+#include "src/slurmctld/agent.h"
+#include "src/slurmctld/job_scheduler.h"
+#include "src/slurmctld/locks.h"
+#include "src/slurmctld/slurmctld.h"
+#include "backfill_sim.h"
+
+#define SIM_NEVER	((time_t) 0x7fffffff)
+#define SIM_BEGIN_TIME	1577836800	/* of synthetic workloads */
+
+#define SIM_EVENT_COMPLETE	1	/* batch script of a job ends */
+#define SIM_EVENT_EPILOG	2	/* epilog of a job ends on a node */
+
+typedef struct {
+	uint32_t trace_id;
+	uint32_t priority;	/* 0 to leave it to the priority plugin */
+	int node_cnt;
+	int cpu_cnt;		/* 0 for whole nodes */
+	time_t submit_time;
+	time_t time_limit;	/* seconds */
+	time_t run_time;	/* seconds, no longer than time_limit */
+
+	uint32_t job_id;	/* 0 until submitted */
+	time_t start_time;	/* 0 until launched */
+	uint32_t cpus;		/* CPUs allocated */
+	bool ended;
+} sim_job_t;
+
+typedef struct {
+	time_t time;
+	uint64_t seq;		/* order of events of the same time */
+	uint16_t type;		/* SIM_EVENT_* */
+	uint32_t job_id;
+	char *node_name;
+} sim_event_t;
+
+typedef struct {
+	int submit_cnt;		/* jobs accepted by slurmctld */
+	int reject_cnt;		/* jobs rejected by slurmctld */
+	int start_cnt;
+	int end_cnt;
+	time_t last_change;	/* of a job or node */
+
+	int bf_cycles;
+	double bf_cpu_ms;	/* CPU time of all cycles */
+	double bf_cpu_ms_max;
+	int sched_passes;
+	double sched_cpu_ms;	/* CPU time of all passes */
+	double sched_cpu_ms_max;
+} sim_stats_t;
+
+time_t sim_now = 0;
+
+static sim_job_t *jobs = NULL;		/* in order of submit time */
+static int job_cnt = 0;
+static sim_job_t **submitted = NULL;	/* in order of job ID */
+static sim_event_t *events = NULL;	/* heap of events by time */
+static int event_cnt = 0;
+static int event_size = 0;
+static uint64_t event_seq = 0;
+static sim_stats_t stats;
+
+/*
+ * The virtual clock of slurmctld. Every call of time() in slurmctld, its
+ * plugins and libslurm resolves to this one, the simulator being linked
+ * with -export-dynamic.
+ */
+extern time_t time(time_t *tloc)
+{
+	struct timespec ts;
+	time_t now = sim_now;
+
+	if (!now) {
+		clock_gettime(CLOCK_REALTIME, &ts);
+		now = ts.tv_sec;
+	}
+	if (tloc)
+		*tloc = now;
+	return now;
+}
+
+/* CPU time of the simulator thread, which schedules, in milliseconds */
+static double _cpu_ms(void)
+{
+	struct timespec ts;
+
+	clock_gettime(CLOCK_THREAD_CPUTIME_ID, &ts);
+	return (ts.tv_sec * 1e3) + (ts.tv_nsec / 1e6);
+}
+
+static bool _event_before(sim_event_t *event1, sim_event_t *event2)
+{
+	if (event1->time != event2->time)
+		return (event1->time < event2->time);
+	return (event1->seq < event2->seq);
+}
+
+static void _event_add(time_t when, uint16_t type, uint32_t job_id,
+		       char *node_name)
+{
+	sim_event_t event;
+	int i, parent;
+
+	if (event_cnt == event_size) {
+		event_size = MAX(1024, event_size * 2);
+		xrecalloc(events, event_size, sizeof(sim_event_t));
+	}
+	event.time = when;
+	event.seq = event_seq++;
+	event.type = type;
+	event.job_id = job_id;
+	event.node_name = node_name;
+	for (i = event_cnt++; i > 0; i = parent) {
+		parent = (i - 1) / 2;
+		if (!_event_before(&event, &events[parent]))
+			break;
+		events[i] = events[parent];
+	}
+	events[i] = event;
+}
+
+/* Remove the first event, which the caller must free the node_name of */
+static void _event_pop(sim_event_t *event)
+{
+	sim_event_t last;
+	int i, child;
+
+	*event = events[0];
+	last = events[--event_cnt];
+	for (i = 0; (child = (2 * i) + 1) < event_cnt; i = child) {
+		if (((child + 1) < event_cnt) &&
+		    _event_before(&events[child + 1], &events[child]))
+			child++;
+		if (!_event_before(&events[child], &last))
+			break;
+		events[i] = events[child];
+	}
+	events[i] = last;
+}
+
+static sim_job_t *_job_find(uint32_t job_id)
+{
+	int lo = 0, hi = stats.submit_cnt - 1, mid;
+
+	while (lo <= hi) {
+		mid = (lo + hi) / 2;
+		if (submitted[mid]->job_id == job_id)
+			return submitted[mid];
+		if (submitted[mid]->job_id < job_id)
+			lo = mid + 1;
+		else
+			hi = mid - 1;
+	}
+	return NULL;
+}
+
+/*
+ * The agent of slurmctld, sending RPCs to the slurmd. Batch job launches
+ * and job terminations are turned into events, other RPCs are dropped.
+ */
+extern void agent_queue_request(agent_arg_t *agent_arg_ptr)
+{
+	batch_job_launch_msg_t *launch_msg;
+	kill_job_msg_t *kill_msg;
+	sim_job_t *job;
+	char *node_name;
+
+	switch (agent_arg_ptr->msg_type) {
+	case REQUEST_BATCH_JOB_LAUNCH:
+		launch_msg = agent_arg_ptr->msg_args;
+		if ((job = _job_find(launch_msg->job_id)) &&
+		    !job->start_time) {
+			job->start_time = sim_now;
+			stats.start_cnt++;
+			stats.last_change = sim_now;
+			_event_add(sim_now + job->run_time, SIM_EVENT_COMPLETE,
+				   job->job_id, NULL);
+		}
+		break;
+	case REQUEST_ABORT_JOB:
+	case REQUEST_KILL_PREEMPTED:
+	case REQUEST_KILL_TIMELIMIT:
+	case REQUEST_TERMINATE_JOB:
+		kill_msg = agent_arg_ptr->msg_args;
+		while ((node_name = hostlist_shift(agent_arg_ptr->hostlist))) {
+			_event_add(sim_now, SIM_EVENT_EPILOG, kill_msg->job_id,
+				   xstrdup(node_name));
+			free(node_name);
+		}
+		break;
+	default:
+		break;
+	}
+
+	hostlist_destroy(agent_arg_ptr->hostlist);
+	xfree(agent_arg_ptr->addr);
+	if (agent_arg_ptr->msg_args)
+		(void) slurm_free_msg_data(agent_arg_ptr->msg_type,
+					   agent_arg_ptr->msg_args);
+	xfree(agent_arg_ptr);
+}
+
+extern void agent_init(void)
+{
+}
+
+extern void *agent(void *args)
+{
+	return NULL;
+}
+
+extern void agent_trigger(int min_wait, bool mail_too)
+{
+}
+
+extern void agent_purge(void)
+{
+}
+
+extern int get_agent_count(void)
+{
+	return 0;
+}
+
+extern int get_agent_thread_count(void)
+{
+	return 0;
+}
+
+extern void agent_pack_pending_rpc_stats(Buf buffer)
+{
+	pack32_array(NULL, 0, buffer);
+	pack32_array(NULL, 0, buffer);
+	pack32_array(NULL, 0, buffer);
+	packstr_array(NULL, 0, buffer);
+}
+
+extern void mail_job_info(job_record_t *job_ptr, uint16_t mail_type)
+{
+}
+
+extern int retry_list_size(void)
+{
+	return 0;
+}
+
+/* Submit a job as _slurm_rpc_submit_batch_job() does */
+static void _job_submit(sim_job_t *job)
+{
+	/* Locks: Read config, read job, read node, read partition */
+	slurmctld_lock_t job_read_lock = {
+		READ_LOCK, READ_LOCK, READ_LOCK, READ_LOCK, READ_LOCK };
+	/* Locks: Read config, write job, write node, read partition, read
+	 * federation */
+	slurmctld_lock_t job_write_lock = {
+		READ_LOCK, WRITE_LOCK, WRITE_LOCK, READ_LOCK, READ_LOCK };
+	job_desc_msg_t *job_desc = xmalloc(sizeof(job_desc_msg_t));
+	job_record_t *job_ptr = NULL;
+	char *err_msg = NULL;
+	uid_t uid = getuid();
+	int rc;
+
+	slurm_init_job_desc_msg(job_desc);
+	job_desc->name = xstrdup("sim");
+	job_desc->alloc_node = xstrdup("sim");
+	job_desc->user_id = uid;
+	job_desc->group_id = getgid();
+	job_desc->script = xstrdup("#!/bin/sh\n");
+	job_desc->env_size = 1;
+	job_desc->environment = xcalloc(2, sizeof(char *));
+	job_desc->environment[0] = xstrdup("SLURM_SIM=1");
+	job_desc->work_dir = xstrdup("/");
+	job_desc->min_nodes = job->node_cnt;
+	job_desc->max_nodes = job->node_cnt;
+	if (job->cpu_cnt)
+		job_desc->min_cpus = job->cpu_cnt;
+	else
+		job_desc->shared = JOB_SHARED_NONE;
+	if (job->time_limit >= YEAR_SECONDS)
+		job_desc->time_limit = INFINITE;
+	else
+		job_desc->time_limit = (job->time_limit + 59) / 60;
+	if (job->priority)
+		job_desc->priority = job->priority;
+	job_desc->het_job_offset = NO_VAL;
+
+	lock_slurmctld(job_read_lock);
+	rc = validate_job_create_req(job_desc, uid, &err_msg);
+	unlock_slurmctld(job_read_lock);
+	xfree(err_msg);
+
+	if (rc == SLURM_SUCCESS) {
+		lock_slurmctld(job_write_lock);
+		rc = job_allocate(job_desc, 0, false, NULL, 0, uid, &job_ptr,
+				  &err_msg, SLURM_PROTOCOL_VERSION);
+		if (job_ptr &&
+		    (!rc || !IS_JOB_FAILED(job_ptr))) {
+			job->job_id = job_ptr->job_id;
+			submitted[stats.submit_cnt++] = job;
+			stats.last_change = sim_now;
+		}
+		unlock_slurmctld(job_write_lock);
+		xfree(err_msg);
+	}
+	slurm_free_job_desc_msg(job_desc);
+
+	if (!job->job_id) {
+		debug("%s: trace job %u: %s", __func__, job->trace_id,
+		      slurm_strerror(rc));
+		stats.reject_cnt++;
+		return;
+	}
+	queue_job_scheduler();
+}
+
+/* Complete a batch job as _slurm_rpc_complete_batch_script() does */
+static void _job_complete(uint32_t job_id)
+{
+	/* Locks: Write job, write node, read federation */
+	slurmctld_lock_t job_write_lock = {
+		NO_LOCK, WRITE_LOCK, WRITE_LOCK, NO_LOCK, READ_LOCK };
+	job_record_t *job_ptr;
+	sim_job_t *job;
+
+	if (!(job = _job_find(job_id)) || job->ended)
+		return;
+	lock_slurmctld(job_write_lock);
+	if ((job_ptr = find_job_record(job_id)))
+		job->cpus = job_ptr->total_cpus;
+	(void) job_complete(job_id, slurmctld_conf.slurm_user_id, false,
+			    false, 0);
+	unlock_slurmctld(job_write_lock);
+	job->ended = true;
+	stats.end_cnt++;
+	stats.last_change = sim_now;
+}
+
+/* Note the end of an epilog as _slurm_rpc_epilog_complete() does */
+static void _job_epilog_complete(uint32_t job_id, char *node_name)
+{
+	/* Locks: Read configuration, write job, write node */
+	slurmctld_lock_t job_write_lock = {
+		READ_LOCK, WRITE_LOCK, WRITE_LOCK, NO_LOCK, NO_LOCK };
+	bool run_scheduler;
+	double cpu_ms;
+
+	lock_slurmctld(job_write_lock);
+	run_scheduler = job_epilog_complete(job_id, node_name, 0);
+	unlock_slurmctld(job_write_lock);
+	stats.last_change = sim_now;
+
+	if (run_scheduler &&
+	    !xstrcasestr(slurmctld_conf.sched_params, "defer")) {
+		cpu_ms = _cpu_ms();
+		(void) schedule(0);
+		cpu_ms = _cpu_ms() - cpu_ms;
+		stats.sched_passes++;
+		stats.sched_cpu_ms += cpu_ms;
+		stats.sched_cpu_ms_max = MAX(stats.sched_cpu_ms_max, cpu_ms);
+		sim_controller_wait();
+	}
+}
+
+static void _events_run(void)
+{
+	sim_event_t event;
+
+	while (event_cnt && (events[0].time <= sim_now)) {
+		_event_pop(&event);
+		if (event.type == SIM_EVENT_COMPLETE)
+			_job_complete(event.job_id);
+		else
+			_job_epilog_complete(event.job_id, event.node_name);
+		xfree(event.node_name);
+	}
+}
+
+/*
+ * Replay the jobs until all have ended, or those left pending did not start
+ * for long after the last job ended
+ */
+static void _simulate(void)
+{
+	time_t next, bf_next = 0, idle_limit;
+	double cpu_ms;
+	int submit_inx = 0;
+	bool pending;
+
+	idle_limit = MAX(sched_interval, sim_backfill_next() - sim_now) * 4;
+	while (true) {
+		pending = (stats.submit_cnt > stats.start_cnt);
+		if ((submit_inx == job_cnt) && !event_cnt &&
+		    (!pending ||
+		     ((sim_now - stats.last_change) > idle_limit)))
+			break;
+
+		next = SIM_NEVER;
+		if (submit_inx < job_cnt)
+			next = jobs[submit_inx].submit_time;
+		if (event_cnt)
+			next = MIN(next, events[0].time);
+		next = MIN(next, sim_controller_next(pending));
+		if (pending && bf_next)
+			next = MIN(next, bf_next);
+		sim_now = MAX(sim_now, next);
+
+		while ((submit_inx < job_cnt) &&
+		       (jobs[submit_inx].submit_time <= sim_now))
+			_job_submit(&jobs[submit_inx++]);
+		sim_controller_wait();
+		_events_run();
+
+		cpu_ms = _cpu_ms();
+		if (sim_controller_background()) {
+			cpu_ms = _cpu_ms() - cpu_ms;
+			stats.sched_passes++;
+			stats.sched_cpu_ms += cpu_ms;
+			stats.sched_cpu_ms_max = MAX(stats.sched_cpu_ms_max,
+						     cpu_ms);
+			sim_controller_wait();
+		}
+
+		if ((stats.submit_cnt == stats.start_cnt) ||
+		    (sim_now < bf_next))
+			continue;
+		/*
+		 * Once bf_interval has passed, the backfill thread tries every
+		 * second until something has changed. Nothing changes before
+		 * the next event, so try then (bf_next of 0).
+		 */
+		cpu_ms = _cpu_ms();
+		if (sim_backfill_try()) {
+			cpu_ms = _cpu_ms() - cpu_ms;
+			stats.bf_cycles++;
+			stats.bf_cpu_ms += cpu_ms;
+			stats.bf_cpu_ms_max = MAX(stats.bf_cpu_ms_max, cpu_ms);
+			sim_controller_wait();
+			bf_next = sim_backfill_next();
+		} else if (sim_now < sim_backfill_next()) {
+			bf_next = sim_backfill_next();
+		} else {
+			bf_next = 0;
+		}
+	}
+}
+
+/* Find the index of each field of a trace in its header line */
+static int _trace_field(char **names, int cnt, const char *name1,
+			const char *name2)
+{
+	int i;
+
+	for (i = 0; i < cnt; i++) {
+		if (!xstrcasecmp(names[i], name1) ||
+		    (name2 && !xstrcasecmp(names[i], name2)))
+			return i;
+	}
+	return -1;
+}
+
+static int _trace_split(char *line, char **fields, int max_fields)
+{
+	char *sep;
+	int cnt = 0;
+
+	line[strcspn(line, "\r\n")] = '\0';
+	while (cnt < max_fields) {
+		fields[cnt++] = line;
+		if (!(sep = strchr(line, '|')))
+			break;
+		*sep = '\0';
+		line = sep + 1;
+	}
+	return cnt;
+}
+
+/* Parse a time limit or elapsed time, plain numbers being minutes */
+static time_t _trace_secs(const char *str)
+{
+	int secs;
+
+	if ((secs = time_str2secs(str)) == NO_VAL)
+		return -1;
+	if (secs == INFINITE)
+		return YEAR_SECONDS;
+	return secs;
+}
+
+static int _cmp_submit(const void *x, const void *y)
+{
+	const sim_job_t *job1 = x, *job2 = y;
+
+	if (job1->submit_time != job2->submit_time)
+		return (job1->submit_time < job2->submit_time) ? -1 : 1;
+	if (job1->trace_id != job2->trace_id)
+		return (job1->trace_id < job2->trace_id) ? -1 : 1;
+	return 0;
+}
+
+/*
+ * Load a trace written by sacct -P
+ * IN node_cnt, cpus - jobs of more nodes or CPUs are not replayed
+ * OUT skip_cnt - count of jobs not replayed
+ * RET count of jobs, -1 on error
+ */
+static int _trace_load(const char *path, int node_cnt, int cpus,
+		       int *skip_cnt)
+{
+	char line[4096], header[4096], *names[64], *fields[64];
+	int name_cnt, cnt, max_jobs = 1024;
+	int f_id, f_prio, f_submit, f_start, f_limit, f_nodes, f_cpus;
+	int f_elapsed;
+	bool elapsed_raw;
+	sim_job_t *job;
+	FILE *fp;
+
+	*skip_cnt = 0;
+	if (!(fp = fopen(path, "r"))) {
+		fprintf(stderr, "Can not open %s: %m\n", path);
+		return -1;
+	}
+	if (!fgets(header, sizeof(header), fp)) {
+		fprintf(stderr, "%s is empty\n", path);
+		fclose(fp);
+		return -1;
+	}
+	name_cnt = _trace_split(header, names, 64);
+	f_id = _trace_field(names, name_cnt, "JobIDRaw", "JobID");
+	f_prio = _trace_field(names, name_cnt, "Priority", NULL);
+	f_submit = _trace_field(names, name_cnt, "Submit", NULL);
+	f_start = _trace_field(names, name_cnt, "Start", NULL);
+	f_limit = _trace_field(names, name_cnt, "TimelimitRaw", "Timelimit");
+	f_nodes = _trace_field(names, name_cnt, "NNodes", NULL);
+	f_cpus = _trace_field(names, name_cnt, "NCPUS", "AllocCPUS");
+	f_elapsed = _trace_field(names, name_cnt, "ElapsedRaw", NULL);
+	if (!(elapsed_raw = (f_elapsed != -1)))
+		f_elapsed = _trace_field(names, name_cnt, "Elapsed", NULL);
+	if ((f_id == -1) || (f_submit == -1) || (f_limit == -1) ||
+	    (f_nodes == -1) || (f_elapsed == -1)) {
+		fprintf(stderr, "%s lacks JobIDRaw, Submit, TimelimitRaw, NNodes or ElapsedRaw\n",
+			path);
+		fclose(fp);
+		return -1;
+	}
+
+	jobs = xcalloc(max_jobs, sizeof(sim_job_t));
+	while (fgets(line, sizeof(line), fp)) {
+		cnt = _trace_split(line, fields, 64);
+		if (cnt < name_cnt)
+			continue;
+		/* Job steps and jobs which never started */
+		if (strchr(fields[f_id], '.'))
+			continue;
+		if ((f_start != -1) &&
+		    (!xstrcasecmp(fields[f_start], "Unknown") ||
+		     !xstrcasecmp(fields[f_start], "None") ||
+		     !fields[f_start][0])) {
+			(*skip_cnt)++;
+			continue;
+		}
+		if (job_cnt == max_jobs) {
+			max_jobs *= 2;
+			xrecalloc(jobs, max_jobs, sizeof(sim_job_t));
+		}
+		job = &jobs[job_cnt];
+		memset(job, 0, sizeof(sim_job_t));
+		job->trace_id = strtoul(fields[f_id], NULL, 10);
+		if (f_prio != -1)
+			job->priority = strtoul(fields[f_prio], NULL, 10);
+		job->submit_time = parse_time(fields[f_submit], 0);
+		job->node_cnt = atoi(fields[f_nodes]);
+		if (f_cpus != -1)
+			job->cpu_cnt = atoi(fields[f_cpus]);
+		job->time_limit = _trace_secs(fields[f_limit]);
+		if (elapsed_raw)
+			job->run_time = atol(fields[f_elapsed]);
+		else
+			job->run_time = _trace_secs(fields[f_elapsed]);
+		if (!job->submit_time || (job->node_cnt < 1) ||
+		    (job->node_cnt > node_cnt) || (job->cpu_cnt < 0) ||
+		    (job->cpu_cnt > (node_cnt * cpus)) ||
+		    (job->time_limit <= 0) || (job->run_time < 0)) {
+			(*skip_cnt)++;
+			continue;
+		}
+		/* Jobs are killed at the end of their time limit */
+		job->run_time = MIN(job->run_time, job->time_limit);
+		job_cnt++;
+	}
+	fclose(fp);
+
+	qsort(jobs, job_cnt, sizeof(sim_job_t), _cmp_submit);
+	return job_cnt;
+}
+
+/* Generate jobs of whole nodes whose work keeps the given share of the nodes
+ * busy */
+static void _workload(int node_cnt, int cnt, double load)
+{
+	static const time_t limits[] = {
+		600, 1800, 3600, 7200, 14400, 28800, 86400 };
+	double work = 0.0;
+	time_t span;
+	int i, max_log = 0;
+
+	while ((8 << max_log) < node_cnt)
+		max_log++;
+	srand(1);
+	job_cnt = cnt;
+	jobs = xcalloc(job_cnt, sizeof(sim_job_t));
+	for (i = 0; i < job_cnt; i++) {
+		jobs[i].trace_id = i + 1;
+		jobs[i].node_cnt = MIN(1 << (rand() % (max_log + 1)), node_cnt);
+		jobs[i].time_limit = limits[rand() %
+					    (sizeof(limits) / sizeof(limits[0]))];
+		jobs[i].run_time = (jobs[i].time_limit *
+				    (1 + (rand() % 100))) / 100;
+		work += (double) jobs[i].node_cnt * jobs[i].run_time;
+	}
+	span = MAX(1, work / (node_cnt * load));
+	for (i = 0; i < job_cnt; i++)
+		jobs[i].submit_time = SIM_BEGIN_TIME + (rand() % span);
+	qsort(jobs, job_cnt, sizeof(sim_job_t), _cmp_submit);
+}
+
+static char *_conf_write(char *dir, int node_cnt, int cpus,
+			 char *sched_params, char *plugin_dir, int verbose)
+{
+	static const char *levels[] = {
+		"fatal", "error", "info", "verbose", "debug", "debug2",
+		"debug3" };
+	char *conf_file = NULL, *user_name;
+	FILE *fp;
+	int i;
+
+	xstrfmtcat(conf_file, "%s/slurm.conf", dir);
+	if (!(fp = fopen(conf_file, "w"))) {
+		fprintf(stderr, "Can not write %s: %m\n", conf_file);
+		exit(1);
+	}
+	user_name = uid_to_string(getuid());
+	fprintf(fp, "ClusterName=sim\n"
+		"SlurmctldHost=localhost\n"
+		"SlurmUser=%s\n"
+		"AuthType=auth/none\n"
+		"CredType=cred/none\n"
+		"StateSaveLocation=%s/state\n"
+		"SlurmdSpoolDir=%s/spool\n"
+		"SlurmctldDebug=%s\n"
+		"SchedulerType=sched/backfill\n"
+		"SelectType=select/cons_tres\n"
+		"SelectTypeParameters=CR_Core\n"
+		"PriorityType=priority/basic\n"
+		"AccountingStorageType=accounting_storage/none\n"
+		"JobCompType=jobcomp/none\n"
+		"JobAcctGatherType=jobacct_gather/none\n"
+		"ProctrackType=proctrack/pgid\n"
+		"SwitchType=switch/none\n"
+		"MpiDefault=none\n"
+		"MaxJobCount=%d\n"
+		"PartitionName=sim Nodes=sim[1-%d] Default=YES "
+		"MaxTime=INFINITE State=UP\n",
+		user_name, dir, dir,
+		levels[MIN(verbose, (sizeof(levels) / sizeof(levels[0])) - 1)],
+		MAX(10000, job_cnt + 1), node_cnt);
+	/* No slurmd is ever contacted, all of them share an address */
+	for (i = 1; i <= node_cnt; i++) {
+		fprintf(fp, "NodeName=sim%d NodeAddr=127.0.0.1 CPUs=%d "
+			"State=IDLE\n", i, cpus);
+	}
+	if (sched_params)
+		fprintf(fp, "SchedulerParameters=%s\n", sched_params);
+	if (plugin_dir)
+		fprintf(fp, "PluginDir=%s\n", plugin_dir);
+	fclose(fp);
+	xfree(user_name);
+
+	return conf_file;
+}
+
+static void _rmdir_recursive(char *path)
+{
+	char nested_path[PATH_MAX];
+	struct stat stat_buf;
+	struct dirent *ent;
+	DIR *dp;
+
+	if (!(dp = opendir(path)))
+		return;
+	while ((ent = readdir(dp))) {
+		if (!xstrcmp(ent->d_name, ".") || !xstrcmp(ent->d_name, ".."))
+			continue;
+		snprintf(nested_path, sizeof(nested_path), "%s/%s", path,
+			 ent->d_name);
+		if (!lstat(nested_path, &stat_buf) &&
+		    S_ISDIR(stat_buf.st_mode))
+			_rmdir_recursive(nested_path);
+		else
+			(void) unlink(nested_path);
+	}
+	closedir(dp);
+	(void) rmdir(path);
+}
+
+static int _cmp_time(const void *x, const void *y)
+{
+	time_t t1 = *(time_t *) x, t2 = *(time_t *) y;
+
+	if (t1 == t2)
+		return 0;
+	return (t1 < t2) ? -1 : 1;
+}
+
+static void _report(int node_cnt, int cpus, int skip_cnt)
+{
+	time_t *waits, first = SIM_NEVER, last = 0;
+	double used = 0.0, wait_sum = 0.0;
+	int i, cnt = 0;
+
+	waits = xcalloc(job_cnt + 1, sizeof(time_t));
+	for (i = 0; i < job_cnt; i++) {
+		if (!jobs[i].start_time)
+			continue;
+		waits[cnt] = jobs[i].start_time - jobs[i].submit_time;
+		wait_sum += waits[cnt++];
+		used += (double) jobs[i].cpus * jobs[i].run_time;
+		first = MIN(first, jobs[i].submit_time);
+		last = MAX(last, jobs[i].start_time + jobs[i].run_time);
+	}
+	qsort(waits, cnt, sizeof(time_t), _cmp_time);
+
+	printf("Jobs:           %d replayed, %d not replayed, %d rejected, %d never started\n",
+	       stats.end_cnt, skip_cnt, stats.reject_cnt,
+	       stats.submit_cnt - stats.start_cnt);
+	printf("Started:        %u by backfill\n",
+	       slurmctld_diag_stats.backfilled_jobs);
+	printf("Utilization:    %.1f%%\n", (last > first) ?
+	       (used * 100.0 / ((double) node_cnt * cpus * (last - first))) :
+	       0.0);
+	if (cnt) {
+		printf("Wait time:      mean %.0f s, median %ld s, max %ld s\n",
+		       wait_sum / cnt, (long) waits[cnt / 2],
+		       (long) waits[cnt - 1]);
+	}
+	printf("Backfill:       %d cycles, %.1f jobs tested per cycle, CPU time per cycle mean %.3f ms, max %.3f ms\n",
+	       stats.bf_cycles,
+	       slurmctld_diag_stats.bf_cycle_counter ?
+	       ((double) slurmctld_diag_stats.bf_depth_sum /
+		slurmctld_diag_stats.bf_cycle_counter) : 0.0,
+	       stats.bf_cycles ? (stats.bf_cpu_ms / stats.bf_cycles) : 0.0,
+	       stats.bf_cpu_ms_max);
+	printf("Main scheduler: %d passes, CPU time per pass mean %.3f ms, max %.3f ms\n",
+	       stats.sched_passes,
+	       stats.sched_passes ?
+	       (stats.sched_cpu_ms / stats.sched_passes) : 0.0,
+	       stats.sched_cpu_ms_max);
+	xfree(waits);
+}
+
+int
+main(int argc, char *argv[])
+{
+	char dir[] = "/tmp/backfill_sim.XXXXXX";
+	char *sched_params = NULL, *plugin_dir = NULL, *conf_file;
+	int c, node_cnt = 0, cpus = 1, synth_cnt = 0, skip_cnt = 0;
+	int verbose = 0;
+
+	while ((c = getopt(argc, argv, "c:n:p:P:s:v")) != -1) {
+		switch (c) {
+		case 'c':
+			cpus = atoi(optarg);
+			break;
+		case 'n':
+			node_cnt = atoi(optarg);
+			break;
+		case 'p':
+			sched_params = optarg;
+			break;
+		case 'P':
+			plugin_dir = optarg;
+			break;
+		case 's':
+			synth_cnt = atoi(optarg);
+			break;
+		case 'v':
+			verbose++;
+			break;
+		default:
+			return 1;
+		}
+	}
+	if ((node_cnt < 1) || (cpus < 1) || (synth_cnt < 0) ||
+	    (optind != (argc - (synth_cnt ? 0 : 1)))) {
+		fprintf(stderr, "Usage: %s -n NODES [-c CPUS] [-p PARAMS] [-P DIR] [-v] (TRACE | -s JOBS)\n",
+			argv[0]);
+		return 1;
+	}
+
+	if (synth_cnt)
+		_workload(node_cnt, synth_cnt, 0.95);
+	else if (_trace_load(argv[optind], node_cnt, cpus, &skip_cnt) < 0)
+		return 1;
+	if (!job_cnt) {
+		fprintf(stderr, "No jobs to replay\n");
+		return 1;
+	}
+	submitted = xcalloc(job_cnt, sizeof(sim_job_t *));
+
+	if (!mkdtemp(dir)) {
+		fprintf(stderr, "Can not create %s: %m\n", dir);
+		return 1;
+	}
+	conf_file = _conf_write(dir, node_cnt, cpus, sched_params, plugin_dir,
+				verbose);
+
+	sim_now = jobs[0].submit_time;
+	sim_controller_init(argv[0], conf_file);
+	sim_backfill_init();
+	_simulate();
+	_report(node_cnt, cpus, skip_cnt);
+
+	_rmdir_recursive(dir);
+	xfree(conf_file);
+	xfree(submitted);
+	xfree(jobs);
+	xfree(events);
+
+	return 0;
+}
@@ -0,0 +1,50 @@
+/* Parts of the backfill simulator, see backfill_sim.c: slurmctld started
+ * without its main() and the backfill scheduler linked in instead of loaded
+ * as a plugin.
+ */
+#ifndef _BACKFILL_SIM_H
+#define _BACKFILL_SIM_H
+
+#include <stdbool.h>
+#include <time.h>
+
+/* Virtual time, returned by time() once set */
+extern time_t sim_now;
+
+/*
+ * Initialize slurmctld as its main() does, with the configuration in
+ *	conf_file and no jobs, logging to stderr at SlurmctldDebug
+ */
+extern void sim_controller_init(char *prog, char *conf_file);
+
+/*
+ * Do the scheduling work of a pass of the slurmctld background thread: purge
+ *	old job records, then run the main scheduler if sched_interval has
+ *	passed or it was requested with queue_job_scheduler()
+ * RET true if schedule() ran
+ */
+extern bool sim_controller_background(void);
+
+/* Return the next time sim_controller_background() has work to do */
+extern time_t sim_controller_next(bool pending);
+
+/*
+ * Wait for the threads prolog_slurmctld() started for the jobs allocated so
+ *	far to launch them
+ */
+extern void sim_controller_wait(void);
+
+/* Prepare the backfill scheduler as its thread does when starting */
+extern void sim_backfill_init(void);
+
+/*
+ * Do the work of a wakeup of the backfill thread
+ * RET true if a backfill cycle ran, false if there was no reason to
+ */
+extern bool sim_backfill_try(void);
+
+/* Return the earliest time of the next backfill cycle, bf_interval after
+ * the end of the last one */
+extern time_t sim_backfill_next(void);
+
+#endif
@@ -0,0 +1,387 @@
+/* Test of parallel evaluation in src/plugins/sched/backfill/bf_parallel.c.
+ *
+ * The park and resume steps of _attempt_backfill() are tested directly, then
+ * a synthetic workload of pending jobs in disjoint partitions (and some in a
+ * partition of all nodes) is planned with them, parking jobs while their
+ * nodes are selected by worker threads. With one worker the plans must be
+ * identical to those made without workers. With several, the
+ * later start times of a job are looked for before jobs of higher priority in
+ * other partitions split the records of the table, so that a few jobs may be
+ * planned differently, but the plans must not depend on the timing of the
+ * workers and must not use any node twice.
+ */
+#define _SYS_WAIT_H 1
+#include <stdio.h>
+#include <stdlib.h>
+#include <time.h>
+#include <unistd.h>
+
+#include "src/common/bitstring.h"
+#include "src/common/xmalloc.h"
+#include "src/plugins/sched/backfill/bf_parallel.h"
+#include "src/plugins/sched/backfill/node_space.h"
+#include <testsuite/dejagnu.h>
+#include "plans.h"
+
+/* Test for failure:
+*/
+#define TEST(_tst, _msg) do {		\
+	if (! (_tst))			\
+		fail( _msg );		\
+	else				\
+		pass( _msg );		\
+} while (0)
+
+#define BEGIN_TIME	1000000
+#define WINDOW		(24 * 60 * 60)
+#define MAX_JOB_NODES	8	/* nodes of a job at most */
+#define MAX_TRIES	32	/* start times tested per pending job */
+
+typedef struct {
+	int node_cnt;
+	int part_cnt;		/* disjoint partitions, plus one of all nodes */
+	int run_cnt;		/* running jobs */
+	int pend_cnt;		/* pending jobs */
+	int cost;		/* work of the select plugin per test */
+} workload_t;
+
+typedef struct {
+	int part;		/* part_cnt for the partition of all nodes */
+	int node_cnt;
+	time_t time_limit;
+} job_t;
+
+/* Job parked while its nodes are selected, as bf_park_t in backfill.c */
+typedef struct {
+	int job_inx;
+	job_t *job;
+	int cost;
+	int tries;
+	time_t start_res;
+	time_t later_start;
+	bitstr_t *avail_bitmap;
+	int rc;
+} park_t;
+
+/*
+ * Select nodes as a select plugin would, here the first consecutive nodes
+ * available. Run on worker threads.
+ */
+static void _eval(void *arg)
+{
+	park_t *park = (park_t *) arg;
+	int i, first = -1, cnt = 0;
+
+	/* Work of the select plugin */
+	for (i = 0; i < park->cost; i++)
+		(void) bit_set_count(park->avail_bitmap);
+
+	for (i = 0; i < bit_size(park->avail_bitmap); i++) {
+		if (!bit_test(park->avail_bitmap, i)) {
+			cnt = 0;
+			continue;
+		}
+		if (cnt++ == 0)
+			first = i;
+		if (cnt == park->job->node_cnt)
+			break;
+	}
+	bit_clear_all(park->avail_bitmap);
+	if (cnt == park->job->node_cnt) {
+		bit_nset(park->avail_bitmap, first, first + cnt - 1);
+		park->rc = 0;
+	} else {
+		park->rc = -1;
+	}
+}
+
+static bitstr_t **_parts_create(workload_t *wl)
+{
+	bitstr_t **parts = xcalloc(wl->part_cnt + 1, sizeof(bitstr_t *));
+	int i, part_size = wl->node_cnt / wl->part_cnt;
+
+	for (i = 0; i <= wl->part_cnt; i++) {
+		parts[i] = bit_alloc(wl->node_cnt);
+		if (i == wl->part_cnt)
+			bit_nset(parts[i], 0, wl->node_cnt - 1);
+		else
+			bit_nset(parts[i], i * part_size,
+				 ((i + 1) * part_size) - 1);
+	}
+	return parts;
+}
+
+static void _parts_free(workload_t *wl, bitstr_t **parts)
+{
+	int i;
+
+	for (i = 0; i <= wl->part_cnt; i++)
+		FREE_NULL_BITMAP(parts[i]);
+	xfree(parts);
+}
+
+static job_t *_jobs_create(workload_t *wl)
+{
+	job_t *jobs = xcalloc(wl->pend_cnt, sizeof(job_t));
+	int i;
+
+	srand(wl->node_cnt + wl->part_cnt + wl->pend_cnt);
+	for (i = 0; i < wl->pend_cnt; i++) {
+		if ((rand() % 8) == 0)
+			jobs[i].part = wl->part_cnt;
+		else
+			jobs[i].part = rand() % wl->part_cnt;
+		jobs[i].node_cnt = 1 + (rand() % MAX_JOB_NODES);
+		jobs[i].time_limit = 60 * (1 + (rand() % 240));
+	}
+	return jobs;
+}
+
+/* Nodes of the next job as _park_next_nodes() in backfill.c, NULL if none */
+static bitstr_t *_next_nodes(workload_t *wl, job_t *jobs, int next,
+			     bitstr_t **parts)
+{
+	if (next >= wl->pend_cnt)
+		return NULL;
+	return parts[jobs[next].part];
+}
+
+/*
+ * Plan a workload as _attempt_backfill() does: reserve the nodes of running
+ * jobs until they end, then test each pending job at the earliest time nodes
+ * of its partition are available and at the later start times found. Jobs are
+ * parked while their nodes are selected, and the outcome of parked jobs is
+ * applied to the table in order of priority.
+ * IN workers - count of worker threads, 0 to select nodes serially
+ * OUT plans - start time and nodes planned for each pending job
+ * OUT max_parked - count of jobs parked at once at most
+ */
+static void _plan(workload_t *wl, int workers, plan_t *plans,
+		  int *max_parked)
+{
+	node_space_map_t *node_space;
+	bitstr_t **parts, *node_bitmap;
+	job_t *jobs;
+	park_t *park;
+	time_t end_time, end_reserve;
+	int i, first, next = 0, node_space_recs = 1;
+	int max_recs = (wl->run_cnt + wl->pend_cnt) * 2 + 1;
+	bool resumed;
+
+	bf_parallel_reconfig(workers);
+	parts = _parts_create(wl);
+	jobs = _jobs_create(wl);
+	*max_parked = 0;
+
+	node_bitmap = bit_alloc(wl->node_cnt);
+	bit_nset(node_bitmap, 0, wl->node_cnt - 1);
+	node_space = node_space_create(max_recs, BEGIN_TIME,
+				       BEGIN_TIME + WINDOW, node_bitmap, NULL);
+	for (i = 0; i < wl->run_cnt; i++) {
+		node_bitmap = bit_alloc(wl->node_cnt);
+		first = rand() % wl->node_cnt;
+		bit_nset(node_bitmap, first,
+			 MIN(first + 1 + (rand() % MAX_JOB_NODES),
+			     wl->node_cnt) - 1);
+		bit_not(node_bitmap);
+		end_time = BEGIN_TIME + 60 * (1 + (rand() % (WINDOW / 60)));
+		node_space_add_reservation(node_space, BEGIN_TIME, end_time,
+					   node_bitmap, NULL, &node_space_recs);
+		FREE_NULL_BITMAP(node_bitmap);
+	}
+
+	while (1) {
+		if ((park = bf_parallel_resume(_next_nodes(wl, jobs, next,
+							    parts)))) {
+			resumed = true;
+			goto tested;
+		}
+		if (next >= wl->pend_cnt)
+			break;
+
+		park = xmalloc(sizeof(park_t));
+		park->job_inx = next;
+		park->job = &jobs[next++];
+		park->cost = wl->cost;
+		park->start_res = BEGIN_TIME;
+		resumed = false;
+
+try_later:
+		FREE_NULL_BITMAP(park->avail_bitmap);
+		park->avail_bitmap = bit_copy(parts[park->job->part]);
+		end_time = park->start_res + park->job->time_limit;
+		park->later_start = node_space_freed(node_space,
+						     park->avail_bitmap,
+						     park->start_res, end_time);
+		node_space_avail(node_space, park->start_res, 0, end_time,
+				 park->avail_bitmap);
+		if (bit_set_count(park->avail_bitmap) < park->job->node_cnt)
+			goto not_runnable;
+
+		if (bf_parallel_may_park(resumed)) {
+			bf_parallel_submit(_eval, park,
+					   parts[park->job->part]);
+			*max_parked = MAX(*max_parked, bf_parallel_count());
+			continue;
+		}
+		_eval(park);
+
+tested:
+		if (park->rc == 0) {
+			i = park->job_inx;
+			end_reserve = park->start_res + park->job->time_limit;
+			plans[i].start_time = park->start_res;
+			plans[i].end_time = end_reserve;
+			plans[i].node_bitmap = bit_copy(park->avail_bitmap);
+			bit_not(park->avail_bitmap);
+			node_space_add_reservation(node_space, park->start_res,
+						   end_reserve,
+						   park->avail_bitmap, NULL,
+						   &node_space_recs);
+			goto next_job;
+		}
+
+not_runnable:
+		if (park->later_start && (park->later_start > park->start_res) &&
+		    (++park->tries < MAX_TRIES)) {
+			park->start_res = park->later_start;
+			goto try_later;
+		}
+
+next_job:
+		FREE_NULL_BITMAP(park->avail_bitmap);
+		xfree(park);
+	}
+
+	node_space_free(node_space);
+	xfree(jobs);
+	_parts_free(wl, parts);
+}
+
+/* Return the count of pairs of pending jobs planned on the same nodes */
+static int _plans_overlap(plan_t *plans, int cnt)
+{
+	int i, j, overlap = 0;
+
+	for (i = 0; i < cnt; i++) {
+		if (!plans[i].node_bitmap)
+			continue;
+		for (j = i + 1; j < cnt; j++) {
+			if (plans[j].node_bitmap &&
+			    (plans[i].start_time < plans[j].end_time) &&
+			    (plans[j].start_time < plans[i].end_time) &&
+			    bit_overlap_any(plans[i].node_bitmap,
+					    plans[j].node_bitmap))
+				overlap++;
+		}
+	}
+	return overlap;
+}
+
+/* Return the count of pending jobs planned */
+static int _plans_count(plan_t *plans, int cnt)
+{
+	int i, planned = 0;
+
+	for (i = 0; i < cnt; i++) {
+		if (plans[i].start_time)
+			planned++;
+	}
+	return planned;
+}
+
+static void _order_eval(void *arg)
+{
+	/* Let later tasks end first */
+	usleep(*(int *) arg * 1000);
+}
+
+int
+main(int argc, char *argv[])
+{
+	workload_t wl = { 512, 8, 100, 600, 16 };
+	plan_t *plans[4];
+	int i, arg[3] = { 30, 20, 10 }, max_parked[4];
+	int *res[3];
+	bitstr_t *node_bitmap[3], *other_bitmap;
+	bool ordered;
+
+	note("Testing task order");
+	{
+		bf_parallel_reconfig(3);
+		TEST(bf_parallel_workers() == 3, "workers started");
+		for (i = 0; i < 3; i++) {
+			node_bitmap[i] = bit_alloc(64);
+			bit_nset(node_bitmap[i], i * 8, (i * 8) + 7);
+			bf_parallel_submit(_order_eval, &arg[i],
+					   node_bitmap[i]);
+		}
+		TEST(bf_parallel_full() && (bf_parallel_count() == 3),
+		     "tasks in flight");
+		TEST(!bf_parallel_may_park(false),
+		     "no job parked with all workers busy");
+		other_bitmap = bit_alloc(64);
+		bit_set(other_bitmap, 20);
+		TEST(bf_parallel_overlap(other_bitmap),
+		     "overlap with nodes of task in flight");
+		bit_clear_all(other_bitmap);
+		bit_set(other_bitmap, 40);
+		TEST(!bf_parallel_overlap(other_bitmap),
+		     "no overlap with other nodes");
+		bf_parallel_wait();
+		TEST(bf_parallel_count() == 3, "tasks evaluated");
+
+		res[0] = bf_parallel_resume(other_bitmap);
+		TEST(res[0] && (bf_parallel_count() == 2),
+		     "job resumed with all workers busy");
+		TEST(!bf_parallel_resume(other_bitmap),
+		     "next job on other nodes parked first");
+		TEST(bf_parallel_may_park(false) && !bf_parallel_may_park(true),
+		     "resumed job not parked behind tasks in flight");
+		bit_set(other_bitmap, 20);
+		res[1] = bf_parallel_resume(other_bitmap);
+		TEST(res[1], "job resumed before next job on its nodes");
+		res[2] = bf_parallel_resume(NULL);
+		TEST(res[2], "job resumed if next job may not be parked");
+		FREE_NULL_BITMAP(other_bitmap);
+		ordered = (res[0] == &arg[0]) && (res[1] == &arg[1]) &&
+			  (res[2] == &arg[2]);
+		TEST(ordered, "jobs resumed in order of submission");
+		TEST(!bf_parallel_count() && !bf_parallel_resume(NULL) &&
+		     !bf_parallel_next(), "no task left");
+		TEST(bf_parallel_may_park(true),
+		     "resumed job parked with no task in flight");
+		for (i = 0; i < 3; i++)
+			FREE_NULL_BITMAP(node_bitmap[i]);
+		bf_parallel_reconfig(0);
+		TEST(bf_parallel_workers() == 0, "workers ended");
+	}
+
+	note("Testing plans against serial evaluation");
+	{
+		int workers[] = { 0, 1, 4, 4 };
+
+		for (i = 0; i < 4; i++) {
+			plans[i] = xcalloc(wl.pend_cnt, sizeof(plan_t));
+			_plan(&wl, workers[i], plans[i], &max_parked[i]);
+		}
+		bf_parallel_reconfig(0);
+		TEST(_plans_count(plans[0], wl.pend_cnt) > (wl.pend_cnt / 2),
+		     "jobs planned");
+		TEST(_plans_overlap(plans[0], wl.pend_cnt) == 0,
+		     "no nodes planned twice serially");
+		TEST(max_parked[1] == 1, "one job parked at once with 1 worker");
+		TEST(plans_differ(plans[0], plans[1], wl.pend_cnt) == 0,
+		     "plans identical with 1 worker");
+		TEST(max_parked[2] > 1, "jobs parked at once with 4 workers");
+		TEST(plans_differ(plans[2], plans[3], wl.pend_cnt) == 0,
+		     "plans repeated with 4 workers");
+		TEST(_plans_overlap(plans[2], wl.pend_cnt) == 0,
+		     "no nodes planned twice with 4 workers");
+		for (i = 0; i < 4; i++)
+			plans_free(plans[i], wl.pend_cnt);
+	}
+
+	totals();
+	return failed;
+}
@@ -0,0 +1,165 @@
+/* Test of the job record hash tables in src/slurmctld/job_hash.c, used by
+ * find_job_record() and find_job_array_rec().
+ */
+#define _SYS_WAIT_H 1
+#include <stdio.h>
+#include <stdlib.h>
+
+#include "src/common/xmalloc.h"
+#include "src/slurmctld/job_hash.h"
+#include <testsuite/dejagnu.h>
+
+/* Test for failure:
+*/
+#define TEST(_tst, _msg) do {		\
+	if (! (_tst))			\
+		fail( _msg );		\
+	else				\
+		pass( _msg );		\
+} while (0)
+
+#define ARRAY_SIZE	1000	/* tasks per job array */
+
+static job_record_t *jobs = NULL;
+static int job_cnt = 0;
+
+/* Create job records of job arrays, with job IDs starting at 1 */
+static void _jobs_create(int cnt)
+{
+	int i;
+
+	jobs = xcalloc(cnt, sizeof(job_record_t));
+	job_cnt = cnt;
+	for (i = 0; i < cnt; i++) {
+		jobs[i].job_id = i + 1;
+		jobs[i].array_job_id = (i - (i % ARRAY_SIZE)) + 1;
+		jobs[i].array_task_id = i % ARRAY_SIZE;
+	}
+}
+
+static void _jobs_free(void)
+{
+	job_hash_fini();
+	xfree(jobs);
+	job_cnt = 0;
+}
+
+/* Return true if all added records and no others are found */
+static bool _jobs_found(bool *added)
+{
+	job_record_t *job_ptr;
+	int i;
+
+	for (i = 0; i < job_cnt; i++) {
+		job_ptr = job_hash_find(jobs[i].job_id);
+		if (job_ptr != (added[i] ? &jobs[i] : NULL))
+			return false;
+		job_ptr = job_hash_array_find(jobs[i].array_job_id,
+					      jobs[i].array_task_id);
+		if (job_ptr != (added[i] ? &jobs[i] : NULL))
+			return false;
+	}
+	return true;
+}
+
+/* Return the number of task records listed for a job array */
+static int _array_task_cnt(uint32_t array_job_id)
+{
+	job_record_t *job_ptr, *prev_ptr = NULL;
+	int cnt = 0;
+
+	for (job_ptr = job_hash_array_first(array_job_id); job_ptr;
+	     job_ptr = job_ptr->job_array_next_j) {
+		if ((job_ptr->array_job_id != array_job_id) ||
+		    (job_ptr->job_array_prev_j != prev_ptr))
+			return -1;
+		prev_ptr = job_ptr;
+		cnt++;
+	}
+	return cnt;
+}
+
+int
+main(int argc, char *argv[])
+{
+	bool *added;
+	int i, j, cnt;
+
+	note("Testing lookup while tables are resized");
+	{
+		_jobs_create(20 * ARRAY_SIZE);
+		added = xcalloc(job_cnt, sizeof(bool));
+		job_hash_init(1);
+		TEST(!job_hash_find(1) && !job_hash_array_first(1),
+		     "empty tables");
+		cnt = 0;
+		for (i = 0; i < job_cnt; i++) {
+			job_hash_add(&jobs[i]);
+			job_hash_array_add(&jobs[i]);
+			added[i] = true;
+			/* Test some while the old table is not empty */
+			if ((i % 997) == 0)
+				cnt += !_jobs_found(added);
+		}
+		TEST(!cnt, "records found while growing");
+		TEST(_jobs_found(added), "all records found");
+		TEST(!job_hash_find(job_cnt + 1) &&
+		     !job_hash_array_find(1, ARRAY_SIZE),
+		     "missing records not found");
+	}
+
+	note("Testing job array task lists");
+	{
+		TEST(_array_task_cnt(1) == ARRAY_SIZE, "all tasks listed");
+		/* Remove first, last and some middle tasks */
+		job_hash_array_remove(job_hash_array_first(1));
+		TEST(_array_task_cnt(1) == ARRAY_SIZE - 1, "first removed");
+		job_hash_array_remove(&jobs[0]);
+		TEST(_array_task_cnt(1) == ARRAY_SIZE - 2, "last removed");
+		job_hash_array_remove(&jobs[ARRAY_SIZE / 2]);
+		TEST(_array_task_cnt(1) == ARRAY_SIZE - 3, "middle removed");
+		TEST(job_hash_array_remove(&jobs[0]) == SLURM_ERROR,
+		     "removed task not found");
+		for (i = 0; i < ARRAY_SIZE; i++)
+			job_hash_array_remove(&jobs[i]);
+		TEST(!job_hash_array_first(1) &&
+		     (_array_task_cnt(ARRAY_SIZE + 1) == ARRAY_SIZE),
+		     "array removed");
+		for (i = 0; i < ARRAY_SIZE; i++)
+			job_hash_array_add(&jobs[i]);
+		TEST(_array_task_cnt(1) == ARRAY_SIZE, "array added again");
+	}
+
+	note("Testing removal while tables are resized");
+	{
+		/* Remove in an order unrelated to the job IDs */
+		cnt = 0;
+		for (i = 0, j = 0; i < job_cnt; i++) {
+			j = (j + 7919) % job_cnt;
+			if (job_hash_remove(&jobs[j]) ||
+			    job_hash_array_remove(&jobs[j]))
+				cnt++;
+			added[j] = false;
+			if ((i % 997) == 0)
+				cnt += !_jobs_found(added);
+		}
+		TEST(!cnt, "records removed while shrinking");
+		TEST(_jobs_found(added), "no records found");
+		TEST(job_hash_remove(&jobs[0]) == SLURM_ERROR,
+		     "removed record not found");
+
+		/* Tables are usable again after shrinking */
+		for (i = 0; i < ARRAY_SIZE; i++) {
+			job_hash_add(&jobs[i]);
+			job_hash_array_add(&jobs[i]);
+			added[i] = true;
+		}
+		TEST(_jobs_found(added), "records added again");
+		TEST(_array_task_cnt(1) == ARRAY_SIZE, "tasks listed again");
+		xfree(added);
+		_jobs_free();
+	}
+
+	totals();
+	return failed;
+}
@@ -0,0 +1,287 @@
+/* Test of license availability planning in src/slurmctld/licenses.c and of
+ * its use in the table of the backfill scheduler
+ * (src/plugins/sched/backfill/node_space.c) to reserve licenses for pending
+ * jobs.
+ */
+#define _SYS_WAIT_H 1
+#include <stdlib.h>
+#include <time.h>
+
+#include "src/common/bitstring.h"
+#include "src/common/list.h"
+#include "src/common/pack.h"
+#include "src/common/xmalloc.h"
+#include "src/common/xstring.h"
+#include "src/slurmctld/licenses.h"
+#include "src/plugins/sched/backfill/node_space.h"
+#include <testsuite/dejagnu.h>
+
+/* Test for failure:
+*/
+#define TEST(_tst, _msg) do {		\
+	if (! (_tst))			\
+		fail( _msg );		\
+	else				\
+		pass( _msg );		\
+} while (0)
+
+#define MAX_RECS	8
+#define TABLE_END	400
+
+/* Backfill table with records beginning at 0, 100, 200 and 300 */
+static node_space_map_t *node_space = NULL;
+static int node_space_recs = 0;
+
+static license_avail_t *_rec_avail(time_t when)
+{
+	return node_space[node_space_find(node_space, when)].licenses;
+}
+
+static void _table_create(void)
+{
+	time_t when;
+
+	node_space = node_space_create(MAX_RECS, 0, TABLE_END, bit_alloc(1),
+				       license_avail_create());
+	node_space_recs = 1;
+	for (when = 100; when < TABLE_END; when += 100) {
+		(void) node_space_split(node_space,
+					node_space_find(node_space, when),
+					when, &node_space_recs);
+	}
+}
+
+static void _job_init(job_record_t *job_ptr, uint32_t job_id, char *licenses)
+{
+	bool valid = false;
+
+	job_ptr->job_id = job_id;
+	job_ptr->license_list = license_validate(licenses, true, true, NULL,
+						 &valid);
+	if (!valid)
+		fail("license_validate");
+}
+
+/* Find the usage of a license packed by get_all_license_usage() */
+static bool _usage_find(List resv_records, char *name, uint32_t *in_use,
+			uint32_t *reserved, char **resv_members)
+{
+	char *buffer, *lic_name, *members[4];
+	int buffer_size, i, j;
+	uint32_t lic_cnt, total, uint32_tmp;
+	uint8_t remote;
+	time_t last_update;
+	bool found = false;
+	Buf buf;
+
+	get_all_license_usage(&buffer, &buffer_size, resv_records, 0,
+			      SLURM_PROTOCOL_VERSION);
+	buf = create_buf(buffer, buffer_size);
+	safe_unpack32(&lic_cnt, buf);
+	safe_unpack_time(&last_update, buf);
+	for (i = 0; i < lic_cnt; i++) {
+		safe_unpackstr_xmalloc(&lic_name, &uint32_tmp, buf);
+		safe_unpack32(&total, buf);
+		safe_unpack32(in_use, buf);
+		safe_unpack32(reserved, buf);
+		safe_unpack8(&remote, buf);
+		for (j = 0; j < 4; j++)
+			safe_unpackstr_xmalloc(&members[j], &uint32_tmp, buf);
+		if (!xstrcmp(lic_name, name)) {
+			found = true;
+			*resv_members = members[2];
+			members[2] = NULL;
+		}
+		xfree(lic_name);
+		for (j = 0; j < 4; j++)
+			xfree(members[j]);
+		if (found)
+			break;
+	}
+unpack_error:
+	free_buf(buf);
+	return found;
+}
+
+static time_t _plan_start(job_record_t *job_ptr, time_t start_res,
+			  time_t run_time)
+{
+	return node_space_licenses_start(node_space, job_ptr, start_res,
+					 run_time, true);
+}
+
+int
+main(int argc, char *argv[])
+{
+	job_record_t run_a = { 0 }, run_b = { 0 }, big = { 0 }, small = { 0 };
+	job_record_t grp_01 = { 0 }, grp_1 = { 0 }, grp_2 = { 0 };
+	job_record_t grp_3 = { 0 };
+	slurmctld_resv_t resv = { 0 };
+	List resv_records;
+	license_avail_t *avail;
+	uint32_t in_use = 0, reserved = 0;
+	char *resv_members = NULL, *members;
+	bitstr_t *group_avail;
+	bool valid = false;
+
+	license_init("matlab:4,W20F[0-3]");
+
+	note("Testing availability of running jobs' licenses");
+	{
+		/* run_a ends at 100, run_b ends at 200 */
+		_job_init(&run_a, 1, "matlab:2,W20F[0-1]");
+		_job_init(&run_b, 2, "matlab:2");
+		license_job_get(&run_a);
+		license_job_get(&run_b);
+
+		_table_create();
+		TEST(node_space_recs == 4, "table split");
+		TEST(license_avail_equal(_rec_avail(0), _rec_avail(100)),
+		     "split records equal");
+		node_space_licenses_return(node_space, &run_a, 100);
+		TEST(!license_avail_equal(_rec_avail(0), _rec_avail(100)),
+		     "return changes availability");
+		node_space_licenses_return(node_space, &run_b, 200);
+		TEST(license_avail_equal(_rec_avail(200), _rec_avail(300)),
+		     "return applies to later records");
+		TEST(!license_avail_equal(_rec_avail(100), _rec_avail(200)),
+		     "return does not apply to earlier records");
+	}
+
+	note("Testing license reservation of a job using all licenses");
+	{
+		_job_init(&big, 3, "matlab:4");
+		TEST(license_job_test(&big, 0, false) == EAGAIN,
+		     "big job blocked now");
+		TEST(_plan_start(&big, 0, 100) == 200,
+		     "big job planned when running jobs end");
+		node_space_licenses_remove(node_space, &big, 200, 300);
+	}
+
+	note("Testing backfill of a job using fewer licenses");
+	{
+		_job_init(&small, 4, "matlab:1");
+		license_job_return(&run_a);
+		TEST(license_job_test(&small, 100, false) == SLURM_SUCCESS,
+		     "small job runnable after first job ends");
+		/* Starting the small job at 100 would delay the big job */
+		TEST(_plan_start(&small, 100, 150) == 300,
+		     "long small job does not delay big job");
+		TEST(_plan_start(&small, 100, 50) == 100,
+		     "short small job backfilled");
+		TEST(node_space_licenses_start(node_space, &small, 100, 50,
+					       false) == 100,
+		     "first record only unavailable");
+		TEST(node_space_licenses_start(node_space, &small, 0, 50,
+					       false) == 100,
+		     "job not started in unavailable first record");
+	}
+
+	note("Testing license groups");
+	{
+		_job_init(&grp_01, 5, "W20F[0-1]");
+		_job_init(&grp_1, 6, "W20F1");
+		_job_init(&grp_2, 7, "W20F2");
+		TEST(_plan_start(&grp_01, 0, 100) == 100,
+		     "group members available when running job ends");
+		TEST(_plan_start(&grp_2, 0, 100) == 0,
+		     "unused group member available now");
+		node_space_licenses_remove(node_space, &grp_01, 100, 200);
+		TEST(_plan_start(&grp_1, 100, 50) == 200,
+		     "reserved group member not available");
+		TEST(_plan_start(&grp_2, 100, 50) == 100,
+		     "other group member available");
+	}
+
+	note("Testing license usage");
+	{
+		/* run_b holds 2 matlab, run_a W20F[0-1] was returned */
+		resv.start_time = 0;
+		resv.end_time = INFINITE;
+		resv.license_list = license_validate("matlab:3,W20F[1-2]",
+						     true, true, NULL, &valid);
+		resv_records = list_create(NULL);
+		list_append(resv_records, &resv);
+		TEST(_usage_find(resv_records, "matlab", &in_use, &reserved,
+				 &resv_members) && (in_use == 2) &&
+		     (reserved == 2),
+		     "reserved count limited to licenses not in use");
+		xfree(resv_members);
+		license_job_get(&grp_01);
+		TEST(_usage_find(resv_records, "W20F", &in_use, &reserved,
+				 &resv_members) && (in_use == 2) &&
+		     (reserved == 1) && !xstrcmp(resv_members, "2"),
+		     "reserved group members not in use");
+		xfree(resv_members);
+		license_job_return(&grp_01);
+		resv.start_time = time(NULL) + 100;
+		TEST(_usage_find(resv_records, "W20F", &in_use, &reserved,
+				 &resv_members) && (in_use == 0) &&
+		     (reserved == 0),
+		     "future reservation not reserved");
+		xfree(resv_members);
+		FREE_NULL_LIST(resv_records);
+		FREE_NULL_LIST(resv.license_list);
+	}
+
+	note("Testing license group members held by a reservation");
+	{
+		resv.name = "resv_1";
+		resv.start_time = 0;
+		resv.license_list = license_validate("W20F[1-2]", true, true,
+						     NULL, &valid);
+		resv_list = list_create(NULL);
+		list_append(resv_list, &resv);
+		_job_init(&grp_3, 8, "W20F3");
+		TEST(license_job_test(&grp_1, 0, false) == EAGAIN,
+		     "reserved member not given to job outside reservation");
+		TEST(license_job_test(&grp_3, 0, false) == SLURM_SUCCESS,
+		     "unreserved member given to job outside reservation");
+		grp_1.resv_name = "resv_1";
+		TEST(license_job_test(&grp_1, 0, false) == SLURM_SUCCESS,
+		     "reserved member given to job in reservation");
+		grp_1.resv_name = NULL;
+
+		group_avail = license_group_avail("W20F", NULL);
+		members = bit_fmt_full(group_avail);
+		TEST(!xstrcmp(members, "0,3"),
+		     "reserved members not available outside reservation");
+		xfree(members);
+		FREE_NULL_BITMAP(group_avail);
+		group_avail = license_group_avail("W20F", "resv_1");
+		members = bit_fmt_full(group_avail);
+		TEST(!xstrcmp(members, "0-3"),
+		     "reserved members available in reservation");
+		xfree(members);
+		FREE_NULL_BITMAP(group_avail);
+		FREE_NULL_LIST(resv_list);
+		FREE_NULL_LIST(resv.license_list);
+	}
+
+	note("Testing reconfiguration");
+	{
+		license_update("matlab:2");
+		TEST(license_avail_test(node_space[0].licenses, &big),
+		     "availability unknown after reconfiguration");
+		avail = license_avail_create();
+		TEST(!license_avail_equal(avail, node_space[0].licenses),
+		     "availability differs after reconfiguration");
+		license_avail_free(avail);
+		license_free();
+		TEST(license_avail_create() == NULL,
+		     "no availability without licenses");
+	}
+
+	node_space_free(node_space);
+	FREE_NULL_LIST(run_a.license_list);
+	FREE_NULL_LIST(run_b.license_list);
+	FREE_NULL_LIST(big.license_list);
+	FREE_NULL_LIST(small.license_list);
+	FREE_NULL_LIST(grp_01.license_list);
+	FREE_NULL_LIST(grp_1.license_list);
+	FREE_NULL_LIST(grp_2.license_list);
+	FREE_NULL_LIST(grp_3.license_list);
+
+	totals();
+	return failed;
+}
@@ -0,0 +1,525 @@
+/* Test of the backfill table in src/plugins/sched/backfill/node_space.c.
+ *
+ * A synthetic workload of running and pending jobs is planned with the table,
+ * and the nodes available and later start times found must match those of
+ * the linear walk over the linked records used before.
+ */
+#define _SYS_WAIT_H 1
+#include <stdio.h>
+#include <stdlib.h>
+#include <time.h>
+
+#include "src/common/bitstring.h"
+#include "src/common/xmalloc.h"
+#include "src/plugins/sched/backfill/node_space.h"
+#include <testsuite/dejagnu.h>
+#include "plans.h"
+
+/* Test for failure:
+*/
+#define TEST(_tst, _msg) do {		\
+	if (! (_tst))			\
+		fail( _msg );		\
+	else				\
+		pass( _msg );		\
+} while (0)
+
+#define BEGIN_TIME	1000000
+#define WINDOW		(24 * 60 * 60)
+#define MAX_JOB_NODES	16	/* nodes of a job at most */
+#define MAX_TRIES	32	/* start times tested per pending job */
+
+typedef struct {
+	int node_cnt;
+	int run_cnt;		/* running jobs */
+	int pend_cnt;		/* pending jobs */
+	int resolution;
+} workload_t;
+
+/* Reservation as made by backfill.c before, linear in the number of records */
+static void _old_add_reservation(time_t start_time, time_t end_reserve,
+				 bitstr_t *res_bitmap,
+				 node_space_map_t *node_space,
+				 int *node_space_recs)
+{
+	bool placed = false;
+	int i, j;
+
+	start_time = MAX(start_time, node_space[0].begin_time);
+	for (j = 0; ; ) {
+		if (node_space[j].end_time > start_time) {
+			i = *node_space_recs;
+			node_space[i].begin_time = start_time;
+			node_space[i].end_time = node_space[j].end_time;
+			node_space[j].end_time = start_time;
+			node_space[i].avail_bitmap =
+				bit_copy(node_space[j].avail_bitmap);
+			node_space[i].next = node_space[j].next;
+			node_space[j].next = i;
+			(*node_space_recs)++;
+			placed = true;
+		}
+		if (node_space[j].end_time == start_time)
+			placed = true;
+		if (placed == true) {
+			while ((j = node_space[j].next)) {
+				if (end_reserve < node_space[j].end_time) {
+					i = *node_space_recs;
+					node_space[i].begin_time = end_reserve;
+					node_space[i].end_time =
+						node_space[j].end_time;
+					node_space[j].end_time = end_reserve;
+					node_space[i].avail_bitmap =
+						bit_copy(node_space[j].
+							 avail_bitmap);
+					node_space[i].next = node_space[j].next;
+					node_space[j].next = i;
+					(*node_space_recs)++;
+					break;
+				}
+				if (end_reserve == node_space[j].end_time)
+					break;
+			}
+			break;
+		}
+		if ((j = node_space[j].next) == 0)
+			break;
+	}
+
+	for (j = 0; ; ) {
+		if ((node_space[j].begin_time >= start_time) &&
+		    (node_space[j].end_time <= end_reserve))
+			bit_and(node_space[j].avail_bitmap, res_bitmap);
+		if ((node_space[j].begin_time >= end_reserve) ||
+		    ((j = node_space[j].next) == 0))
+			break;
+	}
+
+	for (i = 0; ; ) {
+		if ((j = node_space[i].next) == 0)
+			break;
+		if (!bit_equal(node_space[i].avail_bitmap,
+			       node_space[j].avail_bitmap)) {
+			i = j;
+			continue;
+		}
+		node_space[i].end_time = node_space[j].end_time;
+		node_space[i].next = node_space[j].next;
+		FREE_NULL_BITMAP(node_space[j].avail_bitmap);
+		break;
+	}
+}
+
+/* Map walk of _attempt_backfill() as before */
+static time_t _old_avail(node_space_map_t *node_space, time_t start_res,
+			 time_t end_time, bitstr_t *avail_bitmap)
+{
+	bitstr_t *tmp_bitmap = bit_copy(avail_bitmap);
+	time_t later_start = 0;
+	int j;
+
+	for (j = 0; ; ) {
+		if ((node_space[j].end_time > start_res) &&
+		     node_space[j].next && (later_start == 0)) {
+			int tmp = node_space[j].next;
+			bitstr_t *next_bitmap = bit_copy(tmp_bitmap);
+			bitstr_t *current_bitmap = bit_copy(avail_bitmap);
+			bit_and(next_bitmap, node_space[tmp].avail_bitmap);
+			bit_and(current_bitmap, node_space[j].avail_bitmap);
+			if (!bit_super_set(next_bitmap, current_bitmap))
+				later_start = node_space[j].end_time;
+			FREE_NULL_BITMAP(next_bitmap);
+			FREE_NULL_BITMAP(current_bitmap);
+		}
+		if (node_space[j].end_time <= start_res)
+			;
+		else if (node_space[j].begin_time <= end_time)
+			bit_and(avail_bitmap, node_space[j].avail_bitmap);
+		else
+			break;
+		if ((j = node_space[j].next) == 0)
+			break;
+	}
+	FREE_NULL_BITMAP(tmp_bitmap);
+
+	return later_start;
+}
+
+static void _old_free(node_space_map_t *node_space)
+{
+	int i;
+
+	for (i = 0; ; ) {
+		FREE_NULL_BITMAP(node_space[i].avail_bitmap);
+		if ((i = node_space[i].next) == 0)
+			break;
+	}
+	xfree(node_space);
+}
+
+static bitstr_t *_job_nodes(workload_t *wl, int first, int cnt)
+{
+	bitstr_t *node_bitmap = bit_alloc(wl->node_cnt);
+
+	bit_nset(node_bitmap, first, MIN(first + cnt, wl->node_cnt) - 1);
+	return node_bitmap;
+}
+
+/*
+ * Plan a workload as _attempt_backfill() does: reserve the nodes of running
+ * jobs until they end, then test each pending job at the earliest time nodes
+ * are available and at the later start times found, reserving the first
+ * nodes available.
+ * IN old - use the linear walks over the records used before
+ * OUT plans - start time and nodes planned for each pending job
+ * OUT recs - count of records of the table at the end
+ * OUT mismatch - count of queries of the table for which the linear walk over
+ *	the same records finds other nodes or later start time, if not old
+ */
+static void _plan(workload_t *wl, bool old, plan_t *plans, int *recs,
+		  int *mismatch)
+{
+	node_space_map_t *node_space;
+	bitstr_t *node_bitmap, *avail_bitmap, *walk_bitmap;
+	time_t start_res, end_time, end_reserve, later_start;
+	int i, j, cnt, node_space_recs = 1;
+	int max_recs = (wl->run_cnt + wl->pend_cnt) * 2 + 1;
+
+	srand(wl->node_cnt + wl->run_cnt + wl->pend_cnt);
+	if (mismatch)
+		*mismatch = 0;
+	node_bitmap = bit_alloc(wl->node_cnt);
+	bit_nset(node_bitmap, 0, wl->node_cnt - 1);
+	if (old) {
+		node_space = xcalloc(max_recs, sizeof(node_space_map_t));
+		node_space[0].begin_time = BEGIN_TIME;
+		node_space[0].end_time = BEGIN_TIME + WINDOW;
+		node_space[0].avail_bitmap = node_bitmap;
+	} else {
+		node_space = node_space_create(max_recs, BEGIN_TIME,
+					       BEGIN_TIME + WINDOW,
+					       node_bitmap, NULL);
+	}
+
+	for (i = 0; i < wl->run_cnt; i++) {
+		node_bitmap = _job_nodes(wl, rand() % wl->node_cnt,
+					 1 + (rand() % MAX_JOB_NODES));
+		bit_not(node_bitmap);
+		end_time = BEGIN_TIME + 1 + (rand() % WINDOW);
+		end_time = (end_time / wl->resolution) * wl->resolution;
+		if (old)
+			_old_add_reservation(BEGIN_TIME, end_time, node_bitmap,
+					     node_space, &node_space_recs);
+		else
+			node_space_add_reservation(node_space, BEGIN_TIME,
+						   end_time, node_bitmap, NULL,
+						   &node_space_recs);
+		FREE_NULL_BITMAP(node_bitmap);
+	}
+
+	for (i = 0; i < wl->pend_cnt; i++) {
+		cnt = 1 + (rand() % MAX_JOB_NODES);
+		end_reserve = 60 * (1 + (rand() % 240));
+		plans[i].start_time = 0;
+		plans[i].node_bitmap = NULL;
+		start_res = BEGIN_TIME;
+		for (j = 0; j < MAX_TRIES; j++) {
+			avail_bitmap = bit_alloc(wl->node_cnt);
+			bit_nset(avail_bitmap, 0, wl->node_cnt - 1);
+			end_time = start_res + end_reserve;
+			if (old) {
+				later_start = _old_avail(node_space, start_res,
+							 end_time,
+							 avail_bitmap);
+			} else {
+				later_start = node_space_freed(node_space,
+							       avail_bitmap,
+							       start_res,
+							       end_time);
+				node_space_avail(node_space, start_res, 0,
+						 end_time, avail_bitmap);
+			}
+			if (!old && mismatch) {
+				node_space_sync(node_space);
+				walk_bitmap = bit_alloc(wl->node_cnt);
+				bit_nset(walk_bitmap, 0, wl->node_cnt - 1);
+				if ((_old_avail(node_space, start_res, end_time,
+						walk_bitmap) != later_start) ||
+				    !bit_equal(walk_bitmap, avail_bitmap))
+					(*mismatch)++;
+				FREE_NULL_BITMAP(walk_bitmap);
+			}
+			if (bit_set_count(avail_bitmap) >= cnt) {
+				bit_clear_all(avail_bitmap);
+				bit_nset(avail_bitmap, 0, wl->node_cnt - 1);
+				plans[i].start_time = start_res;
+				plans[i].node_bitmap = avail_bitmap;
+				break;
+			}
+			FREE_NULL_BITMAP(avail_bitmap);
+			if (!later_start || (later_start <= start_res))
+				break;
+			start_res = later_start;
+		}
+		if (!plans[i].node_bitmap)
+			continue;
+
+		/* Reserve the first nodes found available */
+		node_bitmap = bit_copy(plans[i].node_bitmap);
+		bit_clear_all(node_bitmap);
+		bit_nset(node_bitmap, 0, wl->node_cnt - 1);
+		if (old)
+			(void) _old_avail(node_space, start_res,
+					  start_res + end_reserve, node_bitmap);
+		else
+			node_space_avail(node_space, start_res, 0,
+					 start_res + end_reserve, node_bitmap);
+		bit_clear_all(plans[i].node_bitmap);
+		for (j = bit_ffs(node_bitmap); (j >= 0) && cnt; j++) {
+			if (bit_test(node_bitmap, j)) {
+				bit_set(plans[i].node_bitmap, j);
+				cnt--;
+			}
+		}
+		bit_copybits(node_bitmap, plans[i].node_bitmap);
+		bit_not(node_bitmap);
+		start_res = (start_res / wl->resolution) * wl->resolution;
+		end_reserve = ((start_res + end_reserve) / wl->resolution) *
+			      wl->resolution;
+		if (old)
+			_old_add_reservation(start_res, end_reserve,
+					     node_bitmap, node_space,
+					     &node_space_recs);
+		else
+			node_space_add_reservation(node_space, start_res,
+						   end_reserve, node_bitmap,
+						   NULL, &node_space_recs);
+		FREE_NULL_BITMAP(node_bitmap);
+	}
+
+	/* Count records in use */
+	*recs = 0;
+	for (i = 0; ; ) {
+		(*recs)++;
+		if ((i = node_space[i].next) == 0)
+			break;
+	}
+	if (old)
+		_old_free(node_space);
+	else
+		node_space_free(node_space);
+}
+
+/* Check the tree of a subtree, RET count of its records or -1 if invalid */
+static int _check_tree(node_space_map_t *node_space, int t, int *next)
+{
+	node_space_map_t *rec;
+	bitstr_t *avail_bitmap, *freed_bitmap;
+	int cnt, left_cnt = 0, right_cnt = 0;
+	bool valid;
+
+	if (t == -1)
+		return 0;
+	rec = &node_space[t];
+	if (rec->tree_res_bitmap)
+		return -1;
+	if (((rec->left != -1) && (node_space[rec->left].parent != t)) ||
+	    ((rec->right != -1) && (node_space[rec->right].parent != t)))
+		return -1;
+	if ((left_cnt = _check_tree(node_space, rec->left, next)) < 0)
+		return -1;
+	/* Records in order of time */
+	if (*next != t)
+		return -1;
+	*next = rec->next;
+	if ((right_cnt = _check_tree(node_space, rec->right, next)) < 0)
+		return -1;
+
+	avail_bitmap = bit_copy(rec->avail_bitmap);
+	freed_bitmap = bit_copy(rec->freed_bitmap);
+	if (rec->left != -1) {
+		bit_and(avail_bitmap, node_space[rec->left].tree_avail_bitmap);
+		bit_or(freed_bitmap, node_space[rec->left].tree_freed_bitmap);
+	}
+	if (rec->right != -1) {
+		bit_and(avail_bitmap,
+			node_space[rec->right].tree_avail_bitmap);
+		bit_or(freed_bitmap, node_space[rec->right].tree_freed_bitmap);
+	}
+	valid = bit_equal(avail_bitmap, rec->tree_avail_bitmap) &&
+		bit_equal(freed_bitmap, rec->tree_freed_bitmap);
+	FREE_NULL_BITMAP(avail_bitmap);
+	FREE_NULL_BITMAP(freed_bitmap);
+	if (!valid)
+		return -1;
+
+	cnt = left_cnt + right_cnt + 1;
+	return cnt;
+}
+
+/* Check records are consecutive and nodes freed match their neighbours */
+static bool _check_recs(node_space_map_t *node_space)
+{
+	bitstr_t *freed_bitmap;
+	bool valid = true;
+	int i, j;
+
+	for (i = 0; valid && ((j = node_space[i].next) != 0); i = j) {
+		freed_bitmap = bit_copy(node_space[j].avail_bitmap);
+		bit_and_not(freed_bitmap, node_space[i].avail_bitmap);
+		valid = (node_space[i].end_time == node_space[j].begin_time) &&
+			(node_space[j].begin_time < node_space[j].end_time) &&
+			bit_equal(freed_bitmap, node_space[j].freed_bitmap);
+		FREE_NULL_BITMAP(freed_bitmap);
+	}
+	return valid;
+}
+
+int
+main(int argc, char *argv[])
+{
+	node_space_map_t *node_space;
+	bitstr_t *node_bitmap, *res_bitmap;
+	plan_t *plans[2];
+	int i, j, recs[2], next, mismatch, node_space_recs = 1;
+
+	note("Testing table operations");
+	{
+		node_bitmap = bit_alloc(64);
+		bit_nset(node_bitmap, 0, 63);
+		node_space = node_space_create(64, BEGIN_TIME,
+					       BEGIN_TIME + WINDOW,
+					       node_bitmap, NULL);
+		TEST(node_space_find(node_space, BEGIN_TIME - 1) == -1,
+		     "time before table not found");
+		TEST(node_space_find(node_space, BEGIN_TIME + WINDOW) == -1,
+		     "time after table not found");
+
+		/* Nodes 0-7 reserved from +100 to +200, 4-11 to +300 */
+		res_bitmap = bit_alloc(64);
+		bit_nset(res_bitmap, 8, 63);
+		node_space_add_reservation(node_space, BEGIN_TIME + 100,
+					   BEGIN_TIME + 200, res_bitmap, NULL,
+					   &node_space_recs);
+		bit_clear_all(res_bitmap);
+		bit_nset(res_bitmap, 0, 3);
+		bit_nset(res_bitmap, 12, 63);
+		node_space_add_reservation(node_space, BEGIN_TIME + 100,
+					   BEGIN_TIME + 300, res_bitmap, NULL,
+					   &node_space_recs);
+		TEST(node_space_recs == 4, "records split");
+		i = node_space_find(node_space, BEGIN_TIME + 250);
+		TEST((i != -1) &&
+		     (node_space[i].begin_time == BEGIN_TIME + 200) &&
+		     (node_space[i].end_time == BEGIN_TIME + 300),
+		     "record found");
+
+		node_bitmap = bit_alloc(64);
+		bit_nset(node_bitmap, 0, 63);
+		node_space_avail(node_space, BEGIN_TIME, 0, BEGIN_TIME + 150,
+				 node_bitmap);
+		TEST((bit_set_count(node_bitmap) == 52) &&
+		     !bit_test(node_bitmap, 0) && !bit_test(node_bitmap, 11),
+		     "nodes available until +150");
+		bit_nset(node_bitmap, 0, 63);
+		node_space_avail(node_space, BEGIN_TIME + 200, 0,
+				 BEGIN_TIME + 400, node_bitmap);
+		TEST((bit_set_count(node_bitmap) == 56) &&
+		     bit_test(node_bitmap, 0) && !bit_test(node_bitmap, 4),
+		     "nodes available from +200");
+
+		bit_nset(node_bitmap, 0, 63);
+		TEST(node_space_freed(node_space, node_bitmap, BEGIN_TIME,
+				      BEGIN_TIME + 150) == BEGIN_TIME + 200,
+		     "nodes freed at +200");
+		bit_clear_all(node_bitmap);
+		bit_nset(node_bitmap, 8, 11);
+		TEST(node_space_freed(node_space, node_bitmap, BEGIN_TIME,
+				      BEGIN_TIME + 150) == BEGIN_TIME + 300,
+		     "some nodes freed at +300");
+		bit_clear_all(node_bitmap);
+		bit_nset(node_bitmap, 12, 63);
+		TEST(node_space_freed(node_space, node_bitmap, BEGIN_TIME,
+				      BEGIN_TIME + 150) == 0,
+		     "other nodes not freed");
+
+		bit_clear_all(node_bitmap);
+		bit_set(node_bitmap, 10);
+		i = node_space_busy(node_space, node_bitmap, BEGIN_TIME - 1);
+		TEST((i != -1) && (node_space[i].begin_time == BEGIN_TIME + 100),
+		     "node busy from +100");
+		i = node_space_busy(node_space, node_bitmap, BEGIN_TIME + 100);
+		TEST((i != -1) && (node_space[i].begin_time == BEGIN_TIME + 200),
+		     "node busy from +200");
+		bit_clear_all(node_bitmap);
+		bit_set(node_bitmap, 40);
+		TEST(node_space_busy(node_space, node_bitmap,
+				     BEGIN_TIME - 1) == -1, "node never busy");
+
+		/* Reserving nothing more merges identical records */
+		bit_nset(res_bitmap, 0, 63);
+		node_space_add_reservation(node_space, BEGIN_TIME + 400,
+					   BEGIN_TIME + 500, res_bitmap, NULL,
+					   &node_space_recs);
+		node_space_sync(node_space);
+		next = 0;
+		TEST((_check_tree(node_space, 0, &next) == 4) && !next &&
+		     _check_recs(node_space), "identical records merged");
+		FREE_NULL_BITMAP(node_bitmap);
+		FREE_NULL_BITMAP(res_bitmap);
+		node_space_free(node_space);
+	}
+
+	note("Testing tree with many records");
+	{
+		node_space_recs = 1;
+		node_bitmap = bit_alloc(256);
+		bit_nset(node_bitmap, 0, 255);
+		node_space = node_space_create(4001, BEGIN_TIME,
+					       BEGIN_TIME + WINDOW,
+					       node_bitmap, NULL);
+		res_bitmap = bit_alloc(256);
+		srand(1);
+		for (i = 0; i < 2000; i++) {
+			bit_nset(res_bitmap, 0, 255);
+			j = rand() % 256;
+			bit_nclear(res_bitmap, j, MIN(j + 4, 255));
+			j = rand() % WINDOW;
+			node_space_add_reservation(node_space, BEGIN_TIME + j,
+						   BEGIN_TIME + j +
+						   (rand() % 7200),
+						   res_bitmap, NULL,
+						   &node_space_recs);
+		}
+		node_space_sync(node_space);
+		next = 0;
+		TEST((_check_tree(node_space, 0, &next) > 1000) && !next,
+		     "tree in order of time with valid summaries");
+		TEST(_check_recs(node_space), "records consecutive");
+		FREE_NULL_BITMAP(res_bitmap);
+		node_space_free(node_space);
+	}
+
+	note("Testing queries match linear walks");
+	{
+		workload_t test[] = {
+			{ 64,  100, 100, 60 },
+			{ 64,  100, 100,  1 },
+			{ 512, 500, 300, 60 },
+			{ 512, 500, 300,  1 },
+		};
+		for (i = 0; i < (sizeof(test) / sizeof(test[0])); i++) {
+			plans[0] = xcalloc(test[i].pend_cnt, sizeof(plan_t));
+			plans[1] = xcalloc(test[i].pend_cnt, sizeof(plan_t));
+			_plan(&test[i], true, plans[0], &recs[0], NULL);
+			_plan(&test[i], false, plans[1], &recs[1], &mismatch);
+			TEST(!mismatch, "same nodes and later start times");
+			TEST(recs[1] <= recs[0], "fewer records");
+			plans_free(plans[0], test[i].pend_cnt);
+			plans_free(plans[1], test[i].pend_cnt);
+		}
+	}
+
+	totals();
+	return failed;
+}
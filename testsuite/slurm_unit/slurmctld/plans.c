@@ -0,0 +1,31 @@
+/* Plans of pending jobs made by the backfill tests, shared by node_space-test
+ * and bf_parallel-test.
+ */
+#include "src/common/xmalloc.h"
+#include "plans.h"
+
+extern void plans_free(plan_t *plans, int cnt)
+{
+	int i;
+
+	for (i = 0; i < cnt; i++)
+		FREE_NULL_BITMAP(plans[i].node_bitmap);
+	xfree(plans);
+}
+
+extern int plans_differ(plan_t *plans_1, plan_t *plans_2, int cnt)
+{
+	int i, diff = 0;
+
+	for (i = 0; i < cnt; i++) {
+		if (plans_1[i].start_time != plans_2[i].start_time)
+			diff++;
+		else if ((!plans_1[i].node_bitmap !=
+			  !plans_2[i].node_bitmap) ||
+			 (plans_1[i].node_bitmap &&
+			  !bit_equal(plans_1[i].node_bitmap,
+				     plans_2[i].node_bitmap)))
+			diff++;
+	}
+	return diff;
+}
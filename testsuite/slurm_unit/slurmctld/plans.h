@@ -0,0 +1,23 @@
+/* Plans of pending jobs made by the backfill tests, shared by node_space-test
+ * and bf_parallel-test.
+ */
+#ifndef _TEST_PLANS_H
+#define _TEST_PLANS_H
+
+#include <time.h>
+
+#include "src/common/bitstring.h"
+
+typedef struct {
+	time_t start_time;	/* 0 if not planned */
+	time_t end_time;
+	bitstr_t *node_bitmap;
+} plan_t;
+
+/* Free the plans of cnt pending jobs */
+extern void plans_free(plan_t *plans, int cnt);
+
+/* Return the count of pending jobs with other plans */
+extern int plans_differ(plan_t *plans_1, plan_t *plans_2, int cnt);
+
+#endif
@@ -0,0 +1,256 @@
+/* Test of the job queue kept between runs of the main scheduler in
+ * src/slurmctld/sched_queue.c, used with SchedulerParameters=sched_incremental.
+ */
+#define _SYS_WAIT_H 1
+#include <stdio.h>
+#include <stdlib.h>
+
+#include "src/common/bitstring.h"
+#include "src/common/list.h"
+#include "src/common/xmalloc.h"
+#include "src/common/xstring.h"
+#include "src/slurmctld/sched_queue.h"
+#include <testsuite/dejagnu.h>
+
+/* Test for failure:
+*/
+#define TEST(_tst, _msg) do {		\
+	if (! (_tst))			\
+		fail( _msg );		\
+	else				\
+		pass( _msg );		\
+} while (0)
+
+#define NODE_CNT	8
+#define PART_CNT	3
+
+/* Stub of the order of job_scheduler.c: decreasing priority, then job ID */
+extern int sort_job_queue2(void *x, void *y)
+{
+	job_queue_rec_t *job_rec1 = *(job_queue_rec_t **) x;
+	job_queue_rec_t *job_rec2 = *(job_queue_rec_t **) y;
+
+	if (job_rec1->priority > job_rec2->priority)
+		return -1;
+	if (job_rec1->priority < job_rec2->priority)
+		return 1;
+	if (job_rec1->job_id < job_rec2->job_id)
+		return -1;
+	if (job_rec1->job_id > job_rec2->job_id)
+		return 1;
+	return 0;
+}
+
+static part_record_t parts[PART_CNT];
+static List test_part_list = NULL;
+static job_record_t *jobs = NULL;
+static int job_cnt = 0;
+
+/* Partitions p0 (nodes 0-3), p1 (nodes 2-5) sharing nodes with p0 and
+ * p2 (nodes 6-7) */
+static void _parts_create(void)
+{
+	int first[PART_CNT] = { 0, 2, 6 }, last[PART_CNT] = { 3, 5, 7 };
+	int i;
+
+	test_part_list = list_create(NULL);
+	for (i = 0; i < PART_CNT; i++) {
+		parts[i].name = xstrdup_printf("p%d", i);
+		parts[i].node_bitmap = bit_alloc(NODE_CNT);
+		bit_nset(parts[i].node_bitmap, first[i], last[i]);
+		list_append(test_part_list, &parts[i]);
+	}
+}
+
+static void _parts_free(void)
+{
+	int i;
+
+	FREE_NULL_LIST(test_part_list);
+	for (i = 0; i < PART_CNT; i++) {
+		xfree(parts[i].name);
+		FREE_NULL_BITMAP(parts[i].node_bitmap);
+	}
+}
+
+static void _jobs_create(int cnt)
+{
+	int i;
+
+	jobs = xcalloc(cnt, sizeof(job_record_t));
+	job_cnt = cnt;
+	for (i = 0; i < cnt; i++) {
+		jobs[i].job_id = i + 1;
+		jobs[i].priority = random() % 1000;
+	}
+}
+
+static void _rec_push(job_record_t *job_ptr, part_record_t *part_ptr)
+{
+	job_queue_rec_t *job_queue_rec = xmalloc(sizeof(job_queue_rec_t));
+
+	job_queue_rec->array_task_id = NO_VAL;
+	job_queue_rec->job_id = job_ptr->job_id;
+	job_queue_rec->job_ptr = job_ptr;
+	job_queue_rec->part_ptr = part_ptr;
+	job_queue_rec->priority = job_ptr->priority;
+	sched_queue_push(job_queue_rec);
+}
+
+/* Queue each job in one partition, every fifth job in two of them */
+static void _jobs_push(void)
+{
+	int i;
+
+	sched_queue_init(test_part_list);
+	for (i = 0; i < job_cnt; i++) {
+		_rec_push(&jobs[i], &parts[i % PART_CNT]);
+		if ((i % 5) == 0)
+			_rec_push(&jobs[i], &parts[(i + 1) % PART_CNT]);
+	}
+}
+
+static int _rec_cnt(int cnt)
+{
+	return cnt + ((cnt + 4) / 5);
+}
+
+/* Pop all records, RET count or -1 if out of order or of clean partitions */
+static int _pop_all(void)
+{
+	job_queue_rec_t *job_queue_rec, *prev_rec = NULL;
+	int cnt = 0;
+
+	while ((job_queue_rec = sched_queue_pop())) {
+		if ((job_queue_rec->queue_inx != -1) ||
+		    !sched_queue_dirty(job_queue_rec->part_ptr) ||
+		    (prev_rec &&
+		     (sort_job_queue2(&prev_rec, &job_queue_rec) > 0)))
+			cnt = -1 - job_cnt;
+		xfree(prev_rec);
+		prev_rec = job_queue_rec;
+		cnt++;
+	}
+	xfree(prev_rec);
+	return (cnt < 0) ? -1 : cnt;
+}
+
+static bool _job_recs_clear(void)
+{
+	int i;
+
+	for (i = 0; i < job_cnt; i++) {
+		if (jobs[i].queue_rec)
+			return false;
+	}
+	return true;
+}
+
+int
+main(int argc, char *argv[])
+{
+	job_queue_rec_t *job_queue_rec;
+	bitstr_t *node_bitmap;
+	bool ok;
+	int i, cnt;
+
+	srandom(1);
+	_parts_create();
+
+	note("Testing order of records");
+	{
+		_jobs_create(1000);
+		_jobs_push();
+		TEST(sched_queue_count() == _rec_cnt(job_cnt),
+		     "records counted");
+		TEST(_pop_all() == _rec_cnt(job_cnt), "records in order");
+		TEST(sched_queue_count() == 0, "queue empty");
+		TEST(_job_recs_clear(), "records unlinked from jobs");
+	}
+
+	note("Testing dirty partitions");
+	{
+		_jobs_push();
+		for (i = 0; i < PART_CNT; i++)
+			sched_queue_set_dirty(&parts[i], false);
+		TEST(sched_queue_pop() == NULL, "no record of clean partitions");
+
+		sched_queue_set_dirty(&parts[2], true);
+		cnt = sched_queue_count();
+		ok = true;
+		while ((job_queue_rec = sched_queue_pop())) {
+			if (job_queue_rec->part_ptr != &parts[2])
+				ok = false;
+			xfree(job_queue_rec);
+		}
+		TEST(ok, "records of dirty partition only");
+		TEST(sched_queue_count() < cnt,
+		     "records of dirty partition removed");
+		TEST(!sched_queue_dirty(&parts[0]) &&
+		     sched_queue_dirty(&parts[2]), "dirty flags kept");
+
+		node_bitmap = bit_alloc(NODE_CNT);
+		bit_set(node_bitmap, 1);
+		sched_queue_dirty_nodes(node_bitmap);
+		TEST(sched_queue_dirty(&parts[0]) &&
+		     !sched_queue_dirty(&parts[1]),
+		     "partition of changed node dirty");
+		bit_clear(node_bitmap, 1);
+		bit_set(node_bitmap, 5);
+		sched_queue_set_dirty(&parts[0], false);
+		sched_queue_dirty_nodes(node_bitmap);
+		TEST(!sched_queue_dirty(&parts[0]) &&
+		     sched_queue_dirty(&parts[1]),
+		     "other partition of changed node dirty");
+		FREE_NULL_BITMAP(node_bitmap);
+
+		/* p2 has no records left, p0 shares nodes with p1 */
+		TEST(sched_queue_dirty_overlap() == 2, "overlap counted");
+		TEST(sched_queue_dirty(&parts[0]) &&
+		     sched_queue_dirty(&parts[1]) &&
+		     !sched_queue_dirty(&parts[2]),
+		     "overlapping partition dirty, empty one clean");
+		cnt = sched_queue_count();
+		TEST(_pop_all() == cnt, "remaining records in order");
+		sched_queue_clear();
+		TEST(_job_recs_clear(), "records freed");
+	}
+
+	note("Testing removal of jobs");
+	{
+		_jobs_push();
+		cnt = sched_queue_count();
+		for (i = 0; i < job_cnt; i += 2) {
+			sched_queue_remove_job(&jobs[i]);
+			cnt -= ((i % 5) == 0) ? 2 : 1;
+		}
+		TEST(sched_queue_count() == cnt,
+		     "records of removed jobs counted");
+		ok = true;
+		for (i = 0; i < job_cnt; i += 2) {
+			if (jobs[i].queue_rec)
+				ok = false;
+		}
+		TEST(ok, "records of removed jobs unlinked");
+
+		/* Move the records of odd jobs to the previous even job */
+		for (i = 1; i < job_cnt; i += 2)
+			sched_queue_move_job(&jobs[i], &jobs[i - 1]);
+		ok = true;
+		while ((job_queue_rec = sched_queue_pop())) {
+			if ((job_queue_rec->job_ptr - jobs) % 2)
+				ok = false;
+			if (job_queue_rec->job_ptr->queue_rec == job_queue_rec)
+				ok = false;
+			xfree(job_queue_rec);
+		}
+		TEST(ok, "records moved to other job");
+		TEST(_job_recs_clear(), "moved records unlinked");
+		xfree(jobs);
+	}
+
+	sched_queue_clear();
+	_parts_free();
+	totals();
+	return failed;
+}
@@ -0,0 +1,57 @@
+/* The backfill scheduler of the simulator, see backfill_sim.c.
+ *
+ * src/plugins/sched/backfill/backfill.c is built into the simulator instead
+ * of loaded as the sched/backfill plugin. Its thread is not started, the
+ * simulator runs each backfill cycle on the virtual clock instead. The
+ * functions of src/slurmctld/sched_plugin.c are replaced here by what they
+ * call in backfill_wrapper.c.
+ */
+#include "src/plugins/sched/backfill/backfill.c"
+#include "src/common/slurm_priority.h"
+#include "src/slurmctld/gang.h"
+#include "backfill_sim.h"
+
+static time_t sim_last_backfill_time = 0;
+
+extern int slurm_sched_init(void)
+{
+	return SLURM_SUCCESS;
+}
+
+extern int slurm_sched_fini(void)
+{
+	gs_fini();
+	return SLURM_SUCCESS;
+}
+
+extern int slurm_sched_g_reconfig(void)
+{
+	gs_reconfig();
+	backfill_reconfig();
+	return SLURM_SUCCESS;
+}
+
+extern uint32_t slurm_sched_g_initial_priority(uint32_t last_prio,
+					       job_record_t *job_ptr)
+{
+	return priority_g_set(last_prio, job_ptr);
+}
+
+extern void sim_backfill_init(void)
+{
+	_load_config();
+	sim_last_backfill_time = time(NULL);
+	het_job_list = list_create(_het_job_map_del);
+}
+
+extern bool sim_backfill_try(void)
+{
+	if (slurmctld_config.scheduling_disabled)
+		return false;
+	return _backfill_try(&sim_last_backfill_time);
+}
+
+extern time_t sim_backfill_next(void)
+{
+	return sim_last_backfill_time + backfill_interval;
+}
@@ -0,0 +1,217 @@
+/* The slurmctld of the simulator, see backfill_sim.c.
+ *
+ * src/slurmctld/controller.c is built into the simulator with its main()
+ * renamed. sim_controller_init() does the part of that main() a primary
+ * controller does before starting its threads, and
+ * sim_controller_background() the part of _slurmctld_background() that
+ * schedules jobs. No RPC, signal, state save or power thread is started,
+ * only those prolog_slurmctld() starts for each job allocated, which
+ * sim_controller_wait() waits for.
+ */
+#define main slurmctld_main
+#include "src/slurmctld/controller.c"
+#undef main
+
+#include "backfill_sim.h"
+
+static time_t sim_last_sched_time = 0;
+static time_t sim_last_full_sched_time = 0;
+static time_t sim_last_purge_job_time = 0;
+
+static int _sim_purge_job_interval(void)
+{
+	if ((slurmctld_conf.min_job_age > 0) &&
+	    (slurmctld_conf.min_job_age < PURGE_JOB_INTERVAL))
+		return MAX(10, slurmctld_conf.min_job_age);
+	return PURGE_JOB_INTERVAL;
+}
+
+extern void sim_controller_init(char *prog, char *conf_file)
+{
+	slurmctld_lock_t config_write_lock = {
+		WRITE_LOCK, WRITE_LOCK, WRITE_LOCK, WRITE_LOCK, NO_LOCK };
+	slurm_trigger_callbacks_t callbacks;
+	prep_callbacks_t prep_callbacks = {
+		.prolog_slurmctld = prep_prolog_slurmctld_callback,
+		.epilog_slurmctld = prep_epilog_slurmctld_callback,
+	};
+	int error_code;
+
+	_init_config();
+	daemonize = 0;
+	log_init(prog, log_opts, LOG_DAEMON, NULL);
+	sched_log_init(prog, sched_log_opts, LOG_DAEMON, NULL);
+	slurmctld_pid = getpid();
+	slurm_conf_init(conf_file);
+	update_logging();
+	memset(&slurmctld_diag_stats, 0, sizeof(slurmctld_diag_stats));
+	slurmctld_config.daemonize = 0;
+	set_slurmctld_state_loc();
+
+	if (license_init(slurmctld_conf.licenses) != SLURM_SUCCESS)
+		fatal("Invalid Licenses value: %s", slurmctld_conf.licenses);
+
+	association_based_accounting =
+		slurm_get_is_association_based_accounting();
+	accounting_enforce = slurmctld_conf.accounting_storage_enforce;
+	memset(&callbacks, 0, sizeof(slurm_trigger_callbacks_t));
+
+	if ((error_code = gethostname_short(slurmctld_config.node_name_short,
+					    MAX_SLURM_NAME)))
+		fatal("getnodename_short error %s", slurm_strerror(error_code));
+	slurmctld_config.cred_ctx = slurm_cred_creator_ctx_create(
+			slurmctld_conf.job_credential_private_key);
+	if (!slurmctld_config.cred_ctx)
+		fatal("slurm_cred_creator_ctx_create(%s): %m",
+		      slurmctld_conf.job_credential_private_key);
+	backup_inx = 0;
+	slurmctld_primary = 1;
+
+	if (slurm_auth_init(NULL) != SLURM_SUCCESS)
+		fatal("failed to initialize authentication plugin");
+	if (slurm_select_init(0) != SLURM_SUCCESS)
+		fatal("failed to initialize node selection plugin");
+	if (gres_plugin_init() != SLURM_SUCCESS)
+		fatal("failed to initialize gres plugin");
+	if (slurm_preempt_init() != SLURM_SUCCESS)
+		fatal("failed to initialize preempt plugin");
+	if (acct_gather_conf_init() != SLURM_SUCCESS)
+		fatal("failed to initialize acct_gather plugins");
+	if (jobacct_gather_init() != SLURM_SUCCESS)
+		fatal("failed to initialize jobacct_gather plugin");
+	if (job_submit_plugin_init() != SLURM_SUCCESS)
+		fatal("failed to initialize job_submit plugin");
+	if (prep_plugin_init(&prep_callbacks) != SLURM_SUCCESS)
+		fatal("failed to initialize prep plugin");
+	if (ext_sensors_init() != SLURM_SUCCESS)
+		fatal("failed to initialize ext_sensors plugin");
+	if (node_features_g_init() != SLURM_SUCCESS)
+		fatal("failed to initialize node_features plugin");
+	if (switch_g_slurmctld_init() != SLURM_SUCCESS)
+		fatal("failed to initialize switch plugin");
+	config_power_mgr();
+
+	xfree(slurmctld_config.auth_info);
+	slurmctld_config.auth_info = slurm_get_auth_info();
+	ctld_assoc_mgr_init(&callbacks);
+	if (slurm_acct_storage_init(NULL) != SLURM_SUCCESS)
+		fatal("failed to initialize accounting_storage plugin");
+
+	lock_slurmctld(config_write_lock);
+	if (switch_g_restore(slurmctld_conf.state_save_location, false))
+		fatal("failed to initialize switch plugin");
+	if ((error_code = read_slurm_conf(0, false)))
+		fatal("read_slurm_conf reading %s: %s",
+		      slurmctld_conf.slurm_conf, slurm_strerror(error_code));
+	unlock_slurmctld(config_write_lock);
+	select_g_select_nodeinfo_set_all();
+
+	acct_db_conn = acct_storage_g_get_connection(
+		&callbacks, 0, NULL, false, slurmctld_conf.cluster_name);
+	if (assoc_mgr_init(acct_db_conn, NULL, errno) &&
+	    (accounting_enforce & ACCOUNTING_ENFORCE_ASSOCS))
+		fatal("assoc_mgr_init failure");
+
+	control_time = time(NULL);
+	_accounting_cluster_ready();
+
+	if (slurm_priority_init() != SLURM_SUCCESS)
+		fatal("failed to initialize priority plugin");
+	if (slurm_sched_init() != SLURM_SUCCESS)
+		fatal("failed to initialize scheduling plugin");
+	if (slurmctld_plugstack_init())
+		fatal("failed to initialize slurmctld_plugstack");
+	if (bb_g_init() != SLURM_SUCCESS)
+		fatal("failed to initialize burst buffer plugin");
+	if (power_g_init() != SLURM_SUCCESS)
+		fatal("failed to initialize power management plugin");
+	if (slurm_mcs_init() != SLURM_SUCCESS)
+		fatal("failed to initialize mcs plugin");
+
+	sim_last_sched_time = sim_last_full_sched_time = time(NULL);
+	sim_last_purge_job_time = time(NULL);
+}
+
+extern bool sim_controller_background(void)
+{
+	slurmctld_lock_t job_write_lock2 = {
+		NO_LOCK, WRITE_LOCK, NO_LOCK, NO_LOCK, NO_LOCK };
+	slurmctld_lock_t purge_job_locks = {
+		.conf = READ_LOCK, .job = WRITE_LOCK,
+		.node = WRITE_LOCK, .fed = READ_LOCK
+	};
+	time_t now = time(NULL);
+	uint32_t job_limit = NO_VAL;
+	int *job_id;
+
+	if (difftime(now, sim_last_purge_job_time) >=
+	    _sim_purge_job_interval()) {
+		lock_slurmctld(purge_job_locks);
+		sim_last_purge_job_time = now;
+		purge_old_job();
+		unlock_slurmctld(purge_job_locks);
+		/* What _purge_files_thread() does when woken up */
+		while ((job_id = list_dequeue(purge_files_list))) {
+			delete_job_desc_files(*job_id);
+			xfree(job_id);
+		}
+	}
+
+	if (difftime(now, sim_last_full_sched_time) >= sched_interval) {
+		job_limit = INFINITE;
+		job_sched_cnt = 0;
+		sim_last_full_sched_time = now;
+	} else if (job_sched_cnt &&
+		   (difftime(now, sim_last_sched_time) >= batch_sched_delay)) {
+		job_limit = 0;
+		job_sched_cnt = 0;
+	}
+	if (job_limit == NO_VAL)
+		return false;
+
+	lock_slurmctld(job_write_lock2);
+	sim_last_sched_time = now;
+	bb_g_load_state(false);
+	unlock_slurmctld(job_write_lock2);
+	(void) schedule(job_limit);
+	set_job_elig_time();
+	return true;
+}
+
+extern time_t sim_controller_next(bool pending)
+{
+	time_t next = sim_last_purge_job_time + _sim_purge_job_interval();
+
+	if (job_sched_cnt)
+		next = MIN(next, sim_last_sched_time + batch_sched_delay);
+	if (pending)
+		next = MIN(next, sim_last_full_sched_time + sched_interval);
+	return next;
+}
+
+extern void sim_controller_wait(void)
+{
+	slurmctld_lock_t job_read_lock = {
+		NO_LOCK, READ_LOCK, NO_LOCK, NO_LOCK, NO_LOCK };
+	ListIterator job_iterator;
+	job_record_t *job_ptr;
+	bool running;
+
+	while (true) {
+		running = false;
+		lock_slurmctld(job_read_lock);
+		job_iterator = list_iterator_create(job_list);
+		while ((job_ptr = list_next(job_iterator))) {
+			if (job_ptr->details &&
+			    job_ptr->details->prolog_running) {
+				running = true;
+				break;
+			}
+		}
+		list_iterator_destroy(job_iterator);
+		unlock_slurmctld(job_read_lock);
+		if (!running)
+			break;
+		usleep(100);
+	}
+}
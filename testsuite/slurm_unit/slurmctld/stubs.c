@@ -0,0 +1,35 @@
+/* Stubs for functions of slurmctld called by src/slurmctld/licenses.c, which
+ * is linked into the tests without the rest of slurmctld.
+ */
+#include "src/common/xstring.h"
+#include "src/slurmctld/licenses.h"
+#include "src/slurmctld/slurmctld.h"
+
+/* Reservations set up by a test, all of them active */
+List resv_list = NULL;
+
+/* Only license group members are reserved, counted licenses are not */
+extern int job_test_lic_resv(job_record_t *job_ptr, char *lic_name,
+			     time_t when, bool reboot, bitstr_t *resv_bits)
+{
+	ListIterator iter;
+	slurmctld_resv_t *resv_ptr;
+
+	if (!resv_list || !resv_bits)
+		return 0;
+
+	iter = list_iterator_create(resv_list);
+	while ((resv_ptr = list_next(iter))) {
+		if (!xstrcmp(job_ptr->resv_name, resv_ptr->name))
+			continue;
+		license_list_group_bits(resv_ptr->license_list, lic_name,
+					resv_bits);
+	}
+	list_iterator_destroy(iter);
+	return 0;
+}
+
+extern void trace_job(job_record_t *job_ptr, const char *func,
+		      const char *extra)
+{
+}